@@ -324,37 +324,26 @@ static void DotNetCore_Receive(MODULE_HANDLE moduleHandle, MESSAGE_HANDLE messag
         {
             DOTNET_CORE_HOST_HANDLE_DATA* result = (DOTNET_CORE_HOST_HANDLE_DATA*)moduleHandle;
 
-            /* Codes_SRS_DOTNET_CORE_04_020: [ DotNetCore_Receive shall call Message_ToByteArray to serialize message. ] */
-            int32_t size = Message_ToByteArray(messageHandle, NULL, 0); 
+            const unsigned char* buffer;
+            int32_t size;
 
-            if (size > 0)
+            /* Codes_SRS_DOTNET_CORE_04_020: [ DotNetCore_Receive shall call Message_GetSerialized to serialize message. ] */
+            if (Message_GetSerialized(messageHandle, &buffer, &size) == 0)
             {
-                unsigned char* buffer = (unsigned char*)malloc(size);
-
-                if (buffer != NULL)
+                try
                 {
-                    int32_t resultFromConversionToByteArray = Message_ToByteArray(messageHandle, buffer, size);
-
-                    if (resultFromConversionToByteArray > 0)
-                    {
-                        try
-                        {
-                            /* Codes_SRS_DOTNET_CORE_04_022: [ DotNetCore_Receive shall call Microsoft.Azure.Devices.Gateway.GatewayDelegatesGateway.Delegates_Receive C# method, implemented on Microsoft.Azure.Devices.Gateway.dll. ] */
-                            (*GatewayReceiveDelegate)(buffer, size, result->module_id);
-                        }
-                        catch (const std::exception& msgErr)
-                        {
-                            (void)msgErr;
-                            LogError("Exception Thrown. Error on calling Receive Delegate.");
-                        }
-                    }
-                    else
-                    {
-                        LogError("Unable to convert message to Byte Array");
-                    }
-
-                    delete(buffer);
+                    /* Codes_SRS_DOTNET_CORE_04_022: [ DotNetCore_Receive shall call Microsoft.Azure.Devices.Gateway.GatewayDelegatesGateway.Delegates_Receive C# method, implemented on Microsoft.Azure.Devices.Gateway.dll. ] */
+                    (*GatewayReceiveDelegate)(const_cast<unsigned char*>(buffer), size, result->module_id);
                 }
+                catch (const std::exception& msgErr)
+                {
+                    (void)msgErr;
+                    LogError("Exception Thrown. Error on calling Receive Delegate.");
+                }
+            }
+            else
+            {
+                LogError("Unable to convert message to Byte Array");
             }
         }
         else
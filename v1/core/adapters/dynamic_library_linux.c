@@ -1,6 +1,11 @@
 // Copyright (c) Microsoft. All rights reserved.
 // Licensed under the MIT license. See LICENSE file in the project root for full license information.
 
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include "azure_c_shared_utility/gballoc.h"
+
 #include "dynamic_library.h"
 #include "gb_library.h"
 
@@ -22,3 +27,26 @@ void* DynamicLibrary_FindSymbol(DYNAMIC_LIBRARY_HANDLE libraryHandle, const char
     return dlsym(libraryHandle, symbolName);
 }
 
+char* DynamicLibrary_GetCanonicalPath(const char* dynamicLibraryFileName)
+{
+    char* result;
+    char resolved[PATH_MAX];
+
+    if (dynamicLibraryFileName == NULL || realpath(dynamicLibraryFileName, resolved) == NULL)
+    {
+        /*Codes_SRS_DYNAMIC_LIBRARY_17_004: [DynamicLibrary_GetCanonicalPath shall return NULL if dynamicLibraryFileName is NULL or does not name an existing file.]*/
+        result = NULL;
+    }
+    else
+    {
+        /*Codes_SRS_DYNAMIC_LIBRARY_17_005: [DynamicLibrary_GetCanonicalPath shall return a newly allocated string holding the absolute path of dynamicLibraryFileName, which the caller frees.]*/
+        size_t length = strlen(resolved) + 1;
+        result = (char*)malloc(length);
+        if (result != NULL)
+        {
+            (void)memcpy(result, resolved, length);
+        }
+    }
+
+    return result;
+}
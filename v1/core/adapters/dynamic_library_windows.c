@@ -1,6 +1,9 @@
 // Copyright (c) Microsoft. All rights reserved.
 // Licensed under the MIT license. See LICENSE file in the project root for full license information.
 
+#include <stdlib.h>
+#include <string.h>
+#include "azure_c_shared_utility/gballoc.h"
 
 #include "gb_library.h"
 
@@ -83,3 +86,30 @@ void* DynamicLibrary_FindSymbol(DYNAMIC_LIBRARY_HANDLE libraryHandle, const char
     HMODULE hModule = (HMODULE)libraryHandle;
     return (void*)GetProcAddress(hModule, symbolName);
 }
+
+char* DynamicLibrary_GetCanonicalPath(const char* dynamicLibraryFileName)
+{
+    char* result;
+    char resolved[MAX_PATH];
+    DWORD length;
+
+    if (dynamicLibraryFileName == NULL ||
+        (length = GetFullPathNameA(dynamicLibraryFileName, MAX_PATH, resolved, NULL)) == 0 ||
+        length >= MAX_PATH ||
+        GetFileAttributesA(resolved) == INVALID_FILE_ATTRIBUTES)
+    {
+        /*Codes_SRS_DYNAMIC_LIBRARY_17_004: [DynamicLibrary_GetCanonicalPath shall return NULL if dynamicLibraryFileName is NULL or does not name an existing file.]*/
+        result = NULL;
+    }
+    else
+    {
+        /*Codes_SRS_DYNAMIC_LIBRARY_17_005: [DynamicLibrary_GetCanonicalPath shall return a newly allocated string holding the absolute path of dynamicLibraryFileName, which the caller frees.]*/
+        result = (char*)malloc(length + 1);
+        if (result != NULL)
+        {
+            (void)memcpy(result, resolved, length + 1);
+        }
+    }
+
+    return result;
+}
@@ -20,6 +20,7 @@ typedef struct BROKER_HANDLE_DATA_TAG* BROKER_HANDLE;
 #include "azure_c_shared_utility/macro_utils.h"
 #include "message.h"
 #include "module.h"
+#include "timer_service.h"
 #include "gateway_export.h"
 
 #ifdef __cplusplus
@@ -28,6 +29,7 @@ extern "C"
 {
 #else
 #include <stddef.h>
+#include <stdbool.h>
 #endif
 
 /** @brief    Link Data with #MODULE_HANDLE for source and sink. 
@@ -41,6 +43,86 @@ typedef struct BROKER_LINK_DATA_TAG {
     MODULE_HANDLE module_sink_handle;
 } BROKER_LINK_DATA;
 
+/** @brief    Number of buckets in #BROKER_MODULE_METRICS::latency_buckets. */
+#define BROKER_LATENCY_BUCKET_COUNT 32
+
+/** @brief    Counters the broker keeps for a module since it was added.
+*
+*    @details    All counters only ever grow, so the difference between two
+*                readings gives the activity in between.
+*                @c receive_elapsed_us, @c memory_live_bytes and
+*                @c memory_budget are not counters but the state of the
+*                module when it was read.
+*/
+typedef struct BROKER_MODULE_METRICS_TAG {
+    /** @brief    Messages delivered to the module's @c Module_Receive. */
+    size_t messages_received;
+    /** @brief    Messages that reached the module's thread but could not be
+    *            delivered, plus those the module reported dropping with
+    *            ::Broker_ReportDroppedMessages.
+    */
+    size_t messages_dropped;
+    /** @brief    Histogram of the time from ::Broker_Publish until the module's
+    *            @c Module_Receive returned. Bucket 0 counts deliveries under
+    *            1 microsecond and bucket @c i those under 2^i microseconds;
+    *            the last bucket also counts anything slower.
+    */
+    size_t latency_buckets[BROKER_LATENCY_BUCKET_COUNT];
+    /** @brief    How long the module's current @c Module_Receive call has been
+    *            running, in microseconds, or 0 when the module is idle.
+    */
+    uint64_t receive_elapsed_us;
+    /** @brief    Thread CPU time spent in the module's @c Module_Receive, in
+    *            microseconds. This includes messages the module published
+    *            from inside @c Module_Receive.
+    */
+    uint64_t receive_cpu_us;
+    /** @brief    Bytes charged to the module's memory account, see
+    *            module_memory.h.
+    */
+    size_t memory_live_bytes;
+    /** @brief    The budget set with ::Broker_SetModuleMemoryBudget, 0 if
+    *            there is none.
+    */
+    size_t memory_budget;
+    /** @brief    Messages the broker did not deliver or send because of the
+    *            settings of ::Broker_SetModuleShedding, published to the
+    *            module or by it.
+    */
+    size_t messages_shed;
+    /** @brief    Total time the delivered messages waited between
+    *            ::Broker_Publish and the start of the module's
+    *            @c Module_Receive, in microseconds. Divided by the
+    *            messages received in between, it gives the average time a
+    *            message queued for the module.
+    */
+    uint64_t queue_wait_us;
+} BROKER_MODULE_METRICS;
+
+/** @brief    What the broker sheds for a module, see
+*            ::Broker_SetModuleShedding.
+*/
+typedef struct BROKER_MODULE_SHEDDING_TAG {
+    /** @brief    Drop every message published to the module. */
+    bool drop_inbound;
+    /** @brief    Deliver only one in @c inbound_sample_every of the messages
+    *            published to the module; 0 or 1 delivers all of them.
+    */
+    size_t inbound_sample_every;
+    /** @brief    Drop every message the module publishes. */
+    bool pause_publishing;
+} BROKER_MODULE_SHEDDING;
+
+/** @brief    What became of the messages queued for a module, see
+*            ::Broker_DrainModule.
+*/
+typedef struct BROKER_MODULE_DRAIN_TAG {
+    /** @brief    Messages delivered to the module while it drained. */
+    size_t messages_drained;
+    /** @brief    Messages discarded once the deadline passed. */
+    size_t messages_abandoned;
+} BROKER_MODULE_DRAIN;
+
 #define BROKER_RESULT_VALUES \
     BROKER_OK, \
     BROKER_ERROR, \
@@ -144,6 +226,142 @@ GATEWAY_EXPORT BROKER_RESULT Broker_AddLink(BROKER_HANDLE broker, const BROKER_L
 */
 GATEWAY_EXPORT BROKER_RESULT Broker_RemoveLink(BROKER_HANDLE broker, const BROKER_LINK_DATA* link);
 
+/** @brief        Adds a route to a module from every other module of the
+*                message broker, including the modules added later.
+*
+*    @details    The route is one subscription of the sink to every topic, so
+*                adding or removing other modules does not change it. The
+*                sink does not receive its own messages unless it also has a
+*                link to itself.
+*
+*    @param        broker    The #BROKER_HANDLE the sink was added to.
+*    @param        sink      The #MODULE_HANDLE of the module that receives
+*                          the messages.
+*
+*    @return        A #BROKER_RESULT describing the result of the function.
+*/
+GATEWAY_EXPORT BROKER_RESULT Broker_AddAnySourceLink(BROKER_HANDLE broker, MODULE_HANDLE sink);
+
+/** @brief        Removes a route added by ::Broker_AddAnySourceLink.
+*
+*    @param        broker    The #BROKER_HANDLE the sink was added to.
+*    @param        sink      The #MODULE_HANDLE of the module that received
+*                          the messages.
+*
+*    @return        A #BROKER_RESULT describing the result of the function.
+*/
+GATEWAY_EXPORT BROKER_RESULT Broker_RemoveAnySourceLink(BROKER_HANDLE broker, MODULE_HANDLE sink);
+
+/** @brief        Reads the counters the broker keeps for a module.
+*
+*    @param        broker    The #BROKER_HANDLE the module was added to.
+*    @param        module    The #MODULE_HANDLE of the module.
+*    @param        metrics    Receives the counters of the module.
+*
+*    @return        A #BROKER_RESULT describing the result of the function.
+*/
+GATEWAY_EXPORT BROKER_RESULT Broker_GetModuleMetrics(BROKER_HANDLE broker, MODULE_HANDLE module, BROKER_MODULE_METRICS* metrics);
+
+/** @brief        Limits the memory a module may hold.
+*
+*    @details    While more than @p budget_bytes are charged to the module's
+*                memory account, the broker drops the messages published to
+*                the module and counts them in
+*                #BROKER_MODULE_METRICS::messages_dropped.
+*
+*    @param        broker          The #BROKER_HANDLE the module was added to.
+*    @param        module          The #MODULE_HANDLE of the module.
+*    @param        budget_bytes    The budget, or 0 to remove it.
+*
+*    @return        A #BROKER_RESULT describing the result of the function.
+*/
+GATEWAY_EXPORT BROKER_RESULT Broker_SetModuleMemoryBudget(BROKER_HANDLE broker, MODULE_HANDLE module, size_t budget_bytes);
+
+/** @brief        Counts messages a module dropped after it received them.
+*
+*    @details    A module that queues what it receives, and drops messages
+*                when its queue is full, reports them here so they show up in
+*                #BROKER_MODULE_METRICS::messages_dropped next to the messages
+*                the broker dropped for it.
+*
+*    @param        broker      The #BROKER_HANDLE the module was added to.
+*    @param        module      The #MODULE_HANDLE of the module, or the handle
+*                            set for it with ::Broker_SetModulePublisher.
+*    @param        count       The number of messages dropped.
+*
+*    @return        A #BROKER_RESULT describing the result of the function.
+*/
+GATEWAY_EXPORT BROKER_RESULT Broker_ReportDroppedMessages(BROKER_HANDLE broker, MODULE_HANDLE module, size_t count);
+
+/** @brief        Sheds load from a module.
+*
+*    @details    The module's thread drops the messages it sheds without
+*                calling @c Module_Receive, and ::Broker_Publish drops the
+*                messages of a paused module without sending them; both are
+*                counted in #BROKER_MODULE_METRICS::messages_shed. A publish
+*                that is dropped this way still returns #BROKER_OK.
+*
+*    @param        broker      The #BROKER_HANDLE the module was added to.
+*    @param        module      The #MODULE_HANDLE of the module.
+*    @param        shedding    What to shed; a zeroed #BROKER_MODULE_SHEDDING
+*                            sheds nothing.
+*
+*    @return        A #BROKER_RESULT describing the result of the function.
+*/
+GATEWAY_EXPORT BROKER_RESULT Broker_SetModuleShedding(BROKER_HANDLE broker, MODULE_HANDLE module, const BROKER_MODULE_SHEDDING* shedding);
+
+/** @brief        Routes what another handle publishes as a module's messages.
+*
+*    @details    ::Broker_Publish replaces @p publisher by @p module as the
+*                source of the messages it publishes, so they follow the links
+*                and the shedding of @p module. This lets a module stand in
+*                for one it creates later, such as a module that is only
+*                loaded once it is needed.
+*
+*    @param        broker       The #BROKER_HANDLE the module was added to.
+*    @param        module       The #MODULE_HANDLE of the module.
+*    @param        publisher    The handle that publishes for @p module, or
+*                             @c NULL to stop.
+*
+*    @return        A #BROKER_RESULT describing the result of the function.
+*/
+GATEWAY_EXPORT BROKER_RESULT Broker_SetModulePublisher(BROKER_HANDLE broker, MODULE_HANDLE module, MODULE_HANDLE publisher);
+
+/** @brief        Delivers the messages queued for a module, then stops
+*                delivering to it.
+*
+*    @details    The module's thread delivers the messages published to the
+*                module so far and exits. Once @p timeout_ms passed, it
+*                discards what is still queued instead. The module's
+*                publishing is then paused, so the modules it links to can be
+*                drained next. The module stays attached until
+*                ::Broker_RemoveModule, which must not be called meanwhile.
+*
+*    @param        broker        The #BROKER_HANDLE the module was added to.
+*    @param        module        The #MODULE_HANDLE of the module.
+*    @param        timeout_ms    How long to let the module drain.
+*    @param        drain         Receives the messages delivered and
+*                              abandoned.
+*
+*    @return        A #BROKER_RESULT describing the result of the function.
+*/
+GATEWAY_EXPORT BROKER_RESULT Broker_DrainModule(BROKER_HANDLE broker, MODULE_HANDLE module, unsigned int timeout_ms, BROKER_MODULE_DRAIN* drain);
+
+/** @brief        Gets the timer service the modules of the broker share.
+*
+*    @details    Modules schedule their periodic work on this service instead
+*                of running a thread of their own, see timer_service.h. The
+*                service is created on the first call and lives until the
+*                broker is destroyed, so modules must cancel their timers by
+*                the time they are destroyed.
+*
+*    @param        broker    The #BROKER_HANDLE the module was created with.
+*
+*    @return        The #TIMER_SERVICE_HANDLE of the broker, or @c NULL upon
+*                failure.
+*/
+GATEWAY_EXPORT TIMER_SERVICE_HANDLE Broker_GetTimerService(BROKER_HANDLE broker);
+
 /** @brief      Disposes of resources allocated by a message broker.
 *
 *    @param      broker  The #BROKER_HANDLE to be destroyed.
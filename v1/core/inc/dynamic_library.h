@@ -18,6 +18,7 @@ typedef void*  DYNAMIC_LIBRARY_HANDLE;
 MOCKABLE_FUNCTION(, GATEWAY_EXPORT DYNAMIC_LIBRARY_HANDLE, DynamicLibrary_LoadLibrary, const char*, dynamicLibraryFileName);
 MOCKABLE_FUNCTION(, GATEWAY_EXPORT void, DynamicLibrary_UnloadLibrary, DYNAMIC_LIBRARY_HANDLE, libraryHandle);
 MOCKABLE_FUNCTION(, GATEWAY_EXPORT void*, DynamicLibrary_FindSymbol, DYNAMIC_LIBRARY_HANDLE, libraryHandle, const char*, symbolName);
+MOCKABLE_FUNCTION(, GATEWAY_EXPORT char*, DynamicLibrary_GetCanonicalPath, const char*, dynamicLibraryFileName);
 
 #ifdef __cplusplus
 }
@@ -8,6 +8,8 @@
 #ifndef EVENT_SYSTEM_H
 #define EVENT_SYSTEM_H
 
+#include <stdint.h>
+
 #include "gateway.h"
 #include "gateway_export.h"
 
@@ -32,6 +34,159 @@ typedef struct GATEWAY_MODULE_INFO_TAG
     VECTOR_HANDLE module_sources;
 } GATEWAY_MODULE_INFO;
 
+/** @brief      Struct representing what a single module did since the
+ *              previous metrics snapshot
+ */
+typedef struct GATEWAY_MODULE_METRICS_TAG
+{
+    /** @brief  The name of the module */
+    const char* module_name;
+
+    /** @brief  Messages delivered to the module */
+    size_t messages_received;
+
+    /** @brief  Messages that reached the module but could not be delivered */
+    size_t messages_dropped;
+
+    /** @brief  Messages delivered to the module per second */
+    double messages_per_second;
+
+    /** @brief  Percentiles of the time from publication until the module's
+     *          @c Module_Receive returned, in microseconds. These are upper
+     *          bounds rounded up to a power of two, and 0 when nothing was
+     *          delivered.
+     */
+    uint64_t latency_p50_us;
+    uint64_t latency_p90_us;
+    uint64_t latency_p99_us;
+
+    /** @brief  Thread CPU time the module used in @c Module_Start and
+     *          @c Module_Receive, including what it published from them, in
+     *          microseconds
+     */
+    uint64_t cpu_time_us;
+
+    /** @brief  Bytes charged to the module's memory account when the
+     *          snapshot was taken, see module_memory.h
+     */
+    size_t memory_live_bytes;
+} GATEWAY_MODULE_METRICS;
+
+/** @brief      Struct representing a module whose @c Module_Receive call is
+ *              past the deadline
+ */
+typedef struct GATEWAY_STUCK_MODULE_TAG
+{
+    /** @brief  The name of the module */
+    const char* module_name;
+
+    /** @brief  How long the call had been running when the watchdog saw it,
+     *          in microseconds
+     */
+    uint64_t receive_elapsed_us;
+} GATEWAY_STUCK_MODULE;
+
+/** @brief      Struct representing a module that holds more memory than its
+ *              budget
+ */
+typedef struct GATEWAY_MODULE_MEMORY_TAG
+{
+    /** @brief  The name of the module */
+    const char* module_name;
+
+    /** @brief  Bytes charged to the module when the check saw it */
+    size_t live_bytes;
+
+    /** @brief  The budget set with #Gateway_SetModuleMemoryBudget */
+    size_t budget_bytes;
+} GATEWAY_MODULE_MEMORY;
+
+/** @brief      What a load shedding rule does to its module */
+typedef enum GATEWAY_SHEDDING_ACTION_TAG
+{
+    /** @brief  Drop every message published to the module */
+    GATEWAY_SHEDDING_DROP_INBOUND = 0,
+    /** @brief  Deliver only one in @c sample_every of the messages published
+     *          to the module
+     */
+    GATEWAY_SHEDDING_SAMPLE_INBOUND,
+    /** @brief  Drop every message the module publishes */
+    GATEWAY_SHEDDING_PAUSE_SOURCE
+} GATEWAY_SHEDDING_ACTION;
+
+/** @brief      Struct representing what to shed from one module once the
+ *              load shedding level reaches @c level
+ */
+typedef struct GATEWAY_SHEDDING_RULE_TAG
+{
+    /** @brief  The name of the module */
+    const char* module_name;
+
+    /** @brief  The lowest level the rule applies at, starting from 1. Rules of
+     *          less important modules get lower levels so they shed first.
+     */
+    unsigned int level;
+
+    /** @brief  What is shed */
+    GATEWAY_SHEDDING_ACTION action;
+
+    /** @brief  For #GATEWAY_SHEDDING_SAMPLE_INBOUND, one in how many
+     *          messages is still delivered; at least 2
+     */
+    size_t sample_every;
+} GATEWAY_SHEDDING_RULE;
+
+/** @brief      Struct representing the settings of the load shedding
+ *              controller, see #Gateway_SetLoadShedding
+ */
+typedef struct GATEWAY_LOAD_SHEDDING_TAG
+{
+    /** @brief  How often the load is checked, in milliseconds */
+    unsigned int check_interval_ms;
+
+    /** @brief  The average time messages may wait for any one module, in
+     *          milliseconds; 0 ignores queueing
+     */
+    unsigned int max_queue_delay_ms;
+
+    /** @brief  The CPU the process may use, 100 being one core kept busy;
+     *          0 ignores the CPU
+     */
+    unsigned int max_cpu_percent;
+
+    /** @brief  The bytes charged to all module memory accounts together;
+     *          0 ignores memory
+     */
+    size_t max_memory_bytes;
+
+    /** @brief  The rules, copied by #Gateway_SetLoadShedding */
+    const GATEWAY_SHEDDING_RULE* rules;
+
+    /** @brief  The number of @c rules */
+    size_t rule_count;
+} GATEWAY_LOAD_SHEDDING;
+
+/** @brief      Struct representing the last load shedding transition */
+typedef struct GATEWAY_LOAD_SHEDDING_STATE_TAG
+{
+    /** @brief  The level after the transition, 0 when nothing is shed */
+    unsigned int level;
+
+    /** @brief  The level before the transition */
+    unsigned int previous_level;
+
+    /** @brief  The longest average wait of the messages of a module when
+     *          the transition happened, in microseconds
+     */
+    uint64_t queue_delay_us;
+
+    /** @brief  The CPU the process used, 100 being one core kept busy */
+    unsigned int cpu_percent;
+
+    /** @brief  The bytes charged to all module memory accounts */
+    size_t memory_bytes;
+} GATEWAY_LOAD_SHEDDING_STATE;
+
 /** @brief      Enum representing different gateway events that have support
  *              for callbacks.
  */
@@ -45,13 +200,90 @@ typedef enum GATEWAY_EVENT_TAG
      *          gateway creation.
      *
      *  The VECTOR_HANDLE from #Gateway_GetModuleList will be provided as the
-     *  context to the callback, and be later cleaned-up automatically.
+     *  context to the callback, and be later cleaned-up automatically. The
+     *  list is only built while a callback is registered; callbacks that
+     *  only need what changed can register for #GATEWAY_MODULE_ADDED,
+     *  #GATEWAY_MODULE_REMOVED, #GATEWAY_LINK_ADDED and #GATEWAY_LINK_REMOVED
+     *  instead.
      */
     GATEWAY_MODULE_LIST_CHANGED,
 
     /** @brief  Called when the gateway is destroyed. */
     GATEWAY_DESTROYED,
 
+    /** @brief  Called every interval set with #Gateway_SetMetricsInterval.
+     *
+     *  The VECTOR_HANDLE from #Gateway_GetMetricsSnapshot will be provided as
+     *  the context to the callback, and be later cleaned-up automatically.
+     */
+    GATEWAY_METRICS_SNAPSHOT,
+
+    /** @brief  Called when a module spent longer in @c Module_Receive than
+     *          the deadline set with #Gateway_SetReceiveDeadline.
+     *
+     *  The VECTOR_HANDLE from #Gateway_GetStuckModules will be provided as
+     *  the context to the callback, and be later cleaned-up automatically.
+     */
+    GATEWAY_MODULE_STUCK,
+
+    /** @brief  Called when a module went over the budget set with
+     *          #Gateway_SetModuleMemoryBudget. The broker drops the messages
+     *          for the module until it is back under budget.
+     *
+     *  The VECTOR_HANDLE from #Gateway_GetModulesOverBudget will be provided
+     *  as the context to the callback, and be later cleaned-up automatically.
+     */
+    GATEWAY_MODULE_OVER_BUDGET,
+
+    /** @brief  Called when the controller set up with
+     *          #Gateway_SetLoadShedding moved to another shedding level.
+     *
+     *  The GATEWAY_LOAD_SHEDDING_STATE* from #Gateway_GetLoadSheddingState
+     *  will be provided as the context to the callback, and be later
+     *  cleaned-up automatically.
+     */
+    GATEWAY_LOAD_SHEDDING_CHANGED,
+
+    /** @brief  Called once, after the first #Gateway_Start started the
+     *          modules.
+     *
+     *  The JSON string from #Gateway_GetStartupReport will be provided as
+     *  the context to the callback, and be later cleaned-up automatically.
+     */
+    GATEWAY_STARTUP_REPORTED,
+
+    /** @brief  Called when a module was added to the gateway.
+     *
+     *  A copy of the name of the module, as a const char*, will be provided
+     *  as the context to the callback, and be later cleaned-up
+     *  automatically. Unlike #GATEWAY_MODULE_LIST_CHANGED this does not
+     *  snapshot the other modules, so the cost of the event does not grow
+     *  with the gateway.
+     */
+    GATEWAY_MODULE_ADDED,
+
+    /** @brief  Called when a module was removed from the gateway.
+     *
+     *  The links of the module are removed first and reported with
+     *  #GATEWAY_LINK_REMOVED. The context is the same as for
+     *  #GATEWAY_MODULE_ADDED.
+     */
+    GATEWAY_MODULE_REMOVED,
+
+    /** @brief  Called when a link was added to the gateway.
+     *
+     *  A copy of the #GATEWAY_LINK_ENTRY, with "*" as @c module_source for
+     *  links from every module, will be provided as the context to the
+     *  callback, and be later cleaned-up automatically.
+     */
+    GATEWAY_LINK_ADDED,
+
+    /** @brief  Called when a link was removed from the gateway.
+     *
+     *  The context is the same as for #GATEWAY_LINK_ADDED.
+     */
+    GATEWAY_LINK_REMOVED,
+
     /* @brief   Not an actual event, used to keep track of count of different
      *          events
      */
@@ -73,9 +305,30 @@ typedef void* GATEWAY_EVENT_CTX;
  */
 typedef void(*GATEWAY_CALLBACK)(GATEWAY_HANDLE gateway, GATEWAY_EVENT event_type, GATEWAY_EVENT_CTX context, void* user_param);
 
+/** @brief      How the event system runs the callbacks of reported events */
+typedef enum EVENTSYSTEM_DISPATCHER_TAG
+{
+    /** @brief  A callback thread is started for reported events and exits
+     *          once no events were reported for a while.
+     */
+    EVENTSYSTEM_DISPATCHER_ON_DEMAND = 0,
+
+    /** @brief  A single callback thread lives until the event system is
+     *          destroyed. Once the thread is started, events are queued
+     *          without locking. Back to back #GATEWAY_MODULE_LIST_CHANGED
+     *          events are delivered only once; their module lists are still
+     *          built when each event is reported, so this saves callback
+     *          runs, not snapshots.
+     */
+    EVENTSYSTEM_DISPATCHER_PERSISTENT
+} EVENTSYSTEM_DISPATCHER;
+
 EVENTSYSTEM_HANDLE EventSystem_Init(void);
+EVENTSYSTEM_HANDLE EventSystem_InitWithDispatcher(EVENTSYSTEM_DISPATCHER dispatcher);
 void EventSystem_AddEventCallback(EVENTSYSTEM_HANDLE event_system, GATEWAY_EVENT event_type, GATEWAY_CALLBACK callback, void* user_param);
 void EventSystem_ReportEvent(EVENTSYSTEM_HANDLE event_system, GATEWAY_HANDLE gw, GATEWAY_EVENT event_type);
+void EventSystem_ReportModuleEvent(EVENTSYSTEM_HANDLE event_system, GATEWAY_HANDLE gw, GATEWAY_EVENT event_type, const char* module_name);
+void EventSystem_ReportLinkEvent(EVENTSYSTEM_HANDLE event_system, GATEWAY_HANDLE gw, GATEWAY_EVENT event_type, const GATEWAY_LINK_ENTRY* link);
 void EventSystem_Destroy(EVENTSYSTEM_HANDLE event_system);
 
 /** @brief      Registers a function to be called on a callback thread when_all
@@ -113,6 +366,181 @@ VECTOR_HANDLE Gateway_GetModuleList(GATEWAY_HANDLE gw);
  */
 void Gateway_DestroyModuleList(VECTOR_HANDLE module_list);
 
+/** @brief      Starts, changes or stops the periodic
+ *              #GATEWAY_METRICS_SNAPSHOT event.
+ *
+ *  @param      gw          Pointer to a #GATEWAY_HANDLE that should report
+ *                          its metrics
+ *  @param      interval_ms How often the event fires, in milliseconds. 0
+ *                          stops it.
+ *
+ *  @return     0 on success, non-zero on failure.
+ */
+int Gateway_SetMetricsInterval(GATEWAY_HANDLE gw, unsigned int interval_ms);
+
+/** @brief      Starts, changes or stops the watchdog that reports
+ *              #GATEWAY_MODULE_STUCK.
+ *
+ *              The watchdog shares its thread with the metrics snapshots and
+ *              checks the modules twice per deadline. A blocked call is
+ *              reported once, however long it stays blocked.
+ *
+ *  @param      gw          Pointer to a #GATEWAY_HANDLE to watch
+ *  @param      deadline_ms How long a module may spend in a single
+ *                          @c Module_Receive call, in milliseconds. 0 stops
+ *                          the watchdog.
+ *
+ *  @return     0 on success, non-zero on failure.
+ */
+int Gateway_SetReceiveDeadline(GATEWAY_HANDLE gw, unsigned int deadline_ms);
+
+/** @brief      Returns the modules the watchdog last found past the deadline.
+ *
+ *              The vector handle should be later destroyed with
+ *              @c Gateway_DestroyStuckModules.
+ *
+ *  @param      gw      Pointer to a #GATEWAY_HANDLE whose modules are read
+ *
+ *  @return     A #VECTOR_HANDLE of #GATEWAY_STUCK_MODULE on success. NULL on
+ *              failure, or if the watchdog was never enabled.
+ */
+VECTOR_HANDLE Gateway_GetStuckModules(GATEWAY_HANDLE gw);
+
+/** @brief      Destroys the vector returned by @c Gateway_GetStuckModules
+ *
+ *  @param      stuck_modules   A vector handle as returned from
+ *              @c Gateway_GetStuckModules
+ */
+void Gateway_DestroyStuckModules(VECTOR_HANDLE stuck_modules);
+
+/** @brief      Sets how many bytes may be charged to a module before the
+ *              broker drops its messages and #GATEWAY_MODULE_OVER_BUDGET is
+ *              reported.
+ *
+ *              The budget is checked by the thread of the metrics snapshots,
+ *              once per second or twice per receive deadline, and a module
+ *              is reported once each time it goes over. Only messages and
+ *              blocks from @c ModuleMemory_Malloc are charged, see
+ *              module_memory.h.
+ *
+ *  @param      gw              Pointer to a #GATEWAY_HANDLE the module was
+ *                              added to
+ *  @param      module_name     The name of the module
+ *  @param      budget_bytes    The budget, 0 removes it
+ *
+ *  @return     0 on success, non-zero on failure.
+ */
+int Gateway_SetModuleMemoryBudget(GATEWAY_HANDLE gw, const char* module_name, size_t budget_bytes);
+
+/** @brief      Returns the modules the last check found over their memory
+ *              budget.
+ *
+ *              The vector handle should be later destroyed with
+ *              @c Gateway_DestroyModulesOverBudget.
+ *
+ *  @param      gw      Pointer to a #GATEWAY_HANDLE whose modules are read
+ *
+ *  @return     A #VECTOR_HANDLE of #GATEWAY_MODULE_MEMORY on success. NULL on
+ *              failure, or if no budget was ever set.
+ */
+VECTOR_HANDLE Gateway_GetModulesOverBudget(GATEWAY_HANDLE gw);
+
+/** @brief      Destroys the vector returned by @c Gateway_GetModulesOverBudget
+ *
+ *  @param      over_budget     A vector handle as returned from
+ *              @c Gateway_GetModulesOverBudget
+ */
+void Gateway_DestroyModulesOverBudget(VECTOR_HANDLE over_budget);
+
+/** @brief      Starts, changes or stops the load shedding controller.
+ *
+ *              The controller shares its thread with the metrics snapshots.
+ *              On every check it reads how long messages wait for each
+ *              module, the CPU the process used since the previous check and
+ *              the bytes charged to the module memory accounts. If any
+ *              reading is over its maximum, the shedding level goes up by
+ *              one, up to the highest level of the rules; once all readings
+ *              are under 80% of their maximum it goes down by one. Each
+ *              change is reported as #GATEWAY_LOAD_SHEDDING_CHANGED, and the
+ *              rules up to the current level are applied to their modules.
+ *              Setting new rules stops shedding and starts over at level 0.
+ *
+ *  @param      gw          Pointer to a #GATEWAY_HANDLE to control
+ *  @param      shedding    The settings, or NULL to stop the controller
+ *
+ *  @return     0 on success, non-zero on failure.
+ */
+int Gateway_SetLoadShedding(GATEWAY_HANDLE gw, const GATEWAY_LOAD_SHEDDING* shedding);
+
+/** @brief      Returns the last load shedding transition.
+ *
+ *              The state should be later destroyed with
+ *              @c Gateway_DestroyLoadSheddingState.
+ *
+ *  @param      gw      Pointer to a #GATEWAY_HANDLE whose controller is read
+ *
+ *  @return     A #GATEWAY_LOAD_SHEDDING_STATE on success. NULL on failure,
+ *              or if load shedding was never set up.
+ */
+GATEWAY_LOAD_SHEDDING_STATE* Gateway_GetLoadSheddingState(GATEWAY_HANDLE gw);
+
+/** @brief      Destroys the state returned by @c Gateway_GetLoadSheddingState
+ *
+ *  @param      state   A state as returned from
+ *              @c Gateway_GetLoadSheddingState
+ */
+void Gateway_DestroyLoadSheddingState(GATEWAY_LOAD_SHEDDING_STATE* state);
+
+/** @brief      Returns where the time to bring the gateway up went.
+ *
+ *              The report is a JSON object. @c total_us is the time from the
+ *              start of #Gateway_Create or #Gateway_CreateFromJson to the end
+ *              of the first #Gateway_Start. @c modules has, for every module
+ *              that start started, the time each step of bringing it up
+ *              took: @c parse_entrypoint_us, @c load_us,
+ *              @c parse_configuration_us, @c create_us, @c add_to_broker_us,
+ *              @c links_us and @c start_us. @c critical_path has the startup
+ *              phases in the order they ran, with the time each took; the
+ *              phases that run the modules in parallel also name the module
+ *              that took longest. All times are in microseconds. The string
+ *              should be later destroyed with @c Gateway_DestroyStartupReport.
+ *
+ *  @param      gw      Pointer to a #GATEWAY_HANDLE whose startup is read
+ *
+ *  @return     A JSON string on success. NULL on failure, or if the gateway
+ *              was not started yet.
+ */
+char* Gateway_GetStartupReport(GATEWAY_HANDLE gw);
+
+/** @brief      Destroys the string returned by @c Gateway_GetStartupReport
+ *
+ *  @param      report  A string as returned from
+ *              @c Gateway_GetStartupReport
+ */
+void Gateway_DestroyStartupReport(char* report);
+
+/** @brief      Returns what every module did since the previous snapshot.
+ *
+ *              The first snapshot covers the time since
+ *              @c Gateway_SetMetricsInterval was first called. The vector
+ *              handle should be later destroyed with
+ *              @c Gateway_DestroyMetricsSnapshot.
+ *
+ *  @param      gw      Pointer to a #GATEWAY_HANDLE whose metrics are read
+ *
+ *  @return     A #VECTOR_HANDLE of #GATEWAY_MODULE_METRICS on success. NULL
+ *              on failure, or if @c Gateway_SetMetricsInterval was never
+ *              called.
+ */
+VECTOR_HANDLE Gateway_GetMetricsSnapshot(GATEWAY_HANDLE gw);
+
+/** @brief      Destroys the vector returned by @c Gateway_GetMetricsSnapshot
+ *
+ *  @param      snapshot    A vector handle as returned from
+ *              @c Gateway_GetMetricsSnapshot
+ */
+void Gateway_DestroyMetricsSnapshot(VECTOR_HANDLE snapshot);
+
 #ifdef __cplusplus
 }
 #endif // __cplusplus
@@ -52,7 +52,8 @@ DEFINE_ENUM(GATEWAY_START_RESULT, GATEWAY_START_RESULT_VALUES);
     GATEWAY_UPDATE_FROM_JSON_INVALID_ARG, \
     GATEWAY_UPDATE_FROM_JSON_MEMORY
 
-/** @brief      Enumeration describing the result of ::Gateway_UpdateFromJson.
+/** @brief      Enumeration describing the result of ::Gateway_UpdateFromJson
+*               and ::Gateway_ReconcileFromJson.
 */
 DEFINE_ENUM(GATEWAY_UPDATE_FROM_JSON_RESULT, GATEWAY_UPDATE_FROM_JSON_RESULT_VALUES);
 
@@ -70,6 +71,9 @@ typedef struct GATEWAY_LINK_ENTRY_TAG
 /** @brief      Struct representing a particular gateway. */
 typedef struct GATEWAY_HANDLE_DATA_TAG* GATEWAY_HANDLE;
 
+/** @brief      Struct representing a watch on a gateway configuration file. */
+typedef struct GATEWAY_CONFIG_WATCHER_DATA_TAG* GATEWAY_CONFIG_WATCHER_HANDLE;
+
 /** @brief      Struct representing the loader and entrypoint
  *              to be used for a specific module.
  */
@@ -112,6 +116,21 @@ typedef struct GATEWAY_PROPERTIES_DATA_TAG
     VECTOR_HANDLE gateway_links;
 } GATEWAY_PROPERTIES;
 
+/** @brief      Struct representing what became of the messages queued for a
+ *              module when the gateway shut down, see #Gateway_Shutdown.
+ */
+typedef struct GATEWAY_MODULE_DRAIN_TAG
+{
+    /** @brief  The name of the module */
+    const char* module_name;
+
+    /** @brief  Messages delivered to the module while it drained */
+    size_t messages_drained;
+
+    /** @brief  Messages still queued for the module at the deadline */
+    size_t messages_abandoned;
+} GATEWAY_MODULE_DRAIN;
+
 /** @brief      Creates a gateway using a JSON configuration file as input
  *              which describes each module. Each module described in the
  *              configuration must support Module_CreateFromJson.
@@ -177,6 +196,63 @@ GATEWAY_EXPORT GATEWAY_HANDLE Gateway_CreateFromJson(const char* file_path);
  */
 GATEWAY_EXPORT GATEWAY_UPDATE_FROM_JSON_RESULT Gateway_UpdateFromJson(GATEWAY_HANDLE gw, const char* json_content);
 
+/** @brief      Brings a running gateway in line with a complete JSON
+ *              configuration, changing only what differs.
+ *
+ *  @details    Unlike ::Gateway_UpdateFromJson, @p json_content describes
+ *              every module and link the gateway shall have. Modules that are
+ *              not in it are removed, modules whose JSON object changed
+ *              (loader, entrypoint or args) are replaced and started, new
+ *              modules are added and started, and links are added and
+ *              removed to match. Modules and links that did not change keep
+ *              running and keep their queued messages. Modules the gateway
+ *              did not create from JSON count as changed.
+ *
+ *              New modules are created before anything is removed, so if
+ *              one of them fails the gateway is left as it was. A failure
+ *              later on leaves the changes made so far in place.
+ *
+ *              A module is given up to @c GATEWAY_RECONCILE_DRAIN_MS to
+ *              receive what was queued for it before it is removed or
+ *              replaced. A changed module whose replacement cannot be
+ *              created stays removed, the other ones are still replaced;
+ *              calling this function again retries it.
+ *
+ *  @param      gw              The #GATEWAY_HANDLE to reconfigure.
+ *  @param      json_content    The complete JSON configuration, in the format
+ *                              ::Gateway_CreateFromJson reads.
+ *
+ *  @return     A GATEWAY_UPDATE_FROM_JSON_RESULT with the operation result.
+ */
+GATEWAY_EXPORT GATEWAY_UPDATE_FROM_JSON_RESULT Gateway_ReconcileFromJson(GATEWAY_HANDLE gw, const char* json_content);
+
+/** @brief      Watches a JSON configuration file and reconciles the gateway
+ *              with it, using ::Gateway_ReconcileFromJson, each time the file
+ *              is written or moved into place.
+ *
+ *  @details    The file is watched with inotify on a thread of its own, so
+ *              this is only available on Linux builds with the
+ *              @c enable_config_watcher CMake option. A save that leaves the
+ *              content as it was does nothing. While the watch runs the
+ *              application shall not add or remove modules and links itself,
+ *              and it shall stop the watch before destroying the gateway.
+ *
+ *  @param      gw          The #GATEWAY_HANDLE to keep in line with the file.
+ *  @param      file_path   The JSON configuration file, usually the one the
+ *                          gateway was created from.
+ *
+ *  @return     A #GATEWAY_CONFIG_WATCHER_HANDLE, or @c NULL on failure or if
+ *              the gateway was built without the watcher.
+ */
+GATEWAY_EXPORT GATEWAY_CONFIG_WATCHER_HANDLE Gateway_WatchConfigFile(GATEWAY_HANDLE gw, const char* file_path);
+
+/** @brief      Stops a watch started by ::Gateway_WatchConfigFile and frees
+ *              it. A reconciliation in progress completes first.
+ *
+ *  @param      watcher     The #GATEWAY_CONFIG_WATCHER_HANDLE to stop.
+ */
+GATEWAY_EXPORT void Gateway_StopWatchingConfigFile(GATEWAY_CONFIG_WATCHER_HANDLE watcher);
+
 /** @brief      Creates a new gateway using the provided #GATEWAY_PROPERTIES.
  *
  *  @param      properties      #GATEWAY_PROPERTIES structure containing
@@ -201,6 +277,34 @@ GATEWAY_EXPORT GATEWAY_START_RESULT Gateway_Start(GATEWAY_HANDLE gw);
  */
 GATEWAY_EXPORT void Gateway_Destroy(GATEWAY_HANDLE gw);
 
+/** @brief      Delivers the messages queued in the gateway, then destroys it.
+ *
+ *              The modules are drained in the order of the links, each
+ *              after the modules that send it messages, so what a module
+ *              sends while it drains is delivered too. A module stops
+ *              publishing once it drained. The modules of a cycle are
+ *              drained in the order they were added. The messages still
+ *              queued at the deadline are discarded, and the gateway is
+ *              destroyed as with #Gateway_Destroy.
+ *
+ *  @param      gw                  #GATEWAY_HANDLE to be shut down.
+ *  @param      drain_timeout_ms    How long the modules may take to drain,
+ *                                  all together.
+ *
+ *  @return     A #VECTOR_HANDLE of #GATEWAY_MODULE_DRAIN, one per module in
+ *              the order they were drained, to be destroyed with
+ *              #Gateway_DestroyShutdownReport. NULL if @p gw is NULL or the
+ *              report could not be built; the gateway is destroyed anyway.
+ */
+GATEWAY_EXPORT VECTOR_HANDLE Gateway_Shutdown(GATEWAY_HANDLE gw, unsigned int drain_timeout_ms);
+
+/** @brief      Destroys the vector returned by #Gateway_Shutdown.
+ *
+ *  @param      report      A vector handle as returned from
+ *                          #Gateway_Shutdown.
+ */
+GATEWAY_EXPORT void Gateway_DestroyShutdownReport(VECTOR_HANDLE report);
+
 /** @brief      Creates a new module based on the GATEWAY_MODULES_ENTRY*.
  *
  *  @param      gw      Pointer to a #GATEWAY_HANDLE to add the Module onto.
@@ -0,0 +1,87 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+/** @file       gateway_trace.h
+*   @brief      Records what the message path of the gateway does, per thread,
+*               and writes it out in the Chrome trace event format.
+*
+*   @details    The trace points are compiled in only when the gateway is
+*               built with @c GATEWAY_TRACE_ENABLED (the @c enable_tracing
+*               CMake option); otherwise the macros below expand to nothing.
+*               Every thread records into a ring buffer of its own, so a trace
+*               point costs a clock read and a few stores and never locks. Once
+*               a ring buffer is full the oldest events are overwritten.
+*
+*               ::GatewayTrace_Dump writes the events of all threads to a file
+*               that can be loaded into chrome://tracing or Perfetto. A message
+*               shows up as a flow from the @c Broker_Publish call that sent
+*               it to the @c Module_Receive calls that received it.
+*/
+
+#ifndef GATEWAY_TRACE_H
+#define GATEWAY_TRACE_H
+
+#include "azure_c_shared_utility/umock_c_prod.h"
+#include "gateway_export.h"
+
+#ifdef __cplusplus
+#include <cstdint>
+extern "C"
+{
+#else
+#include <stdint.h>
+#endif
+
+#ifdef GATEWAY_TRACE_ENABLED
+
+/** @brief      Records an event on the ring buffer of the calling thread.
+*
+*   @param      name    A string literal; only the pointer is kept.
+*   @param      phase   The Chrome trace event phase: 'B', 'E', 'i', 's' or
+*                       'f'.
+*   @param      value   The flow id of 's' and 'f' events, a value shown with
+*                       the other ones.
+*/
+GATEWAY_EXPORT void GatewayTrace_Record(const char* name, char phase, uint64_t value);
+
+/** @brief      Hands the ring buffer of the calling thread to the next thread
+*               that starts recording. Its events stay in the trace until they
+*               are overwritten.
+*/
+GATEWAY_EXPORT void GatewayTrace_ReleaseThread(void);
+
+#define GATEWAY_TRACE_BEGIN(name, value) GatewayTrace_Record((name), 'B', (uint64_t)(value))
+#define GATEWAY_TRACE_END(name) GatewayTrace_Record((name), 'E', 0)
+#define GATEWAY_TRACE_INSTANT(name, value) GatewayTrace_Record((name), 'i', (uint64_t)(value))
+#define GATEWAY_TRACE_FLOW_START(name, id) GatewayTrace_Record((name), 's', (uint64_t)(id))
+#define GATEWAY_TRACE_FLOW_END(name, id) GatewayTrace_Record((name), 'f', (uint64_t)(id))
+#define GATEWAY_TRACE_THREAD_EXIT() GatewayTrace_ReleaseThread()
+
+#else
+
+#define GATEWAY_TRACE_BEGIN(name, value) ((void)0)
+#define GATEWAY_TRACE_END(name) ((void)0)
+#define GATEWAY_TRACE_INSTANT(name, value) ((void)0)
+#define GATEWAY_TRACE_FLOW_START(name, id) ((void)0)
+#define GATEWAY_TRACE_FLOW_END(name, id) ((void)0)
+#define GATEWAY_TRACE_THREAD_EXIT() ((void)0)
+
+#endif
+
+/** @brief      Writes the recorded events of all threads to @p file_path as a
+*               Chrome trace event JSON file.
+*
+*   @details    Threads may keep recording while the dump runs; events they
+*               write into the part of a ring buffer that is being dumped can
+*               come out torn.
+*
+*   @return     0 upon success, or a non-zero value if the file cannot be
+*               written or the gateway was built without tracing.
+*/
+MOCKABLE_FUNCTION(, GATEWAY_EXPORT int, GatewayTrace_Dump, const char*, file_path);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /*GATEWAY_TRACE_H*/
@@ -20,7 +20,10 @@
  *              lifetime is managed via the #Message_Clone and #Message_Destroy 
  *              APIs which atomically increment and decrement the reference 
  *              count respectively. #Message_Destroy deallocates the message 
- *              completely when the reference count becomes zero.
+ *              completely when the reference count becomes zero. The single
+ *              reference count of a message also covers its properties and
+ *              content, which may be borrowed through #Message_BorrowProperties
+ *              and #Message_BorrowContentHandle.
  */
 
 #ifndef MESSAGE_H
@@ -42,8 +45,15 @@
 #endif
 
 #define GATEWAY_MESSAGE_VERSION_1           0x01
+#define GATEWAY_MESSAGE_VERSION_2           0x02
 #define GATEWAY_MESSAGE_VERSION_CURRENT     GATEWAY_MESSAGE_VERSION_1
 
+/** @brief  The highest serialization version this library can read and write.
+ *          Serializations of any version up to this one are recognized by
+ *          #Message_CreateFromByteArray.
+ */
+#define GATEWAY_MESSAGE_VERSION_MAX         GATEWAY_MESSAGE_VERSION_2
+
 /** @brief  Struct representing a particular message. */
 typedef struct MESSAGE_HANDLE_DATA_TAG* MESSAGE_HANDLE;
 
@@ -109,7 +119,8 @@ MOCKABLE_FUNCTION(, GATEWAY_EXPORT MESSAGE_HANDLE, Message_Create, const MESSAGE
  *              containing the serialized form of a message.
  *
  *  @details    The newly created message shall have all the properties of the
- *              original message and the same content.
+ *              original message and the same content. The serialization
+ *              version is detected from the header of the byte array.
  *
  *  @param      source  Pointer to a byte array.
  *  @param      size    size in bytes of the array
@@ -136,6 +147,64 @@ MOCKABLE_FUNCTION(, GATEWAY_EXPORT MESSAGE_HANDLE, Message_CreateFromByteArray,
  */
 MOCKABLE_FUNCTION(, GATEWAY_EXPORT int32_t, Message_ToByteArray, MESSAGE_HANDLE, messageHandle, unsigned char *, buf, int32_t, size);
 
+/** @brief      Creates a byte array representation of a MESSAGE_HANDLE using
+ *              a specific serialization version.
+ *
+ *  @details    #Message_ToByteArray is equivalent to calling this function
+ *              with #GATEWAY_MESSAGE_VERSION_1. Version 2 is a compact
+ *              encoding meant for links where both ends are known to support
+ *              it, see @c proxy/message_format.md.
+ *
+ *  @param      messageHandle   A #MESSAGE_HANDLE. Must not be NULL.
+ *  @param      version         The serialization version, between
+ *                              #GATEWAY_MESSAGE_VERSION_1 and
+ *                              #GATEWAY_MESSAGE_VERSION_MAX.
+ *  @param      buf             A pointer to a byte array in memory, or NULL.
+ *  @param      size            An int32_t that specifies the size of buf.
+ *
+ *  @return     The same as #Message_ToByteArray.
+ */
+MOCKABLE_FUNCTION(, GATEWAY_EXPORT int32_t, Message_ToByteArrayWithVersion, MESSAGE_HANDLE, messageHandle, uint8_t, version, unsigned char *, buf, int32_t, size);
+
+/** @brief      Gets the serialized form of a message.
+ *
+ *  @details    The message is serialized (as by #Message_ToByteArray) the
+ *              first time this function is called and the result is cached on
+ *              the message, so publishing the same message to several
+ *              destinations serializes it only once. The returned buffer is
+ *              owned by the message: it must not be freed or modified and
+ *              remains valid for as long as the caller holds a reference to
+ *              the message. This function is safe to call from several
+ *              threads at once.
+ *
+ *  @param      message     The #MESSAGE_HANDLE to serialize.
+ *  @param      buffer      Receives a pointer to the serialized message.
+ *  @param      size        Receives the size in bytes of the serialized
+ *                          message.
+ *
+ *  @return     0 on success, a non-zero value upon failure.
+ */
+MOCKABLE_FUNCTION(, GATEWAY_EXPORT int, Message_GetSerialized, MESSAGE_HANDLE, message, const unsigned char **, buffer, int32_t *, size);
+
+/** @brief      Gets the serialized form of a message in a specific
+ *              serialization version.
+ *
+ *  @details    Behaves like #Message_GetSerialized, which is equivalent to
+ *              calling this function with #GATEWAY_MESSAGE_VERSION_1. Each
+ *              version is cached separately.
+ *
+ *  @param      message     The #MESSAGE_HANDLE to serialize.
+ *  @param      version     The serialization version, between
+ *                          #GATEWAY_MESSAGE_VERSION_1 and
+ *                          #GATEWAY_MESSAGE_VERSION_MAX.
+ *  @param      buffer      Receives a pointer to the serialized message.
+ *  @param      size        Receives the size in bytes of the serialized
+ *                          message.
+ *
+ *  @return     0 on success, a non-zero value upon failure.
+ */
+MOCKABLE_FUNCTION(, GATEWAY_EXPORT int, Message_GetSerializedWithVersion, MESSAGE_HANDLE, message, uint8_t, version, const unsigned char **, buffer, int32_t *, size);
+
 /** @brief      Creates a new message from a @c CONSTBUFFER source and
  *              @c MAP_HANDLE.
  *
@@ -153,6 +222,31 @@ MOCKABLE_FUNCTION(, GATEWAY_EXPORT int32_t, Message_ToByteArray, MESSAGE_HANDLE,
  */
 MOCKABLE_FUNCTION(, GATEWAY_EXPORT MESSAGE_HANDLE, Message_CreateFromBuffer, const MESSAGE_BUFFER_CONFIG *, cfg);
 
+/** @brief      Creates a new message that shares the content and properties
+ *              of an existing message, except for the properties it overrides
+ *              or removes.
+ *
+ *  @details    The new message keeps a reference to @c parent and stores only
+ *              the properties that differ from it, so the cost of creating it
+ *              does not depend on the number of properties of @c parent.
+ *              Property lookups with #Message_GetProperty resolve through the
+ *              overrides first, then the removed keys, then @c parent. A key
+ *              that is both overridden and removed is overridden. The message
+ *              is created with the reference count initialized to 1.
+ *
+ *  @param      parent          The #MESSAGE_HANDLE the new message derives
+ *                              from.
+ *  @param      overrides       The properties to add to or replace in
+ *                              @c parent, or @c NULL. The map is copied.
+ *  @param      removedKeys     A @c NULL terminated array of the property
+ *                              names of @c parent that the new message does
+ *                              not have, or @c NULL. The array is copied.
+ *
+ *  @return     A non-NULL #MESSAGE_HANDLE for the newly created message, or
+ *              @c NULL upon failure.
+ */
+MOCKABLE_FUNCTION(, GATEWAY_EXPORT MESSAGE_HANDLE, Message_CreateDerived, MESSAGE_HANDLE, parent, MAP_HANDLE, overrides, const char* const*, removedKeys);
+
 /** @brief      Creates a clone of the message.
  *
  *  @details    Since messages are immutable, this function only increments the 
@@ -179,6 +273,22 @@ MOCKABLE_FUNCTION(, GATEWAY_EXPORT MESSAGE_HANDLE, Message_Clone, MESSAGE_HANDLE
  */
 MOCKABLE_FUNCTION(, GATEWAY_EXPORT CONSTMAP_HANDLE, Message_GetProperties, MESSAGE_HANDLE, message);
 
+/** @brief      Gets the value of a single property of a message.
+ *
+ *  @details    Unlike #Message_GetProperties this function does not build the
+ *              property map of a message created by #Message_CreateDerived.
+ *              The returned string is owned by the message and remains valid
+ *              for as long as the caller holds a reference to the message.
+ *
+ *  @param      message     The #MESSAGE_HANDLE from which the property will be
+ *                          fetched.
+ *  @param      key         The name of the property.
+ *
+ *  @return     The value of the property, or @c NULL if the message has no
+ *              such property or upon failure.
+ */
+MOCKABLE_FUNCTION(, GATEWAY_EXPORT const char*, Message_GetProperty, MESSAGE_HANDLE, message, const char*, key);
+
 /** @brief      Gets the content of a message.
  *
  *  @details    The returned @c CONSTBUFFER need not be freed by the caller.
@@ -204,6 +314,36 @@ MOCKABLE_FUNCTION(, GATEWAY_EXPORT const CONSTBUFFER *, Message_GetContent, MESS
  */
 MOCKABLE_FUNCTION(, GATEWAY_EXPORT CONSTBUFFER_HANDLE, Message_GetContentHandle, MESSAGE_HANDLE, message);
 
+/** @brief      Gets the properties of a message without taking a reference on
+ *              them.
+ *
+ *  @details    The returned @c CONSTMAP handle is owned by the message. It must
+ *              not be destroyed and remains valid for as long as the caller
+ *              holds a reference to the message.
+ *
+ *  @param      message     The #MESSAGE_HANDLE from which properties will be
+ *                          fetched.
+ *
+ *  @return     A non-NULL @c CONSTMAP_HANDLE representing the properties of the
+ *              message, or @c NULL upon failure.
+ */
+MOCKABLE_FUNCTION(, GATEWAY_EXPORT CONSTMAP_HANDLE, Message_BorrowProperties, MESSAGE_HANDLE, message);
+
+/** @brief      Gets the @c CONSTBUFFER handle of the message content without
+ *              taking a reference on it.
+ *
+ *  @details    The returned handle is owned by the message. It must not be
+ *              destroyed and remains valid for as long as the caller holds a
+ *              reference to the message.
+ *
+ *  @param      message     The #MESSAGE_HANDLE from which the content will be
+ *                          fetched.
+ *
+ *  @return     A non-NULL @c CONSTBUFFER_HANDLE representing the message
+ *              content, or @c NULL upon failure.
+ */
+MOCKABLE_FUNCTION(, GATEWAY_EXPORT CONSTBUFFER_HANDLE, Message_BorrowContentHandle, MESSAGE_HANDLE, message);
+
 /** @brief      Disposes of resources allocated by the message.
  *       
  *  @param      message     The #MESSAGE_HANDLE to be destroyed.
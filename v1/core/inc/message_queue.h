@@ -21,18 +21,40 @@ extern "C"
 
 typedef struct MESSAGE_QUEUE_TAG* MESSAGE_QUEUE_HANDLE;
 
+/* receives each message removed by MESSAGE_QUEUE_drain, and owns it from then on */
+typedef void(*MESSAGE_QUEUE_DRAIN_CALLBACK)(void* context, MESSAGE_HANDLE message);
+
+/* returned by MESSAGE_QUEUE_push when a bounded queue has no free slot; other failures are positive */
+#define MESSAGE_QUEUE_FULL (-1)
+
 /* creation */
 MOCKABLE_FUNCTION(, MESSAGE_QUEUE_HANDLE, MESSAGE_QUEUE_create);
 
+/* a queue of at most capacity messages (rounded up to a power of two, at least 2) that any number of threads may push
+   onto without locking or allocating, and that a single thread pops from */
+MOCKABLE_FUNCTION(, MESSAGE_QUEUE_HANDLE, MESSAGE_QUEUE_create_bounded, size_t, capacity);
+
 /* destruction */
 MOCKABLE_FUNCTION(, void, MESSAGE_QUEUE_destroy, MESSAGE_QUEUE_HANDLE, handle);
 
 /* insertion */
 MOCKABLE_FUNCTION(, int, MESSAGE_QUEUE_push, MESSAGE_QUEUE_HANDLE, handle, MESSAGE_HANDLE, element);
 
+/* pushes all count elements next to each other, or none of them */
+MOCKABLE_FUNCTION(, int, MESSAGE_QUEUE_push_many, MESSAGE_QUEUE_HANDLE, handle, MESSAGE_HANDLE*, elements, size_t, count);
+
 /* removal */
 MOCKABLE_FUNCTION(, MESSAGE_HANDLE, MESSAGE_QUEUE_pop, MESSAGE_QUEUE_HANDLE, handle);
 
+/* like MESSAGE_QUEUE_pop, but sleeps up to timeout_ms (0 meaning no limit) for a message on an empty bounded queue */
+MOCKABLE_FUNCTION(, MESSAGE_HANDLE, MESSAGE_QUEUE_pop_wait, MESSAGE_QUEUE_HANDLE, handle, unsigned int, timeout_ms);
+
+/* pops up to max messages into messages without waiting, and returns how many it popped */
+MOCKABLE_FUNCTION(, size_t, MESSAGE_QUEUE_pop_batch, MESSAGE_QUEUE_HANDLE, handle, MESSAGE_HANDLE*, messages, size_t, max);
+
+/* hands every message currently queued to callback, oldest first, and returns how many it handed over */
+MOCKABLE_FUNCTION(, size_t, MESSAGE_QUEUE_drain, MESSAGE_QUEUE_HANDLE, handle, MESSAGE_QUEUE_DRAIN_CALLBACK, callback, void*, context);
+
 /* access */
 MOCKABLE_FUNCTION(, bool,  MESSAGE_QUEUE_is_empty, MESSAGE_QUEUE_HANDLE, handle);
 MOCKABLE_FUNCTION(, MESSAGE_HANDLE, MESSAGE_QUEUE_front, MESSAGE_QUEUE_HANDLE, handle);
@@ -76,7 +76,9 @@ extern "C"
 
     /** @brief      Creates an instance of a module.
      *
-     *  @details    This function must be implemented.
+     *  @details    This function must be implemented. The gateway may create
+     *              several modules at once on different threads, unless their
+     *              loader leaves MODULE_LOADER::parallel_create unset.
      *
      *  @param      broker          The #BROKER_HANDLE to which this module
      *                              will publish messages.
@@ -112,7 +114,8 @@ extern "C"
      *
      *  @details    This function is optional, but recommended. Messaging in
      *              the gateway is more predictable when modules delay
-     *              publishing until after this function is called.
+     *              publishing until after this function is called. Like
+     *              #Module_Create, it may run for several modules at once.
      *
      *  @param      moduleHandle    The target module's #MODULE_HANDLE.
      */
@@ -105,7 +105,8 @@ typedef struct MODULE_LOADER_API_TAG
     DOTNET,     \
     DOTNETCORE, \
     NODEJS,     \
-    OUTPROCESS     
+    OUTPROCESS, \
+    NATIVE_STATIC
 
 /**
  * @brief Enumeration listing all supported module loaders
@@ -131,6 +132,13 @@ typedef struct MODULE_LOADER_TAG
 
     /** @brief The module loader's' API implementation. */
     MODULE_LOADER_API*                  api;
+
+    /** @brief Whether modules of this loader may be created and started on
+     *         several threads at once. The gateway creates and starts the
+     *         modules of loaders that leave this false one at a time for each
+     *         loader type, see #ModuleLoader_LockModuleCalls. Loaders that
+     *         host a language runtime leave it false. */
+    bool                                parallel_create;
 } MODULE_LOADER;
 
 #define MODULE_LOADER_RESULT_VALUES \
@@ -183,6 +191,20 @@ MOCKABLE_FUNCTION(, MODULE_LOADER_RESULT, ModuleLoader_UpdateConfiguration,
     MODULE_LOADER_BASE_CONFIGURATION*, configuration
 );
 
+/**
+ * @brief Waits until no other module of a loader of the same type is being
+ *        created or started, and keeps it so until
+ *        #ModuleLoader_UnlockModuleCalls is called. Loaders of one type share
+ *        the runtime that hosts their modules, so they share the lock as well.
+ */
+MOCKABLE_FUNCTION(, MODULE_LOADER_RESULT, ModuleLoader_LockModuleCalls, const MODULE_LOADER*, loader);
+
+/**
+ * @brief Lets the next module of a loader of the same type be created or
+ *        started, after a call to #ModuleLoader_LockModuleCalls succeeded.
+ */
+MOCKABLE_FUNCTION(, void, ModuleLoader_UnlockModuleCalls, const MODULE_LOADER*, loader);
+
 /**
  * @brief Searches the module loader collection given the loader's name.
  */
@@ -33,6 +33,17 @@ typedef struct DYNAMIC_LOADER_ENTRYPOINT_TAG
     STRING_HANDLE moduleLibraryFileName;
 } DYNAMIC_LOADER_ENTRYPOINT;
 
+/** @brief      Creates the state shared by the modules loaded with the
+ *              dynamically linked module loader.
+ *
+ *  @return     #MODULE_LOADER_SUCCESS on success, #MODULE_LOADER_ERROR
+ *              otherwise.
+ */
+MOCKABLE_FUNCTION(, GATEWAY_EXPORT MODULE_LOADER_RESULT, DynamicLoader_Initialize);
+
+/** @brief      Frees the state created by #DynamicLoader_Initialize. */
+MOCKABLE_FUNCTION(, GATEWAY_EXPORT void, DynamicLoader_Deinitialize);
+
 /** @brief      The API for the dynamically linked module loader. */
 MOCKABLE_FUNCTION(, GATEWAY_EXPORT const MODULE_LOADER*, DynamicLoader_Get);
 
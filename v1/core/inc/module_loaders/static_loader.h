@@ -0,0 +1,97 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+/** @file       static_loader.h
+ *  @brief      Library for loading gateway modules that are statically linked
+ *              into the gateway executable.
+ *
+ *  @details    Modules built with BUILD_MODULE_TYPE_STATIC expose their API
+ *              through MODULE_STATIC_GETAPI. The executable registers those
+ *              functions by name at startup, usually through the
+ *              add_static_modules CMake function, and this loader looks them
+ *              up instead of loading a shared library.
+ */
+
+#ifndef STATIC_LOADER_H
+#define STATIC_LOADER_H
+
+#include "azure_c_shared_utility/strings.h"
+#include "azure_c_shared_utility/macro_utils.h"
+#include "azure_c_shared_utility/umock_c_prod.h"
+
+#include "module.h"
+#include "module_loader.h"
+#include "gateway_export.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#define STATIC_LOADER_NAME "static"
+
+/** @brief Structure to load a statically linked module */
+typedef struct STATIC_LOADER_ENTRYPOINT_TAG
+{
+    /** @brief name the module was registered with */
+    STRING_HANDLE moduleName;
+} STATIC_LOADER_ENTRYPOINT;
+
+/** @brief A statically linked module: its name and its Module_GetApi */
+typedef struct STATIC_LOADER_MODULE_TAG
+{
+    /** @brief name of the module in the "module.name" of the entrypoint */
+    const char* module_name;
+
+    /** @brief the MODULE_STATIC_GETAPI function of the module */
+    pfModule_GetApi get_api;
+} STATIC_LOADER_MODULE;
+
+/** @brief A table of statically linked modules, as registered with
+ *         StaticLoader_Register.
+ */
+typedef struct STATIC_LOADER_REGISTRY_TAG
+{
+    /** @brief the modules of the table */
+    const STATIC_LOADER_MODULE* modules;
+
+    /** @brief the number of modules in the table */
+    size_t count;
+
+    /** @brief set by StaticLoader_Register to chain the tables */
+    struct STATIC_LOADER_REGISTRY_TAG* next;
+} STATIC_LOADER_REGISTRY;
+
+/** @brief      Makes the modules of @p registry available to the static
+ *              loader.
+ *
+ *  @details    The registry is linked in as is and must outlive the gateway.
+ *              Registration is not thread safe: it is meant to happen before
+ *              main, through STATIC_LOADER_REGISTER. A name registered more
+ *              than once resolves to the module registered last.
+ */
+GATEWAY_EXPORT void StaticLoader_Register(STATIC_LOADER_REGISTRY* registry);
+
+/** @brief      The API for the statically linked module loader. */
+MOCKABLE_FUNCTION(, GATEWAY_EXPORT const MODULE_LOADER*, StaticLoader_Get);
+
+/** @brief      Registers the STATIC_LOADER_MODULE array @p modules with the
+ *              static loader before main runs.
+ */
+#if defined(_MSC_VER)
+#pragma section(".CRT$XCU", read)
+#define STATIC_LOADER_REGISTER(modules) \
+    static STATIC_LOADER_REGISTRY C2(modules, _registry) = { modules, sizeof(modules) / sizeof((modules)[0]), NULL }; \
+    static void __cdecl C2(modules, _register)(void) { StaticLoader_Register(&C2(modules, _registry)); } \
+    __declspec(allocate(".CRT$XCU")) void (__cdecl* C2(modules, _register_ptr))(void) = C2(modules, _register);
+#else
+#define STATIC_LOADER_REGISTER(modules) \
+    static STATIC_LOADER_REGISTRY C2(modules, _registry) = { modules, sizeof(modules) / sizeof((modules)[0]), NULL }; \
+    __attribute__((constructor)) static void C2(modules, _register)(void) { StaticLoader_Register(&C2(modules, _registry)); }
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // STATIC_LOADER_H
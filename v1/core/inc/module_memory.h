@@ -0,0 +1,103 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+/** @file       module_memory.h
+*   @brief      Charges memory to the module that is running on the calling
+*               thread.
+*
+*   @details    The broker gives every module an account and makes it the
+*               current account of the module's thread while a message is
+*               deserialized for the module and handed to its
+*               @c Module_Receive. Messages created while an account is current
+*               are charged to it until they are destroyed, so a module that
+*               holds on to messages shows up in its live bytes. Modules can
+*               charge their own buffers by allocating them with
+*               ::ModuleMemory_Malloc instead of @c malloc.
+*/
+
+#ifndef MODULE_MEMORY_H
+#define MODULE_MEMORY_H
+
+#include "azure_c_shared_utility/umock_c_prod.h"
+#include "gateway_export.h"
+
+#ifdef __cplusplus
+#include <cstddef>
+extern "C"
+{
+#else
+#include <stddef.h>
+#endif
+
+/** @brief    Handle to the memory account of a module. */
+typedef struct MODULE_MEMORY_TAG* MODULE_MEMORY_HANDLE;
+
+/** @brief      Creates an account with no live bytes and a reference count of 1.
+*
+*   @return     A valid #MODULE_MEMORY_HANDLE upon success, or @c NULL upon
+*               failure.
+*/
+MOCKABLE_FUNCTION(, GATEWAY_EXPORT MODULE_MEMORY_HANDLE, ModuleMemory_Create);
+
+/** @brief      Adds a reference to @p memory. */
+MOCKABLE_FUNCTION(, GATEWAY_EXPORT void, ModuleMemory_IncRef, MODULE_MEMORY_HANDLE, memory);
+
+/** @brief      Drops a reference to @p memory and frees the account with the
+*               last one. Every charge holds a reference, so the account lives
+*               until everything charged to it was released.
+*/
+MOCKABLE_FUNCTION(, GATEWAY_EXPORT void, ModuleMemory_DecRef, MODULE_MEMORY_HANDLE, memory);
+
+/** @brief      Makes @p memory the current account of the calling thread.
+*
+*   @details    The caller keeps its reference; the account must outlive the
+*               time it is current. @c NULL makes the thread charge nothing.
+*
+*   @return     The account that was current before, so it can be restored.
+*/
+MOCKABLE_FUNCTION(, GATEWAY_EXPORT MODULE_MEMORY_HANDLE, ModuleMemory_SetCurrent, MODULE_MEMORY_HANDLE, memory);
+
+/** @brief      Returns the current account of the calling thread, or @c NULL. */
+MOCKABLE_FUNCTION(, GATEWAY_EXPORT MODULE_MEMORY_HANDLE, ModuleMemory_GetCurrent);
+
+/** @brief      Charges @p size bytes to the current account of the calling
+*               thread.
+*
+*   @details    Never allocates.
+*
+*   @return     The charged account with a reference taken for the charge, to
+*               be handed to ::ModuleMemory_Release, or @c NULL when the
+*               thread has no current account.
+*/
+MOCKABLE_FUNCTION(, GATEWAY_EXPORT MODULE_MEMORY_HANDLE, ModuleMemory_Charge, size_t, size);
+
+/** @brief      Takes back a charge of @p size bytes and the reference it held.
+*               Does nothing if @p memory is @c NULL.
+*/
+MOCKABLE_FUNCTION(, GATEWAY_EXPORT void, ModuleMemory_Release, MODULE_MEMORY_HANDLE, memory, size_t, size);
+
+/** @brief      Returns the bytes currently charged to @p memory, or 0 if
+*               @p memory is @c NULL.
+*/
+MOCKABLE_FUNCTION(, GATEWAY_EXPORT size_t, ModuleMemory_GetLiveBytes, MODULE_MEMORY_HANDLE, memory);
+
+/** @brief      Allocates @p size bytes and charges them to the current account
+*               of the calling thread.
+*
+*   @details    The block stays charged to that account until it is freed
+*               with ::ModuleMemory_Free, whichever thread frees it.
+*
+*   @return     The block, or @c NULL upon failure.
+*/
+MOCKABLE_FUNCTION(, GATEWAY_EXPORT void*, ModuleMemory_Malloc, size_t, size);
+
+/** @brief      Frees a block returned by ::ModuleMemory_Malloc. Does nothing
+*               if @p ptr is @c NULL.
+*/
+MOCKABLE_FUNCTION(, GATEWAY_EXPORT void, ModuleMemory_Free, void*, ptr);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /*MODULE_MEMORY_H*/
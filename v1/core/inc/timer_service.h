@@ -0,0 +1,81 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+/** @file       timer_service.h
+*   @brief      Runs one-shot and periodic callbacks on a single shared thread.
+*
+*   @details    Modules that do periodic work schedule a timer instead of
+*               running a thread of their own; ::Broker_GetTimerService gives
+*               every module of a gateway the same service. Timers are kept in
+*               a hierarchical timer wheel with a resolution of one
+*               millisecond, so scheduling and cancelling cost the same however
+*               many timers there are. The thread sleeps until the next slot
+*               with timers in it and fires every timer that is due at once.
+*
+*               Callbacks run on the service thread, one after the other, so
+*               they should return quickly and must not destroy the service.
+*/
+
+#ifndef TIMER_SERVICE_H
+#define TIMER_SERVICE_H
+
+#include "azure_c_shared_utility/umock_c_prod.h"
+#include "gateway_export.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/** @brief    Handle to a timer service. */
+typedef struct TIMER_SERVICE_TAG* TIMER_SERVICE_HANDLE;
+
+/** @brief    Handle to a scheduled timer. */
+typedef struct TIMER_SERVICE_TIMER_TAG* TIMER_HANDLE;
+
+/** @brief    Function called on the service thread when a timer fires. */
+typedef void(*TIMER_CALLBACK)(void* context);
+
+/** @brief      Creates a timer service and starts its thread.
+*
+*   @return     A valid #TIMER_SERVICE_HANDLE upon success, or @c NULL upon
+*               failure.
+*/
+MOCKABLE_FUNCTION(, GATEWAY_EXPORT TIMER_SERVICE_HANDLE, TimerService_Create);
+
+/** @brief      Stops the service thread and frees the service.
+*
+*   @details    Timers that were not cancelled are freed without firing
+*               again; their handles become invalid.
+*/
+MOCKABLE_FUNCTION(, GATEWAY_EXPORT void, TimerService_Destroy, TIMER_SERVICE_HANDLE, service);
+
+/** @brief      Schedules @p callback to run on the service thread.
+*
+*   @param      service     The #TIMER_SERVICE_HANDLE to schedule on.
+*   @param      delay_ms    Milliseconds until the first call.
+*   @param      period_ms   Milliseconds between the following calls, or 0
+*                           for a one-shot timer. A periodic timer that falls
+*                           behind skips the calls it missed.
+*   @param      callback    The function to call.
+*   @param      context     Passed to @p callback.
+*
+*   @return     A #TIMER_HANDLE that must be released with
+*               ::TimerService_Cancel, also once a one-shot timer has fired,
+*               or @c NULL upon failure.
+*/
+MOCKABLE_FUNCTION(, GATEWAY_EXPORT TIMER_HANDLE, TimerService_Schedule, TIMER_SERVICE_HANDLE, service, unsigned int, delay_ms, unsigned int, period_ms, TIMER_CALLBACK, callback, void*, context);
+
+/** @brief      Cancels @p timer and frees it.
+*
+*   @details    Once this function returns the callback of @p timer does not
+*               run anymore; if it is running on another thread, the function
+*               waits for it to return. A callback may cancel its own timer.
+*/
+MOCKABLE_FUNCTION(, GATEWAY_EXPORT void, TimerService_Cancel, TIMER_SERVICE_HANDLE, service, TIMER_HANDLE, timer);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /*TIMER_SERVICE_H*/
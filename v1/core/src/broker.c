@@ -3,11 +3,13 @@
 
 #include <stdlib.h>
 #include <stdbool.h>
+#include <stdint.h>
 
 #include "azure_c_shared_utility/gballoc.h"
 #include "azure_c_shared_utility/vector.h"
 #include "azure_c_shared_utility/strings.h"
 #include "azure_c_shared_utility/lock.h"
+#include "azure_c_shared_utility/condition.h"
 #include "azure_c_shared_utility/threadapi.h"
 #include "azure_c_shared_utility/xlogging.h"
 #include "azure_c_shared_utility/refcount.h"
@@ -21,12 +23,26 @@
 #include "module.h"
 #include "module_access.h"
 #include "broker.h"
+#include "module_memory.h"
+#include "timer_service.h"
+#include "gateway_trace.h"
+#include "internal/gateway_clock.h"
+#include "internal/gateway_atomic.h"
 
 /* minimum size for a guid string, 36 characters + null terminator */
 #define BROKER_GUID_SIZE 37
 #define INPROC_URL_HEAD "inproc://"
 #define INPROC_URL_HEAD_SIZE 9
 #define URL_SIZE (INPROC_URL_HEAD_SIZE + BROKER_GUID_SIZE +1)
+/* the first byte of every frame sent on the publish socket says what the frame holds */
+#define BROKER_FRAME_MESSAGE 0x01
+#define BROKER_FRAME_QUIT 0x02
+#define BROKER_FRAME_TAG_SIZE 1
+/* a quit signal is the quit tag followed by the guid string of its module */
+#define BROKER_QUIT_FRAME_SIZE (BROKER_FRAME_TAG_SIZE + BROKER_GUID_SIZE)
+/* a message frame starts with the message tag and the source handle (the topic), followed by the publish time */
+#define BROKER_TOPIC_SIZE (BROKER_FRAME_TAG_SIZE + sizeof(MODULE_HANDLE))
+#define BROKER_FRAME_HEADER_SIZE (BROKER_TOPIC_SIZE + sizeof(uint64_t))
 
 /*The structure backing the message broker handle*/
 typedef struct BROKER_HANDLE_DATA_TAG
@@ -35,6 +51,12 @@ typedef struct BROKER_HANDLE_DATA_TAG
     LOCK_HANDLE             modules_lock;
     int                     publish_socket;
     STRING_HANDLE           url;
+    /** Shared by the modules, created on the first Broker_GetTimerService */
+    TIMER_SERVICE_HANDLE    timer_service;
+    /** Modules whose publishing is paused, so Broker_Publish only looks up the source when some are */
+    size_t                  paused_modules;
+    /** Modules that publish through another handle, so Broker_Publish only looks for publishers when some do */
+    size_t                  aliased_modules;
 }BROKER_HANDLE_DATA;
 
 DEFINE_REFCOUNT_TYPE(BROKER_HANDLE_DATA);
@@ -53,6 +75,50 @@ typedef struct BROKER_MODULEINFO_TAG
     LOCK_HANDLE     socket_lock;
     /** Guid sent to module worker thread to close task */
     STRING_HANDLE   quit_message_guid;
+    /** Counters for Broker_GetModuleMetrics, only written by the worker thread */
+    volatile size_t messages_received;
+    volatile size_t messages_dropped;
+    volatile size_t latency_buckets[BROKER_LATENCY_BUCKET_COUNT];
+    /** When the current Module_Receive call started, 0 while the worker is not inside it */
+    volatile uint64_t receive_started_us;
+    volatile uint64_t receive_cpu_us;
+    /** Account the module's messages and ModuleMemory_Malloc blocks are charged to */
+    MODULE_MEMORY_HANDLE memory;
+    /** Inbound messages are dropped while the account holds more than this, 0 means no budget */
+    volatile size_t memory_budget;
+    /** Set by Broker_SetModuleShedding */
+    volatile bool   drop_inbound;
+    volatile size_t inbound_sample_every;
+    bool            pause_publishing;
+    /** Inbound messages the worker shed and counted towards inbound_sample_every, only written by the worker thread */
+    volatile size_t messages_shed;
+    size_t          messages_sampled;
+    volatile uint64_t queue_wait_us;
+    /** Messages Broker_Publish dropped while publishing was paused, guarded by the broker's modules_lock */
+    size_t          publishes_shed;
+    /** Messages the module dropped itself, reported with Broker_ReportDroppedMessages, guarded by the modules_lock */
+    size_t          drops_reported;
+    /** Any-source links to the module, its receive socket is subscribed to every topic while this is not 0 */
+    volatile size_t any_source_links;
+    /** Links from the module to itself, so an any-source link does not hide the module's own messages from it */
+    volatile size_t self_links;
+    /** Set by Broker_SetModulePublisher, messages published by this handle are routed as the module's, guarded by the modules_lock */
+    MODULE_HANDLE   publisher;
+    /** Held by the module's attachment and by every Broker_DrainModule waiting on it, guarded by the modules_lock */
+    size_t          references;
+    /** Set by Broker_RemoveModule, guarded by the modules_lock */
+    bool            detached;
+    /** Guards worker_exited, drain_condition is signaled once the worker left its loop or a Module_Receive call a drain waits for returned */
+    LOCK_HANDLE     drain_lock;
+    COND_HANDLE     drain_condition;
+    bool            worker_exited;
+    /** 1 while the worker is inside Module_Receive, read by Broker_DrainModule with a full barrier */
+    volatile size_t receiving;
+    /** Set by Broker_DrainModule once its deadline passed, the worker then discards what is still queued */
+    volatile size_t abandon_queued;
+    /** Set while Broker_DrainModule waits for a Module_Receive call to return */
+    volatile size_t drain_waiting;
+    volatile size_t messages_abandoned;
 
 }BROKER_MODULEINFO;
 
@@ -123,6 +189,9 @@ BROKER_HANDLE Broker_Create(void)
     }
     else
     {
+        result->timer_service = NULL;
+        result->paused_modules = 0;
+        result->aliased_modules = 0;
         /*Codes_SRS_BROKER_13_007: [Broker_Create shall initialize BROKER_HANDLE_DATA::modules with a valid VECTOR_HANDLE.]*/
         result->modules = singlylinkedlist_create();
         if (result->modules == NULL)
@@ -208,11 +277,73 @@ void Broker_IncRef(BROKER_HANDLE broker)
     }
 }
 
+static size_t latency_bucket(uint64_t latency_us)
+{
+    size_t bucket = 0;
+    while (latency_us > 0 && bucket < BROKER_LATENCY_BUCKET_COUNT - 1)
+    {
+        latency_us >>= 1;
+        bucket++;
+    }
+    return bucket;
+}
+
+/*the worker writes 64 bit values that other threads read; such reads may tear on 32 bit targets, so read until two agree*/
+static uint64_t read_uint64(const volatile uint64_t* value)
+{
+    uint64_t result;
+    do
+    {
+        result = *value;
+    } while (result != *value);
+    return result;
+}
+
+/*any-source links subscribe to the tag alone*/
+static const unsigned char message_tag = BROKER_FRAME_MESSAGE;
+
+static void make_topic(unsigned char topic[BROKER_TOPIC_SIZE], MODULE_HANDLE source)
+{
+    topic[0] = BROKER_FRAME_MESSAGE;
+    memcpy(topic + BROKER_FRAME_TAG_SIZE, &source, sizeof(MODULE_HANDLE));
+}
+
+/*a module subscribed to every message also receives its own*/
+static bool is_own_message(const BROKER_MODULEINFO* module_info, const unsigned char* buf, int nbytes)
+{
+    bool result;
+    if (module_info->any_source_links == 0 || module_info->self_links != 0 ||
+        (size_t)nbytes < BROKER_TOPIC_SIZE || buf[0] != BROKER_FRAME_MESSAGE)
+    {
+        result = false;
+    }
+    else
+    {
+        MODULE_HANDLE source;
+        memcpy(&source, buf + BROKER_FRAME_TAG_SIZE, sizeof(MODULE_HANDLE));
+        result = (source == module_info->module->module_handle);
+    }
+    return result;
+}
+
 /**
 * This function runs for each module. It receives a pointer to a MODULE_INFO
 * object that describes the module. Its job is to call the Receive function on
 * the associated module whenever it receives a message.
 */
+static void signal_drain(BROKER_MODULEINFO* module_info)
+{
+    if (Lock(module_info->drain_lock) != LOCK_OK)
+    {
+        LogError("unable to Lock the drain lock, Broker_DrainModule waits for the worker to exit");
+    }
+    else
+    {
+        (void)Condition_Post(module_info->drain_condition);
+        (void)Unlock(module_info->drain_lock);
+    }
+}
+
 static int module_worker(void * user_data)
 {
     /*Codes_SRS_BROKER_13_026: [This function shall assign `user_data` to a local variable called `module_info` of type `BROKER_MODULEINFO*`.]*/
@@ -259,34 +390,120 @@ static int module_worker(void * user_data)
         }
         else
         {
-            if (nbytes == BROKER_GUID_SIZE &&
-                (strncmp(STRING_c_str(module_info->quit_message_guid), (const char *)buf, BROKER_GUID_SIZE-1)==0))
+            GATEWAY_TRACE_INSTANT("broker_dequeue", nbytes);
+            if (nbytes == BROKER_QUIT_FRAME_SIZE &&
+                (strncmp(STRING_c_str(module_info->quit_message_guid), (const char *)buf, BROKER_QUIT_FRAME_SIZE-1)==0))
             {
                 /*Codes_SRS_BROKER_13_068: [ This function shall run a loop that keeps running until module_info->quit_message_guid is sent to the thread. ]*/
                 /* received special quit message for this module */
                 should_continue = 0;
             }
+            else if (is_own_message(module_info, buf, nbytes))
+            {
+                /*Codes_SRS_BROKER_17_081: [ While the module has an any-source link and no link to itself, the function shall ignore its own messages. ]*/
+            }
+            else if (GATEWAY_ATOMIC_LOAD_SIZE(&module_info->abandon_queued) != 0)
+            {
+                /*Codes_SRS_BROKER_17_091: [ Once the deadline of Broker_DrainModule passed, the function shall discard the messages it receives and count them as abandoned. ]*/
+                module_info->messages_abandoned++;
+            }
+            else if ((size_t)nbytes < BROKER_FRAME_HEADER_SIZE || buf[0] != BROKER_FRAME_MESSAGE)
+            {
+                /*Codes_SRS_BROKER_17_044: [ The function shall count a received buffer that does not hold a valid message as a dropped message. ]*/
+                LogError("received a buffer that is not a message frame");
+                module_info->messages_dropped++;
+            }
+            else if (module_info->memory_budget > 0 && ModuleMemory_GetLiveBytes(module_info->memory) > module_info->memory_budget)
+            {
+                /*Codes_SRS_BROKER_17_057: [ While more bytes than the module's memory budget are charged to its account, the function shall drop the messages it receives and count them as dropped. ]*/
+                module_info->messages_dropped++;
+            }
+            else if (module_info->drop_inbound ||
+                (module_info->inbound_sample_every > 1 && module_info->messages_sampled++ % module_info->inbound_sample_every != 0))
+            {
+                /*Codes_SRS_BROKER_17_067: [ The function shall drop the messages its module sheds, all of them or all but one in inbound_sample_every, and count them as shed. ]*/
+                module_info->messages_shed++;
+            }
             else
             {
-                /*Codes_SRS_BROKER_17_024: [ The function shall strip off the topic from the message. ]*/
-                const unsigned char*buf_bytes = (const unsigned char*)buf;
+                /*Codes_SRS_BROKER_17_024: [ The function shall strip off the message tag and the topic from the message. ]*/
+                const unsigned char*buf_bytes = (const unsigned char*)buf + BROKER_FRAME_TAG_SIZE;
+                MODULE_HANDLE source;
+                uint64_t published_us;
+                memcpy(&source, buf_bytes, sizeof(MODULE_HANDLE));
                 buf_bytes += sizeof(MODULE_HANDLE);
+                memcpy(&published_us, buf_bytes, sizeof(uint64_t));
+                buf_bytes += sizeof(uint64_t);
+                /*Codes_SRS_BROKER_17_056: [ The function shall make the module's memory account current on its thread while it deserializes and delivers a message. ]*/
+                MODULE_MEMORY_HANDLE previous_memory = ModuleMemory_SetCurrent(module_info->memory);
                 /*Codes_SRS_BROKER_17_017: [ The function shall deserialize the message received. ]*/
-                MESSAGE_HANDLE msg = Message_CreateFromByteArray(buf_bytes, nbytes - sizeof(MODULE_HANDLE));
+                MESSAGE_HANDLE msg = Message_CreateFromByteArray(buf_bytes, nbytes - BROKER_FRAME_HEADER_SIZE);
                 /*Codes_SRS_BROKER_17_018: [ If the deserialization is not successful, the message loop shall continue. ]*/
-                if (msg != NULL)
+                if (msg == NULL)
                 {
-                    /*Codes_SRS_BROKER_13_092: [The function shall deliver the message to the module's callback function via module_info->module_apis. ]*/
-                    MODULE_RECEIVE(module_info->module->module_apis)(module_info->module->module_handle, msg);
+                    /*Codes_SRS_BROKER_17_044: [ The function shall count a received buffer that does not hold a valid message as a dropped message. ]*/
+                    module_info->messages_dropped++;
+                }
+                else
+                {
+                    /*announced before the deadline is checked again, so a drain past its deadline either waits for the call or the call sees the deadline*/
+                    GATEWAY_ATOMIC_STORE_SIZE(&module_info->receiving, 1);
+                    if (GATEWAY_ATOMIC_LOAD_SIZE(&module_info->abandon_queued) != 0)
+                    {
+                        /*Codes_SRS_BROKER_17_091: [ Once the deadline of Broker_DrainModule passed, the function shall discard the messages it receives and count them as abandoned. ]*/
+                        module_info->messages_abandoned++;
+                    }
+                    else
+                    {
+                        /*Codes_SRS_BROKER_17_052: [ The function shall record when each Module_Receive call starts and clear it once the call returns. ]*/
+                        uint64_t started_us = gateway_clock_now_us();
+                        module_info->receive_started_us = started_us;
+                        /*Codes_SRS_BROKER_17_068: [ The function shall add the time from the publication of each delivered message until its Module_Receive call started to the module's counters. ]*/
+                        module_info->queue_wait_us += started_us > published_us ? started_us - published_us : 0;
+                        uint64_t cpu_before_us = gateway_clock_thread_cpu_us();
+                        GATEWAY_TRACE_BEGIN("Module_Receive", nbytes - BROKER_FRAME_HEADER_SIZE);
+                        GATEWAY_TRACE_FLOW_END("message", (uint64_t)(uintptr_t)source ^ published_us);
+                        /*Codes_SRS_BROKER_13_092: [The function shall deliver the message to the module's callback function via module_info->module_apis. ]*/
+                        MODULE_RECEIVE(module_info->module->module_apis)(module_info->module->module_handle, msg);
+                        GATEWAY_TRACE_END("Module_Receive");
+                        /*Codes_SRS_BROKER_17_054: [ The function shall add the thread CPU time each Module_Receive call used to the module's counters. ]*/
+                        module_info->receive_cpu_us += gateway_clock_thread_cpu_us() - cpu_before_us;
+                        uint64_t now_us = gateway_clock_now_us();
+                        module_info->receive_started_us = 0;
+
+                        /*Codes_SRS_BROKER_17_045: [ The function shall count the delivered message and the time from its publication until Module_Receive returned. ]*/
+                        module_info->latency_buckets[latency_bucket(now_us > published_us ? now_us - published_us : 0)]++;
+                        module_info->messages_received++;
+                    }
+                    /*the barriers of both stores and loads make sure that either Broker_DrainModule sees the call returned, or the worker sees it waits*/
+                    GATEWAY_ATOMIC_STORE_SIZE(&module_info->receiving, 0);
+                    if (GATEWAY_ATOMIC_LOAD_SIZE(&module_info->drain_waiting) != 0)
+                    {
+                        /*Codes_SRS_BROKER_17_102: [ The function shall signal the drain condition once a Module_Receive call that Broker_DrainModule waits for returned. ]*/
+                        signal_drain(module_info);
+                    }
                     /*Codes_SRS_BROKER_13_093: [ The function shall destroy the message that was dequeued by calling Message_Destroy. ]*/
                     Message_Destroy(msg);
                 }
+                (void)ModuleMemory_SetCurrent(previous_memory);
             }
             /*Codes_SRS_BROKER_17_019: [ The function shall free the buffer received on the receive_socket. ]*/
             nn_freemsg(buf);
         }    
     }
 
+    /*Codes_SRS_BROKER_17_099: [ Once it left its loop, the function shall set worker_exited under the drain_lock and signal the drain condition. ]*/
+    if (Lock(module_info->drain_lock) != LOCK_OK)
+    {
+        LogError("unable to Lock the drain lock, Broker_DrainModule waits for its deadline");
+    }
+    else
+    {
+        module_info->worker_exited = true;
+        (void)Condition_Post(module_info->drain_condition);
+        (void)Unlock(module_info->drain_lock);
+    }
+    GATEWAY_TRACE_THREAD_EXIT();
     return 0;
 }
 
@@ -305,6 +522,29 @@ static BROKER_RESULT init_module(BROKER_MODULEINFO* module_info, const MODULE* m
     {
         module_info->module->module_apis = module->module_apis;
         module_info->module->module_handle = module->module_handle;
+        module_info->messages_received = 0;
+        module_info->messages_dropped = 0;
+        memset((void*)module_info->latency_buckets, 0, sizeof(module_info->latency_buckets));
+        module_info->receive_started_us = 0;
+        module_info->receive_cpu_us = 0;
+        module_info->drop_inbound = false;
+        module_info->inbound_sample_every = 0;
+        module_info->pause_publishing = false;
+        module_info->publisher = NULL;
+        module_info->messages_shed = 0;
+        module_info->messages_sampled = 0;
+        module_info->queue_wait_us = 0;
+        module_info->publishes_shed = 0;
+        module_info->drops_reported = 0;
+        module_info->any_source_links = 0;
+        module_info->self_links = 0;
+        module_info->references = 1;
+        module_info->detached = false;
+        module_info->worker_exited = false;
+        module_info->receiving = 0;
+        module_info->abandon_queued = 0;
+        module_info->drain_waiting = 0;
+        module_info->messages_abandoned = 0;
 
         /*Codes_SRS_BROKER_13_099: [The function shall initialize BROKER_MODULEINFO::socket_lock with a valid lock handle.]*/
         module_info->socket_lock = Lock_Init();
@@ -316,10 +556,11 @@ static BROKER_RESULT init_module(BROKER_MODULEINFO* module_info, const MODULE* m
         }
         else
         {
-            char uuid[BROKER_GUID_SIZE];
-            memset(uuid, 0, BROKER_GUID_SIZE);
+            char quit_frame[BROKER_QUIT_FRAME_SIZE];
+            memset(quit_frame, 0, BROKER_QUIT_FRAME_SIZE);
+            quit_frame[0] = BROKER_FRAME_QUIT;
             /*Codes_SRS_BROKER_17_020: [ The function shall create a unique ID used as a quit signal. ]*/
-            if (UniqueId_Generate(uuid, BROKER_GUID_SIZE) != UNIQUEID_OK)
+            if (UniqueId_Generate(quit_frame + BROKER_FRAME_TAG_SIZE, BROKER_GUID_SIZE) != UNIQUEID_OK)
             {
                 /*Codes_SRS_BROKER_13_047: [ This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise. ]*/
                 LogError("Lock_Init for socket lock failed");
@@ -328,7 +569,7 @@ static BROKER_RESULT init_module(BROKER_MODULEINFO* module_info, const MODULE* m
             }
             else
             {
-                module_info->quit_message_guid = STRING_construct(uuid);
+                module_info->quit_message_guid = STRING_construct(quit_frame);
                 if (module_info->quit_message_guid == NULL)
                 {
                     /*Codes_SRS_BROKER_13_047: [ This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise. ]*/
@@ -338,7 +579,41 @@ static BROKER_RESULT init_module(BROKER_MODULEINFO* module_info, const MODULE* m
                 }
                 else
                 {
-                    result = BROKER_OK;
+                    /*Codes_SRS_BROKER_17_055: [ The function shall create a memory account for the module with no budget. ]*/
+                    module_info->memory = ModuleMemory_Create();
+                    module_info->memory_budget = 0;
+                    if (module_info->memory == NULL)
+                    {
+                        /*Codes_SRS_BROKER_13_047: [ This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise. ]*/
+                        LogError("Failed to create the module memory account");
+                        Lock_Deinit(module_info->socket_lock);
+                        STRING_delete(module_info->quit_message_guid);
+                        result = BROKER_ERROR;
+                    }
+                    /*Codes_SRS_BROKER_17_100: [ The function shall create the drain_lock and the drain condition of the module. ]*/
+                    else if ((module_info->drain_lock = Lock_Init()) == NULL)
+                    {
+                        /*Codes_SRS_BROKER_13_047: [ This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise. ]*/
+                        LogError("Lock_Init for the drain lock failed");
+                        ModuleMemory_DecRef(module_info->memory);
+                        Lock_Deinit(module_info->socket_lock);
+                        STRING_delete(module_info->quit_message_guid);
+                        result = BROKER_ERROR;
+                    }
+                    else if ((module_info->drain_condition = Condition_Init()) == NULL)
+                    {
+                        /*Codes_SRS_BROKER_13_047: [ This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise. ]*/
+                        LogError("Condition_Init for the drain condition failed");
+                        Lock_Deinit(module_info->drain_lock);
+                        ModuleMemory_DecRef(module_info->memory);
+                        Lock_Deinit(module_info->socket_lock);
+                        STRING_delete(module_info->quit_message_guid);
+                        result = BROKER_ERROR;
+                    }
+                    else
+                    {
+                        result = BROKER_OK;
+                    }
                 }
             }
         }
@@ -346,11 +621,24 @@ static BROKER_RESULT init_module(BROKER_MODULEINFO* module_info, const MODULE* m
     return result;
 }
 
+/*drops a reference to module_info, under the modules_lock once it is attached; the last one frees what deinit_module left*/
+static void release_module_info(BROKER_MODULEINFO* module_info)
+{
+    if (--module_info->references == 0)
+    {
+        Condition_Deinit(module_info->drain_condition);
+        Lock_Deinit(module_info->drain_lock);
+        free(module_info);
+    }
+}
+
 static void deinit_module(BROKER_MODULEINFO* module_info)
 {
     /*Codes_SRS_BROKER_13_057: [The function shall free all members of the MODULE_INFO object.]*/
     Lock_Deinit(module_info->socket_lock);
     STRING_delete(module_info->quit_message_guid);
+    /*messages still charged to the account keep it alive*/
+    ModuleMemory_DecRef(module_info->memory);
     free(module_info->module);
 }
 
@@ -381,7 +669,7 @@ static BROKER_RESULT start_module(BROKER_MODULEINFO* module_info, STRING_HANDLE
         }
         else
         {
-            /* Codes_SRS_BROKER_17_028: [ The function shall subscribe BROKER_MODULEINFO::receive_socket to the quit signal GUID. ]*/
+            /* Codes_SRS_BROKER_17_028: [ The function shall subscribe BROKER_MODULEINFO::receive_socket to the quit tag followed by the quit signal GUID. ]*/
             if (nn_setsockopt(
                 module_info->receive_socket, NN_SUB, NN_SUB_SUBSCRIBE, STRING_c_str(module_info->quit_message_guid), STRING_length(module_info->quit_message_guid)) < 0)
             {
@@ -422,9 +710,9 @@ static int stop_module(int publish_socket, BROKER_MODULEINFO* module_info)
 {
     int  quit_result, close_result, thread_result, result;
 
-    /*Codes_SRS_BROKER_17_021: [ This function shall send a quit signal to the worker thread by sending BROKER_MODULEINFO::quit_message_guid to the publish_socket. ]*/
+    /*Codes_SRS_BROKER_17_021: [ This function shall send a quit signal to the worker thread by sending the quit tag and BROKER_MODULEINFO::quit_message_guid to the publish_socket. ]*/
     /* send the unique quite id for this module */
-    if ((quit_result = nn_really_send(publish_socket, STRING_c_str(module_info->quit_message_guid), BROKER_GUID_SIZE, 0)) < 0)
+    if ((quit_result = nn_really_send(publish_socket, STRING_c_str(module_info->quit_message_guid), BROKER_QUIT_FRAME_SIZE, 0)) < 0)
     {
         /*Codes_SRS_BROKER_17_015: [ This function shall close the BROKER_MODULEINFO::receive_socket. ]*/
         /* at the cost of a data race, we will close the socket to terminate the thread */
@@ -516,7 +804,7 @@ BROKER_RESULT Broker_AddModule(BROKER_HANDLE broker, const MODULE* module)
                     /*Codes_SRS_BROKER_13_047: [This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise.]*/
                     LogError("Lock on broker_data->modules_lock failed");
                     deinit_module(module_info);
-                    free(module_info);
+                    release_module_info(module_info);
                     result = BROKER_ERROR;
                 }
                 else
@@ -528,7 +816,7 @@ BROKER_RESULT Broker_AddModule(BROKER_HANDLE broker, const MODULE* module)
                         /*Codes_SRS_BROKER_13_047: [This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise.]*/
                         LogError("singlylinkedlist_add failed");
                         deinit_module(module_info);
-                        free(module_info);
+                        release_module_info(module_info);
                         result = BROKER_ERROR;
                     }
                     else
@@ -538,7 +826,7 @@ BROKER_RESULT Broker_AddModule(BROKER_HANDLE broker, const MODULE* module)
                             LogError("start_module failed");
                             deinit_module(module_info);
                             singlylinkedlist_remove(broker_data->modules, moduleListItem);
-                            free(module_info);
+                            release_module_info(module_info);
                             result = BROKER_ERROR;
                         }
                         else
@@ -607,10 +895,20 @@ BROKER_RESULT Broker_RemoveModule(BROKER_HANDLE broker, const MODULE* module)
                 {
                     LogError("unable to stop module");
                 }
+                if (module_info->pause_publishing)
+                {
+                    broker_data->paused_modules--;
+                }
+                if (module_info->publisher != NULL)
+                {
+                    broker_data->aliased_modules--;
+                }
 
                 /*Codes_SRS_BROKER_13_052: [The function shall remove the module from BROKER_HANDLE_DATA::modules.]*/
                 singlylinkedlist_remove(broker_data->modules, module_info_item);
-                free(module_info);
+                /*a Broker_DrainModule waiting on the module frees it once it is done*/
+                module_info->detached = true;
+                release_module_info(module_info);
 
                 /*Codes_SRS_BROKER_13_053: [This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise.]*/
                 result = BROKER_OK;
@@ -643,6 +941,18 @@ BROKER_MODULEINFO* broker_locate_handle(BROKER_HANDLE_DATA* broker_data, MODULE_
     return result;
 }
 
+static bool find_publisher_predicate(LIST_ITEM_HANDLE list_item, const void* value)
+{
+    BROKER_MODULEINFO* element = (BROKER_MODULEINFO*)singlylinkedlist_item_get_value(list_item);
+    return element->publisher == (MODULE_HANDLE)value;
+}
+
+static BROKER_MODULEINFO* broker_locate_publisher(BROKER_HANDLE_DATA* broker_data, MODULE_HANDLE publisher)
+{
+    LIST_ITEM_HANDLE module_info_item = singlylinkedlist_find(broker_data->modules, find_publisher_predicate, publisher);
+    return (module_info_item == NULL) ? NULL : (BROKER_MODULEINFO*)singlylinkedlist_item_get_value(module_info_item);
+}
+
 BROKER_RESULT Broker_AddLink(BROKER_HANDLE broker, const BROKER_LINK_DATA* link)
 {
     BROKER_RESULT result;
@@ -685,9 +995,11 @@ BROKER_RESULT Broker_AddLink(BROKER_HANDLE broker, const BROKER_LINK_DATA* link)
                 }
                 else
                 {
-                    /*Codes_SRS_BROKER_17_032: [ Broker_AddLink shall subscribe module_info->receive_socket to the link->source module handle. ]*/
+                    /*Codes_SRS_BROKER_17_032: [ Broker_AddLink shall subscribe module_info->receive_socket to the message tag followed by the link->source module handle. ]*/
+                    unsigned char topic[BROKER_TOPIC_SIZE];
+                    make_topic(topic, link->module_source_handle);
                     if (nn_setsockopt(
-                        module_info->receive_socket, NN_SUB, NN_SUB_SUBSCRIBE, &(link->module_source_handle), sizeof(MODULE_HANDLE)) < 0)
+                        module_info->receive_socket, NN_SUB, NN_SUB_SUBSCRIBE, topic, BROKER_TOPIC_SIZE) < 0)
                     {
                         /*Codes_SRS_BROKER_17_034: [ Upon an error, Broker_AddLink shall return BROKER_ADD_LINK_ERROR ]*/
                         LogError("Unable to make link in Broker");
@@ -695,6 +1007,10 @@ BROKER_RESULT Broker_AddLink(BROKER_HANDLE broker, const BROKER_LINK_DATA* link)
                     }
                     else
                     {
+                        if (module_info == source_module)
+                        {
+                            module_info->self_links++;
+                        }
                         result = BROKER_OK;
                     }
                 }
@@ -747,9 +1063,11 @@ BROKER_RESULT Broker_RemoveLink(BROKER_HANDLE broker, const BROKER_LINK_DATA* li
                 }
                 else
                 {
-                    /*Codes_SRS_BROKER_17_038: [ Broker_RemoveLink shall unsubscribe module_info->receive_socket from the link->module_source_handle module handle. ]*/
+                    /*Codes_SRS_BROKER_17_038: [ Broker_RemoveLink shall unsubscribe module_info->receive_socket from the message tag followed by the link->module_source_handle module handle. ]*/
+                    unsigned char topic[BROKER_TOPIC_SIZE];
+                    make_topic(topic, link->module_source_handle);
                     if (nn_setsockopt(
-                        module_info->receive_socket, NN_SUB, NN_SUB_UNSUBSCRIBE, &(link->module_source_handle), sizeof(MODULE_HANDLE)) < 0)
+                        module_info->receive_socket, NN_SUB, NN_SUB_UNSUBSCRIBE, topic, BROKER_TOPIC_SIZE) < 0)
                     {
                         /*Codes_SRS_BROKER_17_040: [ Upon an error, Broker_RemoveLink shall return BROKER_REMOVE_LINK_ERROR. ]*/
                         LogError("Unable to make link in Broker");
@@ -757,6 +1075,10 @@ BROKER_RESULT Broker_RemoveLink(BROKER_HANDLE broker, const BROKER_LINK_DATA* li
                     }
                     else
                     {
+                        if (module_info == source_module_info && module_info->self_links > 0)
+                        {
+                            module_info->self_links--;
+                        }
                         result = BROKER_OK;
                     }
                 }
@@ -768,6 +1090,491 @@ BROKER_RESULT Broker_RemoveLink(BROKER_HANDLE broker, const BROKER_LINK_DATA* li
     return result;
 }
 
+BROKER_RESULT Broker_AddAnySourceLink(BROKER_HANDLE broker, MODULE_HANDLE sink)
+{
+    BROKER_RESULT result;
+    /*Codes_SRS_BROKER_17_075: [ If broker or sink are NULL, Broker_AddAnySourceLink shall return BROKER_INVALIDARG. ]*/
+    if (broker == NULL || sink == NULL)
+    {
+        LogError("Broker_AddAnySourceLink, input is NULL.");
+        result = BROKER_INVALIDARG;
+    }
+    else
+    {
+        BROKER_HANDLE_DATA* broker_data = (BROKER_HANDLE_DATA*)broker;
+        /*Codes_SRS_BROKER_17_076: [ Broker_AddAnySourceLink shall find the module_info for sink while holding the modules_lock. ]*/
+        if (Lock(broker_data->modules_lock) != LOCK_OK)
+        {
+            /*Codes_SRS_BROKER_17_078: [ Upon an error, Broker_AddAnySourceLink shall return BROKER_ADD_LINK_ERROR. ]*/
+            LogError("Broker_AddAnySourceLink, Lock on broker_data->modules_lock failed");
+            result = BROKER_ADD_LINK_ERROR;
+        }
+        else
+        {
+            BROKER_MODULEINFO* module_info = broker_locate_handle(broker_data, sink);
+            if (module_info == NULL)
+            {
+                /*Codes_SRS_BROKER_17_078: [ Upon an error, Broker_AddAnySourceLink shall return BROKER_ADD_LINK_ERROR. ]*/
+                LogError("sink is not attached to the broker");
+                result = BROKER_ADD_LINK_ERROR;
+            }
+            /*Codes_SRS_BROKER_17_077: [ When sink gets its first any-source link, Broker_AddAnySourceLink shall subscribe module_info->receive_socket to the message tag, so to every message but no quit signal. ]*/
+            else if (module_info->any_source_links == 0 &&
+                nn_setsockopt(module_info->receive_socket, NN_SUB, NN_SUB_SUBSCRIBE, &message_tag, BROKER_FRAME_TAG_SIZE) < 0)
+            {
+                /*Codes_SRS_BROKER_17_078: [ Upon an error, Broker_AddAnySourceLink shall return BROKER_ADD_LINK_ERROR. ]*/
+                LogError("Unable to make any-source link in Broker");
+                result = BROKER_ADD_LINK_ERROR;
+            }
+            else
+            {
+                module_info->any_source_links++;
+                result = BROKER_OK;
+            }
+            Unlock(broker_data->modules_lock);
+        }
+    }
+    return result;
+}
+
+BROKER_RESULT Broker_RemoveAnySourceLink(BROKER_HANDLE broker, MODULE_HANDLE sink)
+{
+    BROKER_RESULT result;
+    /*Codes_SRS_BROKER_17_079: [ If broker or sink are NULL, Broker_RemoveAnySourceLink shall return BROKER_INVALIDARG. ]*/
+    if (broker == NULL || sink == NULL)
+    {
+        LogError("Broker_RemoveAnySourceLink, input is NULL.");
+        result = BROKER_INVALIDARG;
+    }
+    else
+    {
+        BROKER_HANDLE_DATA* broker_data = (BROKER_HANDLE_DATA*)broker;
+        if (Lock(broker_data->modules_lock) != LOCK_OK)
+        {
+            /*Codes_SRS_BROKER_17_080: [ Upon an error, Broker_RemoveAnySourceLink shall return BROKER_REMOVE_LINK_ERROR. ]*/
+            LogError("Broker_RemoveAnySourceLink, Lock on broker_data->modules_lock failed");
+            result = BROKER_REMOVE_LINK_ERROR;
+        }
+        else
+        {
+            BROKER_MODULEINFO* module_info = broker_locate_handle(broker_data, sink);
+            if (module_info == NULL || module_info->any_source_links == 0)
+            {
+                /*Codes_SRS_BROKER_17_080: [ Upon an error, Broker_RemoveAnySourceLink shall return BROKER_REMOVE_LINK_ERROR. ]*/
+                LogError("sink is not attached to the broker or has no any-source link");
+                result = BROKER_REMOVE_LINK_ERROR;
+            }
+            /*Codes_SRS_BROKER_17_082: [ When the last any-source link of sink is removed, Broker_RemoveAnySourceLink shall unsubscribe module_info->receive_socket from the message tag. ]*/
+            else if (module_info->any_source_links == 1 &&
+                nn_setsockopt(module_info->receive_socket, NN_SUB, NN_SUB_UNSUBSCRIBE, &message_tag, BROKER_FRAME_TAG_SIZE) < 0)
+            {
+                /*Codes_SRS_BROKER_17_080: [ Upon an error, Broker_RemoveAnySourceLink shall return BROKER_REMOVE_LINK_ERROR. ]*/
+                LogError("Unable to remove any-source link in Broker");
+                result = BROKER_REMOVE_LINK_ERROR;
+            }
+            else
+            {
+                module_info->any_source_links--;
+                result = BROKER_OK;
+            }
+            Unlock(broker_data->modules_lock);
+        }
+    }
+    return result;
+}
+
+BROKER_RESULT Broker_GetModuleMetrics(BROKER_HANDLE broker, MODULE_HANDLE module, BROKER_MODULE_METRICS* metrics)
+{
+    BROKER_RESULT result;
+    /*Codes_SRS_BROKER_17_046: [ If broker, module or metrics are NULL, Broker_GetModuleMetrics shall return BROKER_INVALIDARG. ]*/
+    if (broker == NULL || module == NULL || metrics == NULL)
+    {
+        LogError("Broker_GetModuleMetrics, input is NULL.");
+        result = BROKER_INVALIDARG;
+    }
+    else
+    {
+        BROKER_HANDLE_DATA* broker_data = (BROKER_HANDLE_DATA*)broker;
+        /*Codes_SRS_BROKER_17_047: [ Broker_GetModuleMetrics shall lock the modules_lock. ]*/
+        if (Lock(broker_data->modules_lock) != LOCK_OK)
+        {
+            /*Codes_SRS_BROKER_17_050: [ Upon an error, Broker_GetModuleMetrics shall return BROKER_ERROR. ]*/
+            LogError("Broker_GetModuleMetrics, Lock on broker_data->modules_lock failed");
+            result = BROKER_ERROR;
+        }
+        else
+        {
+            /*Codes_SRS_BROKER_17_048: [ Broker_GetModuleMetrics shall find the module_info for module. ]*/
+            BROKER_MODULEINFO* module_info = broker_locate_handle(broker_data, module);
+            if (module_info == NULL)
+            {
+                /*Codes_SRS_BROKER_17_050: [ Upon an error, Broker_GetModuleMetrics shall return BROKER_ERROR. ]*/
+                LogError("module is not attached to the broker");
+                result = BROKER_ERROR;
+            }
+            else
+            {
+                /*Codes_SRS_BROKER_17_049: [ Broker_GetModuleMetrics shall copy the counters of the module into metrics. ]*/
+                /* the worker keeps counting while we copy, so the copy may be a few messages behind */
+                metrics->messages_received = module_info->messages_received;
+                metrics->messages_dropped = module_info->messages_dropped + module_info->drops_reported;
+                for (size_t i = 0; i < BROKER_LATENCY_BUCKET_COUNT; i++)
+                {
+                    metrics->latency_buckets[i] = module_info->latency_buckets[i];
+                }
+                /*Codes_SRS_BROKER_17_053: [ Broker_GetModuleMetrics shall set receive_elapsed_us to the time spent in the current Module_Receive call, or 0 if there is none. ]*/
+                uint64_t started_us = read_uint64(&module_info->receive_started_us);
+                uint64_t now_us = started_us == 0 ? 0 : gateway_clock_now_us();
+                metrics->receive_elapsed_us = now_us > started_us ? now_us - started_us : 0;
+                metrics->receive_cpu_us = read_uint64(&module_info->receive_cpu_us);
+                /*Codes_SRS_BROKER_17_058: [ Broker_GetModuleMetrics shall set memory_live_bytes to the bytes charged to the module's memory account and memory_budget to its budget. ]*/
+                metrics->memory_live_bytes = ModuleMemory_GetLiveBytes(module_info->memory);
+                metrics->memory_budget = module_info->memory_budget;
+                /*Codes_SRS_BROKER_17_069: [ Broker_GetModuleMetrics shall set messages_shed to the messages shed for and by the module and queue_wait_us to the time its delivered messages waited. ]*/
+                metrics->messages_shed = module_info->messages_shed + module_info->publishes_shed;
+                metrics->queue_wait_us = read_uint64(&module_info->queue_wait_us);
+                result = BROKER_OK;
+            }
+            /*Codes_SRS_BROKER_17_051: [ Broker_GetModuleMetrics shall unlock the modules_lock. ]*/
+            Unlock(broker_data->modules_lock);
+        }
+    }
+    return result;
+}
+
+BROKER_RESULT Broker_SetModuleMemoryBudget(BROKER_HANDLE broker, MODULE_HANDLE module, size_t budget_bytes)
+{
+    BROKER_RESULT result;
+    /*Codes_SRS_BROKER_17_059: [ If broker or module is NULL, Broker_SetModuleMemoryBudget shall return BROKER_INVALIDARG. ]*/
+    if (broker == NULL || module == NULL)
+    {
+        LogError("Broker_SetModuleMemoryBudget, input is NULL.");
+        result = BROKER_INVALIDARG;
+    }
+    else
+    {
+        BROKER_HANDLE_DATA* broker_data = (BROKER_HANDLE_DATA*)broker;
+        /*Codes_SRS_BROKER_17_060: [ Broker_SetModuleMemoryBudget shall find the module_info for module under the modules_lock. ]*/
+        if (Lock(broker_data->modules_lock) != LOCK_OK)
+        {
+            /*Codes_SRS_BROKER_17_062: [ Upon an error, Broker_SetModuleMemoryBudget shall return BROKER_ERROR. ]*/
+            LogError("Broker_SetModuleMemoryBudget, Lock on broker_data->modules_lock failed");
+            result = BROKER_ERROR;
+        }
+        else
+        {
+            BROKER_MODULEINFO* module_info = broker_locate_handle(broker_data, module);
+            if (module_info == NULL)
+            {
+                /*Codes_SRS_BROKER_17_062: [ Upon an error, Broker_SetModuleMemoryBudget shall return BROKER_ERROR. ]*/
+                LogError("module is not attached to the broker");
+                result = BROKER_ERROR;
+            }
+            else
+            {
+                /*Codes_SRS_BROKER_17_061: [ Broker_SetModuleMemoryBudget shall set the memory budget of the module to budget_bytes, 0 meaning no budget, and return BROKER_OK. ]*/
+                module_info->memory_budget = budget_bytes;
+                result = BROKER_OK;
+            }
+            Unlock(broker_data->modules_lock);
+        }
+    }
+    return result;
+}
+
+BROKER_RESULT Broker_ReportDroppedMessages(BROKER_HANDLE broker, MODULE_HANDLE module, size_t count)
+{
+    BROKER_RESULT result;
+    /*Codes_SRS_BROKER_17_095: [ If broker or module is NULL, Broker_ReportDroppedMessages shall return BROKER_INVALIDARG. ]*/
+    if (broker == NULL || module == NULL)
+    {
+        LogError("Broker_ReportDroppedMessages, input is NULL.");
+        result = BROKER_INVALIDARG;
+    }
+    else
+    {
+        BROKER_HANDLE_DATA* broker_data = (BROKER_HANDLE_DATA*)broker;
+        /*Codes_SRS_BROKER_17_096: [ Broker_ReportDroppedMessages shall find the module_info for module, or for the module module publishes for, under the modules_lock. ]*/
+        if (Lock(broker_data->modules_lock) != LOCK_OK)
+        {
+            /*Codes_SRS_BROKER_17_098: [ Upon an error, Broker_ReportDroppedMessages shall return BROKER_ERROR. ]*/
+            LogError("Broker_ReportDroppedMessages, Lock on broker_data->modules_lock failed");
+            result = BROKER_ERROR;
+        }
+        else
+        {
+            BROKER_MODULEINFO* module_info = broker_locate_handle(broker_data, module);
+            if (module_info == NULL && broker_data->aliased_modules > 0)
+            {
+                module_info = broker_locate_publisher(broker_data, module);
+            }
+            if (module_info == NULL)
+            {
+                /*Codes_SRS_BROKER_17_098: [ Upon an error, Broker_ReportDroppedMessages shall return BROKER_ERROR. ]*/
+                LogError("module is not attached to the broker");
+                result = BROKER_ERROR;
+            }
+            else
+            {
+                /*Codes_SRS_BROKER_17_097: [ Broker_ReportDroppedMessages shall add count to the messages the module dropped and return BROKER_OK. ]*/
+                module_info->drops_reported += count;
+                result = BROKER_OK;
+            }
+            Unlock(broker_data->modules_lock);
+        }
+    }
+    return result;
+}
+
+BROKER_RESULT Broker_SetModuleShedding(BROKER_HANDLE broker, MODULE_HANDLE module, const BROKER_MODULE_SHEDDING* shedding)
+{
+    BROKER_RESULT result;
+    /*Codes_SRS_BROKER_17_070: [ If broker, module or shedding is NULL, Broker_SetModuleShedding shall return BROKER_INVALIDARG. ]*/
+    if (broker == NULL || module == NULL || shedding == NULL)
+    {
+        LogError("Broker_SetModuleShedding, input is NULL.");
+        result = BROKER_INVALIDARG;
+    }
+    else
+    {
+        BROKER_HANDLE_DATA* broker_data = (BROKER_HANDLE_DATA*)broker;
+        /*Codes_SRS_BROKER_17_071: [ Broker_SetModuleShedding shall find the module_info for module under the modules_lock. ]*/
+        if (Lock(broker_data->modules_lock) != LOCK_OK)
+        {
+            /*Codes_SRS_BROKER_17_073: [ Upon an error, Broker_SetModuleShedding shall return BROKER_ERROR. ]*/
+            LogError("Broker_SetModuleShedding, Lock on broker_data->modules_lock failed");
+            result = BROKER_ERROR;
+        }
+        else
+        {
+            BROKER_MODULEINFO* module_info = broker_locate_handle(broker_data, module);
+            if (module_info == NULL)
+            {
+                /*Codes_SRS_BROKER_17_073: [ Upon an error, Broker_SetModuleShedding shall return BROKER_ERROR. ]*/
+                LogError("module is not attached to the broker");
+                result = BROKER_ERROR;
+            }
+            else
+            {
+                /*Codes_SRS_BROKER_17_072: [ Broker_SetModuleShedding shall copy shedding into the module_info and return BROKER_OK. ]*/
+                module_info->drop_inbound = shedding->drop_inbound;
+                module_info->inbound_sample_every = shedding->inbound_sample_every;
+                if (module_info->pause_publishing != shedding->pause_publishing)
+                {
+                    module_info->pause_publishing = shedding->pause_publishing;
+                    if (shedding->pause_publishing)
+                    {
+                        broker_data->paused_modules++;
+                    }
+                    else
+                    {
+                        broker_data->paused_modules--;
+                    }
+                }
+                result = BROKER_OK;
+            }
+            Unlock(broker_data->modules_lock);
+        }
+    }
+    return result;
+}
+
+BROKER_RESULT Broker_SetModulePublisher(BROKER_HANDLE broker, MODULE_HANDLE module, MODULE_HANDLE publisher)
+{
+    BROKER_RESULT result;
+    /*Codes_SRS_BROKER_17_083: [ If broker or module is NULL, Broker_SetModulePublisher shall return BROKER_INVALIDARG. ]*/
+    if (broker == NULL || module == NULL)
+    {
+        LogError("Broker_SetModulePublisher, input is NULL.");
+        result = BROKER_INVALIDARG;
+    }
+    else
+    {
+        BROKER_HANDLE_DATA* broker_data = (BROKER_HANDLE_DATA*)broker;
+        /*Codes_SRS_BROKER_17_084: [ Broker_SetModulePublisher shall find the module_info for module under the modules_lock. ]*/
+        if (Lock(broker_data->modules_lock) != LOCK_OK)
+        {
+            /*Codes_SRS_BROKER_17_086: [ Upon an error, Broker_SetModulePublisher shall return BROKER_ERROR. ]*/
+            LogError("Broker_SetModulePublisher, Lock on broker_data->modules_lock failed");
+            result = BROKER_ERROR;
+        }
+        else
+        {
+            BROKER_MODULEINFO* module_info = broker_locate_handle(broker_data, module);
+            if (module_info == NULL)
+            {
+                /*Codes_SRS_BROKER_17_086: [ Upon an error, Broker_SetModulePublisher shall return BROKER_ERROR. ]*/
+                LogError("module is not attached to the broker");
+                result = BROKER_ERROR;
+            }
+            else
+            {
+                /*Codes_SRS_BROKER_17_085: [ Broker_SetModulePublisher shall set publisher as the publisher of module, NULL removing it, and return BROKER_OK. ]*/
+                if (module_info->publisher == NULL && publisher != NULL)
+                {
+                    broker_data->aliased_modules++;
+                }
+                else if (module_info->publisher != NULL && publisher == NULL)
+                {
+                    broker_data->aliased_modules--;
+                }
+                module_info->publisher = publisher;
+                result = BROKER_OK;
+            }
+            Unlock(broker_data->modules_lock);
+        }
+    }
+    return result;
+}
+
+BROKER_RESULT Broker_DrainModule(BROKER_HANDLE broker, MODULE_HANDLE module, unsigned int timeout_ms, BROKER_MODULE_DRAIN* drain)
+{
+    BROKER_RESULT result;
+    /*Codes_SRS_BROKER_17_088: [ If broker, module or drain is NULL, Broker_DrainModule shall return BROKER_INVALIDARG. ]*/
+    if (broker == NULL || module == NULL || drain == NULL)
+    {
+        LogError("Broker_DrainModule, input is NULL.");
+        result = BROKER_INVALIDARG;
+    }
+    else
+    {
+        BROKER_HANDLE_DATA* broker_data = (BROKER_HANDLE_DATA*)broker;
+        BROKER_MODULEINFO* module_info;
+        size_t received_before = 0;
+        size_t abandoned_before = 0;
+        /*Codes_SRS_BROKER_17_089: [ Broker_DrainModule shall find the module_info for module under the modules_lock and send its quit signal to the publish_socket, so the worker delivers the messages queued before it and exits. ]*/
+        if (Lock(broker_data->modules_lock) != LOCK_OK)
+        {
+            /*Codes_SRS_BROKER_17_094: [ Upon an error, Broker_DrainModule shall return BROKER_ERROR. ]*/
+            LogError("Broker_DrainModule, Lock on broker_data->modules_lock failed");
+            module_info = NULL;
+        }
+        else
+        {
+            module_info = broker_locate_handle(broker_data, module);
+            if (module_info == NULL)
+            {
+                /*Codes_SRS_BROKER_17_094: [ Upon an error, Broker_DrainModule shall return BROKER_ERROR. ]*/
+                LogError("module is not attached to the broker");
+            }
+            else
+            {
+                received_before = module_info->messages_received;
+                abandoned_before = module_info->messages_abandoned;
+                if (nn_really_send(broker_data->publish_socket, STRING_c_str(module_info->quit_message_guid), BROKER_QUIT_FRAME_SIZE, 0) < 0)
+                {
+                    /*Codes_SRS_BROKER_17_094: [ Upon an error, Broker_DrainModule shall return BROKER_ERROR. ]*/
+                    LogError("unable to send the quit signal to module [%p]", module_info);
+                    module_info = NULL;
+                }
+                else
+                {
+                    module_info->references++;
+                }
+            }
+            Unlock(broker_data->modules_lock);
+        }
+
+        if (module_info == NULL)
+        {
+            result = BROKER_ERROR;
+        }
+        else
+        {
+            uint64_t deadline_us = gateway_clock_now_us() + (uint64_t)timeout_ms * 1000;
+            if (Lock(module_info->drain_lock) != LOCK_OK)
+            {
+                /*Codes_SRS_BROKER_17_094: [ Upon an error, Broker_DrainModule shall return BROKER_ERROR. ]*/
+                LogError("Broker_DrainModule, Lock on the drain lock failed");
+                result = BROKER_ERROR;
+            }
+            else
+            {
+                uint64_t now_us;
+                /*Codes_SRS_BROKER_17_090: [ Broker_DrainModule shall wait on the drain condition at most timeout_ms for the worker to exit. ]*/
+                while (!module_info->worker_exited && (now_us = gateway_clock_now_us()) < deadline_us)
+                {
+                    (void)Condition_Wait(module_info->drain_condition, module_info->drain_lock, (int)((deadline_us - now_us + 999) / 1000));
+                }
+                if (!module_info->worker_exited)
+                {
+                    /*Codes_SRS_BROKER_17_092: [ If the worker did not exit by then, Broker_DrainModule shall have it abandon what is still queued, and wait for the Module_Receive call it is inside of, if any, to return. ]*/
+                    GATEWAY_ATOMIC_STORE_SIZE(&module_info->abandon_queued, 1);
+                    GATEWAY_ATOMIC_STORE_SIZE(&module_info->drain_waiting, 1);
+                    while (!module_info->worker_exited && GATEWAY_ATOMIC_LOAD_SIZE(&module_info->receiving) != 0)
+                    {
+                        (void)Condition_Wait(module_info->drain_condition, module_info->drain_lock, 0);
+                    }
+                    GATEWAY_ATOMIC_STORE_SIZE(&module_info->drain_waiting, 0);
+                    LogInfo("module [%p] abandoned what is still queued after %u ms", module_info, timeout_ms);
+                }
+                (void)Unlock(module_info->drain_lock);
+
+                /*Codes_SRS_BROKER_17_093: [ Broker_DrainModule shall fill drain with the messages delivered and abandoned meanwhile, pause the publishing of the module and return BROKER_OK. ]*/
+                drain->messages_drained = module_info->messages_received - received_before;
+                drain->messages_abandoned = module_info->messages_abandoned - abandoned_before;
+                result = BROKER_OK;
+            }
+
+            /*Codes_SRS_BROKER_17_101: [ Broker_DrainModule shall hold a reference to the module_info while it waits, and release it under the modules_lock, so a module removed meanwhile is only freed once it is done. ]*/
+            if (Lock(broker_data->modules_lock) != LOCK_OK)
+            {
+                /*Codes_SRS_BROKER_17_094: [ Upon an error, Broker_DrainModule shall return BROKER_ERROR. ]*/
+                LogError("Broker_DrainModule, Lock on broker_data->modules_lock failed, the module info is leaked");
+                result = BROKER_ERROR;
+            }
+            else
+            {
+                if (result == BROKER_OK && !module_info->detached && !module_info->pause_publishing)
+                {
+                    module_info->pause_publishing = true;
+                    broker_data->paused_modules++;
+                }
+                release_module_info(module_info);
+                Unlock(broker_data->modules_lock);
+            }
+        }
+    }
+    return result;
+}
+
+TIMER_SERVICE_HANDLE Broker_GetTimerService(BROKER_HANDLE broker)
+{
+    TIMER_SERVICE_HANDLE result;
+    /*Codes_SRS_BROKER_17_063: [ If broker is NULL, Broker_GetTimerService shall return NULL. ]*/
+    if (broker == NULL)
+    {
+        LogError("Broker_GetTimerService, broker is NULL.");
+        result = NULL;
+    }
+    else
+    {
+        BROKER_HANDLE_DATA* broker_data = (BROKER_HANDLE_DATA*)broker;
+        /*Codes_SRS_BROKER_17_064: [ Broker_GetTimerService shall create the timer service of the broker under the modules_lock on the first call and return the same service on every call. ]*/
+        if (Lock(broker_data->modules_lock) != LOCK_OK)
+        {
+            /*Codes_SRS_BROKER_17_065: [ Broker_GetTimerService shall return NULL if any underlying call fails. ]*/
+            LogError("Broker_GetTimerService, Lock on broker_data->modules_lock failed");
+            result = NULL;
+        }
+        else
+        {
+            if (broker_data->timer_service == NULL)
+            {
+                broker_data->timer_service = TimerService_Create();
+                if (broker_data->timer_service == NULL)
+                {
+                    /*Codes_SRS_BROKER_17_065: [ Broker_GetTimerService shall return NULL if any underlying call fails. ]*/
+                    LogError("Unable to create the broker timer service");
+                }
+            }
+            result = broker_data->timer_service;
+            Unlock(broker_data->modules_lock);
+        }
+    }
+    return result;
+}
+
 static void broker_decrement_ref(BROKER_HANDLE broker)
 {
     /*Codes_SRS_BROKER_13_058: [If `broker` is NULL the function shall do nothing.]*/
@@ -782,6 +1589,11 @@ static void broker_decrement_ref(BROKER_HANDLE broker)
             {
                 LogError("WARNING: There are still active modules attached to the broker and the broker is being destroyed.");
             }
+            /*Codes_SRS_BROKER_17_066: [ Broker_Destroy shall destroy the timer service of the broker, if there is one. ]*/
+            if (broker_data->timer_service != NULL)
+            {
+                TimerService_Destroy(broker_data->timer_service);
+            }
             /* May want to do nn_shutdown first for cleanliness. */
             nn_really_close(broker_data->publish_socket);
             STRING_delete(broker_data->url);
@@ -810,6 +1622,7 @@ extern void Broker_DecRef(BROKER_HANDLE broker)
 BROKER_RESULT Broker_Publish(BROKER_HANDLE broker, MODULE_HANDLE source, MESSAGE_HANDLE message)
 {
     BROKER_RESULT result;
+    GATEWAY_TRACE_BEGIN("Broker_Publish", 0);
     /*Codes_SRS_BROKER_13_030: [If broker or message is NULL the function shall return BROKER_INVALIDARG.]*/
     if (broker == NULL || source == NULL || message == NULL)
     {
@@ -828,63 +1641,89 @@ BROKER_RESULT Broker_Publish(BROKER_HANDLE broker, MODULE_HANDLE source, MESSAGE
         }
         else
         {
-            int32_t msg_size;
-            int32_t buf_size;
-            /*Codes_SRS_BROKER_17_007: [ Broker_Publish shall clone the message. ]*/
-            MESSAGE_HANDLE msg = Message_Clone(message);
-            /*Codes_SRS_BROKER_17_008: [ Broker_Publish shall serialize the message. ]*/
-            msg_size = Message_ToByteArray(message, NULL, 0);
-            if (msg_size < 0)
+            if (broker_data->aliased_modules > 0)
             {
-                /*Codes_SRS_BROKER_13_053: [This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise.]*/
-                LogError("unable to serialize a message [%p]", msg);
-                Message_Destroy(msg);
-                result = BROKER_ERROR;
+                /*Codes_SRS_BROKER_17_087: [ If source is the publisher of a module, Broker_Publish shall publish the message as that module. ]*/
+                BROKER_MODULEINFO* alias_info = broker_locate_publisher(broker_data, source);
+                if (alias_info != NULL)
+                {
+                    source = alias_info->module->module_handle;
+                }
+            }
+            BROKER_MODULEINFO* source_info = broker_data->paused_modules > 0 ? broker_locate_handle(broker_data, source) : NULL;
+            if (source_info != NULL && source_info->pause_publishing)
+            {
+                /*Codes_SRS_BROKER_17_074: [ While the publishing of source is paused, Broker_Publish shall count the message as shed and return BROKER_OK without sending it. ]*/
+                source_info->publishes_shed++;
+                result = BROKER_OK;
             }
             else
             {
-                /*Codes_SRS_BROKER_17_025: [ Broker_Publish shall allocate a nanomsg buffer the size of the serialized message + sizeof(MODULE_HANDLE). ]*/
-                buf_size = msg_size + sizeof(MODULE_HANDLE);
-                void* nn_msg = nn_allocmsg(buf_size, 0);
-                if (nn_msg == NULL)
+                const unsigned char* serialized;
+                int32_t msg_size;
+                int32_t buf_size;
+                /*Codes_SRS_BROKER_17_007: [ Broker_Publish shall clone the message. ]*/
+                MESSAGE_HANDLE msg = Message_Clone(message);
+                /*Codes_SRS_BROKER_17_008: [ Broker_Publish shall serialize the message by calling Message_GetSerialized. ]*/
+                if (Message_GetSerialized(message, &serialized, &msg_size) != 0)
                 {
                     /*Codes_SRS_BROKER_13_053: [This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise.]*/
                     LogError("unable to serialize a message [%p]", msg);
+                    Message_Destroy(msg);
                     result = BROKER_ERROR;
                 }
                 else
                 {
-                    /*Codes_SRS_BROKER_17_026: [ Broker_Publish shall copy source into the beginning of the nanomsg buffer. ]*/
-                    unsigned char *nn_msg_bytes = (unsigned char *)nn_msg;
-                    memcpy(nn_msg_bytes, &source, sizeof(MODULE_HANDLE));
-                    /*Codes_SRS_BROKER_17_027: [ Broker_Publish shall serialize the message into the remainder of the nanomsg buffer. ]*/
-                    nn_msg_bytes += sizeof(MODULE_HANDLE);
-                    Message_ToByteArray(message, nn_msg_bytes, msg_size);
-
-                    /*Codes_SRS_BROKER_17_010: [ Broker_Publish shall send a message on the publish_socket. ]*/
-                    int nbytes = nn_really_send(broker_data->publish_socket, &nn_msg, NN_MSG, 0);
-                    if (nbytes != buf_size)
+                    /*Codes_SRS_BROKER_17_025: [ Broker_Publish shall allocate a nanomsg buffer the size of the serialized message + 1 + sizeof(MODULE_HANDLE) + sizeof(uint64_t). ]*/
+                    buf_size = msg_size + BROKER_FRAME_HEADER_SIZE;
+                    void* nn_msg = nn_allocmsg(buf_size, 0);
+                    if (nn_msg == NULL)
                     {
                         /*Codes_SRS_BROKER_13_053: [This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise.]*/
-                        LogError("unable to send a message [%p]", msg);
-                        /*Codes_SRS_BROKER_17_012: [ Broker_Publish shall free the message. ]*/
-                        nn_freemsg(nn_msg);
+                        LogError("unable to serialize a message [%p]", msg);
                         result = BROKER_ERROR;
                     }
                     else
                     {
-                        result = BROKER_OK;
+                        /*Codes_SRS_BROKER_17_026: [ Broker_Publish shall start the nanomsg buffer with the message tag followed by source. ]*/
+                        unsigned char *nn_msg_bytes = (unsigned char *)nn_msg;
+                        make_topic(nn_msg_bytes, source);
+                        nn_msg_bytes += BROKER_TOPIC_SIZE;
+                        /*Codes_SRS_BROKER_17_043: [ Broker_Publish shall copy the current time in microseconds after the source. ]*/
+                        uint64_t published_us = gateway_clock_now_us();
+                        memcpy(nn_msg_bytes, &published_us, sizeof(uint64_t));
+                        /*Codes_SRS_BROKER_17_027: [ Broker_Publish shall copy the serialized message into the remainder of the nanomsg buffer. ]*/
+                        nn_msg_bytes += sizeof(uint64_t);
+                        memcpy(nn_msg_bytes, serialized, msg_size);
+
+                        /*Codes_SRS_BROKER_17_010: [ Broker_Publish shall send a message on the publish_socket. ]*/
+                        int nbytes = nn_really_send(broker_data->publish_socket, &nn_msg, NN_MSG, 0);
+                        if (nbytes != buf_size)
+                        {
+                            /*Codes_SRS_BROKER_13_053: [This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise.]*/
+                            LogError("unable to send a message [%p]", msg);
+                            /*Codes_SRS_BROKER_17_012: [ Broker_Publish shall free the message. ]*/
+                            nn_freemsg(nn_msg);
+                            result = BROKER_ERROR;
+                        }
+                        else
+                        {
+                            GATEWAY_TRACE_INSTANT("broker_enqueue", buf_size);
+                            GATEWAY_TRACE_FLOW_START("message", (uint64_t)(uintptr_t)source ^ published_us);
+                            result = BROKER_OK;
+                        }
                     }
+                    /*Codes_SRS_BROKER_17_012: [ Broker_Publish shall free the message. ]*/
+                    Message_Destroy(msg);
+                    /*Codes_SRS_BROKER_17_011: [ Broker_Publish shall free the serialized message data. ]*/
                 }
-                /*Codes_SRS_BROKER_17_012: [ Broker_Publish shall free the message. ]*/
-                Message_Destroy(msg);
-                /*Codes_SRS_BROKER_17_011: [ Broker_Publish shall free the serialized message data. ]*/
             }
             /*Codes_SRS_BROKER_17_023: [ Broker_Publish shall Unlock the modules lock. ]*/
             Unlock(broker_data->modules_lock);
         }
 
     }
+    GATEWAY_TRACE_END("Broker_Publish");
     /*Codes_SRS_BROKER_13_037: [ This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise. ]*/
     return result;
 }
@@ -3,9 +3,14 @@
 
 #include <stdlib.h>
 #include <stddef.h>
+#include <string.h>
+#include <stdio.h>
 #include <assert.h>
+#include <limits.h>
 #include "azure_c_shared_utility/gballoc.h"
 #include "azure_c_shared_utility/xlogging.h"
+#include "azure_c_shared_utility/crt_abstractions.h"
+#include "parson.h"
 
 #include "gateway.h"
 #include "broker.h"
@@ -13,10 +18,37 @@
 #include "experimental/event_system.h"
 #include "module_access.h"
 #include "gateway_internal.h"
+#include "internal/gateway_clock.h"
+
+/*how often the metrics thread checks the memory budgets when there is no receive deadline*/
+#define GATEWAY_MEMORY_CHECK_MS 1000
+
+/*load shedding eases off once every reading is under this share of its maximum, so it does not flap at the threshold*/
+#define GATEWAY_SHEDDING_RELEASE_PERCENT 80
+
+/*the settings that keep the metrics thread running*/
+typedef enum GATEWAY_TIMER_SETTING_TAG
+{
+    GATEWAY_TIMER_INTERVAL,
+    GATEWAY_TIMER_DEADLINE,
+    GATEWAY_TIMER_MEMORY_CHECKS,
+    GATEWAY_TIMER_LOAD_SHEDDING
+} GATEWAY_TIMER_SETTING;
 
 static bool module_info_name_find(const void* element, const void* module_name);
+static int gateway_metrics_thread(void* param);
+static int gateway_timer_set(GATEWAY_HANDLE_DATA* gateway_handle, GATEWAY_TIMER_SETTING setting, unsigned int value_ms);
+static void gateway_watchdog_check(GATEWAY_HANDLE_DATA* gateway_handle, bool* newly_stuck, bool* newly_over_budget);
+static bool gateway_shedding_check(GATEWAY_HANDLE_DATA* gateway_handle);
+static void gateway_shedding_apply(GATEWAY_HANDLE_DATA* gateway_handle, bool shed);
+static int gateway_shedding_copy(GATEWAY_LOAD_SHEDDING* destination, const GATEWAY_LOAD_SHEDDING* source);
+static GATEWAY_METRICS_DATA* gateway_metrics_create(GATEWAY_HANDLE_DATA* gateway_handle);
+static uint64_t latency_percentile(const size_t* buckets, size_t total, size_t percent);
+static bool baseline_module_find(const void* element, const void* value);
 static void gateway_destroymodulelist_internal(GATEWAY_MODULE_INFO* infos, size_t count);
 static bool module_data_find(const void* element, const void* value);
+static JSON_Value* gateway_create_startup_report(const GATEWAY_HANDLE_DATA* gateway_handle);
+static int gateway_drain_modules(GATEWAY_HANDLE_DATA* gateway_handle, uint64_t deadline_us, VECTOR_HANDLE report);
 
 VECTOR_HANDLE Gateway_GetModuleList(GATEWAY_HANDLE gw)
 {
@@ -147,239 +179,1435 @@ void Gateway_AddEventCallback(GATEWAY_HANDLE gw, GATEWAY_EVENT event_type, GATEW
     }
 }
 
-GATEWAY_HANDLE Gateway_Create(const GATEWAY_PROPERTIES* properties)
+int Gateway_SetMetricsInterval(GATEWAY_HANDLE gw, unsigned int interval_ms)
 {
-    GATEWAY_HANDLE result;
-    /*Codes_SRS_GATEWAY_17_016: [ This function shall initialize the default module loaders. ] */
-    if (ModuleLoader_Initialize() != MODULE_LOADER_SUCCESS)
+    return gateway_timer_set(gw, GATEWAY_TIMER_INTERVAL, interval_ms);
+}
+
+int Gateway_SetReceiveDeadline(GATEWAY_HANDLE gw, unsigned int deadline_ms)
+{
+    /*Codes_SRS_GATEWAY_17_039: [ `Gateway_SetReceiveDeadline` shall behave as `Gateway_SetMetricsInterval`, but set the time a module may spend in `Module_Receive` before `GATEWAY_MODULE_STUCK` is reported. ]*/
+    return gateway_timer_set(gw, GATEWAY_TIMER_DEADLINE, deadline_ms);
+}
+
+VECTOR_HANDLE Gateway_GetMetricsSnapshot(GATEWAY_HANDLE gw)
+{
+    VECTOR_HANDLE result;
+
+    /*Codes_SRS_GATEWAY_17_032: [ If `gw` is NULL or `Gateway_SetMetricsInterval` was never called, the function shall return NULL. ]*/
+    if (gw == NULL || gw->metrics == NULL)
     {
-        LogError("Gateway_Create() - ModuleLoader_Initialize failed");
+        LogError("Metrics are not enabled on gateway [%p]", gw);
         result = NULL;
     }
     else
     {
-        result = gateway_create_internal(properties, false);
-        if (result == NULL)
+        VECTOR_HANDLE baselines = VECTOR_create(sizeof(METRICS_BASELINE));
+        result = VECTOR_create(sizeof(GATEWAY_MODULE_METRICS));
+        if (result == NULL || baselines == NULL)
         {
-            /* Codes_SRS_GATEWAY_27_027: [ Launch - This function shall join any spawned threads upon any failure. ] */
-            /* Codes_SRS_GATEWAY_17_017: [ This function shall destroy the default module loaders upon any failure. ]*/
-            ModuleLoader_Destroy();
+            /*Codes_SRS_GATEWAY_17_036: [ The function shall return NULL if any underlying call fails. ]*/
+            LogError("Failed to create the metrics snapshot vectors");
+            if (result != NULL)
+            {
+                VECTOR_destroy(result);
+                result = NULL;
+            }
+            if (baselines != NULL)
+            {
+                VECTOR_destroy(baselines);
+            }
+        }
+        else if (Lock(gw->metrics->modules_lock) != LOCK_OK)
+        {
+            /*Codes_SRS_GATEWAY_17_036: [ The function shall return NULL if any underlying call fails. ]*/
+            LogError("Failed to lock the gateway modules");
+            VECTOR_destroy(result);
+            VECTOR_destroy(baselines);
+            result = NULL;
+        }
+        else
+        {
+            uint64_t now = gateway_clock_now_us();
+            uint64_t elapsed_us = now - gw->metrics->last_snapshot_us;
+            size_t module_count = VECTOR_size(gw->modules);
+            size_t i;
+            for (i = 0; i < module_count; i++)
+            {
+                MODULE_DATA* module_data = *(MODULE_DATA**)VECTOR_element(gw->modules, i);
+                METRICS_BASELINE current;
+                GATEWAY_MODULE_METRICS entry;
+                size_t buckets[BROKER_LATENCY_BUCKET_COUNT];
+                size_t b;
+                METRICS_BASELINE* previous;
+
+                current.module = module_data->module;
+                /*Codes_SRS_GATEWAY_17_033: [ The function shall read each module's counters with `Broker_GetModuleMetrics`. ]*/
+                if (Broker_GetModuleMetrics(gw->broker, current.module, &current.metrics) != BROKER_OK)
+                {
+                    LogError("Failed to read the metrics of module %s", module_data->module_name);
+                    break;
+                }
+                current.cpu_us = current.metrics.receive_cpu_us + module_data->start_cpu_us;
+
+                /*Codes_SRS_GATEWAY_17_034: [ Each `GATEWAY_MODULE_METRICS` shall hold what the module did since the previous snapshot. ]*/
+                previous = (METRICS_BASELINE*)VECTOR_find_if(gw->metrics->baselines, baseline_module_find, current.module);
+                entry.messages_received = current.metrics.messages_received - (previous == NULL ? 0 : previous->metrics.messages_received);
+                entry.messages_dropped = current.metrics.messages_dropped - (previous == NULL ? 0 : previous->metrics.messages_dropped);
+                entry.messages_per_second = elapsed_us == 0 ? 0.0 : (double)entry.messages_received * 1000000.0 / (double)elapsed_us;
+                for (b = 0; b < BROKER_LATENCY_BUCKET_COUNT; b++)
+                {
+                    buckets[b] = current.metrics.latency_buckets[b] - (previous == NULL ? 0 : previous->metrics.latency_buckets[b]);
+                }
+                /*Codes_SRS_GATEWAY_17_035: [ The latency percentiles shall be the upper bound of the histogram bucket that holds them. ]*/
+                entry.latency_p50_us = latency_percentile(buckets, entry.messages_received, 50);
+                entry.latency_p90_us = latency_percentile(buckets, entry.messages_received, 90);
+                entry.latency_p99_us = latency_percentile(buckets, entry.messages_received, 99);
+                /*Codes_SRS_GATEWAY_17_047: [ The CPU time of each module shall be the thread CPU time of its `Module_Start` and `Module_Receive` calls since the previous snapshot. ]*/
+                entry.cpu_time_us = current.cpu_us - (previous == NULL ? 0 : previous->cpu_us);
+                /*Codes_SRS_GATEWAY_17_048: [ The live bytes of each module shall be the bytes charged to its memory account when the snapshot is taken. ]*/
+                entry.memory_live_bytes = current.metrics.memory_live_bytes;
+
+                if (mallocAndStrcpy_s((char**)&entry.module_name, module_data->module_name) != 0)
+                {
+                    LogError("Failed to copy the name of module %s", module_data->module_name);
+                    break;
+                }
+                else if (VECTOR_push_back(result, &entry, 1) != 0)
+                {
+                    LogError("Failed to add the metrics of module %s", module_data->module_name);
+                    free((char*)entry.module_name);
+                    break;
+                }
+                else if (VECTOR_push_back(baselines, &current, 1) != 0)
+                {
+                    LogError("Failed to keep the metrics of module %s", module_data->module_name);
+                    break;
+                }
+            }
+            (void)Unlock(gw->metrics->modules_lock);
+
+            if (i < module_count)
+            {
+                /*Codes_SRS_GATEWAY_17_036: [ The function shall return NULL if any underlying call fails. ]*/
+                Gateway_DestroyMetricsSnapshot(result);
+                VECTOR_destroy(baselines);
+                result = NULL;
+            }
+            else
+            {
+                /*Codes_SRS_GATEWAY_17_037: [ The function shall make the counters just read the baseline of the next snapshot. ]*/
+                VECTOR_destroy(gw->metrics->baselines);
+                gw->metrics->baselines = baselines;
+                gw->metrics->last_snapshot_us = now;
+            }
         }
     }
 
     return result;
 }
 
-GATEWAY_START_RESULT Gateway_Start(GATEWAY_HANDLE gw)
+VECTOR_HANDLE Gateway_GetStuckModules(GATEWAY_HANDLE gw)
 {
-    GATEWAY_START_RESULT result;
-    if (gw != NULL)
-    {
-        GATEWAY_HANDLE_DATA* gateway_handle = (GATEWAY_HANDLE_DATA*)gw;
+    VECTOR_HANDLE result;
 
-        /*Codes_SRS_GATEWAY_17_010: [ This function shall call Module_Start for every module which defines the start function. ]*/
-        size_t module_count = VECTOR_size(gateway_handle->modules);
-        size_t m;
-        for (m = 0; m < module_count; m++)
+    /*Codes_SRS_GATEWAY_17_041: [ If `gw` is NULL or the metrics were never enabled, the function shall return NULL. ]*/
+    if (gw == NULL || gw->metrics == NULL)
+    {
+        LogError("The watchdog is not enabled on gateway [%p]", gw);
+        result = NULL;
+    }
+    else if ((result = VECTOR_create(sizeof(GATEWAY_STUCK_MODULE))) == NULL)
+    {
+        /*Codes_SRS_GATEWAY_17_043: [ The function shall return NULL if any underlying call fails. ]*/
+        LogError("Failed to create the stuck modules vector");
+    }
+    else if (Lock(gw->metrics->modules_lock) != LOCK_OK)
+    {
+        /*Codes_SRS_GATEWAY_17_043: [ The function shall return NULL if any underlying call fails. ]*/
+        LogError("Failed to lock the gateway modules");
+        VECTOR_destroy(result);
+        result = NULL;
+    }
+    else
+    {
+        size_t stuck_count = VECTOR_size(gw->metrics->stuck);
+        size_t i;
+        /*Codes_SRS_GATEWAY_17_042: [ The function shall return the name of every module the watchdog last found past the deadline and how long its `Module_Receive` call had been running. ]*/
+        for (i = 0; i < stuck_count; i++)
         {
-            MODULE_DATA** module_data = VECTOR_element(gateway_handle->modules, m);
-            pfModule_Start pfStart = MODULE_START((*module_data)->module_loader->api->GetApi((*module_data)->module_loader, (*module_data)->module_library_handle));
-            if (pfStart != NULL)
+            METRICS_BASELINE* stuck = (METRICS_BASELINE*)VECTOR_element(gw->metrics->stuck, i);
+            MODULE_DATA** module_data = (MODULE_DATA**)VECTOR_find_if(gw->modules, module_data_find, stuck->module);
+            GATEWAY_STUCK_MODULE entry;
+            if (module_data == NULL)
             {
-                /*Codes_SRS_GATEWAY_17_010: [ This function shall call Module_Start for every module which defines the start function. ]*/
-                (pfStart)((*module_data)->module);
+                /*removed since the watchdog saw it*/
+                continue;
+            }
+            entry.receive_elapsed_us = stuck->metrics.receive_elapsed_us;
+            if (mallocAndStrcpy_s((char**)&entry.module_name, (*module_data)->module_name) != 0)
+            {
+                LogError("Failed to copy the name of module %s", (*module_data)->module_name);
+                break;
+            }
+            else if (VECTOR_push_back(result, &entry, 1) != 0)
+            {
+                LogError("Failed to add stuck module %s", (*module_data)->module_name);
+                free((char*)entry.module_name);
+                break;
             }
         }
-        /*Codes_SRS_GATEWAY_17_012: [ This function shall report a GATEWAY_STARTED event. ]*/
-        EventSystem_ReportEvent(gw->event_system, gw, GATEWAY_STARTED);
-        /*Codes_SRS_GATEWAY_17_013: [ This function shall return GATEWAY_START_SUCCESS upon completion. ]*/
-        result = GATEWAY_START_SUCCESS;
-    }
-    else
-    {
-        /*Codes_SRS_GATEWAY_17_009: [ This function shall return GATEWAY_START_INVALID_ARGS if a NULL gateway is received. ]*/
-        result = GATEWAY_START_INVALID_ARGS;
+        (void)Unlock(gw->metrics->modules_lock);
+
+        if (i < stuck_count)
+        {
+            /*Codes_SRS_GATEWAY_17_043: [ The function shall return NULL if any underlying call fails. ]*/
+            Gateway_DestroyStuckModules(result);
+            result = NULL;
+        }
     }
+
     return result;
 }
 
-void Gateway_Destroy(GATEWAY_HANDLE gw)
+void Gateway_DestroyStuckModules(VECTOR_HANDLE stuck_modules)
 {
-    gateway_destroy_internal(gw);
-    /*Codes_SRS_GATEWAY_17_019: [ The function shall destroy the module loader list. ]*/
-    ModuleLoader_Destroy();
+    if (stuck_modules != NULL)
+    {
+        size_t count = VECTOR_size(stuck_modules);
+        size_t i;
+        for (i = 0; i < count; i++)
+        {
+            /*Codes_SRS_GATEWAY_17_044: [ This function shall free every module name and destroy the vector. ]*/
+            free((char*)((GATEWAY_STUCK_MODULE*)VECTOR_element(stuck_modules, i))->module_name);
+        }
+        VECTOR_destroy(stuck_modules);
+    }
 }
 
-MODULE_HANDLE Gateway_AddModule(GATEWAY_HANDLE gw, const GATEWAY_MODULES_ENTRY* entry)
+int Gateway_SetModuleMemoryBudget(GATEWAY_HANDLE gw, const char* module_name, size_t budget_bytes)
 {
-    MODULE_HANDLE module;
-    /*Codes_SRS_GATEWAY_14_011: [ If gw, entry, or GATEWAY_MODULES_ENTRY's loader_configuration or loader_api is NULL the function shall return NULL. ]*/
-    if (gw != NULL && entry != NULL)
-    {
-        module = gateway_addmodule_internal(gw, entry, false);
+    int result;
 
-        if (module == NULL)
+    /*Codes_SRS_GATEWAY_17_049: [ If `gw` or `module_name` is NULL, the function shall return a non-zero value. ]*/
+    if (gw == NULL || module_name == NULL)
+    {
+        LogError("Invalid input gw [%p], module_name [%p]", gw, module_name);
+        result = __LINE__;
+    }
+    else
+    {
+        MODULE_DATA** module_data = (MODULE_DATA**)VECTOR_find_if(gw->modules, module_name_find, module_name);
+        if (module_data == NULL)
         {
-            LogError("Gateway_AddModule(): Unable to add module '%s'.", entry->module_name);
+            /*Codes_SRS_GATEWAY_17_050: [ If no module is called `module_name`, the function shall return a non-zero value. ]*/
+            LogError("No module called %s", module_name);
+            result = __LINE__;
+        }
+        /*Codes_SRS_GATEWAY_17_051: [ The function shall set the budget of the module with `Broker_SetModuleMemoryBudget`. ]*/
+        else if (Broker_SetModuleMemoryBudget(gw->broker, (*module_data)->module, budget_bytes) != BROKER_OK)
+        {
+            /*Codes_SRS_GATEWAY_17_053: [ The function shall return 0 on success and a non-zero value if any underlying call fails. ]*/
+            LogError("Failed to set the memory budget of module %s", module_name);
+            result = __LINE__;
+        }
+        /*Codes_SRS_GATEWAY_17_052: [ A non-zero budget shall make the metrics thread check the memory budgets of all modules, starting it if needed. ]*/
+        else if (budget_bytes > 0 && gateway_timer_set(gw, GATEWAY_TIMER_MEMORY_CHECKS, 1) != 0)
+        {
+            /*Codes_SRS_GATEWAY_17_053: [ The function shall return 0 on success and a non-zero value if any underlying call fails. ]*/
+            LogError("Failed to start the memory budget checks");
+            result = __LINE__;
         }
         else
         {
-            /*Codes_SRS_GATEWAY_26_011: [ The function shall report `GATEWAY_MODULE_LIST_CHANGED` event after successfully adding the module. ]*/
-            EventSystem_ReportEvent(gw->event_system, gw, GATEWAY_MODULE_LIST_CHANGED);
+            /*Codes_SRS_GATEWAY_17_053: [ The function shall return 0 on success and a non-zero value if any underlying call fails. ]*/
+            result = 0;
         }
     }
-    else
-    {
-        module = NULL;
-        LogError("Gateway_AddModule(): Unable to add module to NULL GATEWAY_HANDLE or from NULL GATEWAY_MODULES_ENTRY*. gw = %p, entry = %p.", gw, entry);
-    }
 
-    return module;
+    return result;
 }
 
-extern void Gateway_StartModule(GATEWAY_HANDLE gw, MODULE_HANDLE module)
+VECTOR_HANDLE Gateway_GetModulesOverBudget(GATEWAY_HANDLE gw)
 {
-    if (gw != NULL)
+    VECTOR_HANDLE result;
+
+    /*Codes_SRS_GATEWAY_17_055: [ If `gw` is NULL or the metrics were never enabled, the function shall return NULL. ]*/
+    if (gw == NULL || gw->metrics == NULL)
     {
-        GATEWAY_HANDLE_DATA* gateway_handle = (GATEWAY_HANDLE_DATA*)gw;
-        MODULE_DATA** module_data = (MODULE_DATA**)VECTOR_find_if(gateway_handle->modules, module_data_find, module);
-        if (module_data != NULL)
+        LogError("Memory budgets are not checked on gateway [%p]", gw);
+        result = NULL;
+    }
+    else if ((result = VECTOR_create(sizeof(GATEWAY_MODULE_MEMORY))) == NULL)
+    {
+        /*Codes_SRS_GATEWAY_17_057: [ The function shall return NULL if any underlying call fails. ]*/
+        LogError("Failed to create the modules over budget vector");
+    }
+    else if (Lock(gw->metrics->modules_lock) != LOCK_OK)
+    {
+        /*Codes_SRS_GATEWAY_17_057: [ The function shall return NULL if any underlying call fails. ]*/
+        LogError("Failed to lock the gateway modules");
+        VECTOR_destroy(result);
+        result = NULL;
+    }
+    else
+    {
+        size_t over_budget_count = VECTOR_size(gw->metrics->over_budget);
+        size_t i;
+        /*Codes_SRS_GATEWAY_17_056: [ The function shall return the name, live bytes and budget of every module the last check found over its memory budget. ]*/
+        for (i = 0; i < over_budget_count; i++)
         {
-            pfModule_Start pfStart = MODULE_START((*module_data)->module_loader->api->GetApi((*module_data)->module_loader, (*module_data)->module_library_handle));
-            if (pfStart != NULL)
+            METRICS_BASELINE* over_budget = (METRICS_BASELINE*)VECTOR_element(gw->metrics->over_budget, i);
+            MODULE_DATA** module_data = (MODULE_DATA**)VECTOR_find_if(gw->modules, module_data_find, over_budget->module);
+            GATEWAY_MODULE_MEMORY entry;
+            if (module_data == NULL)
             {
-                /*Codes_SRS_GATEWAY_17_008: [ When module is found, if the Module_Start function is defined for this module, the Module_Start function shall be called. ]*/
-                (pfStart)((*module_data)->module);
+                /*removed since the check saw it*/
+                continue;
+            }
+            entry.live_bytes = over_budget->metrics.memory_live_bytes;
+            entry.budget_bytes = over_budget->metrics.memory_budget;
+            if (mallocAndStrcpy_s((char**)&entry.module_name, (*module_data)->module_name) != 0)
+            {
+                LogError("Failed to copy the name of module %s", (*module_data)->module_name);
+                break;
+            }
+            else if (VECTOR_push_back(result, &entry, 1) != 0)
+            {
+                LogError("Failed to add module over budget %s", (*module_data)->module_name);
+                free((char*)entry.module_name);
+                break;
             }
         }
-        else
+        (void)Unlock(gw->metrics->modules_lock);
+
+        if (i < over_budget_count)
         {
-            /*Codes_SRS_GATEWAY_17_007: [ If module is not found in the gateway, this function shall do nothing. ]*/
-            LogError("Gateway_StartModule(): Failed to start module because the MODULE_DATA not found.");
+            /*Codes_SRS_GATEWAY_17_057: [ The function shall return NULL if any underlying call fails. ]*/
+            Gateway_DestroyModulesOverBudget(result);
+            result = NULL;
         }
     }
-    else
-    {
-        /*Codes_SRS_GATEWAY_17_006: [ If gw is NULL, this function shall do nothing. ]*/
-        LogError("Gateway_StartModule(): Failed to start module because the GATEWAY_HANDLE is NULL.");
-    }
-}
 
+    return result;
+}
 
-void Gateway_RemoveModule(GATEWAY_HANDLE gw, MODULE_HANDLE module)
+void Gateway_DestroyModulesOverBudget(VECTOR_HANDLE over_budget)
 {
-    /*Codes_SRS_GATEWAY_14_020: [ If gw or module is NULL the function shall return. ]*/
-    if (gw != NULL)
+    if (over_budget != NULL)
     {
-        GATEWAY_HANDLE_DATA* gateway_handle = (GATEWAY_HANDLE_DATA*)gw;
-
-        /*Codes_SRS_GATEWAY_14_023: [The function shall locate the MODULE_DATA object in GATEWAY_HANDLE_DATA's modules containing module and return if it cannot be found. ]*/
-        MODULE_DATA** module_data = (MODULE_DATA**)VECTOR_find_if(gateway_handle->modules, module_data_find, module);
-
-        if (module_data != NULL)
-        {
-            gateway_removemodule_internal(gateway_handle, module_data);
-            /*Codes_SRS_GATEWAY_26_012: [ The function shall report `GATEWAY_MODULE_LIST_CHANGED` event after successfully removing the module. ]*/
-            EventSystem_ReportEvent(gw->event_system, gw, GATEWAY_MODULE_LIST_CHANGED);
-        }
-        else
+        size_t count = VECTOR_size(over_budget);
+        size_t i;
+        for (i = 0; i < count; i++)
         {
-            LogError("Gateway_RemoveModule(): Failed to remove module because the MODULE_DATA pointer is NULL.");
+            /*Codes_SRS_GATEWAY_17_058: [ This function shall free every module name and destroy the vector. ]*/
+            free((char*)((GATEWAY_MODULE_MEMORY*)VECTOR_element(over_budget, i))->module_name);
         }
-    }
-    else
-    {
-        LogError("Gateway_RemoveModule(): Failed to remove module because the GATEWA_HANDLE is NULL.");
+        VECTOR_destroy(over_budget);
     }
 }
 
-int Gateway_RemoveModuleByName(GATEWAY_HANDLE gw, const char *module_name)
+int Gateway_SetLoadShedding(GATEWAY_HANDLE gw, const GATEWAY_LOAD_SHEDDING* shedding)
 {
     int result;
-    if (gw != NULL && module_name != NULL)
+    GATEWAY_LOAD_SHEDDING copy;
+    memset(&copy, 0, sizeof(GATEWAY_LOAD_SHEDDING));
+
+    /*Codes_SRS_GATEWAY_17_059: [ If `gw` is NULL, the function shall return a non-zero value. ]*/
+    if (gw == NULL)
     {
-        MODULE_DATA **module_data = (MODULE_DATA**)VECTOR_find_if(gw->modules, module_name_find, module_name);
-        if (module_data != NULL)
-        {
-            /* Codes_SRS_GATEWAY_26_016: [** The function shall return 0 if the module was found. ] */
-            result = 0;
-            gateway_removemodule_internal(gw, module_data);
-            EventSystem_ReportEvent(gw->event_system, gw, GATEWAY_MODULE_LIST_CHANGED);
-        }
-        else
-        {
-            /* Codes_SRS_GATEWAY_26_017: [** If module with `module_name` name is not found this function shall return non - zero and do nothing. ] */
-            LogError("Couldn't find module with the specified name");
-            result = __LINE__;
-        }
+        LogError("NULL gateway handle given to the load shedding controller");
+        result = __LINE__;
     }
-    else
+    /*Codes_SRS_GATEWAY_17_060: [ If `shedding` has a `check_interval_ms` of 0, NULL `rules` with a non-zero `rule_count`, or a rule with a NULL `module_name`, a `level` of 0, an unknown `action` or a `sample_every` under 2 for `GATEWAY_SHEDDING_SAMPLE_INBOUND`, the function shall return a non-zero value. ]*/
+    else if (shedding != NULL && gateway_shedding_copy(&copy, shedding) != 0)
     {
-        /* Codes_SRS_GATEWAY_26_015: [ If `gw` or `module_name` is `NULL` the function shall do nothing and return with non - zero result. ] */
-        LogError("NULL gateway or module_name given to Gateway_RemoveModuleByName()");
+        LogError("Invalid load shedding settings");
+        result = __LINE__;
+    }
+    else if (shedding == NULL && gw->metrics == NULL)
+    {
+        /*nothing was ever started*/
+        result = 0;
+    }
+    /*Codes_SRS_GATEWAY_17_061: [ The function shall have the metrics thread check the load every `check_interval_ms` milliseconds, starting it if needed, or stop the checks if `shedding` is NULL. ]*/
+    else if (gateway_timer_set(gw, GATEWAY_TIMER_LOAD_SHEDDING, shedding == NULL ? 0 : shedding->check_interval_ms) != 0)
+    {
+        /*Codes_SRS_GATEWAY_17_071: [ The function shall return 0 on success and a non-zero value if any underlying call fails. ]*/
+        LogError("Failed to start the load shedding checks");
+        gateway_shedding_free(&copy);
+        result = __LINE__;
+    }
+    else if (Lock(gw->metrics->modules_lock) != LOCK_OK)
+    {
+        /*Codes_SRS_GATEWAY_17_071: [ The function shall return 0 on success and a non-zero value if any underlying call fails. ]*/
+        LogError("Failed to lock the gateway modules");
+        gateway_shedding_free(&copy);
         result = __LINE__;
     }
+    else
+    {
+        GATEWAY_METRICS_DATA* metrics = gw->metrics;
+        /*Codes_SRS_GATEWAY_17_062: [ The function shall stop what the previous rules shed, replace them with a copy of `shedding` and start over at level 0. ]*/
+        gateway_shedding_apply(gw, false);
+        gateway_shedding_free(&metrics->shedding);
+        metrics->shedding = copy;
+        memset(&metrics->shedding_state, 0, sizeof(GATEWAY_LOAD_SHEDDING_STATE));
+        VECTOR_clear(metrics->shedding_baselines);
+        metrics->shedding_check_us = gateway_clock_now_us();
+        metrics->shedding_cpu_us = gateway_clock_process_cpu_us();
+        (void)Unlock(metrics->modules_lock);
+        /*Codes_SRS_GATEWAY_17_071: [ The function shall return 0 on success and a non-zero value if any underlying call fails. ]*/
+        result = 0;
+    }
+
     return result;
 }
 
-GATEWAY_ADD_LINK_RESULT Gateway_AddLink(GATEWAY_HANDLE gw, const GATEWAY_LINK_ENTRY* entryLink)
+GATEWAY_LOAD_SHEDDING_STATE* Gateway_GetLoadSheddingState(GATEWAY_HANDLE gw)
 {
-    GATEWAY_ADD_LINK_RESULT result;
+    GATEWAY_LOAD_SHEDDING_STATE* result;
 
-    if (gw == NULL || entryLink == NULL || entryLink->module_source == NULL || entryLink->module_sink == NULL)
+    /*Codes_SRS_GATEWAY_17_067: [ If `gw` is NULL or the metrics were never enabled, the function shall return NULL. ]*/
+    if (gw == NULL || gw->metrics == NULL)
     {
-        /*Codes_SRS_GATEWAY_04_008: [ If gw , entryLink, entryLink->module_source or entryLink->module_source is NULL the function shall return GATEWAY_ADD_LINK_INVALID_ARG. ]*/
-        result = GATEWAY_ADD_LINK_INVALID_ARG;
-        LogError("Failed to add link because either the GATEWAY_HANDLE is NULL, entryLink, module_source string is NULL or empty or module_sink is NULL or empty. gw = %p, module_source = '%s', module_sink = '%s'.", gw, entryLink, (entryLink != NULL)? entryLink->module_source:NULL, (entryLink != NULL) ? entryLink->module_sink : NULL);
+        LogError("Load shedding is not set up on gateway [%p]", gw);
+        result = NULL;
+    }
+    else if ((result = (GATEWAY_LOAD_SHEDDING_STATE*)malloc(sizeof(GATEWAY_LOAD_SHEDDING_STATE))) == NULL)
+    {
+        /*Codes_SRS_GATEWAY_17_069: [ The function shall return NULL if any underlying call fails. ]*/
+        LogError("Failed to allocate the load shedding state");
+    }
+    else if (Lock(gw->metrics->modules_lock) != LOCK_OK)
+    {
+        /*Codes_SRS_GATEWAY_17_069: [ The function shall return NULL if any underlying call fails. ]*/
+        LogError("Failed to lock the gateway modules");
+        free(result);
+        result = NULL;
     }
     else
     {
-        if (!gateway_addlink_internal(gw, entryLink))
-        {
-            /*Codes_SRS_GATEWAY_04_010: [ If the entryLink already exists it the function shall return GATEWAY_ADD_LINK_ERROR ] */
-            /*Codes_SRS_GATEWAY_04_011: [ If the module referenced by the entryLink->module_source or entryLink->module_sink doesn't exists this function shall return GATEWAY_ADD_LINK_ERROR ] */
-            result = GATEWAY_ADD_LINK_ERROR;
-        }
-        else
-        {
-            /*Codes_SRS_GATEWAY_04_013: [ If adding the link succeed this function shall return GATEWAY_ADD_LINK_SUCCESS ]*/
-            result = GATEWAY_ADD_LINK_SUCCESS;
-            /*Codes_SRS_GATEWAY_26_019: [ The function shall report `GATEWAY_MODULE_LIST_CHANGED` event after successfully adding the link. ]*/
-            EventSystem_ReportEvent(gw->event_system, gw, GATEWAY_MODULE_LIST_CHANGED);
-        }
+        /*Codes_SRS_GATEWAY_17_068: [ The function shall return a copy of the last shedding transition and the readings it was based on. ]*/
+        *result = gw->metrics->shedding_state;
+        (void)Unlock(gw->metrics->modules_lock);
     }
 
     return result;
 }
 
-void Gateway_RemoveLink(GATEWAY_HANDLE gw, const GATEWAY_LINK_ENTRY* entryLink)
+void Gateway_DestroyLoadSheddingState(GATEWAY_LOAD_SHEDDING_STATE* state)
 {
-    /*Codes_SRS_GATEWAY_04_005: [ If gw or entryLink is NULL the function shall return. ]*/
-    if (gw == NULL || entryLink == NULL)
+    if (state != NULL)
     {
-        LogError("Gateway_RemoveLink(): Failed to remove link because the GATEWAY_HANDLE is NULL or entryLink is NULL.");
+        /*Codes_SRS_GATEWAY_17_070: [ This function shall free `state`. ]*/
+        free(state);
     }
-    else
-    {
-        GATEWAY_HANDLE_DATA* gateway_handle = (GATEWAY_HANDLE_DATA*)gw;
+}
 
-        /*Codes_SRS_GATEWAY_04_006: [ The function shall locate the LINK_DATA object in GATEWAY_HANDLE_DATA's links containing link and return if it cannot be found. ]*/
+void Gateway_DestroyMetricsSnapshot(VECTOR_HANDLE snapshot)
+{
+    if (snapshot != NULL)
+    {
+        size_t count = VECTOR_size(snapshot);
+        size_t i;
+        for (i = 0; i < count; i++)
+        {
+            /*Codes_SRS_GATEWAY_17_038: [ This function shall free every module name and destroy the snapshot. ]*/
+            free((char*)((GATEWAY_MODULE_METRICS*)VECTOR_element(snapshot, i))->module_name);
+        }
+        VECTOR_destroy(snapshot);
+    }
+}
+
+char* Gateway_GetStartupReport(GATEWAY_HANDLE gw)
+{
+    char* result;
+
+    /*Codes_SRS_GATEWAY_17_083: [ If `gw` is NULL or `Gateway_Start` was never called, the function shall return NULL. ]*/
+    if (gw == NULL || !gw->startup.finished)
+    {
+        LogError("Gateway [%p] was not started", gw);
+        result = NULL;
+    }
+    else
+    {
+        /*Codes_SRS_GATEWAY_17_084: [ The function shall return a JSON object with `total_us` and, for every module the first `Gateway_Start` started, the time each step of bringing it up took. ]*/
+        /*Codes_SRS_GATEWAY_17_085: [ The JSON object shall have a `critical_path` array of the startup phases in the order they ran, where the phases that create and start the modules name the module that took longest. ]*/
+        JSON_Value* report = gateway_create_startup_report(gw);
+        if (report == NULL)
+        {
+            /*Codes_SRS_GATEWAY_17_086: [ The function shall return NULL if any underlying call fails. ]*/
+            LogError("Failed to build the startup report");
+            result = NULL;
+        }
+        else
+        {
+            result = json_serialize_to_string(report);
+            if (result == NULL)
+            {
+                /*Codes_SRS_GATEWAY_17_086: [ The function shall return NULL if any underlying call fails. ]*/
+                LogError("Failed to serialize the startup report");
+            }
+            json_value_free(report);
+        }
+    }
+
+    return result;
+}
+
+void Gateway_DestroyStartupReport(char* report)
+{
+    /*Codes_SRS_GATEWAY_17_087: [ This function shall free `report`. ]*/
+    if (report != NULL)
+    {
+        json_free_serialized_string(report);
+    }
+}
+
+GATEWAY_HANDLE Gateway_Create(const GATEWAY_PROPERTIES* properties)
+{
+    GATEWAY_HANDLE result;
+    /*Codes_SRS_GATEWAY_17_016: [ This function shall initialize the default module loaders. ] */
+    if (ModuleLoader_Initialize() != MODULE_LOADER_SUCCESS)
+    {
+        LogError("Gateway_Create() - ModuleLoader_Initialize failed");
+        result = NULL;
+    }
+    else
+    {
+        result = gateway_create_internal(properties, false);
+        if (result == NULL)
+        {
+            /* Codes_SRS_GATEWAY_27_027: [ Launch - This function shall join any spawned threads upon any failure. ] */
+            /* Codes_SRS_GATEWAY_17_017: [ This function shall destroy the default module loaders upon any failure. ]*/
+            ModuleLoader_Destroy();
+        }
+    }
+
+    return result;
+}
+
+static void start_module(void* context, size_t index)
+{
+    GATEWAY_HANDLE_DATA* gateway_handle = (GATEWAY_HANDLE_DATA*)context;
+    MODULE_DATA** module_data = VECTOR_element(gateway_handle->modules, index);
+    uint64_t begin_us = gateway_clock_now_us();
+    pfModule_Start pfStart = MODULE_START((*module_data)->module_loader->api->GetApi((*module_data)->module_loader, (*module_data)->module_library_handle));
+    if (pfStart != NULL)
+    {
+        uint64_t cpu_before_us = gateway_clock_thread_cpu_us();
+        /*Codes_SRS_GATEWAY_17_100: [ If the loader of a module did not set parallel_create, this function shall call its Module_Start between ModuleLoader_LockModuleCalls and ModuleLoader_UnlockModuleCalls. ]*/
+        bool locked = gateway_lock_module_calls((*module_data)->module_loader);
+        /*Codes_SRS_GATEWAY_17_010: [ This function shall call Module_Start for every module which defines the start function. ]*/
+        (pfStart)((*module_data)->module);
+        gateway_unlock_module_calls((*module_data)->module_loader, locked);
+        /*Codes_SRS_GATEWAY_17_045: [ The function shall charge the thread CPU time `Module_Start` used to the module. ]*/
+        (*module_data)->start_cpu_us += gateway_clock_thread_cpu_us() - cpu_before_us;
+    }
+    /*Codes_SRS_GATEWAY_17_081: [ The first time it is called, this function shall take the time starting each module and all of them took, and the time from the start of the gateway creation to the end of the start. ]*/
+    if (!gateway_handle->startup.finished)
+    {
+        (*module_data)->startup.start_us = gateway_clock_now_us() - begin_us;
+        (*module_data)->startup.started_with_gateway = true;
+    }
+}
+
+GATEWAY_START_RESULT Gateway_Start(GATEWAY_HANDLE gw)
+{
+    GATEWAY_START_RESULT result;
+    if (gw != NULL)
+    {
+        GATEWAY_HANDLE_DATA* gateway_handle = (GATEWAY_HANDLE_DATA*)gw;
+        uint64_t begin_us = gateway_clock_now_us();
+
+        /*Codes_SRS_GATEWAY_17_010: [ This function shall call Module_Start for every module which defines the start function. ]*/
+        /*Codes_SRS_GATEWAY_17_076: [ This function shall start the modules concurrently, on at most GATEWAY_MODULE_THREADS threads including the calling one, one at a time for each loader type that did not set parallel_create, and return once all of them were started. ]*/
+        gateway_run_parallel(VECTOR_size(gateway_handle->modules), start_module, gateway_handle);
+        /*Codes_SRS_GATEWAY_17_012: [ This function shall report a GATEWAY_STARTED event. ]*/
+        EventSystem_ReportEvent(gw->event_system, gw, GATEWAY_STARTED);
+        if (!gateway_handle->startup.finished)
+        {
+            uint64_t end_us = gateway_clock_now_us();
+            /*Codes_SRS_GATEWAY_17_081: [ The first time it is called, this function shall take the time starting each module and all of them took, and the time from the start of the gateway creation to the end of the start. ]*/
+            gateway_handle->startup.start_modules_us = end_us - begin_us;
+            gateway_handle->startup.total_us = end_us - gateway_handle->startup.begin_us;
+            gateway_handle->startup.finished = true;
+            /*Codes_SRS_GATEWAY_17_082: [ The first time it is called, this function shall then report a `GATEWAY_STARTUP_REPORTED` event. ]*/
+            EventSystem_ReportEvent(gw->event_system, gw, GATEWAY_STARTUP_REPORTED);
+        }
+        /*Codes_SRS_GATEWAY_17_013: [ This function shall return GATEWAY_START_SUCCESS upon completion. ]*/
+        result = GATEWAY_START_SUCCESS;
+    }
+    else
+    {
+        /*Codes_SRS_GATEWAY_17_009: [ This function shall return GATEWAY_START_INVALID_ARGS if a NULL gateway is received. ]*/
+        result = GATEWAY_START_INVALID_ARGS;
+    }
+    return result;
+}
+
+void Gateway_Destroy(GATEWAY_HANDLE gw)
+{
+    gateway_destroy_internal(gw);
+    /*Codes_SRS_GATEWAY_17_019: [ The function shall destroy the module loader list. ]*/
+    ModuleLoader_Destroy();
+}
+
+VECTOR_HANDLE Gateway_Shutdown(GATEWAY_HANDLE gw, unsigned int drain_timeout_ms)
+{
+    VECTOR_HANDLE result;
+
+    /*Codes_SRS_GATEWAY_17_088: [ If `gw` is NULL, the function shall do nothing and return NULL. ]*/
+    if (gw == NULL)
+    {
+        LogError("Gateway_Shutdown: gw is NULL");
+        result = NULL;
+    }
+    else
+    {
+        /*the deadline is taken before anything else, stopping the metrics thread included*/
+        uint64_t deadline_us = gateway_clock_now_us() + (uint64_t)drain_timeout_ms * 1000;
+
+        /*Codes_SRS_GATEWAY_17_089: [ The function shall stop the metrics thread first, so load shedding does not change what the modules publish while they drain. ]*/
+        if (gw->metrics != NULL)
+        {
+            gateway_metrics_stop_internal(gw->metrics);
+        }
+
+        result = VECTOR_create(sizeof(GATEWAY_MODULE_DRAIN));
+        if (result == NULL)
+        {
+            /*Codes_SRS_GATEWAY_17_093: [ If the report cannot be built, the function shall still drain and destroy the gateway, and return NULL. ]*/
+            LogError("Failed to create the shutdown report, the modules are drained without it");
+        }
+
+        if (gateway_drain_modules(gw, deadline_us, result) != 0 && result != NULL)
+        {
+            /*Codes_SRS_GATEWAY_17_093: [ If the report cannot be built, the function shall still drain and destroy the gateway, and return NULL. ]*/
+            Gateway_DestroyShutdownReport(result);
+            result = NULL;
+        }
+
+        /*Codes_SRS_GATEWAY_17_092: [ The function shall then destroy the gateway as `Gateway_Destroy` does. ]*/
+        Gateway_Destroy(gw);
+    }
+
+    return result;
+}
+
+void Gateway_DestroyShutdownReport(VECTOR_HANDLE report)
+{
+    if (report != NULL)
+    {
+        size_t count = VECTOR_size(report);
+        size_t i;
+        for (i = 0; i < count; i++)
+        {
+            /*Codes_SRS_GATEWAY_17_094: [ This function shall free every module name and destroy the vector. ]*/
+            free((char*)((GATEWAY_MODULE_DRAIN*)VECTOR_element(report, i))->module_name);
+        }
+        VECTOR_destroy(report);
+    }
+}
+
+MODULE_HANDLE Gateway_AddModule(GATEWAY_HANDLE gw, const GATEWAY_MODULES_ENTRY* entry)
+{
+    MODULE_HANDLE module;
+    /*Codes_SRS_GATEWAY_14_011: [ If gw, entry, or GATEWAY_MODULES_ENTRY's loader_configuration or loader_api is NULL the function shall return NULL. ]*/
+    if (gw != NULL && entry != NULL)
+    {
+        module = gateway_addmodule_internal(gw, entry, false);
+
+        if (module == NULL)
+        {
+            LogError("Gateway_AddModule(): Unable to add module '%s'.", entry->module_name);
+        }
+        else
+        {
+            /*Codes_SRS_GATEWAY_26_011: [ The function shall report `GATEWAY_MODULE_LIST_CHANGED` event after successfully adding the module. ]*/
+            EventSystem_ReportEvent(gw->event_system, gw, GATEWAY_MODULE_LIST_CHANGED);
+        }
+    }
+    else
+    {
+        module = NULL;
+        LogError("Gateway_AddModule(): Unable to add module to NULL GATEWAY_HANDLE or from NULL GATEWAY_MODULES_ENTRY*. gw = %p, entry = %p.", gw, entry);
+    }
+
+    return module;
+}
+
+extern void Gateway_StartModule(GATEWAY_HANDLE gw, MODULE_HANDLE module)
+{
+    if (gw != NULL)
+    {
+        GATEWAY_HANDLE_DATA* gateway_handle = (GATEWAY_HANDLE_DATA*)gw;
+        MODULE_DATA** module_data = (MODULE_DATA**)VECTOR_find_if(gateway_handle->modules, module_data_find, module);
+        if (module_data != NULL)
+        {
+            pfModule_Start pfStart = MODULE_START((*module_data)->module_loader->api->GetApi((*module_data)->module_loader, (*module_data)->module_library_handle));
+            if (pfStart != NULL)
+            {
+                uint64_t cpu_before_us = gateway_clock_thread_cpu_us();
+                /*Codes_SRS_GATEWAY_17_101: [ If the loader of the module did not set parallel_create, the function shall call Module_Start between ModuleLoader_LockModuleCalls and ModuleLoader_UnlockModuleCalls. ]*/
+                bool locked = gateway_lock_module_calls((*module_data)->module_loader);
+                /*Codes_SRS_GATEWAY_17_008: [ When module is found, if the Module_Start function is defined for this module, the Module_Start function shall be called. ]*/
+                (pfStart)((*module_data)->module);
+                gateway_unlock_module_calls((*module_data)->module_loader, locked);
+                /*Codes_SRS_GATEWAY_17_046: [ The function shall charge the thread CPU time `Module_Start` used to the module. ]*/
+                (*module_data)->start_cpu_us += gateway_clock_thread_cpu_us() - cpu_before_us;
+            }
+        }
+        else
+        {
+            /*Codes_SRS_GATEWAY_17_007: [ If module is not found in the gateway, this function shall do nothing. ]*/
+            LogError("Gateway_StartModule(): Failed to start module because the MODULE_DATA not found.");
+        }
+    }
+    else
+    {
+        /*Codes_SRS_GATEWAY_17_006: [ If gw is NULL, this function shall do nothing. ]*/
+        LogError("Gateway_StartModule(): Failed to start module because the GATEWAY_HANDLE is NULL.");
+    }
+}
+
+
+void Gateway_RemoveModule(GATEWAY_HANDLE gw, MODULE_HANDLE module)
+{
+    /*Codes_SRS_GATEWAY_14_020: [ If gw or module is NULL the function shall return. ]*/
+    if (gw != NULL)
+    {
+        GATEWAY_HANDLE_DATA* gateway_handle = (GATEWAY_HANDLE_DATA*)gw;
+
+        /*Codes_SRS_GATEWAY_14_023: [The function shall locate the MODULE_DATA object in GATEWAY_HANDLE_DATA's modules containing module and return if it cannot be found. ]*/
+        MODULE_DATA** module_data = (MODULE_DATA**)VECTOR_find_if(gateway_handle->modules, module_data_find, module);
+
+        if (module_data != NULL)
+        {
+            gateway_removemodule_internal(gateway_handle, module_data);
+            /*Codes_SRS_GATEWAY_26_012: [ The function shall report `GATEWAY_MODULE_LIST_CHANGED` event after successfully removing the module. ]*/
+            EventSystem_ReportEvent(gw->event_system, gw, GATEWAY_MODULE_LIST_CHANGED);
+        }
+        else
+        {
+            LogError("Gateway_RemoveModule(): Failed to remove module because the MODULE_DATA pointer is NULL.");
+        }
+    }
+    else
+    {
+        LogError("Gateway_RemoveModule(): Failed to remove module because the GATEWA_HANDLE is NULL.");
+    }
+}
+
+int Gateway_RemoveModuleByName(GATEWAY_HANDLE gw, const char *module_name)
+{
+    int result;
+    if (gw != NULL && module_name != NULL)
+    {
+        MODULE_DATA **module_data = (MODULE_DATA**)VECTOR_find_if(gw->modules, module_name_find, module_name);
+        if (module_data != NULL)
+        {
+            /* Codes_SRS_GATEWAY_26_016: [** The function shall return 0 if the module was found. ] */
+            result = 0;
+            gateway_removemodule_internal(gw, module_data);
+            EventSystem_ReportEvent(gw->event_system, gw, GATEWAY_MODULE_LIST_CHANGED);
+        }
+        else
+        {
+            /* Codes_SRS_GATEWAY_26_017: [** If module with `module_name` name is not found this function shall return non - zero and do nothing. ] */
+            LogError("Couldn't find module with the specified name");
+            result = __LINE__;
+        }
+    }
+    else
+    {
+        /* Codes_SRS_GATEWAY_26_015: [ If `gw` or `module_name` is `NULL` the function shall do nothing and return with non - zero result. ] */
+        LogError("NULL gateway or module_name given to Gateway_RemoveModuleByName()");
+        result = __LINE__;
+    }
+    return result;
+}
+
+GATEWAY_ADD_LINK_RESULT Gateway_AddLink(GATEWAY_HANDLE gw, const GATEWAY_LINK_ENTRY* entryLink)
+{
+    GATEWAY_ADD_LINK_RESULT result;
+
+    if (gw == NULL || entryLink == NULL || entryLink->module_source == NULL || entryLink->module_sink == NULL)
+    {
+        /*Codes_SRS_GATEWAY_04_008: [ If gw , entryLink, entryLink->module_source or entryLink->module_source is NULL the function shall return GATEWAY_ADD_LINK_INVALID_ARG. ]*/
+        result = GATEWAY_ADD_LINK_INVALID_ARG;
+        LogError("Failed to add link because either the GATEWAY_HANDLE is NULL, entryLink, module_source string is NULL or empty or module_sink is NULL or empty. gw = %p, module_source = '%s', module_sink = '%s'.", gw, entryLink, (entryLink != NULL)? entryLink->module_source:NULL, (entryLink != NULL) ? entryLink->module_sink : NULL);
+    }
+    else
+    {
+        if (!gateway_addlink_internal(gw, entryLink))
+        {
+            /*Codes_SRS_GATEWAY_04_010: [ If the entryLink already exists it the function shall return GATEWAY_ADD_LINK_ERROR ] */
+            /*Codes_SRS_GATEWAY_04_011: [ If the module referenced by the entryLink->module_source or entryLink->module_sink doesn't exists this function shall return GATEWAY_ADD_LINK_ERROR ] */
+            result = GATEWAY_ADD_LINK_ERROR;
+        }
+        else
+        {
+            /*Codes_SRS_GATEWAY_04_013: [ If adding the link succeed this function shall return GATEWAY_ADD_LINK_SUCCESS ]*/
+            result = GATEWAY_ADD_LINK_SUCCESS;
+            /*Codes_SRS_GATEWAY_26_019: [ The function shall report `GATEWAY_MODULE_LIST_CHANGED` event after successfully adding the link. ]*/
+            EventSystem_ReportEvent(gw->event_system, gw, GATEWAY_MODULE_LIST_CHANGED);
+        }
+    }
+
+    return result;
+}
+
+void Gateway_RemoveLink(GATEWAY_HANDLE gw, const GATEWAY_LINK_ENTRY* entryLink)
+{
+    /*Codes_SRS_GATEWAY_04_005: [ If gw or entryLink is NULL the function shall return. ]*/
+    if (gw == NULL || entryLink == NULL)
+    {
+        LogError("Gateway_RemoveLink(): Failed to remove link because the GATEWAY_HANDLE is NULL or entryLink is NULL.");
+    }
+    else
+    {
+        GATEWAY_HANDLE_DATA* gateway_handle = (GATEWAY_HANDLE_DATA*)gw;
+
+        /*Codes_SRS_GATEWAY_04_006: [ The function shall locate the LINK_DATA object in GATEWAY_HANDLE_DATA's links containing link and return if it cannot be found. ]*/
         LINK_DATA* link_data = (LINK_DATA*)VECTOR_find_if(gateway_handle->links, link_data_find, entryLink);
 
-        if (link_data != NULL)
+        if (link_data != NULL)
+        {
+            gateway_removelink_internal(gateway_handle, link_data);
+            /*Codes_SRS_GATEWAY_26_018: [ The function shall report `GATEWAY_MODULE_LIST_CHANGED` event. ]*/
+            EventSystem_ReportEvent(gw->event_system, gw, GATEWAY_MODULE_LIST_CHANGED);
+        }
+        else
+        {
+            LogError("Gateway_RemoveLink(): Could not find link given it's source/sink.");
+        }
+    }
+}
+
+/*Private*/
+
+static GATEWAY_METRICS_DATA* gateway_metrics_create(GATEWAY_HANDLE_DATA* gateway_handle)
+{
+    GATEWAY_METRICS_DATA* result = (GATEWAY_METRICS_DATA*)malloc(sizeof(GATEWAY_METRICS_DATA));
+    if (result == NULL)
+    {
+        LogError("Failed to allocate the gateway metrics");
+    }
+    else
+    {
+        memset(result, 0, sizeof(GATEWAY_METRICS_DATA));
+        result->modules_lock = Lock_Init();
+        result->timer_lock = Lock_Init();
+        result->timer_condition = Condition_Init();
+        result->baselines = VECTOR_create(sizeof(METRICS_BASELINE));
+        result->stuck = VECTOR_create(sizeof(METRICS_BASELINE));
+        result->over_budget = VECTOR_create(sizeof(METRICS_BASELINE));
+        result->shedding_baselines = VECTOR_create(sizeof(METRICS_BASELINE));
+        if (result->modules_lock == NULL || result->timer_lock == NULL || result->timer_condition == NULL || result->baselines == NULL || result->stuck == NULL || result->over_budget == NULL || result->shedding_baselines == NULL)
+        {
+            LogError("Failed to initialize the gateway metrics");
+            gateway_handle->metrics = result;
+            gateway_metrics_destroy_internal(gateway_handle);
+            result = NULL;
+        }
+        else
+        {
+            size_t module_count = VECTOR_size(gateway_handle->modules);
+            size_t i;
+            result->last_snapshot_us = gateway_clock_now_us();
+            for (i = 0; i < module_count; i++)
+            {
+                MODULE_DATA* module_data = *(MODULE_DATA**)VECTOR_element(gateway_handle->modules, i);
+                METRICS_BASELINE baseline;
+                baseline.module = module_data->module;
+                /*a module without a baseline simply reports everything it did so far*/
+                if (Broker_GetModuleMetrics(gateway_handle->broker, baseline.module, &baseline.metrics) != BROKER_OK)
+                {
+                    LogError("Failed to record the metrics baseline of module [%p]", baseline.module);
+                }
+                else
+                {
+                    baseline.cpu_us = baseline.metrics.receive_cpu_us + module_data->start_cpu_us;
+                    if (VECTOR_push_back(result->baselines, &baseline, 1) != 0)
+                    {
+                        LogError("Failed to record the metrics baseline of module [%p]", baseline.module);
+                    }
+                }
+            }
+        }
+    }
+    return result;
+}
+
+static int gateway_timer_set(GATEWAY_HANDLE_DATA* gateway_handle, GATEWAY_TIMER_SETTING setting, unsigned int value_ms)
+{
+    int result;
+
+    /*Codes_SRS_GATEWAY_17_023: [ If `gw` is NULL, the function shall return a non-zero value. ]*/
+    if (gateway_handle == NULL)
+    {
+        LogError("NULL gateway handle given to the metrics timer");
+        result = __LINE__;
+    }
+    else if (gateway_handle->metrics == NULL && value_ms == 0)
+    {
+        /*nothing was ever started*/
+        result = 0;
+    }
+    /*Codes_SRS_GATEWAY_17_024: [ On the first call, the function shall record the current counters of every module as the baseline of the first snapshot. ]*/
+    else if (gateway_handle->metrics == NULL && (gateway_handle->metrics = gateway_metrics_create(gateway_handle)) == NULL)
+    {
+        /*Codes_SRS_GATEWAY_17_029: [ The function shall return a non-zero value if any underlying call fails. ]*/
+        LogError("Failed to create the gateway metrics");
+        result = __LINE__;
+    }
+    else if (Lock(gateway_handle->metrics->timer_lock) != LOCK_OK)
+    {
+        /*Codes_SRS_GATEWAY_17_029: [ The function shall return a non-zero value if any underlying call fails. ]*/
+        LogError("Failed to lock the metrics timer");
+        result = __LINE__;
+    }
+    else
+    {
+        GATEWAY_METRICS_DATA* metrics = gateway_handle->metrics;
+        bool stop;
+        switch (setting)
+        {
+        case GATEWAY_TIMER_INTERVAL:
+            metrics->interval_ms = value_ms;
+            break;
+        case GATEWAY_TIMER_DEADLINE:
+            metrics->deadline_ms = value_ms;
+            break;
+        case GATEWAY_TIMER_MEMORY_CHECKS:
+            metrics->memory_checks = value_ms != 0;
+            break;
+        default:
+            metrics->shedding_ms = value_ms;
+            break;
+        }
+        metrics->reconfigured = true;
+
+        stop = metrics->interval_ms == 0 && metrics->deadline_ms == 0 && !metrics->memory_checks && metrics->shedding_ms == 0;
+        if (stop)
+        {
+            result = 0;
+        }
+        else if (metrics->timer_thread == NULL)
+        {
+            /*Codes_SRS_GATEWAY_17_026: [ The function shall start a thread that reports a `GATEWAY_METRICS_SNAPSHOT` event every `interval_ms` milliseconds. ]*/
+            if (ThreadAPI_Create(&metrics->timer_thread, gateway_metrics_thread, gateway_handle) != THREADAPI_OK)
+            {
+                /*Codes_SRS_GATEWAY_17_029: [ The function shall return a non-zero value if any underlying call fails. ]*/
+                LogError("Failed to start the metrics thread");
+                metrics->interval_ms = 0;
+                metrics->deadline_ms = 0;
+                metrics->memory_checks = false;
+                metrics->shedding_ms = 0;
+                metrics->timer_thread = NULL;
+                result = __LINE__;
+            }
+            else
+            {
+                /*Codes_SRS_GATEWAY_17_027: [ The function shall return 0 on success. ]*/
+                result = 0;
+            }
+        }
+        else
+        {
+            /*Codes_SRS_GATEWAY_17_031: [ If the metrics thread is running, the function shall wake it so the new setting applies immediately. ]*/
+            (void)Condition_Post(metrics->timer_condition);
+            /*Codes_SRS_GATEWAY_17_027: [ The function shall return 0 on success. ]*/
+            result = 0;
+        }
+        (void)Unlock(metrics->timer_lock);
+
+        if (stop)
+        {
+            /*Codes_SRS_GATEWAY_17_028: [ Once neither snapshots, the receive deadline, memory budgets nor load shedding are enabled, the function shall stop and join the metrics thread. ]*/
+            gateway_metrics_stop_internal(metrics);
+        }
+    }
+
+    return result;
+}
+
+static int gateway_metrics_thread(void* param)
+{
+    GATEWAY_HANDLE_DATA* gateway_handle = (GATEWAY_HANDLE_DATA*)param;
+    GATEWAY_METRICS_DATA* metrics = gateway_handle->metrics;
+
+    if (Lock(metrics->timer_lock) != LOCK_OK)
+    {
+        LogError("Failed to lock the metrics timer, no metrics will be reported");
+    }
+    else
+    {
+        uint64_t next_snapshot_us = 0;
+        uint64_t next_check_us = 0;
+        uint64_t next_shedding_us = 0;
+        /*the periods the schedules were last armed with, 0 while a schedule is off*/
+        unsigned int armed_interval_ms = 0;
+        unsigned int armed_check_ms = 0;
+        unsigned int armed_shedding_ms = 0;
+        while (metrics->interval_ms > 0 || metrics->deadline_ms > 0 || metrics->memory_checks || metrics->shedding_ms > 0)
+        {
+            uint64_t now_us = gateway_clock_now_us();
+            bool check_enabled = metrics->deadline_ms > 0 || metrics->memory_checks;
+            bool snapshot_due;
+            bool check_due;
+            bool shedding_due;
+
+            /*the watchdog looks twice per deadline, so a stuck module is seen at most 1.5 deadlines in*/
+            unsigned int check_ms = metrics->deadline_ms == 0 ? GATEWAY_MEMORY_CHECK_MS :
+                metrics->deadline_ms / 2 > 0 ? metrics->deadline_ms / 2 : 1;
+            /*Codes_SRS_GATEWAY_17_103: [ The metrics thread shall keep the absolute time each schedule is next due, and start a schedule over only when a setting changed its period. ]*/
+            if (metrics->reconfigured)
+            {
+                unsigned int new_check_ms = check_enabled ? check_ms : 0;
+                if (metrics->interval_ms != armed_interval_ms)
+                {
+                    next_snapshot_us = now_us + (uint64_t)metrics->interval_ms * 1000;
+                    armed_interval_ms = metrics->interval_ms;
+                }
+                if (new_check_ms != armed_check_ms)
+                {
+                    next_check_us = now_us + (uint64_t)new_check_ms * 1000;
+                    armed_check_ms = new_check_ms;
+                }
+                if (metrics->shedding_ms != armed_shedding_ms)
+                {
+                    next_shedding_us = now_us + (uint64_t)metrics->shedding_ms * 1000;
+                    armed_shedding_ms = metrics->shedding_ms;
+                }
+                metrics->reconfigured = false;
+            }
+
+            snapshot_due = metrics->interval_ms > 0 && now_us >= next_snapshot_us;
+            check_due = check_enabled && now_us >= next_check_us;
+            shedding_due = metrics->shedding_ms > 0 && now_us >= next_shedding_us;
+            if (!snapshot_due && !check_due && !shedding_due)
+            {
+                uint64_t wake_us = UINT64_MAX;
+                uint64_t wait_ms;
+                if (metrics->interval_ms > 0 && next_snapshot_us < wake_us)
+                {
+                    wake_us = next_snapshot_us;
+                }
+                if (check_enabled && next_check_us < wake_us)
+                {
+                    wake_us = next_check_us;
+                }
+                if (metrics->shedding_ms > 0 && next_shedding_us < wake_us)
+                {
+                    wake_us = next_shedding_us;
+                }
+
+                /*a timeout of 0 would wait forever, and the wait takes an int*/
+                wait_ms = (wake_us - now_us + 999) / 1000;
+                if (Condition_Wait(metrics->timer_condition, metrics->timer_lock, wait_ms > INT_MAX ? INT_MAX : (int)wait_ms) == COND_ERROR)
+                {
+                    LogError("Failed to wait on the metrics timer, no further metrics will be reported");
+                    break;
+                }
+                /*whether it was a timeout, a reconfigure or a spurious wake, the next pass works it out from the due times*/
+            }
+            else
+            {
+                bool newly_stuck = false;
+                bool newly_over_budget = false;
+                bool shedding_changed = false;
+                if (snapshot_due)
+                {
+                    next_snapshot_us = now_us + (uint64_t)metrics->interval_ms * 1000;
+                }
+                if (check_due)
+                {
+                    next_check_us = now_us + (uint64_t)check_ms * 1000;
+                }
+                if (shedding_due)
+                {
+                    next_shedding_us = now_us + (uint64_t)metrics->shedding_ms * 1000;
+                }
+
+                (void)Unlock(metrics->timer_lock);
+                if (snapshot_due)
+                {
+                    /*Codes_SRS_GATEWAY_17_026: [ The function shall start a thread that reports a `GATEWAY_METRICS_SNAPSHOT` event every `interval_ms` milliseconds. ]*/
+                    EventSystem_ReportEvent(gateway_handle->event_system, gateway_handle, GATEWAY_METRICS_SNAPSHOT);
+                }
+                if (check_due)
+                {
+                    gateway_watchdog_check(gateway_handle, &newly_stuck, &newly_over_budget);
+                }
+                if (shedding_due)
+                {
+                    shedding_changed = gateway_shedding_check(gateway_handle);
+                }
+                /*Codes_SRS_GATEWAY_17_040: [ The metrics thread shall report `GATEWAY_MODULE_STUCK` once for each `Module_Receive` call that exceeds the deadline. ]*/
+                if (newly_stuck)
+                {
+                    EventSystem_ReportEvent(gateway_handle->event_system, gateway_handle, GATEWAY_MODULE_STUCK);
+                }
+                /*Codes_SRS_GATEWAY_17_054: [ The metrics thread shall report `GATEWAY_MODULE_OVER_BUDGET` once each time a module goes over its memory budget. ]*/
+                if (newly_over_budget)
+                {
+                    EventSystem_ReportEvent(gateway_handle->event_system, gateway_handle, GATEWAY_MODULE_OVER_BUDGET);
+                }
+                /*Codes_SRS_GATEWAY_17_066: [ The metrics thread shall report `GATEWAY_LOAD_SHEDDING_CHANGED` each time the shedding level changes. ]*/
+                if (shedding_changed)
+                {
+                    EventSystem_ReportEvent(gateway_handle->event_system, gateway_handle, GATEWAY_LOAD_SHEDDING_CHANGED);
+                }
+                if (Lock(metrics->timer_lock) != LOCK_OK)
+                {
+                    LogError("Failed to lock the metrics timer, no further metrics will be reported");
+                    return 0;
+                }
+            }
+        }
+        (void)Unlock(metrics->timer_lock);
+    }
+    return 0;
+}
+
+/*finds the modules that got stuck or went over their memory budget since the previous check*/
+static void gateway_watchdog_check(GATEWAY_HANDLE_DATA* gateway_handle, bool* newly_stuck, bool* newly_over_budget)
+{
+    GATEWAY_METRICS_DATA* metrics = gateway_handle->metrics;
+    VECTOR_HANDLE stuck = VECTOR_create(sizeof(METRICS_BASELINE));
+    VECTOR_HANDLE over_budget = VECTOR_create(sizeof(METRICS_BASELINE));
+    if (stuck == NULL || over_budget == NULL)
+    {
+        LogError("Failed to create the watchdog vectors");
+        if (stuck != NULL)
         {
-            gateway_removelink_internal(gateway_handle, link_data);
-            /*Codes_SRS_GATEWAY_26_018: [ The function shall report `GATEWAY_MODULE_LIST_CHANGED` event. ]*/
-            EventSystem_ReportEvent(gw->event_system, gw, GATEWAY_MODULE_LIST_CHANGED);
+            VECTOR_destroy(stuck);
+        }
+        if (over_budget != NULL)
+        {
+            VECTOR_destroy(over_budget);
+        }
+    }
+    else if (Lock(metrics->modules_lock) != LOCK_OK)
+    {
+        LogError("Failed to lock the gateway modules");
+        VECTOR_destroy(stuck);
+        VECTOR_destroy(over_budget);
+    }
+    else
+    {
+        uint64_t deadline_us = (uint64_t)metrics->deadline_ms * 1000;
+        size_t module_count = VECTOR_size(gateway_handle->modules);
+        size_t i;
+        for (i = 0; i < module_count; i++)
+        {
+            METRICS_BASELINE current;
+            current.module = (*(MODULE_DATA**)VECTOR_element(gateway_handle->modules, i))->module;
+            if (Broker_GetModuleMetrics(gateway_handle->broker, current.module, &current.metrics) != BROKER_OK)
+            {
+                continue;
+            }
+            if (deadline_us > 0 && current.metrics.receive_elapsed_us >= deadline_us)
+            {
+                /*the counters only move once Module_Receive returns, so unchanged counters mean the same call*/
+                METRICS_BASELINE* previous = (METRICS_BASELINE*)VECTOR_find_if(metrics->stuck, baseline_module_find, current.module);
+                if (previous == NULL ||
+                    previous->metrics.messages_received != current.metrics.messages_received ||
+                    previous->metrics.messages_dropped != current.metrics.messages_dropped)
+                {
+                    *newly_stuck = true;
+                }
+                if (VECTOR_push_back(stuck, &current, 1) != 0)
+                {
+                    LogError("Failed to remember a stuck module, it may be reported again");
+                }
+            }
+            if (current.metrics.memory_budget > 0 && current.metrics.memory_live_bytes > current.metrics.memory_budget)
+            {
+                /*a module is reported when it goes over, not for as long as it stays over*/
+                if (VECTOR_find_if(metrics->over_budget, baseline_module_find, current.module) == NULL)
+                {
+                    *newly_over_budget = true;
+                }
+                if (VECTOR_push_back(over_budget, &current, 1) != 0)
+                {
+                    LogError("Failed to remember a module over budget, it may be reported again");
+                }
+            }
+        }
+
+        VECTOR_destroy(metrics->stuck);
+        metrics->stuck = stuck;
+        VECTOR_destroy(metrics->over_budget);
+        metrics->over_budget = over_budget;
+        (void)Unlock(metrics->modules_lock);
+    }
+}
+
+/*reads the load of the gateway and moves the shedding level by one step, returns whether it moved*/
+static bool gateway_shedding_check(GATEWAY_HANDLE_DATA* gateway_handle)
+{
+    bool result = false;
+    GATEWAY_METRICS_DATA* metrics = gateway_handle->metrics;
+    VECTOR_HANDLE baselines = VECTOR_create(sizeof(METRICS_BASELINE));
+    if (baselines == NULL)
+    {
+        LogError("Failed to create the load shedding baselines");
+    }
+    else if (Lock(metrics->modules_lock) != LOCK_OK)
+    {
+        LogError("Failed to lock the gateway modules");
+        VECTOR_destroy(baselines);
+    }
+    else
+    {
+        const GATEWAY_LOAD_SHEDDING* shedding = &metrics->shedding;
+        uint64_t now_us = gateway_clock_now_us();
+        uint64_t cpu_us = gateway_clock_process_cpu_us();
+        uint64_t queue_delay_us = 0;
+        size_t memory_bytes = 0;
+        unsigned int cpu_percent;
+        unsigned int top_level = 0;
+        unsigned int level = metrics->shedding_state.level;
+        size_t module_count = VECTOR_size(gateway_handle->modules);
+        size_t i;
+        for (i = 0; i < module_count; i++)
+        {
+            METRICS_BASELINE current;
+            METRICS_BASELINE* previous;
+            uint64_t wait_us;
+            current.module = (*(MODULE_DATA**)VECTOR_element(gateway_handle->modules, i))->module;
+            current.cpu_us = 0;
+            if (Broker_GetModuleMetrics(gateway_handle->broker, current.module, &current.metrics) != BROKER_OK)
+            {
+                continue;
+            }
+            memory_bytes += current.metrics.memory_live_bytes;
+
+            /*nanomsg does not tell how many messages are queued, but how long they waited grows with the queue; a module stuck in Module_Receive makes its messages wait at least that long*/
+            wait_us = current.metrics.receive_elapsed_us;
+            previous = (METRICS_BASELINE*)VECTOR_find_if(metrics->shedding_baselines, baseline_module_find, current.module);
+            if (previous != NULL && current.metrics.messages_received > previous->metrics.messages_received)
+            {
+                uint64_t average_us = (current.metrics.queue_wait_us - previous->metrics.queue_wait_us) /
+                    (current.metrics.messages_received - previous->metrics.messages_received);
+                if (average_us > wait_us)
+                {
+                    wait_us = average_us;
+                }
+            }
+            if (wait_us > queue_delay_us)
+            {
+                queue_delay_us = wait_us;
+            }
+            if (VECTOR_push_back(baselines, &current, 1) != 0)
+            {
+                LogError("Failed to remember the load of a module, its queue is not checked next time");
+            }
+        }
+        cpu_percent = now_us > metrics->shedding_check_us && cpu_us > metrics->shedding_cpu_us ?
+            (unsigned int)((cpu_us - metrics->shedding_cpu_us) * 100 / (now_us - metrics->shedding_check_us)) : 0;
+
+        for (i = 0; i < shedding->rule_count; i++)
+        {
+            if (shedding->rules[i].level > top_level)
+            {
+                top_level = shedding->rules[i].level;
+            }
+        }
+        if (level < top_level &&
+            ((shedding->max_queue_delay_ms > 0 && queue_delay_us >= (uint64_t)shedding->max_queue_delay_ms * 1000) ||
+            (shedding->max_cpu_percent > 0 && cpu_percent >= shedding->max_cpu_percent) ||
+            (shedding->max_memory_bytes > 0 && memory_bytes >= shedding->max_memory_bytes)))
+        {
+            /*Codes_SRS_GATEWAY_17_063: [ The metrics thread shall raise the shedding level by one, up to the highest level of the rules, when the queue delay, CPU or memory is at or over its non-zero maximum. ]*/
+            level++;
+        }
+        else if (level > 0 &&
+            (shedding->max_queue_delay_ms == 0 || queue_delay_us * 100 < (uint64_t)shedding->max_queue_delay_ms * 1000 * GATEWAY_SHEDDING_RELEASE_PERCENT) &&
+            (shedding->max_cpu_percent == 0 || cpu_percent * 100 < shedding->max_cpu_percent * GATEWAY_SHEDDING_RELEASE_PERCENT) &&
+            (shedding->max_memory_bytes == 0 || memory_bytes < shedding->max_memory_bytes / 100 * GATEWAY_SHEDDING_RELEASE_PERCENT))
+        {
+            /*Codes_SRS_GATEWAY_17_064: [ The metrics thread shall lower the shedding level by one once every reading with a non-zero maximum is under 80% of it. ]*/
+            level--;
+        }
+
+        if (level != metrics->shedding_state.level)
+        {
+            metrics->shedding_state.previous_level = metrics->shedding_state.level;
+            metrics->shedding_state.level = level;
+            metrics->shedding_state.queue_delay_us = queue_delay_us;
+            metrics->shedding_state.cpu_percent = cpu_percent;
+            metrics->shedding_state.memory_bytes = memory_bytes;
+            result = true;
+        }
+        /*modules may have been added since the level changed, so the rules stay applied for as long as something is shed*/
+        if (result || level > 0)
+        {
+            /*Codes_SRS_GATEWAY_17_065: [ The metrics thread shall have the broker shed what the rules up to the current level ask for from their modules with `Broker_SetModuleShedding`. ]*/
+            gateway_shedding_apply(gateway_handle, true);
+        }
+
+        VECTOR_destroy(metrics->shedding_baselines);
+        metrics->shedding_baselines = baselines;
+        metrics->shedding_check_us = now_us;
+        metrics->shedding_cpu_us = cpu_us;
+        (void)Unlock(metrics->modules_lock);
+    }
+    return result;
+}
+
+/*sets what the broker sheds for every module that has a rule, nothing if shed is false; modules_lock must be held*/
+static void gateway_shedding_apply(GATEWAY_HANDLE_DATA* gateway_handle, bool shed)
+{
+    const GATEWAY_LOAD_SHEDDING* shedding = &gateway_handle->metrics->shedding;
+    unsigned int level = gateway_handle->metrics->shedding_state.level;
+    size_t i;
+    for (i = 0; i < shedding->rule_count; i++)
+    {
+        const char* module_name = shedding->rules[i].module_name;
+        MODULE_DATA** module_data = (MODULE_DATA**)VECTOR_find_if(gateway_handle->modules, module_name_find, module_name);
+        BROKER_MODULE_SHEDDING module_shedding;
+        size_t j;
+
+        /*a module with several rules is set once, at its first rule*/
+        for (j = 0; j < i && strcmp(shedding->rules[j].module_name, module_name) != 0; j++)
+        {
+        }
+        if (module_data == NULL || j < i)
+        {
+            continue;
+        }
+
+        memset(&module_shedding, 0, sizeof(BROKER_MODULE_SHEDDING));
+        for (j = i; shed && j < shedding->rule_count; j++)
+        {
+            const GATEWAY_SHEDDING_RULE* rule = &shedding->rules[j];
+            if (rule->level <= level && strcmp(rule->module_name, module_name) == 0)
+            {
+                switch (rule->action)
+                {
+                case GATEWAY_SHEDDING_DROP_INBOUND:
+                    module_shedding.drop_inbound = true;
+                    break;
+                case GATEWAY_SHEDDING_SAMPLE_INBOUND:
+                    if (rule->sample_every > module_shedding.inbound_sample_every)
+                    {
+                        module_shedding.inbound_sample_every = rule->sample_every;
+                    }
+                    break;
+                default:
+                    module_shedding.pause_publishing = true;
+                    break;
+                }
+            }
+        }
+        if (Broker_SetModuleShedding(gateway_handle->broker, (*module_data)->module, &module_shedding) != BROKER_OK)
+        {
+            LogError("Failed to set what is shed from module %s", module_name);
+        }
+    }
+}
+
+static int gateway_shedding_copy(GATEWAY_LOAD_SHEDDING* destination, const GATEWAY_LOAD_SHEDDING* source)
+{
+    int result;
+    if (source->check_interval_ms == 0 || (source->rules == NULL && source->rule_count > 0))
+    {
+        LogError("Load shedding needs a check interval and rules");
+        result = __LINE__;
+    }
+    else
+    {
+        size_t i;
+        for (i = 0; i < source->rule_count; i++)
+        {
+            const GATEWAY_SHEDDING_RULE* rule = &source->rules[i];
+            if (rule->module_name == NULL || rule->level == 0 ||
+                (rule->action != GATEWAY_SHEDDING_DROP_INBOUND && rule->action != GATEWAY_SHEDDING_SAMPLE_INBOUND && rule->action != GATEWAY_SHEDDING_PAUSE_SOURCE) ||
+                (rule->action == GATEWAY_SHEDDING_SAMPLE_INBOUND && rule->sample_every < 2))
+            {
+                LogError("Invalid load shedding rule %zu", i);
+                break;
+            }
+        }
+
+        if (i < source->rule_count)
+        {
+            result = __LINE__;
         }
         else
         {
-            LogError("Gateway_RemoveLink(): Could not find link given it's source/sink.");
+            *destination = *source;
+            destination->rules = NULL;
+            destination->rule_count = 0;
+            if (source->rule_count == 0)
+            {
+                result = 0;
+            }
+            else if ((destination->rules = (GATEWAY_SHEDDING_RULE*)malloc(source->rule_count * sizeof(GATEWAY_SHEDDING_RULE))) == NULL)
+            {
+                LogError("Failed to allocate the load shedding rules");
+                result = __LINE__;
+            }
+            else
+            {
+                GATEWAY_SHEDDING_RULE* rules = (GATEWAY_SHEDDING_RULE*)destination->rules;
+                for (i = 0; i < source->rule_count; i++)
+                {
+                    rules[i] = source->rules[i];
+                    if (mallocAndStrcpy_s((char**)&rules[i].module_name, source->rules[i].module_name) != 0)
+                    {
+                        LogError("Failed to copy the load shedding rule of module %s", source->rules[i].module_name);
+                        break;
+                    }
+                    destination->rule_count++;
+                }
+
+                if (i < source->rule_count)
+                {
+                    gateway_shedding_free(destination);
+                    result = __LINE__;
+                }
+                else
+                {
+                    result = 0;
+                }
+            }
         }
     }
+    return result;
 }
 
-/*Private*/
+static uint64_t latency_percentile(const size_t* buckets, size_t total, size_t percent)
+{
+    uint64_t result = 0;
+    if (total > 0)
+    {
+        /*the rank of the sample that sits on the percentile, counted from 1*/
+        size_t rank = (total * percent + 99) / 100;
+        size_t seen = 0;
+        size_t i;
+        for (i = 0; i < BROKER_LATENCY_BUCKET_COUNT; i++)
+        {
+            seen += buckets[i];
+            if (seen >= rank)
+            {
+                break;
+            }
+        }
+        result = (uint64_t)1 << (i < BROKER_LATENCY_BUCKET_COUNT ? i : BROKER_LATENCY_BUCKET_COUNT - 1);
+    }
+    return result;
+}
+
+static bool baseline_module_find(const void* element, const void* value)
+{
+    return ((const METRICS_BASELINE*)element)->module == value;
+}
 
 static void gateway_destroymodulelist_internal(GATEWAY_MODULE_INFO* infos, size_t count)
 {
@@ -396,8 +1624,241 @@ static bool module_data_find(const void* element, const void* value)
     return (*(MODULE_DATA**)element)->module == value;
 }
 
+/*whether a module that was not drained yet links to the module at index*/
+static bool gateway_module_has_upstream(const GATEWAY_HANDLE_DATA* gateway_handle, const bool* drained, size_t index)
+{
+    MODULE_DATA* module_data = *(MODULE_DATA**)VECTOR_element(gateway_handle->modules, index);
+    size_t module_count = VECTOR_size(gateway_handle->modules);
+    size_t link_count = VECTOR_size(gateway_handle->links);
+    size_t i;
+    size_t j;
+    bool result = false;
+    for (i = 0; !result && i < link_count; i++)
+    {
+        const LINK_DATA* link_data = (const LINK_DATA*)VECTOR_element(gateway_handle->links, i);
+        if (link_data->module_sink == module_data)
+        {
+            for (j = 0; !result && j < module_count; j++)
+            {
+                MODULE_DATA* source = *(MODULE_DATA**)VECTOR_element(gateway_handle->modules, j);
+                result = !drained[j] && source != module_data &&
+                    (link_data->from_any_source || link_data->module_source == source);
+            }
+        }
+    }
+    return result;
+}
+
+/*returns 0 if every drained module was added to report, __LINE__ otherwise*/
+static int gateway_drain_modules(GATEWAY_HANDLE_DATA* gateway_handle, uint64_t deadline_us, VECTOR_HANDLE report)
+{
+    int result;
+    size_t module_count = VECTOR_size(gateway_handle->modules);
+    bool* drained;
+    if (module_count == 0)
+    {
+        /*nothing to drain, the report stays empty*/
+        result = 0;
+    }
+    else if ((drained = (bool*)malloc(module_count * sizeof(bool))) == NULL)
+    {
+        /*Codes_SRS_GATEWAY_17_093: [ If the report cannot be built, the function shall still drain and destroy the gateway, and return NULL. ]*/
+        LogError("Failed to order the modules, they are destroyed without draining");
+        result = __LINE__;
+    }
+    else
+    {
+        size_t drained_count;
+        result = 0;
+        memset(drained, 0, module_count * sizeof(bool));
+        for (drained_count = 0; drained_count < module_count; drained_count++)
+        {
+            MODULE_DATA* module_data;
+            GATEWAY_MODULE_DRAIN entry;
+            BROKER_MODULE_DRAIN drain;
+            uint64_t now_us;
+            size_t next;
+
+            /*Codes_SRS_GATEWAY_17_090: [ The function shall drain each module with `Broker_DrainModule` after the modules that link to it, and the modules of a cycle in the order they were added. ]*/
+            for (next = 0; next < module_count && (drained[next] || gateway_module_has_upstream(gateway_handle, drained, next)); next++)
+            {
+            }
+            if (next == module_count)
+            {
+                for (next = 0; drained[next]; next++)
+                {
+                }
+            }
+            drained[next] = true;
+            module_data = *(MODULE_DATA**)VECTOR_element(gateway_handle->modules, next);
+
+            /*Codes_SRS_GATEWAY_17_091: [ The modules shall share one deadline, `drain_timeout_ms` from the call, each being given what is left of it, and the function shall report the messages each module drained and abandoned. ]*/
+            now_us = gateway_clock_now_us();
+            if (Broker_DrainModule(gateway_handle->broker, module_data->module,
+                now_us < deadline_us ? (unsigned int)((deadline_us - now_us) / 1000) : 0, &drain) != BROKER_OK)
+            {
+                LogError("Failed to drain module %s, its messages are discarded", module_data->module_name);
+            }
+            else if (report != NULL && result == 0)
+            {
+                entry.messages_drained = drain.messages_drained;
+                entry.messages_abandoned = drain.messages_abandoned;
+                if (mallocAndStrcpy_s((char**)&entry.module_name, module_data->module_name) != 0)
+                {
+                    LogError("Failed to copy the name of module %s", module_data->module_name);
+                    result = __LINE__;
+                }
+                else if (VECTOR_push_back(report, &entry, 1) != 0)
+                {
+                    LogError("Failed to report how module %s drained", module_data->module_name);
+                    free((char*)entry.module_name);
+                    result = __LINE__;
+                }
+            }
+        }
+        free(drained);
+    }
+    return result;
+}
+
 static bool module_info_name_find(const void* element, const void* module_name)
 {
     const char* name = (const char*)module_name;
     return (strcmp(((GATEWAY_MODULE_INFO*)element)->module_name, name) == 0);
 }
+
+/*adds an empty array named name to object, which owns it from then on*/
+static JSON_Array* report_set_array(JSON_Object* object, const char* name)
+{
+    JSON_Array* result;
+    JSON_Value* value = json_value_init_array();
+    if (value == NULL)
+    {
+        result = NULL;
+    }
+    else if (json_object_set_value(object, name, value) != JSONSuccess)
+    {
+        json_value_free(value);
+        result = NULL;
+    }
+    else
+    {
+        result = json_value_get_array(value);
+    }
+    return result;
+}
+
+/*appends an empty object to array, which owns it from then on*/
+static JSON_Object* report_append_object(JSON_Array* array)
+{
+    JSON_Object* result;
+    JSON_Value* value = json_value_init_object();
+    if (value == NULL)
+    {
+        result = NULL;
+    }
+    else if (json_array_append_value(array, value) != JSONSuccess)
+    {
+        json_value_free(value);
+        result = NULL;
+    }
+    else
+    {
+        result = json_value_get_object(value);
+    }
+    return result;
+}
+
+static int report_add_module(JSON_Array* modules, const MODULE_DATA* module_data)
+{
+    const MODULE_STARTUP_TIMES* times = &module_data->startup;
+    JSON_Object* entry = report_append_object(modules);
+    return (entry == NULL ||
+        json_object_set_string(entry, "name", module_data->module_name) != JSONSuccess ||
+        json_object_set_number(entry, "parse_entrypoint_us", (double)times->parse_entrypoint_us) != JSONSuccess ||
+        json_object_set_number(entry, "load_us", (double)times->load_us) != JSONSuccess ||
+        json_object_set_number(entry, "parse_configuration_us", (double)times->parse_configuration_us) != JSONSuccess ||
+        json_object_set_number(entry, "create_us", (double)times->create_us) != JSONSuccess ||
+        json_object_set_number(entry, "add_to_broker_us", (double)times->add_to_broker_us) != JSONSuccess ||
+        json_object_set_number(entry, "links_us", (double)times->links_us) != JSONSuccess ||
+        json_object_set_number(entry, "start_us", (double)times->start_us) != JSONSuccess) ? __LINE__ : 0;
+}
+
+static int report_add_phase(JSON_Array* critical_path, const char* phase, uint64_t us, const MODULE_DATA* slowest)
+{
+    JSON_Object* entry = report_append_object(critical_path);
+    return (entry == NULL ||
+        json_object_set_string(entry, "phase", phase) != JSONSuccess ||
+        json_object_set_number(entry, "us", (double)us) != JSONSuccess ||
+        (slowest != NULL && json_object_set_string(entry, "module", slowest->module_name) != JSONSuccess)) ? __LINE__ : 0;
+}
+
+static JSON_Value* gateway_create_startup_report(const GATEWAY_HANDLE_DATA* gateway_handle)
+{
+    JSON_Value* result = json_value_init_object();
+    if (result == NULL)
+    {
+        LogError("Failed to create the startup report object");
+    }
+    else
+    {
+        const GATEWAY_STARTUP_DATA* startup = &gateway_handle->startup;
+        const MODULE_DATA* slowest_create = NULL;
+        const MODULE_DATA* slowest_start = NULL;
+        JSON_Object* report = json_value_get_object(result);
+        JSON_Array* modules;
+        JSON_Array* critical_path;
+        int failed;
+
+        if (json_object_set_number(report, "total_us", (double)startup->total_us) != JSONSuccess ||
+            (modules = report_set_array(report, "modules")) == NULL)
+        {
+            failed = __LINE__;
+        }
+        else
+        {
+            size_t module_count = VECTOR_size(gateway_handle->modules);
+            size_t i;
+            failed = 0;
+            for (i = 0; failed == 0 && i < module_count; i++)
+            {
+                const MODULE_DATA* module_data = *(MODULE_DATA**)VECTOR_element(gateway_handle->modules, i);
+                const MODULE_STARTUP_TIMES* times = &module_data->startup;
+                if (times->started_with_gateway)
+                {
+                    failed = report_add_module(modules, module_data);
+
+                    if (slowest_create == NULL || times->create_us > slowest_create->startup.create_us)
+                    {
+                        slowest_create = module_data;
+                    }
+                    if (slowest_start == NULL || times->start_us > slowest_start->startup.start_us)
+                    {
+                        slowest_start = module_data;
+                    }
+                }
+            }
+        }
+
+        /*the phases run one after the other, so the slowest module of each parallel phase is what holds the startup back*/
+        if (failed == 0 &&
+            ((critical_path = report_set_array(report, "critical_path")) == NULL ||
+            report_add_phase(critical_path, "parse_json", startup->parse_json_us, NULL) != 0 ||
+            report_add_phase(critical_path, "load_modules", startup->load_modules_us, NULL) != 0 ||
+            report_add_phase(critical_path, "create_modules", startup->create_modules_us, slowest_create) != 0 ||
+            report_add_phase(critical_path, "add_modules", startup->add_modules_us, NULL) != 0 ||
+            report_add_phase(critical_path, "links", startup->links_us, NULL) != 0 ||
+            report_add_phase(critical_path, "start_modules", startup->start_modules_us, slowest_start) != 0))
+        {
+            failed = __LINE__;
+        }
+
+        if (failed != 0)
+        {
+            LogError("Failed to fill in the startup report, line %d", failed);
+            json_value_free(result);
+            result = NULL;
+        }
+    }
+    return result;
+}
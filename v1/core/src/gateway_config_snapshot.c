@@ -0,0 +1,428 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/xlogging.h"
+
+#include "internal/gateway_config_snapshot.h"
+
+#ifdef GATEWAY_CONFIG_SNAPSHOT_ENABLED
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/*"GWCS" read as a little endian number, so a snapshot written on a machine of the other byte order does not match*/
+#define SNAPSHOT_MAGIC 0x53435747
+#define SNAPSHOT_VERSION 2
+#define SNAPSHOT_TEMPORARY_SUFFIX ".tmp"
+
+/*all offsets count from the start of the file; 0 is the header, so it stands for NULL*/
+typedef struct SNAPSHOT_HEADER_TAG
+{
+    uint32_t magic;
+    uint32_t version;
+    uint64_t source_hash;
+    uint64_t size;
+    uint32_t module_count;
+    uint32_t link_count;
+    uint32_t loaders;
+    uint32_t reserved;
+} SNAPSHOT_HEADER;
+
+typedef struct SNAPSHOT_MODULE_TAG
+{
+    uint64_t configuration_hash;
+    uint32_t module_name;
+    uint32_t loader_name;
+    uint32_t entrypoint;
+    uint32_t args;
+    uint32_t activation;
+    uint32_t reserved;
+} SNAPSHOT_MODULE;
+
+typedef struct SNAPSHOT_LINK_TAG
+{
+    uint32_t module_source;
+    uint32_t module_sink;
+} SNAPSHOT_LINK;
+
+typedef struct GATEWAY_CONFIG_SNAPSHOT_TAG
+{
+    const char* mapping;
+    size_t size;
+    const SNAPSHOT_HEADER* header;
+    const SNAPSHOT_MODULE* modules;
+    const SNAPSHOT_LINK* links;
+} GATEWAY_CONFIG_SNAPSHOT;
+
+static uint64_t hash_bytes(uint64_t hash, const unsigned char* bytes, size_t length)
+{
+    size_t i;
+    for (i = 0; i < length; i++)
+    {
+        hash = (hash ^ bytes[i]) * 1099511628211ULL;
+    }
+    return hash;
+}
+
+char* GatewayConfigSnapshot_ReadSource(const char* file_path, uint64_t* source_hash)
+{
+    char* result;
+    if (file_path == NULL || source_hash == NULL)
+    {
+        /*Codes_SRS_GATEWAY_SNAPSHOT_17_001: [ If file_path or source_hash is NULL, GatewayConfigSnapshot_ReadSource shall return NULL. ]*/
+        LogError("Invalid argument file_path = %p, source_hash = %p.", file_path, source_hash);
+        result = NULL;
+    }
+    else
+    {
+        FILE* file = fopen(file_path, "rb");
+        if (file == NULL)
+        {
+            /*Codes_SRS_GATEWAY_SNAPSHOT_17_003: [ GatewayConfigSnapshot_ReadSource shall return NULL if the file cannot be read or any underlying call fails. ]*/
+            LogError("unable to open %s", file_path);
+            result = NULL;
+        }
+        else
+        {
+            long size;
+            if (fseek(file, 0, SEEK_END) != 0 || (size = ftell(file)) < 0 || fseek(file, 0, SEEK_SET) != 0)
+            {
+                /*Codes_SRS_GATEWAY_SNAPSHOT_17_003: [ GatewayConfigSnapshot_ReadSource shall return NULL if the file cannot be read or any underlying call fails. ]*/
+                LogError("unable to get the size of %s", file_path);
+                result = NULL;
+            }
+            else if ((result = (char*)malloc((size_t)size + 1)) == NULL)
+            {
+                /*Codes_SRS_GATEWAY_SNAPSHOT_17_003: [ GatewayConfigSnapshot_ReadSource shall return NULL if the file cannot be read or any underlying call fails. ]*/
+                LogError("unable to allocate the content of %s", file_path);
+            }
+            else if (fread(result, 1, (size_t)size, file) != (size_t)size)
+            {
+                /*Codes_SRS_GATEWAY_SNAPSHOT_17_003: [ GatewayConfigSnapshot_ReadSource shall return NULL if the file cannot be read or any underlying call fails. ]*/
+                LogError("unable to read %s", file_path);
+                free(result);
+                result = NULL;
+            }
+            else
+            {
+                /*Codes_SRS_GATEWAY_SNAPSHOT_17_002: [ GatewayConfigSnapshot_ReadSource shall return the content of the file, NUL terminated, and set source_hash to the FNV-1a hash of it. ]*/
+                result[size] = '\0';
+                *source_hash = hash_bytes(14695981039346656037ULL, (const unsigned char*)result, (size_t)size);
+            }
+            (void)fclose(file);
+        }
+    }
+    return result;
+}
+
+static size_t string_size(const char* value)
+{
+    return value == NULL ? 0 : strlen(value) + 1;
+}
+
+/*copies value to the string block at *next and returns its offset, 0 for NULL*/
+static uint32_t put_string(char* buffer, size_t* next, const char* value)
+{
+    uint32_t result;
+    if (value == NULL)
+    {
+        result = 0;
+    }
+    else
+    {
+        size_t length = strlen(value) + 1;
+        (void)memcpy(buffer + *next, value, length);
+        result = (uint32_t)*next;
+        *next += length;
+    }
+    return result;
+}
+
+int GatewayConfigSnapshot_Write(const char* snapshot_path, uint64_t source_hash, const char* loaders, const GATEWAY_CONFIG_SNAPSHOT_MODULE* modules, size_t module_count, const GATEWAY_LINK_ENTRY* links, size_t link_count)
+{
+    int result;
+    if (snapshot_path == NULL || (modules == NULL && module_count > 0) || (links == NULL && link_count > 0))
+    {
+        /*Codes_SRS_GATEWAY_SNAPSHOT_17_004: [ If snapshot_path is NULL, or modules or links is NULL while its count is not 0, GatewayConfigSnapshot_Write shall fail and return a non-zero value. ]*/
+        LogError("Invalid argument snapshot_path = %p, modules = %p, module_count = %lu, links = %p, link_count = %lu.",
+            snapshot_path, modules, (unsigned long)module_count, links, (unsigned long)link_count);
+        result = __LINE__;
+    }
+    else
+    {
+        size_t tables_size = sizeof(SNAPSHOT_HEADER) + module_count * sizeof(SNAPSHOT_MODULE) + link_count * sizeof(SNAPSHOT_LINK);
+        size_t size = tables_size + string_size(loaders);
+        size_t i;
+        for (i = 0; i < module_count; i++)
+        {
+            size += string_size(modules[i].module_name) + string_size(modules[i].loader_name) +
+                string_size(modules[i].entrypoint) + string_size(modules[i].args) + string_size(modules[i].activation);
+        }
+        for (i = 0; i < link_count; i++)
+        {
+            size += string_size(links[i].module_source) + string_size(links[i].module_sink);
+        }
+
+        if (size > UINT32_MAX)
+        {
+            /*Codes_SRS_GATEWAY_SNAPSHOT_17_006: [ If any underlying call fails, GatewayConfigSnapshot_Write shall remove the file it wrote to, fail and return a non-zero value. ]*/
+            LogError("the configuration is too large for a snapshot");
+            result = __LINE__;
+        }
+        else
+        {
+            size_t path_length = strlen(snapshot_path);
+            char* temporary_path = (char*)malloc(path_length + sizeof(SNAPSHOT_TEMPORARY_SUFFIX));
+            char* buffer = (char*)malloc(size);
+            if (temporary_path == NULL || buffer == NULL)
+            {
+                /*Codes_SRS_GATEWAY_SNAPSHOT_17_006: [ If any underlying call fails, GatewayConfigSnapshot_Write shall remove the file it wrote to, fail and return a non-zero value. ]*/
+                LogError("unable to allocate the snapshot of %lu bytes", (unsigned long)size);
+                result = __LINE__;
+            }
+            else
+            {
+                SNAPSHOT_HEADER* header = (SNAPSHOT_HEADER*)buffer;
+                SNAPSHOT_MODULE* module_table = (SNAPSHOT_MODULE*)(buffer + sizeof(SNAPSHOT_HEADER));
+                SNAPSHOT_LINK* link_table = (SNAPSHOT_LINK*)(buffer + sizeof(SNAPSHOT_HEADER) + module_count * sizeof(SNAPSHOT_MODULE));
+                size_t next = tables_size;
+                FILE* file;
+
+                /*Codes_SRS_GATEWAY_SNAPSHOT_17_005: [ GatewayConfigSnapshot_Write shall write source_hash, loaders, every module and every link to snapshot_path followed by .tmp and then rename it to snapshot_path. ]*/
+                /*zeroed, so the padding of the tables does not carry whatever the heap held*/
+                (void)memset(buffer, 0, tables_size);
+                header->magic = SNAPSHOT_MAGIC;
+                header->version = SNAPSHOT_VERSION;
+                header->source_hash = source_hash;
+                header->size = size;
+                header->module_count = (uint32_t)module_count;
+                header->link_count = (uint32_t)link_count;
+                header->loaders = put_string(buffer, &next, loaders);
+                for (i = 0; i < module_count; i++)
+                {
+                    module_table[i].configuration_hash = modules[i].configuration_hash;
+                    module_table[i].module_name = put_string(buffer, &next, modules[i].module_name);
+                    module_table[i].loader_name = put_string(buffer, &next, modules[i].loader_name);
+                    module_table[i].entrypoint = put_string(buffer, &next, modules[i].entrypoint);
+                    module_table[i].args = put_string(buffer, &next, modules[i].args);
+                    module_table[i].activation = put_string(buffer, &next, modules[i].activation);
+                }
+                for (i = 0; i < link_count; i++)
+                {
+                    link_table[i].module_source = put_string(buffer, &next, links[i].module_source);
+                    link_table[i].module_sink = put_string(buffer, &next, links[i].module_sink);
+                }
+
+                (void)memcpy(temporary_path, snapshot_path, path_length);
+                (void)memcpy(temporary_path + path_length, SNAPSHOT_TEMPORARY_SUFFIX, sizeof(SNAPSHOT_TEMPORARY_SUFFIX));
+                if ((file = fopen(temporary_path, "wb")) == NULL)
+                {
+                    /*Codes_SRS_GATEWAY_SNAPSHOT_17_006: [ If any underlying call fails, GatewayConfigSnapshot_Write shall remove the file it wrote to, fail and return a non-zero value. ]*/
+                    LogError("unable to open %s for writing", temporary_path);
+                    result = __LINE__;
+                }
+                else
+                {
+                    size_t written = fwrite(buffer, 1, size, file);
+                    int close_result = fclose(file);
+                    if (written != size || close_result != 0 || rename(temporary_path, snapshot_path) != 0)
+                    {
+                        /*Codes_SRS_GATEWAY_SNAPSHOT_17_006: [ If any underlying call fails, GatewayConfigSnapshot_Write shall remove the file it wrote to, fail and return a non-zero value. ]*/
+                        LogError("unable to write the snapshot %s", snapshot_path);
+                        (void)remove(temporary_path);
+                        result = __LINE__;
+                    }
+                    else
+                    {
+                        /*Codes_SRS_GATEWAY_SNAPSHOT_17_007: [ GatewayConfigSnapshot_Write shall return 0 upon success. ]*/
+                        result = 0;
+                    }
+                }
+            }
+            free(buffer);
+            free(temporary_path);
+        }
+    }
+    return result;
+}
+
+/*an offset is valid if it is 0 where NULL is allowed, or points into the strings, which the file ends with a NUL of*/
+static int is_valid_offset(const GATEWAY_CONFIG_SNAPSHOT* snapshot, size_t strings_begin, uint32_t offset, int allow_null)
+{
+    return offset == 0 ? allow_null : (offset >= strings_begin && offset < snapshot->size);
+}
+
+static int is_valid_snapshot(const GATEWAY_CONFIG_SNAPSHOT* snapshot, uint64_t source_hash)
+{
+    int result;
+    const SNAPSHOT_HEADER* header = snapshot->header;
+    if (snapshot->size < sizeof(SNAPSHOT_HEADER) ||
+        header->magic != SNAPSHOT_MAGIC ||
+        header->version != SNAPSHOT_VERSION ||
+        header->size != snapshot->size)
+    {
+        LogError("the snapshot is damaged or of another version of the gateway");
+        result = 0;
+    }
+    else if (header->source_hash != source_hash)
+    {
+        LogInfo("the snapshot was written from another version of the configuration");
+        result = 0;
+    }
+    else
+    {
+        /*64 bit arithmetic, so counts from a damaged header cannot wrap around*/
+        uint64_t strings_begin = (uint64_t)sizeof(SNAPSHOT_HEADER) +
+            (uint64_t)header->module_count * sizeof(SNAPSHOT_MODULE) +
+            (uint64_t)header->link_count * sizeof(SNAPSHOT_LINK);
+        if (strings_begin > snapshot->size || snapshot->mapping[snapshot->size - 1] != '\0' ||
+            !is_valid_offset(snapshot, (size_t)strings_begin, header->loaders, 1))
+        {
+            result = 0;
+        }
+        else
+        {
+            uint32_t i;
+            result = 1;
+            for (i = 0; i < header->module_count && result; i++)
+            {
+                const SNAPSHOT_MODULE* module = &snapshot->modules[i];
+                result = is_valid_offset(snapshot, (size_t)strings_begin, module->module_name, 0) &&
+                    is_valid_offset(snapshot, (size_t)strings_begin, module->loader_name, 0) &&
+                    is_valid_offset(snapshot, (size_t)strings_begin, module->entrypoint, 1) &&
+                    is_valid_offset(snapshot, (size_t)strings_begin, module->args, 1) &&
+                    is_valid_offset(snapshot, (size_t)strings_begin, module->activation, 1);
+            }
+            for (i = 0; i < header->link_count && result; i++)
+            {
+                const SNAPSHOT_LINK* link = &snapshot->links[i];
+                result = is_valid_offset(snapshot, (size_t)strings_begin, link->module_source, 0) &&
+                    is_valid_offset(snapshot, (size_t)strings_begin, link->module_sink, 0);
+            }
+        }
+        if (!result)
+        {
+            LogError("the snapshot is damaged");
+        }
+    }
+    return result;
+}
+
+GATEWAY_CONFIG_SNAPSHOT_HANDLE GatewayConfigSnapshot_Open(const char* snapshot_path, uint64_t source_hash)
+{
+    GATEWAY_CONFIG_SNAPSHOT* result;
+    int fd;
+    struct stat file_stat;
+    if (snapshot_path == NULL)
+    {
+        /*Codes_SRS_GATEWAY_SNAPSHOT_17_008: [ If snapshot_path is NULL, or the file cannot be opened or mapped, GatewayConfigSnapshot_Open shall return NULL. ]*/
+        LogError("snapshot_path is NULL");
+        result = NULL;
+    }
+    else if ((fd = open(snapshot_path, O_RDONLY | O_CLOEXEC)) < 0)
+    {
+        /*a missing snapshot is the normal case the first time a configuration is used*/
+        /*Codes_SRS_GATEWAY_SNAPSHOT_17_008: [ If snapshot_path is NULL, or the file cannot be opened or mapped, GatewayConfigSnapshot_Open shall return NULL. ]*/
+        result = NULL;
+    }
+    else
+    {
+        if (fstat(fd, &file_stat) != 0 || file_stat.st_size < (off_t)sizeof(SNAPSHOT_HEADER))
+        {
+            /*Codes_SRS_GATEWAY_SNAPSHOT_17_009: [ GatewayConfigSnapshot_Open shall return NULL if the file is not a snapshot of this version, was written from a source of another hash or refers to anything outside of itself. ]*/
+            LogError("the snapshot %s is damaged", snapshot_path);
+            result = NULL;
+        }
+        else if ((result = (GATEWAY_CONFIG_SNAPSHOT*)malloc(sizeof(GATEWAY_CONFIG_SNAPSHOT))) == NULL)
+        {
+            /*Codes_SRS_GATEWAY_SNAPSHOT_17_008: [ If snapshot_path is NULL, or the file cannot be opened or mapped, GatewayConfigSnapshot_Open shall return NULL. ]*/
+            LogError("unable to allocate the snapshot");
+        }
+        else
+        {
+            void* mapping = mmap(NULL, (size_t)file_stat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (mapping == MAP_FAILED)
+            {
+                /*Codes_SRS_GATEWAY_SNAPSHOT_17_008: [ If snapshot_path is NULL, or the file cannot be opened or mapped, GatewayConfigSnapshot_Open shall return NULL. ]*/
+                LogError("unable to map the snapshot %s", snapshot_path);
+                free(result);
+                result = NULL;
+            }
+            else
+            {
+                /*Codes_SRS_GATEWAY_SNAPSHOT_17_010: [ Otherwise GatewayConfigSnapshot_Open shall return a handle to the mapped snapshot. ]*/
+                result->mapping = (const char*)mapping;
+                result->size = (size_t)file_stat.st_size;
+                result->header = (const SNAPSHOT_HEADER*)mapping;
+                result->modules = (const SNAPSHOT_MODULE*)(result->mapping + sizeof(SNAPSHOT_HEADER));
+                result->links = (const SNAPSHOT_LINK*)(result->mapping + sizeof(SNAPSHOT_HEADER) + (size_t)result->header->module_count * sizeof(SNAPSHOT_MODULE));
+                if (!is_valid_snapshot(result, source_hash))
+                {
+                    /*Codes_SRS_GATEWAY_SNAPSHOT_17_009: [ GatewayConfigSnapshot_Open shall return NULL if the file is not a snapshot of this version, was written from a source of another hash or refers to anything outside of itself. ]*/
+                    (void)munmap(mapping, result->size);
+                    free(result);
+                    result = NULL;
+                }
+            }
+        }
+        /*the mapping stays valid once the descriptor is closed*/
+        (void)close(fd);
+    }
+    return result;
+}
+
+static const char* string_at(GATEWAY_CONFIG_SNAPSHOT_HANDLE snapshot, uint32_t offset)
+{
+    return offset == 0 ? NULL : snapshot->mapping + offset;
+}
+
+/*Codes_SRS_GATEWAY_SNAPSHOT_17_011: [ The getters shall return the loaders, modules and links that were written to the snapshot, with strings pointing into the mapping. ]*/
+const char* GatewayConfigSnapshot_GetLoaders(GATEWAY_CONFIG_SNAPSHOT_HANDLE snapshot)
+{
+    return string_at(snapshot, snapshot->header->loaders);
+}
+
+size_t GatewayConfigSnapshot_GetModuleCount(GATEWAY_CONFIG_SNAPSHOT_HANDLE snapshot)
+{
+    return snapshot->header->module_count;
+}
+
+void GatewayConfigSnapshot_GetModule(GATEWAY_CONFIG_SNAPSHOT_HANDLE snapshot, size_t index, GATEWAY_CONFIG_SNAPSHOT_MODULE* module)
+{
+    const SNAPSHOT_MODULE* entry = &snapshot->modules[index];
+    module->module_name = string_at(snapshot, entry->module_name);
+    module->loader_name = string_at(snapshot, entry->loader_name);
+    module->entrypoint = string_at(snapshot, entry->entrypoint);
+    module->args = string_at(snapshot, entry->args);
+    module->activation = string_at(snapshot, entry->activation);
+    module->configuration_hash = entry->configuration_hash;
+}
+
+size_t GatewayConfigSnapshot_GetLinkCount(GATEWAY_CONFIG_SNAPSHOT_HANDLE snapshot)
+{
+    return snapshot->header->link_count;
+}
+
+void GatewayConfigSnapshot_GetLink(GATEWAY_CONFIG_SNAPSHOT_HANDLE snapshot, size_t index, GATEWAY_LINK_ENTRY* link)
+{
+    link->module_source = string_at(snapshot, snapshot->links[index].module_source);
+    link->module_sink = string_at(snapshot, snapshot->links[index].module_sink);
+}
+
+void GatewayConfigSnapshot_Close(GATEWAY_CONFIG_SNAPSHOT_HANDLE snapshot)
+{
+    if (snapshot != NULL)
+    {
+        /*Codes_SRS_GATEWAY_SNAPSHOT_17_012: [ GatewayConfigSnapshot_Close shall unmap the snapshot and free the handle; if snapshot is NULL it shall do nothing. ]*/
+        (void)munmap((void*)snapshot->mapping, snapshot->size);
+        free(snapshot);
+    }
+}
+
+#endif
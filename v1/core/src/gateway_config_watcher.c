@@ -0,0 +1,280 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/xlogging.h"
+
+#include "gateway.h"
+
+#ifdef GATEWAY_CONFIG_WATCHER_ENABLED
+
+#include <stdint.h>
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include "azure_c_shared_utility/threadapi.h"
+
+typedef struct GATEWAY_CONFIG_WATCHER_DATA_TAG
+{
+    GATEWAY_HANDLE gateway;
+
+    /*the watched file, and the directory it is in, since editors replace files rather than write them in place*/
+    char* file_path;
+    char* directory;
+    const char* file_name;
+
+    /*the content last applied, NULL if the file could not be read yet*/
+    char* content;
+
+    int inotify_fd;
+    int stop_fd;
+    THREAD_HANDLE thread;
+} GATEWAY_CONFIG_WATCHER_DATA;
+
+static char* read_file(const char* file_path)
+{
+    char* result = NULL;
+    FILE* file = fopen(file_path, "rb");
+    if (file == NULL)
+    {
+        LogError("unable to open %s", file_path);
+    }
+    else
+    {
+        long size;
+        if (fseek(file, 0, SEEK_END) != 0 || (size = ftell(file)) < 0 || fseek(file, 0, SEEK_SET) != 0)
+        {
+            LogError("unable to get the size of %s", file_path);
+        }
+        else if ((result = (char*)malloc((size_t)size + 1)) == NULL)
+        {
+            LogError("unable to allocate the content of %s", file_path);
+        }
+        else if (fread(result, 1, (size_t)size, file) != (size_t)size)
+        {
+            LogError("unable to read %s", file_path);
+            free(result);
+            result = NULL;
+        }
+        else
+        {
+            result[size] = '\0';
+        }
+        (void)fclose(file);
+    }
+    return result;
+}
+
+static void apply_file(GATEWAY_CONFIG_WATCHER_DATA* watcher)
+{
+    char* content = read_file(watcher->file_path);
+    if (content == NULL)
+    {
+        LogError("the gateway keeps running with the configuration it has");
+    }
+    else if (watcher->content != NULL && strcmp(content, watcher->content) == 0)
+    {
+        /*Codes_SRS_GATEWAY_JSON_17_032: [ If the content of the file did not change since it was last applied, the watcher shall do nothing. ]*/
+        free(content);
+    }
+    else
+    {
+        /*Codes_SRS_GATEWAY_JSON_17_031: [ Each time the file is written or moved into place, the watcher shall reconcile the gateway with its content using Gateway_ReconcileFromJson. ]*/
+        GATEWAY_UPDATE_FROM_JSON_RESULT result = Gateway_ReconcileFromJson(watcher->gateway, content);
+        if (result != GATEWAY_UPDATE_FROM_JSON_SUCCESS)
+        {
+            /*the content is not kept, so saving the same file again retries it*/
+            LogError("failed to apply %s: %s", watcher->file_path, ENUM_TO_STRING(GATEWAY_UPDATE_FROM_JSON_RESULT, result));
+            free(content);
+        }
+        else
+        {
+            LogInfo("applied %s", watcher->file_path);
+            free(watcher->content);
+            watcher->content = content;
+        }
+    }
+}
+
+static int watch_file(void* param)
+{
+    GATEWAY_CONFIG_WATCHER_DATA* watcher = (GATEWAY_CONFIG_WATCHER_DATA*)param;
+    /*uint64_t keeps the buffer aligned for struct inotify_event*/
+    uint64_t buffer[512];
+    int stopping = 0;
+
+    while (!stopping)
+    {
+        struct pollfd fds[2];
+        fds[0].fd = watcher->stop_fd;
+        fds[0].events = POLLIN;
+        fds[0].revents = 0;
+        fds[1].fd = watcher->inotify_fd;
+        fds[1].events = POLLIN;
+        fds[1].revents = 0;
+
+        if (poll(fds, 2, -1) < 0)
+        {
+            if (errno != EINTR)
+            {
+                LogError("unable to wait for changes of %s, no longer watching it", watcher->file_path);
+                stopping = 1;
+            }
+        }
+        else if (fds[0].revents != 0)
+        {
+            stopping = 1;
+        }
+        else if (fds[1].revents != 0)
+        {
+            int file_changed = 0;
+            ssize_t length;
+            while ((length = read(watcher->inotify_fd, buffer, sizeof(buffer))) > 0)
+            {
+                const char* event_bytes = (const char*)buffer;
+                while (event_bytes < (const char*)buffer + length)
+                {
+                    const struct inotify_event* event = (const struct inotify_event*)event_bytes;
+                    if (event->len > 0 && strcmp(event->name, watcher->file_name) == 0)
+                    {
+                        file_changed = 1;
+                    }
+                    event_bytes += sizeof(struct inotify_event) + event->len;
+                }
+            }
+            if (file_changed)
+            {
+                apply_file(watcher);
+            }
+        }
+    }
+    return 0;
+}
+
+static void destroy_watcher(GATEWAY_CONFIG_WATCHER_DATA* watcher)
+{
+    if (watcher->inotify_fd >= 0)
+    {
+        (void)close(watcher->inotify_fd);
+    }
+    if (watcher->stop_fd >= 0)
+    {
+        (void)close(watcher->stop_fd);
+    }
+    free(watcher->content);
+    free(watcher->directory);
+    free(watcher->file_path);
+    free(watcher);
+}
+
+GATEWAY_CONFIG_WATCHER_HANDLE Gateway_WatchConfigFile(GATEWAY_HANDLE gw, const char* file_path)
+{
+    GATEWAY_CONFIG_WATCHER_DATA* result;
+    if (gw == NULL || file_path == NULL)
+    {
+        /*Codes_SRS_GATEWAY_JSON_17_029: [ If gw or file_path is NULL, Gateway_WatchConfigFile shall return NULL. ]*/
+        LogError("Invalid argument gw = %p, file_path = %p.", gw, file_path);
+        result = NULL;
+    }
+    else if ((result = (GATEWAY_CONFIG_WATCHER_DATA*)malloc(sizeof(GATEWAY_CONFIG_WATCHER_DATA))) == NULL)
+    {
+        /*Codes_SRS_GATEWAY_JSON_17_033: [ Gateway_WatchConfigFile shall return NULL if any underlying call fails. ]*/
+        LogError("Failed to allocate the configuration watcher.");
+    }
+    else
+    {
+        size_t path_length = strlen(file_path);
+        const char* slash = strrchr(file_path, '/');
+        size_t directory_length = slash == NULL ? 1 : (slash == file_path ? 1 : (size_t)(slash - file_path));
+
+        memset(result, 0, sizeof(GATEWAY_CONFIG_WATCHER_DATA));
+        result->gateway = gw;
+        result->inotify_fd = -1;
+        result->stop_fd = -1;
+        result->file_path = (char*)malloc(path_length + 1);
+        result->directory = (char*)malloc(directory_length + 1);
+        if (result->file_path == NULL || result->directory == NULL)
+        {
+            /*Codes_SRS_GATEWAY_JSON_17_033: [ Gateway_WatchConfigFile shall return NULL if any underlying call fails. ]*/
+            LogError("Failed to allocate the path of the configuration file.");
+            destroy_watcher(result);
+            result = NULL;
+        }
+        else
+        {
+            (void)memcpy(result->file_path, file_path, path_length + 1);
+            (void)memcpy(result->directory, slash == NULL ? "." : file_path, directory_length);
+            result->directory[directory_length] = '\0';
+            result->file_name = result->file_path + (slash == NULL ? 0 : (size_t)(slash - file_path) + 1);
+
+            /*Codes_SRS_GATEWAY_JSON_17_030: [ Gateway_WatchConfigFile shall read the file as it is now, so only later changes of it are applied. ]*/
+            result->content = read_file(file_path);
+
+            /*Codes_SRS_GATEWAY_JSON_17_031: [ Each time the file is written or moved into place, the watcher shall reconcile the gateway with its content using Gateway_ReconcileFromJson. ]*/
+            if ((result->inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC)) < 0 ||
+                inotify_add_watch(result->inotify_fd, result->directory, IN_CLOSE_WRITE | IN_MOVED_TO) < 0 ||
+                (result->stop_fd = eventfd(0, EFD_CLOEXEC)) < 0)
+            {
+                /*Codes_SRS_GATEWAY_JSON_17_033: [ Gateway_WatchConfigFile shall return NULL if any underlying call fails. ]*/
+                LogError("Failed to watch %s, errno = %d.", result->directory, errno);
+                destroy_watcher(result);
+                result = NULL;
+            }
+            else if (ThreadAPI_Create(&result->thread, watch_file, result) != THREADAPI_OK)
+            {
+                /*Codes_SRS_GATEWAY_JSON_17_033: [ Gateway_WatchConfigFile shall return NULL if any underlying call fails. ]*/
+                LogError("Failed to start the configuration watcher thread.");
+                destroy_watcher(result);
+                result = NULL;
+            }
+        }
+    }
+    return result;
+}
+
+void Gateway_StopWatchingConfigFile(GATEWAY_CONFIG_WATCHER_HANDLE watcher)
+{
+    if (watcher == NULL)
+    {
+        /*Codes_SRS_GATEWAY_JSON_17_034: [ If watcher is NULL, Gateway_StopWatchingConfigFile shall do nothing. ]*/
+        LogError("watcher is NULL");
+    }
+    else
+    {
+        /*Codes_SRS_GATEWAY_JSON_17_035: [ Gateway_StopWatchingConfigFile shall stop the watcher thread, wait for it to end and free the watcher. ]*/
+        uint64_t stop = 1;
+        int thread_result;
+        if (write(watcher->stop_fd, &stop, sizeof(stop)) != (ssize_t)sizeof(stop))
+        {
+            /*the thread keeps using the watcher, so it cannot be freed*/
+            LogError("Failed to signal the configuration watcher thread, errno = %d.", errno);
+        }
+        else
+        {
+            (void)ThreadAPI_Join(watcher->thread, &thread_result);
+            destroy_watcher(watcher);
+        }
+    }
+}
+
+#else
+
+GATEWAY_CONFIG_WATCHER_HANDLE Gateway_WatchConfigFile(GATEWAY_HANDLE gw, const char* file_path)
+{
+    /*Codes_SRS_GATEWAY_JSON_17_036: [ If the gateway was built without the configuration watcher, Gateway_WatchConfigFile shall return NULL. ]*/
+    (void)gw;
+    LogError("the gateway was built without the configuration watcher, unable to watch %s", file_path == NULL ? "(null)" : file_path);
+    return NULL;
+}
+
+void Gateway_StopWatchingConfigFile(GATEWAY_CONFIG_WATCHER_HANDLE watcher)
+{
+    (void)watcher;
+}
+
+#endif
@@ -2,6 +2,9 @@
 // Licensed under the MIT license. See LICENSE file in the project root for full license information.
 
 #include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <limits.h>
 #include "azure_c_shared_utility/gballoc.h"
 #include "azure_c_shared_utility/xlogging.h"
 #include "azure_c_shared_utility/macro_utils.h"
@@ -11,6 +14,9 @@
 
 #include "module_loaders/dynamic_loader.h"
 #include "gateway_internal.h"
+#include "internal/gateway_clock.h"
+#include "internal/gateway_config_snapshot.h"
+#include "internal/gateway_lazy_module.h"
 
 #define MODULES_KEY "modules"
 #define LOADERS_KEY "loaders"
@@ -20,10 +26,23 @@
 #define LOADER_ENTRYPOINT_KEY "entrypoint"
 #define MODULE_PATH_KEY "module.path"
 #define ARG_KEY "args"
+#define ACTIVATION_KEY "activation"
+#define ACTIVATION_MODE_KEY "mode"
+#define ACTIVATION_QUEUE_KEY "max_queued_messages"
+#define ACTIVATION_IDLE_TIMEOUT_KEY "idle_timeout_ms"
+#define ACTIVATION_EAGER "eager"
+#define ACTIVATION_LAZY "lazy"
+#define ACTIVATION_MAX_QUEUED_MESSAGES 65536
 
 #define LINKS_KEY "links"
 #define SOURCE_KEY "source"
 #define SINK_KEY "sink"
+#define ANY_SOURCE "*"
+
+/*how long a module that a reconcile removes or replaces may deliver what was queued for it*/
+#ifndef GATEWAY_RECONCILE_DRAIN_MS
+#define GATEWAY_RECONCILE_DRAIN_MS 1000
+#endif
 
 #define PARSE_JSON_RESULT_VALUES \
     PARSE_JSON_SUCCESS, \
@@ -35,9 +54,16 @@
 DEFINE_ENUM(PARSE_JSON_RESULT, PARSE_JSON_RESULT_VALUES);
 
 GATEWAY_HANDLE gateway_create_internal(const GATEWAY_PROPERTIES* properties, bool use_json);
-static PARSE_JSON_RESULT parse_json_internal(GATEWAY_PROPERTIES* out_properties, JSON_Value *root);
+static PARSE_JSON_RESULT parse_json_internal(GATEWAY_PROPERTIES* out_properties, JSON_Value *root, uint64_t** entrypoint_us);
 static void destroy_properties_internal(GATEWAY_PROPERTIES* properties);
+static void record_configurations(GATEWAY_HANDLE_DATA* gateway, JSON_Value* root, const uint64_t* configuration_hashes, const GATEWAY_PROPERTIES* properties, const uint64_t* entrypoint_us);
+static GATEWAY_HANDLE create_from_json(const char* file_path, JSON_Value* root_value, uint64_t begin_us, const char* snapshot_path, uint64_t source_hash);
 void gateway_destroy_internal(GATEWAY_HANDLE gw);
+#ifdef GATEWAY_CONFIG_SNAPSHOT_ENABLED
+static char* snapshot_path_of(const char* file_path);
+static bool create_from_snapshot(const char* snapshot_path, uint64_t source_hash, uint64_t begin_us, GATEWAY_HANDLE* gw);
+static void write_snapshot(const char* snapshot_path, uint64_t source_hash, JSON_Value* root, const GATEWAY_PROPERTIES* properties);
+#endif
 
 GATEWAY_HANDLE Gateway_CreateFromJson(const char* file_path)
 {
@@ -54,80 +80,128 @@ GATEWAY_HANDLE Gateway_CreateFromJson(const char* file_path)
         }
         else
         {
-            JSON_Value *root_value;
-
+            uint64_t begin_us = gateway_clock_now_us();
+#ifdef GATEWAY_CONFIG_SNAPSHOT_ENABLED
+            /*Codes_SRS_GATEWAY_JSON_17_039: [ If the gateway was built with configuration snapshots, the function shall read and hash the file and look for a snapshot of it at file_path followed by .snapshot. ]*/
+            uint64_t source_hash = 0;
+            char* source = GatewayConfigSnapshot_ReadSource(file_path, &source_hash);
+            char* snapshot_path = source == NULL ? NULL : snapshot_path_of(file_path);
+            if (snapshot_path == NULL || !create_from_snapshot(snapshot_path, source_hash, begin_us, &gw))
+            {
+                /*Codes_SRS_GATEWAY_JSON_14_002: [The function shall use parson to read the file and parse the JSON string to a parson JSON_Value structure.]*/
+                gw = create_from_json(file_path, source == NULL ? NULL : json_parse_string(source), begin_us, snapshot_path, source_hash);
+            }
+            free(snapshot_path);
+            free(source);
+#else
             /*Codes_SRS_GATEWAY_JSON_14_002: [The function shall use parson to read the file and parse the JSON string to a parson JSON_Value structure.]*/
-            root_value = json_parse_file(file_path);
-            if (root_value != NULL)
+            gw = create_from_json(file_path, json_parse_file(file_path), begin_us, NULL, 0);
+#endif
+            if (gw == NULL)
             {
-                /*Codes_SRS_GATEWAY_JSON_14_004: [The function shall traverse the JSON_Value object to initialize a GATEWAY_PROPERTIES instance.]*/
-                GATEWAY_PROPERTIES *properties = (GATEWAY_PROPERTIES*)malloc(sizeof(GATEWAY_PROPERTIES));
+                /*Codes_SRS_GATEWAY_JSON_17_006: [ Upon failure this function shall destroy the module loader list. ]*/
+                ModuleLoader_Destroy();
+            }
+        }
+    }    /*Codes_SRS_GATEWAY_JSON_14_001: [If file_path is NULL the function shall return NULL.]*/
+    else
+    {
+        gw = NULL;
+        LogError("Input file path is NULL.");
+    }
 
-                if (properties != NULL)
-                {
-                    properties->gateway_modules = NULL;
-                    properties->gateway_links = NULL;
-                    if ((parse_json_internal(properties, root_value) == PARSE_JSON_SUCCESS) && properties->gateway_modules != NULL && properties->gateway_links != NULL)
-                    {
-                        /*Codes_SRS_GATEWAY_JSON_14_007: [The function shall use the GATEWAY_PROPERTIES instance to create and return a GATEWAY_HANDLE using the lower level API.]*/
-                        /*Codes_SRS_GATEWAY_JSON_17_004: [ The function shall set the module loader to the default dynamically linked library module loader. ]*/
-                        gw = gateway_create_internal(properties, true);
+    return gw;
+}
 
-                        if (gw == NULL)
-                        {
-                            LogError("Failed to create gateway using lower level library.");
-                        }
-                        else
-                        {
-                            /*Codes_SRS_GATEWAY_JSON_17_001: [ Upon successful creation, this function shall start the gateway. ]*/
-                            GATEWAY_START_RESULT start_result;
-                            start_result = Gateway_Start(gw);
-                            if (start_result != GATEWAY_START_SUCCESS)
-                            {
-                                /*Codes_SRS_GATEWAY_JSON_17_002: [ This function shall return NULL if starting the gateway fails. ]*/
-                                LogError("failed to start gateway");
-                                gateway_destroy_internal(gw);
-                                gw = NULL;
-                            }
-                        }
-                    }
-                    /*Codes_SRS_GATEWAY_JSON_14_006: [The function shall return NULL if the JSON_Value contains incomplete information.]*/
-                    else
-                    {
-                        gw = NULL;
-                        LogError("Failed to create properties structure from JSON configuration.");
-                    }
-                    destroy_properties_internal(properties);
-                    free(properties);
-                }
-                /*Codes_SRS_GATEWAY_JSON_14_008: [This function shall return NULL upon any memory allocation failure.]*/
-                else
+static GATEWAY_HANDLE create_and_start(const GATEWAY_PROPERTIES* properties, JSON_Value* root, const uint64_t* configuration_hashes, const uint64_t* entrypoint_us, uint64_t begin_us, uint64_t parse_json_us)
+{
+    /*Codes_SRS_GATEWAY_JSON_14_007: [The function shall use the GATEWAY_PROPERTIES instance to create and return a GATEWAY_HANDLE using the lower level API.]*/
+    /*Codes_SRS_GATEWAY_JSON_17_004: [ The function shall set the module loader to the default dynamically linked library module loader. ]*/
+    GATEWAY_HANDLE gw = gateway_create_internal(properties, true);
+
+    if (gw == NULL)
+    {
+        LogError("Failed to create gateway using lower level library.");
+    }
+    else
+    {
+        GATEWAY_START_RESULT start_result;
+        /*Codes_SRS_GATEWAY_JSON_17_015: [ The function shall keep a hash of each module's JSON object with the module. ]*/
+        /*Codes_SRS_GATEWAY_JSON_17_038: [ The function shall keep the time parsing each module's entrypoint took with the module. ]*/
+        record_configurations(gw, root, configuration_hashes, properties, entrypoint_us);
+        /*Codes_SRS_GATEWAY_JSON_17_037: [ The startup of the gateway shall begin before the file is read, and the time reading and parsing it took shall be kept with the gateway. ]*/
+        gw->startup.begin_us = begin_us;
+        gw->startup.parse_json_us = parse_json_us;
+
+        /*Codes_SRS_GATEWAY_JSON_17_001: [ Upon successful creation, this function shall start the gateway. ]*/
+        start_result = Gateway_Start(gw);
+        if (start_result != GATEWAY_START_SUCCESS)
+        {
+            /*Codes_SRS_GATEWAY_JSON_17_002: [ This function shall return NULL if starting the gateway fails. ]*/
+            LogError("failed to start gateway");
+            gateway_destroy_internal(gw);
+            gw = NULL;
+        }
+    }
+    return gw;
+}
+
+/*creates the gateway from the parsed file and frees root_value; the file is kept as a snapshot at snapshot_path unless it is NULL*/
+static GATEWAY_HANDLE create_from_json(const char* file_path, JSON_Value* root_value, uint64_t begin_us, const char* snapshot_path, uint64_t source_hash)
+{
+    GATEWAY_HANDLE gw;
+    if (root_value != NULL)
+    {
+        /*Codes_SRS_GATEWAY_JSON_14_004: [The function shall traverse the JSON_Value object to initialize a GATEWAY_PROPERTIES instance.]*/
+        GATEWAY_PROPERTIES *properties = (GATEWAY_PROPERTIES*)malloc(sizeof(GATEWAY_PROPERTIES));
+
+        if (properties != NULL)
+        {
+            uint64_t* entrypoint_us = NULL;
+            properties->gateway_modules = NULL;
+            properties->gateway_links = NULL;
+            if ((parse_json_internal(properties, root_value, &entrypoint_us) == PARSE_JSON_SUCCESS) && properties->gateway_modules != NULL && properties->gateway_links != NULL)
+            {
+                gw = create_and_start(properties, root_value, NULL, entrypoint_us, begin_us, gateway_clock_now_us() - begin_us);
+#ifdef GATEWAY_CONFIG_SNAPSHOT_ENABLED
+                if (gw != NULL && snapshot_path != NULL)
                 {
-                    gw = NULL;
-                    LogError("Failed to allocate GATEWAY_PROPERTIES.");
+                    /*Codes_SRS_GATEWAY_JSON_17_040: [ Once the gateway started, the function shall write what it parsed from the file to the snapshot, so the next gateway created from the same file does not parse it. ]*/
+                    write_snapshot(snapshot_path, source_hash, root_value, properties);
                 }
-
-                json_value_free(root_value);
+#else
+                (void)snapshot_path;
+                (void)source_hash;
+#endif
             }
+            /*Codes_SRS_GATEWAY_JSON_14_006: [The function shall return NULL if the JSON_Value contains incomplete information.]*/
             else
             {
-                /*Codes_SRS_GATEWAY_JSON_14_003: [The function shall return NULL if the file contents could not be read and / or parsed to a JSON_Value.]*/
                 gw = NULL;
-                LogError("Input file [%s] could not be read.", file_path);
+                LogError("Failed to create properties structure from JSON configuration.");
             }
-            if (gw == NULL)
+            if (entrypoint_us != NULL)
             {
-                /*Codes_SRS_GATEWAY_JSON_17_006: [ Upon failure this function shall destroy the module loader list. ]*/
-                ModuleLoader_Destroy();
+                free(entrypoint_us);
             }
+            destroy_properties_internal(properties);
+            free(properties);
         }
-    }    /*Codes_SRS_GATEWAY_JSON_14_001: [If file_path is NULL the function shall return NULL.]*/
+        /*Codes_SRS_GATEWAY_JSON_14_008: [This function shall return NULL upon any memory allocation failure.]*/
+        else
+        {
+            gw = NULL;
+            LogError("Failed to allocate GATEWAY_PROPERTIES.");
+        }
+
+        json_value_free(root_value);
+    }
     else
     {
+        /*Codes_SRS_GATEWAY_JSON_14_003: [The function shall return NULL if the file contents could not be read and / or parsed to a JSON_Value.]*/
         gw = NULL;
-        LogError("Input file path is NULL.");
+        LogError("Input file [%s] could not be read.", file_path);
     }
-
     return gw;
 }
 
@@ -188,7 +262,7 @@ GATEWAY_UPDATE_FROM_JSON_RESULT Gateway_UpdateFromJson(GATEWAY_HANDLE gw, const
                 properties->gateway_links = NULL;
                 /* Codes_SRS_GATEWAY_JSON_04_007: [ The function shall traverse the JSON_Value object to initialize a GATEWAY_PROPERTIES instance. ] */
                 /* Codes_SRS_GATEWAY_JSON_04_011: [ The function shall be able to add just `modules`, just `links` or both. ] */
-                if (parse_json_internal(properties, root_value) != PARSE_JSON_SUCCESS)
+                if (parse_json_internal(properties, root_value, NULL) != PARSE_JSON_SUCCESS)
                 {
                     /* Codes_SRS_GATEWAY_JSON_04_010: [ The function shall return GATEWAY_UPDATE_FROM_JSON_ERROR if the JSON_Value contains incomplete information. ] */
                     LogError("Failed to create properties structure from JSON configuration.");
@@ -361,6 +435,12 @@ GATEWAY_UPDATE_FROM_JSON_RESULT Gateway_UpdateFromJson(GATEWAY_HANDLE gw, const
                                     }
                                 }
                             }
+
+                            if (result == GATEWAY_UPDATE_FROM_JSON_SUCCESS)
+                            {
+                                /*Codes_SRS_GATEWAY_JSON_17_016: [ The function shall keep a hash of each added module's JSON object with the module. ]*/
+                                record_configurations(gw, root_value, NULL, properties, NULL);
+                            }
                             VECTOR_destroy(links_added_successfully);
                         }
                         VECTOR_destroy(modules_added_successfully);
@@ -377,6 +457,318 @@ GATEWAY_UPDATE_FROM_JSON_RESULT Gateway_UpdateFromJson(GATEWAY_HANDLE gw, const
 }
 
 
+/*FNV-1a over the serialized JSON object of a module, enough to tell two configurations of it apart*/
+static uint64_t configuration_hash(const JSON_Value* module_json)
+{
+    uint64_t result;
+    char* serialized = json_serialize_to_string(module_json);
+    if (serialized == NULL)
+    {
+        /*0 is the hash of a module that was not added from JSON, so it counts as changed next time*/
+        LogError("Failed to serialize a module configuration.");
+        result = 0;
+    }
+    else
+    {
+        const unsigned char* c;
+        result = 14695981039346656037ULL;
+        for (c = (const unsigned char*)serialized; *c != '\0'; c++)
+        {
+            result = (result ^ *c) * 1099511628211ULL;
+        }
+        json_free_serialized_string(serialized);
+    }
+    return result;
+}
+
+/*the hashes are taken from configuration_hashes if the configuration came from a snapshot, or computed from root otherwise*/
+static void record_configurations(GATEWAY_HANDLE_DATA* gateway, JSON_Value* root, const uint64_t* configuration_hashes, const GATEWAY_PROPERTIES* properties, const uint64_t* entrypoint_us)
+{
+    if (properties->gateway_modules != NULL)
+    {
+        /*parse_json_internal keeps the order of the "modules" array*/
+        JSON_Array* modules_array = json_object_get_array(json_value_get_object(root), MODULES_KEY);
+        size_t entries_count = VECTOR_size(properties->gateway_modules);
+        for (size_t entry_index = 0; entry_index < entries_count; ++entry_index)
+        {
+            GATEWAY_MODULES_ENTRY* entry = (GATEWAY_MODULES_ENTRY*)VECTOR_element(properties->gateway_modules, entry_index);
+            MODULE_DATA** module_data = (MODULE_DATA**)VECTOR_find_if(gateway->modules, module_name_find, entry->module_name);
+            if (module_data != NULL)
+            {
+                (*module_data)->configuration_hash = configuration_hashes != NULL ?
+                    configuration_hashes[entry_index] :
+                    configuration_hash(json_array_get_value(modules_array, entry_index));
+                if (entrypoint_us != NULL)
+                {
+                    (*module_data)->startup.parse_entrypoint_us = entrypoint_us[entry_index];
+                }
+            }
+        }
+    }
+}
+
+static bool entry_name_find(const void* element, const void* module_name)
+{
+    return strcmp(((const GATEWAY_MODULES_ENTRY*)element)->module_name, (const char*)module_name) == 0;
+}
+
+static bool entry_link_find(const void* element, const void* link_data)
+{
+    return link_data_find(link_data, element);
+}
+
+static bool check_reconcile_input(const GATEWAY_PROPERTIES* properties)
+{
+    bool result = true;
+    size_t modules_count = properties->gateway_modules == NULL ? 0 : VECTOR_size(properties->gateway_modules);
+    size_t links_count = properties->gateway_links == NULL ? 0 : VECTOR_size(properties->gateway_links);
+
+    for (size_t module_index = 0; module_index < modules_count && result; ++module_index)
+    {
+        GATEWAY_MODULES_ENTRY* entry = (GATEWAY_MODULES_ENTRY*)VECTOR_element(properties->gateway_modules, module_index);
+        for (size_t other_index = 0; other_index < module_index && result; ++other_index)
+        {
+            if (strcmp(((GATEWAY_MODULES_ENTRY*)VECTOR_element(properties->gateway_modules, other_index))->module_name, entry->module_name) == 0)
+            {
+                LogError("Module %s is configured more than once.", entry->module_name);
+                result = false;
+            }
+        }
+    }
+
+    for (size_t link_index = 0; link_index < links_count && result; ++link_index)
+    {
+        GATEWAY_LINK_ENTRY* link = (GATEWAY_LINK_ENTRY*)VECTOR_element(properties->gateway_links, link_index);
+        if (modules_count == 0 ||
+            VECTOR_find_if(properties->gateway_modules, entry_name_find, link->module_sink) == NULL ||
+            (strcmp(link->module_source, ANY_SOURCE) != 0 && VECTOR_find_if(properties->gateway_modules, entry_name_find, link->module_source) == NULL))
+        {
+            LogError("Link from '%s' to '%s' refers to a module that is not configured.", link->module_source, link->module_sink);
+            result = false;
+        }
+    }
+    return result;
+}
+
+static GATEWAY_UPDATE_FROM_JSON_RESULT reconcile_internal(GATEWAY_HANDLE_DATA* gateway, JSON_Value* root, const GATEWAY_PROPERTIES* properties)
+{
+    GATEWAY_UPDATE_FROM_JSON_RESULT result;
+    VECTOR_HANDLE added = VECTOR_create(sizeof(GATEWAY_MODULES_ENTRY));
+    VECTOR_HANDLE replaced = VECTOR_create(sizeof(GATEWAY_MODULES_ENTRY));
+    if (added == NULL || replaced == NULL)
+    {
+        LogError("Failed to create the vectors of changed modules.");
+        result = GATEWAY_UPDATE_FROM_JSON_MEMORY;
+    }
+    else
+    {
+        size_t modules_count = properties->gateway_modules == NULL ? 0 : VECTOR_size(properties->gateway_modules);
+        size_t links_count = properties->gateway_links == NULL ? 0 : VECTOR_size(properties->gateway_links);
+        JSON_Array* modules_array = json_object_get_array(json_value_get_object(root), MODULES_KEY);
+        bool changed = false;
+        size_t index;
+
+        /*Codes_SRS_GATEWAY_JSON_17_021: [ The function shall add every configured module whose name is not in the gateway and replace every module whose JSON object hashes differently from the one it was added with. ]*/
+        result = GATEWAY_UPDATE_FROM_JSON_SUCCESS;
+        for (index = 0; index < modules_count && result == GATEWAY_UPDATE_FROM_JSON_SUCCESS; ++index)
+        {
+            GATEWAY_MODULES_ENTRY* entry = (GATEWAY_MODULES_ENTRY*)VECTOR_element(properties->gateway_modules, index);
+            MODULE_DATA** module_data = (MODULE_DATA**)VECTOR_find_if(gateway->modules, module_name_find, entry->module_name);
+            if (module_data == NULL)
+            {
+                if (VECTOR_push_back(added, entry, 1) != 0)
+                {
+                    result = GATEWAY_UPDATE_FROM_JSON_MEMORY;
+                }
+            }
+            else if ((*module_data)->configuration_hash == 0 ||
+                (*module_data)->configuration_hash != configuration_hash(json_array_get_value(modules_array, index)))
+            {
+                if (VECTOR_push_back(replaced, entry, 1) != 0)
+                {
+                    result = GATEWAY_UPDATE_FROM_JSON_MEMORY;
+                }
+            }
+        }
+
+        if (result != GATEWAY_UPDATE_FROM_JSON_SUCCESS)
+        {
+            LogError("Failed to record a changed module.");
+        }
+        /*Codes_SRS_GATEWAY_JSON_17_022: [ The function shall create the new modules before it changes anything else, and return GATEWAY_UPDATE_FROM_JSON_ERROR with the gateway unchanged if that fails. ]*/
+        else if (VECTOR_size(added) > 0 && gateway_addmodules_internal(gateway, added, VECTOR_size(added), true) != 0)
+        {
+            LogError("Failed to add the new modules, the gateway is unchanged.");
+            result = GATEWAY_UPDATE_FROM_JSON_ERROR;
+        }
+        else
+        {
+            changed = VECTOR_size(added) > 0;
+
+            /*Codes_SRS_GATEWAY_JSON_17_023: [ The function shall remove every link of the gateway that is not configured. ]*/
+            index = 0;
+            while (index < VECTOR_size(gateway->links))
+            {
+                LINK_DATA* link_data = (LINK_DATA*)VECTOR_element(gateway->links, index);
+                if (links_count == 0 || VECTOR_find_if(properties->gateway_links, entry_link_find, link_data) == NULL)
+                {
+                    gateway_removelink_internal(gateway, link_data);
+                    changed = true;
+                }
+                else
+                {
+                    index++;
+                }
+            }
+
+            /*Codes_SRS_GATEWAY_JSON_17_024: [ The function shall remove every module of the gateway that is not configured or is replaced, together with its links. ]*/
+            index = 0;
+            while (index < VECTOR_size(gateway->modules))
+            {
+                MODULE_DATA** module_data = (MODULE_DATA**)VECTOR_element(gateway->modules, index);
+                if (modules_count == 0 ||
+                    VECTOR_find_if(properties->gateway_modules, entry_name_find, (*module_data)->module_name) == NULL ||
+                    VECTOR_find_if(replaced, entry_name_find, (*module_data)->module_name) != NULL)
+                {
+                    BROKER_MODULE_DRAIN drain;
+                    /*Codes_SRS_GATEWAY_JSON_17_045: [ The function shall drain each module it removes with Broker_DrainModule, for at most GATEWAY_RECONCILE_DRAIN_MS, before removing it. ]*/
+                    if (Broker_DrainModule(gateway->broker, (*module_data)->module, GATEWAY_RECONCILE_DRAIN_MS, &drain) != BROKER_OK)
+                    {
+                        LogError("Failed to drain module %s, its messages are discarded", (*module_data)->module_name);
+                    }
+                    else if (drain.messages_abandoned > 0)
+                    {
+                        LogError("Module %s was removed with %zu messages it did not receive", (*module_data)->module_name, drain.messages_abandoned);
+                    }
+                    gateway_removemodule_internal(gateway, module_data);
+                    changed = true;
+                }
+                else
+                {
+                    index++;
+                }
+            }
+
+            /*Codes_SRS_GATEWAY_JSON_17_025: [ The function shall then create the replacing modules. ]*/
+            if (VECTOR_size(replaced) > 0 && gateway_addmodules_internal(gateway, replaced, VECTOR_size(replaced), true) != 0)
+            {
+                /*Codes_SRS_GATEWAY_JSON_17_046: [ If the replacing modules cannot be created together, the function shall create the ones the gateway does not have one at a time, return GATEWAY_UPDATE_FROM_JSON_ERROR and leave out those that fail, which were reported removed, so the next reconcile adds them. ]*/
+                for (index = 0; index < VECTOR_size(replaced); ++index)
+                {
+                    GATEWAY_MODULES_ENTRY* entry = (GATEWAY_MODULES_ENTRY*)VECTOR_element(replaced, index);
+                    if (VECTOR_find_if(gateway->modules, module_name_find, entry->module_name) == NULL &&
+                        gateway_addmodule_internal(gateway, entry, true) == NULL)
+                    {
+                        LogError("Failed to replace module %s, it stays removed.", entry->module_name);
+                    }
+                }
+                result = GATEWAY_UPDATE_FROM_JSON_ERROR;
+            }
+
+            /*Codes_SRS_GATEWAY_JSON_17_026: [ The function shall add every configured link the gateway does not have. ]*/
+            for (index = 0; index < links_count; ++index)
+            {
+                GATEWAY_LINK_ENTRY* entry = (GATEWAY_LINK_ENTRY*)VECTOR_element(properties->gateway_links, index);
+                if (VECTOR_find_if(gateway->links, link_data_find, entry) == NULL)
+                {
+                    if (gateway_addlink_internal(gateway, entry))
+                    {
+                        changed = true;
+                    }
+                    else
+                    {
+                        LogError("Unable to add link from '%s' to '%s'.", entry->module_source, entry->module_sink);
+                        result = GATEWAY_UPDATE_FROM_JSON_ERROR;
+                    }
+                }
+            }
+
+            /*Codes_SRS_GATEWAY_JSON_17_027: [ Once the links are in place, the function shall start the added and replacing modules and keep the hash of their JSON objects with them. ]*/
+            for (index = 0; index < modules_count; ++index)
+            {
+                GATEWAY_MODULES_ENTRY* entry = (GATEWAY_MODULES_ENTRY*)VECTOR_element(properties->gateway_modules, index);
+                if (VECTOR_find_if(added, entry_name_find, entry->module_name) != NULL ||
+                    VECTOR_find_if(replaced, entry_name_find, entry->module_name) != NULL)
+                {
+                    MODULE_DATA** module_data = (MODULE_DATA**)VECTOR_find_if(gateway->modules, module_name_find, entry->module_name);
+                    if (module_data != NULL)
+                    {
+                        (*module_data)->configuration_hash = configuration_hash(json_array_get_value(modules_array, index));
+                        Gateway_StartModule(gateway, (*module_data)->module);
+                    }
+                }
+            }
+
+            /*Codes_SRS_GATEWAY_JSON_17_028: [ If any module or link changed, the function shall report a GATEWAY_MODULE_LIST_CHANGED event. ]*/
+            if (changed || VECTOR_size(replaced) > 0)
+            {
+                EventSystem_ReportEvent(gateway->event_system, gateway, GATEWAY_MODULE_LIST_CHANGED);
+            }
+        }
+    }
+
+    if (added != NULL)
+    {
+        VECTOR_destroy(added);
+    }
+    if (replaced != NULL)
+    {
+        VECTOR_destroy(replaced);
+    }
+    return result;
+}
+
+GATEWAY_UPDATE_FROM_JSON_RESULT Gateway_ReconcileFromJson(GATEWAY_HANDLE gw, const char* json_content)
+{
+    GATEWAY_UPDATE_FROM_JSON_RESULT result;
+    if (gw == NULL || json_content == NULL)
+    {
+        /*Codes_SRS_GATEWAY_JSON_17_017: [ If gw or json_content is NULL the function shall return GATEWAY_UPDATE_FROM_JSON_INVALID_ARG. ]*/
+        LogError("Invalid argument gw = %p, json_content = %p.", gw, json_content);
+        result = GATEWAY_UPDATE_FROM_JSON_INVALID_ARG;
+    }
+    else
+    {
+        /*Codes_SRS_GATEWAY_JSON_17_018: [ The function shall use parson to parse the JSON string to a parson JSON_Value structure. ]*/
+        JSON_Value *root_value = json_parse_string(json_content);
+        if (root_value == NULL)
+        {
+            /*Codes_SRS_GATEWAY_JSON_17_019: [ The function shall return GATEWAY_UPDATE_FROM_JSON_ERROR if the JSON content could not be parsed, contains incomplete information or configures a link to a module it does not configure. ]*/
+            LogError("JSON content could not be parsed.");
+            result = GATEWAY_UPDATE_FROM_JSON_ERROR;
+        }
+        else
+        {
+            GATEWAY_PROPERTIES *properties = (GATEWAY_PROPERTIES*)malloc(sizeof(GATEWAY_PROPERTIES));
+            if (properties == NULL)
+            {
+                /*Codes_SRS_GATEWAY_JSON_17_020: [ The function shall return GATEWAY_UPDATE_FROM_JSON_MEMORY upon any memory allocation failure. ]*/
+                LogError("Failed to allocate GATEWAY_PROPERTIES.");
+                result = GATEWAY_UPDATE_FROM_JSON_MEMORY;
+            }
+            else
+            {
+                properties->gateway_modules = NULL;
+                properties->gateway_links = NULL;
+                /*Codes_SRS_GATEWAY_JSON_17_019: [ The function shall return GATEWAY_UPDATE_FROM_JSON_ERROR if the JSON content could not be parsed, contains incomplete information or configures a link to a module it does not configure. ]*/
+                if (parse_json_internal(properties, root_value, NULL) != PARSE_JSON_SUCCESS || !check_reconcile_input(properties))
+                {
+                    LogError("Failed to create properties structure from JSON configuration.");
+                    result = GATEWAY_UPDATE_FROM_JSON_ERROR;
+                }
+                else
+                {
+                    result = reconcile_internal(gw, root_value, properties);
+                }
+                destroy_properties_internal(properties);
+                free(properties);
+            }
+            json_value_free(root_value);
+        }
+    }
+    return result;
+}
+
 static void destroy_properties_internal(GATEWAY_PROPERTIES* properties)
 {
     if (properties->gateway_modules != NULL)
@@ -446,7 +838,73 @@ static PARSE_JSON_RESULT parse_loader(JSON_Object* loader_json, GATEWAY_MODULE_L
     return result;
 }
 
-static PARSE_JSON_RESULT parse_json_internal(GATEWAY_PROPERTIES* out_properties, JSON_Value *root)
+/*reads an optional whole number setting of an "activation" object, value is left alone if it is missing*/
+static int parse_activation_setting(JSON_Object* settings, const char* name, double min, double max, double* value)
+{
+    int result;
+    JSON_Value* setting = json_object_get_value(settings, name);
+    if (setting == NULL)
+    {
+        result = 0;
+    }
+    else
+    {
+        double number = json_value_get_number(setting);
+        if (json_value_get_type(setting) != JSONNumber || number < min || number > max || number != (double)(unsigned long)number)
+        {
+            LogError("\"%s\" of \"%s\" must be a whole number from %.0f to %.0f.", name, ACTIVATION_KEY, min, max);
+            result = __LINE__;
+        }
+        else
+        {
+            *value = number;
+            result = 0;
+        }
+    }
+    return result;
+}
+
+/*applies the "activation" of a module to its loader_info, which is left as it was upon failure*/
+static int parse_activation(const JSON_Value* activation_json, GATEWAY_MODULE_LOADER_INFO* loader_info)
+{
+    int result;
+    /*Codes_SRS_GATEWAY_JSON_17_043: [ The "activation" of a module shall be "eager", "lazy", or an object with such a "mode" and optionally a "max_queued_messages" from 1 to 65536 and an "idle_timeout_ms"; otherwise the function shall fail. ]*/
+    JSON_Object* settings = json_value_get_object(activation_json);
+    const char* mode = settings != NULL ? json_object_get_string(settings, ACTIVATION_MODE_KEY) : json_value_get_string(activation_json);
+    double max_queued_messages = GATEWAY_LAZY_DEFAULT_QUEUED_MESSAGES;
+    double idle_timeout_ms = 0;
+    if (mode == NULL)
+    {
+        LogError("\"%s\" must be \"%s\", \"%s\" or an object with a \"%s\".", ACTIVATION_KEY, ACTIVATION_EAGER, ACTIVATION_LAZY, ACTIVATION_MODE_KEY);
+        result = __LINE__;
+    }
+    else if (strcmp(mode, ACTIVATION_EAGER) == 0)
+    {
+        result = 0;
+    }
+    else if (strcmp(mode, ACTIVATION_LAZY) != 0)
+    {
+        LogError("Unknown \"%s\" mode %s.", ACTIVATION_KEY, mode);
+        result = __LINE__;
+    }
+    else if (settings != NULL &&
+        (parse_activation_setting(settings, ACTIVATION_QUEUE_KEY, 1, ACTIVATION_MAX_QUEUED_MESSAGES, &max_queued_messages) != 0 ||
+        parse_activation_setting(settings, ACTIVATION_IDLE_TIMEOUT_KEY, 0, UINT_MAX, &idle_timeout_ms) != 0))
+    {
+        result = __LINE__;
+    }
+    else
+    {
+        /*Codes_SRS_GATEWAY_JSON_17_044: [ For a lazy module, the function shall have the loader of the module wrapped by GatewayLazyModule_Wrap, so the module is only loaded and created once a message reaches it. ]*/
+        GATEWAY_LAZY_ACTIVATION activation;
+        activation.max_queued_messages = (size_t)max_queued_messages;
+        activation.idle_timeout_ms = (unsigned int)idle_timeout_ms;
+        result = GatewayLazyModule_Wrap(loader_info, &activation);
+    }
+    return result;
+}
+
+static PARSE_JSON_RESULT parse_json_internal(GATEWAY_PROPERTIES* out_properties, JSON_Value *root, uint64_t** entrypoint_us)
 {
     PARSE_JSON_RESULT result;
 
@@ -472,6 +930,17 @@ static PARSE_JSON_RESULT parse_json_internal(GATEWAY_PROPERTIES* out_properties,
                         /*Codes_SRS_GATEWAY_JSON_17_008: [ The function shall parse the "modules" JSON array for each module entry. ]*/
                         JSON_Object *module;
                         size_t module_count = json_array_get_count(modules_array);
+                        uint64_t* parse_times = NULL;
+                        if (entrypoint_us != NULL && module_count > 0)
+                        {
+                            /*the times only go into the startup report, so the gateway is created without them if they cannot be kept*/
+                            parse_times = (uint64_t*)malloc(module_count * sizeof(uint64_t));
+                            if (parse_times == NULL)
+                            {
+                                LogError("Failed to allocate the entrypoint parse times, they will not be reported.");
+                            }
+                            *entrypoint_us = parse_times;
+                        }
                         result = PARSE_JSON_SUCCESS;
                         for (size_t module_index = 0; module_index < module_count; ++module_index)
                         {
@@ -480,7 +949,13 @@ static PARSE_JSON_RESULT parse_json_internal(GATEWAY_PROPERTIES* out_properties,
                             /*Codes_SRS_GATEWAY_JSON_17_009: [ For each module, the function shall call the loader's ParseEntrypointFromJson function to parse the entrypoint JSON. ]*/
                             JSON_Object* loader_args = json_object_get_object(module, LOADER_KEY);
                             GATEWAY_MODULE_LOADER_INFO loader_info;
-                            if (parse_loader(loader_args, &loader_info) != PARSE_JSON_SUCCESS)
+                            uint64_t parse_begin_us = gateway_clock_now_us();
+                            PARSE_JSON_RESULT parse_result = parse_loader(loader_args, &loader_info);
+                            if (parse_times != NULL)
+                            {
+                                parse_times[module_index] = gateway_clock_now_us() - parse_begin_us;
+                            }
+                            if (parse_result != PARSE_JSON_SUCCESS)
                             {
                                 result = PARSE_JSON_MISSING_OR_MISCONFIGURED_CONFIG;
                                 LogError("Failed to parse loader configuration.");
@@ -489,7 +964,16 @@ static PARSE_JSON_RESULT parse_json_internal(GATEWAY_PROPERTIES* out_properties,
                             else
                             {
                                 const char* module_name = json_object_get_string(module, MODULE_NAME_KEY);
-                                if (module_name != NULL)
+                                JSON_Value* activation = module_name == NULL ? NULL : json_object_get_value(module, ACTIVATION_KEY);
+                                if (activation != NULL && parse_activation(activation, &loader_info) != 0)
+                                {
+                                    /*Codes_SRS_GATEWAY_JSON_17_043: [ The "activation" of a module shall be "eager", "lazy", or an object with such a "mode" and optionally a "max_queued_messages" from 1 to 65536 and an "idle_timeout_ms"; otherwise the function shall fail. ]*/
+                                    loader_info.loader->api->FreeEntrypoint(loader_info.loader, loader_info.entrypoint);
+                                    result = PARSE_JSON_MISSING_OR_MISCONFIGURED_CONFIG;
+                                    LogError("\"%s\" of module %s is misconfigured.", ACTIVATION_KEY, module_name);
+                                    break;
+                                }
+                                else if (module_name != NULL)
                                 {
                                     /*Codes_SRS_GATEWAY_JSON_14_005: [The function shall set the value of const void* module_properties in the GATEWAY_PROPERTIES instance to a char* representing the serialized args value for the particular module.]*/
                                     JSON_Value *args = json_object_get_value(module, ARG_KEY);
@@ -623,3 +1107,301 @@ static PARSE_JSON_RESULT parse_json_internal(GATEWAY_PROPERTIES* out_properties,
     }
     return result;
 }
+
+#ifdef GATEWAY_CONFIG_SNAPSHOT_ENABLED
+
+#define SNAPSHOT_SUFFIX ".snapshot"
+
+static char* snapshot_path_of(const char* file_path)
+{
+    size_t path_length = strlen(file_path);
+    char* result = (char*)malloc(path_length + sizeof(SNAPSHOT_SUFFIX));
+    if (result == NULL)
+    {
+        LogError("Failed to allocate the snapshot path of %s.", file_path);
+    }
+    else
+    {
+        (void)memcpy(result, file_path, path_length);
+        (void)memcpy(result + path_length, SNAPSHOT_SUFFIX, sizeof(SNAPSHOT_SUFFIX));
+    }
+    return result;
+}
+
+static int apply_snapshot_loaders(const char* loaders)
+{
+    int result;
+    JSON_Value* loaders_json = json_parse_string(loaders);
+    if (loaders_json == NULL)
+    {
+        LogError("Failed to parse the loaders of the snapshot.");
+        result = __LINE__;
+    }
+    else
+    {
+        if (ModuleLoader_InitializeFromJson(loaders_json) != MODULE_LOADER_SUCCESS)
+        {
+            LogError("An error occurred while initializing the loaders of the snapshot.");
+            result = __LINE__;
+        }
+        else
+        {
+            result = 0;
+        }
+        json_value_free(loaders_json);
+    }
+    return result;
+}
+
+/*the snapshot keeps entrypoints as JSON, since only the loader knows what it parses them into*/
+static int parse_snapshot_loader(const GATEWAY_CONFIG_SNAPSHOT_MODULE* module, GATEWAY_MODULE_LOADER_INFO* loader_info)
+{
+    int result;
+    const MODULE_LOADER* loader = ModuleLoader_FindByName(module->loader_name);
+    if (loader == NULL)
+    {
+        LogError("The snapshot has a non-existent loader 'name' specified - %s.", module->loader_name);
+        result = __LINE__;
+    }
+    else if (module->entrypoint == NULL)
+    {
+        loader_info->loader = loader;
+        loader_info->entrypoint = NULL;
+        result = 0;
+    }
+    else
+    {
+        JSON_Value* entrypoint_json = json_parse_string(module->entrypoint);
+        loader_info->loader = loader;
+        loader_info->entrypoint = entrypoint_json == NULL ? NULL :
+            loader->api->ParseEntrypointFromJson(loader, entrypoint_json);
+        if (loader_info->entrypoint == NULL)
+        {
+            LogError("An error occurred when parsing the entrypoint of the snapshot for loader - %s.", module->loader_name);
+            result = __LINE__;
+        }
+        else
+        {
+            result = 0;
+        }
+        json_value_free(entrypoint_json);
+    }
+    return result;
+}
+
+static int parse_snapshot_module_loader(const GATEWAY_CONFIG_SNAPSHOT_MODULE* module, GATEWAY_MODULE_LOADER_INFO* loader_info)
+{
+    int result;
+    if (parse_snapshot_loader(module, loader_info) != 0)
+    {
+        result = __LINE__;
+    }
+    else if (module->activation == NULL)
+    {
+        result = 0;
+    }
+    else
+    {
+        JSON_Value* activation_json = json_parse_string(module->activation);
+        if (activation_json == NULL || parse_activation(activation_json, loader_info) != 0)
+        {
+            LogError("An error occurred when applying the activation of the snapshot to module %s.", module->module_name);
+            loader_info->loader->api->FreeEntrypoint(loader_info->loader, loader_info->entrypoint);
+            result = __LINE__;
+        }
+        else
+        {
+            result = 0;
+        }
+        json_value_free(activation_json);
+    }
+    return result;
+}
+
+/*the names and args of the properties point into the snapshot, so they only live as long as it is open*/
+static int properties_from_snapshot(GATEWAY_CONFIG_SNAPSHOT_HANDLE snapshot, GATEWAY_PROPERTIES* properties, uint64_t* configuration_hashes, uint64_t* entrypoint_us)
+{
+    int result;
+    const char* loaders = GatewayConfigSnapshot_GetLoaders(snapshot);
+    if (loaders != NULL && apply_snapshot_loaders(loaders) != 0)
+    {
+        result = __LINE__;
+    }
+    else if ((properties->gateway_modules = VECTOR_create(sizeof(GATEWAY_MODULES_ENTRY))) == NULL ||
+        (properties->gateway_links = VECTOR_create(sizeof(GATEWAY_LINK_ENTRY))) == NULL)
+    {
+        LogError("Failed to create the properties vectors of the snapshot.");
+        result = __LINE__;
+    }
+    else
+    {
+        size_t module_count = GatewayConfigSnapshot_GetModuleCount(snapshot);
+        size_t link_count = GatewayConfigSnapshot_GetLinkCount(snapshot);
+        size_t index;
+        result = 0;
+        for (index = 0; index < module_count && result == 0; index++)
+        {
+            GATEWAY_CONFIG_SNAPSHOT_MODULE module;
+            GATEWAY_MODULES_ENTRY entry;
+            uint64_t parse_begin_us = gateway_clock_now_us();
+            GatewayConfigSnapshot_GetModule(snapshot, index, &module);
+            entry.module_name = module.module_name;
+            entry.module_configuration = module.args;
+            if (parse_snapshot_module_loader(&module, &entry.module_loader_info) != 0)
+            {
+                result = __LINE__;
+            }
+            else if (VECTOR_push_back(properties->gateway_modules, &entry, 1) != 0)
+            {
+                LogError("Failed to push data into properties vector.");
+                entry.module_loader_info.loader->api->FreeEntrypoint(entry.module_loader_info.loader, entry.module_loader_info.entrypoint);
+                result = __LINE__;
+            }
+            else
+            {
+                configuration_hashes[index] = module.configuration_hash;
+                entrypoint_us[index] = gateway_clock_now_us() - parse_begin_us;
+            }
+        }
+        for (index = 0; index < link_count && result == 0; index++)
+        {
+            GATEWAY_LINK_ENTRY link;
+            GatewayConfigSnapshot_GetLink(snapshot, index, &link);
+            if (VECTOR_push_back(properties->gateway_links, &link, 1) != 0)
+            {
+                LogError("Failed to push data into links vector.");
+                result = __LINE__;
+            }
+        }
+    }
+    return result;
+}
+
+static void destroy_snapshot_properties(GATEWAY_PROPERTIES* properties)
+{
+    if (properties->gateway_modules != NULL)
+    {
+        size_t vector_size = VECTOR_size(properties->gateway_modules);
+        for (size_t element_index = 0; element_index < vector_size; ++element_index)
+        {
+            GATEWAY_MODULES_ENTRY* element = (GATEWAY_MODULES_ENTRY*)VECTOR_element(properties->gateway_modules, element_index);
+            element->module_loader_info.loader->api->FreeEntrypoint(element->module_loader_info.loader, element->module_loader_info.entrypoint);
+        }
+        VECTOR_destroy(properties->gateway_modules);
+        properties->gateway_modules = NULL;
+    }
+    if (properties->gateway_links != NULL)
+    {
+        VECTOR_destroy(properties->gateway_links);
+        properties->gateway_links = NULL;
+    }
+}
+
+/*returns false if there is no snapshot of the file as it is now or it cannot be used, so the file has to be parsed;*/
+/*otherwise gw is the gateway created from the snapshot, NULL if creating or starting it failed*/
+static bool create_from_snapshot(const char* snapshot_path, uint64_t source_hash, uint64_t begin_us, GATEWAY_HANDLE* gw)
+{
+    bool result;
+    GATEWAY_CONFIG_SNAPSHOT_HANDLE snapshot = GatewayConfigSnapshot_Open(snapshot_path, source_hash);
+    if (snapshot == NULL)
+    {
+        result = false;
+    }
+    else
+    {
+        GATEWAY_PROPERTIES properties;
+        size_t module_count = GatewayConfigSnapshot_GetModuleCount(snapshot);
+        /*the hashes of the modules, followed by the times parsing their entrypoints took*/
+        uint64_t* module_values = (uint64_t*)malloc((module_count == 0 ? 1 : 2 * module_count) * sizeof(uint64_t));
+        properties.gateway_modules = NULL;
+        properties.gateway_links = NULL;
+        if (module_values == NULL)
+        {
+            /*Codes_SRS_GATEWAY_JSON_17_042: [ If the snapshot cannot be used, the function shall create the gateway from the file. ]*/
+            LogError("Failed to allocate the module hashes of the snapshot.");
+            result = false;
+        }
+        else if (properties_from_snapshot(snapshot, &properties, module_values, module_values + module_count) != 0)
+        {
+            /*Codes_SRS_GATEWAY_JSON_17_042: [ If the snapshot cannot be used, the function shall create the gateway from the file. ]*/
+            LogError("Failed to use the snapshot %s, parsing the configuration instead.", snapshot_path);
+            result = false;
+        }
+        else
+        {
+            /*Codes_SRS_GATEWAY_JSON_17_041: [ If the snapshot was written from the file as it is now, the function shall create and start the gateway from the snapshot without parsing the file. ]*/
+            *gw = create_and_start(&properties, NULL, module_values, module_values + module_count, begin_us, gateway_clock_now_us() - begin_us);
+            result = true;
+        }
+        destroy_snapshot_properties(&properties);
+        free(module_values);
+        GatewayConfigSnapshot_Close(snapshot);
+    }
+    return result;
+}
+
+static void write_snapshot(const char* snapshot_path, uint64_t source_hash, JSON_Value* root, const GATEWAY_PROPERTIES* properties)
+{
+    JSON_Object* json_document = json_value_get_object(root);
+    JSON_Array* modules_array = json_object_get_array(json_document, MODULES_KEY);
+    JSON_Value* loaders_json = json_object_get_value(json_document, LOADERS_KEY);
+    size_t module_count = VECTOR_size(properties->gateway_modules);
+    GATEWAY_CONFIG_SNAPSHOT_MODULE* modules = (GATEWAY_CONFIG_SNAPSHOT_MODULE*)malloc((module_count == 0 ? 1 : module_count) * sizeof(GATEWAY_CONFIG_SNAPSHOT_MODULE));
+    char* loaders = loaders_json == NULL ? NULL : json_serialize_to_string(loaders_json);
+    if (modules == NULL || (loaders_json != NULL && loaders == NULL))
+    {
+        LogError("Failed to prepare the snapshot %s.", snapshot_path);
+    }
+    else
+    {
+        size_t index;
+        bool serialized = true;
+        for (index = 0; index < module_count; index++)
+        {
+            const GATEWAY_MODULES_ENTRY* entry = (const GATEWAY_MODULES_ENTRY*)VECTOR_element(properties->gateway_modules, index);
+            JSON_Object* module_json = json_array_get_object(modules_array, index);
+            JSON_Object* loader_json = json_object_get_object(module_json, LOADER_KEY);
+            JSON_Value* entrypoint_json = json_object_get_value(loader_json, LOADER_ENTRYPOINT_KEY);
+            JSON_Value* activation_json = json_object_get_value(module_json, ACTIVATION_KEY);
+            const char* loader_name = json_object_get_string(loader_json, LOADER_NAME_KEY);
+            modules[index].module_name = entry->module_name;
+            /*the loader of a lazy module is the stand-in, the snapshot keeps the one it wraps and the activation*/
+            modules[index].loader_name = loader_name == NULL ? DYNAMIC_LOADER_NAME : loader_name;
+            modules[index].entrypoint = entrypoint_json == NULL ? NULL : json_serialize_to_string(entrypoint_json);
+            modules[index].args = (const char*)entry->module_configuration;
+            modules[index].activation = activation_json == NULL ? NULL : json_serialize_to_string(activation_json);
+            modules[index].configuration_hash = configuration_hash(json_array_get_value(modules_array, index));
+            serialized = serialized &&
+                (entrypoint_json == NULL || modules[index].entrypoint != NULL) &&
+                (activation_json == NULL || modules[index].activation != NULL);
+        }
+
+        /*the links are kept contiguously by the vector*/
+        if (!serialized ||
+            GatewayConfigSnapshot_Write(snapshot_path, source_hash, loaders, modules, module_count,
+                (const GATEWAY_LINK_ENTRY*)VECTOR_front(properties->gateway_links), VECTOR_size(properties->gateway_links)) != 0)
+        {
+            /*not a failure of the gateway, the next one parses the file again*/
+            LogError("Failed to write the snapshot %s.", snapshot_path);
+        }
+
+        for (index = 0; index < module_count; index++)
+        {
+            if (modules[index].entrypoint != NULL)
+            {
+                json_free_serialized_string((char*)modules[index].entrypoint);
+            }
+            if (modules[index].activation != NULL)
+            {
+                json_free_serialized_string((char*)modules[index].activation);
+            }
+        }
+    }
+    if (loaders != NULL)
+    {
+        json_free_serialized_string(loaders);
+    }
+    free(modules);
+}
+
+#endif
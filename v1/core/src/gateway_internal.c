@@ -17,11 +17,68 @@
 #endif
 
 #include "gateway_internal.h"
+#include "internal/gateway_atomic.h"
+#include "internal/gateway_clock.h"
 
 #define GATEWAY_ALL "*"
 
+/*how the event system runs callbacks; the build can select EVENTSYSTEM_DISPATCHER_ON_DEMAND instead*/
+#ifndef GATEWAY_EVENT_DISPATCHER
+#define GATEWAY_EVENT_DISPATCHER EVENTSYSTEM_DISPATCHER_PERSISTENT
+#endif
+
+/*most threads that create or start modules at the same time, the calling thread included; 1 makes the gateway create and start them one after the other*/
+#ifndef GATEWAY_MODULE_THREADS
+#define GATEWAY_MODULE_THREADS 8
+#endif
+
 static MODULE_DATA *no_module = NULL;
 
+/*the modules vector only needs guarding once a metrics thread may read it*/
+static void lock_modules(GATEWAY_HANDLE_DATA* gateway_handle)
+{
+    if (gateway_handle->metrics != NULL && Lock(gateway_handle->metrics->modules_lock) != LOCK_OK)
+    {
+        LogError("Failed to lock the gateway modules");
+    }
+}
+
+static void unlock_modules(GATEWAY_HANDLE_DATA* gateway_handle)
+{
+    if (gateway_handle->metrics != NULL)
+    {
+        (void)Unlock(gateway_handle->metrics->modules_lock);
+    }
+}
+
+/*charges the time spent adding a link to the broker to its sink and to the links phase, while the gateway is starting up*/
+static void charge_link_time(GATEWAY_HANDLE_DATA* gateway_handle, MODULE_DATA* module_sink, uint64_t begin_us)
+{
+    if (!gateway_handle->startup.finished)
+    {
+        uint64_t link_us = gateway_clock_now_us() - begin_us;
+        module_sink->startup.links_us += link_us;
+        gateway_handle->startup.links_us += link_us;
+    }
+}
+
+/*nothing can be listening while the gateway is created or destroyed, which is when it has no event system*/
+static void report_module_change(GATEWAY_HANDLE_DATA* gateway_handle, GATEWAY_EVENT event_type, const char* module_name)
+{
+    if (gateway_handle->event_system != NULL)
+    {
+        EventSystem_ReportModuleEvent(gateway_handle->event_system, gateway_handle, event_type, module_name);
+    }
+}
+
+static void report_link_change(GATEWAY_HANDLE_DATA* gateway_handle, GATEWAY_EVENT event_type, const GATEWAY_LINK_ENTRY* link_entry)
+{
+    if (gateway_handle->event_system != NULL)
+    {
+        EventSystem_ReportLinkEvent(gateway_handle->event_system, gateway_handle, event_type, link_entry);
+    }
+}
+
 bool module_name_find(const void* element, const void* module_name)
 {
     const char* module_name_casted = (const char*)module_name;
@@ -107,7 +164,11 @@ static int add_regular_link(GATEWAY_HANDLE_DATA* gateway_handle, const GATEWAY_L
         }
         else
         {
-            if (add_one_link_to_broker(gateway_handle, (*module_source_handle)->module, (*module_sink_handle)->module) != 0)
+            uint64_t link_begin_us = gateway_clock_now_us();
+            int add_result = add_one_link_to_broker(gateway_handle, (*module_source_handle)->module, (*module_sink_handle)->module);
+            /*Codes_SRS_GATEWAY_17_080: [ While the gateway is starting up, the time spent adding a link to the broker shall be charged to the link's sink and to the links phase. ]*/
+            charge_link_time(gateway_handle, *module_sink_handle, link_begin_us);
+            if (add_result != 0)
             {
                 LogError("Unable to add link to Broker.");
                 result = __LINE__;
@@ -148,6 +209,8 @@ GATEWAY_HANDLE gateway_create_internal(const GATEWAY_PROPERTIES* properties, boo
     {
         /* For freeing up NULL ptrs in case of create failure */
         memset(gateway, 0, sizeof(GATEWAY_HANDLE_DATA));
+        /*Codes_SRS_GATEWAY_17_077: [ This function shall take the time the gateway began to be created. ]*/
+        gateway->startup.begin_us = gateway_clock_now_us();
 
         /*Codes_SRS_GATEWAY_14_003: [This function shall create a new BROKER_HANDLE for the gateway representing this gateway's message broker. ]*/
         gateway->broker = Broker_Create();
@@ -186,25 +249,11 @@ GATEWAY_HANDLE gateway_create_internal(const GATEWAY_PROPERTIES* properties, boo
                     {
                         /*Codes_SRS_GATEWAY_14_009: [The function shall use each of GATEWAY_PROPERTIES's gateway_modules to create and add a module to the gateway's message broker. ]*/
                         size_t entries_count = VECTOR_size(properties->gateway_modules);
-                        if (entries_count > 0)
+                        /*Codes_SRS_GATEWAY_14_036: [ If any MODULE_HANDLE is unable to be created from a GATEWAY_MODULES_ENTRY the GATEWAY_HANDLE will be destroyed. ]*/
+                        if (entries_count > 0 && gateway_addmodules_internal(gateway, properties->gateway_modules, entries_count, use_json) != 0)
                         {
-                            //Add the first module, if successful add others
-                            GATEWAY_MODULES_ENTRY* entry = (GATEWAY_MODULES_ENTRY*)VECTOR_element(properties->gateway_modules, 0);
-                            MODULE_HANDLE module = gateway_addmodule_internal(gateway, entry, use_json);
-
-                            //Continue adding modules until all are added or one fails
-                            for (size_t properties_index = 1; properties_index < entries_count && module != NULL; ++properties_index)
-                            {
-                                entry = (GATEWAY_MODULES_ENTRY*)VECTOR_element(properties->gateway_modules, properties_index);
-                                module = gateway_addmodule_internal(gateway, entry, use_json);
-                            }
-
-                            /*Codes_SRS_GATEWAY_14_036: [ If any MODULE_HANDLE is unable to be created from a GATEWAY_MODULES_ENTRY the GATEWAY_HANDLE will be destroyed. ]*/
-                            if (module == NULL)
-                            {
-                                gateway_destroy_internal(gateway);
-                                gateway = NULL;
-                            }
+                            gateway_destroy_internal(gateway);
+                            gateway = NULL;
                         }
 
                         if (gateway != NULL)
@@ -244,7 +293,8 @@ GATEWAY_HANDLE gateway_create_internal(const GATEWAY_PROPERTIES* properties, boo
                         /* TODO: Seperate the gateway init from gateway start-up so that plugins have the chance
                         * register themselves */
                         /*Codes_SRS_GATEWAY_26_001: [ This function shall initialize attached Gateway Events callback system and report GATEWAY_STARTED event. ] */
-                        gateway->event_system = EventSystem_Init();
+                        /*Codes_SRS_GATEWAY_26_021: [ This function shall create the Event System with the `GATEWAY_EVENT_DISPATCHER` dispatcher, which is `EVENTSYSTEM_DISPATCHER_PERSISTENT` unless the build selects otherwise. ] */
+                        gateway->event_system = EventSystem_InitWithDispatcher(GATEWAY_EVENT_DISPATCHER);
                         /*Codes_SRS_GATEWAY_26_002: [ If Gateway Events module fails to be initialized the gateway module shall be destroyed with no events reported. ] */
                         if (gateway->event_system == NULL)
                         {
@@ -279,6 +329,12 @@ void gateway_destroy_internal(GATEWAY_HANDLE gw)
     {
         GATEWAY_HANDLE_DATA* gateway_handle = (GATEWAY_HANDLE_DATA*)gw;
 
+        if (gateway_handle->metrics != NULL)
+        {
+            /*Codes_SRS_GATEWAY_17_030: [ The function shall stop the metrics thread and free the metrics data before destroying the event system. ]*/
+            gateway_metrics_destroy_internal(gateway_handle);
+        }
+
         if (gateway_handle->event_system != NULL)
         {
             /* event_system might be NULL here if destroying during failed creation, event system API should cleanly handle that */
@@ -340,9 +396,82 @@ bool checkIfModuleExists(GATEWAY_HANDLE_DATA* gateway_handle, const char* module
     return module_data == NULL ? false : true;
 }
 
-MODULE_HANDLE gateway_addmodule_internal(GATEWAY_HANDLE_DATA* gateway_handle, const GATEWAY_MODULES_ENTRY* module_entry, bool use_json)
+/*the state of one module on its way into the gateway*/
+typedef struct MODULE_CREATE_TASK_TAG
 {
-    MODULE_HANDLE module_result;
+    const GATEWAY_MODULES_ENTRY* module_entry;
+    BROKER_HANDLE broker;
+    MODULE_DATA* module_data;
+    MODULE_LIBRARY_HANDLE module_library_handle;
+    const MODULE_API* module_apis;
+    const void* module_configuration;
+    const void* transformed_module_configuration;
+    MODULE_HANDLE module_handle;
+    MODULE_STARTUP_TIMES startup;
+} MODULE_CREATE_TASK;
+
+typedef struct PARALLEL_RUN_TAG
+{
+    GATEWAY_PARALLEL_TASK task;
+    void* context;
+    size_t count;
+    volatile size_t next;
+} PARALLEL_RUN;
+
+static int parallel_worker(void* param)
+{
+    PARALLEL_RUN* run = (PARALLEL_RUN*)param;
+    size_t index;
+    while ((index = GATEWAY_ATOMIC_ADD_SIZE(&run->next, 1)) < run->count)
+    {
+        run->task(run->context, index);
+    }
+    return 0;
+}
+
+void gateway_run_parallel(size_t count, GATEWAY_PARALLEL_TASK task, void* context)
+{
+    PARALLEL_RUN run;
+    THREAD_HANDLE threads[GATEWAY_MODULE_THREADS];
+    size_t started = 0;
+    size_t i;
+
+    run.task = task;
+    run.context = context;
+    run.count = count;
+    run.next = 0;
+
+    /*the calling thread takes tasks as well, so a pool that cannot grow still gets through all of them*/
+    while (started + 1 < GATEWAY_MODULE_THREADS && started + 1 < count)
+    {
+        if (ThreadAPI_Create(&threads[started], parallel_worker, &run) != THREADAPI_OK)
+        {
+            LogError("unable to start a module thread, continuing with fewer threads");
+            break;
+        }
+        started++;
+    }
+    (void)parallel_worker(&run);
+    for (i = 0; i < started; i++)
+    {
+        int thread_result;
+        (void)ThreadAPI_Join(threads[i], &thread_result);
+    }
+}
+
+static bool task_name_find(const MODULE_CREATE_TASK* tasks, size_t task_count, const char* module_name)
+{
+    size_t i;
+    for (i = 0; i < task_count && strcmp(tasks[i].module_entry->module_name, module_name) != 0; i++)
+    {
+    }
+    return i < task_count;
+}
+
+/*checks module_entry, loads its library and builds its configuration; the module loaders are not thread safe, so this always runs on the calling thread*/
+static bool prepare_module(GATEWAY_HANDLE_DATA* gateway_handle, MODULE_CREATE_TASK* task, const GATEWAY_MODULES_ENTRY* module_entry, bool use_json, const MODULE_CREATE_TASK* batch, size_t batch_count)
+{
+    bool result;
 
     /*Codes_SRS_GATEWAY_14_011: [ If gw, entry, or GATEWAY_MODULES_ENTRY's loader_configuration or loader_api is NULL the function shall return NULL. ]*/
     if (
@@ -354,7 +483,7 @@ MODULE_HANDLE gateway_addmodule_internal(GATEWAY_HANDLE_DATA* gateway_handle, co
 		module_entry->module_loader_info.loader->api == NULL
        )
     {
-        module_result = NULL;
+        result = false;
         LogError(
             "Failed to add module because a required input parameter is NULL. gw = %p, module_name = '%s', loader = %p, entrypoint = %p.",
             gateway_handle,
@@ -366,228 +495,463 @@ MODULE_HANDLE gateway_addmodule_internal(GATEWAY_HANDLE_DATA* gateway_handle, co
     else if (strcmp(module_entry->module_name, GATEWAY_ALL) == 0)
     {
         /*Codes_SRS_GATEWAY_17_001: [ This function shall not accept "*" as a module name. ]*/
-        module_result = NULL;
+        result = false;
         LogError("Failed to add module because the module_name is invalid [%s]", module_entry->module_name);
     }
+    /*Codes_SRS_GATEWAY_04_004: [ If a module with the same module_name already exists, this function shall fail and the GATEWAY_HANDLE will be destroyed. ]*/
+    else if (checkIfModuleExists(gateway_handle, module_entry->module_name) || task_name_find(batch, batch_count, module_entry->module_name))
+    {
+        result = false;
+        LogError("Error to add module. Duplicated module name: %s", module_entry->module_name);
+    }
     else
     {
-        //First check if a module with a given name already exists.
-        /*Codes_SRS_GATEWAY_04_004: [ If a module with the same module_name already exists, this function shall fail and the GATEWAY_HANDLE will be destroyed. ]*/
-        bool moduleExist = checkIfModuleExists(gateway_handle, module_entry->module_name);
-        if (!moduleExist)
+        task->module_entry = module_entry;
+        task->broker = gateway_handle->broker;
+        task->module_handle = NULL;
+        memset(&task->startup, 0, sizeof(MODULE_STARTUP_TIMES));
+        task->module_data = (MODULE_DATA*)malloc(sizeof(MODULE_DATA));
+        if (task->module_data == NULL)
+        {
+            /*Codes_SRS_GATEWAY_14_031: [If unsuccessful, the function shall return NULL.]*/
+            result = false;
+            LogError("Failed to add module because it could not allocate memory.");
+        }
+        else
         {
-            MODULE_DATA * new_module_data = (MODULE_DATA*)malloc(sizeof(MODULE_DATA));
-            if (new_module_data == NULL)
+            uint64_t phase_begin_us = gateway_clock_now_us();
+            /*Codes_SRS_GATEWAY_14_012: [The function shall load the module located at GATEWAY_MODULES_ENTRY's module_path into a MODULE_LIBRARY_HANDLE. ]*/
+            /*Codes_SRS_GATEWAY_17_015: [ The function shall use the module's specified loader and the module's entrypoint to get each module's MODULE_LIBRARY_HANDLE. ]*/
+            task->module_library_handle = module_entry->module_loader_info.loader->api->Load(
+                module_entry->module_loader_info.loader,
+                module_entry->module_loader_info.entrypoint
+            );
+
+            /*Codes_SRS_GATEWAY_14_031: [If unsuccessful, the function shall return NULL.]*/
+            if (task->module_library_handle == NULL)
             {
-                /*Codes_SRS_GATEWAY_14_031: [If unsuccessful, the function shall return NULL.]*/
-                module_result = NULL;
-                LogError("Failed to add module because it could not allocate memory.");
+                free(task->module_data);
+                result = false;
+                LogError("Failed to add module because the module could not be loaded.");
             }
             else
             {
-                /*Codes_SRS_GATEWAY_14_012: [The function shall load the module located at GATEWAY_MODULES_ENTRY's module_path into a MODULE_LIBRARY_HANDLE. ]*/
-                /*Codes_SRS_GATEWAY_17_015: [ The function shall use the module's specified loader and the module's entrypoint to get each module's MODULE_LIBRARY_HANDLE. ]*/
-                MODULE_LIBRARY_HANDLE module_library_handle = module_entry->module_loader_info.loader->api->Load(
+                //Should always be a safe call.
+                /*Codes_SRS_GATEWAY_14_013: [The function shall get the const MODULE_API* from the MODULE_LIBRARY_HANDLE.]*/
+                task->module_apis = module_entry->module_loader_info.loader->api->GetApi(module_entry->module_loader_info.loader, task->module_library_handle);
+                /*Codes_SRS_GATEWAY_17_078: [ The function shall take the time each step of adding a module took: loading the module, building its configuration, Module_Create and Broker_AddModule. ]*/
+                task->startup.load_us = gateway_clock_now_us() - phase_begin_us;
+                phase_begin_us = gateway_clock_now_us();
+
+                // parse module args if needed
+                task->module_configuration = module_entry->module_configuration;
+                if (use_json)
+                {
+                    task->module_configuration = MODULE_PARSE_CONFIGURATION_FROM_JSON(task->module_apis)(
+                        (const char *)(module_entry->module_configuration)
+                    );
+                }
+
+                // request the loader to transform the module configuration to what the module expects
+                /*Codes_SRS_GATEWAY_17_018: [ The function shall construct module configuration from module's entrypoint and module's module_configuration. ]*/
+                /*Codes_SRS_GATEWAY_17_021: [ The function shall construct module configuration from module's entrypoint and module's module_configuration. ]*/
+                /*Codes_SRS_GATEWAY_JSON_17_011: [ The function shall the loader's BuildModuleConfiguration to construct module input from module's "args" and "loader.entrypoint". ]*/
+                task->transformed_module_configuration = module_entry->module_loader_info.loader->api->BuildModuleConfiguration(
                     module_entry->module_loader_info.loader,
-                    module_entry->module_loader_info.entrypoint
+                    module_entry->module_loader_info.entrypoint,
+                    task->module_configuration
                 );
+                task->startup.parse_configuration_us = gateway_clock_now_us() - phase_begin_us;
+                result = true;
+            }
+        }
+    }
+    return result;
+}
+
+bool gateway_lock_module_calls(const MODULE_LOADER* loader)
+{
+    bool locked = !loader->parallel_create;
+    if (locked && ModuleLoader_LockModuleCalls(loader) != MODULE_LOADER_SUCCESS)
+    {
+        /*like the modules lock, a lock that fails does not hold the gateway back*/
+        LogError("Failed to lock the modules of loader %s, the module is called without it.", loader->name);
+        locked = false;
+    }
+    return locked;
+}
+
+void gateway_unlock_module_calls(const MODULE_LOADER* loader, bool locked)
+{
+    if (locked)
+    {
+        ModuleLoader_UnlockModuleCalls(loader);
+    }
+}
+
+/*runs Module_Create, the slow part of adding a module, which is why it may run on a thread of the pool*/
+static void create_module(void* context, size_t index)
+{
+    MODULE_CREATE_TASK* task = (MODULE_CREATE_TASK*)context + index;
+    const MODULE_LOADER* loader = task->module_entry->module_loader_info.loader;
+    uint64_t begin_us = gateway_clock_now_us();
+    /*Codes_SRS_GATEWAY_17_099: [ If the loader of the module did not set parallel_create, the function shall call Module_Create between ModuleLoader_LockModuleCalls and ModuleLoader_UnlockModuleCalls. ]*/
+    bool locked = gateway_lock_module_calls(loader);
+    /*Codes_SRS_GATEWAY_14_015: [The function shall use the MODULE_API to create a MODULE_HANDLE using the GATEWAY_MODULES_ENTRY's module_configuration. ]*/
+    task->module_handle = MODULE_CREATE(task->module_apis)(task->broker, task->transformed_module_configuration);
+    gateway_unlock_module_calls(loader, locked);
+    /*Codes_SRS_GATEWAY_17_078: [ The function shall take the time each step of adding a module took: loading the module, building its configuration, Module_Create and Broker_AddModule. ]*/
+    task->startup.create_us = gateway_clock_now_us() - begin_us;
+}
+
+static void release_module_configuration(MODULE_CREATE_TASK* task, bool use_json)
+{
+    // free the configurations
+    /*Codes_SRS_GATEWAY_17_020: [ The function shall clean up any constructed resources. ]*/
+    /*Codes_SRS_GATEWAY_17_022: [ The function shall clean up any constructed resources. ]*/
+    if (use_json)
+    {
+        MODULE_FREE_CONFIGURATION(task->module_apis)((void*)task->module_configuration);
+    }
+    task->module_entry->module_loader_info.loader->api->FreeModuleConfiguration(task->module_entry->module_loader_info.loader, task->transformed_module_configuration);
+}
+
+/*destroys the module of a task that will not be attached and unloads its library*/
+static void discard_module(MODULE_CREATE_TASK* task)
+{
+    if (task->module_handle != NULL)
+    {
+        MODULE_DESTROY(task->module_apis)(task->module_handle);
+    }
+    task->module_entry->module_loader_info.loader->api->Unload(task->module_entry->module_loader_info.loader, task->module_library_handle);
+    free(task->module_data);
+}
 
-                /*Codes_SRS_GATEWAY_14_031: [If unsuccessful, the function shall return NULL.]*/
-                if (module_library_handle == NULL)
+/*attaches a created module to the broker and to the gateway, or discards it*/
+static MODULE_HANDLE attach_module(GATEWAY_HANDLE_DATA* gateway_handle, MODULE_CREATE_TASK* task)
+{
+    MODULE_HANDLE module_result;
+    const GATEWAY_MODULES_ENTRY* module_entry = task->module_entry;
+    MODULE_DATA* new_module_data = task->module_data;
+    MODULE_HANDLE module_handle = task->module_handle;
+
+    /*Codes_SRS_GATEWAY_14_016: [If the module creation is unsuccessful, the function shall return NULL.]*/
+    if (module_handle == NULL)
+    {
+        module_result = NULL;
+        discard_module(task);
+        LogError("Module_Create failed.");
+    }
+    else
+    {
+        /*Codes_SRS_GATEWAY_99_011: [The function shall assign `module_apis` to `MODULE::module_apis`. ]*/
+        MODULE module;
+        BROKER_RESULT add_result;
+        uint64_t add_begin_us = gateway_clock_now_us();
+        module.module_apis = task->module_apis;
+        module.module_handle = module_handle;
+
+        /*Codes_SRS_GATEWAY_14_017: [The function shall attach the module to the GATEWAY_HANDLE_DATA's broker using a call to Broker_AddModule. ]*/
+        add_result = Broker_AddModule(gateway_handle->broker, &module);
+        /*Codes_SRS_GATEWAY_17_078: [ The function shall take the time each step of adding a module took: loading the module, building its configuration, Module_Create and Broker_AddModule. ]*/
+        task->startup.add_to_broker_us = gateway_clock_now_us() - add_begin_us;
+        /*Codes_SRS_GATEWAY_14_018: [If the function cannot attach the module to the message broker, the function shall return NULL.]*/
+        if (add_result != BROKER_OK)
+        {
+            module_result = NULL;
+            LogError("Failed to add module to the gateway's broker.");
+        }
+        else
+        {
+            char* name_copied = NULL;
+            /*Codes_SRS_GATEWAY_26_020: [ The function shall make a copy of the name of the module for internal use. ]*/
+            mallocAndStrcpy_s(&name_copied, module_entry->module_name);
+            if (name_copied == NULL)
+            {
+                module_result = NULL;
+                if (Broker_RemoveModule(gateway_handle->broker, &module) != BROKER_OK)
+                {
+                    LogError("Failed to remove module [%p] from the gateway message broker. This module will remain attached.", &module);
+                }
+                LogError("Unable to malloc for module name");
+            }
+            else
+            {
+                strcpy(name_copied, module_entry->module_name);
+                /*Codes_SRS_GATEWAY_14_039: [ The function shall increment the BROKER_HANDLE reference count if the MODULE_HANDLE was successfully added to the GATEWAY_HANDLE_DATA's broker. ]*/
+                Broker_IncRef(gateway_handle->broker);
+                /*Codes_SRS_GATEWAY_14_029: [ The function shall create a new MODULE_DATA containing the MODULE_HANDLE, MODULE_LOADER_API and MODULE_LIBRARY_HANDLE if the module was successfully linked to the message broker. ]*/
+                MODULE_DATA module_data =
                 {
-                    free(new_module_data);
+                    name_copied,
+                    task->module_library_handle,
+                    module_entry->module_loader_info.loader,
+                    module_handle,
+                    0,
+                    0
+                };
+                module_data.startup = task->startup;
+                *new_module_data = module_data;
+                lock_modules(gateway_handle);
+                /*Codes_SRS_GATEWAY_14_032: [The function shall add the new MODULE_DATA to GATEWAY_HANDLE_DATA's modules if the module was successfully attached to the message broker. ]*/
+                if (VECTOR_push_back(gateway_handle->modules, &new_module_data, 1) != 0)
+                {
+                    /*Codes_SRS_GATEWAY_14_019: [The function shall return the newly created MODULE_HANDLE only if each API call returns successfully.]*/
+                    Broker_DecRef(gateway_handle->broker);
+                    free(name_copied);
                     module_result = NULL;
-                    LogError("Failed to add module because the module could not be loaded.");
+                    if (Broker_RemoveModule(gateway_handle->broker, &module) != BROKER_OK)
+                    {
+                        LogError("Failed to remove module [%p] from the gateway message broker. This module will remain attached.", &module);
+                    }
+                    LogError("Unable to add MODULE_DATA* to the gateway module vector.");
                 }
                 else
                 {
-                    //Should always be a safe call.
-                    /*Codes_SRS_GATEWAY_14_013: [The function shall get the const MODULE_API* from the MODULE_LIBRARY_HANDLE.]*/
-                    const MODULE_API* module_apis = module_entry->module_loader_info.loader->api->GetApi(module_entry->module_loader_info.loader, module_library_handle);
-
-                    // parse module args if needed
-                    const void* module_configuration = module_entry->module_configuration;
-                    const void* transformed_module_configuration;
-                    if (use_json)
-                    {
-                        module_configuration = MODULE_PARSE_CONFIGURATION_FROM_JSON(module_apis)(
-                            (const char *)(module_entry->module_configuration)
-                        );
-					}
-
-                    // request the loader to transform the module configuration to what the module expects
-                    /*Codes_SRS_GATEWAY_17_018: [ The function shall construct module configuration from module's entrypoint and module's module_configuration. ]*/
-                    /*Codes_SRS_GATEWAY_17_021: [ The function shall construct module configuration from module's entrypoint and module's module_configuration. ]*/
-                    /*Codes_SRS_GATEWAY_JSON_17_011: [ The function shall the loader's BuildModuleConfiguration to construct module input from module's "args" and "loader.entrypoint". ]*/
-                    transformed_module_configuration = module_entry->module_loader_info.loader->api->BuildModuleConfiguration(
-                        module_entry->module_loader_info.loader,
-                        module_entry->module_loader_info.entrypoint,
-                        module_configuration
-                    );
+                    /*Codes_SRS_GATEWAY_14_019: [The function shall return the newly created MODULE_HANDLE only if each API call returns successfully.]*/
+                    module_result = module_handle;
+                }
+                unlock_modules(gateway_handle);
 
-                    /*Codes_SRS_GATEWAY_14_015: [The function shall use the MODULE_API to create a MODULE_HANDLE using the GATEWAY_MODULES_ENTRY's module_configuration. ]*/
-                    MODULE_HANDLE module_handle = MODULE_CREATE(module_apis)(gateway_handle->broker, transformed_module_configuration);
+                if (module_result != NULL)
+                {
+                    /*Codes_SRS_GATEWAY_17_095: [ Once the gateway has its event system, the function shall report `GATEWAY_MODULE_ADDED` with the name of every module it added. ]*/
+                    report_module_change(gateway_handle, GATEWAY_MODULE_ADDED, name_copied);
+                }
+            }
+        }
 
-                    // free the configurations
-                    /*Codes_SRS_GATEWAY_17_020: [ The function shall clean up any constructed resources. ]*/
-                    /*Codes_SRS_GATEWAY_17_022: [ The function shall clean up any constructed resources. ]*/
-                    if (use_json)
-                    {
-                        MODULE_FREE_CONFIGURATION(module_apis)((void*)module_configuration);
-                    }
-                    module_entry->module_loader_info.loader->api->FreeModuleConfiguration(module_entry->module_loader_info.loader, transformed_module_configuration);
+        /*Codes_SRS_GATEWAY_14_030: [If any internal API call is unsuccessful after a module is created, the library will be unloaded and the module destroyed.]*/
+        if (module_result == NULL)
+        {
+            discard_module(task);
+        }
+    }
 
-                    /*Codes_SRS_GATEWAY_14_016: [If the module creation is unsuccessful, the function shall return NULL.]*/
-                    if (module_handle == NULL)
-                    {
-                        free(new_module_data);
-                        module_result = NULL;
-                        module_entry->module_loader_info.loader->api->Unload(module_entry->module_loader_info.loader, module_library_handle);
-                        LogError("Module_Create failed.");
-                    }
-                    else
-                    {
-                        /*Codes_SRS_GATEWAY_99_011: [The function shall assign `module_apis` to `MODULE::module_apis`. ]*/
-                        MODULE module;
-                        module.module_apis = module_apis;
-                        module.module_handle = module_handle;
-
-                        /*Codes_SRS_GATEWAY_14_017: [The function shall attach the module to the GATEWAY_HANDLE_DATA's broker using a call to Broker_AddModule. ]*/
-                        /*Codes_SRS_GATEWAY_14_018: [If the function cannot attach the module to the message broker, the function shall return NULL.]*/
-                        if (Broker_AddModule(gateway_handle->broker, &module) != BROKER_OK)
-                        {
-                            free(new_module_data);
-                            module_result = NULL;
-                            LogError("Failed to add module to the gateway's broker.");
-                        }
-                        else
-                        {
-                            char* name_copied = NULL;
-                            /*Codes_SRS_GATEWAY_26_020: [ The function shall make a copy of the name of the module for internal use. ]*/
-                            mallocAndStrcpy_s(&name_copied, module_entry->module_name);
-                            if (name_copied == NULL)
-                            {
-                                free(new_module_data);
-                                module_result = NULL;
-                                if (Broker_RemoveModule(gateway_handle->broker, &module) != BROKER_OK)
-                                {
-                                    LogError("Failed to remove module [%p] from the gateway message broker. This module will remain attached.", &module);
-                                }
-                                LogError("Unable to malloc for module name");
-                            }
-                            else
-                            {
-                                strcpy(name_copied, module_entry->module_name);
-                                /*Codes_SRS_GATEWAY_14_039: [ The function shall increment the BROKER_HANDLE reference count if the MODULE_HANDLE was successfully added to the GATEWAY_HANDLE_DATA's broker. ]*/
-                                Broker_IncRef(gateway_handle->broker);
-                                /*Codes_SRS_GATEWAY_14_029: [ The function shall create a new MODULE_DATA containing the MODULE_HANDLE, MODULE_LOADER_API and MODULE_LIBRARY_HANDLE if the module was successfully linked to the message broker. ]*/
-                                MODULE_DATA module_data =
-                                {
-                                    name_copied,
-                                    module_library_handle,
-                                    module_entry->module_loader_info.loader,
-                                    module_handle
-                                };
-                                *new_module_data = module_data;
-                                /*Codes_SRS_GATEWAY_14_032: [The function shall add the new MODULE_DATA to GATEWAY_HANDLE_DATA's modules if the module was successfully attached to the message broker. ]*/
-                                if (VECTOR_push_back(gateway_handle->modules, &new_module_data, 1) != 0)
-                                {
-                                    /*Codes_SRS_GATEWAY_14_019: [The function shall return the newly created MODULE_HANDLE only if each API call returns successfully.]*/
-                                    Broker_DecRef(gateway_handle->broker);
-                                    free(new_module_data);
-                                    free(name_copied);
-                                    module_result = NULL;
-                                    if (Broker_RemoveModule(gateway_handle->broker, &module) != BROKER_OK)
-                                    {
-                                        LogError("Failed to remove module [%p] from the gateway message broker. This module will remain attached.", &module);
-                                    }
-                                    LogError("Unable to add MODULE_DATA* to the gateway module vector.");
-                                }
-                                else
-                                {
-                                    if (add_module_to_any_source(gateway_handle, *(MODULE_DATA**)VECTOR_back(gateway_handle->modules)) != 0)
-                                    {
-                                        /*Codes_SRS_GATEWAY_14_019: [The function shall return the newly created MODULE_HANDLE only if each API call returns successfully.]*/
-                                        Broker_DecRef(gateway_handle->broker);
-                                        module_result = NULL;
-                                        if (Broker_RemoveModule(gateway_handle->broker, &module) != BROKER_OK)
-                                        {
-                                            LogError("Failed to remove module [%p] from the gateway message broker. This module will remain attached.", &module);
-                                        }
-                                        VECTOR_erase(gateway_handle->modules, VECTOR_back(gateway_handle->modules), 1);
-                                        free(new_module_data);
-                                        free(name_copied);
-                                        LogError("Unable to add MODULE_DATA* to existing broker links.");
-                                    }
-                                    else
-                                    {
-                                        /*Codes_SRS_GATEWAY_14_019: [The function shall return the newly created MODULE_HANDLE only if each API call returns successfully.]*/
-                                        module_result = module_handle;
-                                    }
-                                }
-                            }
-                        }
+    return module_result;
+}
 
-                        /*Codes_SRS_GATEWAY_14_030: [If any internal API call is unsuccessful after a module is created, the library will be unloaded and the module destroyed.]*/
-                        if (module_result == NULL)
-                        {
-                            MODULE_DESTROY(module_apis)(module_handle);
-                            module_entry->module_loader_info.loader->api->Unload(module_entry->module_loader_info.loader, module_library_handle);
-                        }
-                    }
-                }
+MODULE_HANDLE gateway_addmodule_internal(GATEWAY_HANDLE_DATA* gateway_handle, const GATEWAY_MODULES_ENTRY* module_entry, bool use_json)
+{
+    MODULE_HANDLE module_result;
+    MODULE_CREATE_TASK task;
+
+    if (!prepare_module(gateway_handle, &task, module_entry, use_json, NULL, 0))
+    {
+        module_result = NULL;
+    }
+    else
+    {
+        create_module(&task, 0);
+        release_module_configuration(&task, use_json);
+        module_result = attach_module(gateway_handle, &task);
+
+        /*Codes_SRS_GATEWAY_17_079: [ While the gateway is starting up, the function shall take the time loading, creating and attaching the modules took. ]*/
+        if (module_result != NULL && !gateway_handle->startup.finished)
+        {
+            gateway_handle->startup.load_modules_us += task.startup.load_us + task.startup.parse_configuration_us;
+            gateway_handle->startup.create_modules_us += task.startup.create_us;
+            gateway_handle->startup.add_modules_us += task.startup.add_to_broker_us;
+        }
+    }
+
+    return module_result;
+}
+
+int gateway_addmodules_internal(GATEWAY_HANDLE_DATA* gateway_handle, VECTOR_HANDLE module_entries, size_t entries_count, bool use_json)
+{
+    int result;
+    MODULE_CREATE_TASK* tasks = (MODULE_CREATE_TASK*)malloc(entries_count * sizeof(MODULE_CREATE_TASK));
+    if (tasks == NULL)
+    {
+        LogError("Failed to add modules because it could not allocate memory.");
+        result = __LINE__;
+    }
+    else
+    {
+        size_t prepared = 0;
+        size_t i;
+        uint64_t phase_begin_us = gateway_clock_now_us();
+        uint64_t load_modules_us;
+        uint64_t create_modules_us;
+        /*Codes_SRS_GATEWAY_17_072: [ The function shall load every module and build its configuration on the calling thread, one after the other. ]*/
+        while (prepared < entries_count &&
+            prepare_module(gateway_handle, &tasks[prepared], (const GATEWAY_MODULES_ENTRY*)VECTOR_element(module_entries, prepared), use_json, tasks, prepared))
+        {
+            prepared++;
+        }
+        load_modules_us = gateway_clock_now_us() - phase_begin_us;
+
+        if (prepared < entries_count)
+        {
+            /*Codes_SRS_GATEWAY_17_075: [ If any module fails to be loaded, created or attached, the function shall destroy the modules it created and unload their libraries. ]*/
+            for (i = 0; i < prepared; i++)
+            {
+                release_module_configuration(&tasks[i], use_json);
+                discard_module(&tasks[i]);
             }
+            result = __LINE__;
         }
         else
         {
-            module_result = NULL;
-            LogError("Error to add module. Duplicated module name: %s", module_entry->module_name);
+            /*Codes_SRS_GATEWAY_17_073: [ The function shall then create the modules concurrently, on at most GATEWAY_MODULE_THREADS threads including the calling one, one at a time for each loader type that did not set parallel_create. ]*/
+            phase_begin_us = gateway_clock_now_us();
+            gateway_run_parallel(entries_count, create_module, tasks);
+            create_modules_us = gateway_clock_now_us() - phase_begin_us;
+
+            /*Codes_SRS_GATEWAY_17_074: [ Once all modules were created, the function shall attach them to the broker and the gateway in the order of the entries. ]*/
+            result = 0;
+            phase_begin_us = gateway_clock_now_us();
+            for (i = 0; i < entries_count; i++)
+            {
+                release_module_configuration(&tasks[i], use_json);
+                if (result != 0)
+                {
+                    /*Codes_SRS_GATEWAY_17_075: [ If any module fails to be loaded, created or attached, the function shall destroy the modules it created and unload their libraries. ]*/
+                    discard_module(&tasks[i]);
+                }
+                else if (attach_module(gateway_handle, &tasks[i]) == NULL)
+                {
+                    result = __LINE__;
+                }
+            }
+
+            /*Codes_SRS_GATEWAY_17_079: [ While the gateway is starting up, the function shall take the time loading, creating and attaching the modules took. ]*/
+            if (!gateway_handle->startup.finished)
+            {
+                gateway_handle->startup.load_modules_us += load_modules_us;
+                gateway_handle->startup.create_modules_us += create_modules_us;
+                gateway_handle->startup.add_modules_us += gateway_clock_now_us() - phase_begin_us;
+            }
         }
+        free(tasks);
     }
-
-    return module_result;
+    return result;
 }
 
 void gateway_removemodule_internal(GATEWAY_HANDLE_DATA* gateway_handle, MODULE_DATA** module_data_pptr)
 {
+    MODULE_DATA * module_data_ptr = *module_data_pptr;
     MODULE module;
     module.module_apis = NULL;
-    module.module_handle = (*module_data_pptr)->module;
+    module.module_handle = module_data_ptr->module;
 
-    remove_module_from_any_source(gateway_handle, *module_data_pptr);
     /* Codes_SRS_GATEWAY_26_018: [ This function shall remove any links that contain the removed module either as a source or sink. ] */
     if (gateway_handle->links)
     {
         LINK_DATA *link;
-        while ((link = VECTOR_find_if(gateway_handle->links, link_name_both_find, (*module_data_pptr)->module_name)) != NULL)
+        while ((link = VECTOR_find_if(gateway_handle->links, link_name_both_find, module_data_ptr->module_name)) != NULL)
         {
             gateway_removelink_internal(gateway_handle, link);
         }
     }
 
-    free((*module_data_pptr)->module_name);
+    /*Codes_SRS_GATEWAY_17_096: [ Once the gateway has its event system, the function shall report `GATEWAY_MODULE_REMOVED` with the name of the module after removing its links. ]*/
+    report_module_change(gateway_handle, GATEWAY_MODULE_REMOVED, module_data_ptr->module_name);
+
+    /*Codes_SRS_GATEWAY_14_026:[The function shall remove that MODULE_DATA from GATEWAY_HANDLE_DATA's modules. ]*/
+    /*Codes_SRS_GATEWAY_17_102: [ The function shall hold the lock of the gateway modules only while it removes the `MODULE_DATA`, and detach, destroy and unload the module after releasing it. ]*/
+    lock_modules(gateway_handle);
+    VECTOR_erase(gateway_handle->modules, module_data_pptr, 1);
+    unlock_modules(gateway_handle);
+
+    free(module_data_ptr->module_name);
 
     /*Codes_SRS_GATEWAY_14_021: [ The function shall detach module from the GATEWAY_HANDLE_DATA's broker BROKER_HANDLE. ]*/
     /*Codes_SRS_GATEWAY_14_022: [ If GATEWAY_HANDLE_DATA's broker cannot detach module, the function shall log the error and continue unloading the module from the GATEWAY_HANDLE. ]*/
     if (Broker_RemoveModule(gateway_handle->broker, &module) != BROKER_OK)
     {
-        LogError("Failed to remove module [%p] from the message broker. This module will remain linked to the broker but will be removed from the gateway.", (*module_data_pptr)->module);
+        LogError("Failed to remove module [%p] from the message broker. This module will remain linked to the broker but will be removed from the gateway.", module_data_ptr->module);
     }
     /*Codes_SRS_GATEWAY_14_038: [ The function shall decrement the BROKER_HANDLE reference count. ]*/
     Broker_DecRef(gateway_handle->broker);
 
     /*Codes_SRS_GATEWAY_14_024: [ The function shall use the MODULE_DATA's module_library_handle to retrieve the MODULE_API and destroy module. ]*/
-    MODULE_DESTROY((*module_data_pptr)->module_loader->api->GetApi((*module_data_pptr)->module_loader, (*module_data_pptr)->module_library_handle))((*module_data_pptr)->module);
+    MODULE_DESTROY(module_data_ptr->module_loader->api->GetApi(module_data_ptr->module_loader, module_data_ptr->module_library_handle))(module_data_ptr->module);
 
     /*Codes_SRS_GATEWAY_14_025: [The function shall unload MODULE_DATA's module_library_handle. ]*/
-    (*module_data_pptr)->module_loader->api->Unload((*module_data_pptr)->module_loader, (*module_data_pptr)->module_library_handle);
+    module_data_ptr->module_loader->api->Unload(module_data_ptr->module_loader, module_data_ptr->module_library_handle);
 
-    /*Codes_SRS_GATEWAY_14_026:[The function shall remove that MODULE_DATA from GATEWAY_HANDLE_DATA's modules. ]*/
-    MODULE_DATA * module_data_ptr = *module_data_pptr;
-    VECTOR_erase(gateway_handle->modules, module_data_pptr, 1);
     free(module_data_ptr);
 }
 
+void gateway_metrics_stop_internal(GATEWAY_METRICS_DATA* metrics)
+{
+    if (metrics->timer_thread != NULL)
+    {
+        int thread_result;
+        /*Codes_SRS_GATEWAY_17_028: [ Once neither snapshots, the receive deadline, memory budgets nor load shedding are enabled, the function shall stop and join the metrics thread. ]*/
+        if (Lock(metrics->timer_lock) != LOCK_OK)
+        {
+            LogError("Failed to lock the metrics timer, the metrics thread will not be joined");
+        }
+        else
+        {
+            metrics->interval_ms = 0;
+            metrics->deadline_ms = 0;
+            metrics->memory_checks = false;
+            metrics->shedding_ms = 0;
+            metrics->reconfigured = true;
+            (void)Condition_Post(metrics->timer_condition);
+            (void)Unlock(metrics->timer_lock);
+            if (ThreadAPI_Join(metrics->timer_thread, &thread_result) != THREADAPI_OK)
+            {
+                LogError("Failed to join the metrics thread");
+            }
+            metrics->timer_thread = NULL;
+        }
+    }
+}
+
+void gateway_metrics_destroy_internal(GATEWAY_HANDLE_DATA* gateway_handle)
+{
+    GATEWAY_METRICS_DATA* metrics = gateway_handle->metrics;
+    gateway_metrics_stop_internal(metrics);
+    if (metrics->baselines != NULL)
+    {
+        VECTOR_destroy(metrics->baselines);
+    }
+    if (metrics->stuck != NULL)
+    {
+        VECTOR_destroy(metrics->stuck);
+    }
+    if (metrics->over_budget != NULL)
+    {
+        VECTOR_destroy(metrics->over_budget);
+    }
+    if (metrics->shedding_baselines != NULL)
+    {
+        VECTOR_destroy(metrics->shedding_baselines);
+    }
+    gateway_shedding_free(&metrics->shedding);
+    if (metrics->timer_condition != NULL)
+    {
+        Condition_Deinit(metrics->timer_condition);
+    }
+    if (metrics->timer_lock != NULL)
+    {
+        (void)Lock_Deinit(metrics->timer_lock);
+    }
+    if (metrics->modules_lock != NULL)
+    {
+        (void)Lock_Deinit(metrics->modules_lock);
+    }
+    free(metrics);
+    gateway_handle->metrics = NULL;
+}
+
+void gateway_shedding_free(GATEWAY_LOAD_SHEDDING* shedding)
+{
+    size_t i;
+    for (i = 0; i < shedding->rule_count; i++)
+    {
+        free((char*)shedding->rules[i].module_name);
+    }
+    free((GATEWAY_SHEDDING_RULE*)shedding->rules);
+    shedding->rules = NULL;
+    shedding->rule_count = 0;
+}
+
 bool gateway_addlink_internal(GATEWAY_HANDLE_DATA* gateway_handle, const GATEWAY_LINK_ENTRY* link_entry)
 {
     bool result;
@@ -630,6 +994,12 @@ bool gateway_addlink_internal(GATEWAY_HANDLE_DATA* gateway_handle, const GATEWAY
         LogError("Error to add link. Duplicated link found. Source_name: %s, Sink_name: %s", link_entry->module_source, link_entry->module_sink);
     }
 
+    if (result)
+    {
+        /*Codes_SRS_GATEWAY_17_097: [ Once the gateway has its event system, the function shall report `GATEWAY_LINK_ADDED` with every link it added. ]*/
+        report_link_change(gateway_handle, GATEWAY_LINK_ADDED, link_entry);
+    }
+
     return result;
 }
 
@@ -653,70 +1023,18 @@ void gateway_removelink_internal(GATEWAY_HANDLE_DATA* gateway_handle, LINK_DATA*
         Broker_RemoveLink(gateway_handle->broker, &broker_data);
     }
 
-    VECTOR_erase(gateway_handle->links, link_data, 1);
-}
-
-int add_module_to_any_source(GATEWAY_HANDLE_DATA* gateway_handle, MODULE_DATA* module)
-{
-    int result = 0;
-    size_t link;
-    size_t num_links = VECTOR_size(gateway_handle->links);
-    for (link = 0; link < num_links; link++)
+    if (gateway_handle->event_system != NULL)
     {
-        LINK_DATA * link_data = VECTOR_element(gateway_handle->links, link);
-        if (link_data->from_any_source)
+        GATEWAY_LINK_ENTRY link_entry =
         {
-            MODULE_DATA** module_sink = (MODULE_DATA**)VECTOR_find_if(gateway_handle->modules, module_name_find, link_data->module_sink->module_name);
-            if (module_sink == NULL)
-            {
-                LogError("Link failure between [%s] and [%s]", link_data->module_sink->module_name, module->module_name);
-                result = __LINE__;
-                break;
-            }
-            else
-            {
-                if (add_one_link_to_broker(gateway_handle, module->module, (*module_sink)->module) != 0)
-                {
-                    result = __LINE__;
-                    break;
-                }
-            }
-        }
-    }
-    if (result != 0)
-    {
-        remove_module_from_any_source(gateway_handle, module);
+            link_data->from_any_source ? GATEWAY_ALL : link_data->module_source->module_name,
+            link_data->module_sink->module_name
+        };
+        /*Codes_SRS_GATEWAY_17_098: [ Once the gateway has its event system, the function shall report `GATEWAY_LINK_REMOVED` with the link, whose source is "*" for a link from every module. ]*/
+        report_link_change(gateway_handle, GATEWAY_LINK_REMOVED, &link_entry);
     }
 
-    return result;
-}
-
-void remove_module_from_any_source(GATEWAY_HANDLE_DATA* gateway_handle, MODULE_DATA* module)
-{
-    if (gateway_handle->links)
-    {
-        size_t link;
-        size_t num_links = VECTOR_size(gateway_handle->links);
-        for (link = 0; link < num_links; link++)
-        {
-            LINK_DATA * link_data = VECTOR_element(gateway_handle->links, link);
-            if (link_data->from_any_source)
-            {
-                MODULE_DATA** module_sink = (MODULE_DATA**)VECTOR_find_if(gateway_handle->modules, module_name_find, link_data->module_sink->module_name);
-                if (module_sink == NULL)
-                {
-                    LogError("Could not find sink for link [%s]", link_data->module_sink);
-                }
-                else
-                {
-                    if (remove_one_link_from_broker(gateway_handle, module->module, (*module_sink)->module) != 0)
-                    {
-                        LogError("Unable to remove link to Broker.");
-                    }
-                }
-            }
-        }
-    }
+    VECTOR_erase(gateway_handle->links, link_data, 1);
 }
 
 int add_any_source_link(GATEWAY_HANDLE_DATA* gateway_handle, const GATEWAY_LINK_ENTRY* link_entry)
@@ -749,24 +1067,20 @@ int add_any_source_link(GATEWAY_HANDLE_DATA* gateway_handle, const GATEWAY_LINK_
         else
         {
             /*Codes_SRS_GATEWAY_17_003: [ The gateway shall treat a source of "*" as link to the sink module from every other module in gateway. ]*/
-            size_t m;
-            size_t num_modules = VECTOR_size(gateway_handle->modules);
-            result = 0;
-            for (m = 0; m < num_modules; m++)
+            /*Codes_SRS_GATEWAY_17_005: [ For this link, the sink shall receive all messages publish by other modules. ]*/
+            uint64_t link_begin_us = gateway_clock_now_us();
+            BROKER_RESULT add_result = Broker_AddAnySourceLink(gateway_handle->broker, (*module_sink_data)->module);
+            /*Codes_SRS_GATEWAY_17_080: [ While the gateway is starting up, the time spent adding a link to the broker shall be charged to the link's sink and to the links phase. ]*/
+            charge_link_time(gateway_handle, *module_sink_data, link_begin_us);
+            if (add_result != BROKER_OK)
             {
-                MODULE_DATA **source_module_data = (MODULE_DATA **)VECTOR_element(gateway_handle->modules, m);
-                /*Codes_SRS_GATEWAY_17_005: [ For this link, the sink shall receive all messages publish by other modules. ]*/
-                if ((*source_module_data)->module != (*module_sink_data)->module &&
-                    add_one_link_to_broker(gateway_handle, (*source_module_data)->module, (*module_sink_data)->module) != 0)
-                {
-                    result = __LINE__;
-                    break;
-                }
+                LogError("Unable to add any-source link to Broker for sink %s.", link_entry->module_sink);
+                VECTOR_erase(gateway_handle->links, VECTOR_back(gateway_handle->links), 1);
+                result = __LINE__;
             }
-            if (result != 0)
+            else
             {
-                remove_any_source_link(gateway_handle, &link_data);
-                VECTOR_erase(gateway_handle->links, VECTOR_back(gateway_handle->links), 1);
+                result = 0;
             }
         }
     }
@@ -780,23 +1094,15 @@ void remove_any_source_link(GATEWAY_HANDLE_DATA* gateway_handle, LINK_DATA* link
     /*Codes_SRS_GATEWAY_04_011: [If the module referenced by the entryLink->module_source or entryLink->module_sink doesn't exists this function shall return GATEWAY_ADD_LINK_ERROR ] */
     if (module_sink_data != NULL)
     {
-        size_t m;
-        size_t num_modules = VECTOR_size(gateway_handle->modules);
-        for (m = 0; m < num_modules; m++)
+        if (Broker_RemoveAnySourceLink(gateway_handle->broker, (*module_sink_data)->module) != BROKER_OK)
         {
-            MODULE_DATA **source_module_data = (MODULE_DATA **)VECTOR_element(gateway_handle->modules, m);
-            if ((*source_module_data)->module != (*module_sink_data)->module &&
-                remove_one_link_from_broker(gateway_handle, (*source_module_data)->module, (*module_sink_data)->module) != 0)
-            {
-                LogError("Unable to remove link to Broker.");
-            }
+            LogError("Unable to remove any-source link from Broker.");
         }
     }
     else
     {
-        LogError("Sink module doesn't exists on this gateway. Module Name: %s.", link_entry->module_sink);
+        LogError("Sink module doesn't exists on this gateway. Module Name: %s.", link_entry->module_sink->module_name);
     }
-
 }
 
 /* Searches both sources and sinks. */
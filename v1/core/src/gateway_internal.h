@@ -4,13 +4,50 @@
 #ifndef GATEWAY_INTERNAL_H
 #define GATEWAY_INTERNAL_H
 
+#include <stdint.h>
+#include "azure_c_shared_utility/lock.h"
+#include "azure_c_shared_utility/condition.h"
+#include "azure_c_shared_utility/threadapi.h"
 #include "module_loader.h"
+#include "broker.h"
 
 #ifdef __cplusplus
 extern "C"
 {
 #endif
 
+typedef struct MODULE_STARTUP_TIMES_TAG {
+    /** @brief  Time the loader's ParseEntrypointFromJson took, in
+     *          microseconds, 0 if the module was not added from JSON
+     */
+    uint64_t parse_entrypoint_us;
+
+    /** @brief  Time the loader's Load and GetApi took, in microseconds */
+    uint64_t load_us;
+
+    /** @brief  Time Module_ParseConfigurationFromJson and the loader's
+     *          BuildModuleConfiguration took, in microseconds
+     */
+    uint64_t parse_configuration_us;
+
+    /** @brief  Time Module_Create took, in microseconds */
+    uint64_t create_us;
+
+    /** @brief  Time Broker_AddModule took, in microseconds */
+    uint64_t add_to_broker_us;
+
+    /** @brief  Time spent adding the startup links into the module, in
+     *          microseconds
+     */
+    uint64_t links_us;
+
+    /** @brief  Time Module_Start took, in microseconds */
+    uint64_t start_us;
+
+    /** @brief  Whether the module was started by the first Gateway_Start */
+    bool started_with_gateway;
+} MODULE_STARTUP_TIMES;
+
 typedef struct MODULE_DATA_TAG {
     /** @brief  The name of the module added. This name is unique on a gateway.
      */
@@ -26,8 +63,131 @@ typedef struct MODULE_DATA_TAG {
      *          broker.
      */
     MODULE_HANDLE module;
+
+    /** @brief  Thread CPU time the module's Module_Start used, in
+     *          microseconds.
+     */
+    uint64_t start_cpu_us;
+
+    /** @brief  Hash of the JSON object the module was configured from, 0 if
+     *          it was not added from a JSON configuration.
+     */
+    uint64_t configuration_hash;
+
+    /** @brief  Where the time to bring the module up went */
+    MODULE_STARTUP_TIMES startup;
 } MODULE_DATA;
 
+typedef struct METRICS_BASELINE_TAG {
+    /** @brief  The module the counters were read from */
+    MODULE_HANDLE module;
+
+    /** @brief  The broker counters at the previous snapshot */
+    BROKER_MODULE_METRICS metrics;
+
+    /** @brief  All the CPU time charged to the module at the previous
+     *          snapshot, in microseconds
+     */
+    uint64_t cpu_us;
+} METRICS_BASELINE;
+
+typedef struct GATEWAY_METRICS_DATA_TAG {
+    /** @brief  Guards the gateway's modules vector against the metrics thread */
+    LOCK_HANDLE modules_lock;
+
+    /** @brief  Guards interval_ms and signals timer_thread when it changes */
+    LOCK_HANDLE timer_lock;
+    COND_HANDLE timer_condition;
+
+    /** @brief  Thread reporting GATEWAY_METRICS_SNAPSHOT, NULL when stopped */
+    THREAD_HANDLE timer_thread;
+
+    /** @brief  Milliseconds between snapshots, 0 disables them */
+    unsigned int interval_ms;
+
+    /** @brief  Milliseconds a module may spend in Module_Receive, 0 disables
+     *          the watchdog
+     */
+    unsigned int deadline_ms;
+
+    /** @brief  Whether the module memory budgets are checked, set once a
+     *          budget was set
+     */
+    bool memory_checks;
+
+    /** @brief  Milliseconds between load shedding checks, 0 disables the
+     *          controller. timer_thread stops once all four are off.
+     */
+    unsigned int shedding_ms;
+
+    /** @brief  Set under timer_lock whenever one of the settings above
+     *          changes, so timer_thread can tell a reconfigure from any
+     *          other wake
+     */
+    bool reconfigured;
+
+    /** @brief  When the previous snapshot was taken, in microseconds */
+    uint64_t last_snapshot_us;
+
+    /** @brief  Vector of METRICS_BASELINE, one per module seen so far */
+    VECTOR_HANDLE baselines;
+
+    /** @brief  Vector of METRICS_BASELINE of the modules the watchdog last
+     *          found past the deadline, guarded by modules_lock
+     */
+    VECTOR_HANDLE stuck;
+
+    /** @brief  Vector of METRICS_BASELINE of the modules last found over
+     *          their memory budget, guarded by modules_lock
+     */
+    VECTOR_HANDLE over_budget;
+
+    /** @brief  The load shedding settings with their own copy of the rules,
+     *          guarded by modules_lock like the rest of the controller state
+     */
+    GATEWAY_LOAD_SHEDDING shedding;
+
+    /** @brief  The last shedding transition and the readings behind it */
+    GATEWAY_LOAD_SHEDDING_STATE shedding_state;
+
+    /** @brief  Vector of METRICS_BASELINE, one per module at the previous
+     *          load shedding check
+     */
+    VECTOR_HANDLE shedding_baselines;
+
+    /** @brief  When the previous load shedding check ran and the process
+     *          CPU time then, in microseconds
+     */
+    uint64_t shedding_check_us;
+    uint64_t shedding_cpu_us;
+} GATEWAY_METRICS_DATA;
+
+typedef struct GATEWAY_STARTUP_DATA_TAG {
+    /** @brief  When the gateway began to be created, in microseconds */
+    uint64_t begin_us;
+
+    /** @brief  Wall time of each startup phase, in microseconds. Loading
+     *          and adding the modules run one module after the other,
+     *          creating and starting them run in parallel.
+     */
+    uint64_t parse_json_us;
+    uint64_t load_modules_us;
+    uint64_t create_modules_us;
+    uint64_t add_modules_us;
+    uint64_t links_us;
+    uint64_t start_modules_us;
+
+    /** @brief  Wall time from begin_us to the end of the first
+     *          Gateway_Start, in microseconds
+     */
+    uint64_t total_us;
+
+    /** @brief  Set once the first Gateway_Start returned, after which the
+     *          startup times no longer change
+     */
+    bool finished;
+} GATEWAY_STARTUP_DATA;
+
 typedef struct GATEWAY_HANDLE_DATA_TAG {
 
     /** @brief  Vector of MODULE_DATA modules that the Gateway must track */
@@ -41,6 +201,12 @@ typedef struct GATEWAY_HANDLE_DATA_TAG {
 
     /** @brief  Vector of LINK_DATA links that the Gateway must track */
     VECTOR_HANDLE links;
+
+    /** @brief  Runtime metrics state, NULL until Gateway_SetMetricsInterval */
+    GATEWAY_METRICS_DATA* metrics;
+
+    /** @brief  Where the time to bring the gateway up went */
+    GATEWAY_STARTUP_DATA startup;
 } GATEWAY_HANDLE_DATA;
 
 typedef struct LINK_DATA_TAG {
@@ -49,18 +215,27 @@ typedef struct LINK_DATA_TAG {
     MODULE_DATA *module_sink;
 } LINK_DATA;
 
+/** @brief  One of the tasks gateway_run_parallel runs, given its index */
+typedef void(*GATEWAY_PARALLEL_TASK)(void* context, size_t index);
+
 GATEWAY_HANDLE gateway_create_internal(const GATEWAY_PROPERTIES* properties, bool use_json);
 void gateway_destroy_internal(GATEWAY_HANDLE gw);
 MODULE_HANDLE gateway_addmodule_internal(GATEWAY_HANDLE_DATA* gateway_handle, const GATEWAY_MODULES_ENTRY* entry, bool use_json);
+int gateway_addmodules_internal(GATEWAY_HANDLE_DATA* gateway_handle, VECTOR_HANDLE module_entries, size_t entries_count, bool use_json);
+void gateway_run_parallel(size_t count, GATEWAY_PARALLEL_TASK task, void* context);
+/*returns whether the module calls of loader were locked, which is when it did not set parallel_create*/
+bool gateway_lock_module_calls(const MODULE_LOADER* loader);
+void gateway_unlock_module_calls(const MODULE_LOADER* loader, bool locked);
 void gateway_removemodule_internal(GATEWAY_HANDLE_DATA* gateway_handle, MODULE_DATA** module);
 bool gateway_addlink_internal(GATEWAY_HANDLE_DATA* gateway_handle, const GATEWAY_LINK_ENTRY* link_entry);
 void gateway_removelink_internal(GATEWAY_HANDLE_DATA* gateway_handle, LINK_DATA* link_data);
-int add_module_to_any_source(GATEWAY_HANDLE_DATA* gateway_handle, MODULE_DATA* module);
-void remove_module_from_any_source(GATEWAY_HANDLE_DATA* gateway_handle, MODULE_DATA* module);
 int add_any_source_link(GATEWAY_HANDLE_DATA* gateway_handle, const GATEWAY_LINK_ENTRY* link_entry);
 void remove_any_source_link(GATEWAY_HANDLE_DATA* gateway_handle, LINK_DATA* link_entry);
 bool module_name_find(const void* element, const void* module_name);
 bool link_data_find(const void* element, const void* link_data);
+void gateway_metrics_stop_internal(GATEWAY_METRICS_DATA* metrics);
+void gateway_metrics_destroy_internal(GATEWAY_HANDLE_DATA* gateway_handle);
+void gateway_shedding_free(GATEWAY_LOAD_SHEDDING* shedding);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,738 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#include <stdint.h>
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/xlogging.h"
+#include "azure_c_shared_utility/refcount.h"
+#include "azure_c_shared_utility/lock.h"
+#include "azure_c_shared_utility/crt_abstractions.h"
+
+#include "module.h"
+#include "module_access.h"
+#include "module_loader.h"
+#include "message_queue.h"
+#include "timer_service.h"
+#include "internal/gateway_clock.h"
+#include "internal/gateway_lazy_module.h"
+
+#define LAZY_LOADER_NAME "lazy"
+
+/*the entrypoint of a stand-in, shared by the entry it was parsed for and every library loaded from it,*/
+/*since the gateway frees the entries once the modules are created*/
+typedef struct LAZY_ENTRYPOINT_TAG
+{
+    const MODULE_LOADER* loader;
+    void* entrypoint;
+    GATEWAY_LAZY_ACTIVATION activation;
+} LAZY_ENTRYPOINT;
+
+DEFINE_REFCOUNT_TYPE(LAZY_ENTRYPOINT);
+
+/*what BuildModuleConfiguration hands to Module_Create; args belongs to the gateway*/
+typedef struct LAZY_CONFIGURATION_TAG
+{
+    LAZY_ENTRYPOINT* entrypoint;
+    const char* args;
+} LAZY_CONFIGURATION;
+
+#define LAZY_MODULE_STATE_VALUES \
+    LAZY_MODULE_INACTIVE, \
+    LAZY_MODULE_ACTIVATING, \
+    LAZY_MODULE_ACTIVE, \
+    LAZY_MODULE_DEACTIVATING, \
+    LAZY_MODULE_FAILED
+
+DEFINE_ENUM(LAZY_MODULE_STATE, LAZY_MODULE_STATE_VALUES);
+
+typedef struct LAZY_MODULE_TAG
+{
+    BROKER_HANDLE broker;
+    LAZY_ENTRYPOINT* entrypoint;
+    char* args;
+
+    /*the activation and the idle check run on it, one after the other*/
+    TIMER_SERVICE_HANDLE timer_service;
+    TIMER_HANDLE idle_timer;
+
+    /*guards everything below; it is never held while the module behind the stand-in runs*/
+    LOCK_HANDLE lock;
+    LAZY_MODULE_STATE state;
+    bool started;
+    bool module_started;
+    /*Module_Receive and Module_Start calls in progress, the module is not destroyed under them*/
+    size_t calls;
+    TIMER_HANDLE activation_timer;
+    MESSAGE_QUEUE_HANDLE pending;
+    size_t pending_dropped;
+
+    MODULE_LIBRARY_HANDLE library;
+    const MODULE_API* api;
+    MODULE_HANDLE module;
+
+    uint64_t last_receive_us;
+} LAZY_MODULE;
+
+static void on_activate(void* context);
+
+static void release_entrypoint(LAZY_ENTRYPOINT* entrypoint)
+{
+    if (DEC_REF(LAZY_ENTRYPOINT, entrypoint) == DEC_RETURN_ZERO)
+    {
+        entrypoint->loader->api->FreeEntrypoint(entrypoint->loader, entrypoint->entrypoint);
+        free(entrypoint);
+    }
+}
+
+static void destroy_pending(LAZY_MODULE* lazy)
+{
+    MESSAGE_HANDLE message;
+    while ((message = MESSAGE_QUEUE_pop(lazy->pending)) != NULL)
+    {
+        Message_Destroy(message);
+        lazy->pending_dropped++;
+    }
+}
+
+/*modules of a loader that did not set parallel_create are loaded, created, started and destroyed one at a time, as the gateway does*/
+static bool lock_module_calls(const MODULE_LOADER* loader)
+{
+    bool locked = !loader->parallel_create;
+    if (locked && ModuleLoader_LockModuleCalls(loader) != MODULE_LOADER_SUCCESS)
+    {
+        LogError("Failed to lock the modules of loader %s, the module is called without it.", loader->name);
+        locked = false;
+    }
+    return locked;
+}
+
+static void unlock_module_calls(const MODULE_LOADER* loader, bool locked)
+{
+    if (locked)
+    {
+        ModuleLoader_UnlockModuleCalls(loader);
+    }
+}
+
+/*called under the lock; returns the timer of the previous activation, which the caller cancels once it released the lock*/
+static TIMER_HANDLE schedule_activation(LAZY_MODULE* lazy)
+{
+    TIMER_HANDLE previous = lazy->activation_timer;
+    lazy->activation_timer = TimerService_Schedule(lazy->timer_service, 0, 0, on_activate, lazy);
+    if (lazy->activation_timer == NULL)
+    {
+        /*the messages stay queued, the next one tries again*/
+        LogError("Failed to schedule the activation.");
+        lazy->state = LAZY_MODULE_INACTIVE;
+    }
+    else
+    {
+        lazy->state = LAZY_MODULE_ACTIVATING;
+    }
+    return previous;
+}
+
+static void cancel_timer(LAZY_MODULE* lazy, TIMER_HANDLE timer)
+{
+    if (timer != NULL)
+    {
+        TimerService_Cancel(lazy->timer_service, timer);
+    }
+}
+
+/*a Module_Receive or Module_Start call made with the lock released returned*/
+static void end_call(LAZY_MODULE* lazy)
+{
+    if (Lock(lazy->lock) != LOCK_OK)
+    {
+        /*the call is never counted out, so the module is kept*/
+        LogError("Lock failed, the module is kept.");
+    }
+    else
+    {
+        lazy->calls--;
+        (void)Unlock(lazy->lock);
+    }
+}
+
+static void start_module(LAZY_MODULE* lazy, const MODULE_API* api, MODULE_HANDLE module)
+{
+    if (MODULE_START(api) != NULL)
+    {
+        const MODULE_LOADER* loader = lazy->entrypoint->loader;
+        bool locked = lock_module_calls(loader);
+        MODULE_START(api)(module);
+        unlock_module_calls(loader, locked);
+    }
+}
+
+/*destroys the module behind the stand-in and unloads its library*/
+static void destroy_module(LAZY_MODULE* lazy, MODULE_LIBRARY_HANDLE library, const MODULE_API* api, MODULE_HANDLE module)
+{
+    const MODULE_LOADER* loader = lazy->entrypoint->loader;
+    bool locked = lock_module_calls(loader);
+    MODULE_DESTROY(api)(module);
+    loader->api->Unload(loader, library);
+    unlock_module_calls(loader, locked);
+}
+
+/*runs on the timer service; the check goes on while the module is inactive, so only Module_Destroy cancels its timer*/
+static void on_idle_check(void* context)
+{
+    LAZY_MODULE* lazy = (LAZY_MODULE*)context;
+    if (Lock(lazy->lock) != LOCK_OK)
+    {
+        LogError("Lock failed, the module is kept.");
+    }
+    else if (lazy->state != LAZY_MODULE_ACTIVE || lazy->calls > 0 ||
+        gateway_clock_now_us() - lazy->last_receive_us < (uint64_t)lazy->entrypoint->activation.idle_timeout_ms * 1000)
+    {
+        (void)Unlock(lazy->lock);
+    }
+    else
+    {
+        /*Codes_SRS_GATEWAY_LAZY_17_014: [ Once an active module received nothing for idle_timeout_ms, the stand-in shall destroy it, unload its library and become inactive. ]*/
+        MODULE_LIBRARY_HANDLE library = lazy->library;
+        const MODULE_API* api = lazy->api;
+        MODULE_HANDLE module = lazy->module;
+        lazy->library = NULL;
+        lazy->api = NULL;
+        lazy->module = NULL;
+        lazy->module_started = false;
+        /*the messages that arrive meanwhile are queued*/
+        lazy->state = LAZY_MODULE_DEACTIVATING;
+        (void)Unlock(lazy->lock);
+
+        (void)Broker_SetModulePublisher(lazy->broker, (MODULE_HANDLE)lazy, NULL);
+        destroy_module(lazy, library, api, module);
+
+        if (Lock(lazy->lock) != LOCK_OK)
+        {
+            LogError("Lock failed, the module is not activated again.");
+        }
+        else
+        {
+            TIMER_HANDLE previous = NULL;
+            lazy->state = LAZY_MODULE_INACTIVE;
+            if (!MESSAGE_QUEUE_is_empty(lazy->pending))
+            {
+                previous = schedule_activation(lazy);
+            }
+            (void)Unlock(lazy->lock);
+            cancel_timer(lazy, previous);
+        }
+    }
+}
+
+/*loads and creates the module behind the stand-in, like the gateway adds a module*/
+static MODULE_HANDLE create_module(LAZY_MODULE* lazy, MODULE_LIBRARY_HANDLE* library, const MODULE_API** api)
+{
+    MODULE_HANDLE result;
+    const MODULE_LOADER* loader = lazy->entrypoint->loader;
+    bool locked = lock_module_calls(loader);
+    *library = loader->api->Load(loader, lazy->entrypoint->entrypoint);
+    if (*library == NULL)
+    {
+        LogError("Failed to load the module.");
+        result = NULL;
+    }
+    else
+    {
+        *api = loader->api->GetApi(loader, *library);
+        void* module_configuration = MODULE_PARSE_CONFIGURATION_FROM_JSON(*api)(lazy->args);
+        void* transformed_configuration = loader->api->BuildModuleConfiguration(loader, lazy->entrypoint->entrypoint, module_configuration);
+        result = MODULE_CREATE(*api)(lazy->broker, transformed_configuration);
+        MODULE_FREE_CONFIGURATION(*api)(module_configuration);
+        loader->api->FreeModuleConfiguration(loader, transformed_configuration);
+        if (result == NULL)
+        {
+            LogError("Module_Create failed.");
+        }
+        /*Codes_SRS_GATEWAY_LAZY_17_010: [ The stand-in shall set the module as its publisher on the broker. ]*/
+        else if (Broker_SetModulePublisher(lazy->broker, (MODULE_HANDLE)lazy, result) != BROKER_OK)
+        {
+            LogError("Failed to route the messages of the module.");
+            MODULE_DESTROY(*api)(result);
+            result = NULL;
+        }
+
+        if (result == NULL)
+        {
+            loader->api->Unload(loader, *library);
+        }
+    }
+    unlock_module_calls(loader, locked);
+    return result;
+}
+
+/*runs on the timer service*/
+static void on_activate(void* context)
+{
+    LAZY_MODULE* lazy = (LAZY_MODULE*)context;
+    MODULE_LIBRARY_HANDLE library = NULL;
+    const MODULE_API* api = NULL;
+    /*Codes_SRS_GATEWAY_LAZY_17_009: [ The activation shall load the library of the module, parse its args, build its configuration with the wrapped loader and create it. ]*/
+    MODULE_HANDLE module = create_module(lazy, &library, &api);
+
+    if (Lock(lazy->lock) != LOCK_OK)
+    {
+        /*the lock is not shared with anything that could fail it but a broken platform, so give up the module*/
+        LogError("Lock failed, the module is not activated.");
+        if (module != NULL)
+        {
+            (void)Broker_SetModulePublisher(lazy->broker, (MODULE_HANDLE)lazy, NULL);
+            destroy_module(lazy, library, api, module);
+        }
+    }
+    else if (module == NULL)
+    {
+        /*Codes_SRS_GATEWAY_LAZY_17_013: [ If the module cannot be activated, the stand-in shall drop the queued messages and every message it receives afterwards. ]*/
+        lazy->state = LAZY_MODULE_FAILED;
+        destroy_pending(lazy);
+        LogError("Failed to activate the module, %lu messages were dropped.", (unsigned long)lazy->pending_dropped);
+        (void)Unlock(lazy->lock);
+    }
+    else
+    {
+        bool activating = true;
+        lazy->library = library;
+        lazy->api = api;
+        lazy->module = module;
+        /*loading may take longer than the idle timeout*/
+        lazy->last_receive_us = gateway_clock_now_us();
+        (void)Unlock(lazy->lock);
+
+        /*the module is started and handed the queue one call at a time with the lock released; what arrives meanwhile is queued behind*/
+        while (activating)
+        {
+            bool start = false;
+            MESSAGE_HANDLE message = NULL;
+            if (Lock(lazy->lock) != LOCK_OK)
+            {
+                LogError("Lock failed, the module stays activating.");
+                activating = false;
+            }
+            else
+            {
+                if (lazy->started && !lazy->module_started)
+                {
+                    lazy->module_started = true;
+                    start = true;
+                }
+                else if ((message = MESSAGE_QUEUE_pop(lazy->pending)) == NULL)
+                {
+                    lazy->state = LAZY_MODULE_ACTIVE;
+                    if (lazy->pending_dropped > 0)
+                    {
+                        LogError("%lu messages arrived while the module was activated and were dropped.", (unsigned long)lazy->pending_dropped);
+                        lazy->pending_dropped = 0;
+                    }
+                    activating = false;
+                }
+                (void)Unlock(lazy->lock);
+
+                if (start)
+                {
+                    /*Codes_SRS_GATEWAY_LAZY_17_011: [ If the stand-in was started, the activation shall start the module. ]*/
+                    start_module(lazy, api, module);
+                }
+                else if (message != NULL)
+                {
+                    /*Codes_SRS_GATEWAY_LAZY_17_012: [ The activation shall then hand the queued messages to the module, oldest first. ]*/
+                    MODULE_RECEIVE(api)(module, message);
+                    Message_Destroy(message);
+                }
+            }
+        }
+    }
+}
+
+static void* LazyModule_ParseConfigurationFromJson(const char* configuration)
+{
+    char* result;
+    /*Codes_SRS_GATEWAY_LAZY_17_004: [ The stand-in shall keep a copy of the serialized args until the module is activated. ]*/
+    if (configuration == NULL)
+    {
+        result = NULL;
+    }
+    else if (mallocAndStrcpy_s(&result, configuration) != 0)
+    {
+        LogError("Failed to copy the module args.");
+        result = NULL;
+    }
+    return result;
+}
+
+static void LazyModule_FreeConfiguration(void* configuration)
+{
+    free(configuration);
+}
+
+static MODULE_HANDLE LazyModule_Create(BROKER_HANDLE broker, const void* configuration)
+{
+    LAZY_MODULE* result;
+    const LAZY_CONFIGURATION* lazy_configuration = (const LAZY_CONFIGURATION*)configuration;
+    if (broker == NULL || lazy_configuration == NULL)
+    {
+        LogError("invalid arguments broker = %p, configuration = %p.", broker, configuration);
+        result = NULL;
+    }
+    else
+    {
+        result = (LAZY_MODULE*)malloc(sizeof(LAZY_MODULE));
+        if (result == NULL)
+        {
+            /*Codes_SRS_GATEWAY_LAZY_17_006: [ If any underlying call fails, Module_Create of the stand-in shall free what it allocated and return NULL. ]*/
+            LogError("Failed to allocate the lazy module.");
+        }
+        else
+        {
+            result->args = NULL;
+            if (lazy_configuration->args != NULL && mallocAndStrcpy_s(&result->args, lazy_configuration->args) != 0)
+            {
+                /*Codes_SRS_GATEWAY_LAZY_17_006: [ If any underlying call fails, Module_Create of the stand-in shall free what it allocated and return NULL. ]*/
+                LogError("Failed to copy the module args.");
+                free(result);
+                result = NULL;
+            }
+            else if ((result->lock = Lock_Init()) == NULL)
+            {
+                /*Codes_SRS_GATEWAY_LAZY_17_006: [ If any underlying call fails, Module_Create of the stand-in shall free what it allocated and return NULL. ]*/
+                LogError("Lock_Init failed.");
+                free(result->args);
+                free(result);
+                result = NULL;
+            }
+            /*Codes_SRS_GATEWAY_LAZY_17_005: [ Module_Create of the stand-in shall create a bounded message queue of max_queued_messages and neither load nor create the module. ]*/
+            else if ((result->pending = MESSAGE_QUEUE_create_bounded(lazy_configuration->entrypoint->activation.max_queued_messages)) == NULL)
+            {
+                /*Codes_SRS_GATEWAY_LAZY_17_006: [ If any underlying call fails, Module_Create of the stand-in shall free what it allocated and return NULL. ]*/
+                LogError("Failed to create the queue of pending messages.");
+                (void)Lock_Deinit(result->lock);
+                free(result->args);
+                free(result);
+                result = NULL;
+            }
+            /*Codes_SRS_GATEWAY_LAZY_17_017: [ Module_Create of the stand-in shall get the timer service of the broker, on which the module is activated and the idle check runs. ]*/
+            else if ((result->timer_service = Broker_GetTimerService(broker)) == NULL)
+            {
+                /*Codes_SRS_GATEWAY_LAZY_17_006: [ If any underlying call fails, Module_Create of the stand-in shall free what it allocated and return NULL. ]*/
+                LogError("Failed to get the timer service of the broker.");
+                MESSAGE_QUEUE_destroy(result->pending);
+                (void)Lock_Deinit(result->lock);
+                free(result->args);
+                free(result);
+                result = NULL;
+            }
+            else
+            {
+                unsigned int idle_timeout_ms = lazy_configuration->entrypoint->activation.idle_timeout_ms;
+                result->broker = broker;
+                result->entrypoint = lazy_configuration->entrypoint;
+                INC_REF(LAZY_ENTRYPOINT, result->entrypoint);
+                result->state = LAZY_MODULE_INACTIVE;
+                result->started = false;
+                result->module_started = false;
+                result->calls = 0;
+                result->activation_timer = NULL;
+                result->pending_dropped = 0;
+                result->library = NULL;
+                result->api = NULL;
+                result->module = NULL;
+                result->idle_timer = NULL;
+                result->last_receive_us = 0;
+
+                if (idle_timeout_ms > 0 &&
+                    (result->idle_timer = TimerService_Schedule(result->timer_service, idle_timeout_ms, idle_timeout_ms, on_idle_check, result)) == NULL)
+                {
+                    /*Codes_SRS_GATEWAY_LAZY_17_006: [ If any underlying call fails, Module_Create of the stand-in shall free what it allocated and return NULL. ]*/
+                    LogError("Failed to schedule the idle check.");
+                    release_entrypoint(result->entrypoint);
+                    MESSAGE_QUEUE_destroy(result->pending);
+                    (void)Lock_Deinit(result->lock);
+                    free(result->args);
+                    free(result);
+                    result = NULL;
+                }
+            }
+        }
+    }
+    return (MODULE_HANDLE)result;
+}
+
+static void LazyModule_Destroy(MODULE_HANDLE moduleHandle)
+{
+    if (moduleHandle != NULL)
+    {
+        LAZY_MODULE* lazy = (LAZY_MODULE*)moduleHandle;
+        /*Codes_SRS_GATEWAY_LAZY_17_015: [ Module_Destroy of the stand-in shall cancel the idle check, wait for an activation in progress, destroy the module if it is active and unload its library. ]*/
+        /*the broker does not deliver anymore and, once the idle check is cancelled, nothing schedules another activation*/
+        cancel_timer(lazy, lazy->idle_timer);
+        cancel_timer(lazy, lazy->activation_timer);
+        if (lazy->module != NULL)
+        {
+            destroy_module(lazy, lazy->library, lazy->api, lazy->module);
+        }
+        destroy_pending(lazy);
+        MESSAGE_QUEUE_destroy(lazy->pending);
+        (void)Lock_Deinit(lazy->lock);
+        release_entrypoint(lazy->entrypoint);
+        free(lazy->args);
+        free(lazy);
+    }
+}
+
+static void LazyModule_Receive(MODULE_HANDLE moduleHandle, MESSAGE_HANDLE messageHandle)
+{
+    LAZY_MODULE* lazy = (LAZY_MODULE*)moduleHandle;
+    if (lazy == NULL || messageHandle == NULL)
+    {
+        LogError("invalid arguments moduleHandle = %p, messageHandle = %p.", moduleHandle, messageHandle);
+    }
+    else if (Lock(lazy->lock) != LOCK_OK)
+    {
+        LogError("Lock failed, the message is dropped.");
+    }
+    else
+    {
+        const MODULE_API* api = NULL;
+        MODULE_HANDLE module = NULL;
+        TIMER_HANDLE previous = NULL;
+        lazy->last_receive_us = gateway_clock_now_us();
+        if (lazy->state == LAZY_MODULE_ACTIVE)
+        {
+            /*counted, so the idle check keeps the module until the call returns*/
+            lazy->calls++;
+            api = lazy->api;
+            module = lazy->module;
+        }
+        else if (lazy->state == LAZY_MODULE_FAILED)
+        {
+            /*Codes_SRS_GATEWAY_LAZY_17_013: [ If the module cannot be activated, the stand-in shall drop the queued messages and every message it receives afterwards. ]*/
+            lazy->pending_dropped++;
+        }
+        else
+        {
+            /*Codes_SRS_GATEWAY_LAZY_17_008: [ Otherwise Module_Receive of the stand-in shall queue a clone of the message, dropping it if the queue is full, and schedule the activation of the module on the timer service unless it is activating already. ]*/
+            MESSAGE_HANDLE clone = Message_Clone(messageHandle);
+            if (clone == NULL || MESSAGE_QUEUE_push(lazy->pending, clone) != 0)
+            {
+                if (clone != NULL)
+                {
+                    Message_Destroy(clone);
+                }
+                lazy->pending_dropped++;
+            }
+
+            if (lazy->state == LAZY_MODULE_INACTIVE)
+            {
+                previous = schedule_activation(lazy);
+            }
+        }
+        (void)Unlock(lazy->lock);
+
+        /*the timer of a previous activation fired already, it became inactive since*/
+        cancel_timer(lazy, previous);
+        if (module != NULL)
+        {
+            /*Codes_SRS_GATEWAY_LAZY_17_007: [ While the module is active, Module_Receive of the stand-in shall hand the message to it. ]*/
+            MODULE_RECEIVE(api)(module, messageHandle);
+            end_call(lazy);
+        }
+    }
+}
+
+static void LazyModule_Start(MODULE_HANDLE moduleHandle)
+{
+    LAZY_MODULE* lazy = (LAZY_MODULE*)moduleHandle;
+    if (lazy == NULL)
+    {
+        LogError("moduleHandle is NULL.");
+    }
+    else if (Lock(lazy->lock) != LOCK_OK)
+    {
+        LogError("Lock failed, the module is not started.");
+    }
+    else
+    {
+        const MODULE_API* api = NULL;
+        MODULE_HANDLE module = NULL;
+        /*Codes_SRS_GATEWAY_LAZY_17_016: [ Module_Start of the stand-in shall start the module if it is active, and otherwise have it started once it is activated. ]*/
+        lazy->started = true;
+        if (lazy->state == LAZY_MODULE_ACTIVE && !lazy->module_started)
+        {
+            lazy->module_started = true;
+            lazy->calls++;
+            api = lazy->api;
+            module = lazy->module;
+        }
+        (void)Unlock(lazy->lock);
+
+        if (module != NULL)
+        {
+            start_module(lazy, api, module);
+            end_call(lazy);
+        }
+    }
+}
+
+static const MODULE_API_1 LazyModule_API =
+{
+    { MODULE_API_VERSION_1 },
+
+    LazyModule_ParseConfigurationFromJson,
+    LazyModule_FreeConfiguration,
+    LazyModule_Create,
+    LazyModule_Destroy,
+    LazyModule_Receive,
+    LazyModule_Start
+};
+
+static MODULE_LIBRARY_HANDLE LazyModuleLoader_Load(const MODULE_LOADER* loader, const void* entrypoint)
+{
+    (void)loader;
+    /*Codes_SRS_GATEWAY_LAZY_17_003: [ The loader of the stand-in shall load nothing, its library handle keeping the entrypoint alive. ]*/
+    if (entrypoint != NULL)
+    {
+        INC_REF(LAZY_ENTRYPOINT, (LAZY_ENTRYPOINT*)entrypoint);
+    }
+    return (MODULE_LIBRARY_HANDLE)entrypoint;
+}
+
+static void LazyModuleLoader_Unload(const MODULE_LOADER* loader, MODULE_LIBRARY_HANDLE handle)
+{
+    (void)loader;
+    if (handle != NULL)
+    {
+        release_entrypoint((LAZY_ENTRYPOINT*)handle);
+    }
+}
+
+static const MODULE_API* LazyModuleLoader_GetApi(const MODULE_LOADER* loader, MODULE_LIBRARY_HANDLE handle)
+{
+    (void)loader;
+    (void)handle;
+    return (const MODULE_API*)&LazyModule_API;
+}
+
+static void* LazyModuleLoader_ParseEntrypointFromJson(const MODULE_LOADER* loader, const JSON_Value* json)
+{
+    (void)loader;
+    (void)json;
+    /*the loader is not registered, its entrypoints only come from GatewayLazyModule_Wrap*/
+    LogError("The lazy loader does not parse entrypoints.");
+    return NULL;
+}
+
+static void LazyModuleLoader_FreeEntrypoint(const MODULE_LOADER* loader, void* entrypoint)
+{
+    (void)loader;
+    if (entrypoint != NULL)
+    {
+        release_entrypoint((LAZY_ENTRYPOINT*)entrypoint);
+    }
+}
+
+static MODULE_LOADER_BASE_CONFIGURATION* LazyModuleLoader_ParseConfigurationFromJson(const MODULE_LOADER* loader, const JSON_Value* json)
+{
+    (void)loader;
+    (void)json;
+    return NULL;
+}
+
+static void LazyModuleLoader_FreeConfiguration(const MODULE_LOADER* loader, MODULE_LOADER_BASE_CONFIGURATION* configuration)
+{
+    (void)loader;
+    (void)configuration;
+}
+
+static void* LazyModuleLoader_BuildModuleConfiguration(const MODULE_LOADER* loader, const void* entrypoint, const void* module_configuration)
+{
+    LAZY_CONFIGURATION* result;
+    (void)loader;
+    if (entrypoint == NULL)
+    {
+        LogError("entrypoint is NULL.");
+        result = NULL;
+    }
+    else
+    {
+        result = (LAZY_CONFIGURATION*)malloc(sizeof(LAZY_CONFIGURATION));
+        if (result == NULL)
+        {
+            LogError("Failed to allocate the lazy module configuration.");
+        }
+        else
+        {
+            result->entrypoint = (LAZY_ENTRYPOINT*)entrypoint;
+            result->args = (const char*)module_configuration;
+        }
+    }
+    return result;
+}
+
+static void LazyModuleLoader_FreeModuleConfiguration(const MODULE_LOADER* loader, const void* module_configuration)
+{
+    (void)loader;
+    free((void*)module_configuration);
+}
+
+static MODULE_LOADER_API Lazy_Module_Loader_API =
+{
+    .Load = LazyModuleLoader_Load,
+    .Unload = LazyModuleLoader_Unload,
+    .GetApi = LazyModuleLoader_GetApi,
+
+    .ParseEntrypointFromJson = LazyModuleLoader_ParseEntrypointFromJson,
+    .FreeEntrypoint = LazyModuleLoader_FreeEntrypoint,
+
+    .ParseConfigurationFromJson = LazyModuleLoader_ParseConfigurationFromJson,
+    .FreeConfiguration = LazyModuleLoader_FreeConfiguration,
+
+    .BuildModuleConfiguration = LazyModuleLoader_BuildModuleConfiguration,
+    .FreeModuleConfiguration = LazyModuleLoader_FreeModuleConfiguration
+};
+
+static const MODULE_LOADER Lazy_Module_Loader =
+{
+    UNKNOWN,
+    LAZY_LOADER_NAME,
+    NULL,
+    &Lazy_Module_Loader_API,
+    /*Module_Create of the stand-in neither loads nor creates anything*/
+    true
+};
+
+int GatewayLazyModule_Wrap(GATEWAY_MODULE_LOADER_INFO* loader_info, const GATEWAY_LAZY_ACTIVATION* activation)
+{
+    int result;
+    /*Codes_SRS_GATEWAY_LAZY_17_001: [ If loader_info, its loader or its entrypoint, or activation is NULL, or activation asks for no queue, GatewayLazyModule_Wrap shall fail and return a non-zero value. ]*/
+    if (loader_info == NULL || loader_info->loader == NULL || loader_info->entrypoint == NULL ||
+        activation == NULL || activation->max_queued_messages == 0)
+    {
+        LogError("invalid arguments loader_info = %p, activation = %p.", loader_info, activation);
+        result = __LINE__;
+    }
+    else
+    {
+        LAZY_ENTRYPOINT* entrypoint = REFCOUNT_TYPE_CREATE(LAZY_ENTRYPOINT);
+        if (entrypoint == NULL)
+        {
+            /*Codes_SRS_GATEWAY_LAZY_17_001: [ If loader_info, its loader or its entrypoint, or activation is NULL, or activation asks for no queue, GatewayLazyModule_Wrap shall fail and return a non-zero value. ]*/
+            LogError("Failed to allocate the lazy entrypoint.");
+            result = __LINE__;
+        }
+        else
+        {
+            /*Codes_SRS_GATEWAY_LAZY_17_002: [ GatewayLazyModule_Wrap shall replace the loader and entrypoint of loader_info by the ones of a stand-in that keeps them and activation, and return 0. ]*/
+            entrypoint->loader = loader_info->loader;
+            entrypoint->entrypoint = loader_info->entrypoint;
+            entrypoint->activation = *activation;
+            loader_info->loader = &Lazy_Module_Loader;
+            loader_info->entrypoint = entrypoint;
+            result = 0;
+        }
+    }
+    return result;
+}
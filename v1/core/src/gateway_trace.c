@@ -0,0 +1,217 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include "azure_c_shared_utility/gballoc.h"
+
+#include "gateway_trace.h"
+#include "azure_c_shared_utility/xlogging.h"
+
+#ifdef GATEWAY_TRACE_ENABLED
+
+#include "internal/gateway_atomic.h"
+#include "internal/gateway_clock.h"
+
+#ifdef _MSC_VER
+#define GATEWAY_TRACE_THREAD_LOCAL __declspec(thread)
+#else
+#define GATEWAY_TRACE_THREAD_LOCAL __thread
+#endif
+
+/*events kept per thread; 32 bytes each, so a ring buffer takes 256KB by default*/
+#ifndef GATEWAY_TRACE_BUFFER_EVENTS
+#define GATEWAY_TRACE_BUFFER_EVENTS 8192
+#endif
+
+typedef struct GATEWAY_TRACE_EVENT_TAG
+{
+    const char* name;
+    uint64_t ts_us;
+    uint64_t value;
+    /*the thread is kept per event because a released ring buffer is reused by another thread*/
+    uint32_t thread_id;
+    char phase;
+} GATEWAY_TRACE_EVENT;
+
+typedef struct GATEWAY_TRACE_BUFFER_TAG
+{
+    struct GATEWAY_TRACE_BUFFER_TAG* next;
+    /*1 while a thread records into the buffer, 0 once it was released*/
+    volatile size_t owned;
+    /*number of events ever written; the ring holds the last GATEWAY_TRACE_BUFFER_EVENTS of them*/
+    volatile size_t written;
+    uint32_t thread_id;
+    GATEWAY_TRACE_EVENT events[GATEWAY_TRACE_BUFFER_EVENTS];
+} GATEWAY_TRACE_BUFFER;
+
+/*buffers are only ever pushed to the front of this list and live until the process exits*/
+static GATEWAY_TRACE_BUFFER* volatile trace_buffers = NULL;
+static volatile size_t trace_thread_ids = 0;
+static GATEWAY_TRACE_THREAD_LOCAL GATEWAY_TRACE_BUFFER* current_buffer = NULL;
+
+static GATEWAY_TRACE_BUFFER* claim_buffer(void)
+{
+    GATEWAY_TRACE_BUFFER* result = (GATEWAY_TRACE_BUFFER*)GATEWAY_ATOMIC_LOAD_POINTER(&trace_buffers);
+    while (result != NULL && GATEWAY_ATOMIC_CAS_SIZE(&result->owned, 0, 1) != 0)
+    {
+        result = result->next;
+    }
+    if (result == NULL)
+    {
+        result = (GATEWAY_TRACE_BUFFER*)malloc(sizeof(GATEWAY_TRACE_BUFFER));
+        if (result == NULL)
+        {
+            LogError("unable to allocate a trace buffer");
+        }
+        else
+        {
+            GATEWAY_TRACE_BUFFER* head;
+            result->owned = 1;
+            result->written = 0;
+            do
+            {
+                head = (GATEWAY_TRACE_BUFFER*)GATEWAY_ATOMIC_LOAD_POINTER(&trace_buffers);
+                result->next = head;
+            } while (GATEWAY_ATOMIC_CAS_POINTER(&trace_buffers, head, result) != head);
+        }
+    }
+    if (result != NULL)
+    {
+        result->thread_id = (uint32_t)GATEWAY_ATOMIC_ADD_SIZE(&trace_thread_ids, 1) + 1;
+    }
+    return result;
+}
+
+void GatewayTrace_Record(const char* name, char phase, uint64_t value)
+{
+    GATEWAY_TRACE_BUFFER* buffer = current_buffer;
+    if (buffer == NULL)
+    {
+        /*Codes_SRS_GATEWAY_TRACE_17_001: [ The first time a thread records an event, GatewayTrace_Record shall give it a ring buffer released by another thread or allocate a new one. ]*/
+        buffer = claim_buffer();
+        current_buffer = buffer;
+    }
+    /*Codes_SRS_GATEWAY_TRACE_17_002: [ If no ring buffer can be allocated, GatewayTrace_Record shall drop the event. ]*/
+    if (buffer != NULL)
+    {
+        /*Codes_SRS_GATEWAY_TRACE_17_003: [ GatewayTrace_Record shall write name, phase, value, the calling thread and the current time in microseconds over the oldest event of the ring buffer of the calling thread. ]*/
+        size_t written = buffer->written;
+        GATEWAY_TRACE_EVENT* event = &buffer->events[written % GATEWAY_TRACE_BUFFER_EVENTS];
+        event->name = name;
+        event->ts_us = gateway_clock_now_us();
+        event->value = value;
+        event->thread_id = buffer->thread_id;
+        event->phase = phase;
+        /*publishing the count after the event keeps GatewayTrace_Dump from reading an event that is half written*/
+        GATEWAY_ATOMIC_STORE_SIZE(&buffer->written, written + 1);
+    }
+}
+
+void GatewayTrace_ReleaseThread(void)
+{
+    GATEWAY_TRACE_BUFFER* buffer = current_buffer;
+    /*Codes_SRS_GATEWAY_TRACE_17_004: [ GatewayTrace_ReleaseThread shall hand the ring buffer of the calling thread, if any, to the next thread that starts recording. ]*/
+    if (buffer != NULL)
+    {
+        current_buffer = NULL;
+        GATEWAY_ATOMIC_STORE_SIZE(&buffer->owned, 0);
+    }
+}
+
+static void write_event(FILE* file, const GATEWAY_TRACE_EVENT* event, int first)
+{
+    (void)fprintf(file, "%s\n{\"name\":\"%s\",\"cat\":\"gateway\",\"ph\":\"%c\",\"ts\":%" PRIu64 ",\"pid\":1,\"tid\":%" PRIu32,
+        first ? "" : ",", event->name, event->phase, event->ts_us, event->thread_id);
+    switch (event->phase)
+    {
+    case 's':
+        (void)fprintf(file, ",\"id\":\"0x%" PRIx64 "\"}", event->value);
+        break;
+    case 'f':
+        /*bind the end of a flow to the slice it is recorded in*/
+        (void)fprintf(file, ",\"id\":\"0x%" PRIx64 "\",\"bp\":\"e\"}", event->value);
+        break;
+    case 'i':
+        (void)fprintf(file, ",\"s\":\"t\",\"args\":{\"value\":%" PRIu64 "}}", event->value);
+        break;
+    case 'B':
+        (void)fprintf(file, ",\"args\":{\"value\":%" PRIu64 "}}", event->value);
+        break;
+    default:
+        (void)fprintf(file, "}");
+        break;
+    }
+}
+
+int GatewayTrace_Dump(const char* file_path)
+{
+    int result;
+    if (file_path == NULL)
+    {
+        /*Codes_SRS_GATEWAY_TRACE_17_005: [ If file_path is NULL, GatewayTrace_Dump shall fail and return a non-zero value. ]*/
+        LogError("file_path is NULL");
+        result = __LINE__;
+    }
+    else
+    {
+        FILE* file = fopen(file_path, "w");
+        if (file == NULL)
+        {
+            /*Codes_SRS_GATEWAY_TRACE_17_006: [ If the file cannot be opened for writing, GatewayTrace_Dump shall fail and return a non-zero value. ]*/
+            LogError("unable to open trace file %s", file_path);
+            result = __LINE__;
+        }
+        else
+        {
+            int first = 1;
+            GATEWAY_TRACE_BUFFER* buffer = (GATEWAY_TRACE_BUFFER*)GATEWAY_ATOMIC_LOAD_POINTER(&trace_buffers);
+            /*Codes_SRS_GATEWAY_TRACE_17_007: [ GatewayTrace_Dump shall write a Chrome trace event JSON object whose traceEvents array holds the events kept in every ring buffer, oldest first. ]*/
+            (void)fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+            while (buffer != NULL)
+            {
+                size_t written = GATEWAY_ATOMIC_LOAD_SIZE(&buffer->written);
+                size_t index = written > GATEWAY_TRACE_BUFFER_EVENTS ? written - GATEWAY_TRACE_BUFFER_EVENTS : 0;
+                for (; index < written; index++)
+                {
+                    write_event(file, &buffer->events[index % GATEWAY_TRACE_BUFFER_EVENTS], first);
+                    first = 0;
+                }
+                buffer = buffer->next;
+            }
+            (void)fprintf(file, "\n]}\n");
+
+            /*Codes_SRS_GATEWAY_TRACE_17_008: [ If writing the file fails, GatewayTrace_Dump shall fail and return a non-zero value. ]*/
+            if (ferror(file) != 0)
+            {
+                LogError("unable to write trace file %s", file_path);
+                (void)fclose(file);
+                result = __LINE__;
+            }
+            else if (fclose(file) != 0)
+            {
+                LogError("unable to close trace file %s", file_path);
+                result = __LINE__;
+            }
+            else
+            {
+                /*Codes_SRS_GATEWAY_TRACE_17_009: [ GatewayTrace_Dump shall return 0 upon success. ]*/
+                result = 0;
+            }
+        }
+    }
+    return result;
+}
+
+#else
+
+int GatewayTrace_Dump(const char* file_path)
+{
+    /*Codes_SRS_GATEWAY_TRACE_17_010: [ If the gateway was built without GATEWAY_TRACE_ENABLED, GatewayTrace_Dump shall fail and return a non-zero value. ]*/
+    LogError("the gateway was built without tracing, unable to dump a trace to %s", file_path == NULL ? "(null)" : file_path);
+    return __LINE__;
+}
+
+#endif
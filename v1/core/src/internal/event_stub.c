@@ -17,6 +17,12 @@ struct EVENTSYSTEM_DATA {
 
 
 
+EVENTSYSTEM_HANDLE EventSystem_InitWithDispatcher(EVENTSYSTEM_DISPATCHER dispatcher)
+{
+    (void)dispatcher;
+    return EventSystem_Init();
+}
+
 EVENTSYSTEM_HANDLE EventSystem_Init(void)
 {
     /* Codes_SRS_EVENTSYSTEM_26_001: [ This function shall create EVENTSYSTEM_HANDLE representing the created event system. ] */
@@ -3,6 +3,7 @@
 
 #include <stdlib.h>
 #include <stddef.h>
+#include <string.h>
 #include "azure_c_shared_utility/vector.h"
 #include "azure_c_shared_utility/gballoc.h"
 #include "azure_c_shared_utility/xlogging.h"
@@ -13,6 +14,7 @@
 
 #include "gateway.h"
 #include "experimental/event_system.h"
+#include "gateway_atomic.h"
 
 #include <assert.h>
 #include <stdlib.h>
@@ -20,9 +22,10 @@
 struct EVENTSYSTEM_DATA {
     VECTOR_HANDLE event_callbacks[GATEWAY_EVENTS_COUNT];
     /* Should some callback or thread creation fail all next event reports will be no-op */
-    int is_errored;
+    volatile size_t is_errored;
     /* @brief Decides whether the thread should have delayed shutdown or not */
     int delay_when_queue_empty;
+    EVENTSYSTEM_DISPATCHER dispatcher;
 
     THREAD_HANDLE callback_thread;
     // The last thread that quit already and needs cleaning up of the handle
@@ -31,6 +34,12 @@ struct EVENTSYSTEM_DATA {
     LOCK_HANDLE thread_queue_lock;
     COND_HANDLE thread_queue_condition;
     SINGLYLINKEDLIST_HANDLE thread_queue;
+    /* Persistent dispatcher only: rows pushed without locking, newest first */
+    struct THREAD_QUEUE_ROW_TAG* volatile pending_rows;
+    /* Persistent dispatcher only: set while the thread sleeps, so reporters know to post the condition */
+    volatile size_t dispatcher_waiting;
+    /* Persistent dispatcher only: set by the one reporter that starts the thread */
+    volatile size_t dispatcher_started;
 };
 
 typedef struct CALLBACK_CLOSURE_TAG {
@@ -43,6 +52,7 @@ typedef struct THREAD_QUEUE_ROW_TAG {
     GATEWAY_EVENT event_type;
     VECTOR_HANDLE callbacks;
     GATEWAY_EVENT_CTX context;
+    struct THREAD_QUEUE_ROW_TAG* next;
 } THREAD_QUEUE_ROW;
 
 /** @brief How long should the thread stay alive before shutting down when the processing queue is empty */
@@ -54,12 +64,54 @@ static int add_to_thread_queue(EVENTSYSTEM_HANDLE event_system, THREAD_QUEUE_ROW
 static THREAD_QUEUE_ROW* get_from_thread_queue(EVENTSYSTEM_HANDLE event_system, int timeout_ms);
 static void destroy_thread_row(THREAD_QUEUE_ROW* row);
 static int callback_thread_main_func(void* event_system_param);
+static int persistent_thread_main_func(void* event_system_param);
+static void push_pending_row(EVENTSYSTEM_HANDLE event_system, THREAD_QUEUE_ROW* row);
+static THREAD_QUEUE_ROW* take_pending_rows(EVENTSYSTEM_HANDLE event_system);
+static void call_row_callbacks(THREAD_QUEUE_ROW* row);
 static GATEWAY_EVENT_CTX handle_module_list_update(EVENTSYSTEM_HANDLE event_system, GATEWAY_HANDLE gateway, VECTOR_HANDLE callbacks);
 
 /** @brief This function assumes that the context is a #VECTOR_HANDLE and destroys it */
 static void callback_destroy_modulelist(GATEWAY_HANDLE gateway, GATEWAY_EVENT event_type, GATEWAY_EVENT_CTX context, void* user_param);
 
+static GATEWAY_EVENT_CTX handle_metrics_snapshot(EVENTSYSTEM_HANDLE event_system, GATEWAY_HANDLE gateway, VECTOR_HANDLE callbacks);
+
+/** @brief This function assumes that the context is a #VECTOR_HANDLE of #GATEWAY_MODULE_METRICS and destroys it */
+static void callback_destroy_metrics_snapshot(GATEWAY_HANDLE gateway, GATEWAY_EVENT event_type, GATEWAY_EVENT_CTX context, void* user_param);
+
+static GATEWAY_EVENT_CTX handle_module_stuck(EVENTSYSTEM_HANDLE event_system, GATEWAY_HANDLE gateway, VECTOR_HANDLE callbacks);
+
+/** @brief This function assumes that the context is a #VECTOR_HANDLE of #GATEWAY_STUCK_MODULE and destroys it */
+static void callback_destroy_stuck_modules(GATEWAY_HANDLE gateway, GATEWAY_EVENT event_type, GATEWAY_EVENT_CTX context, void* user_param);
+
+static GATEWAY_EVENT_CTX handle_module_over_budget(EVENTSYSTEM_HANDLE event_system, GATEWAY_HANDLE gateway, VECTOR_HANDLE callbacks);
+
+/** @brief This function assumes that the context is a #VECTOR_HANDLE of #GATEWAY_MODULE_MEMORY and destroys it */
+static void callback_destroy_modules_over_budget(GATEWAY_HANDLE gateway, GATEWAY_EVENT event_type, GATEWAY_EVENT_CTX context, void* user_param);
+
+static GATEWAY_EVENT_CTX handle_load_shedding_changed(EVENTSYSTEM_HANDLE event_system, GATEWAY_HANDLE gateway, VECTOR_HANDLE callbacks);
+
+/** @brief This function assumes that the context is a #GATEWAY_LOAD_SHEDDING_STATE and destroys it */
+static void callback_destroy_load_shedding_state(GATEWAY_HANDLE gateway, GATEWAY_EVENT event_type, GATEWAY_EVENT_CTX context, void* user_param);
+
+static GATEWAY_EVENT_CTX handle_startup_reported(EVENTSYSTEM_HANDLE event_system, GATEWAY_HANDLE gateway, VECTOR_HANDLE callbacks);
+
+/** @brief This function assumes that the context is a startup report string and destroys it */
+static void callback_destroy_startup_report(GATEWAY_HANDLE gateway, GATEWAY_EVENT event_type, GATEWAY_EVENT_CTX context, void* user_param);
+
+static void report_event(EVENTSYSTEM_HANDLE event_system, GATEWAY_HANDLE gw, GATEWAY_EVENT event_type, const void* subject);
+static GATEWAY_EVENT_CTX handle_module_change(EVENTSYSTEM_HANDLE event_system, const char* module_name, VECTOR_HANDLE callbacks);
+static GATEWAY_EVENT_CTX handle_link_change(EVENTSYSTEM_HANDLE event_system, const GATEWAY_LINK_ENTRY* link, VECTOR_HANDLE callbacks);
+
+/** @brief This function assumes that the context is a single allocation, the copy of a module name or link, and frees it */
+static void callback_free_change(GATEWAY_HANDLE gateway, GATEWAY_EVENT event_type, GATEWAY_EVENT_CTX context, void* user_param);
+
 EVENTSYSTEM_HANDLE EventSystem_Init(void)
+{
+    /* Codes_SRS_EVENTSYSTEM_26_017: [ This function shall create an event system with the `EVENTSYSTEM_DISPATCHER_ON_DEMAND` dispatcher. ] */
+    return EventSystem_InitWithDispatcher(EVENTSYSTEM_DISPATCHER_ON_DEMAND);
+}
+
+EVENTSYSTEM_HANDLE EventSystem_InitWithDispatcher(EVENTSYSTEM_DISPATCHER dispatcher)
 {
     /* Codes_SRS_EVENTSYSTEM_26_001: [ This function shall create EVENTSYSTEM_HANDLE representing the created event system. ] */
     EVENTSYSTEM_HANDLE result = (EVENTSYSTEM_HANDLE)malloc(sizeof(struct EVENTSYSTEM_DATA));
@@ -106,6 +158,8 @@ EVENTSYSTEM_HANDLE EventSystem_Init(void)
             if (result != NULL)
             {
                 result->delay_when_queue_empty = 1;
+                /* Codes_SRS_EVENTSYSTEM_26_018: [ This function shall deliver events with the given dispatcher. ] */
+                result->dispatcher = dispatcher;
 
                 result->thread_queue = singlylinkedlist_create();
                 /* Codes_SRS_EVENTSYSTEM_26_002: [ This function shall return NULL upon any internal error during event system creation. ] */
@@ -146,66 +200,35 @@ void EventSystem_AddEventCallback(EVENTSYSTEM_HANDLE event_system, GATEWAY_EVENT
 
 void EventSystem_ReportEvent(EVENTSYSTEM_HANDLE event_system, GATEWAY_HANDLE gw, GATEWAY_EVENT event_type)
 {
-    /* Codes_SRS_EVENTSYSTEM_26_014: [ This function shall do nothing when `event_system` parameter is NULL. ] */
-    if (event_system == NULL)
+    report_event(event_system, gw, event_type, NULL);
+}
+
+void EventSystem_ReportModuleEvent(EVENTSYSTEM_HANDLE event_system, GATEWAY_HANDLE gw, GATEWAY_EVENT event_type, const char* module_name)
+{
+    /* Codes_SRS_EVENTSYSTEM_17_001: [ This function shall log a failure and do nothing else when `event_type` is neither `GATEWAY_MODULE_ADDED` nor `GATEWAY_MODULE_REMOVED` or `module_name` is NULL. ] */
+    if ((event_type != GATEWAY_MODULE_ADDED && event_type != GATEWAY_MODULE_REMOVED) || module_name == NULL)
     {
-        LogError("null gateway handle or gateway event handle when reporting event");
+        LogError("invalid module event %d or NULL module name when reporting a module event", (int)event_type);
     }
-    /* Codes_SRS_EVENTSYSTEM_26_013: [ Should the worker thread ever fail to be created or any internall callbacks fail, failure will be logged and no further callbacks will be called during gateway's lifecycle. ] */
-    else if (!event_system->is_errored)
+    else
     {
-        /* Lock-avoiding mechanism, we get a probably-past state with previous if, then check synchronized state to be sure */
-        int real_is_errored = 0;
-        Lock(event_system->internal_change_lock);
-        real_is_errored = event_system->is_errored;
-        Unlock(event_system->internal_change_lock);
-        
-        if (!real_is_errored)
-        {
-            /* We need to copy the callback queue because the callback might register another function */
-            /* Codes_SRS_EVENTSYSTEM_26_007: [ This function shan't call any callbacks registered for any other GATEWAY_EVENT other than the one given as parameter. ] */
-            VECTOR_HANDLE callbacks = event_system->event_callbacks[event_type];
-            size_t vector_size = VECTOR_size(callbacks);
-
-            if (vector_size > 0)
-            {
-                VECTOR_HANDLE call_queue = VECTOR_create(sizeof(CALLBACK_CLOSURE));
-                if (call_queue == NULL)
-                {
-                    /*Codes_SRS_EVENTSYSTEM_26_013: [ Should the worker thread ever fail to be created or any internall callbacks fail, failure will be logged and no further callbacks will be called during gateway's lifecycle. ] */
-                    LogError("Failed to create call queue during event report");
-                    event_system->is_errored = 1;
-                }
-                else
-                {
-                    if (VECTOR_push_back(call_queue, VECTOR_front(callbacks), vector_size) != 0)
-                    {
-                        /*Codes_SRS_EVENTSYSTEM_26_013: [ Should the worker thread ever fail to be created or any internall callbacks fail, failure will be logged and no further callbacks will be called during gateway's lifecycle. ] */
-                        LogError("Failed to copy callback queue during event report");
-                        event_system->is_errored = 1;
-                        VECTOR_destroy(call_queue);
-                    }
-                    else
-                    {
-                        GATEWAY_EVENT_CTX context = NULL;
-                        /* handlers might change event_system->is_errored */
-                        switch (event_type)
-                        {
-                        case GATEWAY_MODULE_LIST_CHANGED:
-                            context = handle_module_list_update(event_system, gw, call_queue);
-                            break;
-                        default:
-                            break;
-                        }
+        /* Codes_SRS_EVENTSYSTEM_17_002: [ This function shall report `event_type` the way `EventSystem_ReportEvent` does. ] */
+        report_event(event_system, gw, event_type, module_name);
+    }
+}
 
-                        if (event_system->is_errored)
-                            VECTOR_destroy(call_queue);
-                        else
-                            callbacks_call(event_system, gw, event_type, call_queue, context);
-                    }
-                }
-            }
-        }
+void EventSystem_ReportLinkEvent(EVENTSYSTEM_HANDLE event_system, GATEWAY_HANDLE gw, GATEWAY_EVENT event_type, const GATEWAY_LINK_ENTRY* link)
+{
+    /* Codes_SRS_EVENTSYSTEM_17_003: [ This function shall log a failure and do nothing else when `event_type` is neither `GATEWAY_LINK_ADDED` nor `GATEWAY_LINK_REMOVED`, or `link` or one of its module names is NULL. ] */
+    if ((event_type != GATEWAY_LINK_ADDED && event_type != GATEWAY_LINK_REMOVED) ||
+        link == NULL || link->module_source == NULL || link->module_sink == NULL)
+    {
+        LogError("invalid link event %d or NULL link when reporting a link event", (int)event_type);
+    }
+    else
+    {
+        /* Codes_SRS_EVENTSYSTEM_17_004: [ This function shall report `event_type` the way `EventSystem_ReportEvent` does. ] */
+        report_event(event_system, gw, event_type, link);
     }
 }
 
@@ -269,12 +292,116 @@ static void destroy_event_system(EVENTSYSTEM_HANDLE handle)
         }
         singlylinkedlist_destroy(handle->thread_queue);
 
+        THREAD_QUEUE_ROW* pending = take_pending_rows(handle);
+        while (pending != NULL)
+        {
+            THREAD_QUEUE_ROW* next = pending->next;
+            destroy_thread_row(pending);
+            pending = next;
+        }
+
         for (int i = 0; i < GATEWAY_EVENTS_COUNT; i++)
             VECTOR_destroy(handle->event_callbacks[i]);
         free(handle);
     }
 }
 
+static void report_event(EVENTSYSTEM_HANDLE event_system, GATEWAY_HANDLE gw, GATEWAY_EVENT event_type, const void* subject)
+{
+    /* Codes_SRS_EVENTSYSTEM_26_014: [ This function shall do nothing when `event_system` parameter is NULL. ] */
+    if (event_system == NULL)
+    {
+        LogError("null gateway handle or gateway event handle when reporting event");
+    }
+    /* Codes_SRS_EVENTSYSTEM_26_013: [ Should the worker thread ever fail to be created or any internall callbacks fail, failure will be logged and no further callbacks will be called during gateway's lifecycle. ] */
+    else if (!event_system->is_errored)
+    {
+        int real_is_errored = 0;
+        if (event_system->dispatcher == EVENTSYSTEM_DISPATCHER_PERSISTENT)
+        {
+            /* Codes_SRS_EVENTSYSTEM_26_020: [ The `EVENTSYSTEM_DISPATCHER_PERSISTENT` dispatcher shall queue events without taking a lock. ] */
+            real_is_errored = (GATEWAY_ATOMIC_LOAD_SIZE(&event_system->is_errored) != 0);
+        }
+        else
+        {
+            /* Lock-avoiding mechanism, we get a probably-past state with previous if, then check synchronized state to be sure */
+            Lock(event_system->internal_change_lock);
+            real_is_errored = (event_system->is_errored != 0);
+            Unlock(event_system->internal_change_lock);
+        }
+
+        if (!real_is_errored)
+        {
+            /* We need to copy the callback queue because the callback might register another function */
+            /* Codes_SRS_EVENTSYSTEM_26_007: [ This function shan't call any callbacks registered for any other GATEWAY_EVENT other than the one given as parameter. ] */
+            VECTOR_HANDLE callbacks = event_system->event_callbacks[event_type];
+            size_t vector_size = VECTOR_size(callbacks);
+
+            if (vector_size > 0)
+            {
+                VECTOR_HANDLE call_queue = VECTOR_create(sizeof(CALLBACK_CLOSURE));
+                if (call_queue == NULL)
+                {
+                    /*Codes_SRS_EVENTSYSTEM_26_013: [ Should the worker thread ever fail to be created or any internall callbacks fail, failure will be logged and no further callbacks will be called during gateway's lifecycle. ] */
+                    LogError("Failed to create call queue during event report");
+                    event_system->is_errored = 1;
+                }
+                else
+                {
+                    if (VECTOR_push_back(call_queue, VECTOR_front(callbacks), vector_size) != 0)
+                    {
+                        /*Codes_SRS_EVENTSYSTEM_26_013: [ Should the worker thread ever fail to be created or any internall callbacks fail, failure will be logged and no further callbacks will be called during gateway's lifecycle. ] */
+                        LogError("Failed to copy callback queue during event report");
+                        event_system->is_errored = 1;
+                        VECTOR_destroy(call_queue);
+                    }
+                    else
+                    {
+                        GATEWAY_EVENT_CTX context = NULL;
+                        /* handlers might change event_system->is_errored */
+                        switch (event_type)
+                        {
+                        case GATEWAY_MODULE_LIST_CHANGED:
+                            context = handle_module_list_update(event_system, gw, call_queue);
+                            break;
+                        case GATEWAY_METRICS_SNAPSHOT:
+                            context = handle_metrics_snapshot(event_system, gw, call_queue);
+                            break;
+                        case GATEWAY_MODULE_STUCK:
+                            context = handle_module_stuck(event_system, gw, call_queue);
+                            break;
+                        case GATEWAY_MODULE_OVER_BUDGET:
+                            context = handle_module_over_budget(event_system, gw, call_queue);
+                            break;
+                        case GATEWAY_LOAD_SHEDDING_CHANGED:
+                            context = handle_load_shedding_changed(event_system, gw, call_queue);
+                            break;
+                        case GATEWAY_STARTUP_REPORTED:
+                            context = handle_startup_reported(event_system, gw, call_queue);
+                            break;
+                        case GATEWAY_MODULE_ADDED:
+                        case GATEWAY_MODULE_REMOVED:
+                            context = handle_module_change(event_system, (const char*)subject, call_queue);
+                            break;
+                        case GATEWAY_LINK_ADDED:
+                        case GATEWAY_LINK_REMOVED:
+                            context = handle_link_change(event_system, (const GATEWAY_LINK_ENTRY*)subject, call_queue);
+                            break;
+                        default:
+                            break;
+                        }
+
+                        if (event_system->is_errored)
+                            VECTOR_destroy(call_queue);
+                        else
+                            callbacks_call(event_system, gw, event_type, call_queue, context);
+                    }
+                }
+            }
+        }
+    }
+}
+
 static void callbacks_call(EVENTSYSTEM_HANDLE event_system, GATEWAY_HANDLE gw, GATEWAY_EVENT event_type, VECTOR_HANDLE callbacks, GATEWAY_EVENT_CTX context)
 {
     THREAD_QUEUE_ROW* row = (THREAD_QUEUE_ROW*)malloc(sizeof(THREAD_QUEUE_ROW));
@@ -289,40 +416,75 @@ static void callbacks_call(EVENTSYSTEM_HANDLE event_system, GATEWAY_HANDLE gw, G
         row->event_type = event_type;
         row->callbacks = callbacks;
         row->context = context;
+        row->next = NULL;
+    }
+
+    if (event_system->dispatcher == EVENTSYSTEM_DISPATCHER_PERSISTENT)
+    {
+        /* Codes_SRS_EVENTSYSTEM_26_013: [ Should the worker thread ever fail to be created or any internall callbacks fail, failure will be logged and no further callbacks will be called during gateway's lifecycle. ] */
+        if (row == NULL)
+        {
+            GATEWAY_ATOMIC_STORE_SIZE(&event_system->is_errored, 1);
+        }
+        else
+        {
+            push_pending_row(event_system, row);
+
+            /* Codes_SRS_EVENTSYSTEM_26_033: [ The `EVENTSYSTEM_DISPATCHER_PERSISTENT` dispatcher shall take the internal lock only once, when the first event starts its thread. ] */
+            /* the lock publishes the thread handle to EventSystem_Destroy */
+            if (GATEWAY_ATOMIC_CAS_SIZE(&event_system->dispatcher_started, 0, 1) == 0)
+            {
+                Lock(event_system->internal_change_lock);
+                /* Codes_SRS_EVENTSYSTEM_26_008: [ This function shall call all registered callbacks on a seperate thread. ] */
+                /* Codes_SRS_EVENTSYSTEM_26_019: [ The `EVENTSYSTEM_DISPATCHER_PERSISTENT` dispatcher shall create its thread once and keep it until the event system is destroyed. ] */
+                if (ThreadAPI_Create(&event_system->callback_thread, persistent_thread_main_func, (void*)event_system) != THREADAPI_OK)
+                {
+                    /* Codes_SRS_EVENTSYSTEM_26_013: [ Should the worker thread ever fail to be created or any internall callbacks fail, failure will be logged and no further callbacks will be called during gateway's lifecycle. ] */
+                    /* Stuff on the queue will be deleted when destroying EventSystem */
+                    LogError("failed to create the event dispatcher thread");
+                    event_system->callback_thread = NULL;
+                    GATEWAY_ATOMIC_STORE_SIZE(&event_system->is_errored, 1);
+                }
+                Unlock(event_system->internal_change_lock);
+            }
+        }
+    }
+    else
+    {
         /* Failed to add to queue, we have allocated row which won't be freed during EventSystem destroy */
-        if (add_to_thread_queue(event_system, row))
+        if (row != NULL && add_to_thread_queue(event_system, row))
         {
             destroy_thread_row(row);
             row = NULL;
         }
-    }
 
-    Lock(event_system->internal_change_lock);
+        Lock(event_system->internal_change_lock);
 
-    // There's a thread to cleanup that was destroyed but has a floating handle
-    if (event_system->destroyed_thread != NULL)
-    {
-        int res;
-        ThreadAPI_Join(event_system->destroyed_thread, &res);
-        event_system->destroyed_thread = NULL;
-    }
+        // There's a thread to cleanup that was destroyed but has a floating handle
+        if (event_system->destroyed_thread != NULL)
+        {
+            int res;
+            ThreadAPI_Join(event_system->destroyed_thread, &res);
+            event_system->destroyed_thread = NULL;
+        }
 
-    /* Codes_SRS_EVENTSYSTEM_26_013: [ Should the worker thread ever fail to be created or any internall callbacks fail, failure will be logged and no further callbacks will be called during gateway's lifecycle. ] */
-    if (row == NULL)
-    {
-        event_system->is_errored = 1;
-    }
-    else if (event_system->callback_thread == NULL)
-    {
-        /* Codes_SRS_EVENTSYSTEM_26_008: [ This function shall call all registered callbacks on a seperate thread. ] */
-        THREADAPI_RESULT result = ThreadAPI_Create(&event_system->callback_thread, callback_thread_main_func, (void*)event_system);
         /* Codes_SRS_EVENTSYSTEM_26_013: [ Should the worker thread ever fail to be created or any internall callbacks fail, failure will be logged and no further callbacks will be called during gateway's lifecycle. ] */
-        /* Stuff on the queue will be deleted when destroying EventSystem */
-        if (result != THREADAPI_OK)
+        if (row == NULL)
+        {
             event_system->is_errored = 1;
-    }
+        }
+        else if (event_system->callback_thread == NULL)
+        {
+            /* Codes_SRS_EVENTSYSTEM_26_008: [ This function shall call all registered callbacks on a seperate thread. ] */
+            THREADAPI_RESULT result = ThreadAPI_Create(&event_system->callback_thread, callback_thread_main_func, (void*)event_system);
+            /* Codes_SRS_EVENTSYSTEM_26_013: [ Should the worker thread ever fail to be created or any internall callbacks fail, failure will be logged and no further callbacks will be called during gateway's lifecycle. ] */
+            /* Stuff on the queue will be deleted when destroying EventSystem */
+            if (result != THREADAPI_OK)
+                event_system->is_errored = 1;
+        }
 
-    Unlock(event_system->internal_change_lock);
+        Unlock(event_system->internal_change_lock);
+    }
 }
 
 static int add_to_thread_queue(EVENTSYSTEM_HANDLE event_system, THREAD_QUEUE_ROW* row)
@@ -375,15 +537,7 @@ static int callback_thread_main_func(void* event_system_param)
     THREAD_QUEUE_ROW* row;
     while ((row = get_from_thread_queue(event_system, THREAD_EMPTY_QUEUE_TIMEOUT_MS)) != NULL)
     {
-        size_t vector_size = VECTOR_size(row->callbacks);
-        /* Codes_SRS_EVENTSYSTEM_26_006: [ This function shall call all registered callbacks for the given GATEWAY_EVENT. ] */
-        /* Codes_SRS_EVENTSYSTEM_26_009: [ This function shall call all registered callbacks in First - In - First - Out order in terms registration. ] */
-        for (size_t i = 0; i < vector_size; i++)
-        {
-            CALLBACK_CLOSURE *closure = (CALLBACK_CLOSURE*)VECTOR_element(row->callbacks, i);
-            /* Codes_SRS_EVENTSYSTEM_26_010: [ The given `GATEWAY_CALLBACK` function shall be called with proper `GATEWAY_HANDLE`, `GATEWAY_EVENT` and provided user parameter as function parameters coresponding to the gateway and the event that occured. ] */
-            closure->call(row->gateway, row->event_type, row->context, closure->user_param);
-        }
+        call_row_callbacks(row);
         destroy_thread_row(row);
     }
 
@@ -397,6 +551,129 @@ static int callback_thread_main_func(void* event_system_param)
     return THREADAPI_OK;
 }
 
+static void call_row_callbacks(THREAD_QUEUE_ROW* row)
+{
+    size_t vector_size = VECTOR_size(row->callbacks);
+    /* Codes_SRS_EVENTSYSTEM_26_006: [ This function shall call all registered callbacks for the given GATEWAY_EVENT. ] */
+    /* Codes_SRS_EVENTSYSTEM_26_009: [ This function shall call all registered callbacks in First - In - First - Out order in terms registration. ] */
+    for (size_t i = 0; i < vector_size; i++)
+    {
+        CALLBACK_CLOSURE *closure = (CALLBACK_CLOSURE*)VECTOR_element(row->callbacks, i);
+        /* Codes_SRS_EVENTSYSTEM_26_010: [ The given `GATEWAY_CALLBACK` function shall be called with proper `GATEWAY_HANDLE`, `GATEWAY_EVENT` and provided user parameter as function parameters coresponding to the gateway and the event that occured. ] */
+        closure->call(row->gateway, row->event_type, row->context, closure->user_param);
+    }
+}
+
+static void push_pending_row(EVENTSYSTEM_HANDLE event_system, THREAD_QUEUE_ROW* row)
+{
+    /* Codes_SRS_EVENTSYSTEM_26_020: [ The `EVENTSYSTEM_DISPATCHER_PERSISTENT` dispatcher shall queue events without taking a lock. ] */
+    THREAD_QUEUE_ROW* head = GATEWAY_ATOMIC_LOAD_POINTER(&event_system->pending_rows);
+    for (;;)
+    {
+        THREAD_QUEUE_ROW* observed;
+        row->next = head;
+        observed = GATEWAY_ATOMIC_CAS_POINTER(&event_system->pending_rows, head, row);
+        if (observed == head)
+        {
+            break;
+        }
+        head = observed;
+    }
+
+    /* publishing the row above and reading the flag here pair with the thread setting the flag and then
+     * looking at the queue again, so at least one side sees the other */
+    if (GATEWAY_ATOMIC_LOAD_SIZE(&event_system->dispatcher_waiting) != 0)
+    {
+        Lock(event_system->thread_queue_lock);
+        Condition_Post(event_system->thread_queue_condition);
+        Unlock(event_system->thread_queue_lock);
+    }
+}
+
+/** @brief Takes every queued row at once and returns them oldest first */
+static THREAD_QUEUE_ROW* take_pending_rows(EVENTSYSTEM_HANDLE event_system)
+{
+    THREAD_QUEUE_ROW* head = GATEWAY_ATOMIC_LOAD_POINTER(&event_system->pending_rows);
+    for (;;)
+    {
+        THREAD_QUEUE_ROW* observed = GATEWAY_ATOMIC_CAS_POINTER(&event_system->pending_rows, head, NULL);
+        if (observed == head)
+        {
+            break;
+        }
+        head = observed;
+    }
+
+    THREAD_QUEUE_ROW* oldest_first = NULL;
+    while (head != NULL)
+    {
+        THREAD_QUEUE_ROW* next = head->next;
+        head->next = oldest_first;
+        oldest_first = head;
+        head = next;
+    }
+    return oldest_first;
+}
+
+static int persistent_thread_main_func(void* event_system_param)
+{
+    EVENTSYSTEM_HANDLE event_system = (EVENTSYSTEM_HANDLE)event_system_param;
+    int keep_running = 1;
+    int wait_failed = 0;
+    while (keep_running)
+    {
+        THREAD_QUEUE_ROW* row = take_pending_rows(event_system);
+        if (row != NULL)
+        {
+            while (row != NULL)
+            {
+                THREAD_QUEUE_ROW* next = row->next;
+                if (row->event_type == GATEWAY_MODULE_LIST_CHANGED && next != NULL && next->event_type == GATEWAY_MODULE_LIST_CHANGED)
+                {
+                    /* Codes_SRS_EVENTSYSTEM_26_021: [ When several `GATEWAY_MODULE_LIST_CHANGED` events are waiting back to back, the `EVENTSYSTEM_DISPATCHER_PERSISTENT` dispatcher shall only deliver the last of them and clean up the module lists of the others. ] */
+                    callback_destroy_modulelist(row->gateway, row->event_type, row->context, NULL);
+                }
+                else
+                {
+                    call_row_callbacks(row);
+                }
+                destroy_thread_row(row);
+                row = next;
+            }
+        }
+        else
+        {
+            Lock(event_system->thread_queue_lock);
+            GATEWAY_ATOMIC_STORE_SIZE(&event_system->dispatcher_waiting, 1);
+            /* an event reported before the flag was set is caught here */
+            if (GATEWAY_ATOMIC_LOAD_POINTER(&event_system->pending_rows) == NULL)
+            {
+                /* Codes_SRS_EVENTSYSTEM_26_022: [ The `EVENTSYSTEM_DISPATCHER_PERSISTENT` dispatcher thread shall wait without a timeout while there are no events, and exit only once the event system is being destroyed and no events are left. ] */
+                if (!event_system->delay_when_queue_empty)
+                {
+                    keep_running = 0;
+                }
+                else if (Condition_Wait(event_system->thread_queue_condition, event_system->thread_queue_lock, 0) == COND_ERROR)
+                {
+                    keep_running = 0;
+                    wait_failed = 1;
+                }
+            }
+            GATEWAY_ATOMIC_STORE_SIZE(&event_system->dispatcher_waiting, 0);
+            Unlock(event_system->thread_queue_lock);
+        }
+    }
+
+    if (wait_failed)
+    {
+        /* Codes_SRS_EVENTSYSTEM_26_013: [ Should the worker thread ever fail to be created or any internall callbacks fail, failure will be logged and no further callbacks will be called during gateway's lifecycle. ] */
+        LogError("event dispatcher failed to wait for events");
+        GATEWAY_ATOMIC_STORE_SIZE(&event_system->is_errored, 1);
+    }
+
+    return THREADAPI_OK;
+}
+
 static GATEWAY_EVENT_CTX handle_module_list_update(EVENTSYSTEM_HANDLE event_system, GATEWAY_HANDLE gateway, VECTOR_HANDLE callbacks)
 {
     /* Codes_SRS_EVENTSYSTEM_26_016: [ This event shall provide `VECTOR_HANDLE` as returned from #Gateway_GetModuleList as the event context in callbacks ] */
@@ -430,4 +707,253 @@ static void callback_destroy_modulelist(GATEWAY_HANDLE gateway, GATEWAY_EVENT ev
     (void)event_type;
     (void)user_param;
     Gateway_DestroyModuleList((VECTOR_HANDLE)context);
-}
\ No newline at end of file
+}
+
+static GATEWAY_EVENT_CTX handle_metrics_snapshot(EVENTSYSTEM_HANDLE event_system, GATEWAY_HANDLE gateway, VECTOR_HANDLE callbacks)
+{
+    /* Codes_SRS_EVENTSYSTEM_26_023: [ This event shall provide `VECTOR_HANDLE` as returned from #Gateway_GetMetricsSnapshot as the event context in callbacks ] */
+    VECTOR_HANDLE snapshot = Gateway_GetMetricsSnapshot(gateway);
+    if (snapshot == NULL)
+    {
+        event_system->is_errored = 1;
+    }
+    else
+    {
+        CALLBACK_CLOSURE closure = {
+            callback_destroy_metrics_snapshot,
+            NULL
+        };
+        /* Codes_SRS_EVENTSYSTEM_26_024: [ This event shall clean up the `VECTOR_HANDLE` of #Gateway_GetMetricsSnapshot after finishing all the callbacks ] */
+        if (VECTOR_push_back(callbacks, &closure, 1) != 0)
+        {
+            LogError("Failed to push back during handling metrics snapshot event");
+            Gateway_DestroyMetricsSnapshot(snapshot);
+            event_system->is_errored = 1;
+            snapshot = NULL;
+        }
+    }
+    return snapshot;
+}
+
+static void callback_destroy_metrics_snapshot(GATEWAY_HANDLE gateway, GATEWAY_EVENT event_type, GATEWAY_EVENT_CTX context, void* user_param)
+{
+    (void)gateway;
+    (void)event_type;
+    (void)user_param;
+    Gateway_DestroyMetricsSnapshot((VECTOR_HANDLE)context);
+}
+
+static GATEWAY_EVENT_CTX handle_module_stuck(EVENTSYSTEM_HANDLE event_system, GATEWAY_HANDLE gateway, VECTOR_HANDLE callbacks)
+{
+    /* Codes_SRS_EVENTSYSTEM_26_025: [ This event shall provide `VECTOR_HANDLE` as returned from #Gateway_GetStuckModules as the event context in callbacks ] */
+    VECTOR_HANDLE stuck_modules = Gateway_GetStuckModules(gateway);
+    if (stuck_modules == NULL)
+    {
+        event_system->is_errored = 1;
+    }
+    else
+    {
+        CALLBACK_CLOSURE closure = {
+            callback_destroy_stuck_modules,
+            NULL
+        };
+        /* Codes_SRS_EVENTSYSTEM_26_026: [ This event shall clean up the `VECTOR_HANDLE` of #Gateway_GetStuckModules after finishing all the callbacks ] */
+        if (VECTOR_push_back(callbacks, &closure, 1) != 0)
+        {
+            LogError("Failed to push back during handling module stuck event");
+            Gateway_DestroyStuckModules(stuck_modules);
+            event_system->is_errored = 1;
+            stuck_modules = NULL;
+        }
+    }
+    return stuck_modules;
+}
+
+static void callback_destroy_stuck_modules(GATEWAY_HANDLE gateway, GATEWAY_EVENT event_type, GATEWAY_EVENT_CTX context, void* user_param)
+{
+    (void)gateway;
+    (void)event_type;
+    (void)user_param;
+    Gateway_DestroyStuckModules((VECTOR_HANDLE)context);
+}
+
+static GATEWAY_EVENT_CTX handle_module_over_budget(EVENTSYSTEM_HANDLE event_system, GATEWAY_HANDLE gateway, VECTOR_HANDLE callbacks)
+{
+    /* Codes_SRS_EVENTSYSTEM_26_027: [ This event shall provide `VECTOR_HANDLE` as returned from #Gateway_GetModulesOverBudget as the event context in callbacks ] */
+    VECTOR_HANDLE over_budget = Gateway_GetModulesOverBudget(gateway);
+    if (over_budget == NULL)
+    {
+        event_system->is_errored = 1;
+    }
+    else
+    {
+        CALLBACK_CLOSURE closure = {
+            callback_destroy_modules_over_budget,
+            NULL
+        };
+        /* Codes_SRS_EVENTSYSTEM_26_028: [ This event shall clean up the `VECTOR_HANDLE` of #Gateway_GetModulesOverBudget after finishing all the callbacks ] */
+        if (VECTOR_push_back(callbacks, &closure, 1) != 0)
+        {
+            LogError("Failed to push back during handling module over budget event");
+            Gateway_DestroyModulesOverBudget(over_budget);
+            event_system->is_errored = 1;
+            over_budget = NULL;
+        }
+    }
+    return over_budget;
+}
+
+static void callback_destroy_modules_over_budget(GATEWAY_HANDLE gateway, GATEWAY_EVENT event_type, GATEWAY_EVENT_CTX context, void* user_param)
+{
+    (void)gateway;
+    (void)event_type;
+    (void)user_param;
+    Gateway_DestroyModulesOverBudget((VECTOR_HANDLE)context);
+}
+
+static GATEWAY_EVENT_CTX handle_load_shedding_changed(EVENTSYSTEM_HANDLE event_system, GATEWAY_HANDLE gateway, VECTOR_HANDLE callbacks)
+{
+    /* Codes_SRS_EVENTSYSTEM_26_029: [ This event shall provide `GATEWAY_LOAD_SHEDDING_STATE*` as returned from #Gateway_GetLoadSheddingState as the event context in callbacks ] */
+    GATEWAY_LOAD_SHEDDING_STATE* state = Gateway_GetLoadSheddingState(gateway);
+    if (state == NULL)
+    {
+        event_system->is_errored = 1;
+    }
+    else
+    {
+        CALLBACK_CLOSURE closure = {
+            callback_destroy_load_shedding_state,
+            NULL
+        };
+        /* Codes_SRS_EVENTSYSTEM_26_030: [ This event shall clean up the `GATEWAY_LOAD_SHEDDING_STATE*` of #Gateway_GetLoadSheddingState after finishing all the callbacks ] */
+        if (VECTOR_push_back(callbacks, &closure, 1) != 0)
+        {
+            LogError("Failed to push back during handling load shedding event");
+            Gateway_DestroyLoadSheddingState(state);
+            event_system->is_errored = 1;
+            state = NULL;
+        }
+    }
+    return state;
+}
+
+static void callback_destroy_load_shedding_state(GATEWAY_HANDLE gateway, GATEWAY_EVENT event_type, GATEWAY_EVENT_CTX context, void* user_param)
+{
+    (void)gateway;
+    (void)event_type;
+    (void)user_param;
+    Gateway_DestroyLoadSheddingState((GATEWAY_LOAD_SHEDDING_STATE*)context);
+}
+
+static GATEWAY_EVENT_CTX handle_startup_reported(EVENTSYSTEM_HANDLE event_system, GATEWAY_HANDLE gateway, VECTOR_HANDLE callbacks)
+{
+    /* Codes_SRS_EVENTSYSTEM_26_031: [ This event shall provide the JSON string returned from #Gateway_GetStartupReport as the event context in callbacks ] */
+    char* report = Gateway_GetStartupReport(gateway);
+    if (report == NULL)
+    {
+        event_system->is_errored = 1;
+    }
+    else
+    {
+        CALLBACK_CLOSURE closure = {
+            callback_destroy_startup_report,
+            NULL
+        };
+        /* Codes_SRS_EVENTSYSTEM_26_032: [ This event shall clean up the string of #Gateway_GetStartupReport after finishing all the callbacks ] */
+        if (VECTOR_push_back(callbacks, &closure, 1) != 0)
+        {
+            LogError("Failed to push back during handling startup report event");
+            Gateway_DestroyStartupReport(report);
+            event_system->is_errored = 1;
+            report = NULL;
+        }
+    }
+    return report;
+}
+
+static void callback_destroy_startup_report(GATEWAY_HANDLE gateway, GATEWAY_EVENT event_type, GATEWAY_EVENT_CTX context, void* user_param)
+{
+    (void)gateway;
+    (void)event_type;
+    (void)user_param;
+    Gateway_DestroyStartupReport((char*)context);
+}
+
+static GATEWAY_EVENT_CTX handle_module_change(EVENTSYSTEM_HANDLE event_system, const char* module_name, VECTOR_HANDLE callbacks)
+{
+    char* name = NULL;
+    /* Codes_SRS_EVENTSYSTEM_17_005: [ `GATEWAY_MODULE_ADDED` and `GATEWAY_MODULE_REMOVED` shall provide a copy of the name of the module as the event context in callbacks ] */
+    if (module_name != NULL)
+    {
+        size_t name_size = strlen(module_name) + 1;
+        name = (char*)malloc(name_size);
+        if (name == NULL)
+        {
+            LogError("Failed to copy the module name during handling module change event");
+            event_system->is_errored = 1;
+        }
+        else
+        {
+            CALLBACK_CLOSURE closure = {
+                callback_free_change,
+                NULL
+            };
+            memcpy(name, module_name, name_size);
+            /* Codes_SRS_EVENTSYSTEM_17_006: [ `GATEWAY_MODULE_ADDED` and `GATEWAY_MODULE_REMOVED` shall free the copy of the name after finishing all the callbacks ] */
+            if (VECTOR_push_back(callbacks, &closure, 1) != 0)
+            {
+                LogError("Failed to push back during handling module change event");
+                free(name);
+                event_system->is_errored = 1;
+                name = NULL;
+            }
+        }
+    }
+    return name;
+}
+
+static GATEWAY_EVENT_CTX handle_link_change(EVENTSYSTEM_HANDLE event_system, const GATEWAY_LINK_ENTRY* link, VECTOR_HANDLE callbacks)
+{
+    GATEWAY_LINK_ENTRY* copy = NULL;
+    /* Codes_SRS_EVENTSYSTEM_17_007: [ `GATEWAY_LINK_ADDED` and `GATEWAY_LINK_REMOVED` shall provide a copy of the `GATEWAY_LINK_ENTRY`, allocated together with its module names, as the event context in callbacks ] */
+    if (link != NULL)
+    {
+        size_t source_size = strlen(link->module_source) + 1;
+        size_t sink_size = strlen(link->module_sink) + 1;
+        copy = (GATEWAY_LINK_ENTRY*)malloc(sizeof(GATEWAY_LINK_ENTRY) + source_size + sink_size);
+        if (copy == NULL)
+        {
+            LogError("Failed to copy the link during handling link change event");
+            event_system->is_errored = 1;
+        }
+        else
+        {
+            char* names = (char*)(copy + 1);
+            CALLBACK_CLOSURE closure = {
+                callback_free_change,
+                NULL
+            };
+            memcpy(names, link->module_source, source_size);
+            memcpy(names + source_size, link->module_sink, sink_size);
+            copy->module_source = names;
+            copy->module_sink = names + source_size;
+            /* Codes_SRS_EVENTSYSTEM_17_008: [ `GATEWAY_LINK_ADDED` and `GATEWAY_LINK_REMOVED` shall free the copy of the link after finishing all the callbacks ] */
+            if (VECTOR_push_back(callbacks, &closure, 1) != 0)
+            {
+                LogError("Failed to push back during handling link change event");
+                free(copy);
+                event_system->is_errored = 1;
+                copy = NULL;
+            }
+        }
+    }
+    return copy;
+}
+
+static void callback_free_change(GATEWAY_HANDLE gateway, GATEWAY_EVENT event_type, GATEWAY_EVENT_CTX context, void* user_param)
+{
+    (void)gateway;
+    (void)event_type;
+    (void)user_param;
+    free(context);
+}
@@ -0,0 +1,68 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+/*this header provides the handful of atomic primitives the gateway core needs on top of the*/
+/*INC_REF/DEC_REF macros of azure_c_shared_utility/refcount.h. It follows the same platform*/
+/*selection as refcount.h: Interlocked* on Windows, the __sync builtins on GCC and clang.*/
+
+#ifndef GATEWAY_ATOMIC_H
+#define GATEWAY_ATOMIC_H
+
+#ifdef _MSC_VER
+#include <windows.h>
+
+/*returns the value that was stored at target before the operation*/
+#define GATEWAY_ATOMIC_CAS_POINTER(target, expected, desired) \
+    InterlockedCompareExchangePointer((PVOID volatile*)(target), (PVOID)(desired), (PVOID)(expected))
+
+/*a compare-and-swap that never succeeds doubles as a load with a full barrier*/
+#define GATEWAY_ATOMIC_LOAD_POINTER(target) \
+    InterlockedCompareExchangePointer((PVOID volatile*)(target), NULL, NULL)
+
+#ifdef _WIN64
+#define GATEWAY_ATOMIC_CAS_SIZE(target, expected, desired) \
+    (size_t)InterlockedCompareExchange64((LONG64 volatile*)(target), (LONG64)(desired), (LONG64)(expected))
+
+#define GATEWAY_ATOMIC_STORE_SIZE(target, value) \
+    (void)InterlockedExchange64((LONG64 volatile*)(target), (LONG64)(value))
+
+/*returns the value that was stored at target before the addition*/
+#define GATEWAY_ATOMIC_ADD_SIZE(target, value) \
+    (size_t)InterlockedExchangeAdd64((LONG64 volatile*)(target), (LONG64)(value))
+#else
+#define GATEWAY_ATOMIC_CAS_SIZE(target, expected, desired) \
+    (size_t)InterlockedCompareExchange((LONG volatile*)(target), (LONG)(desired), (LONG)(expected))
+
+#define GATEWAY_ATOMIC_STORE_SIZE(target, value) \
+    (void)InterlockedExchange((LONG volatile*)(target), (LONG)(value))
+
+#define GATEWAY_ATOMIC_ADD_SIZE(target, value) \
+    (size_t)InterlockedExchangeAdd((LONG volatile*)(target), (LONG)(value))
+#endif
+
+#elif defined(__GNUC__)
+
+#define GATEWAY_ATOMIC_CAS_POINTER(target, expected, desired) \
+    __sync_val_compare_and_swap((target), (expected), (desired))
+
+#define GATEWAY_ATOMIC_LOAD_POINTER(target) \
+    __sync_val_compare_and_swap((target), NULL, NULL)
+
+#define GATEWAY_ATOMIC_CAS_SIZE(target, expected, desired) \
+    __sync_val_compare_and_swap((target), (size_t)(expected), (size_t)(desired))
+
+/*__sync_lock_test_and_set is only an acquire barrier, so the store is fenced on both sides*/
+#define GATEWAY_ATOMIC_STORE_SIZE(target, value) \
+    do { __sync_synchronize(); *(target) = (value); __sync_synchronize(); } while (0)
+
+#define GATEWAY_ATOMIC_ADD_SIZE(target, value) \
+    __sync_fetch_and_add((target), (size_t)(value))
+
+#else
+#error "no atomic primitives available for this compiler"
+#endif
+
+#define GATEWAY_ATOMIC_LOAD_SIZE(target) \
+    GATEWAY_ATOMIC_CAS_SIZE((target), 0, 0)
+
+#endif /*GATEWAY_ATOMIC_H*/
@@ -0,0 +1,93 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+/*this header provides a monotonic clock with microsecond resolution for timing inside the gateway*/
+/*core. tickcounter.h only offers milliseconds and needs a handle, which is too coarse and too*/
+/*costly to use once per message. gateway_clock_thread_cpu_us gives the CPU time the calling*/
+/*thread used, so work can be charged to the module that ran it, and gateway_clock_process_cpu_us*/
+/*the CPU time of the whole process, summed over its threads.*/
+
+#ifndef GATEWAY_CLOCK_H
+#define GATEWAY_CLOCK_H
+
+#include <stdint.h>
+
+#ifdef _MSC_VER
+#include <windows.h>
+
+static __inline uint64_t gateway_clock_now_us(void)
+{
+    LARGE_INTEGER frequency;
+    LARGE_INTEGER counter;
+    (void)QueryPerformanceFrequency(&frequency);
+    (void)QueryPerformanceCounter(&counter);
+    /*split the conversion so the multiplication cannot overflow*/
+    return (uint64_t)(counter.QuadPart / frequency.QuadPart) * 1000000 +
+        (uint64_t)(counter.QuadPart % frequency.QuadPart) * 1000000 / (uint64_t)frequency.QuadPart;
+}
+
+static __inline uint64_t gateway_clock_thread_cpu_us(void)
+{
+    FILETIME creation;
+    FILETIME exit;
+    FILETIME kernel;
+    FILETIME user;
+    if (!GetThreadTimes(GetCurrentThread(), &creation, &exit, &kernel, &user))
+    {
+        return 0;
+    }
+    /*FILETIME counts 100 nanosecond intervals*/
+    return ((((uint64_t)kernel.dwHighDateTime << 32) | kernel.dwLowDateTime) +
+        (((uint64_t)user.dwHighDateTime << 32) | user.dwLowDateTime)) / 10;
+}
+
+static __inline uint64_t gateway_clock_process_cpu_us(void)
+{
+    FILETIME creation;
+    FILETIME exit;
+    FILETIME kernel;
+    FILETIME user;
+    if (!GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user))
+    {
+        return 0;
+    }
+    return ((((uint64_t)kernel.dwHighDateTime << 32) | kernel.dwLowDateTime) +
+        (((uint64_t)user.dwHighDateTime << 32) | user.dwLowDateTime)) / 10;
+}
+
+#else
+#include <time.h>
+
+static inline uint64_t gateway_clock_now_us(void)
+{
+    struct timespec now;
+    if (clock_gettime(CLOCK_MONOTONIC, &now) != 0)
+    {
+        return 0;
+    }
+    return (uint64_t)now.tv_sec * 1000000 + (uint64_t)now.tv_nsec / 1000;
+}
+
+static inline uint64_t gateway_clock_thread_cpu_us(void)
+{
+    struct timespec used;
+    if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &used) != 0)
+    {
+        return 0;
+    }
+    return (uint64_t)used.tv_sec * 1000000 + (uint64_t)used.tv_nsec / 1000;
+}
+
+static inline uint64_t gateway_clock_process_cpu_us(void)
+{
+    struct timespec used;
+    if (clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &used) != 0)
+    {
+        return 0;
+    }
+    return (uint64_t)used.tv_sec * 1000000 + (uint64_t)used.tv_nsec / 1000;
+}
+
+#endif
+
+#endif /*GATEWAY_CLOCK_H*/
@@ -0,0 +1,63 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+/*this header reads and writes the configuration snapshots Gateway_CreateFromJson keeps next to a*/
+/*JSON configuration file. A snapshot holds what parsing the file produced, already validated and*/
+/*serialized: the "loaders" array, and for each module its name, loader name, entrypoint, args,*/
+/*activation and the hash of its JSON object, and the links. The file is laid out so it can be*/
+/*mapped and used in place: fixed size tables of offsets into a block of NUL terminated strings, so*/
+/*opening it costs a mmap and a few checks instead of a parse. The entrypoints stay JSON, since only the loaders*/
+/*know what they parse them into. A snapshot is only used while the FNV-1a hash of the file it was*/
+/*written from matches the file as it is now.*/
+
+#ifndef GATEWAY_CONFIG_SNAPSHOT_H
+#define GATEWAY_CONFIG_SNAPSHOT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "gateway.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+typedef struct GATEWAY_CONFIG_SNAPSHOT_MODULE_TAG
+{
+    const char* module_name;
+    const char* loader_name;
+    /*the serialized "loader.entrypoint" value, NULL if the module has none*/
+    const char* entrypoint;
+    /*the serialized "args" value, NULL if the module has none*/
+    const char* args;
+    /*the serialized "activation" value, NULL if the module has none*/
+    const char* activation;
+    uint64_t configuration_hash;
+} GATEWAY_CONFIG_SNAPSHOT_MODULE;
+
+typedef struct GATEWAY_CONFIG_SNAPSHOT_TAG* GATEWAY_CONFIG_SNAPSHOT_HANDLE;
+
+/*returns the content of file_path, NUL terminated, and its hash in source_hash, NULL if it cannot be read*/
+char* GatewayConfigSnapshot_ReadSource(const char* file_path, uint64_t* source_hash);
+
+/*writes the snapshot to a file next to snapshot_path and moves it into place, so a snapshot is never*/
+/*seen half written. returns 0 upon success*/
+int GatewayConfigSnapshot_Write(const char* snapshot_path, uint64_t source_hash, const char* loaders, const GATEWAY_CONFIG_SNAPSHOT_MODULE* modules, size_t module_count, const GATEWAY_LINK_ENTRY* links, size_t link_count);
+
+/*maps snapshot_path, NULL if it does not exist, is damaged or was written from another source*/
+GATEWAY_CONFIG_SNAPSHOT_HANDLE GatewayConfigSnapshot_Open(const char* snapshot_path, uint64_t source_hash);
+
+/*the strings below point into the mapping and live until GatewayConfigSnapshot_Close*/
+const char* GatewayConfigSnapshot_GetLoaders(GATEWAY_CONFIG_SNAPSHOT_HANDLE snapshot);
+size_t GatewayConfigSnapshot_GetModuleCount(GATEWAY_CONFIG_SNAPSHOT_HANDLE snapshot);
+void GatewayConfigSnapshot_GetModule(GATEWAY_CONFIG_SNAPSHOT_HANDLE snapshot, size_t index, GATEWAY_CONFIG_SNAPSHOT_MODULE* module);
+size_t GatewayConfigSnapshot_GetLinkCount(GATEWAY_CONFIG_SNAPSHOT_HANDLE snapshot);
+void GatewayConfigSnapshot_GetLink(GATEWAY_CONFIG_SNAPSHOT_HANDLE snapshot, size_t index, GATEWAY_LINK_ENTRY* link);
+
+void GatewayConfigSnapshot_Close(GATEWAY_CONFIG_SNAPSHOT_HANDLE snapshot);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /*GATEWAY_CONFIG_SNAPSHOT_H*/
@@ -0,0 +1,42 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+/*this header lets the gateway defer loading a module until a message reaches it. A lazy module is*/
+/*added to the gateway as a stand-in that is attached to the broker and linked like any module, but*/
+/*only loads the library and creates the module behind it on its first message, on the timer service*/
+/*of the broker so the broker keeps delivering meanwhile. The messages that arrive until the module is created*/
+/*are kept in a bounded queue and handed to it in order once it is. What the module publishes is*/
+/*routed as the stand-in's, see Broker_SetModulePublisher, so links from it work as configured. A*/
+/*module that received nothing for a while may be destroyed and its library unloaded again; the*/
+/*next message activates it anew.*/
+
+#ifndef GATEWAY_LAZY_MODULE_H
+#define GATEWAY_LAZY_MODULE_H
+
+#include <stddef.h>
+#include "gateway.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#define GATEWAY_LAZY_DEFAULT_QUEUED_MESSAGES 64
+
+typedef struct GATEWAY_LAZY_ACTIVATION_TAG
+{
+    /*messages kept while the module is being created, rounded up to a power of two; more are dropped*/
+    size_t max_queued_messages;
+    /*the module is destroyed after it received nothing for this long, 0 to keep it once created*/
+    unsigned int idle_timeout_ms;
+} GATEWAY_LAZY_ACTIVATION;
+
+/*makes loader_info describe a stand-in that loads the module it described on demand, and takes over*/
+/*its entrypoint. returns 0 upon success; upon failure loader_info is left as it was*/
+int GatewayLazyModule_Wrap(GATEWAY_MODULE_LOADER_INFO* loader_info, const GATEWAY_LAZY_ACTIVATION* activation);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /*GATEWAY_LAZY_MODULE_H*/
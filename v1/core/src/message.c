@@ -3,30 +3,430 @@
 
 #include <stdlib.h>
 #include <stddef.h>
+#include <stdbool.h>
+#include <string.h>
 #include <inttypes.h>
 #include "azure_c_shared_utility/gballoc.h"
 
 #include "message.h"
+#include "module_memory.h"
+#include "gateway_trace.h"
 #include "azure_c_shared_utility/buffer_.h"
 #include "azure_c_shared_utility/map.h"
 #include "azure_c_shared_utility/constmap.h"
 #include "azure_c_shared_utility/xlogging.h"
 
 #include "azure_c_shared_utility/refcount.h"
+#include "internal/gateway_atomic.h"
 
 #define FIRST_MESSAGE_BYTE 0xA1  /*0xA1 comes from (A)zure (I)oT*/
 #define SECOND_MESSAGE_BYTE 0x60 /*0x60 comes from (G)ateway*/
+#define SECOND_MESSAGE_BYTE_V2 0x62 /*0x60 with the serialization version in the low bits*/
 
 #define MIN_MESSAGE_BUFFER_LENGTH 14 /*14 is the minimum message length that is still valid*/
+#define MIN_MESSAGE_BUFFER_LENGTH_V2 4 /*header, property count and content size*/
+
+#define CONTENT_ALIGNMENT_V2 8 /*version 2 aligns content of at least this many bytes to this many bytes*/
+#define MAX_VARINT_LENGTH 5 /*an int32_t never needs more than 5 groups of 7 bits*/
+
+/*property names that a version 2 serialization encodes as an index in this table. The table is part of*/
+/*the version 2 format: entries can never be changed, reordered or removed, and adding one needs a new version*/
+static const char* const MESSAGE_KEY_DICTIONARY[] =
+{
+    "source",
+    "macAddress",
+    "deviceName",
+    "deviceKey",
+    "iotHubMessageId",
+    "iotHubMessageDeliveryStatus",
+    "bleControllerIndex",
+    "timestamp",
+    "characteristicUUID"
+};
+
+#define MESSAGE_KEY_DICTIONARY_SIZE (sizeof(MESSAGE_KEY_DICTIONARY) / sizeof(MESSAGE_KEY_DICTIONARY[0]))
+
+/*the serialized form of a message, computed at most once per message and followed in memory by "size" bytes*/
+typedef struct MESSAGE_SERIALIZATION_TAG
+{
+    int32_t size;
+}MESSAGE_SERIALIZATION;
+
+/*a derived message only stores what differs from its parent: the properties it overrides and the ones it removes*/
+typedef struct MESSAGE_OVERLAY_TAG
+{
+    MESSAGE_HANDLE parent;
+    CONSTMAP_HANDLE overrides;
+    const char* const* overrideKeys;
+    const char* const* overrideValues;
+    size_t overrideCount;
+    char** removedKeys;
+    size_t removedCount;
+    size_t propertiesBound; /*an upper bound for the number of properties of the derived message*/
+}MESSAGE_OVERLAY;
 
 typedef struct MESSAGE_HANDLE_DATA_TAG
 {
-    CONSTMAP_HANDLE properties;
+    /*for a derived message this is NULL until somebody asks for the whole property map*/
+    CONSTMAP_HANDLE volatile properties;
+    /*a derived message borrows the content of its parent*/
     CONSTBUFFER_HANDLE content;
+    /*indexed by serialization version - 1*/
+    MESSAGE_SERIALIZATION* volatile serialized[GATEWAY_MESSAGE_VERSION_MAX];
+    MESSAGE_OVERLAY* overlay;
+    /*the account of the module that created the message, NULL if there was none*/
+    MODULE_MEMORY_HANDLE owner;
+    size_t charged;
 }MESSAGE_HANDLE_DATA;
 
 DEFINE_REFCOUNT_TYPE(MESSAGE_HANDLE_DATA);
 
+/*charges a new message to the module running on this thread. Content that the message shares with*/
+/*another message or buffer is not counted, it belongs to whoever made it*/
+static void Message_ChargeOwner(MESSAGE_HANDLE_DATA* messageData, size_t ownedContentSize)
+{
+    /*Codes_SRS_MESSAGE_17_061: [ A new message shall be charged to the current module memory account of the calling thread with the size of the message and of the content it copied. ]*/
+    messageData->charged = sizeof(MESSAGE_HANDLE_DATA) + ownedContentSize;
+    messageData->owner = ModuleMemory_Charge(messageData->charged);
+}
+
+/*returns true when the overlay replaces or removes the property "key" of its parent*/
+static bool Message_OverlayHidesKey(const MESSAGE_OVERLAY* overlay, const char* key)
+{
+    bool result = false;
+    size_t i;
+    for (i = 0; (i < overlay->overrideCount) && !result; i++)
+    {
+        result = (strcmp(overlay->overrideKeys[i], key) == 0);
+    }
+    for (i = 0; (i < overlay->removedCount) && !result; i++)
+    {
+        result = (strcmp(overlay->removedKeys[i], key) == 0);
+    }
+    return result;
+}
+
+/*appends the properties of the message to keys and values, starting at index *count*/
+static int Message_CollectProperties(MESSAGE_HANDLE_DATA* messageData, const char** keys, const char** values, size_t* count)
+{
+    int result;
+    CONSTMAP_HANDLE properties = GATEWAY_ATOMIC_LOAD_POINTER(&messageData->properties);
+    if (properties != NULL)
+    {
+        const char* const* ownKeys;
+        const char* const* ownValues;
+        size_t ownCount;
+        if (ConstMap_GetInternals(properties, &ownKeys, &ownValues, &ownCount) != CONSTMAP_OK)
+        {
+            LogError("failed to get the keys and values from the message properties");
+            result = __LINE__;
+        }
+        else
+        {
+            memcpy(keys + *count, ownKeys, ownCount * sizeof(const char*));
+            memcpy(values + *count, ownValues, ownCount * sizeof(const char*));
+            *count += ownCount;
+            result = 0;
+        }
+    }
+    else
+    {
+        MESSAGE_OVERLAY* overlay = messageData->overlay;
+        size_t first = *count;
+        if (Message_CollectProperties((MESSAGE_HANDLE_DATA*)overlay->parent, keys, values, count) != 0)
+        {
+            result = __LINE__;
+        }
+        else
+        {
+            /*keep the properties of the parent that are neither overridden nor removed...*/
+            size_t kept = first;
+            size_t i;
+            for (i = first; i < *count; i++)
+            {
+                if (!Message_OverlayHidesKey(overlay, keys[i]))
+                {
+                    keys[kept] = keys[i];
+                    values[kept] = values[i];
+                    kept++;
+                }
+            }
+
+            /*... and append the overrides*/
+            for (i = 0; i < overlay->overrideCount; i++)
+            {
+                keys[kept] = overlay->overrideKeys[i];
+                values[kept] = overlay->overrideValues[i];
+                kept++;
+            }
+            *count = kept;
+            result = 0;
+        }
+    }
+    return result;
+}
+
+/*gets the keys and values of the message properties. When they have to be gathered from a chain of derived*/
+/*messages the arrays are allocated in *storage, which the caller shall free; otherwise *storage is NULL*/
+static int Message_GetPropertyArrays(MESSAGE_HANDLE_DATA* messageData, const char* const** keys, const char* const** values, size_t* count, void** storage)
+{
+    int result;
+    CONSTMAP_HANDLE properties = GATEWAY_ATOMIC_LOAD_POINTER(&messageData->properties);
+    if (properties != NULL)
+    {
+        *storage = NULL;
+        if (ConstMap_GetInternals(properties, keys, values, count) != CONSTMAP_OK)
+        {
+            LogError("failed to get the keys and values from the message properties");
+            result = __LINE__;
+        }
+        else
+        {
+            result = 0;
+        }
+    }
+    else if (messageData->overlay->propertiesBound == 0)
+    {
+        *storage = NULL;
+        *keys = NULL;
+        *values = NULL;
+        *count = 0;
+        result = 0;
+    }
+    else
+    {
+        size_t bound = messageData->overlay->propertiesBound;
+        const char** arrays = (const char**)malloc(2 * bound * sizeof(const char*));
+        if (arrays == NULL)
+        {
+            LogError("unable to allocate the property arrays of a derived message");
+            result = __LINE__;
+        }
+        else
+        {
+            *count = 0;
+            if (Message_CollectProperties(messageData, arrays, arrays + bound, count) != 0)
+            {
+                free(arrays);
+                result = __LINE__;
+            }
+            else
+            {
+                *keys = arrays;
+                *values = arrays + bound;
+                *storage = (void*)arrays;
+                result = 0;
+            }
+        }
+    }
+    return result;
+}
+
+/*builds the property map of a derived message and publishes it on the message. Returns the published map (not cloned).*/
+static CONSTMAP_HANDLE Message_MaterializeProperties(MESSAGE_HANDLE_DATA* messageData)
+{
+    CONSTMAP_HANDLE result;
+    const char* const* keys;
+    const char* const* values;
+    size_t count;
+    void* storage;
+    if (Message_GetPropertyArrays(messageData, &keys, &values, &count, &storage) != 0)
+    {
+        LogError("unable to gather the properties of a derived message");
+        result = NULL;
+    }
+    else
+    {
+        MAP_HANDLE map = Map_Create(NULL);
+        if (map == NULL)
+        {
+            LogError("Map_Create failed");
+            result = NULL;
+        }
+        else
+        {
+            size_t i;
+            for (i = 0; i < count; i++)
+            {
+                if (Map_Add(map, keys[i], values[i]) != MAP_OK)
+                {
+                    LogError("Map_Add failed");
+                    break;
+                }
+            }
+
+            if (i != count)
+            {
+                result = NULL;
+            }
+            else
+            {
+                CONSTMAP_HANDLE candidate = ConstMap_Create(map);
+                if (candidate == NULL)
+                {
+                    LogError("ConstMap_Create failed");
+                    result = NULL;
+                }
+                else
+                {
+                    /*Codes_SRS_MESSAGE_17_041: [ Message_GetProperties shall build the property map of a derived message only once. ]*/
+                    result = GATEWAY_ATOMIC_CAS_POINTER(&messageData->properties, NULL, candidate);
+                    if (result != NULL)
+                    {
+                        ConstMap_Destroy(candidate);
+                    }
+                    else
+                    {
+                        result = candidate;
+                    }
+                }
+            }
+            Map_Destroy(map);
+        }
+
+        if (storage != NULL)
+        {
+            free(storage);
+        }
+    }
+    return result;
+}
+
+/*copies a NULL terminated array of keys in a single allocation*/
+static int Message_CopyRemovedKeys(const char* const* removedKeys, char*** copy, size_t* count)
+{
+    int result;
+    size_t n = 0;
+    size_t textSize = 0;
+    if (removedKeys != NULL)
+    {
+        while (removedKeys[n] != NULL)
+        {
+            textSize += strlen(removedKeys[n]) + 1;
+            n++;
+        }
+    }
+
+    if (n == 0)
+    {
+        *copy = NULL;
+        *count = 0;
+        result = 0;
+    }
+    else
+    {
+        char** keys = (char**)malloc(n * sizeof(char*) + textSize);
+        if (keys == NULL)
+        {
+            LogError("unable to allocate the removed keys");
+            result = __LINE__;
+        }
+        else
+        {
+            char* text = (char*)(keys + n);
+            size_t i;
+            for (i = 0; i < n; i++)
+            {
+                size_t length = strlen(removedKeys[i]) + 1;
+                memcpy(text, removedKeys[i], length);
+                keys[i] = text;
+                text += length;
+            }
+            *copy = keys;
+            *count = n;
+            result = 0;
+        }
+    }
+    return result;
+}
+
+static void Message_DestroyOverlay(MESSAGE_OVERLAY* overlay)
+{
+    if (overlay->overrides != NULL)
+    {
+        ConstMap_Destroy(overlay->overrides);
+    }
+    if (overlay->removedKeys != NULL)
+    {
+        free(overlay->removedKeys);
+    }
+    Message_Destroy(overlay->parent);
+    free(overlay);
+}
+
+static MESSAGE_OVERLAY* Message_CreateOverlay(MESSAGE_HANDLE parent, MAP_HANDLE overrides, const char* const* removedKeys)
+{
+    MESSAGE_OVERLAY* result = (MESSAGE_OVERLAY*)malloc(sizeof(MESSAGE_OVERLAY));
+    if (result == NULL)
+    {
+        LogError("unable to allocate the overlay of a derived message");
+    }
+    else
+    {
+        MESSAGE_HANDLE_DATA* parentData = (MESSAGE_HANDLE_DATA*)parent;
+        size_t parentBound;
+        const char* const* parentKeys;
+        const char* const* parentValues;
+
+        if (parentData->overlay != NULL)
+        {
+            parentBound = parentData->overlay->propertiesBound;
+        }
+        else if (ConstMap_GetInternals(parentData->properties, &parentKeys, &parentValues, &parentBound) != CONSTMAP_OK)
+        {
+            /*Codes_SRS_MESSAGE_17_032: [ If any of the above steps fails, Message_CreateDerived shall fail and return NULL. ]*/
+            LogError("failed to get the number of properties of the parent message");
+            free(result);
+            result = NULL;
+        }
+
+        if (result != NULL)
+        {
+            result->overrides = NULL;
+            result->overrideKeys = NULL;
+            result->overrideValues = NULL;
+            result->overrideCount = 0;
+
+            /*Codes_SRS_MESSAGE_17_029: [ If overrides is not NULL, Message_CreateDerived shall copy overrides to a readonly CONSTMAP. ]*/
+            if ((overrides != NULL) &&
+                ((result->overrides = ConstMap_Create(overrides)) == NULL))
+            {
+                /*Codes_SRS_MESSAGE_17_032: [ If any of the above steps fails, Message_CreateDerived shall fail and return NULL. ]*/
+                LogError("ConstMap_Create failed");
+                free(result);
+                result = NULL;
+            }
+            else if ((result->overrides != NULL) &&
+                (ConstMap_GetInternals(result->overrides, &result->overrideKeys, &result->overrideValues, &result->overrideCount) != CONSTMAP_OK))
+            {
+                /*Codes_SRS_MESSAGE_17_032: [ If any of the above steps fails, Message_CreateDerived shall fail and return NULL. ]*/
+                LogError("failed to get the keys and values from the overrides");
+                ConstMap_Destroy(result->overrides);
+                free(result);
+                result = NULL;
+            }
+            /*Codes_SRS_MESSAGE_17_030: [ Message_CreateDerived shall copy the NULL terminated array removedKeys, which may be NULL. ]*/
+            else if (Message_CopyRemovedKeys(removedKeys, &result->removedKeys, &result->removedCount) != 0)
+            {
+                /*Codes_SRS_MESSAGE_17_032: [ If any of the above steps fails, Message_CreateDerived shall fail and return NULL. ]*/
+                if (result->overrides != NULL)
+                {
+                    ConstMap_Destroy(result->overrides);
+                }
+                free(result);
+                result = NULL;
+            }
+            else
+            {
+                result->propertiesBound = parentBound + result->overrideCount;
+                /*Codes_SRS_MESSAGE_17_031: [ Message_CreateDerived shall call Message_Clone on parent and share the content of parent. ]*/
+                result->parent = Message_Clone(parent);
+            }
+        }
+    }
+    return result;
+}
+
 static MESSAGE_HANDLE_DATA* Message_CreateImpl(const MESSAGE_CONFIG * cfg)
 {
     MESSAGE_HANDLE_DATA* result;
@@ -63,7 +463,10 @@ static MESSAGE_HANDLE_DATA* Message_CreateImpl(const MESSAGE_CONFIG * cfg)
             }
             else
             {
-                /*all is fine, return as is.*/
+                /*Codes_SRS_MESSAGE_17_018: [ A newly created message shall not have a serialized form. ]*/
+                memset((void*)result->serialized, 0, sizeof(result->serialized));
+                result->overlay = NULL;
+                Message_ChargeOwner(result, cfg->size);
             }
         }
     }
@@ -147,14 +550,111 @@ MESSAGE_HANDLE Message_CreateFromBuffer(const MESSAGE_BUFFER_CONFIG* cfg)
                 }
                 else
                 {
-                    /*all is fine, return as is.*/
-				}
+                    /*Codes_SRS_MESSAGE_17_018: [ A newly created message shall not have a serialized form. ]*/
+                    memset((void*)result->serialized, 0, sizeof(result->serialized));
+                    result->overlay = NULL;
+                    Message_ChargeOwner(result, 0);
+                }
+            }
+        }
+    }
+    return (MESSAGE_HANDLE)result;
+}
+
+MESSAGE_HANDLE Message_CreateDerived(MESSAGE_HANDLE parent, MAP_HANDLE overrides, const char* const* removedKeys)
+{
+    MESSAGE_HANDLE_DATA* result;
+    if (parent == NULL)
+    {
+        /*Codes_SRS_MESSAGE_17_027: [ If parent is NULL then Message_CreateDerived shall fail and return NULL. ]*/
+        LogError("invalid parameter (NULL).");
+        result = NULL;
+    }
+    else
+    {
+        /*Codes_SRS_MESSAGE_17_028: [ On success, Message_CreateDerived shall return a non-NULL handle and set the internal ref count to "1". ]*/
+        result = REFCOUNT_TYPE_CREATE(MESSAGE_HANDLE_DATA);
+        if (result == NULL)
+        {
+            /*Codes_SRS_MESSAGE_17_032: [ If any of the above steps fails, Message_CreateDerived shall fail and return NULL. ]*/
+            LogError("malloc returned NULL");
+        }
+        else
+        {
+            result->overlay = Message_CreateOverlay(parent, overrides, removedKeys);
+            if (result->overlay == NULL)
+            {
+                LogError("unable to create the overlay of the derived message");
+                free(result);
+                result = NULL;
+            }
+            else
+            {
+                result->content = ((MESSAGE_HANDLE_DATA*)parent)->content;
+                result->properties = NULL;
+                /*Codes_SRS_MESSAGE_17_018: [ A newly created message shall not have a serialized form. ]*/
+                memset((void*)result->serialized, 0, sizeof(result->serialized));
+                Message_ChargeOwner(result, 0);
             }
         }
     }
     return (MESSAGE_HANDLE)result;
 }
 
+const char* Message_GetProperty(MESSAGE_HANDLE message, const char* key)
+{
+    const char* result;
+    if (
+        (message == NULL) ||
+        (key == NULL)
+        )
+    {
+        /*Codes_SRS_MESSAGE_17_033: [ If message or key is NULL then Message_GetProperty shall return NULL. ]*/
+        LogError("invalid parameter message=[%p] key=[%p]", message, key);
+        result = NULL;
+    }
+    else
+    {
+        MESSAGE_HANDLE_DATA* messageData = (MESSAGE_HANDLE_DATA*)message;
+        bool resolved = false;
+        result = NULL;
+        while (!resolved && (messageData->overlay != NULL))
+        {
+            const MESSAGE_OVERLAY* overlay = messageData->overlay;
+            size_t i;
+            for (i = 0; (i < overlay->overrideCount) && !resolved; i++)
+            {
+                if (strcmp(overlay->overrideKeys[i], key) == 0)
+                {
+                    /*Codes_SRS_MESSAGE_17_034: [ If message is a derived message that overrides key, Message_GetProperty shall return the overriding value. ]*/
+                    result = overlay->overrideValues[i];
+                    resolved = true;
+                }
+            }
+            for (i = 0; (i < overlay->removedCount) && !resolved; i++)
+            {
+                if (strcmp(overlay->removedKeys[i], key) == 0)
+                {
+                    /*Codes_SRS_MESSAGE_17_035: [ Otherwise, if message is a derived message that removes key, Message_GetProperty shall return NULL. ]*/
+                    resolved = true;
+                }
+            }
+            if (!resolved)
+            {
+                /*Codes_SRS_MESSAGE_17_036: [ Otherwise, if message is a derived message, Message_GetProperty shall look key up in the parent message. ]*/
+                messageData = (MESSAGE_HANDLE_DATA*)overlay->parent;
+            }
+        }
+
+        if (!resolved)
+        {
+            /*Codes_SRS_MESSAGE_17_037: [ Otherwise, Message_GetProperty shall return the value of key from the message properties, or NULL if there is no such property. ]*/
+            result = ConstMap_GetValue(messageData->properties, key);
+        }
+    }
+    return result;
+}
+
 MESSAGE_HANDLE Message_Clone(MESSAGE_HANDLE message)
 {
     if (message == NULL)
@@ -165,12 +665,10 @@ MESSAGE_HANDLE Message_Clone(MESSAGE_HANDLE message)
     else
     {
         /*Codes_SRS_MESSAGE_02_008: [Otherwise, Message_Clone shall increment the internal ref count.] */
+        /*Codes_SRS_MESSAGE_17_001: [ Message_Clone shall not clone the CONSTMAP handle; the internal ref count of the message covers its properties. ]*/
+        /*Codes_SRS_MESSAGE_17_004: [ Message_Clone shall not clone the CONSTBUFFER handle; the internal ref count of the message covers its content. ]*/
+        /*Codes_SRS_MESSAGE_17_038: [ For a derived message, Message_Clone shall only increment the internal ref count. ]*/
         INC_REF(MESSAGE_HANDLE_DATA, message);
-        MESSAGE_HANDLE_DATA* messageData = (MESSAGE_HANDLE_DATA*)message;
-        /*Codes_SRS_MESSAGE_17_001: [Message_Clone shall clone the CONSTMAP handle.]*/
-        (void)ConstMap_Clone(messageData->properties);
-        /*Codes_SRS_MESSAGE_17_004: [Message_Clone shall clone the CONSTBUFFER handle]*/
-        (void)CONSTBUFFER_Clone(messageData->content);
     }
     /*Codes_SRS_MESSAGE_02_010: [Message_Clone shall return messageHandle.]*/
     return message;
@@ -187,9 +685,25 @@ CONSTMAP_HANDLE Message_GetProperties(MESSAGE_HANDLE message)
     }
     else
     {
-        /*Codes_SRS_MESSAGE_02_012: [Otherwise, Message_GetProperties shall shall clone and return the CONSTMAP handle representing the properties of the message.]*/
         MESSAGE_HANDLE_DATA* messageData = (MESSAGE_HANDLE_DATA*)message;
-        result = ConstMap_Clone(messageData->properties);
+        CONSTMAP_HANDLE properties = GATEWAY_ATOMIC_LOAD_POINTER(&messageData->properties);
+        if (properties == NULL)
+        {
+            /*only a derived message has no property map of its own*/
+            properties = Message_MaterializeProperties(messageData);
+        }
+
+        if (properties == NULL)
+        {
+            /*Codes_SRS_MESSAGE_17_040: [ If building the property map of a derived message fails, Message_GetProperties shall return NULL. ]*/
+            LogError("unable to build the properties of derived message [%p]", message);
+            result = NULL;
+        }
+        else
+        {
+            /*Codes_SRS_MESSAGE_02_012: [Otherwise, Message_GetProperties shall shall clone and return the CONSTMAP handle representing the properties of the message.]*/
+            result = ConstMap_Clone(properties);
+        }
     }
     return result;
 }
@@ -212,19 +726,63 @@ const CONSTBUFFER * Message_GetContent(MESSAGE_HANDLE message)
     return result;
 }
 
-CONSTBUFFER_HANDLE Message_GetContentHandle(MESSAGE_HANDLE message) 
+CONSTBUFFER_HANDLE Message_GetContentHandle(MESSAGE_HANDLE message) 
+{
+    CONSTBUFFER_HANDLE result;
+    if (message == NULL)
+    {
+        /*Codes_SRS_MESSAGE_17_006: [If message is NULL then Message_GetContentHandle shall return NULL.] */
+        LogError("invalid argument, message is NULL");
+        result = NULL;
+    }
+    else
+    {
+        /*Codes_SRS_MESSAGE_17_007: [Otherwise, Message_GetContentHandle shall shall clone and return the CONSTBUFFER_HANDLE representing the message content.]*/
+        result = CONSTBUFFER_Clone(((MESSAGE_HANDLE_DATA*)message)->content);
+    }
+    return result;
+}
+
+CONSTMAP_HANDLE Message_BorrowProperties(MESSAGE_HANDLE message)
+{
+    CONSTMAP_HANDLE result;
+    if (message == NULL)
+    {
+        /*Codes_SRS_MESSAGE_17_056: [ If message is NULL then Message_BorrowProperties shall return NULL. ]*/
+        LogError("invalid arg: message is NULL");
+        result = NULL;
+    }
+    else
+    {
+        MESSAGE_HANDLE_DATA* messageData = (MESSAGE_HANDLE_DATA*)message;
+        result = GATEWAY_ATOMIC_LOAD_POINTER(&messageData->properties);
+        if (result == NULL)
+        {
+            /*Codes_SRS_MESSAGE_17_057: [ For a derived message, Message_BorrowProperties shall build the property map as Message_GetProperties does, and return NULL if that fails. ]*/
+            result = Message_MaterializeProperties(messageData);
+            if (result == NULL)
+            {
+                LogError("unable to build the properties of derived message [%p]", message);
+            }
+        }
+        /*Codes_SRS_MESSAGE_17_058: [ Otherwise, Message_BorrowProperties shall return the CONSTMAP handle representing the properties of the message without cloning it. ]*/
+    }
+    return result;
+}
+
+CONSTBUFFER_HANDLE Message_BorrowContentHandle(MESSAGE_HANDLE message)
 {
     CONSTBUFFER_HANDLE result;
     if (message == NULL)
     {
-        /*Codes_SRS_MESSAGE_17_006: [If message is NULL then Message_GetContentHandle shall return NULL.] */
+        /*Codes_SRS_MESSAGE_17_059: [ If message is NULL then Message_BorrowContentHandle shall return NULL. ]*/
         LogError("invalid argument, message is NULL");
         result = NULL;
     }
     else
     {
-        /*Codes_SRS_MESSAGE_17_007: [Otherwise, Message_GetContentHandle shall shall clone and return the CONSTBUFFER_HANDLE representing the message content.]*/
-        result = CONSTBUFFER_Clone(((MESSAGE_HANDLE_DATA*)message)->content);
+        /*Codes_SRS_MESSAGE_17_060: [ Otherwise, Message_BorrowContentHandle shall return the CONSTBUFFER_HANDLE representing the message content without cloning it. ]*/
+        result = ((MESSAGE_HANDLE_DATA*)message)->content;
     }
     return result;
 }
@@ -239,14 +797,36 @@ void Message_Destroy(MESSAGE_HANDLE message)
     else
     {
         MESSAGE_HANDLE_DATA* messageData = (MESSAGE_HANDLE_DATA*)message;
-        /*Codes_SRS_MESSAGE_17_002: [Message_Destroy shall destroy the CONSTMAP properties.]*/
-        ConstMap_Destroy(messageData->properties);
-        /*Codes_SRS_MESSAGE_17_005: [Message_Destroy shall destroy the CONSTBUFFER.]*/
-        CONSTBUFFER_Destroy(messageData->content);
         /*Codes_SRS_MESSAGE_02_020: [Otherwise, Message_Destroy shall decrement the internal ref count of the message.]*/
         if (DEC_REF(MESSAGE_HANDLE_DATA, message) == DEC_RETURN_ZERO)
         {
             /*Codes_SRS_MESSAGE_02_021: [If the ref count is zero then the allocated resources are freed.]*/
+            if (messageData->overlay == NULL)
+            {
+                /*Codes_SRS_MESSAGE_17_002: [ If the ref count is zero then Message_Destroy shall destroy the CONSTMAP properties. ]*/
+                ConstMap_Destroy(messageData->properties);
+                /*Codes_SRS_MESSAGE_17_005: [ If the ref count is zero then Message_Destroy shall destroy the CONSTBUFFER. ]*/
+                CONSTBUFFER_Destroy(messageData->content);
+            }
+            else
+            {
+                /*Codes_SRS_MESSAGE_17_039: [ If the ref count of a derived message is zero then Message_Destroy shall free the overlay and the property map built for it, and shall call Message_Destroy on the parent message. ]*/
+                if (messageData->properties != NULL)
+                {
+                    ConstMap_Destroy(messageData->properties);
+                }
+                Message_DestroyOverlay(messageData->overlay);
+            }
+            /*Codes_SRS_MESSAGE_17_019: [ If the ref count is zero then the cached serialized forms shall be freed. ]*/
+            for (size_t i = 0; i < GATEWAY_MESSAGE_VERSION_MAX; i++)
+            {
+                if (messageData->serialized[i] != NULL)
+                {
+                    free(messageData->serialized[i]);
+                }
+            }
+            /*Codes_SRS_MESSAGE_17_062: [ If the ref count is zero then Message_Destroy shall release the charge of the message. ]*/
+            ModuleMemory_Release(messageData->owner, messageData->charged);
             free(message);
         }
     }
@@ -298,23 +878,292 @@ static int parse_null_terminated_const_char(const unsigned char* source, int32_t
     return result;
 }
 
+/*this function parses the buffer pointed to by source, having size sourceSize, starting at index position for a*/
+/*varint: groups of 7 bits, least significant group first, with the high bit set on every byte but the last one*/
+/*the value has to fit in an int32_t. if the parsing succeeds then *parsed is updated to reflect how many characters*/
+/*have been consumed and *value is updated to the parsed value and the function return 0*/
+static int parse_varint(const unsigned char* source, int32_t sourceSize, int32_t position, int32_t *parsed, int32_t* value)
+{
+    int result;
+    uint64_t accumulated = 0;
+    int32_t consumed = 0;
+    bool complete = false;
+    while (
+        (!complete) &&
+        (consumed < MAX_VARINT_LENGTH) &&
+        (position + consumed < sourceSize)
+        )
+    {
+        unsigned char byte = source[position + consumed];
+        accumulated |= (uint64_t)(byte & 0x7F) << (7 * consumed);
+        consumed++;
+        complete = ((byte & 0x80) == 0);
+    }
+
+    if (!complete)
+    {
+        /*Codes_SRS_MESSAGE_02_025: [ If while parsing the message content, a read would occur past the end of the array (as indicated by size) then Message_CreateFromByteArray shall fail and return NULL. ]*/
+        LogError("unable to parse a varint because it would go past the end of the source");
+        result = __LINE__;
+    }
+    else if (accumulated > INT32_MAX)
+    {
+        LogError("varint does not fit in an int32_t");
+        result = __LINE__;
+    }
+    else
+    {
+        *parsed = consumed;
+        *value = (int32_t)accumulated;
+        result = 0;
+    }
+    return result;
+}
+
+/*copies length bytes of source starting at index position to *strings, followed by '\0'. On success *value points to*/
+/*the copy and *strings is advanced past it*/
+static int parse_length_prefixed_const_char(const unsigned char* source, int32_t sourceSize, int32_t position, int32_t length, char** strings, const char** value)
+{
+    int result;
+    if (length > sourceSize - position)
+    {
+        /*Codes_SRS_MESSAGE_02_025: [ If while parsing the message content, a read would occur past the end of the array (as indicated by size) then Message_CreateFromByteArray shall fail and return NULL. ]*/
+        LogError("unable to parse a string of %" PRId32 " bytes because it would go past the end of the source", length);
+        result = __LINE__;
+    }
+    else
+    {
+        memcpy(*strings, source + position, length);
+        (*strings)[length] = '\0';
+        *value = *strings;
+        *strings += length + 1;
+        result = 0;
+    }
+    return result;
+}
+
+static size_t varint_size(size_t value)
+{
+    size_t result = 1;
+    while (value >= 0x80)
+    {
+        value >>= 7;
+        result++;
+    }
+    return result;
+}
+
+/*writes value as a varint at buf + position and returns the position of the byte after it*/
+static size_t write_varint(unsigned char* buf, size_t position, size_t value)
+{
+    while (value >= 0x80)
+    {
+        buf[position++] = (unsigned char)((value & 0x7F) | 0x80);
+        value >>= 7;
+    }
+    buf[position++] = (unsigned char)value;
+    return position;
+}
+
+/*returns the index of key in MESSAGE_KEY_DICTIONARY, or MESSAGE_KEY_DICTIONARY_SIZE when key is not in there*/
+static size_t Message_FindDictionaryKey(const char* key)
+{
+    size_t result;
+    for (result = 0; result < MESSAGE_KEY_DICTIONARY_SIZE; result++)
+    {
+        if (strcmp(MESSAGE_KEY_DICTIONARY[result], key) == 0)
+        {
+            break;
+        }
+    }
+    return result;
+}
+
+/*version 2 content of at least CONTENT_ALIGNMENT_V2 bytes starts at an offset that is a multiple of CONTENT_ALIGNMENT_V2*/
+static size_t Message_Version2ContentOffset(size_t position, size_t contentSize)
+{
+    return (contentSize >= CONTENT_ALIGNMENT_V2) ?
+        ((position + CONTENT_ALIGNMENT_V2 - 1) & ~(size_t)(CONTENT_ALIGNMENT_V2 - 1)) :
+        position;
+}
+
+/*parses a version 2 serialization. The caller has already checked the header*/
+static MESSAGE_HANDLE_DATA* Message_CreateFromByteArrayV2(const unsigned char* source, int32_t size)
+{
+    MESSAGE_HANDLE_DATA* result;
+    int32_t currentPosition = 2; /*current position is always the first character that "we are about to look at"*/
+    int32_t parsed; /*reused in all parsings*/
+    int32_t propertiesCount;
+    if (parse_varint(source, size, currentPosition, &parsed, &propertiesCount) != 0)
+    {
+        LogError("unable to parse the number of properties");
+        result = NULL;
+    }
+    else if (propertiesCount > (size - currentPosition - parsed) / 2) /*every property takes at least 2 bytes*/
+    {
+        /*Codes_SRS_MESSAGE_02_030: [ If any of the above steps fails, then Message_CreateFromByteArray shall fail and return NULL. ]*/
+        LogError("invalid message detected with wrong number of properties =%" PRId32, propertiesCount);
+        result = NULL;
+    }
+    else
+    {
+        currentPosition += parsed;
+        /*Codes_SRS_MESSAGE_02_026: [ A MAP_HANDLE shall be created. ]*/
+        MAP_HANDLE configMap = Map_Create(NULL);
+        if (configMap == NULL)
+        {
+            /*Codes_SRS_MESSAGE_02_030: [ If any of the above steps fails, then Message_CreateFromByteArray shall fail and return NULL. ]*/
+            LogError("failed to create a MAP_HANDLE");
+            result = NULL;
+        }
+        else
+        {
+            /*keys and values are not null terminated in a version 2 serialization, so they are copied here. They*/
+            /*cannot take more than what is left of source plus one terminator each*/
+            char* strings = NULL;
+            if (
+                (propertiesCount > 0) &&
+                ((strings = (char*)malloc((size_t)(size - currentPosition) + 2 * (size_t)propertiesCount)) == NULL)
+                )
+            {
+                /*Codes_SRS_MESSAGE_02_030: [ If any of the above steps fails, then Message_CreateFromByteArray shall fail and return NULL. ]*/
+                LogError("unable to allocate memory for the properties");
+                result = NULL;
+            }
+            else
+            {
+                char* nextString = strings;
+                int32_t i;
+                for (i = 0; i < propertiesCount; i++)
+                {
+                    int32_t keyTag;
+                    const char* keyName;
+                    const char* keyValue;
+                    int32_t valueLength;
+                    if (parse_varint(source, size, currentPosition, &parsed, &keyTag) != 0)
+                    {
+                        LogError("unable to parse the name of the property");
+                        break;
+                    }
+                    currentPosition += parsed;
+
+                    if ((keyTag & 1) != 0)
+                    {
+                        if ((size_t)(keyTag >> 1) >= MESSAGE_KEY_DICTIONARY_SIZE)
+                        {
+                            /*Codes_SRS_MESSAGE_17_047: [ If a version 2 serialization names a property by an index that is not in the key dictionary then Message_CreateFromByteArray shall fail and return NULL. ]*/
+                            LogError("unknown key dictionary index %" PRId32, keyTag >> 1);
+                            break;
+                        }
+                        keyName = MESSAGE_KEY_DICTIONARY[keyTag >> 1];
+                    }
+                    else if (parse_length_prefixed_const_char(source, size, currentPosition, keyTag >> 1, &nextString, &keyName) != 0)
+                    {
+                        LogError("unable to parse the name string of the property");
+                        break;
+                    }
+                    else
+                    {
+                        currentPosition += keyTag >> 1;
+                    }
+
+                    if (parse_varint(source, size, currentPosition, &parsed, &valueLength) != 0)
+                    {
+                        LogError("unable to parse the value of the property");
+                        break;
+                    }
+                    currentPosition += parsed;
+
+                    if (parse_length_prefixed_const_char(source, size, currentPosition, valueLength, &nextString, &keyValue) != 0)
+                    {
+                        LogError("unable to parse the value string of the property");
+                        break;
+                    }
+                    currentPosition += valueLength;
+
+                    /*Codes_SRS_MESSAGE_02_027: [ All the properties of the byte array shall be added to the MAP_HANDLE. ]*/
+                    if (Map_Add(configMap, keyName, keyValue) != MAP_OK)
+                    {
+                        LogError("Map_Add failed");
+                        break;
+                    }
+                }
+
+                int32_t messageContentSize;
+                if (i != propertiesCount)
+                {
+                    result = NULL;
+                }
+                else if (parse_varint(source, size, currentPosition, &parsed, &messageContentSize) != 0)
+                {
+                    LogError("no space to read the number of bytes making the message");
+                    result = NULL;
+                }
+                else
+                {
+                    size_t contentOffset = Message_Version2ContentOffset((size_t)(currentPosition + parsed), (size_t)messageContentSize);
+                    if (
+                        (contentOffset > (size_t)size) ||
+                        ((size_t)messageContentSize != (size_t)size - contentOffset)
+                        )
+                    {
+                        /*Codes_SRS_MESSAGE_17_048: [ If the content of a version 2 serialization does not end exactly at the end of the array then Message_CreateFromByteArray shall fail and return NULL. ]*/
+                        LogError("the message content doesn't add up to the message size %" PRId32, size);
+                        result = NULL;
+                    }
+                    else
+                    {
+                        /*Codes_SRS_MESSAGE_02_028: [ A structure of type MESSAGE_CONFIG shall be populated with the MAP_HANDLE previously constructed and the message content ]*/
+                        MESSAGE_CONFIG msgConfig = { (size_t)messageContentSize, source + contentOffset, configMap };
+
+                        /*Codes_SRS_MESSAGE_02_029: [ A MESSAGE_HANDLE shall be constructed from the MESSAGE_CONFIG. ]*/
+                        /*Codes_SRS_MESSAGE_02_031: [ Otherwise Message_CreateFromByteArray shall succeed and return a non-NULL handle. ]*/
+                        result = Message_CreateImpl(&msgConfig);
+                    }
+                }
+
+                if (strings != NULL)
+                {
+                    free(strings);
+                }
+            }
+            Map_Destroy(configMap);
+        }
+    }
+    return result;
+}
+
 /*creates a MESSAGE_HANDLE from a serialized byte array*/
 MESSAGE_HANDLE Message_CreateFromByteArray(const unsigned char* source, int32_t size)
 {
     MESSAGE_HANDLE_DATA* result;
+    GATEWAY_TRACE_BEGIN("Message_CreateFromByteArray", size);
     /*Codes_SRS_MESSAGE_02_022: [ If source is NULL then Message_CreateFromByteArray shall fail and return NULL. ]*/
-    /*Codes_SRS_MESSAGE_02_023: [ If source is not NULL and and size parameter is smaller than 14 then Message_CreateFromByteArray shall fail and return NULL. ]*/
+    /*Codes_SRS_MESSAGE_02_023: [ If source is not NULL and and size parameter is smaller than 4, or source is a version 1 serialization and size parameter is smaller than 14, then Message_CreateFromByteArray shall fail and return NULL. ]*/
     if (
         (source == NULL) ||
-        (size < MIN_MESSAGE_BUFFER_LENGTH)
+        (size < MIN_MESSAGE_BUFFER_LENGTH_V2)
+        )
+    {
+        LogError("invalid parameter source=[%p] size=%" PRId32, source, size);
+        result = NULL;
+    }
+    else if (
+        (source[0] == FIRST_MESSAGE_BYTE) &&
+        (source[1] == SECOND_MESSAGE_BYTE_V2)
         )
+    {
+        /*Codes_SRS_MESSAGE_17_046: [ If the first two bytes of source are 0xA1 0x62 then Message_CreateFromByteArray shall parse source as a version 2 serialization. ]*/
+        result = Message_CreateFromByteArrayV2(source, size);
+    }
+    else if (size < MIN_MESSAGE_BUFFER_LENGTH)
     {
         LogError("invalid parameter source=[%p] size=%" PRId32, source, size);
         result = NULL;
     }
     else
     {
-        /*Codes_SRS_MESSAGE_02_024: [ If the first two bytes of source are not 0xA1 0x60 then Message_CreateFromByteArray shall fail and return NULL. ]*/
+        /*Codes_SRS_MESSAGE_02_024: [ If the first two bytes of source are neither 0xA1 0x60 nor 0xA1 0x62 then Message_CreateFromByteArray shall fail and return NULL. ]*/
         if (
             (source[0] != FIRST_MESSAGE_BYTE) ||
             (source[1] != SECOND_MESSAGE_BYTE)
@@ -456,11 +1305,185 @@ MESSAGE_HANDLE Message_CreateFromByteArray(const unsigned char* source, int32_t
 			}
         }
     }
+    GATEWAY_TRACE_END("Message_CreateFromByteArray");
     return (MESSAGE_HANDLE)result;
 
 }
 
-extern int32_t Message_ToByteArray(MESSAGE_HANDLE messageHandle, unsigned char* buf, int32_t size)
+/*serializes a message whose arguments have already been validated*/
+static int32_t Message_Serialize(MESSAGE_HANDLE_DATA* messageHandleData, uint8_t version, unsigned char* buf, int32_t size)
+{
+    int32_t result;
+    size_t byteArraySize;
+    const char* const * keys;
+    const char* const * values;
+    size_t nProperties;
+    void* propertiesStorage;
+
+    /*Codes_SRS_MESSAGE_17_042: [ For a derived message, Message_ToByteArray shall serialize the properties of the parent message that are neither overridden nor removed, followed by the overrides. ]*/
+    /*Codes_SRS_MESSAGE_02_035: [ If any of the above steps fails then Message_ToByteArray shall fail and return -1. ]*/
+    if (Message_GetPropertyArrays(messageHandleData, &keys, &values, &nProperties, &propertiesStorage) != 0)
+    {
+        LogError("failed to get the keys and values from the message properties");
+        result = -1;
+    }
+    else
+    {
+        size_t i;
+        const CONSTBUFFER* messageContent = CONSTBUFFER_GetContent(messageHandleData->content);
+
+        /*Codes_SRS_MESSAGE_02_033: [Message_ToByteArray shall precompute the needed memory size.]*/
+        if (version == GATEWAY_MESSAGE_VERSION_1)
+        {
+            byteArraySize =
+                + 2 /*header*/
+                + 4 /*total size of byte array*/
+                + 4 /*total number of properties*/
+                + 0 /*an unknown at this moment number of bytes for properties*/
+                + 4 /*number of bytes in messageContent*/
+                + 0 /*an unknown at this moment number of bytes for message content*/
+                ;
+            for (i = 0;i < nProperties;i++)
+            {
+                /*add to the needed size the name and value of property i*/
+                byteArraySize += (strlen(keys[i]) + 1) + (strlen(values[i]) + 1);
+            }
+            byteArraySize += messageContent->size;
+        }
+        else
+        {
+            byteArraySize = 2 /*header*/ + varint_size(nProperties);
+            for (i = 0;i < nProperties;i++)
+            {
+                size_t keyIndex = Message_FindDictionaryKey(keys[i]);
+                size_t valueLength = strlen(values[i]);
+                if (keyIndex < MESSAGE_KEY_DICTIONARY_SIZE)
+                {
+                    byteArraySize += varint_size((keyIndex << 1) | 1);
+                }
+                else
+                {
+                    size_t keyLength = strlen(keys[i]);
+                    byteArraySize += varint_size(keyLength << 1) + keyLength;
+                }
+                byteArraySize += varint_size(valueLength) + valueLength;
+            }
+            byteArraySize += varint_size(messageContent->size);
+            byteArraySize = Message_Version2ContentOffset(byteArraySize, messageContent->size) + messageContent->size;
+        }
+
+        if (byteArraySize > INT32_MAX)
+        {
+            /*Codes_SRS_MESSAGE_02_035: [ If any of the above steps fails then Message_ToByteArray shall fail and return -1. ]*/
+            LogError("message is too big to be serialized");
+            result = -1;
+        }
+        else if (size == 0)
+        {
+            /*Codes_SRS_MESSAGE_17_016: [ If buf is NULL and size is equal to zero, Message_ToByteArray shall return the needed memory size. ]*/
+            result = (int32_t)byteArraySize;
+        }
+        else if (byteArraySize > (size_t)size)
+        {
+            /*Codes_SRS_MESSAGE_17_017: [ If buf is not NULL and size is less than the needed memory size, Message_ToByteArray shall return -1; ]*/
+            LogError("message is %u bytes, won't fit in buffer of %u bytes", byteArraySize, size);
+            result = -1;
+        }
+        else if (version == GATEWAY_MESSAGE_VERSION_1)
+        {
+            /*Codes_SRS_MESSAGE_02_034: [ Message_ToByteArray shall populate the memory with values as indicated in the implementation details. ]*/
+
+            size_t currentPosition; /*always points to the byte we are about to write*/
+            /*a header formed of the following hex characters in this order: 0xA1 0x60*/
+            buf[0] = FIRST_MESSAGE_BYTE;
+            buf[1] = SECOND_MESSAGE_BYTE;
+            /*4 bytes in MSB order representing the total size of the byte array. */
+            buf[2] = byteArraySize >> 24;
+            buf[3] = (byteArraySize >> 16) & 0xFF;
+            buf[4] = (byteArraySize >> 8) & 0xFF;
+            buf[5] = (byteArraySize) & 0xFF;
+            /*4 bytes in MSB order representing the number of properties*/
+            buf[6] = nProperties >> 24;
+            buf[7] = (nProperties >> 16) & 0xFF;
+            buf[8] = (nProperties >> 8) & 0xFF;
+            buf[9] = nProperties & 0xFF;
+            /*for every property, 2 arrays of null terminated characters representing the name of the property and the value.*/
+				currentPosition = 10;
+            for (i = 0;i < nProperties;i++)
+            {
+                size_t nameLength = strlen(keys[i]) + 1;/*the +1 will take care of copying '\0' too*/
+                size_t valueLength = strlen(values[i]) + 1;/*the +1 will take care of copying '\0' too*/
+
+                /*copy name*/
+                memcpy(buf + currentPosition, keys[i], nameLength);
+                currentPosition += nameLength;
+                
+                /*copy value*/
+                memcpy(buf + currentPosition, values[i], valueLength);
+                currentPosition += valueLength;
+            }
+
+            /*4 bytes in MSB order representing the number of bytes in the message content array*/
+            buf[currentPosition++] = (messageContent->size) >> 24;
+            buf[currentPosition++] = ((messageContent->size) >> 16) & 0xFF;
+            buf[currentPosition++] = ((messageContent->size) >> 8) & 0xFF;
+            buf[currentPosition++] = (messageContent->size) & 0xFF;
+
+            /*n bytes of message content follows.*/
+            memcpy(buf + currentPosition, messageContent->buffer, messageContent->size);
+
+            /*Codes_SRS_MESSAGE_02_036: [ Otherwise Message_ToByteArray shall succeed, and return the byte array size. ]*/
+            result = (int32_t)byteArraySize;
+        }
+        else
+        {
+            /*Codes_SRS_MESSAGE_17_045: [ For version 2, Message_ToByteArrayWithVersion shall populate the memory with values as indicated in the version 2 implementation details. ]*/
+            size_t currentPosition; /*always points to the byte we are about to write*/
+            size_t contentOffset;
+            /*a header formed of the following hex characters in this order: 0xA1 0x62*/
+            buf[0] = FIRST_MESSAGE_BYTE;
+            buf[1] = SECOND_MESSAGE_BYTE_V2;
+            currentPosition = write_varint(buf, 2, nProperties);
+            for (i = 0;i < nProperties;i++)
+            {
+                size_t keyIndex = Message_FindDictionaryKey(keys[i]);
+                size_t valueLength = strlen(values[i]);
+                if (keyIndex < MESSAGE_KEY_DICTIONARY_SIZE)
+                {
+                    /*odd tags are indexes in the key dictionary*/
+                    currentPosition = write_varint(buf, currentPosition, (keyIndex << 1) | 1);
+                }
+                else
+                {
+                    /*even tags are the length of the key that follows*/
+                    size_t keyLength = strlen(keys[i]);
+                    currentPosition = write_varint(buf, currentPosition, keyLength << 1);
+                    memcpy(buf + currentPosition, keys[i], keyLength);
+                    currentPosition += keyLength;
+                }
+                currentPosition = write_varint(buf, currentPosition, valueLength);
+                memcpy(buf + currentPosition, values[i], valueLength);
+                currentPosition += valueLength;
+            }
+
+            currentPosition = write_varint(buf, currentPosition, messageContent->size);
+            contentOffset = Message_Version2ContentOffset(currentPosition, messageContent->size);
+            memset(buf + currentPosition, 0, contentOffset - currentPosition);
+            memcpy(buf + contentOffset, messageContent->buffer, messageContent->size);
+
+            /*Codes_SRS_MESSAGE_02_036: [ Otherwise Message_ToByteArray shall succeed, and return the byte array size. ]*/
+            result = (int32_t)byteArraySize;
+        }
+
+        if (propertiesStorage != NULL)
+        {
+            free(propertiesStorage);
+        }
+    }
+    return result;
+}
+
+int32_t Message_ToByteArrayWithVersion(MESSAGE_HANDLE messageHandle, uint8_t version, unsigned char* buf, int32_t size)
 {
     int32_t result;
     if (messageHandle == NULL) 
@@ -478,100 +1501,124 @@ extern int32_t Message_ToByteArray(MESSAGE_HANDLE messageHandle, unsigned char*
         LogError("Null buffer sent with a specific size buffer=[%p], size=[%d]", messageHandle, size);
         result = -1;
     }
+    else if (
+        (version < GATEWAY_MESSAGE_VERSION_1) ||
+        (version > GATEWAY_MESSAGE_VERSION_MAX)
+        )
+    {
+        /*Codes_SRS_MESSAGE_17_043: [ If version is not a supported serialization version then Message_ToByteArrayWithVersion shall fail and return -1. ]*/
+        LogError("unsupported serialization version %d", (int)version);
+        result = -1;
+    }
     else
     {
-        MESSAGE_HANDLE_DATA* messageHandleData = (MESSAGE_HANDLE_DATA*)messageHandle;
+        result = Message_Serialize((MESSAGE_HANDLE_DATA*)messageHandle, version, buf, size);
+    }
+    return result;
+}
 
-        /*Codes_SRS_MESSAGE_02_033: [Message_ToByteArray shall precompute the needed memory size.]*/
-        size_t byteArraySize =
-            + 2 /*header*/
-            + 4 /*total size of byte array*/
-            + 4 /*total number of properties*/
-            + 0 /*an unknown at this moment number of bytes for properties*/
-            + 4 /*number of bytes in messageContent*/
-            + 0 /*an unknown at this moment number of bytes for message content*/
-            ;
-        
-        const char* const * keys;
-        const char* const * values;
-        size_t nProperties;
-
-        /*Codes_SRS_MESSAGE_02_035: [ If any of the above steps fails then Message_ToByteArray shall fail and return -1. ]*/
-        if (ConstMap_GetInternals(messageHandleData->properties, &keys, &values, &nProperties) != CONSTMAP_OK)
+int32_t Message_ToByteArray(MESSAGE_HANDLE messageHandle, unsigned char* buf, int32_t size)
+{
+    /*Codes_SRS_MESSAGE_17_044: [ Message_ToByteArray shall behave as Message_ToByteArrayWithVersion with version GATEWAY_MESSAGE_VERSION_1. ]*/
+    return Message_ToByteArrayWithVersion(messageHandle, GATEWAY_MESSAGE_VERSION_1, buf, size);
+}
+
+/*returns the cached serialization of a message, computing and caching it first if needed*/
+static MESSAGE_SERIALIZATION* Message_GetCachedSerialization(MESSAGE_HANDLE_DATA* messageData, uint8_t version)
+{
+    MESSAGE_SERIALIZATION* result;
+    MESSAGE_SERIALIZATION* volatile* cached = &messageData->serialized[version - GATEWAY_MESSAGE_VERSION_1];
+    result = GATEWAY_ATOMIC_LOAD_POINTER(cached);
+    if (result != NULL)
+    {
+        /*Codes_SRS_MESSAGE_17_021: [ If the message has already been serialized with version, Message_GetSerialized shall return the cached serialization without serializing the message again. Every version is cached separately. ]*/
+    }
+    else
+    {
+        /*Codes_SRS_MESSAGE_17_022: [ Message_GetSerialized shall compute the serialization size by calling Message_ToByteArray with a NULL buffer. ]*/
+        int32_t needed = Message_Serialize(messageData, version, NULL, 0);
+        if (needed < 0)
         {
-            LogError("failed to get the keys and values from the message properties");
-            result = -1;
+            /*Codes_SRS_MESSAGE_17_025: [ If any of the above steps fails then Message_GetSerialized shall fail and return a non-zero value. ]*/
+            LogError("unable to compute the serialization size of message [%p]", messageData);
         }
         else
         {
-            size_t i;
-            for (i = 0;i < nProperties;i++)
-            {
-                /*add to the needed size the name and value of property i*/
-                byteArraySize += (strlen(keys[i]) + 1) + (strlen(values[i]) + 1);
-            }
-
-            const CONSTBUFFER* messageContent = CONSTBUFFER_GetContent(messageHandleData->content);
-            byteArraySize += messageContent->size;
-            
-            if (size == 0)
+            /*Codes_SRS_MESSAGE_17_023: [ Message_GetSerialized shall allocate memory for the serialization and serialize the message by calling Message_ToByteArray. ]*/
+            MESSAGE_SERIALIZATION* candidate = (MESSAGE_SERIALIZATION*)malloc(sizeof(MESSAGE_SERIALIZATION) + needed);
+            if (candidate == NULL)
             {
-                /*Codes_SRS_MESSAGE_17_016: [ If buf is NULL and size is equal to zero, Message_ToByteArray shall return the needed memory size. ]*/
-                result = byteArraySize;
+                /*Codes_SRS_MESSAGE_17_025: [ If any of the above steps fails then Message_GetSerialized shall fail and return a non-zero value. ]*/
+                LogError("unable to allocate %" PRId32 " bytes for the serialized message", needed);
             }
-            else if (byteArraySize > (size_t)size)
+            else if (Message_Serialize(messageData, version, (unsigned char*)(candidate + 1), needed) != needed)
             {
-                /*Codes_SRS_MESSAGE_17_017: [ If buf is not NULL and size is less than the needed memory size, Message_ToByteArray shall return -1; ]*/
-                LogError("message is %u bytes, won't fit in buffer of %u bytes", byteArraySize, size);
-                result = -1;
+                /*Codes_SRS_MESSAGE_17_025: [ If any of the above steps fails then Message_GetSerialized shall fail and return a non-zero value. ]*/
+                LogError("unable to serialize message [%p]", messageData);
+                free(candidate);
             }
             else
             {
-                /*Codes_SRS_MESSAGE_02_034: [ Message_ToByteArray shall populate the memory with values as indicated in the implementation details. ]*/
-
-                size_t currentPosition; /*always points to the byte we are about to write*/
-                /*a header formed of the following hex characters in this order: 0xA1 0x60*/
-                buf[0] = FIRST_MESSAGE_BYTE;
-                buf[1] = SECOND_MESSAGE_BYTE;
-                /*4 bytes in MSB order representing the total size of the byte array. */
-                buf[2] = byteArraySize >> 24;
-                buf[3] = (byteArraySize >> 16) & 0xFF;
-                buf[4] = (byteArraySize >> 8) & 0xFF;
-                buf[5] = (byteArraySize) & 0xFF;
-                /*4 bytes in MSB order representing the number of properties*/
-                buf[6] = nProperties >> 24;
-                buf[7] = (nProperties >> 16) & 0xFF;
-                buf[8] = (nProperties >> 8) & 0xFF;
-                buf[9] = nProperties & 0xFF;
-                /*for every property, 2 arrays of null terminated characters representing the name of the property and the value.*/
-				currentPosition = 10;
-                for (i = 0;i < nProperties;i++)
+                candidate->size = needed;
+                /*Codes_SRS_MESSAGE_17_024: [ Message_GetSerialized shall publish the serialization atomically; if another thread published a serialization first, the new serialization shall be freed and the existing one returned. ]*/
+                result = GATEWAY_ATOMIC_CAS_POINTER(cached, NULL, candidate);
+                if (result != NULL)
                 {
-                    size_t nameLength = strlen(keys[i]) + 1;/*the +1 will take care of copying '\0' too*/
-                    size_t valueLength = strlen(values[i]) + 1;/*the +1 will take care of copying '\0' too*/
-
-                    /*copy name*/
-                    memcpy(buf + currentPosition, keys[i], nameLength);
-                    currentPosition += nameLength;
-                    
-                    /*copy value*/
-                    memcpy(buf + currentPosition, values[i], valueLength);
-                    currentPosition += valueLength;
+                    free(candidate);
+                }
+                else
+                {
+                    result = candidate;
                 }
-
-                /*4 bytes in MSB order representing the number of bytes in the message content array*/
-                buf[currentPosition++] = (messageContent->size) >> 24;
-                buf[currentPosition++] = ((messageContent->size) >> 16) & 0xFF;
-                buf[currentPosition++] = ((messageContent->size) >> 8) & 0xFF;
-                buf[currentPosition++] = (messageContent->size) & 0xFF;
-
-                /*n bytes of message content follows.*/
-                memcpy(buf + currentPosition, messageContent->buffer, messageContent->size);
-
-                /*Codes_SRS_MESSAGE_02_036: [ Otherwise Message_ToByteArray shall succeed, and return the byte array size. ]*/
-                result = byteArraySize;
             }
         }
     }
     return result;
-}
\ No newline at end of file
+}
+
+int Message_GetSerializedWithVersion(MESSAGE_HANDLE message, uint8_t version, const unsigned char** buffer, int32_t* size)
+{
+    int result;
+    if (
+        (message == NULL) ||
+        (buffer == NULL) ||
+        (size == NULL)
+        )
+    {
+        /*Codes_SRS_MESSAGE_17_020: [ If message, buffer or size is NULL then Message_GetSerialized shall fail and return a non-zero value. ]*/
+        LogError("invalid parameter message=[%p] buffer=[%p] size=[%p]", message, buffer, size);
+        result = __LINE__;
+    }
+    else if (
+        (version < GATEWAY_MESSAGE_VERSION_1) ||
+        (version > GATEWAY_MESSAGE_VERSION_MAX)
+        )
+    {
+        /*Codes_SRS_MESSAGE_17_049: [ If version is not a supported serialization version then Message_GetSerializedWithVersion shall fail and return a non-zero value. ]*/
+        LogError("unsupported serialization version %d", (int)version);
+        result = __LINE__;
+    }
+    else
+    {
+        MESSAGE_SERIALIZATION* serialization = Message_GetCachedSerialization((MESSAGE_HANDLE_DATA*)message, version);
+        if (serialization == NULL)
+        {
+            /*Codes_SRS_MESSAGE_17_025: [ If any of the above steps fails then Message_GetSerialized shall fail and return a non-zero value. ]*/
+            result = __LINE__;
+        }
+        else
+        {
+            /*Codes_SRS_MESSAGE_17_026: [ On success, Message_GetSerialized shall set *buffer and *size to the serialized message and return 0. ]*/
+            *buffer = (const unsigned char*)(serialization + 1);
+            *size = serialization->size;
+            result = 0;
+        }
+    }
+    return result;
+}
+
+int Message_GetSerialized(MESSAGE_HANDLE message, const unsigned char** buffer, int32_t* size)
+{
+    /*Codes_SRS_MESSAGE_17_050: [ Message_GetSerialized shall behave as Message_GetSerializedWithVersion with version GATEWAY_MESSAGE_VERSION_1. ]*/
+    return Message_GetSerializedWithVersion(message, GATEWAY_MESSAGE_VERSION_1, buffer, size);
+}
@@ -5,10 +5,13 @@
 #include "azure_c_shared_utility/gballoc.h"
 #include "azure_c_shared_utility/vector.h"
 #include "azure_c_shared_utility/xlogging.h"
+#include "azure_c_shared_utility/lock.h"
+#include "azure_c_shared_utility/condition.h"
 
 #include "azure_c_shared_utility/doublylinkedlist.h"
 #include "message.h"
 #include "message_queue.h"
+#include "internal/gateway_atomic.h"
 
 typedef struct MESSAGE_QUEUE_STORAGE_TAG
 {
@@ -16,15 +19,142 @@ typedef struct MESSAGE_QUEUE_STORAGE_TAG
     MESSAGE_HANDLE message;
 } MESSAGE_QUEUE_STORAGE;
 
+/*a slot of a bounded queue. sequence tells who owns the slot: it equals the position of the next push that*/
+/*may fill the slot, position + 1 once that push has published its message, and position + capacity once*/
+/*the consumer has emptied the slot again*/
+typedef struct MESSAGE_QUEUE_CELL_TAG
+{
+    volatile size_t sequence;
+    MESSAGE_HANDLE message;
+} MESSAGE_QUEUE_CELL;
+
 typedef struct MESSAGE_QUEUE_TAG
 {
     MESSAGE_QUEUE_STORAGE queue_head;
+    /*the fields below are only used by bounded queues, which have cells != NULL*/
+    MESSAGE_QUEUE_CELL* cells;
+    size_t mask;
+    volatile size_t enqueue_position;
+    size_t dequeue_position; /*only the consumer touches this*/
+    volatile size_t consumer_waiting;
+    LOCK_HANDLE wait_lock;
+    COND_HANDLE wait_condition;
 } MESSAGE_QUEUE_HANDLE_DATA;
 
+/*claims count consecutive positions with a single compare-and-swap. The consumer empties slots in order, so*/
+/*if the slot of the last position is free then so are all the slots before it*/
+static int bounded_claim(MESSAGE_QUEUE_HANDLE_DATA* handle, size_t count, size_t* first)
+{
+    int result;
+    size_t position = GATEWAY_ATOMIC_LOAD_SIZE(&handle->enqueue_position);
+    for (;;)
+    {
+        size_t last = position + count - 1;
+        MESSAGE_QUEUE_CELL* cell = &handle->cells[last & handle->mask];
+        size_t sequence = GATEWAY_ATOMIC_LOAD_SIZE(&cell->sequence);
+        if (sequence == last)
+        {
+            /*the slots are free, try to claim them against the other producers*/
+            size_t observed = GATEWAY_ATOMIC_CAS_SIZE(&handle->enqueue_position, position, position + count);
+            if (observed == position)
+            {
+                *first = position;
+                result = 0;
+                break;
+            }
+            else
+            {
+                position = observed;
+            }
+        }
+        else if ((ptrdiff_t)(sequence - last) < 0)
+        {
+            result = MESSAGE_QUEUE_FULL;
+            break;
+        }
+        else
+        {
+            /*another producer claimed these positions first*/
+            position = GATEWAY_ATOMIC_LOAD_SIZE(&handle->enqueue_position);
+        }
+    }
+    return result;
+}
+
+static int bounded_push_many(MESSAGE_QUEUE_HANDLE_DATA* handle, MESSAGE_HANDLE* elements, size_t count)
+{
+    int result;
+    size_t first;
+    if (count > handle->mask + 1 || bounded_claim(handle, count, &first) != 0)
+    {
+        /*Codes_SRS_MESSAGE_QUEUE_17_028: [ If a bounded message queue already holds capacity messages, MESSAGE_QUEUE_push shall return MESSAGE_QUEUE_FULL without taking ownership of element. ]*/
+        /*Codes_SRS_MESSAGE_QUEUE_17_038: [ If a bounded message queue does not have count free slots, MESSAGE_QUEUE_push_many shall return MESSAGE_QUEUE_FULL without taking ownership of any element. ]*/
+        result = MESSAGE_QUEUE_FULL;
+    }
+    else
+    {
+        size_t i;
+        for (i = 0; i < count; i++)
+        {
+            MESSAGE_QUEUE_CELL* cell = &handle->cells[(first + i) & handle->mask];
+            cell->message = elements[i];
+            GATEWAY_ATOMIC_STORE_SIZE(&cell->sequence, first + i + 1);
+        }
+
+        /*Codes_SRS_MESSAGE_QUEUE_17_029: [ If the consumer of a bounded message queue is waiting in MESSAGE_QUEUE_pop_wait, MESSAGE_QUEUE_push shall wake it up. ]*/
+        /*Codes_SRS_MESSAGE_QUEUE_17_039: [ If the consumer of a bounded message queue is waiting in MESSAGE_QUEUE_pop_wait, MESSAGE_QUEUE_push_many shall wake it up once. ]*/
+        /*publishing the messages above and reading the flag here pair with the consumer setting the flag and*/
+        /*then looking at the queue again, so at least one side sees the other*/
+        if (GATEWAY_ATOMIC_LOAD_SIZE(&handle->consumer_waiting) != 0)
+        {
+            if (Lock(handle->wait_lock) != LOCK_OK)
+            {
+                LogError("unable to lock the message queue to wake its consumer");
+            }
+            else
+            {
+                (void)Condition_Post(handle->wait_condition);
+                (void)Unlock(handle->wait_lock);
+            }
+        }
+        result = 0;
+    }
+    return result;
+}
+
+static MESSAGE_QUEUE_CELL* bounded_front(MESSAGE_QUEUE_HANDLE_DATA* handle)
+{
+    MESSAGE_QUEUE_CELL* cell = &handle->cells[handle->dequeue_position & handle->mask];
+    return (GATEWAY_ATOMIC_LOAD_SIZE(&cell->sequence) == handle->dequeue_position + 1) ? cell : NULL;
+}
+
+static MESSAGE_HANDLE bounded_pop(MESSAGE_QUEUE_HANDLE_DATA* handle)
+{
+    MESSAGE_HANDLE result;
+    MESSAGE_QUEUE_CELL* cell = bounded_front(handle);
+    if (cell == NULL)
+    {
+        result = NULL;
+    }
+    else
+    {
+        result = cell->message;
+        cell->message = NULL;
+        /*hand the slot back to the producers for the push one lap later*/
+        GATEWAY_ATOMIC_STORE_SIZE(&cell->sequence, handle->dequeue_position + handle->mask + 1);
+        handle->dequeue_position++;
+    }
+    return result;
+}
+
 static MESSAGE_HANDLE message_pop(MESSAGE_QUEUE_HANDLE_DATA* handle)
 {
     MESSAGE_HANDLE result;
-	if (DList_IsListEmpty((PDLIST_ENTRY)&(handle->queue_head)))
+    if (handle->cells != NULL)
+    {
+        result = bounded_pop(handle);
+    }
+	else if (DList_IsListEmpty((PDLIST_ENTRY)&(handle->queue_head)))
 	{
         /*Codes_SRS_MESSAGE_QUEUE_17_013: [ MESSAGE_QUEUE_pop shall return NULL on an empty message queue. ]*/
 		result = NULL;
@@ -59,6 +189,90 @@ MESSAGE_QUEUE_HANDLE MESSAGE_QUEUE_create()
         /*Codes_SRS_MESSAGE_QUEUE_17_002: [ A newly created message queue shall be empty. ]*/
         DList_InitializeListHead((PDLIST_ENTRY)&(result->queue_head));
         result->queue_head.message = NULL;
+        result->cells = NULL;
+        result->wait_lock = NULL;
+        result->wait_condition = NULL;
+    }
+    return result;
+}
+
+MESSAGE_QUEUE_HANDLE MESSAGE_QUEUE_create_bounded(size_t capacity)
+{
+    MESSAGE_QUEUE_HANDLE_DATA* result;
+    /*a single slot would be published with the position of the next push and be overwritten before it is popped*/
+    size_t rounded = 2;
+    while (rounded < capacity && rounded <= (((size_t)-1) >> 2))
+    {
+        rounded <<= 1;
+    }
+
+    if (capacity == 0 || rounded < capacity)
+    {
+        /*Codes_SRS_MESSAGE_QUEUE_17_023: [ If capacity is zero or too large to be rounded up to a power of two, MESSAGE_QUEUE_create_bounded shall fail and return NULL. ]*/
+        LogError("invalid capacity %zu.", capacity);
+        result = NULL;
+    }
+    else
+    {
+        result = (MESSAGE_QUEUE_HANDLE_DATA*)malloc(sizeof(MESSAGE_QUEUE_HANDLE_DATA));
+        if (result == NULL)
+        {
+            /*Codes_SRS_MESSAGE_QUEUE_17_026: [ If any of the above steps fails, MESSAGE_QUEUE_create_bounded shall free all allocated resources and return NULL. ]*/
+            LogError("malloc failed.");
+        }
+        else
+        {
+            /*Codes_SRS_MESSAGE_QUEUE_17_024: [ MESSAGE_QUEUE_create_bounded shall allocate all the slots of the queue up front, rounding capacity up to a power of two of at least 2. ]*/
+            result->cells = (MESSAGE_QUEUE_CELL*)malloc(rounded * sizeof(MESSAGE_QUEUE_CELL));
+            if (result->cells == NULL)
+            {
+                /*Codes_SRS_MESSAGE_QUEUE_17_026: [ If any of the above steps fails, MESSAGE_QUEUE_create_bounded shall free all allocated resources and return NULL. ]*/
+                LogError("unable to allocate %zu message queue slots.", rounded);
+                free(result);
+                result = NULL;
+            }
+            else
+            {
+                /*Codes_SRS_MESSAGE_QUEUE_17_025: [ MESSAGE_QUEUE_create_bounded shall create a lock and a condition for MESSAGE_QUEUE_pop_wait. ]*/
+                result->wait_lock = Lock_Init();
+                if (result->wait_lock == NULL)
+                {
+                    /*Codes_SRS_MESSAGE_QUEUE_17_026: [ If any of the above steps fails, MESSAGE_QUEUE_create_bounded shall free all allocated resources and return NULL. ]*/
+                    LogError("Lock_Init failed.");
+                    free(result->cells);
+                    free(result);
+                    result = NULL;
+                }
+                else
+                {
+                    result->wait_condition = Condition_Init();
+                    if (result->wait_condition == NULL)
+                    {
+                        /*Codes_SRS_MESSAGE_QUEUE_17_026: [ If any of the above steps fails, MESSAGE_QUEUE_create_bounded shall free all allocated resources and return NULL. ]*/
+                        LogError("Condition_Init failed.");
+                        (void)Lock_Deinit(result->wait_lock);
+                        free(result->cells);
+                        free(result);
+                        result = NULL;
+                    }
+                    else
+                    {
+                        size_t i;
+                        for (i = 0; i < rounded; i++)
+                        {
+                            result->cells[i].sequence = i;
+                            result->cells[i].message = NULL;
+                        }
+                        result->mask = rounded - 1;
+                        result->enqueue_position = 0;
+                        result->dequeue_position = 0;
+                        result->consumer_waiting = 0;
+                        result->queue_head.message = NULL;
+                        /*Codes_SRS_MESSAGE_QUEUE_17_027: [ On success, MESSAGE_QUEUE_create_bounded shall return a non-NULL handle to an empty message queue. ]*/
+                    }
+                }
+            }
+        }
     }
     return result;
 }
@@ -80,6 +294,12 @@ void MESSAGE_QUEUE_destroy(MESSAGE_QUEUE_HANDLE handle)
             Message_Destroy(message);
         }
         /*Codes_SRS_MESSAGE_QUEUE_17_006: [ MESSAGE_QUEUE_destroy shall free all allocated resources. ]*/
+        if (mq->cells != NULL)
+        {
+            Condition_Deinit(mq->wait_condition);
+            (void)Lock_Deinit(mq->wait_lock);
+            free(mq->cells);
+        }
         free(handle);
     }
 }
@@ -96,6 +316,12 @@ int MESSAGE_QUEUE_push(MESSAGE_QUEUE_HANDLE handle, MESSAGE_HANDLE element)
         LogError("invalid argument - handle(%p), element(%p).", handle, element);
         result = __LINE__;
     }
+    else if (handle->cells != NULL)
+    {
+        /*Codes_SRS_MESSAGE_QUEUE_17_008: [ MESSAGE_QUEUE_push shall return zero on success. ]*/
+        /*Codes_SRS_MESSAGE_QUEUE_17_011: [ Messages shall be pushed into the queue in a first-in-first-out order. ]*/
+        result = bounded_push_many(handle, &element, 1);
+    }
     else
     {
 		MESSAGE_QUEUE_STORAGE* temp = (MESSAGE_QUEUE_STORAGE*)malloc(sizeof(MESSAGE_QUEUE_STORAGE));
@@ -118,6 +344,71 @@ int MESSAGE_QUEUE_push(MESSAGE_QUEUE_HANDLE handle, MESSAGE_HANDLE element)
     return result;
 }
 
+int MESSAGE_QUEUE_push_many(MESSAGE_QUEUE_HANDLE handle, MESSAGE_HANDLE* elements, size_t count)
+{
+    int result;
+    size_t i = 0;
+    while (elements != NULL && i < count && elements[i] != NULL)
+    {
+        i++;
+    }
+
+    if (handle == NULL || elements == NULL || i < count)
+    {
+        /*Codes_SRS_MESSAGE_QUEUE_17_035: [ MESSAGE_QUEUE_push_many shall return a non-zero value if handle or elements are NULL, or if any of the count elements is NULL. ]*/
+        LogError("invalid argument - handle(%p), elements(%p).", handle, elements);
+        result = __LINE__;
+    }
+    else if (count == 0)
+    {
+        /*Codes_SRS_MESSAGE_QUEUE_17_040: [ MESSAGE_QUEUE_push_many shall return zero without changing the queue if count is zero. ]*/
+        result = 0;
+    }
+    else if (handle->cells != NULL)
+    {
+        /*Codes_SRS_MESSAGE_QUEUE_17_036: [ MESSAGE_QUEUE_push_many shall push all count elements onto the queue in order, such that no other message pushed concurrently is placed between them. ]*/
+        /*Codes_SRS_MESSAGE_QUEUE_17_041: [ MESSAGE_QUEUE_push_many shall return zero on success. ]*/
+        result = bounded_push_many(handle, elements, count);
+    }
+    else
+    {
+        DLIST_ENTRY batch;
+        DList_InitializeListHead(&batch);
+        for (i = 0; i < count; i++)
+        {
+            MESSAGE_QUEUE_STORAGE* temp = (MESSAGE_QUEUE_STORAGE*)malloc(sizeof(MESSAGE_QUEUE_STORAGE));
+            if (temp == NULL)
+            {
+                break;
+            }
+            temp->message = elements[i];
+            DList_InsertTailList(&batch, (PDLIST_ENTRY)temp);
+        }
+
+        if (i < count)
+        {
+            /*Codes_SRS_MESSAGE_QUEUE_17_037: [ If any system call fails, MESSAGE_QUEUE_push_many shall leave the queue unchanged and return a non-zero value. ]*/
+            LogError("malloc failed.");
+            while (!DList_IsListEmpty(&batch))
+            {
+                free(DList_RemoveHeadList(&batch));
+            }
+            result = __LINE__;
+        }
+        else
+        {
+            /*Codes_SRS_MESSAGE_QUEUE_17_036: [ MESSAGE_QUEUE_push_many shall push all count elements onto the queue in order, such that no other message pushed concurrently is placed between them. ]*/
+            /*splice the whole batch onto the tail in one step*/
+            PDLIST_ENTRY first = batch.Flink;
+            (void)DList_RemoveEntryList(&batch);
+            DList_AppendTailList((PDLIST_ENTRY)&(handle->queue_head), first);
+            /*Codes_SRS_MESSAGE_QUEUE_17_041: [ MESSAGE_QUEUE_push_many shall return zero on success. ]*/
+            result = 0;
+        }
+    }
+    return result;
+}
+
 /* removal */
 
 MESSAGE_HANDLE MESSAGE_QUEUE_pop(MESSAGE_QUEUE_HANDLE handle)
@@ -139,6 +430,128 @@ MESSAGE_HANDLE MESSAGE_QUEUE_pop(MESSAGE_QUEUE_HANDLE handle)
     return result;
 }
 
+MESSAGE_HANDLE MESSAGE_QUEUE_pop_wait(MESSAGE_QUEUE_HANDLE handle, unsigned int timeout_ms)
+{
+    MESSAGE_HANDLE result;
+    if (handle == NULL)
+    {
+        /*Codes_SRS_MESSAGE_QUEUE_17_030: [ MESSAGE_QUEUE_pop_wait shall return NULL on a NULL message queue. ]*/
+        LogError("invalid argument - handle(%p).", handle);
+        result = NULL;
+    }
+    else
+    {
+        /*Codes_SRS_MESSAGE_QUEUE_17_031: [ If the message queue is not empty, MESSAGE_QUEUE_pop_wait shall behave as MESSAGE_QUEUE_pop without waiting. ]*/
+        result = message_pop(handle);
+        if (result == NULL && handle->cells != NULL)
+        {
+            /*Codes_SRS_MESSAGE_QUEUE_17_032: [ If a bounded message queue is empty, MESSAGE_QUEUE_pop_wait shall wait on its condition for at most timeout_ms milliseconds, or until a message is pushed if timeout_ms is zero. ]*/
+            if (Lock(handle->wait_lock) != LOCK_OK)
+            {
+                LogError("unable to lock the message queue.");
+            }
+            else
+            {
+                GATEWAY_ATOMIC_STORE_SIZE(&handle->consumer_waiting, 1);
+                /*a producer that pushed before seeing the flag is caught here*/
+                result = bounded_pop(handle);
+                if (result == NULL)
+                {
+                    (void)Condition_Wait(handle->wait_condition, handle->wait_lock, (int)timeout_ms);
+                    /*Codes_SRS_MESSAGE_QUEUE_17_033: [ After waiting, MESSAGE_QUEUE_pop_wait shall return the oldest message in the queue, or NULL if the queue is still empty. ]*/
+                    result = bounded_pop(handle);
+                }
+                GATEWAY_ATOMIC_STORE_SIZE(&handle->consumer_waiting, 0);
+                (void)Unlock(handle->wait_lock);
+            }
+        }
+        else
+        {
+            /*Codes_SRS_MESSAGE_QUEUE_17_034: [ MESSAGE_QUEUE_pop_wait shall not wait on a message queue created by MESSAGE_QUEUE_create. ]*/
+        }
+    }
+    return result;
+}
+
+size_t MESSAGE_QUEUE_pop_batch(MESSAGE_QUEUE_HANDLE handle, MESSAGE_HANDLE* messages, size_t max)
+{
+    size_t result;
+    if (handle == NULL || messages == NULL)
+    {
+        /*Codes_SRS_MESSAGE_QUEUE_17_042: [ MESSAGE_QUEUE_pop_batch shall return zero if handle or messages are NULL. ]*/
+        LogError("invalid argument - handle(%p), messages(%p).", handle, messages);
+        result = 0;
+    }
+    else
+    {
+        /*Codes_SRS_MESSAGE_QUEUE_17_043: [ MESSAGE_QUEUE_pop_batch shall remove up to max messages from the queue in first-in-first-out order and store them in messages. ]*/
+        /*Codes_SRS_MESSAGE_QUEUE_17_044: [ MESSAGE_QUEUE_pop_batch shall return the number of messages stored in messages. ]*/
+        /*Codes_SRS_MESSAGE_QUEUE_17_045: [ MESSAGE_QUEUE_pop_batch shall not wait for messages. ]*/
+        for (result = 0; result < max; result++)
+        {
+            messages[result] = message_pop(handle);
+            if (messages[result] == NULL)
+            {
+                break;
+            }
+        }
+    }
+    return result;
+}
+
+size_t MESSAGE_QUEUE_drain(MESSAGE_QUEUE_HANDLE handle, MESSAGE_QUEUE_DRAIN_CALLBACK callback, void* context)
+{
+    size_t result;
+    if (handle == NULL || callback == NULL)
+    {
+        /*Codes_SRS_MESSAGE_QUEUE_17_046: [ MESSAGE_QUEUE_drain shall return zero if handle or callback are NULL. ]*/
+        LogError("invalid argument - handle(%p), callback(%p).", handle, callback);
+        result = 0;
+    }
+    else if (handle->cells != NULL)
+    {
+        /*Codes_SRS_MESSAGE_QUEUE_17_047: [ MESSAGE_QUEUE_drain shall remove every message that was on the queue when it was called and pass each to callback, in first-in-first-out order, along with context. ]*/
+        /*stop at the positions claimed so far, so producers that keep pushing cannot keep us here*/
+        size_t end = GATEWAY_ATOMIC_LOAD_SIZE(&handle->enqueue_position);
+        MESSAGE_HANDLE message;
+        result = 0;
+        while (handle->dequeue_position != end && (message = bounded_pop(handle)) != NULL)
+        {
+            /*Codes_SRS_MESSAGE_QUEUE_17_048: [ MESSAGE_QUEUE_drain shall transfer ownership of each message to callback. ]*/
+            callback(context, message);
+            result++;
+        }
+        /*Codes_SRS_MESSAGE_QUEUE_17_049: [ MESSAGE_QUEUE_drain shall return the number of messages passed to callback. ]*/
+    }
+    else
+    {
+        /*Codes_SRS_MESSAGE_QUEUE_17_047: [ MESSAGE_QUEUE_drain shall remove every message that was on the queue when it was called and pass each to callback, in first-in-first-out order, along with context. ]*/
+        /*detach the whole list in one step; callback may then push onto this queue again*/
+        DLIST_ENTRY drained;
+        DList_InitializeListHead(&drained);
+        if (!DList_IsListEmpty((PDLIST_ENTRY)&(handle->queue_head)))
+        {
+            PDLIST_ENTRY first = handle->queue_head.queue_entry.Flink;
+            (void)DList_RemoveEntryList((PDLIST_ENTRY)&(handle->queue_head));
+            DList_InitializeListHead((PDLIST_ENTRY)&(handle->queue_head));
+            DList_AppendTailList(&drained, first);
+        }
+
+        result = 0;
+        while (!DList_IsListEmpty(&drained))
+        {
+            MESSAGE_QUEUE_STORAGE* entry = (MESSAGE_QUEUE_STORAGE*)DList_RemoveHeadList(&drained);
+            MESSAGE_HANDLE message = entry->message;
+            free(entry);
+            /*Codes_SRS_MESSAGE_QUEUE_17_048: [ MESSAGE_QUEUE_drain shall transfer ownership of each message to callback. ]*/
+            callback(context, message);
+            result++;
+        }
+        /*Codes_SRS_MESSAGE_QUEUE_17_049: [ MESSAGE_QUEUE_drain shall return the number of messages passed to callback. ]*/
+    }
+    return result;
+}
+
 /* access */
 bool MESSAGE_QUEUE_is_empty(MESSAGE_QUEUE_HANDLE handle)
 {
@@ -153,7 +566,9 @@ bool MESSAGE_QUEUE_is_empty(MESSAGE_QUEUE_HANDLE handle)
 	{
         /*Codes_SRS_MESSAGE_QUEUE_17_017: [ MESSAGE_QUEUE_is_empty shall return true if there are no messages on the queue. ]*/
         /*Codes_SRS_MESSAGE_QUEUE_17_018: [ MESSAGE_QUEUE_is_empty shall return false if one or more messages have been pushed on the queue. ]*/
-		result = (DList_IsListEmpty((PDLIST_ENTRY)&(handle->queue_head)));
+		result = (handle->cells != NULL) ?
+            (bounded_front(handle) == NULL) :
+            (DList_IsListEmpty((PDLIST_ENTRY)&(handle->queue_head)));
 	}
 	return result;
 }
@@ -169,8 +584,15 @@ MESSAGE_HANDLE MESSAGE_QUEUE_front(MESSAGE_QUEUE_HANDLE handle)
     }
     else
     {
+        if (handle->cells != NULL)
+        {
+            /*Codes_SRS_MESSAGE_QUEUE_17_020: [ MESSAGE_QUEUE_front shall return NULL if the message queue is empty. ]*/
+            /*Codes_SRS_MESSAGE_QUEUE_17_021: [ On a non-empty queue, MESSAGE_QUEUE_front shall return the first remaining element that was pushed onto the message queue. ]*/
+            MESSAGE_QUEUE_CELL* cell = bounded_front(handle);
+            result = (cell == NULL) ? NULL : cell->message;
+        }
         /*Codes_SRS_MESSAGE_QUEUE_17_020: [ MESSAGE_QUEUE_front shall return NULL if the message queue is empty. ]*/
-        if (DList_IsListEmpty((PDLIST_ENTRY)&(handle->queue_head)))
+        else if (DList_IsListEmpty((PDLIST_ENTRY)&(handle->queue_head)))
         {
             result = NULL;
         }
@@ -16,6 +16,7 @@
 #include "module.h"
 #include "module_loader.h"
 #include "module_loaders/dynamic_loader.h"
+#include "module_loaders/static_loader.h"
 
 #ifdef OUTPROCESS_ENABLED
 #include "module_loaders/outprocess_loader.h"
@@ -33,6 +34,9 @@
 #include "module_loaders/dotnet_core_loader.h"
 #endif
 
+// NATIVE_STATIC is the last value of MODULE_LOADER_TYPE_VALUES
+#define MODULE_LOADER_TYPE_COUNT (NATIVE_STATIC + 1)
+
 static MODULE_LOADER_RESULT add_module_loader(const MODULE_LOADER* loader);
 
 static struct
@@ -43,7 +47,25 @@ static struct
     // Lock used to protect this instance.
     LOCK_HANDLE   lock;
 
-} g_module_loaders = { 0, NULL };
+    // Locks taken while a module is created or started, one per loader type.
+    LOCK_HANDLE   module_call_locks[MODULE_LOADER_TYPE_COUNT];
+
+} g_module_loaders = { 0, NULL, { NULL } };
+
+static bool create_module_call_locks(void)
+{
+    size_t i;
+    for (i = 0; i < MODULE_LOADER_TYPE_COUNT; i++)
+    {
+        g_module_loaders.module_call_locks[i] = Lock_Init();
+        if (g_module_loaders.module_call_locks[i] == NULL)
+        {
+            LogError("Lock_Init failed");
+            break;
+        }
+    }
+    return i == MODULE_LOADER_TYPE_COUNT;
+}
 
 MODULE_LOADER_RESULT ModuleLoader_Initialize(void)
 {
@@ -89,7 +111,8 @@ MODULE_LOADER_RESULT ModuleLoader_Initialize(void)
                 // add all supported module loaders
                 const MODULE_LOADER* supported_loaders[] =
                 {
-                    DynamicLoader_Get()
+                    DynamicLoader_Get(),
+                    StaticLoader_Get()
 #ifdef NODE_BINDING_ENABLED
                     , NodeLoader_Get()
 #endif
@@ -109,7 +132,11 @@ MODULE_LOADER_RESULT ModuleLoader_Initialize(void)
 
                 size_t loaders_count = sizeof(supported_loaders) / sizeof(supported_loaders[0]);
                 size_t i;
-                for (i = 0; i < loaders_count; i++)
+
+                /*Codes_SRS_MODULE_LOADER_17_012: [ ModuleLoader_Initialize shall initialize a lock for each module loader type. ]*/
+                /*Codes_SRS_MODULE_LOADER_17_019: [ ModuleLoader_Initialize shall call DynamicLoader_Initialize before adding the default loaders. ]*/
+                bool locks_created = create_module_call_locks() && DynamicLoader_Initialize() == MODULE_LOADER_SUCCESS;
+                for (i = 0; locks_created && i < loaders_count; i++)
                 {
                     /*Codes_SRS_MODULE_LOADER_13_005: [ ModuleLoader_Initialize shall add the default support module loaders to g_module.module_loaders. ]*/
                     if (add_module_loader(supported_loaders[i]) != MODULE_LOADER_SUCCESS)
@@ -408,6 +435,61 @@ void ModuleLoader_Destroy(void)
         Lock_Deinit(g_module_loaders.lock);
         g_module_loaders.lock = NULL;
     }
+
+    for (size_t i = 0; i < MODULE_LOADER_TYPE_COUNT; i++)
+    {
+        if (g_module_loaders.module_call_locks[i] != NULL)
+        {
+            /*Codes_SRS_MODULE_LOADER_17_013: [ ModuleLoader_Destroy shall free the lock of every module loader type that is not NULL. ]*/
+            Lock_Deinit(g_module_loaders.module_call_locks[i]);
+            g_module_loaders.module_call_locks[i] = NULL;
+        }
+    }
+
+    /*Codes_SRS_MODULE_LOADER_17_020: [ ModuleLoader_Destroy shall call DynamicLoader_Deinitialize. ]*/
+    DynamicLoader_Deinitialize();
+}
+
+MODULE_LOADER_RESULT ModuleLoader_LockModuleCalls(const MODULE_LOADER* loader)
+{
+    MODULE_LOADER_RESULT result;
+
+    /*Codes_SRS_MODULE_LOADER_17_014: [ ModuleLoader_LockModuleCalls shall return MODULE_LOADER_ERROR if loader is NULL, its type is out of range or the loaders are not initialized. ]*/
+    if (loader == NULL || (int)loader->type < 0 || loader->type >= MODULE_LOADER_TYPE_COUNT ||
+        g_module_loaders.module_call_locks[loader->type] == NULL)
+    {
+        LogError("invalid arguments loader = %p, or the module loaders are not initialized", loader);
+        result = MODULE_LOADER_ERROR;
+    }
+    /*Codes_SRS_MODULE_LOADER_17_015: [ ModuleLoader_LockModuleCalls shall acquire the lock of the type of loader and return MODULE_LOADER_SUCCESS. ]*/
+    else if (Lock(g_module_loaders.module_call_locks[loader->type]) != LOCK_OK)
+    {
+        LogError("Lock failed");
+
+        /*Codes_SRS_MODULE_LOADER_17_016: [ ModuleLoader_LockModuleCalls shall return MODULE_LOADER_ERROR if the lock cannot be acquired. ]*/
+        result = MODULE_LOADER_ERROR;
+    }
+    else
+    {
+        result = MODULE_LOADER_SUCCESS;
+    }
+
+    return result;
+}
+
+void ModuleLoader_UnlockModuleCalls(const MODULE_LOADER* loader)
+{
+    /*Codes_SRS_MODULE_LOADER_17_017: [ ModuleLoader_UnlockModuleCalls shall do nothing if loader is NULL, its type is out of range or the loaders are not initialized. ]*/
+    if (loader == NULL || (int)loader->type < 0 || loader->type >= MODULE_LOADER_TYPE_COUNT ||
+        g_module_loaders.module_call_locks[loader->type] == NULL)
+    {
+        LogError("invalid arguments loader = %p, or the module loaders are not initialized", loader);
+    }
+    /*Codes_SRS_MODULE_LOADER_17_018: [ ModuleLoader_UnlockModuleCalls shall release the lock of the type of loader. ]*/
+    else if (Unlock(g_module_loaders.module_call_locks[loader->type]) != LOCK_OK)
+    {
+        LogError("Unlock failed.");
+    }
 }
 
 static MODULE_LOADER_RESULT add_module_loader(const MODULE_LOADER* loader)
@@ -509,6 +591,11 @@ MODULE_LOADER* ModuleLoader_GetDefaultLoaderForType(MODULE_LOADER_TYPE type)
         result = ModuleLoader_FindByName(DYNAMIC_LOADER_NAME);
         break;
 
+    case NATIVE_STATIC:
+        /*Codes_SRS_MODULE_LOADER_13_058: [ ModuleLoader_GetDefaultLoaderForType shall return a non-NULL MODULE_LOADER pointer when the loader type is a recongized type. ]*/
+        result = ModuleLoader_FindByName(STATIC_LOADER_NAME);
+        break;
+
 #ifdef NODE_BINDING_ENABLED
     case NODEJS:
         /*Codes_SRS_MODULE_LOADER_13_058: [ ModuleLoader_GetDefaultLoaderForType shall return a non-NULL MODULE_LOADER pointer when the loader type is a recongized type. ]*/
@@ -559,6 +646,9 @@ MODULE_LOADER_TYPE ModuleLoader_ParseType(const char* type)
     if (strcmp(type, "native") == 0)
         /*Codes_SRS_MODULE_LOADER_13_060: [ ModuleLoader_ParseType shall return a valid MODULE_LOADER_TYPE if type is a recognized module loader type string. ]*/
         loader_type = NATIVE;
+    else if (strcmp(type, "static") == 0)
+        /*Codes_SRS_MODULE_LOADER_13_060: [ ModuleLoader_ParseType shall return a valid MODULE_LOADER_TYPE if type is a recognized module loader type string. ]*/
+        loader_type = NATIVE_STATIC;
     else if (strcmp(type, "outprocess") == 0)
         /*Codes_SRS_MODULE_LOADER_13_060: [ ModuleLoader_ParseType shall return a valid MODULE_LOADER_TYPE if type is a recognized module loader type string. ]*/
         loader_type = OUTPROCESS;
@@ -583,8 +673,10 @@ MODULE_LOADER_TYPE ModuleLoader_ParseType(const char* type)
 
 bool ModuleLoader_IsDefaultLoader(const char* name)
 {
-    /*Codes_SRS_MODULE_LOADER_13_061: [ ModuleLoader_IsDefaultLoader shall return true if name is the name of a default module loader and false otherwise. The default module loader names are 'native', 'node', 'java' , 'dotnet' and 'dotnetcore'. ]*/
+    /*Codes_SRS_MODULE_LOADER_13_061: [ ModuleLoader_IsDefaultLoader shall return true if name is the name of a default module loader and false otherwise. The default module loader names are 'native', 'static', 'node', 'java' , 'dotnet' and 'dotnetcore'. ]*/
     return strcmp(name, DYNAMIC_LOADER_NAME) == 0
+           ||
+           strcmp(name, STATIC_LOADER_NAME) == 0
            ||
            strcmp(name, "outprocess") == 0
            ||
@@ -707,6 +799,7 @@ static MODULE_LOADER_RESULT add_loader_from_json(const JSON_Value* loader, size_
                                     new_loader->type = loader_type;
                                     new_loader->configuration = loader_configuration;
                                     new_loader->api = default_loader->api;
+                                    new_loader->parallel_create = default_loader->parallel_create;
 
                                     /*Codes_SRS_MODULE_LOADER_13_070: [ ModuleLoader_InitializeFromJson shall allocate a MODULE_LOADER and add the loader to the gateway by calling ModuleLoader_Add if the loader entry is not for a default loader. ]*/
 
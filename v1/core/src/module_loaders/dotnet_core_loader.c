@@ -590,7 +590,8 @@ MODULE_LOADER Dotnet_Core_Module_Loader =
     DOTNETCORE, //Codes_SRS_DOTNET_CORE_MODULE_LOADER_04_038: [ MODULE_LOADER::type shall be DOTNETCORE. ]
     DOTNET_CORE_LOADER_NAME, //Codes_SRS_DOTNET_CORE_MODULE_LOADER_04_039: [ MODULE_LOADER::name shall be the string 'dotnetcore'. ]
     NULL,
-    &Dotnet_Core_Module_Loader_API
+    &Dotnet_Core_Module_Loader_API,
+    false // the CoreCLR host is not thread safe
 };
 
 const MODULE_LOADER* DotnetCoreLoader_Get(void)
@@ -482,7 +482,8 @@ MODULE_LOADER Dotnet_Module_Loader =
     DOTNET, //Codes_SRS_DOTNET_MODULE_LOADER_04_038: [ MODULE_LOADER::type shall be DOTNET. ]
     DOTNET_LOADER_NAME, //Codes_SRS_DOTNET_MODULE_LOADER_04_039: [ MODULE_LOADER::name shall be the string 'dotnet'. ]
     NULL,
-    &Dotnet_Module_Loader_API
+    &Dotnet_Module_Loader_API,
+    false // the CLR host is not thread safe
 };
 
 const MODULE_LOADER* DotnetLoader_Get(void)
@@ -5,6 +5,7 @@
 #include <string.h>
 
 #include "azure_c_shared_utility/xlogging.h"
+#include "azure_c_shared_utility/lock.h"
 #include "parson.h"
 
 #include "module.h"
@@ -13,12 +14,103 @@
 #include "module_loaders/dynamic_loader.h"
 #include "dynamic_library.h"
 
+/*one per library, shared by the modules loaded from it*/
 typedef struct DYNAMIC_MODULE_HANDLE_DATA_TAG
 {
     void* library;
     const MODULE_API* api;
+    size_t ref_count;
+    struct DYNAMIC_MODULE_HANDLE_DATA_TAG* next;
+    /*the canonical path of the library, or its name as configured when it has none*/
+    char library_path[1];
 }DYNAMIC_MODULE_HANDLE_DATA;
 
+static struct
+{
+    LOCK_HANDLE lock;
+    DYNAMIC_MODULE_HANDLE_DATA* libraries;
+} g_library_cache = { NULL, NULL };
+
+static DYNAMIC_MODULE_HANDLE_DATA* find_cached_library(const char* library_path)
+{
+    DYNAMIC_MODULE_HANDLE_DATA* result = g_library_cache.libraries;
+    while (result != NULL && strcmp(result->library_path, library_path) != 0)
+    {
+        result = result->next;
+    }
+    return result;
+}
+
+static DYNAMIC_MODULE_HANDLE_DATA* load_library(const char* moduleLibraryFileName, const char* library_path)
+{
+    size_t path_length = strlen(library_path);
+    DYNAMIC_MODULE_HANDLE_DATA* result = (DYNAMIC_MODULE_HANDLE_DATA*)malloc(sizeof(DYNAMIC_MODULE_HANDLE_DATA) + path_length);
+    if (result == NULL)
+    {
+        //Codes_SRS_DYNAMIC_MODULE_LOADER_13_003: [ DynamicModuleLoader_Load shall return NULL if an underlying platform call fails. ]
+        LogError("malloc(sizeof(DYNAMIC_MODULE_HANDLE_DATA)) failed");
+    }
+    else
+    {
+        /* load the DLL */
+        //Codes_SRS_DYNAMIC_MODULE_LOADER_13_004: [ DynamicModuleLoader_Load shall load the module into memory by calling DynamicLibrary_LoadLibrary. ]
+        result->library = DynamicLibrary_LoadLibrary(moduleLibraryFileName);
+        if (result->library == NULL)
+        {
+            //Codes_SRS_DYNAMIC_MODULE_LOADER_13_003: [ DynamicModuleLoader_Load shall return NULL if an underlying platform call fails. ]
+            free(result);
+            result = NULL;
+            LogError("DynamicLibrary_LoadLibrary() returned NULL for module %s", moduleLibraryFileName);
+        }
+        else
+        {
+            //Codes_SRS_DYNAMIC_MODULE_LOADER_13_033: [ DynamicModuleLoader_Load shall call DynamicLibrary_FindSymbol on the module handle with the symbol name Module_GetApi to acquire the function that returns the module's API table. ]
+            pfModule_GetApi pfnGetAPI = (pfModule_GetApi)DynamicLibrary_FindSymbol(result->library, MODULE_GETAPI_NAME);
+            if (pfnGetAPI == NULL)
+            {
+                //Codes_SRS_DYNAMIC_MODULE_LOADER_13_003: [ DynamicModuleLoader_Load shall return NULL if an underlying platform call fails. ]
+                DynamicLibrary_UnloadLibrary(result->library);
+                free(result);
+                result = NULL;
+                LogError("DynamicLibrary_FindSymbol() returned NULL");
+            }
+            else
+            {
+                //Codes_SRS_DYNAMIC_MODULE_LOADER_13_040: [ DynamicModuleLoader_Load shall call the module's Module_GetAPI callback to acquire the module API table. ]
+                result->api = pfnGetAPI(Module_ApiGatewayVersion);
+
+                /* if any of the required functions is NULL then we have a misbehaving module */
+                if (result->api == NULL ||
+                    result->api->version > Module_ApiGatewayVersion ||
+                    MODULE_CREATE(result->api) == NULL ||
+                    MODULE_DESTROY(result->api) == NULL ||
+                    MODULE_RECEIVE(result->api) == NULL)
+                {
+                    //Codes_SRS_DYNAMIC_MODULE_LOADER_13_034: [ DynamicModuleLoader_Load shall return NULL if the MODULE_API pointer returned by the module is NULL. ]
+                    //Codes_SRS_DYNAMIC_MODULE_LOADER_13_035: [ DynamicModuleLoader_Load shall return NULL if MODULE_API::version is greater than Module_ApiGatewayVersion. ]
+                    //Codes_SRS_DYNAMIC_MODULE_LOADER_13_036: [ DynamicModuleLoader_Load shall return NULL if the Module_Create function in MODULE_API is NULL. ]
+                    //Codes_SRS_DYNAMIC_MODULE_LOADER_13_037: [ DynamicModuleLoader_Load shall return NULL if the Module_Receive function in MODULE_API is NULL. ]
+                    //Codes_SRS_DYNAMIC_MODULE_LOADER_13_038: [ DynamicModuleLoader_Load shall return NULL if the Module_Destroy function in MODULE_API is NULL. ]
+                    DynamicLibrary_UnloadLibrary(result->library);
+                    free(result);
+                    result = NULL;
+                    LogError("pfnGetapi() returned NULL");
+                }
+                else
+                {
+                    //Codes_SRS_DYNAMIC_MODULE_LOADER_17_058: [ DynamicModuleLoader_Load shall cache the library under its canonical path with a reference count of 1. ]
+                    (void)memcpy(result->library_path, library_path, path_length + 1);
+                    result->ref_count = 1;
+                    result->next = g_library_cache.libraries;
+                    g_library_cache.libraries = result;
+                }
+            }
+        }
+    }
+
+    return result;
+}
+
 static MODULE_LIBRARY_HANDLE DynamicModuleLoader_Load(const MODULE_LOADER* loader, const void* entrypoint)
 {
     DYNAMIC_MODULE_HANDLE_DATA* result;
@@ -53,60 +145,35 @@ static MODULE_LIBRARY_HANDLE DynamicModuleLoader_Load(const MODULE_LOADER* loade
             else
             {
                 const char * moduleLibraryFileName = STRING_c_str(dynamic_loader_entrypoint->moduleLibraryFileName);
-                result = (DYNAMIC_MODULE_HANDLE_DATA*)malloc(sizeof(DYNAMIC_MODULE_HANDLE_DATA));
-                if (result == NULL)
+
+                //Codes_SRS_DYNAMIC_MODULE_LOADER_17_057: [ DynamicModuleLoader_Load shall key the library by DynamicLibrary_GetCanonicalPath, or by entrypoint->moduleLibraryFileName if it has no canonical path. ]
+                char* canonical_path = DynamicLibrary_GetCanonicalPath(moduleLibraryFileName);
+                const char* library_path = (canonical_path == NULL) ? moduleLibraryFileName : canonical_path;
+
+                if (Lock(g_library_cache.lock) != LOCK_OK)
                 {
                     //Codes_SRS_DYNAMIC_MODULE_LOADER_13_003: [ DynamicModuleLoader_Load shall return NULL if an underlying platform call fails. ]
-                    LogError("malloc(sizeof(DYNAMIC_MODULE_HANDLE_DATA)) failed");
+                    result = NULL;
+                    LogError("unable to lock the library cache");
                 }
                 else
                 {
-                    /* load the DLL */
-                    //Codes_SRS_DYNAMIC_MODULE_LOADER_13_004: [ DynamicModuleLoader_Load shall load the module into memory by calling DynamicLibrary_LoadLibrary. ]
-                    result->library = DynamicLibrary_LoadLibrary(moduleLibraryFileName);
-                    if (result->library == NULL)
+                    result = find_cached_library(library_path);
+                    if (result != NULL)
                     {
-                        //Codes_SRS_DYNAMIC_MODULE_LOADER_13_003: [ DynamicModuleLoader_Load shall return NULL if an underlying platform call fails. ]
-                        free(result);
-                        result = NULL;
-                        LogError("DynamicLibrary_LoadLibrary() returned NULL for module %s", moduleLibraryFileName);
+                        //Codes_SRS_DYNAMIC_MODULE_LOADER_17_059: [ If the library is cached already, DynamicModuleLoader_Load shall increment its reference count and return it without loading it again. ]
+                        result->ref_count++;
                     }
                     else
                     {
-                        //Codes_SRS_DYNAMIC_MODULE_LOADER_13_033: [ DynamicModuleLoader_Load shall call DynamicLibrary_FindSymbol on the module handle with the symbol name Module_GetApi to acquire the function that returns the module's API table. ]
-                        pfModule_GetApi pfnGetAPI = (pfModule_GetApi)DynamicLibrary_FindSymbol(result->library, MODULE_GETAPI_NAME);
-                        if (pfnGetAPI == NULL)
-                        {
-                            //Codes_SRS_DYNAMIC_MODULE_LOADER_13_003: [ DynamicModuleLoader_Load shall return NULL if an underlying platform call fails. ]
-                            DynamicLibrary_UnloadLibrary(result->library);
-                            free(result);
-                            result = NULL;
-                            LogError("DynamicLibrary_FindSymbol() returned NULL");
-                        }
-                        else
-                        {
-                            //Codes_SRS_DYNAMIC_MODULE_LOADER_13_040: [ DynamicModuleLoader_Load shall call the module's Module_GetAPI callback to acquire the module API table. ]
-                            result->api = pfnGetAPI(Module_ApiGatewayVersion);
-
-                            /* if any of the required functions is NULL then we have a misbehaving module */
-                            if (result->api == NULL ||
-                                result->api->version > Module_ApiGatewayVersion ||
-                                MODULE_CREATE(result->api) == NULL ||
-                                MODULE_DESTROY(result->api) == NULL ||
-                                MODULE_RECEIVE(result->api) == NULL)
-                            {
-                                //Codes_SRS_DYNAMIC_MODULE_LOADER_13_034: [ DynamicModuleLoader_Load shall return NULL if the MODULE_API pointer returned by the module is NULL. ]
-                                //Codes_SRS_DYNAMIC_MODULE_LOADER_13_035: [ DynamicModuleLoader_Load shall return NULL if MODULE_API::version is greater than Module_ApiGatewayVersion. ]
-                                //Codes_SRS_DYNAMIC_MODULE_LOADER_13_036: [ DynamicModuleLoader_Load shall return NULL if the Module_Create function in MODULE_API is NULL. ]
-                                //Codes_SRS_DYNAMIC_MODULE_LOADER_13_037: [ DynamicModuleLoader_Load shall return NULL if the Module_Receive function in MODULE_API is NULL. ]
-                                //Codes_SRS_DYNAMIC_MODULE_LOADER_13_038: [ DynamicModuleLoader_Load shall return NULL if the Module_Destroy function in MODULE_API is NULL. ]
-                                DynamicLibrary_UnloadLibrary(result->library);
-                                free(result);
-                                result = NULL;
-                                LogError("pfnGetapi() returned NULL");
-                            }
-                        }
+                        result = load_library(moduleLibraryFileName, library_path);
                     }
+                    (void)Unlock(g_library_cache.lock);
+                }
+
+                if (canonical_path != NULL)
+                {
+                    free(canonical_path);
                 }
             }
         }
@@ -146,11 +213,34 @@ static void DynamicModuleLoader_Unload(const MODULE_LOADER* loader, MODULE_LIBRA
     {
         DYNAMIC_MODULE_HANDLE_DATA* loader_data = moduleLibraryHandle;
 
-        /*Codes_SRS_MODULE_LOADER_17_010: [DynamicModuleLoader_Unload shall attempt to unload the library.]*/
-        DynamicLibrary_UnloadLibrary(loader_data->library);
+        if (Lock(g_library_cache.lock) != LOCK_OK)
+        {
+            LogError("unable to lock the library cache, leaking library %s", loader_data->library_path);
+        }
+        else
+        {
+            //Codes_SRS_DYNAMIC_MODULE_LOADER_17_060: [ DynamicModuleLoader_Unload shall decrement the reference count of the library and do nothing else while it is not 0. ]
+            loader_data->ref_count--;
+            if (loader_data->ref_count == 0)
+            {
+                DYNAMIC_MODULE_HANDLE_DATA** link = &g_library_cache.libraries;
+                while (*link != NULL && *link != loader_data)
+                {
+                    link = &(*link)->next;
+                }
+                if (*link != NULL)
+                {
+                    *link = loader_data->next;
+                }
+
+                /*Codes_SRS_MODULE_LOADER_17_010: [DynamicModuleLoader_Unload shall attempt to unload the library.]*/
+                DynamicLibrary_UnloadLibrary(loader_data->library);
 
-        /*Codes_SRS_MODULE_LOADER_17_011: [DynamicModuleLoader_Unload shall deallocate memory for the structure MODULE_LIBRARY_HANDLE.]*/
-        free(loader_data);
+                /*Codes_SRS_MODULE_LOADER_17_011: [DynamicModuleLoader_Unload shall deallocate memory for the structure MODULE_LIBRARY_HANDLE.]*/
+                free(loader_data);
+            }
+            (void)Unlock(g_library_cache.lock);
+        }
     }
     else
     {
@@ -330,9 +420,54 @@ static MODULE_LOADER Dynamic_Module_Loader =
     NATIVE,
     DYNAMIC_LOADER_NAME,
     NULL,
-    &Dynamic_Module_Loader_API
+    &Dynamic_Module_Loader_API,
+    true
 };
 
+MODULE_LOADER_RESULT DynamicLoader_Initialize(void)
+{
+    MODULE_LOADER_RESULT result;
+
+    if (g_library_cache.lock != NULL)
+    {
+        /*the cache lock is already there, modules may be loaded with it*/
+        result = MODULE_LOADER_SUCCESS;
+    }
+    else
+    {
+        //Codes_SRS_DYNAMIC_MODULE_LOADER_17_061: [ DynamicLoader_Initialize shall create the lock of the library cache. ]
+        g_library_cache.lock = Lock_Init();
+        if (g_library_cache.lock == NULL)
+        {
+            //Codes_SRS_DYNAMIC_MODULE_LOADER_17_062: [ DynamicLoader_Initialize shall return MODULE_LOADER_ERROR if the lock cannot be created. ]
+            LogError("unable to create the lock of the library cache");
+            result = MODULE_LOADER_ERROR;
+        }
+        else
+        {
+            //Codes_SRS_DYNAMIC_MODULE_LOADER_17_063: [ DynamicLoader_Initialize shall return MODULE_LOADER_SUCCESS when the lock of the library cache exists. ]
+            result = MODULE_LOADER_SUCCESS;
+        }
+    }
+
+    return result;
+}
+
+void DynamicLoader_Deinitialize(void)
+{
+    if (g_library_cache.lock != NULL)
+    {
+        if (g_library_cache.libraries != NULL)
+        {
+            LogError("libraries are still loaded while the dynamic loader is deinitialized");
+        }
+
+        //Codes_SRS_DYNAMIC_MODULE_LOADER_17_064: [ DynamicLoader_Deinitialize shall free the lock of the library cache. ]
+        (void)Lock_Deinit(g_library_cache.lock);
+        g_library_cache.lock = NULL;
+    }
+}
+
 const MODULE_LOADER* DynamicLoader_Get(void)
 {
     //Codes_SRS_DYNAMIC_MODULE_LOADER_13_054: [DynamicModuleLoader_Get shall return a non - NULL pointer to a MODULE_LOADER struct.]
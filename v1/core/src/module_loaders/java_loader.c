@@ -597,7 +597,9 @@ MODULE_LOADER Java_Module_Loader =
 
     NULL,                   // default loader configuration is NULL unless user overrides
     
-    &Java_Module_Loader_API // the module loader function pointer table
+    &Java_Module_Loader_API, // the module loader function pointer table
+
+    false                   // the JVM is not created concurrently
 };
 
 const MODULE_LOADER* JavaLoader_Get(void)
@@ -440,7 +440,9 @@ static MODULE_LOADER Node_Module_Loader =
 
     NULL,                   // default loader configuration is NULL unless user overrides
 
-    &Node_Module_Loader_API // the module loader function pointer table
+    &Node_Module_Loader_API, // the module loader function pointer table
+
+    false                   // node is not started concurrently
 };
 
 const MODULE_LOADER* NodeLoader_Get(void)
@@ -0,0 +1,329 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+#include <stdlib.h>
+#include "azure_c_shared_utility/gballoc.h"
+#include <string.h>
+
+#include "azure_c_shared_utility/xlogging.h"
+#include "parson.h"
+
+#include "module.h"
+#include "module_access.h"
+#include "module_loader.h"
+#include "module_loaders/static_loader.h"
+
+typedef struct STATIC_MODULE_HANDLE_DATA_TAG
+{
+    const MODULE_API* api;
+}STATIC_MODULE_HANDLE_DATA;
+
+static STATIC_LOADER_REGISTRY* g_static_registries = NULL;
+
+void StaticLoader_Register(STATIC_LOADER_REGISTRY* registry)
+{
+    if (registry == NULL)
+    {
+        //Codes_SRS_STATIC_MODULE_LOADER_17_001: [ StaticLoader_Register shall do nothing if registry is NULL. ]
+        LogError("registry is NULL");
+    }
+    else
+    {
+        //Codes_SRS_STATIC_MODULE_LOADER_17_002: [ StaticLoader_Register shall link registry in front of the registries already registered, without allocating. ]
+        registry->next = g_static_registries;
+        g_static_registries = registry;
+    }
+}
+
+static pfModule_GetApi find_static_module(const char* module_name)
+{
+    pfModule_GetApi result = NULL;
+    STATIC_LOADER_REGISTRY* registry;
+    for (registry = g_static_registries; registry != NULL && result == NULL; registry = registry->next)
+    {
+        size_t i;
+        for (i = 0; i < registry->count; i++)
+        {
+            if (registry->modules[i].module_name != NULL &&
+                strcmp(registry->modules[i].module_name, module_name) == 0)
+            {
+                result = registry->modules[i].get_api;
+                break;
+            }
+        }
+    }
+
+    return result;
+}
+
+static MODULE_LIBRARY_HANDLE StaticModuleLoader_Load(const MODULE_LOADER* loader, const void* entrypoint)
+{
+    STATIC_MODULE_HANDLE_DATA* result;
+
+    if (loader == NULL || entrypoint == NULL)
+    {
+        //Codes_SRS_STATIC_MODULE_LOADER_17_003: [ StaticModuleLoader_Load shall return NULL if loader or entrypoint is NULL. ]
+        result = NULL;
+        LogError(
+            "invalid input - loader = %p, entrypoint = %p",
+            loader, entrypoint
+        );
+    }
+    else
+    {
+        if (loader->type != NATIVE_STATIC)
+        {
+            //Codes_SRS_STATIC_MODULE_LOADER_17_004: [ StaticModuleLoader_Load shall return NULL if loader->type is not NATIVE_STATIC. ]
+            result = NULL;
+            LogError("loader->type is not NATIVE_STATIC");
+        }
+        else
+        {
+            STATIC_LOADER_ENTRYPOINT* static_loader_entrypoint = (STATIC_LOADER_ENTRYPOINT*)entrypoint;
+            if (static_loader_entrypoint->moduleName == NULL)
+            {
+                //Codes_SRS_STATIC_MODULE_LOADER_17_005: [ StaticModuleLoader_Load shall return NULL if entrypoint->moduleName is NULL. ]
+                result = NULL;
+                LogError("moduleName is NULL");
+            }
+            else
+            {
+                const char* moduleName = STRING_c_str(static_loader_entrypoint->moduleName);
+
+                //Codes_SRS_STATIC_MODULE_LOADER_17_006: [ StaticModuleLoader_Load shall look up the Module_GetApi function registered under entrypoint->moduleName. ]
+                pfModule_GetApi pfnGetAPI = find_static_module(moduleName);
+                if (pfnGetAPI == NULL)
+                {
+                    //Codes_SRS_STATIC_MODULE_LOADER_17_007: [ StaticModuleLoader_Load shall return NULL if no module was registered under entrypoint->moduleName. ]
+                    result = NULL;
+                    LogError("no statically linked module registered as %s", moduleName);
+                }
+                else
+                {
+                    result = (STATIC_MODULE_HANDLE_DATA*)malloc(sizeof(STATIC_MODULE_HANDLE_DATA));
+                    if (result == NULL)
+                    {
+                        //Codes_SRS_STATIC_MODULE_LOADER_17_008: [ StaticModuleLoader_Load shall return NULL if an underlying platform call fails. ]
+                        LogError("malloc(sizeof(STATIC_MODULE_HANDLE_DATA)) failed");
+                    }
+                    else
+                    {
+                        //Codes_SRS_STATIC_MODULE_LOADER_17_009: [ StaticModuleLoader_Load shall call the module's Module_GetApi function to acquire the module API table. ]
+                        result->api = pfnGetAPI(Module_ApiGatewayVersion);
+
+                        /* if any of the required functions is NULL then we have a misbehaving module */
+                        if (result->api == NULL ||
+                            result->api->version > Module_ApiGatewayVersion ||
+                            MODULE_CREATE(result->api) == NULL ||
+                            MODULE_DESTROY(result->api) == NULL ||
+                            MODULE_RECEIVE(result->api) == NULL)
+                        {
+                            //Codes_SRS_STATIC_MODULE_LOADER_17_010: [ StaticModuleLoader_Load shall return NULL if the MODULE_API pointer returned by the module is NULL, its version is greater than Module_ApiGatewayVersion or its Module_Create, Module_Destroy or Module_Receive function is NULL. ]
+                            free(result);
+                            result = NULL;
+                            LogError("Module_GetApi of %s returned an invalid MODULE_API", moduleName);
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    //Codes_SRS_STATIC_MODULE_LOADER_17_011: [ StaticModuleLoader_Load shall return a non-NULL pointer of type MODULE_LIBRARY_HANDLE when successful. ]
+    return result;
+}
+
+static const MODULE_API* StaticModuleLoader_GetModuleApi(const MODULE_LOADER* loader, MODULE_LIBRARY_HANDLE moduleLibraryHandle)
+{
+    (void)loader;
+
+    const MODULE_API* result;
+
+    if (moduleLibraryHandle == NULL)
+    {
+        //Codes_SRS_STATIC_MODULE_LOADER_17_012: [ StaticModuleLoader_GetModuleApi shall return NULL if moduleLibraryHandle is NULL. ]
+        result = NULL;
+        LogError("moduleLibraryHandle is NULL");
+    }
+    else
+    {
+        //Codes_SRS_STATIC_MODULE_LOADER_17_013: [ StaticModuleLoader_GetModuleApi shall return the MODULE_API acquired by StaticModuleLoader_Load. ]
+        STATIC_MODULE_HANDLE_DATA* loader_data = moduleLibraryHandle;
+        result = loader_data->api;
+    }
+
+    return result;
+}
+
+static void StaticModuleLoader_Unload(const MODULE_LOADER* loader, MODULE_LIBRARY_HANDLE moduleLibraryHandle)
+{
+    (void)loader;
+
+    if (moduleLibraryHandle != NULL)
+    {
+        //Codes_SRS_STATIC_MODULE_LOADER_17_015: [ StaticModuleLoader_Unload shall deallocate the MODULE_LIBRARY_HANDLE. ]
+        free(moduleLibraryHandle);
+    }
+    else
+    {
+        //Codes_SRS_STATIC_MODULE_LOADER_17_014: [ StaticModuleLoader_Unload shall do nothing if moduleLibraryHandle is NULL. ]
+        LogError("moduleLibraryHandle is NULL");
+    }
+}
+
+static void* StaticModuleLoader_ParseEntrypointFromJson(const MODULE_LOADER* loader, const JSON_Value* json)
+{
+    (void)loader;
+    // The input is a JSON object that looks like this:
+    //  "entrypoint": {
+    //      "module.name": "hello_world"
+    //  }
+    STATIC_LOADER_ENTRYPOINT* config;
+    if (json == NULL)
+    {
+        LogError("json is NULL");
+
+        //Codes_SRS_STATIC_MODULE_LOADER_17_016: [ StaticModuleLoader_ParseEntrypointFromJson shall return NULL if json is NULL. ]
+        config = NULL;
+    }
+    else if (json_value_get_type(json) != JSONObject)
+    {
+        LogError("'json' is not an object value");
+
+        //Codes_SRS_STATIC_MODULE_LOADER_17_017: [ StaticModuleLoader_ParseEntrypointFromJson shall return NULL if the root json entity is not an object. ]
+        config = NULL;
+    }
+    else
+    {
+        JSON_Object* entrypoint = json_value_get_object(json);
+        if (entrypoint == NULL)
+        {
+            LogError("json_value_get_object failed");
+
+            //Codes_SRS_STATIC_MODULE_LOADER_17_018: [ StaticModuleLoader_ParseEntrypointFromJson shall return NULL if an underlying platform call fails. ]
+            config = NULL;
+        }
+        else
+        {
+            //Codes_SRS_STATIC_MODULE_LOADER_17_019: [ StaticModuleLoader_ParseEntrypointFromJson shall read the name of the module from the attribute module.name. ]
+            const char* moduleName = json_object_get_string(entrypoint, "module.name");
+            if (moduleName == NULL)
+            {
+                LogError("json_object_get_string for 'module.name' returned NULL");
+
+                //Codes_SRS_STATIC_MODULE_LOADER_17_020: [ StaticModuleLoader_ParseEntrypointFromJson shall return NULL if module.name does not exist. ]
+                config = NULL;
+            }
+            else
+            {
+                config = (STATIC_LOADER_ENTRYPOINT*)malloc(sizeof(STATIC_LOADER_ENTRYPOINT));
+                if (config == NULL)
+                {
+                    //Codes_SRS_STATIC_MODULE_LOADER_17_018: [ StaticModuleLoader_ParseEntrypointFromJson shall return NULL if an underlying platform call fails. ]
+                    LogError("malloc failed");
+                }
+                else
+                {
+                    config->moduleName = STRING_construct(moduleName);
+                    if (config->moduleName == NULL)
+                    {
+                        LogError("STRING_construct failed");
+                        free(config);
+
+                        //Codes_SRS_STATIC_MODULE_LOADER_17_018: [ StaticModuleLoader_ParseEntrypointFromJson shall return NULL if an underlying platform call fails. ]
+                        config = NULL;
+                    }
+                }
+            }
+        }
+    }
+
+    //Codes_SRS_STATIC_MODULE_LOADER_17_021: [ StaticModuleLoader_ParseEntrypointFromJson shall return a non-NULL pointer to the parsed representation of the entrypoint when successful. ]
+    return (void*)config;
+}
+
+static void StaticModuleLoader_FreeEntrypoint(const MODULE_LOADER* loader, void* entrypoint)
+{
+    (void)loader;
+
+    if (entrypoint != NULL)
+    {
+        //Codes_SRS_STATIC_MODULE_LOADER_17_022: [ StaticModuleLoader_FreeEntrypoint shall free resources allocated during StaticModuleLoader_ParseEntrypointFromJson. ]
+        STATIC_LOADER_ENTRYPOINT* ep = (STATIC_LOADER_ENTRYPOINT*)entrypoint;
+        STRING_delete(ep->moduleName);
+        free(ep);
+    }
+    else
+    {
+        //Codes_SRS_STATIC_MODULE_LOADER_17_023: [ StaticModuleLoader_FreeEntrypoint shall do nothing if entrypoint is NULL. ]
+        LogError("entrypoint is NULL");
+    }
+}
+
+static MODULE_LOADER_BASE_CONFIGURATION* StaticModuleLoader_ParseConfigurationFromJson(const MODULE_LOADER* loader, const JSON_Value* json)
+{
+    (void)loader;
+    (void)json;
+
+    //Codes_SRS_STATIC_MODULE_LOADER_17_024: [ StaticModuleLoader_ParseConfigurationFromJson shall return NULL. ]
+    return NULL;
+}
+
+static void StaticModuleLoader_FreeConfiguration(const MODULE_LOADER* loader, MODULE_LOADER_BASE_CONFIGURATION* configuration)
+{
+    (void)loader;
+    (void)configuration;
+
+    //Codes_SRS_STATIC_MODULE_LOADER_17_025: [ StaticModuleLoader_FreeConfiguration shall do nothing. ]
+}
+
+static void* StaticModuleLoader_BuildModuleConfiguration(
+    const MODULE_LOADER* loader,
+    const void* entrypoint,
+    const void* module_configuration
+)
+{
+    (void)loader;
+    (void)entrypoint;
+
+    //Codes_SRS_STATIC_MODULE_LOADER_17_026: [ StaticModuleLoader_BuildModuleConfiguration shall return module_configuration. ]
+    return (void *)module_configuration;
+}
+
+static void StaticModuleLoader_FreeModuleConfiguration(const MODULE_LOADER* loader, const void* module_configuration)
+{
+    (void)loader;
+    (void)module_configuration;
+
+    //Codes_SRS_STATIC_MODULE_LOADER_17_027: [ StaticModuleLoader_FreeModuleConfiguration shall do nothing. ]
+}
+
+static MODULE_LOADER_API Static_Module_Loader_API =
+{
+    .Load = StaticModuleLoader_Load,
+    .Unload = StaticModuleLoader_Unload,
+    .GetApi = StaticModuleLoader_GetModuleApi,
+
+    .ParseEntrypointFromJson = StaticModuleLoader_ParseEntrypointFromJson,
+    .FreeEntrypoint = StaticModuleLoader_FreeEntrypoint,
+
+    .ParseConfigurationFromJson = StaticModuleLoader_ParseConfigurationFromJson,
+    .FreeConfiguration = StaticModuleLoader_FreeConfiguration,
+
+    .BuildModuleConfiguration = StaticModuleLoader_BuildModuleConfiguration,
+    .FreeModuleConfiguration = StaticModuleLoader_FreeModuleConfiguration
+};
+
+static MODULE_LOADER Static_Module_Loader =
+{
+    NATIVE_STATIC,
+    STATIC_LOADER_NAME,
+    NULL,
+    &Static_Module_Loader_API,
+    true
+};
+
+const MODULE_LOADER* StaticLoader_Get(void)
+{
+    //Codes_SRS_STATIC_MODULE_LOADER_17_028: [ StaticLoader_Get shall return a pointer to a MODULE_LOADER whose type is NATIVE_STATIC and whose name is the string static. ]
+    return &Static_Module_Loader;
+}
@@ -0,0 +1,160 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#include <stdint.h>
+#include "azure_c_shared_utility/gballoc.h"
+
+#include "module_memory.h"
+#include "azure_c_shared_utility/xlogging.h"
+#include "azure_c_shared_utility/refcount.h"
+#include "internal/gateway_atomic.h"
+
+#ifdef _MSC_VER
+#define MODULE_MEMORY_THREAD_LOCAL __declspec(thread)
+#else
+#define MODULE_MEMORY_THREAD_LOCAL __thread
+#endif
+
+typedef struct MODULE_MEMORY_TAG
+{
+    volatile size_t live_bytes;
+}MODULE_MEMORY;
+
+DEFINE_REFCOUNT_TYPE(MODULE_MEMORY);
+
+/*the header in front of every block of ModuleMemory_Malloc, padded so the block is aligned like malloc's*/
+typedef union MODULE_MEMORY_BLOCK_TAG
+{
+    struct
+    {
+        MODULE_MEMORY_HANDLE owner;
+        size_t size;
+    } header;
+    long double align_long_double;
+    uint64_t align_uint64;
+    void* align_pointer;
+}MODULE_MEMORY_BLOCK;
+
+static MODULE_MEMORY_THREAD_LOCAL MODULE_MEMORY_HANDLE current_memory = NULL;
+
+MODULE_MEMORY_HANDLE ModuleMemory_Create(void)
+{
+    /*Codes_SRS_MODULE_MEMORY_17_001: [ ModuleMemory_Create shall return a new account with no live bytes and a reference count of 1. ]*/
+    MODULE_MEMORY* result = REFCOUNT_TYPE_CREATE(MODULE_MEMORY);
+    if (result == NULL)
+    {
+        /*Codes_SRS_MODULE_MEMORY_17_002: [ ModuleMemory_Create shall return NULL if the allocation fails. ]*/
+        LogError("malloc returned NULL");
+    }
+    else
+    {
+        result->live_bytes = 0;
+    }
+    return result;
+}
+
+void ModuleMemory_IncRef(MODULE_MEMORY_HANDLE memory)
+{
+    /*Codes_SRS_MODULE_MEMORY_17_003: [ If memory is NULL, ModuleMemory_IncRef and ModuleMemory_DecRef shall do nothing. ]*/
+    if (memory != NULL)
+    {
+        /*Codes_SRS_MODULE_MEMORY_17_004: [ ModuleMemory_IncRef shall increment the reference count of memory. ]*/
+        INC_REF(MODULE_MEMORY, memory);
+    }
+}
+
+void ModuleMemory_DecRef(MODULE_MEMORY_HANDLE memory)
+{
+    /*Codes_SRS_MODULE_MEMORY_17_003: [ If memory is NULL, ModuleMemory_IncRef and ModuleMemory_DecRef shall do nothing. ]*/
+    if (memory != NULL)
+    {
+        /*Codes_SRS_MODULE_MEMORY_17_005: [ ModuleMemory_DecRef shall decrement the reference count of memory and free it when the count reaches 0. ]*/
+        if (DEC_REF(MODULE_MEMORY, memory) == DEC_RETURN_ZERO)
+        {
+            free(memory);
+        }
+    }
+}
+
+MODULE_MEMORY_HANDLE ModuleMemory_SetCurrent(MODULE_MEMORY_HANDLE memory)
+{
+    /*Codes_SRS_MODULE_MEMORY_17_006: [ ModuleMemory_SetCurrent shall make memory the current account of the calling thread and return the previous one. ]*/
+    MODULE_MEMORY_HANDLE result = current_memory;
+    current_memory = memory;
+    return result;
+}
+
+MODULE_MEMORY_HANDLE ModuleMemory_GetCurrent(void)
+{
+    /*Codes_SRS_MODULE_MEMORY_17_007: [ ModuleMemory_GetCurrent shall return the current account of the calling thread. ]*/
+    return current_memory;
+}
+
+MODULE_MEMORY_HANDLE ModuleMemory_Charge(size_t size)
+{
+    MODULE_MEMORY_HANDLE result = current_memory;
+    /*Codes_SRS_MODULE_MEMORY_17_008: [ If the calling thread has no current account, ModuleMemory_Charge shall return NULL. ]*/
+    if (result != NULL)
+    {
+        /*Codes_SRS_MODULE_MEMORY_17_009: [ ModuleMemory_Charge shall add size to the live bytes of the current account, take a reference to it and return it. ]*/
+        INC_REF(MODULE_MEMORY, result);
+        (void)GATEWAY_ATOMIC_ADD_SIZE(&result->live_bytes, size);
+    }
+    return result;
+}
+
+void ModuleMemory_Release(MODULE_MEMORY_HANDLE memory, size_t size)
+{
+    /*Codes_SRS_MODULE_MEMORY_17_010: [ If memory is NULL, ModuleMemory_Release shall do nothing. ]*/
+    if (memory != NULL)
+    {
+        /*Codes_SRS_MODULE_MEMORY_17_011: [ ModuleMemory_Release shall subtract size from the live bytes of memory and drop the reference taken by the charge. ]*/
+        (void)GATEWAY_ATOMIC_ADD_SIZE(&memory->live_bytes, (size_t)0 - size);
+        ModuleMemory_DecRef(memory);
+    }
+}
+
+size_t ModuleMemory_GetLiveBytes(MODULE_MEMORY_HANDLE memory)
+{
+    /*Codes_SRS_MODULE_MEMORY_17_012: [ ModuleMemory_GetLiveBytes shall return the live bytes of memory, or 0 if memory is NULL. ]*/
+    return memory == NULL ? 0 : GATEWAY_ATOMIC_LOAD_SIZE(&memory->live_bytes);
+}
+
+void* ModuleMemory_Malloc(size_t size)
+{
+    void* result;
+    MODULE_MEMORY_BLOCK* block;
+    if (size > SIZE_MAX - sizeof(MODULE_MEMORY_BLOCK))
+    {
+        /*Codes_SRS_MODULE_MEMORY_17_014: [ ModuleMemory_Malloc shall return NULL if the allocation fails. ]*/
+        LogError("allocation of %zu bytes is too large", size);
+        result = NULL;
+    }
+    else if ((block = (MODULE_MEMORY_BLOCK*)malloc(sizeof(MODULE_MEMORY_BLOCK) + size)) == NULL)
+    {
+        /*Codes_SRS_MODULE_MEMORY_17_014: [ ModuleMemory_Malloc shall return NULL if the allocation fails. ]*/
+        LogError("malloc returned NULL");
+        result = NULL;
+    }
+    else
+    {
+        /*Codes_SRS_MODULE_MEMORY_17_013: [ ModuleMemory_Malloc shall allocate size bytes and charge them to the current account of the calling thread. ]*/
+        block->header.size = size;
+        block->header.owner = ModuleMemory_Charge(size);
+        result = block + 1;
+    }
+    return result;
+}
+
+void ModuleMemory_Free(void* ptr)
+{
+    /*Codes_SRS_MODULE_MEMORY_17_015: [ If ptr is NULL, ModuleMemory_Free shall do nothing. ]*/
+    if (ptr != NULL)
+    {
+        /*Codes_SRS_MODULE_MEMORY_17_016: [ ModuleMemory_Free shall release the charge of the block from the account it was charged to and free the block. ]*/
+        MODULE_MEMORY_BLOCK* block = (MODULE_MEMORY_BLOCK*)ptr - 1;
+        ModuleMemory_Release(block->header.owner, block->header.size);
+        free(block);
+    }
+}
@@ -0,0 +1,472 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "azure_c_shared_utility/gballoc.h"
+
+#include "timer_service.h"
+#include "azure_c_shared_utility/xlogging.h"
+#include "azure_c_shared_utility/lock.h"
+#include "azure_c_shared_utility/condition.h"
+#include "azure_c_shared_utility/threadapi.h"
+#include "internal/gateway_clock.h"
+
+#ifdef _MSC_VER
+#define TIMER_SERVICE_THREAD_LOCAL __declspec(thread)
+#else
+#define TIMER_SERVICE_THREAD_LOCAL __thread
+#endif
+
+/*4 levels of 64 one millisecond slots hold timers up to 2^24 ms (about 4.6 hours) out. A slot of*/
+/*level n spans 64^n ms; when the lower levels wrap, the next slot of the level above is moved down.*/
+#define TIMER_WHEEL_LEVELS 4
+#define TIMER_WHEEL_SLOT_BITS 6
+#define TIMER_WHEEL_SLOTS (1 << TIMER_WHEEL_SLOT_BITS)
+#define TIMER_WHEEL_SLOT_MASK (TIMER_WHEEL_SLOTS - 1)
+#define TIMER_WHEEL_RANGE_MS ((uint64_t)1 << (TIMER_WHEEL_LEVELS * TIMER_WHEEL_SLOT_BITS))
+
+typedef struct TIMER_SERVICE_TIMER_TAG
+{
+    struct TIMER_SERVICE_TIMER_TAG* next;
+    /*the pointer that points at this timer, NULL while the timer is not in the wheel*/
+    struct TIMER_SERVICE_TIMER_TAG** link;
+    uint64_t expires_ms;
+    unsigned int period_ms;
+    TIMER_CALLBACK callback;
+    void* context;
+    bool cancelled;
+    bool free_after_run;
+}TIMER;
+
+typedef struct TIMER_SERVICE_TAG
+{
+    LOCK_HANDLE lock;
+    COND_HANDLE wake;
+    COND_HANDLE callback_done;
+    THREAD_HANDLE thread;
+    bool stop;
+    uint64_t start_us;
+    /*the next tick the wheel will process, ticks are milliseconds since start_us*/
+    uint64_t now_ms;
+    /*the tick the thread sleeps until, UINT64_MAX while it sleeps without timeout and 0 while it is awake*/
+    uint64_t wake_ms;
+    size_t timer_count;
+    TIMER* running;
+    /*the timers of the tick being processed, waiting for their callback*/
+    TIMER* due;
+    TIMER* slots[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SLOTS];
+}TIMER_SERVICE;
+
+static TIMER_SERVICE_THREAD_LOCAL TIMER_SERVICE* current_service = NULL;
+
+static uint64_t timer_service_clock_ms(TIMER_SERVICE* service)
+{
+    return (gateway_clock_now_us() - service->start_us) / 1000;
+}
+
+static void timer_push(TIMER** head, TIMER* timer)
+{
+    timer->next = *head;
+    if (*head != NULL)
+    {
+        (*head)->link = &timer->next;
+    }
+    *head = timer;
+    timer->link = head;
+}
+
+static void timer_link(TIMER_SERVICE* service, TIMER* timer)
+{
+    uint64_t expires_ms = timer->expires_ms < service->now_ms ? service->now_ms : timer->expires_ms;
+    uint64_t delta_ms = expires_ms - service->now_ms;
+    size_t level = 0;
+    if (delta_ms >= TIMER_WHEEL_RANGE_MS)
+    {
+        /*park it in the furthest slot, it moves on from there when that slot comes down*/
+        delta_ms = TIMER_WHEEL_RANGE_MS - 1;
+        expires_ms = service->now_ms + delta_ms;
+    }
+    while (level < TIMER_WHEEL_LEVELS - 1 && delta_ms >= ((uint64_t)1 << ((level + 1) * TIMER_WHEEL_SLOT_BITS)))
+    {
+        level++;
+    }
+    timer_push(&service->slots[level][(expires_ms >> (level * TIMER_WHEEL_SLOT_BITS)) & TIMER_WHEEL_SLOT_MASK], timer);
+    service->timer_count++;
+}
+
+static void timer_unlink(TIMER_SERVICE* service, TIMER* timer)
+{
+    if (timer->link != NULL)
+    {
+        *timer->link = timer->next;
+        if (timer->next != NULL)
+        {
+            timer->next->link = timer->link;
+        }
+        timer->next = NULL;
+        timer->link = NULL;
+        service->timer_count--;
+    }
+}
+
+/*an empty wheel has nothing to run in the ticks it missed, so it jumps to the clock instead of replaying them*/
+static void timer_wheel_skip_idle(TIMER_SERVICE* service, uint64_t clock_ms)
+{
+    if (service->timer_count == 0 && service->now_ms < clock_ms)
+    {
+        /*Codes_SRS_TIMER_SERVICE_17_016: [ While the service has no timers, the service shall not process the milliseconds that pass one by one. ]*/
+        service->now_ms = clock_ms;
+    }
+}
+
+/*moves the timers of a slot of a higher level to the levels below*/
+static void timer_wheel_cascade(TIMER_SERVICE* service, size_t level)
+{
+    TIMER** slot = &service->slots[level][(service->now_ms >> (level * TIMER_WHEEL_SLOT_BITS)) & TIMER_WHEEL_SLOT_MASK];
+    TIMER* timer;
+    while ((timer = *slot) != NULL)
+    {
+        timer_unlink(service, timer);
+        timer_link(service, timer);
+    }
+}
+
+/*runs the callbacks of every timer due at the tick now_ms, called with the lock held, returns false if it lost the lock*/
+static bool timer_wheel_tick(TIMER_SERVICE* service)
+{
+    size_t level;
+    TIMER* timer;
+    for (level = 1; level < TIMER_WHEEL_LEVELS && ((service->now_ms >> ((level - 1) * TIMER_WHEEL_SLOT_BITS)) & TIMER_WHEEL_SLOT_MASK) == 0; level++)
+    {
+        timer_wheel_cascade(service, level);
+    }
+
+    service->due = service->slots[0][service->now_ms & TIMER_WHEEL_SLOT_MASK];
+    service->slots[0][service->now_ms & TIMER_WHEEL_SLOT_MASK] = NULL;
+    if (service->due != NULL)
+    {
+        service->due->link = &service->due;
+    }
+    /*move on first, so timers scheduled by the callbacks land in the next tick at the earliest*/
+    service->now_ms++;
+
+    while ((timer = service->due) != NULL && !service->stop)
+    {
+        timer_unlink(service, timer);
+        service->running = timer;
+        (void)Unlock(service->lock);
+        /*Codes_SRS_TIMER_SERVICE_17_009: [ The service thread shall call the callback of every timer that is due with its context, calling all timers due in the same millisecond together. ]*/
+        timer->callback(timer->context);
+        if (Lock(service->lock) != LOCK_OK)
+        {
+            LogError("Failed to lock the timer service, timers will not fire anymore");
+            return false;
+        }
+        service->running = NULL;
+        (void)Condition_Post(service->callback_done);
+
+        if (timer->free_after_run)
+        {
+            /*Codes_SRS_TIMER_SERVICE_17_015: [ If it is called from the callback of timer, TimerService_Cancel shall free timer once the callback returns. ]*/
+            free(timer);
+        }
+        else if (!timer->cancelled && timer->period_ms > 0)
+        {
+            /*Codes_SRS_TIMER_SERVICE_17_010: [ Once the callback of a periodic timer returns, the service shall schedule it again period_ms after it was due, skipping the calls it fell behind on. ]*/
+            uint64_t clock_ms = timer_service_clock_ms(service);
+            timer->expires_ms += timer->period_ms;
+            if (timer->expires_ms <= clock_ms)
+            {
+                timer->expires_ms += ((clock_ms - timer->expires_ms) / timer->period_ms + 1) * timer->period_ms;
+            }
+            timer_link(service, timer);
+        }
+        else
+        {
+            /*Codes_SRS_TIMER_SERVICE_17_011: [ A one-shot timer shall not fire again. ]*/
+        }
+    }
+    return true;
+}
+
+/*returns the tick the thread needs to wake up at, or UINT64_MAX if no timer is scheduled*/
+static uint64_t timer_wheel_next_tick(TIMER_SERVICE* service)
+{
+    uint64_t result;
+    if (service->timer_count == 0)
+    {
+        result = UINT64_MAX;
+    }
+    else
+    {
+        /*look for a timer in what is left of the first level, or else wake for the next cascade*/
+        uint64_t boundary = (service->now_ms | TIMER_WHEEL_SLOT_MASK) + 1;
+        for (result = service->now_ms; result < boundary; result++)
+        {
+            if (service->slots[0][result & TIMER_WHEEL_SLOT_MASK] != NULL)
+            {
+                break;
+            }
+        }
+    }
+    return result;
+}
+
+static int timer_service_thread(void* param)
+{
+    TIMER_SERVICE* service = (TIMER_SERVICE*)param;
+    current_service = service;
+
+    if (Lock(service->lock) != LOCK_OK)
+    {
+        LogError("Failed to lock the timer service, timers will not fire");
+    }
+    else
+    {
+        while (!service->stop)
+        {
+            uint64_t clock_ms = timer_service_clock_ms(service);
+            timer_wheel_skip_idle(service, clock_ms);
+            if (service->now_ms <= clock_ms)
+            {
+                if (!timer_wheel_tick(service))
+                {
+                    current_service = NULL;
+                    return 0;
+                }
+            }
+            else
+            {
+                uint64_t next_ms = timer_wheel_next_tick(service);
+                service->wake_ms = next_ms;
+                /*a timeout of 0 waits until a timer is scheduled*/
+                if (Condition_Wait(service->wake, service->lock, next_ms == UINT64_MAX ? 0 : (int)(next_ms - clock_ms)) == COND_ERROR)
+                {
+                    LogError("Failed to wait on the timer service, timers will not fire anymore");
+                    service->stop = true;
+                }
+                service->wake_ms = 0;
+            }
+        }
+        (void)Unlock(service->lock);
+    }
+
+    current_service = NULL;
+    return 0;
+}
+
+TIMER_SERVICE_HANDLE TimerService_Create(void)
+{
+    TIMER_SERVICE* result = (TIMER_SERVICE*)malloc(sizeof(TIMER_SERVICE));
+    if (result == NULL)
+    {
+        /*Codes_SRS_TIMER_SERVICE_17_002: [ TimerService_Create shall return NULL if any underlying call fails. ]*/
+        LogError("malloc returned NULL");
+    }
+    else
+    {
+        size_t level;
+        size_t slot;
+        result->stop = false;
+        result->start_us = gateway_clock_now_us();
+        result->now_ms = 0;
+        result->wake_ms = 0;
+        result->timer_count = 0;
+        result->running = NULL;
+        result->due = NULL;
+        for (level = 0; level < TIMER_WHEEL_LEVELS; level++)
+        {
+            for (slot = 0; slot < TIMER_WHEEL_SLOTS; slot++)
+            {
+                result->slots[level][slot] = NULL;
+            }
+        }
+
+        if ((result->lock = Lock_Init()) == NULL)
+        {
+            /*Codes_SRS_TIMER_SERVICE_17_002: [ TimerService_Create shall return NULL if any underlying call fails. ]*/
+            LogError("Lock_Init failed");
+            free(result);
+            result = NULL;
+        }
+        else if ((result->wake = Condition_Init()) == NULL)
+        {
+            /*Codes_SRS_TIMER_SERVICE_17_002: [ TimerService_Create shall return NULL if any underlying call fails. ]*/
+            LogError("Condition_Init failed");
+            Lock_Deinit(result->lock);
+            free(result);
+            result = NULL;
+        }
+        else if ((result->callback_done = Condition_Init()) == NULL)
+        {
+            /*Codes_SRS_TIMER_SERVICE_17_002: [ TimerService_Create shall return NULL if any underlying call fails. ]*/
+            LogError("Condition_Init failed");
+            Condition_Deinit(result->wake);
+            Lock_Deinit(result->lock);
+            free(result);
+            result = NULL;
+        }
+        /*Codes_SRS_TIMER_SERVICE_17_001: [ TimerService_Create shall return a service with no timers and start its thread. ]*/
+        else if (ThreadAPI_Create(&result->thread, timer_service_thread, result) != THREADAPI_OK)
+        {
+            /*Codes_SRS_TIMER_SERVICE_17_002: [ TimerService_Create shall return NULL if any underlying call fails. ]*/
+            LogError("Failed to start the timer service thread");
+            Condition_Deinit(result->callback_done);
+            Condition_Deinit(result->wake);
+            Lock_Deinit(result->lock);
+            free(result);
+            result = NULL;
+        }
+    }
+    return result;
+}
+
+void TimerService_Destroy(TIMER_SERVICE_HANDLE service)
+{
+    /*Codes_SRS_TIMER_SERVICE_17_003: [ If service is NULL, TimerService_Destroy shall do nothing. ]*/
+    if (service == NULL)
+    {
+        LogError("NULL timer service given to TimerService_Destroy");
+    }
+    else
+    {
+        int thread_result;
+        size_t level;
+        size_t slot;
+
+        /*Codes_SRS_TIMER_SERVICE_17_004: [ TimerService_Destroy shall stop and join the service thread, then free every timer still in the service and the service. ]*/
+        if (Lock(service->lock) != LOCK_OK)
+        {
+            LogError("Failed to lock the timer service, stopping it anyway");
+            service->stop = true;
+        }
+        else
+        {
+            service->stop = true;
+            (void)Condition_Post(service->wake);
+            (void)Unlock(service->lock);
+        }
+        if (ThreadAPI_Join(service->thread, &thread_result) != THREADAPI_OK)
+        {
+            LogError("Failed to join the timer service thread");
+        }
+
+        while (service->due != NULL)
+        {
+            TIMER* timer = service->due;
+            timer_unlink(service, timer);
+            free(timer);
+        }
+        for (level = 0; level < TIMER_WHEEL_LEVELS; level++)
+        {
+            for (slot = 0; slot < TIMER_WHEEL_SLOTS; slot++)
+            {
+                while (service->slots[level][slot] != NULL)
+                {
+                    TIMER* timer = service->slots[level][slot];
+                    timer_unlink(service, timer);
+                    free(timer);
+                }
+            }
+        }
+
+        Condition_Deinit(service->callback_done);
+        Condition_Deinit(service->wake);
+        Lock_Deinit(service->lock);
+        free(service);
+    }
+}
+
+TIMER_HANDLE TimerService_Schedule(TIMER_SERVICE_HANDLE service, unsigned int delay_ms, unsigned int period_ms, TIMER_CALLBACK callback, void* context)
+{
+    TIMER* result;
+    /*Codes_SRS_TIMER_SERVICE_17_005: [ If service or callback is NULL, TimerService_Schedule shall return NULL. ]*/
+    if (service == NULL || callback == NULL)
+    {
+        LogError("Invalid input service [%p], callback [%p]", service, callback);
+        result = NULL;
+    }
+    else if ((result = (TIMER*)malloc(sizeof(TIMER))) == NULL)
+    {
+        /*Codes_SRS_TIMER_SERVICE_17_007: [ TimerService_Schedule shall return NULL if any underlying call fails. ]*/
+        LogError("malloc returned NULL");
+    }
+    else
+    {
+        result->next = NULL;
+        result->link = NULL;
+        result->period_ms = period_ms;
+        result->callback = callback;
+        result->context = context;
+        result->cancelled = false;
+        result->free_after_run = false;
+
+        if (Lock(service->lock) != LOCK_OK)
+        {
+            /*Codes_SRS_TIMER_SERVICE_17_007: [ TimerService_Schedule shall return NULL if any underlying call fails. ]*/
+            LogError("Failed to lock the timer service");
+            free(result);
+            result = NULL;
+        }
+        else
+        {
+            uint64_t clock_ms = timer_service_clock_ms(service);
+            /*the first timer after an idle spell is linked relative to the clock, not to where the wheel stopped*/
+            timer_wheel_skip_idle(service, clock_ms);
+            /*Codes_SRS_TIMER_SERVICE_17_006: [ TimerService_Schedule shall add a timer that is due delay_ms milliseconds from now to the service and return it. ]*/
+            result->expires_ms = clock_ms + delay_ms;
+            timer_link(service, result);
+            /*Codes_SRS_TIMER_SERVICE_17_008: [ TimerService_Schedule shall wake the service thread if the timer is due before the thread would wake up. ]*/
+            if (result->expires_ms < service->wake_ms)
+            {
+                (void)Condition_Post(service->wake);
+            }
+            (void)Unlock(service->lock);
+        }
+    }
+    return result;
+}
+
+void TimerService_Cancel(TIMER_SERVICE_HANDLE service, TIMER_HANDLE timer)
+{
+    /*Codes_SRS_TIMER_SERVICE_17_012: [ If service or timer is NULL, TimerService_Cancel shall do nothing. ]*/
+    if (service == NULL || timer == NULL)
+    {
+        LogError("Invalid input service [%p], timer [%p]", service, timer);
+    }
+    else if (Lock(service->lock) != LOCK_OK)
+    {
+        LogError("Failed to lock the timer service, the timer is not cancelled");
+    }
+    else if (current_service == service && service->running == timer)
+    {
+        /*Codes_SRS_TIMER_SERVICE_17_015: [ If it is called from the callback of timer, TimerService_Cancel shall free timer once the callback returns. ]*/
+        timer->free_after_run = true;
+        (void)Unlock(service->lock);
+    }
+    else
+    {
+        /*Codes_SRS_TIMER_SERVICE_17_013: [ TimerService_Cancel shall remove timer from the service, so its callback is not called anymore, and free it. ]*/
+        bool free_now = true;
+        timer->cancelled = true;
+        timer_unlink(service, timer);
+        /*Codes_SRS_TIMER_SERVICE_17_014: [ If the callback of timer is running on the service thread, TimerService_Cancel shall wait for it to return. ]*/
+        while (service->running == timer)
+        {
+            if (Condition_Wait(service->callback_done, service->lock, 0) == COND_ERROR)
+            {
+                LogError("Failed to wait for the timer callback to return, the service frees the timer");
+                timer->free_after_run = true;
+                free_now = false;
+                break;
+            }
+        }
+        (void)Unlock(service->lock);
+        if (free_now)
+        {
+            free(timer);
+        }
+    }
+}
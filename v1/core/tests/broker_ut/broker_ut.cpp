@@ -4,10 +4,12 @@
 #include <cstdlib>
 #include <cstddef>
 #include <cstdbool>
+#include <cstdint>
 #include "testrunnerswitcher.h"
 #include "micromock.h"
 #include "micromockcharstararenullterminatedstrings.h"
 #include "azure_c_shared_utility/lock.h"
+#include "azure_c_shared_utility/condition.h"
 #include "azure_c_shared_utility/vector.h"
 #include "azure_c_shared_utility/vector_types_internal.h"
 #include "azure_c_shared_utility/singlylinkedlist.h"
@@ -46,6 +48,7 @@ namespace BASEIMPLEMENTATION
 };
 
 #include "broker.h"
+#include "module_memory.h"
 #include "azure_c_shared_utility/lock.h"
 
 DEFINE_MICROMOCK_ENUM_TO_STRING(BROKER_RESULT, BROKER_RESULT_VALUES);
@@ -74,6 +77,8 @@ static size_t whenShallsinglylinkedlist_add_fail;
 
 static size_t currentLock_Init_call;
 static size_t whenShallLock_Init_fail;
+static size_t currentCondition_Init_call;
+static size_t whenShallCondition_Init_fail;
 
 static size_t currentLock_call;
 static size_t whenShallLock_fail;
@@ -90,6 +95,7 @@ static size_t currentThreadAPI_Create_call;
 static size_t whenShallThreadAPI_Create_fail;
 
 static size_t nn_current_msg_size;
+static unsigned char nn_recv_frame_tag;
 
 typedef struct LIST_ITEM_INSTANCE_TAG
 {
@@ -113,12 +119,16 @@ static void* nn_socket_memory[10];
 
 static THREAD_START_FUNC thread_func_to_call;
 static void* thread_func_args;
+/*runs in place of whatever signals the drain condition while Broker_DrainModule waits on it*/
+static void(*on_Condition_Wait)(void);
 
 struct FakeModule_Receive_Call_Status
 {
     MODULE_HANDLE module;
     MESSAGE_HANDLE messageHandle;
     bool was_called;
+    size_t hold_bytes;
+    void* held;
 };
 static FakeModule_Receive_Call_Status call_status_for_FakeModule_Receive;
 
@@ -140,6 +150,10 @@ static void FakeModule_Receive(MODULE_HANDLE module, MESSAGE_HANDLE messageHandl
     (void)messageHandle;
     call_status_for_FakeModule_Receive.was_called = true;
     ASSERT_ARE_EQUAL(void_ptr, module, call_status_for_FakeModule_Receive.module);
+    if (call_status_for_FakeModule_Receive.hold_bytes > 0)
+    {
+        call_status_for_FakeModule_Receive.held = ModuleMemory_Malloc(call_status_for_FakeModule_Receive.hold_bytes);
+    }
 }
 
 static MODULE_API_1 fake_module_apis =
@@ -243,6 +257,43 @@ public:
         auto result2 = LOCK_OK;
     MOCK_METHOD_END(LOCK_RESULT, result2)
 
+    MOCK_STATIC_METHOD_0(, COND_HANDLE, Condition_Init)
+        COND_HANDLE result2;
+        ++currentCondition_Init_call;
+        if ((whenShallCondition_Init_fail > 0) &&
+            (currentCondition_Init_call == whenShallCondition_Init_fail))
+        {
+            result2 = NULL;
+        }
+        else
+        {
+            result2 = (COND_HANDLE)malloc(1);
+        }
+    MOCK_METHOD_END(COND_HANDLE, result2)
+
+    MOCK_STATIC_METHOD_1(, COND_RESULT, Condition_Post, COND_HANDLE, handle)
+        auto result2 = COND_OK;
+    MOCK_METHOD_END(COND_RESULT, result2)
+
+    MOCK_STATIC_METHOD_3(, COND_RESULT, Condition_Wait, COND_HANDLE, handle, LOCK_HANDLE, lock, int, timeout_milliseconds)
+        COND_RESULT result2;
+        if (on_Condition_Wait != NULL)
+        {
+            void(*signal)(void) = on_Condition_Wait;
+            on_Condition_Wait = NULL;
+            signal();
+            result2 = COND_OK;
+        }
+        else
+        {
+            result2 = COND_TIMEOUT;
+        }
+    MOCK_METHOD_END(COND_RESULT, result2)
+
+    MOCK_STATIC_METHOD_1(, void, Condition_Deinit, COND_HANDLE, handle)
+        free(handle);
+    MOCK_VOID_METHOD_END()
+
     MOCK_STATIC_METHOD_1(, VECTOR_HANDLE, VECTOR_create, size_t, elementSize)
         VECTOR_HANDLE result2;
         ++currentVECTOR_create_call;
@@ -350,6 +401,12 @@ public:
     MOCK_STATIC_METHOD_3(, int32_t, Message_ToByteArray, MESSAGE_HANDLE, messageHandle, unsigned char *, buffer, int32_t, size)
     MOCK_METHOD_END(int32_t, (int32_t)1)
 
+    MOCK_STATIC_METHOD_3(, int, Message_GetSerialized, MESSAGE_HANDLE, message, const unsigned char**, buffer, int32_t*, size)
+        static const unsigned char serialized_byte = 0;
+        *buffer = &serialized_byte;
+        *size = 1;
+    MOCK_METHOD_END(int, 0)
+
     // list.h
 
     MOCK_STATIC_METHOD_0(, SINGLYLINKEDLIST_HANDLE, singlylinkedlist_create)
@@ -562,10 +619,12 @@ public:
         int rcv_length;
         if (len == NN_MSG)
         {
+            // the frame tag comes first, "nn_recv" stands in for the topic, the zeroes after it for the publish time
             char * text = (char*)"nn_recv";
-            (*(void**)buf) = malloc(8);
-            memcpy((*(void**)buf), text, 8);
-            rcv_length = 8;
+            (*(void**)buf) = calloc(1, 64);
+            *(unsigned char*)(*(void**)buf) = nn_recv_frame_tag;
+            memcpy((unsigned char*)(*(void**)buf) + 1, text, 8);
+            rcv_length = 1 + 8 + sizeof(uint64_t);
         }
         else
         {
@@ -575,6 +634,14 @@ public:
 
     MOCK_STATIC_METHOD_0(, int, nn_errno)
     MOCK_METHOD_END(int, 0)
+
+    MOCK_STATIC_METHOD_0(, TIMER_SERVICE_HANDLE, TimerService_Create)
+        TIMER_SERVICE_HANDLE service = (TIMER_SERVICE_HANDLE)BASEIMPLEMENTATION::gballoc_malloc(1);
+    MOCK_METHOD_END(TIMER_SERVICE_HANDLE, service)
+
+    MOCK_STATIC_METHOD_1(, void, TimerService_Destroy, TIMER_SERVICE_HANDLE, service)
+        BASEIMPLEMENTATION::gballoc_free(service);
+    MOCK_VOID_METHOD_END()
 };
 
 DECLARE_GLOBAL_MOCK_METHOD_1(CBrokerMocks, , void*, gballoc_malloc, size_t, size);
@@ -585,6 +652,11 @@ DECLARE_GLOBAL_MOCK_METHOD_1(CBrokerMocks, , LOCK_RESULT, Lock, LOCK_HANDLE, loc
 DECLARE_GLOBAL_MOCK_METHOD_1(CBrokerMocks, , LOCK_RESULT, Unlock, LOCK_HANDLE, lock);
 DECLARE_GLOBAL_MOCK_METHOD_1(CBrokerMocks, , LOCK_RESULT, Lock_Deinit, LOCK_HANDLE, lock);
 
+DECLARE_GLOBAL_MOCK_METHOD_0(CBrokerMocks, , COND_HANDLE, Condition_Init);
+DECLARE_GLOBAL_MOCK_METHOD_1(CBrokerMocks, , COND_RESULT, Condition_Post, COND_HANDLE, handle);
+DECLARE_GLOBAL_MOCK_METHOD_3(CBrokerMocks, , COND_RESULT, Condition_Wait, COND_HANDLE, handle, LOCK_HANDLE, lock, int, timeout_milliseconds);
+DECLARE_GLOBAL_MOCK_METHOD_1(CBrokerMocks, , void, Condition_Deinit, COND_HANDLE, handle);
+
 DECLARE_GLOBAL_MOCK_METHOD_1(CBrokerMocks, , VECTOR_HANDLE, VECTOR_create, size_t, elementSize);
 DECLARE_GLOBAL_MOCK_METHOD_1(CBrokerMocks, , void, VECTOR_destroy, VECTOR_HANDLE, vector);
 DECLARE_GLOBAL_MOCK_METHOD_3(CBrokerMocks, , int, VECTOR_push_back, VECTOR_HANDLE, vector, const void*, elements, size_t, numElements);
@@ -603,6 +675,7 @@ DECLARE_GLOBAL_MOCK_METHOD_1(CBrokerMocks, , MESSAGE_HANDLE, Message_Clone, MESS
 DECLARE_GLOBAL_MOCK_METHOD_1(CBrokerMocks, , void, Message_Destroy, MESSAGE_HANDLE, message);
 DECLARE_GLOBAL_MOCK_METHOD_2(CBrokerMocks, , MESSAGE_HANDLE, Message_CreateFromByteArray, const unsigned char*, source, int32_t, size);
 DECLARE_GLOBAL_MOCK_METHOD_3(CBrokerMocks, , int32_t, Message_ToByteArray, MESSAGE_HANDLE, messageHandle, unsigned char *, buffer, int32_t, size);
+DECLARE_GLOBAL_MOCK_METHOD_3(CBrokerMocks, , int, Message_GetSerialized, MESSAGE_HANDLE, message, const unsigned char**, buffer, int32_t*, size);
 
 // singlylinkedlist.h
 DECLARE_GLOBAL_MOCK_METHOD_0(CBrokerMocks, , SINGLYLINKEDLIST_HANDLE, singlylinkedlist_create);
@@ -634,6 +707,8 @@ DECLARE_GLOBAL_MOCK_METHOD_2(CBrokerMocks, , int, nn_connect, int, s, const char
 DECLARE_GLOBAL_MOCK_METHOD_4(CBrokerMocks, , int, nn_send, int, s, const void*, buf, size_t, len, int, flags)
 DECLARE_GLOBAL_MOCK_METHOD_4(CBrokerMocks, , int, nn_recv, int, s, void*, buf, size_t, len, int, flags)
 DECLARE_GLOBAL_MOCK_METHOD_0(CBrokerMocks, , int, nn_errno)
+DECLARE_GLOBAL_MOCK_METHOD_0(CBrokerMocks, , TIMER_SERVICE_HANDLE, TimerService_Create);
+DECLARE_GLOBAL_MOCK_METHOD_1(CBrokerMocks, , void, TimerService_Destroy, TIMER_SERVICE_HANDLE, service);
 
 BEGIN_TEST_SUITE(broker_ut)
 
@@ -660,6 +735,8 @@ TEST_FUNCTION_INITIALIZE(TestMethodInitialize)
     currentmalloc_call = 0;
     whenShallmalloc_fail = 0;
 
+    nn_recv_frame_tag = 0x01;
+
     currentVECTOR_create_call = 0;
     whenShallVECTOR_create_fail = 0;
 
@@ -671,6 +748,8 @@ TEST_FUNCTION_INITIALIZE(TestMethodInitialize)
 
     currentLock_Init_call = 0;
     whenShallLock_Init_fail = 0;
+    currentCondition_Init_call = 0;
+    whenShallCondition_Init_fail = 0;
 
     currentsinglylinkedlist_find_call = 0;
     whenShallsinglylinkedlist_find_fail = 0;
@@ -705,11 +784,14 @@ TEST_FUNCTION_INITIALIZE(TestMethodInitialize)
 
     thread_func_to_call = NULL;
     thread_func_args = NULL;
+    on_Condition_Wait = NULL;
 
 
     call_status_for_FakeModule_Receive.messageHandle = NULL;
     call_status_for_FakeModule_Receive.module = NULL;
     call_status_for_FakeModule_Receive.was_called = false;
+    call_status_for_FakeModule_Receive.hold_bytes = 0;
+    call_status_for_FakeModule_Receive.held = NULL;
 }
 
 TEST_FUNCTION_CLEANUP(TestMethodCleanup)
@@ -1291,6 +1373,141 @@ TEST_FUNCTION(Broker_AddModule_fails_string_construct_fails)
     Broker_Destroy(broker);
 }
 
+//Tests_SRS_BROKER_17_055: [ The function shall create a memory account for the module with no budget. ]
+//Tests_SRS_BROKER_13_047: [This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise.]
+TEST_FUNCTION(Broker_AddModule_fails_memory_account_create_fails)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    auto broker = Broker_Create();
+    mocks.ResetAllCalls();
+
+    // this is for the Broker_AddModule call
+    STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the module_info*/
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the module struct*/
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Lock_Init());
+    STRICT_EXPECTED_CALL(mocks, Lock_Deinit(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, UniqueId_Generate(IGNORED_PTR_ARG, 37))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, STRING_construct(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the memory account*/
+        .IgnoreArgument(1)
+        .SetFailReturn((void*)NULL);
+
+    ///act
+    auto result = Broker_AddModule(broker, &fake_module);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, result, BROKER_ERROR);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    Broker_Destroy(broker);
+}
+
+//Tests_SRS_BROKER_17_100: [ The function shall create the drain_lock and the drain condition of the module. ]
+//Tests_SRS_BROKER_13_047: [This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise.]
+TEST_FUNCTION(Broker_AddModule_fails_when_drain_lock_Init_fails)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    auto broker = Broker_Create();
+    mocks.ResetAllCalls();
+
+    // this is for the Broker_AddModule call
+    STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the module_info*/
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the module struct*/
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Lock_Init());
+    STRICT_EXPECTED_CALL(mocks, Lock_Deinit(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, UniqueId_Generate(IGNORED_PTR_ARG, 37))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, STRING_construct(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the memory account*/
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    whenShallLock_Init_fail = currentLock_Init_call + 2;
+    STRICT_EXPECTED_CALL(mocks, Lock_Init()); /*this is for the drain lock*/
+
+    ///act
+    auto result = Broker_AddModule(broker, &fake_module);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, result, BROKER_ERROR);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    Broker_Destroy(broker);
+}
+
+//Tests_SRS_BROKER_17_100: [ The function shall create the drain_lock and the drain condition of the module. ]
+//Tests_SRS_BROKER_13_047: [This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise.]
+TEST_FUNCTION(Broker_AddModule_fails_when_drain_Condition_Init_fails)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    auto broker = Broker_Create();
+    mocks.ResetAllCalls();
+
+    // this is for the Broker_AddModule call
+    STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the module_info*/
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the module struct*/
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Lock_Init());
+    STRICT_EXPECTED_CALL(mocks, Lock_Deinit(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, UniqueId_Generate(IGNORED_PTR_ARG, 37))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, STRING_construct(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the memory account*/
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Lock_Init()); /*this is for the drain lock*/
+    STRICT_EXPECTED_CALL(mocks, Lock_Deinit(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    whenShallCondition_Init_fail = currentCondition_Init_call + 1;
+    STRICT_EXPECTED_CALL(mocks, Condition_Init());
+
+    ///act
+    auto result = Broker_AddModule(broker, &fake_module);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, result, BROKER_ERROR);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    Broker_Destroy(broker);
+}
+
 //Tests_SRS_BROKER_13_047: [This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise.]
 TEST_FUNCTION(Broker_AddModule_fails_Lock_modules_lock_fails)
 {
@@ -1315,6 +1532,16 @@ TEST_FUNCTION(Broker_AddModule_fails_Lock_modules_lock_fails)
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, STRING_construct(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the memory account*/
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Lock_Init()); /*this is for the drain lock*/
+    STRICT_EXPECTED_CALL(mocks, Condition_Init());
+    STRICT_EXPECTED_CALL(mocks, Lock_Deinit(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Condition_Deinit(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
@@ -1356,6 +1583,16 @@ TEST_FUNCTION(Broker_AddModule_fails_when_singlylinkedlist_add_fails)
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, STRING_construct(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the memory account*/
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Lock_Init()); /*this is for the drain lock*/
+    STRICT_EXPECTED_CALL(mocks, Condition_Init());
+    STRICT_EXPECTED_CALL(mocks, Lock_Deinit(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Condition_Deinit(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
@@ -1402,6 +1639,16 @@ TEST_FUNCTION(Broker_AddModule_fails_when_nn_socket_fails)
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, STRING_construct(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the memory account*/
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Lock_Init()); /*this is for the drain lock*/
+    STRICT_EXPECTED_CALL(mocks, Condition_Init());
+    STRICT_EXPECTED_CALL(mocks, Lock_Deinit(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Condition_Deinit(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
@@ -1450,6 +1697,16 @@ TEST_FUNCTION(Broker_AddModule_fails_when_nn_connect_fails)
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, STRING_construct(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the memory account*/
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Lock_Init()); /*this is for the drain lock*/
+    STRICT_EXPECTED_CALL(mocks, Condition_Init());
+    STRICT_EXPECTED_CALL(mocks, Lock_Deinit(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Condition_Deinit(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
@@ -1504,6 +1761,16 @@ TEST_FUNCTION(Broker_AddModule_fails_when_nn_setSocketOpts_fails)
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, STRING_construct(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the memory account*/
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Lock_Init()); /*this is for the drain lock*/
+    STRICT_EXPECTED_CALL(mocks, Condition_Init());
+    STRICT_EXPECTED_CALL(mocks, Lock_Deinit(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Condition_Deinit(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
@@ -1523,7 +1790,7 @@ TEST_FUNCTION(Broker_AddModule_fails_when_nn_setSocketOpts_fails)
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, STRING_length(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, nn_setsockopt(IGNORED_NUM_ARG, NN_SUB, NN_SUB_SUBSCRIBE, IGNORED_PTR_ARG, 36))
+    STRICT_EXPECTED_CALL(mocks, nn_setsockopt(IGNORED_NUM_ARG, NN_SUB, NN_SUB_SUBSCRIBE, IGNORED_PTR_ARG, 37))
         .IgnoreArgument(1)
         .IgnoreArgument(4)
         .SetFailReturn(-1);
@@ -1565,6 +1832,16 @@ TEST_FUNCTION(Broker_AddModule_fails_when_ThreadAPI_Create_fails)
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, STRING_construct(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the memory account*/
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Lock_Init()); /*this is for the drain lock*/
+    STRICT_EXPECTED_CALL(mocks, Condition_Init());
+    STRICT_EXPECTED_CALL(mocks, Lock_Deinit(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Condition_Deinit(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
@@ -1584,7 +1861,7 @@ TEST_FUNCTION(Broker_AddModule_fails_when_ThreadAPI_Create_fails)
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, STRING_length(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, nn_setsockopt(IGNORED_NUM_ARG, NN_SUB, NN_SUB_SUBSCRIBE, IGNORED_PTR_ARG, 36))
+    STRICT_EXPECTED_CALL(mocks, nn_setsockopt(IGNORED_NUM_ARG, NN_SUB, NN_SUB_SUBSCRIBE, IGNORED_PTR_ARG, 37))
         .IgnoreArgument(1)
         .IgnoreArgument(4);
     STRICT_EXPECTED_CALL(mocks, nn_close(IGNORED_NUM_ARG))
@@ -1616,7 +1893,7 @@ TEST_FUNCTION(Broker_AddModule_fails_when_ThreadAPI_Create_fails)
 //Tests_SRS_BROKER_13_045 : [Broker_AddModule shall append the new instance of BROKER_MODULEINFO to BROKER_HANDLE_DATA::modules.]
 //Tests_SRS_BROKER_13_046 : [This function shall release the lock on BROKER_HANDLE_DATA::modules_lock.]
 //Tests_SRS_BROKER_13_047 : [This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise.]
-//Tests_SRS_BROKER_17_028: [ The function shall subscribe BROKER_MODULEINFO::receive_socket to the quit signal GUID. ]
+//Tests_SRS_BROKER_17_028: [ The function shall subscribe BROKER_MODULEINFO::receive_socket to the quit tag followed by the quit signal GUID. ]
 TEST_FUNCTION(Broker_AddModule_succeeds)
 {
     ///arrange
@@ -1636,6 +1913,10 @@ TEST_FUNCTION(Broker_AddModule_succeeds)
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, STRING_construct(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the memory account*/
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Lock_Init()); /*this is for the drain lock*/
+    STRICT_EXPECTED_CALL(mocks, Condition_Init());
     STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
@@ -1649,7 +1930,7 @@ TEST_FUNCTION(Broker_AddModule_succeeds)
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, STRING_length(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, nn_setsockopt(IGNORED_NUM_ARG, NN_SUB, NN_SUB_SUBSCRIBE, IGNORED_PTR_ARG, 36))
+    STRICT_EXPECTED_CALL(mocks, nn_setsockopt(IGNORED_NUM_ARG, NN_SUB, NN_SUB_SUBSCRIBE, IGNORED_PTR_ARG, 37))
         .IgnoreArgument(1)
         .IgnoreArgument(4);
     STRICT_EXPECTED_CALL(mocks, ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
@@ -1676,7 +1957,8 @@ TEST_FUNCTION(Broker_AddModule_succeeds)
 //Tests_SRS_BROKER_13_092: [ The function shall deliver the message to the module's callback function via module_info->module_apis. ]
 //Tests_SRS_BROKER_13_093: [ The function shall destroy the message that was dequeued by calling Message_Destroy. ]
 //Tests_SRS_BROKER_17_019: [ The function shall free the buffer received on the receive_socket. ]
-//Tests_SRS_BROKER_17_024: [ The function shall strip off the topic from the message. ]
+//Tests_SRS_BROKER_17_024: [ The function shall strip off the message tag and the topic from the message. ]
+//Tests_SRS_BROKER_17_099: [ Once it left its loop, the function shall set worker_exited under the drain_lock and signal the drain condition. ]
 TEST_FUNCTION(module_publish_worker_calls_receive_once_then_exits_on_quit_msg)
 {
     CBrokerMocks mocks;
@@ -1717,15 +1999,22 @@ TEST_FUNCTION(module_publish_worker_calls_receive_once_then_exits_on_quit_msg)
     STRICT_EXPECTED_CALL(mocks, nn_recv(IGNORED_NUM_ARG, IGNORED_PTR_ARG, NN_MSG, 0))
         .IgnoreArgument(1)
         .IgnoreArgument(2)
-        .SetReturn(37);
+        .SetReturn(38);
     STRICT_EXPECTED_CALL(mocks, nn_freemsg(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    // buf from nn_recv will always be "nn_recv", so match this here to let it
+    // buf from nn_recv will always be the message tag and "nn_recv", so match this here to let it
     // recognize quit message
     STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
         .IgnoreArgument(1)
-        .SetFailReturn("nn_recv");
+        .SetFailReturn("\x01nn_recv");
 
+    // worker exit
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG)) /*this is for the drain lock*/
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Condition_Post(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
 
     auto result = thread_func_to_call(thread_func_args);
 
@@ -1760,6 +2049,13 @@ TEST_FUNCTION(module_publish_worker_exits_on_lock_fail)
         .IgnoreArgument(1)
         .SetFailReturn(LOCK_ERROR);
 
+    // worker exit
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG)) /*this is for the drain lock*/
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Condition_Post(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
 
     auto result = thread_func_to_call(thread_func_args);
 
@@ -1802,6 +2098,13 @@ TEST_FUNCTION(module_publish_worker_exits_on_Unlock_fail)
     STRICT_EXPECTED_CALL(mocks, nn_freemsg(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
 
+    // worker exit
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG)) /*this is for the drain lock*/
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Condition_Post(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
 
     auto result = thread_func_to_call(thread_func_args);
 
@@ -1842,6 +2145,13 @@ TEST_FUNCTION(module_publish_worker_exits_on_nn_recv_error)
         .SetFailReturn(-1);
     STRICT_EXPECTED_CALL(mocks, nn_errno());
 
+    // worker exit
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG)) /*this is for the drain lock*/
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Condition_Post(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
 
     auto result = thread_func_to_call(thread_func_args);
 
@@ -1891,6 +2201,14 @@ TEST_FUNCTION(module_publish_worker_retries_when_nn_recv_is_interrupted)
         .SetFailReturn(-1);
     STRICT_EXPECTED_CALL(mocks, nn_errno());
 
+    // worker exit
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG)) /*this is for the drain lock*/
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Condition_Post(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+
     auto result = thread_func_to_call(thread_func_args);
 
     ASSERT_ARE_EQUAL(int, result, 0);
@@ -1927,13 +2245,13 @@ TEST_FUNCTION(module_publish_worker_message_size_matches_but_not_quit_for_me)
     STRICT_EXPECTED_CALL(mocks, nn_recv(IGNORED_NUM_ARG, IGNORED_PTR_ARG, NN_MSG, 0))
         .IgnoreArgument(1)
         .IgnoreArgument(2)
-        .SetReturn(37);
+        .SetReturn(38);
     STRICT_EXPECTED_CALL(mocks, nn_freemsg(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    // buf from nn_recv will always be "nn_recv", so force a mismatch
+    // buf from nn_recv will always be the message tag and "nn_recv", so force a mismatch
     STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
         .IgnoreArgument(1)
-        .SetFailReturn("nn_send");
+        .SetFailReturn("\x01nn_send");
     STRICT_EXPECTED_CALL(mocks, Message_CreateFromByteArray(IGNORED_PTR_ARG, IGNORED_NUM_ARG))
         .IgnoreArgument(1)
         .IgnoreArgument(2);
@@ -1948,15 +2266,22 @@ TEST_FUNCTION(module_publish_worker_message_size_matches_but_not_quit_for_me)
     STRICT_EXPECTED_CALL(mocks, nn_recv(IGNORED_NUM_ARG, IGNORED_PTR_ARG, NN_MSG, 0))
         .IgnoreArgument(1)
         .IgnoreArgument(2)
-        .SetReturn(37);
+        .SetReturn(38);
     STRICT_EXPECTED_CALL(mocks, nn_freemsg(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    // buf from nn_recv will always be "nn_recv", so match this here to let it
+    // buf from nn_recv will always be the message tag and "nn_recv", so match this here to let it
     // recognize quit message
     STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
         .IgnoreArgument(1)
-        .SetFailReturn("nn_recv");
+        .SetFailReturn("\x01nn_recv");
 
+    // worker exit
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG)) /*this is for the drain lock*/
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Condition_Post(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
 
     auto result = thread_func_to_call(thread_func_args);
 
@@ -2009,15 +2334,22 @@ TEST_FUNCTION(module_publish_worker_continue_on_CreateFromByteArray_fails)
     STRICT_EXPECTED_CALL(mocks, nn_recv(IGNORED_NUM_ARG, IGNORED_PTR_ARG, NN_MSG, 0))
         .IgnoreArgument(1)
         .IgnoreArgument(2)
-        .SetReturn(37);
+        .SetReturn(38);
     STRICT_EXPECTED_CALL(mocks, nn_freemsg(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    // buf from nn_recv will always be "nn_recv", so match this here to let it
+    // buf from nn_recv will always be the message tag and "nn_recv", so match this here to let it
     // recognize quit message
     STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
         .IgnoreArgument(1)
-        .SetFailReturn("nn_recv");
+        .SetFailReturn("\x01nn_recv");
 
+    // worker exit
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG)) /*this is for the drain lock*/
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Condition_Post(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
 
     auto result = thread_func_to_call(thread_func_args);
 
@@ -2030,291 +2362,412 @@ TEST_FUNCTION(module_publish_worker_continue_on_CreateFromByteArray_fails)
     Broker_Destroy(broker);
 }
 
-//Tests_SRS_BROKER_13_048: [If broker or module is NULL the function shall return BROKER_INVALIDARG.]
-TEST_FUNCTION(Broker_RemoveModule_fails_with_null_broker)
+//Tests_SRS_BROKER_17_044: [ The function shall count a received buffer that does not hold a valid message as a dropped message. ]
+//Tests_SRS_BROKER_17_045: [ The function shall count the delivered message and the time from its publication until Module_Receive returned. ]
+//Tests_SRS_BROKER_17_049: [ Broker_GetModuleMetrics shall copy the counters of the module into metrics. ]
+//Tests_SRS_BROKER_17_052: [ The function shall record when each Module_Receive call starts and clear it once the call returns. ]
+TEST_FUNCTION(module_publish_worker_counts_delivered_and_dropped_messages)
 {
-    ///arrange
     CBrokerMocks mocks;
+    auto broker = Broker_Create();
 
-    ///act
-    auto r1 = Broker_RemoveModule(NULL, (MODULE*)0x1);
-
-    ///assert
-    ASSERT_ARE_EQUAL(BROKER_RESULT, r1, BROKER_INVALIDARG);
-    mocks.AssertActualAndExpectedCalls();
-
-    ///cleanup
-}
+    // setup fake module's validation data
+    unsigned char fake;
+    MESSAGE_CONFIG c = { 1, &fake, (MAP_HANDLE)&fake };
+    auto message = Message_Create(&c);
+    call_status_for_FakeModule_Receive.module = fake_module.module_handle;
+    call_status_for_FakeModule_Receive.messageHandle = message;
 
-//Tests_SRS_BROKER_13_048: [If broker or module is NULL the function shall return BROKER_INVALIDARG.]
-TEST_FUNCTION(Broker_RemoveModule_fails_with_null_module)
-{
-    ///arrange
-    CBrokerMocks mocks;
+    (void)Broker_AddModule(broker, &fake_module);
 
-    ///act
-    auto r1 = Broker_RemoveModule((BROKER_HANDLE)0x1, NULL);
+    mocks.ResetAllCalls();
 
-    ///assert
-    ASSERT_ARE_EQUAL(BROKER_RESULT, r1, BROKER_INVALIDARG);
-    mocks.AssertActualAndExpectedCalls();
+    //loop 1, delivered
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, nn_recv(IGNORED_NUM_ARG, IGNORED_PTR_ARG, NN_MSG, 0))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(mocks, nn_freemsg(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Message_CreateFromByteArray(IGNORED_PTR_ARG, IGNORED_NUM_ARG))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(mocks, Message_Destroy(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
 
-    ///cleanup
-}
-
-//Tests_SRS_BROKER_13_088 : [This function shall acquire the lock on BROKER_HANDLE_DATA::modules_lock.]
-//Tests_SRS_BROKER_13_049 : [Broker_RemoveModule shall perform a linear search for module in BROKER_HANDLE_DATA::modules.]
-//Tests_SRS_BROKER_13_050 : [Broker_RemoveModule shall unlock BROKER_HANDLE_DATA::modules_lock and return BROKER_ERROR if the module is not found in BROKER_HANDLE_DATA::modules.]
-//Tests_SRS_BROKER_13_052 : [The function shall remove the module from BROKER_HANDLE_DATA::modules.]
-//Tests_SRS_BROKER_13_054 : [This function shall release the lock on BROKER_HANDLE_DATA::modules_lock.]
-//Tests_SRS_BROKER_17_021: [ This function shall send a quit signal to the worker thread by sending BROKER_MODULEINFO::quit_message_guid to the publish_socket. ]
-//Tests_SRS_BROKER_02_001: [ Broker_RemoveModule shall lock BROKER_MODULEINFO::socket_lock. ]
-//Tests_SRS_BROKER_17_015: [ This function shall close the BROKER_MODULEINFO::receive_socket. ]
-//Tests_SRS_BROKER_02_003: [ After closing the socket, Broker_RemoveModule shall unlock BROKER_MODULEINFO::info_lock. ]
-//Tests_SRS_BROKER_13_104 : [The function shall wait for the module's thread to exit by joining BROKER_MODULEINFO::thread via ThreadAPI_Join. ]
-//Tests_SRS_BROKER_13_057 : [The function shall free all members of the BROKER_MODULEINFO object.]
-//Tests_SRS_BROKER_13_053 : [This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise.]
-TEST_FUNCTION(Broker_RemoveModule_succeeds)
-{
-    ///arrange
-    CBrokerMocks mocks;
-    auto broker = Broker_Create();
-    auto result = Broker_AddModule(broker, &fake_module);
-    mocks.ResetAllCalls();
-
-    // this is for the Broker_RemoveModule call
+    //loop 2, does not deserialize
     STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-
-    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_find(IGNORED_PTR_ARG, IGNORED_PTR_ARG, &fake_module))
+    STRICT_EXPECTED_CALL(mocks, nn_recv(IGNORED_NUM_ARG, IGNORED_PTR_ARG, NN_MSG, 0))
         .IgnoreArgument(1)
         .IgnoreArgument(2);
-    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_item_get_value(IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(mocks, nn_freemsg(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_item_get_value(IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(mocks, Message_CreateFromByteArray(IGNORED_PTR_ARG, IGNORED_NUM_ARG))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2)
+        .SetFailReturn((MESSAGE_HANDLE)NULL);
+
+    //loop 3, too short to hold a message
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, nn_send(IGNORED_NUM_ARG, IGNORED_PTR_ARG, 37, 0))
+    STRICT_EXPECTED_CALL(mocks, nn_recv(IGNORED_NUM_ARG, IGNORED_PTR_ARG, NN_MSG, 0))
         .IgnoreArgument(1)
-        .IgnoreArgument(2);
-    STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
+        .IgnoreArgument(2)
+        .SetReturn(4);
+    STRICT_EXPECTED_CALL(mocks, nn_freemsg(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG)) /*this is the lock protecting mq_lock*/
+
+    //loop 4
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, nn_close(IGNORED_NUM_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, ThreadAPI_Join(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(mocks, nn_recv(IGNORED_NUM_ARG, IGNORED_PTR_ARG, NN_MSG, 0))
         .IgnoreArgument(1)
-        .IgnoreArgument(2);
-    STRICT_EXPECTED_CALL(mocks, Lock_Deinit(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
+        .IgnoreArgument(2)
+        .SetReturn(38);
+    STRICT_EXPECTED_CALL(mocks, nn_freemsg(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_remove(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+    // buf from nn_recv will always be the message tag and "nn_recv", so match this here to let it
+    // recognize quit message
+    STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
         .IgnoreArgument(1)
-        .IgnoreArgument(2);
-    STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
+        .SetFailReturn("\x01nn_recv");
+
+    // worker exit
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG)) /*this is for the drain lock*/
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(mocks, Condition_Post(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-
-
-    ///act
-    result = Broker_RemoveModule(broker, &fake_module);
-
-    ///assert
-    ASSERT_ARE_EQUAL(BROKER_RESULT, result, BROKER_OK);
-    mocks.AssertActualAndExpectedCalls();
-
-    ///cleanup
-    Broker_Destroy(broker);
-}
-
-//Tests_SRS_BROKER_13_053: [This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise.]
-TEST_FUNCTION(Broker_RemoveModule_fails_when_Lock_fails)
-{
-    ///arrange
-    CBrokerMocks mocks;
-    auto broker = Broker_Create();
-    auto result = Broker_AddModule(broker, &fake_module);
-    mocks.ResetAllCalls();
-
-    // this is for the Broker_RemoveModule call
-    whenShallLock_fail = currentLock_call + 1;
-    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
 
-    ///act
-    result = Broker_RemoveModule(broker, &fake_module);
+    auto result = thread_func_to_call(thread_func_args);
 
-    ///assert
-    ASSERT_ARE_EQUAL(BROKER_RESULT, result, BROKER_ERROR);
+    ASSERT_ARE_EQUAL(int, result, 0);
     mocks.AssertActualAndExpectedCalls();
 
+    BROKER_MODULE_METRICS metrics;
+    ASSERT_ARE_EQUAL(BROKER_RESULT, BROKER_OK, Broker_GetModuleMetrics(broker, fake_module_handle, &metrics));
+    ASSERT_ARE_EQUAL(size_t, 1, metrics.messages_received);
+    ASSERT_ARE_EQUAL(size_t, 2, metrics.messages_dropped);
+    size_t latencies = 0;
+    for (size_t i = 0; i < BROKER_LATENCY_BUCKET_COUNT; i++)
+    {
+        latencies += metrics.latency_buckets[i];
+    }
+    ASSERT_ARE_EQUAL(size_t, 1, latencies);
+    ASSERT_IS_TRUE(metrics.receive_elapsed_us == 0);
+
     ///cleanup
+    Message_Destroy(message);
     Broker_RemoveModule(broker, &fake_module);
     Broker_Destroy(broker);
 }
 
-
-//Tests_SRS_BROKER_13_050: [Broker_RemoveModule shall unlock BROKER_HANDLE_DATA::modules_lock and return BROKER_ERROR if the module is not found in BROKER_HANDLE_DATA::modules.]
-TEST_FUNCTION(Broker_RemoveModule_fails_when_singlylinkedlist_find_fails)
+//Tests_SRS_BROKER_17_044: [ The function shall count a received buffer that does not hold a valid message as a dropped message. ]
+TEST_FUNCTION(module_publish_worker_drops_frames_not_tagged_as_messages)
 {
-    ///arrange
     CBrokerMocks mocks;
     auto broker = Broker_Create();
-    auto result = Broker_AddModule(broker, &fake_module);
+
+    (void)Broker_AddModule(broker, &fake_module);
+
     mocks.ResetAllCalls();
 
-    // this is for the Broker_RemoveModule call
+    // a quit signal of another module
+    nn_recv_frame_tag = 0x02;
+
+    //loop 1, not a message
     STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    whenShallsinglylinkedlist_find_fail = 1;
-    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_find(IGNORED_PTR_ARG, IGNORED_PTR_ARG, &fake_module))
+    STRICT_EXPECTED_CALL(mocks, nn_recv(IGNORED_NUM_ARG, IGNORED_PTR_ARG, NN_MSG, 0))
         .IgnoreArgument(1)
         .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(mocks, nn_freemsg(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
 
-    ///act
-    result = Broker_RemoveModule(broker, &fake_module);
+    //loop 2
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, nn_recv(IGNORED_NUM_ARG, IGNORED_PTR_ARG, NN_MSG, 0))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2)
+        .SetReturn(38);
+    STRICT_EXPECTED_CALL(mocks, nn_freemsg(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    // buf from nn_recv will now be the quit tag and "nn_recv", so match this here to let it
+    // recognize quit message
+    STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .SetFailReturn("\x02nn_recv");
 
-    ///assert
-    ASSERT_ARE_EQUAL(BROKER_RESULT, result, BROKER_ERROR);
+    // worker exit
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG)) /*this is for the drain lock*/
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Condition_Post(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+
+    auto result = thread_func_to_call(thread_func_args);
+
+    ASSERT_ARE_EQUAL(int, result, 0);
     mocks.AssertActualAndExpectedCalls();
 
+    BROKER_MODULE_METRICS metrics;
+    ASSERT_ARE_EQUAL(BROKER_RESULT, BROKER_OK, Broker_GetModuleMetrics(broker, fake_module_handle, &metrics));
+    ASSERT_ARE_EQUAL(size_t, 0, metrics.messages_received);
+    ASSERT_ARE_EQUAL(size_t, 1, metrics.messages_dropped);
+
     ///cleanup
     Broker_RemoveModule(broker, &fake_module);
     Broker_Destroy(broker);
 }
-//Tests_SRS_BROKER_13_050: [Broker_RemoveModule shall unlock BROKER_HANDLE_DATA::modules_lock and return BROKER_ERROR if the module is not found in BROKER_HANDLE_DATA::modules.]
 
-TEST_FUNCTION(Broker_RemoveModule_succeeds_when_nn_send_fails)
+//Tests_SRS_BROKER_17_056: [ The function shall make the module's memory account current on its thread while it deserializes and delivers a message. ]
+//Tests_SRS_BROKER_17_057: [ While more bytes than the module's memory budget are charged to its account, the function shall drop the messages it receives and count them as dropped. ]
+TEST_FUNCTION(module_publish_worker_drops_messages_while_over_memory_budget)
 {
-    ///arrange
     CBrokerMocks mocks;
     auto broker = Broker_Create();
-    auto result = Broker_AddModule(broker, &fake_module);
+
+    // setup fake module's validation data, the module keeps 100 bytes charged to its account
+    unsigned char fake;
+    MESSAGE_CONFIG c = { 1, &fake, (MAP_HANDLE)&fake };
+    auto message = Message_Create(&c);
+    call_status_for_FakeModule_Receive.module = fake_module.module_handle;
+    call_status_for_FakeModule_Receive.messageHandle = message;
+    call_status_for_FakeModule_Receive.hold_bytes = 100;
+
+    (void)Broker_AddModule(broker, &fake_module);
+    (void)Broker_SetModuleMemoryBudget(broker, fake_module_handle, 10);
+
     mocks.ResetAllCalls();
 
-    // this is for the Broker_RemoveModule call
+    //loop 1, delivered while under budget
     STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-
-    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_find(IGNORED_PTR_ARG, IGNORED_PTR_ARG, &fake_module))
+    STRICT_EXPECTED_CALL(mocks, nn_recv(IGNORED_NUM_ARG, IGNORED_PTR_ARG, NN_MSG, 0))
         .IgnoreArgument(1)
         .IgnoreArgument(2);
-    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_item_get_value(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_item_get_value(IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(mocks, nn_freemsg(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, nn_send(IGNORED_NUM_ARG, IGNORED_PTR_ARG, 37, 0))
+    STRICT_EXPECTED_CALL(mocks, Message_CreateFromByteArray(IGNORED_PTR_ARG, IGNORED_NUM_ARG))
         .IgnoreArgument(1)
-        .IgnoreArgument(2)
-        .SetFailReturn(-1);
-    STRICT_EXPECTED_CALL(mocks, nn_errno());
-    STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
+        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG)) /*this is for the block the module holds*/
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, nn_close(IGNORED_NUM_ARG))
+    STRICT_EXPECTED_CALL(mocks, Message_Destroy(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, ThreadAPI_Join(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+
+    //loop 2, over budget, does not deserialize
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, nn_recv(IGNORED_NUM_ARG, IGNORED_PTR_ARG, NN_MSG, 0))
         .IgnoreArgument(1)
         .IgnoreArgument(2);
-    STRICT_EXPECTED_CALL(mocks, Lock_Deinit(IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(mocks, nn_freemsg(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
+
+    //loop 3
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_remove(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, nn_recv(IGNORED_NUM_ARG, IGNORED_PTR_ARG, NN_MSG, 0))
         .IgnoreArgument(1)
-        .IgnoreArgument(2);
-    STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
+        .IgnoreArgument(2)
+        .SetReturn(38);
+    STRICT_EXPECTED_CALL(mocks, nn_freemsg(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
+    // buf from nn_recv will always be the message tag and "nn_recv", so match this here to let it
+    // recognize quit message
+    STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .SetFailReturn("\x01nn_recv");
+
+    // worker exit
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG)) /*this is for the drain lock*/
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Condition_Post(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
 
-    ///act
-    result = Broker_RemoveModule(broker, &fake_module);
+    auto result = thread_func_to_call(thread_func_args);
 
-    ///assert
-    ASSERT_ARE_EQUAL(BROKER_RESULT, result, BROKER_OK);
+    ASSERT_ARE_EQUAL(int, result, 0);
     mocks.AssertActualAndExpectedCalls();
 
+    BROKER_MODULE_METRICS metrics;
+    ASSERT_ARE_EQUAL(BROKER_RESULT, BROKER_OK, Broker_GetModuleMetrics(broker, fake_module_handle, &metrics));
+    ASSERT_ARE_EQUAL(size_t, 1, metrics.messages_received);
+    ASSERT_ARE_EQUAL(size_t, 1, metrics.messages_dropped);
+    ASSERT_ARE_EQUAL(size_t, 100, metrics.memory_live_bytes);
+    ASSERT_ARE_EQUAL(size_t, 10, metrics.memory_budget);
+    ASSERT_IS_NULL(ModuleMemory_GetCurrent());
+
+    ModuleMemory_Free(call_status_for_FakeModule_Receive.held);
+    ASSERT_ARE_EQUAL(BROKER_RESULT, BROKER_OK, Broker_GetModuleMetrics(broker, fake_module_handle, &metrics));
+    ASSERT_ARE_EQUAL(size_t, 0, metrics.memory_live_bytes);
+
     ///cleanup
+    Message_Destroy(message);
+    Broker_RemoveModule(broker, &fake_module);
     Broker_Destroy(broker);
 }
 
-TEST_FUNCTION(Broker_RemoveModule_retries_nn_send_when_it_is_interrupted)
+//Tests_SRS_BROKER_17_067: [ The function shall drop the messages its module sheds, all of them or all but one in inbound_sample_every, and count them as shed. ]
+//Tests_SRS_BROKER_17_069: [ Broker_GetModuleMetrics shall set messages_shed to the messages shed for and by the module and queue_wait_us to the time its delivered messages waited. ]
+TEST_FUNCTION(module_publish_worker_sheds_sampled_messages)
 {
-    ///arrange
     CBrokerMocks mocks;
     auto broker = Broker_Create();
-    auto result = Broker_AddModule(broker, &fake_module);
+    BROKER_MODULE_SHEDDING shedding = { false, 2, false };
+
+    // setup fake module's validation data
+    unsigned char fake;
+    MESSAGE_CONFIG c = { 1, &fake, (MAP_HANDLE)&fake };
+    auto message = Message_Create(&c);
+    call_status_for_FakeModule_Receive.module = fake_module.module_handle;
+    call_status_for_FakeModule_Receive.messageHandle = message;
+
+    (void)Broker_AddModule(broker, &fake_module);
+    (void)Broker_SetModuleShedding(broker, fake_module_handle, &shedding);
+
     mocks.ResetAllCalls();
 
-    // this is for the Broker_RemoveModule call
+    //loop 1, the first of every two messages is delivered
     STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-
-    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_find(IGNORED_PTR_ARG, IGNORED_PTR_ARG, &fake_module))
+    STRICT_EXPECTED_CALL(mocks, nn_recv(IGNORED_NUM_ARG, IGNORED_PTR_ARG, NN_MSG, 0))
         .IgnoreArgument(1)
         .IgnoreArgument(2);
-    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_item_get_value(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_item_get_value(IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(mocks, nn_freemsg(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, nn_send(IGNORED_NUM_ARG, IGNORED_PTR_ARG, 37, 0))
-        .IgnoreArgument(1)
-        .IgnoreArgument(2)
-        .SetFailReturn(-1);
-    STRICT_EXPECTED_CALL(mocks, nn_errno())
-        .SetFailReturn(EINTR);
-    STRICT_EXPECTED_CALL(mocks, nn_send(IGNORED_NUM_ARG, IGNORED_PTR_ARG, 37, 0))
+    STRICT_EXPECTED_CALL(mocks, Message_CreateFromByteArray(IGNORED_PTR_ARG, IGNORED_NUM_ARG))
         .IgnoreArgument(1)
         .IgnoreArgument(2);
-    STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(mocks, Message_Destroy(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG)) /*this is the lock protecting mq_lock*/
+
+    //loop 2, shed without deserializing
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, nn_close(IGNORED_NUM_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, ThreadAPI_Join(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(mocks, nn_recv(IGNORED_NUM_ARG, IGNORED_PTR_ARG, NN_MSG, 0))
         .IgnoreArgument(1)
         .IgnoreArgument(2);
-    STRICT_EXPECTED_CALL(mocks, Lock_Deinit(IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(mocks, nn_freemsg(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
+
+    //loop 3
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_remove(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, nn_recv(IGNORED_NUM_ARG, IGNORED_PTR_ARG, NN_MSG, 0))
         .IgnoreArgument(1)
-        .IgnoreArgument(2);
-    STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
+        .IgnoreArgument(2)
+        .SetReturn(38);
+    STRICT_EXPECTED_CALL(mocks, nn_freemsg(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
+    // buf from nn_recv will always be the message tag and "nn_recv", so match this here to let it
+    // recognize quit message
+    STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .SetFailReturn("\x01nn_recv");
+
+    // worker exit
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG)) /*this is for the drain lock*/
         .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Condition_Post(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+
+    auto result = thread_func_to_call(thread_func_args);
+
+    ASSERT_ARE_EQUAL(int, result, 0);
+    mocks.AssertActualAndExpectedCalls();
+
+    BROKER_MODULE_METRICS metrics;
+    ASSERT_ARE_EQUAL(BROKER_RESULT, BROKER_OK, Broker_GetModuleMetrics(broker, fake_module_handle, &metrics));
+    ASSERT_ARE_EQUAL(size_t, 1, metrics.messages_received);
+    ASSERT_ARE_EQUAL(size_t, 0, metrics.messages_dropped);
+    ASSERT_ARE_EQUAL(size_t, 1, metrics.messages_shed);
+
+    ///cleanup
+    Message_Destroy(message);
+    Broker_RemoveModule(broker, &fake_module);
+    Broker_Destroy(broker);
+}
 
+//Tests_SRS_BROKER_13_048: [If broker or module is NULL the function shall return BROKER_INVALIDARG.]
+TEST_FUNCTION(Broker_RemoveModule_fails_with_null_broker)
+{
+    ///arrange
+    CBrokerMocks mocks;
 
     ///act
-    result = Broker_RemoveModule(broker, &fake_module);
+    auto r1 = Broker_RemoveModule(NULL, (MODULE*)0x1);
 
     ///assert
-    ASSERT_ARE_EQUAL(BROKER_RESULT, result, BROKER_OK);
+    ASSERT_ARE_EQUAL(BROKER_RESULT, r1, BROKER_INVALIDARG);
     mocks.AssertActualAndExpectedCalls();
 
     ///cleanup
-    Broker_Destroy(broker);
 }
 
-//Tests_SRS_BROKER_13_050: [Broker_RemoveModule shall unlock BROKER_HANDLE_DATA::modules_lock and return BROKER_ERROR if the module is not found in BROKER_HANDLE_DATA::modules.s]
-TEST_FUNCTION(Broker_RemoveModule_succeeds_even_when_Lock_fails)
+//Tests_SRS_BROKER_13_048: [If broker or module is NULL the function shall return BROKER_INVALIDARG.]
+TEST_FUNCTION(Broker_RemoveModule_fails_with_null_module)
+{
+    ///arrange
+    CBrokerMocks mocks;
+
+    ///act
+    auto r1 = Broker_RemoveModule((BROKER_HANDLE)0x1, NULL);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, r1, BROKER_INVALIDARG);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+}
+
+//Tests_SRS_BROKER_13_088 : [This function shall acquire the lock on BROKER_HANDLE_DATA::modules_lock.]
+//Tests_SRS_BROKER_13_049 : [Broker_RemoveModule shall perform a linear search for module in BROKER_HANDLE_DATA::modules.]
+//Tests_SRS_BROKER_13_050 : [Broker_RemoveModule shall unlock BROKER_HANDLE_DATA::modules_lock and return BROKER_ERROR if the module is not found in BROKER_HANDLE_DATA::modules.]
+//Tests_SRS_BROKER_13_052 : [The function shall remove the module from BROKER_HANDLE_DATA::modules.]
+//Tests_SRS_BROKER_13_054 : [This function shall release the lock on BROKER_HANDLE_DATA::modules_lock.]
+//Tests_SRS_BROKER_17_021: [ This function shall send a quit signal to the worker thread by sending the quit tag and BROKER_MODULEINFO::quit_message_guid to the publish_socket. ]
+//Tests_SRS_BROKER_02_001: [ Broker_RemoveModule shall lock BROKER_MODULEINFO::socket_lock. ]
+//Tests_SRS_BROKER_17_015: [ This function shall close the BROKER_MODULEINFO::receive_socket. ]
+//Tests_SRS_BROKER_02_003: [ After closing the socket, Broker_RemoveModule shall unlock BROKER_MODULEINFO::info_lock. ]
+//Tests_SRS_BROKER_13_104 : [The function shall wait for the module's thread to exit by joining BROKER_MODULEINFO::thread via ThreadAPI_Join. ]
+//Tests_SRS_BROKER_13_057 : [The function shall free all members of the BROKER_MODULEINFO object.]
+//Tests_SRS_BROKER_13_053 : [This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise.]
+TEST_FUNCTION(Broker_RemoveModule_succeeds)
 {
     ///arrange
     CBrokerMocks mocks;
@@ -2335,14 +2788,15 @@ TEST_FUNCTION(Broker_RemoveModule_succeeds_even_when_Lock_fails)
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, singlylinkedlist_item_get_value(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, nn_send(IGNORED_NUM_ARG, IGNORED_PTR_ARG, 37, 0))
+    STRICT_EXPECTED_CALL(mocks, nn_send(IGNORED_NUM_ARG, IGNORED_PTR_ARG, 38, 0))
         .IgnoreArgument(1)
         .IgnoreArgument(2);
     STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG)) /*this is the lock protecting mq_lock*/
-        .IgnoreArgument(1)
-        .SetFailReturn(LOCK_ERROR);
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, nn_close(IGNORED_NUM_ARG))
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, ThreadAPI_Join(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
@@ -2359,6 +2813,13 @@ TEST_FUNCTION(Broker_RemoveModule_succeeds_even_when_Lock_fails)
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG)) /*this is for the memory account*/
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Lock_Deinit(IGNORED_PTR_ARG)) /*this is for the drain lock*/
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Condition_Deinit(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+
 
     ///act
     result = Broker_RemoveModule(broker, &fake_module);
@@ -2371,8 +2832,66 @@ TEST_FUNCTION(Broker_RemoveModule_succeeds_even_when_Lock_fails)
     Broker_Destroy(broker);
 }
 
+//Tests_SRS_BROKER_13_053: [This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise.]
+TEST_FUNCTION(Broker_RemoveModule_fails_when_Lock_fails)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    auto broker = Broker_Create();
+    auto result = Broker_AddModule(broker, &fake_module);
+    mocks.ResetAllCalls();
+
+    // this is for the Broker_RemoveModule call
+    whenShallLock_fail = currentLock_call + 1;
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+
+    ///act
+    result = Broker_RemoveModule(broker, &fake_module);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, result, BROKER_ERROR);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    Broker_RemoveModule(broker, &fake_module);
+    Broker_Destroy(broker);
+}
+
+
 //Tests_SRS_BROKER_13_050: [Broker_RemoveModule shall unlock BROKER_HANDLE_DATA::modules_lock and return BROKER_ERROR if the module is not found in BROKER_HANDLE_DATA::modules.]
-TEST_FUNCTION(Broker_RemoveModule_succeeds_even_when_nn_close_fails)
+TEST_FUNCTION(Broker_RemoveModule_fails_when_singlylinkedlist_find_fails)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    auto broker = Broker_Create();
+    auto result = Broker_AddModule(broker, &fake_module);
+    mocks.ResetAllCalls();
+
+    // this is for the Broker_RemoveModule call
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    whenShallsinglylinkedlist_find_fail = 1;
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_find(IGNORED_PTR_ARG, IGNORED_PTR_ARG, &fake_module))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2);
+
+    ///act
+    result = Broker_RemoveModule(broker, &fake_module);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, result, BROKER_ERROR);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    Broker_RemoveModule(broker, &fake_module);
+    Broker_Destroy(broker);
+}
+//Tests_SRS_BROKER_13_050: [Broker_RemoveModule shall unlock BROKER_HANDLE_DATA::modules_lock and return BROKER_ERROR if the module is not found in BROKER_HANDLE_DATA::modules.]
+
+TEST_FUNCTION(Broker_RemoveModule_succeeds_when_nn_send_fails)
 {
     ///arrange
     CBrokerMocks mocks;
@@ -2393,19 +2912,15 @@ TEST_FUNCTION(Broker_RemoveModule_succeeds_even_when_nn_close_fails)
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, singlylinkedlist_item_get_value(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, nn_send(IGNORED_NUM_ARG, IGNORED_PTR_ARG, 37, 0))
+    STRICT_EXPECTED_CALL(mocks, nn_send(IGNORED_NUM_ARG, IGNORED_PTR_ARG, 38, 0))
         .IgnoreArgument(1)
-        .IgnoreArgument(2);
+        .IgnoreArgument(2)
+        .SetFailReturn(-1);
+    STRICT_EXPECTED_CALL(mocks, nn_errno());
     STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG)) /*this is the lock protecting mq_lock*/
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, nn_close(IGNORED_NUM_ARG))
-        .IgnoreArgument(1)
-        .SetReturn(-1);
-    STRICT_EXPECTED_CALL(mocks, nn_errno());
+        .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, ThreadAPI_Join(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreArgument(1)
         .IgnoreArgument(2);
@@ -2420,6 +2935,12 @@ TEST_FUNCTION(Broker_RemoveModule_succeeds_even_when_nn_close_fails)
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG)) /*this is for the memory account*/
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Lock_Deinit(IGNORED_PTR_ARG)) /*this is for the drain lock*/
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Condition_Deinit(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
 
     ///act
     result = Broker_RemoveModule(broker, &fake_module);
@@ -2432,8 +2953,7 @@ TEST_FUNCTION(Broker_RemoveModule_succeeds_even_when_nn_close_fails)
     Broker_Destroy(broker);
 }
 
-//Tests_SRS_BROKER_13_050: [Broker_RemoveModule shall unlock BROKER_HANDLE_DATA::modules_lock and return BROKER_ERROR if the module is not found in BROKER_HANDLE_DATA::modules.]
-TEST_FUNCTION(Broker_RemoveModule_succeeds_even_when_unlock_fails)
+TEST_FUNCTION(Broker_RemoveModule_retries_nn_send_when_it_is_interrupted)
 {
     ///arrange
     CBrokerMocks mocks;
@@ -2445,8 +2965,7 @@ TEST_FUNCTION(Broker_RemoveModule_succeeds_even_when_unlock_fails)
     STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
-        .IgnoreArgument(1)
-        .SetFailReturn(LOCK_ERROR);
+        .IgnoreArgument(1);
 
     STRICT_EXPECTED_CALL(mocks, singlylinkedlist_find(IGNORED_PTR_ARG, IGNORED_PTR_ARG, &fake_module))
         .IgnoreArgument(1)
@@ -2455,7 +2974,13 @@ TEST_FUNCTION(Broker_RemoveModule_succeeds_even_when_unlock_fails)
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, singlylinkedlist_item_get_value(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, nn_send(IGNORED_NUM_ARG, IGNORED_PTR_ARG, 37, 0))
+    STRICT_EXPECTED_CALL(mocks, nn_send(IGNORED_NUM_ARG, IGNORED_PTR_ARG, 38, 0))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2)
+        .SetFailReturn(-1);
+    STRICT_EXPECTED_CALL(mocks, nn_errno())
+        .SetFailReturn(EINTR);
+    STRICT_EXPECTED_CALL(mocks, nn_send(IGNORED_NUM_ARG, IGNORED_PTR_ARG, 38, 0))
         .IgnoreArgument(1)
         .IgnoreArgument(2);
     STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
@@ -2480,6 +3005,13 @@ TEST_FUNCTION(Broker_RemoveModule_succeeds_even_when_unlock_fails)
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG)) /*this is for the memory account*/
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Lock_Deinit(IGNORED_PTR_ARG)) /*this is for the drain lock*/
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Condition_Deinit(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+
 
     ///act
     result = Broker_RemoveModule(broker, &fake_module);
@@ -2492,67 +3024,264 @@ TEST_FUNCTION(Broker_RemoveModule_succeeds_even_when_unlock_fails)
     Broker_Destroy(broker);
 }
 
-//Tests_SRS_BROKER_17_029: [ If broker, link, link->module_source_handle or link->module_sink_handle are NULL, Broker_AddLink shall return BROKER_INVALIDARG. ]
-TEST_FUNCTION(Broker_AddLink_null_broker_fails)
+//Tests_SRS_BROKER_13_050: [Broker_RemoveModule shall unlock BROKER_HANDLE_DATA::modules_lock and return BROKER_ERROR if the module is not found in BROKER_HANDLE_DATA::modules.s]
+TEST_FUNCTION(Broker_RemoveModule_succeeds_even_when_Lock_fails)
 {
     ///arrange
     CBrokerMocks mocks;
-    BROKER_HANDLE broker = NULL;
-    BROKER_LINK_DATA bld =
-    {
-        fake_module_handle,
-        fake_module_handle
-    };
-
-    ///act
-    auto result = Broker_AddLink(broker, &bld);
-
-    ///assert
-    ASSERT_ARE_EQUAL(BROKER_RESULT, result, BROKER_INVALIDARG);
-    mocks.AssertActualAndExpectedCalls();
-
-    ///cleanup
+    auto broker = Broker_Create();
+    auto result = Broker_AddModule(broker, &fake_module);
+    mocks.ResetAllCalls();
 
-}
+    // this is for the Broker_RemoveModule call
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
 
-//Tests_SRS_BROKER_17_029: [ If broker, link, link->module_source_handle or link->module_sink_handle are NULL, Broker_AddLink shall return BROKER_INVALIDARG. ]
-TEST_FUNCTION(Broker_AddLink_null_link_fails)
-{
-    ///arrange
-    CBrokerMocks mocks;
-    BROKER_HANDLE broker = (BROKER_HANDLE)0x01;
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_find(IGNORED_PTR_ARG, IGNORED_PTR_ARG, &fake_module))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_item_get_value(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_item_get_value(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, nn_send(IGNORED_NUM_ARG, IGNORED_PTR_ARG, 38, 0))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG)) /*this is the lock protecting mq_lock*/
+        .IgnoreArgument(1)
+        .SetFailReturn(LOCK_ERROR);
+    STRICT_EXPECTED_CALL(mocks, nn_close(IGNORED_NUM_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, ThreadAPI_Join(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(mocks, Lock_Deinit(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_remove(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG)) /*this is for the memory account*/
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Lock_Deinit(IGNORED_PTR_ARG)) /*this is for the drain lock*/
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Condition_Deinit(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
 
     ///act
-    auto result = Broker_AddLink(broker, NULL);
+    result = Broker_RemoveModule(broker, &fake_module);
 
     ///assert
-    ASSERT_ARE_EQUAL(BROKER_RESULT, result, BROKER_INVALIDARG);
+    ASSERT_ARE_EQUAL(BROKER_RESULT, result, BROKER_OK);
     mocks.AssertActualAndExpectedCalls();
 
     ///cleanup
-
+    Broker_Destroy(broker);
 }
 
-//Tests_SRS_BROKER_17_029: [ If broker, link, link->module_source_handle or link->module_sink_handle are NULL, Broker_AddLink shall return BROKER_INVALIDARG. ]
-TEST_FUNCTION(Broker_AddLink_null_source_fails)
+//Tests_SRS_BROKER_13_050: [Broker_RemoveModule shall unlock BROKER_HANDLE_DATA::modules_lock and return BROKER_ERROR if the module is not found in BROKER_HANDLE_DATA::modules.]
+TEST_FUNCTION(Broker_RemoveModule_succeeds_even_when_nn_close_fails)
 {
     ///arrange
     CBrokerMocks mocks;
-    BROKER_HANDLE broker = (BROKER_HANDLE)0x01;
-    BROKER_LINK_DATA bld =
-    {
-        NULL,
-        fake_module_handle
-    };
-
-    ///act
-    auto result = Broker_AddLink(broker, &bld);
+    auto broker = Broker_Create();
+    auto result = Broker_AddModule(broker, &fake_module);
+    mocks.ResetAllCalls();
 
-    ///assert
-    ASSERT_ARE_EQUAL(BROKER_RESULT, result, BROKER_INVALIDARG);
-    mocks.AssertActualAndExpectedCalls();
+    // this is for the Broker_RemoveModule call
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
 
-    ///cleanup
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_find(IGNORED_PTR_ARG, IGNORED_PTR_ARG, &fake_module))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_item_get_value(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_item_get_value(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, nn_send(IGNORED_NUM_ARG, IGNORED_PTR_ARG, 38, 0))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG)) /*this is the lock protecting mq_lock*/
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, nn_close(IGNORED_NUM_ARG))
+        .IgnoreArgument(1)
+        .SetReturn(-1);
+    STRICT_EXPECTED_CALL(mocks, nn_errno());
+    STRICT_EXPECTED_CALL(mocks, ThreadAPI_Join(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(mocks, Lock_Deinit(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_remove(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG)) /*this is for the memory account*/
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Lock_Deinit(IGNORED_PTR_ARG)) /*this is for the drain lock*/
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Condition_Deinit(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+
+    ///act
+    result = Broker_RemoveModule(broker, &fake_module);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, result, BROKER_OK);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    Broker_Destroy(broker);
+}
+
+//Tests_SRS_BROKER_13_050: [Broker_RemoveModule shall unlock BROKER_HANDLE_DATA::modules_lock and return BROKER_ERROR if the module is not found in BROKER_HANDLE_DATA::modules.]
+TEST_FUNCTION(Broker_RemoveModule_succeeds_even_when_unlock_fails)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    auto broker = Broker_Create();
+    auto result = Broker_AddModule(broker, &fake_module);
+    mocks.ResetAllCalls();
+
+    // this is for the Broker_RemoveModule call
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .SetFailReturn(LOCK_ERROR);
+
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_find(IGNORED_PTR_ARG, IGNORED_PTR_ARG, &fake_module))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_item_get_value(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_item_get_value(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, nn_send(IGNORED_NUM_ARG, IGNORED_PTR_ARG, 38, 0))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG)) /*this is the lock protecting mq_lock*/
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, nn_close(IGNORED_NUM_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, ThreadAPI_Join(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(mocks, Lock_Deinit(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_remove(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG)) /*this is for the memory account*/
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Lock_Deinit(IGNORED_PTR_ARG)) /*this is for the drain lock*/
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Condition_Deinit(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+
+    ///act
+    result = Broker_RemoveModule(broker, &fake_module);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, result, BROKER_OK);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    Broker_Destroy(broker);
+}
+
+//Tests_SRS_BROKER_17_029: [ If broker, link, link->module_source_handle or link->module_sink_handle are NULL, Broker_AddLink shall return BROKER_INVALIDARG. ]
+TEST_FUNCTION(Broker_AddLink_null_broker_fails)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    BROKER_HANDLE broker = NULL;
+    BROKER_LINK_DATA bld =
+    {
+        fake_module_handle,
+        fake_module_handle
+    };
+
+    ///act
+    auto result = Broker_AddLink(broker, &bld);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, result, BROKER_INVALIDARG);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+
+}
+
+//Tests_SRS_BROKER_17_029: [ If broker, link, link->module_source_handle or link->module_sink_handle are NULL, Broker_AddLink shall return BROKER_INVALIDARG. ]
+TEST_FUNCTION(Broker_AddLink_null_link_fails)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    BROKER_HANDLE broker = (BROKER_HANDLE)0x01;
+
+    ///act
+    auto result = Broker_AddLink(broker, NULL);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, result, BROKER_INVALIDARG);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+
+}
+
+//Tests_SRS_BROKER_17_029: [ If broker, link, link->module_source_handle or link->module_sink_handle are NULL, Broker_AddLink shall return BROKER_INVALIDARG. ]
+TEST_FUNCTION(Broker_AddLink_null_source_fails)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    BROKER_HANDLE broker = (BROKER_HANDLE)0x01;
+    BROKER_LINK_DATA bld =
+    {
+        NULL,
+        fake_module_handle
+    };
+
+    ///act
+    auto result = Broker_AddLink(broker, &bld);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, result, BROKER_INVALIDARG);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
 
 }
 
@@ -2582,7 +3311,7 @@ TEST_FUNCTION(Broker_AddLink_null_sink_fails)
 //Tests_SRS_BROKER_17_030: [ Broker_AddLink shall lock the modules_lock. ]
 //Tests_SRS_BROKER_17_031: [ Broker_AddLink shall find the BROKER_HANDLE_DATA::module_info for link->module_sink_handle. ]
 //Tests_SRS_BROKER_17_041: [ Broker_AddLink shall find the BROKER_HANDLE_DATA::module_info for link->module_source_handle. ]
-//Tests_SRS_BROKER_17_032: [ Broker_AddLink shall subscribe module_info->receive_socket to the link->module_source_handle module handle. ]
+//Tests_SRS_BROKER_17_032: [ Broker_AddLink shall subscribe module_info->receive_socket to the message tag followed by the link->source module handle. ]
 //Tests_SRS_BROKER_17_033: [ Broker_AddLink shall unlock the modules_lock. ]
 TEST_FUNCTION(Broker_AddLink_succeeds)
 {
@@ -2612,7 +3341,7 @@ TEST_FUNCTION(Broker_AddLink_succeeds)
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, singlylinkedlist_item_get_value(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, nn_setsockopt(IGNORED_NUM_ARG, NN_SUB, NN_SUB_SUBSCRIBE, IGNORED_PTR_ARG, sizeof(MODULE_HANDLE)))
+    STRICT_EXPECTED_CALL(mocks, nn_setsockopt(IGNORED_NUM_ARG, NN_SUB, NN_SUB_SUBSCRIBE, IGNORED_PTR_ARG, 1 + sizeof(MODULE_HANDLE)))
         .IgnoreArgument(1)
         .IgnoreArgument(4);
 
@@ -2663,7 +3392,7 @@ TEST_FUNCTION(Broker_AddLink_fails_setsocketoption_fails)
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, singlylinkedlist_item_get_value(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, nn_setsockopt(IGNORED_NUM_ARG, NN_SUB, NN_SUB_SUBSCRIBE, IGNORED_PTR_ARG, sizeof(MODULE_HANDLE)))
+    STRICT_EXPECTED_CALL(mocks, nn_setsockopt(IGNORED_NUM_ARG, NN_SUB, NN_SUB_SUBSCRIBE, IGNORED_PTR_ARG, 1 + sizeof(MODULE_HANDLE)))
         .IgnoreArgument(1)
         .IgnoreArgument(4)
         .SetFailReturn(-1);
@@ -2878,31 +3607,1520 @@ TEST_FUNCTION(Broker_RemoveLink_null_sink_fails)
     ///act
     auto result = Broker_RemoveLink(broker, &bld);
 
-    ///assert
-    ASSERT_ARE_EQUAL(BROKER_RESULT, result, BROKER_INVALIDARG);
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, result, BROKER_INVALIDARG);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+
+}
+
+//Tests_SRS_BROKER_17_036: [ Broker_RemoveLink shall lock the modules_lock. ]
+//Tests_SRS_BROKER_17_037: [ Broker_RemoveLink shall find the module_info for link->module_sink_handle. ]
+//Tests_SRS_BROKER_17_042: [ Broker_RemoveLink shall find the module_info for link->module_source_handle. ]
+//Tests_SRS_BROKER_17_038: [ Broker_RemoveLink shall unsubscribe module_info->receive_socket from the message tag followed by the link->module_source_handle module handle. ]
+//Tests_SRS_BROKER_17_039: [ Broker_RemoveLink shall unlock the modules_lock. ]
+TEST_FUNCTION(Broker_RemoveLink_succeeds)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    auto broker = Broker_Create();
+    auto result = Broker_AddModule(broker, &fake_module);
+    BROKER_LINK_DATA bld =
+    {
+        fake_module_handle,
+        fake_module_handle
+    };
+    result = Broker_AddLink(broker, &bld);
+
+    mocks.ResetAllCalls();
+
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_find(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2)
+        .IgnoreArgument(3);
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_item_get_value(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_item_get_value(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_find(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2)
+        .IgnoreArgument(3);
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_item_get_value(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_item_get_value(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+
+    STRICT_EXPECTED_CALL(mocks, nn_setsockopt(IGNORED_NUM_ARG, NN_SUB, NN_SUB_UNSUBSCRIBE, IGNORED_PTR_ARG, 1 + sizeof(MODULE_HANDLE)))
+        .IgnoreArgument(1)
+        .IgnoreArgument(4);
+
+    ///act
+    result = Broker_RemoveLink(broker, &bld);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, result, BROKER_OK);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    Broker_RemoveModule(broker, &fake_module);
+    Broker_Destroy(broker);
+}
+
+//Tests_SRS_BROKER_17_040: [ Upon an error, Broker_RemoveLink shall return BROKER_REMOVE_LINK_ERROR. ]
+TEST_FUNCTION(Broker_RemoveLink_fails_sockopt_fails)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    auto broker = Broker_Create();
+    auto result = Broker_AddModule(broker, &fake_module);
+    BROKER_LINK_DATA bld =
+    {
+        fake_module_handle,
+        fake_module_handle
+    };
+    result = Broker_AddLink(broker, &bld);
+
+    mocks.ResetAllCalls();
+
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_find(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2)
+        .IgnoreArgument(3);
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_item_get_value(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_item_get_value(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_find(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2)
+        .IgnoreArgument(3);
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_item_get_value(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_item_get_value(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, nn_setsockopt(IGNORED_NUM_ARG, NN_SUB, NN_SUB_UNSUBSCRIBE, IGNORED_PTR_ARG, 1 + sizeof(MODULE_HANDLE)))
+        .IgnoreArgument(1)
+        .IgnoreArgument(4)
+        .SetFailReturn(-1);
+
+    ///act
+    result = Broker_RemoveLink(broker, &bld);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, result, BROKER_REMOVE_LINK_ERROR);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    Broker_RemoveModule(broker, &fake_module);
+    Broker_Destroy(broker);
+}
+
+TEST_FUNCTION(Broker_RemoveLink_fails_source_find_fails)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    auto broker = Broker_Create();
+    auto result = Broker_AddModule(broker, &fake_module);
+    BROKER_LINK_DATA bld =
+    {
+        fake_module_handle,
+        fake_module_handle
+    };
+    result = Broker_AddLink(broker, &bld);
+
+    mocks.ResetAllCalls();
+
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_find(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2)
+        .IgnoreArgument(3);
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_item_get_value(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_item_get_value(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_find(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2)
+        .IgnoreArgument(3)
+        .SetFailReturn(nullptr);
+
+    ///act
+    result = Broker_RemoveLink(broker, &bld);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, result, BROKER_REMOVE_LINK_ERROR);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    Broker_RemoveModule(broker, &fake_module);
+    Broker_Destroy(broker);
+}
+
+
+//Tests_SRS_BROKER_17_040: [ Upon an error, Broker_RemoveLink shall return BROKER_REMOVE_LINK_ERROR. ]
+TEST_FUNCTION(Broker_RemoveLink_fails_singlylinkedlist_find_fails)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    auto broker = Broker_Create();
+    auto result = Broker_AddModule(broker, &fake_module);
+    BROKER_LINK_DATA bld =
+    {
+        fake_module_handle,
+        fake_module_handle
+    };
+    result = Broker_AddLink(broker, &bld);
+
+    mocks.ResetAllCalls();
+
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_find(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2)
+        .IgnoreArgument(3)
+        .SetFailReturn(nullptr);
+
+    ///act
+    result = Broker_RemoveLink(broker, &bld);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, result, BROKER_REMOVE_LINK_ERROR);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    Broker_RemoveModule(broker, &fake_module);
+    Broker_Destroy(broker);
+}
+
+//Tests_SRS_BROKER_17_040: [ Upon an error, Broker_RemoveLink shall return BROKER_REMOVE_LINK_ERROR. ]
+TEST_FUNCTION(Broker_RemoveLink_fails_lock_fails)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    auto broker = Broker_Create();
+    auto result = Broker_AddModule(broker, &fake_module);
+    BROKER_LINK_DATA bld =
+    {
+        fake_module_handle,
+        fake_module_handle
+    };
+    result = Broker_AddLink(broker, &bld);
+
+    mocks.ResetAllCalls();
+
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .SetFailReturn(LOCK_ERROR);
+
+    ///act
+    result = Broker_RemoveLink(broker, &bld);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, result, BROKER_REMOVE_LINK_ERROR);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    Broker_RemoveModule(broker, &fake_module);
+    Broker_Destroy(broker);
+}
+
+//Tests_SRS_BROKER_17_075: [ If broker or sink are NULL, Broker_AddAnySourceLink shall return BROKER_INVALIDARG. ]
+TEST_FUNCTION(Broker_AddAnySourceLink_fails_with_null_inputs)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    auto broker = Broker_Create();
+    mocks.ResetAllCalls();
+
+    ///act
+    auto result1 = Broker_AddAnySourceLink(NULL, fake_module_handle);
+    auto result2 = Broker_AddAnySourceLink(broker, NULL);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, result1, BROKER_INVALIDARG);
+    ASSERT_ARE_EQUAL(BROKER_RESULT, result2, BROKER_INVALIDARG);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    Broker_Destroy(broker);
+}
+
+//Tests_SRS_BROKER_17_076: [ Broker_AddAnySourceLink shall find the module_info for sink while holding the modules_lock. ]
+//Tests_SRS_BROKER_17_077: [ When sink gets its first any-source link, Broker_AddAnySourceLink shall subscribe module_info->receive_socket to the message tag, so to every message but no quit signal. ]
+TEST_FUNCTION(Broker_AddAnySourceLink_succeeds)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    auto broker = Broker_Create();
+    (void)Broker_AddModule(broker, &fake_module);
+    mocks.ResetAllCalls();
+
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_find(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2)
+        .IgnoreArgument(3);
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_item_get_value(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_item_get_value(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, nn_setsockopt(IGNORED_NUM_ARG, NN_SUB, NN_SUB_SUBSCRIBE, IGNORED_PTR_ARG, 1))
+        .IgnoreArgument(1)
+        .IgnoreArgument(4);
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+
+    ///act
+    auto result = Broker_AddAnySourceLink(broker, fake_module_handle);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, result, BROKER_OK);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    Broker_RemoveModule(broker, &fake_module);
+    Broker_Destroy(broker);
+}
+
+//Tests_SRS_BROKER_17_077: [ When sink gets its first any-source link, Broker_AddAnySourceLink shall subscribe module_info->receive_socket to the message tag, so to every message but no quit signal. ]
+TEST_FUNCTION(Broker_AddAnySourceLink_subscribes_once)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    auto broker = Broker_Create();
+    (void)Broker_AddModule(broker, &fake_module);
+    (void)Broker_AddAnySourceLink(broker, fake_module_handle);
+    mocks.ResetAllCalls();
+
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_find(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2)
+        .IgnoreArgument(3);
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_item_get_value(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_item_get_value(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+
+    ///act
+    auto result = Broker_AddAnySourceLink(broker, fake_module_handle);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, result, BROKER_OK);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    Broker_RemoveModule(broker, &fake_module);
+    Broker_Destroy(broker);
+}
+
+//Tests_SRS_BROKER_17_078: [ Upon an error, Broker_AddAnySourceLink shall return BROKER_ADD_LINK_ERROR. ]
+TEST_FUNCTION(Broker_AddAnySourceLink_fails_setsockopt_fails)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    auto broker = Broker_Create();
+    (void)Broker_AddModule(broker, &fake_module);
+    mocks.ResetAllCalls();
+
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_find(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2)
+        .IgnoreArgument(3);
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_item_get_value(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_item_get_value(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, nn_setsockopt(IGNORED_NUM_ARG, NN_SUB, NN_SUB_SUBSCRIBE, IGNORED_PTR_ARG, 1))
+        .IgnoreArgument(1)
+        .IgnoreArgument(4)
+        .SetFailReturn(-1);
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+
+    ///act
+    auto result = Broker_AddAnySourceLink(broker, fake_module_handle);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, result, BROKER_ADD_LINK_ERROR);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    Broker_RemoveModule(broker, &fake_module);
+    Broker_Destroy(broker);
+}
+
+//Tests_SRS_BROKER_17_078: [ Upon an error, Broker_AddAnySourceLink shall return BROKER_ADD_LINK_ERROR. ]
+TEST_FUNCTION(Broker_AddAnySourceLink_fails_singlylinkedlist_find_fails)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    auto broker = Broker_Create();
+    (void)Broker_AddModule(broker, &fake_module);
+    mocks.ResetAllCalls();
+
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_find(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2)
+        .IgnoreArgument(3)
+        .SetFailReturn(nullptr);
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+
+    ///act
+    auto result = Broker_AddAnySourceLink(broker, fake_module_handle);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, result, BROKER_ADD_LINK_ERROR);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    Broker_RemoveModule(broker, &fake_module);
+    Broker_Destroy(broker);
+}
+
+//Tests_SRS_BROKER_17_079: [ If broker or sink are NULL, Broker_RemoveAnySourceLink shall return BROKER_INVALIDARG. ]
+TEST_FUNCTION(Broker_RemoveAnySourceLink_fails_with_null_inputs)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    auto broker = Broker_Create();
+    mocks.ResetAllCalls();
+
+    ///act
+    auto result1 = Broker_RemoveAnySourceLink(NULL, fake_module_handle);
+    auto result2 = Broker_RemoveAnySourceLink(broker, NULL);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, result1, BROKER_INVALIDARG);
+    ASSERT_ARE_EQUAL(BROKER_RESULT, result2, BROKER_INVALIDARG);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    Broker_Destroy(broker);
+}
+
+//Tests_SRS_BROKER_17_082: [ When the last any-source link of sink is removed, Broker_RemoveAnySourceLink shall unsubscribe module_info->receive_socket from the message tag. ]
+TEST_FUNCTION(Broker_RemoveAnySourceLink_succeeds)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    auto broker = Broker_Create();
+    (void)Broker_AddModule(broker, &fake_module);
+    (void)Broker_AddAnySourceLink(broker, fake_module_handle);
+    mocks.ResetAllCalls();
+
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_find(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2)
+        .IgnoreArgument(3);
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_item_get_value(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_item_get_value(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, nn_setsockopt(IGNORED_NUM_ARG, NN_SUB, NN_SUB_UNSUBSCRIBE, IGNORED_PTR_ARG, 1))
+        .IgnoreArgument(1)
+        .IgnoreArgument(4);
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+
+    ///act
+    auto result = Broker_RemoveAnySourceLink(broker, fake_module_handle);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, result, BROKER_OK);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    Broker_RemoveModule(broker, &fake_module);
+    Broker_Destroy(broker);
+}
+
+//Tests_SRS_BROKER_17_080: [ Upon an error, Broker_RemoveAnySourceLink shall return BROKER_REMOVE_LINK_ERROR. ]
+TEST_FUNCTION(Broker_RemoveAnySourceLink_fails_without_link)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    auto broker = Broker_Create();
+    (void)Broker_AddModule(broker, &fake_module);
+    mocks.ResetAllCalls();
+
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_find(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2)
+        .IgnoreArgument(3);
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_item_get_value(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_item_get_value(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+
+    ///act
+    auto result = Broker_RemoveAnySourceLink(broker, fake_module_handle);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, result, BROKER_REMOVE_LINK_ERROR);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    Broker_RemoveModule(broker, &fake_module);
+    Broker_Destroy(broker);
+}
+
+//Tests_SRS_BROKER_17_080: [ Upon an error, Broker_RemoveAnySourceLink shall return BROKER_REMOVE_LINK_ERROR. ]
+TEST_FUNCTION(Broker_RemoveAnySourceLink_fails_sockopt_fails)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    auto broker = Broker_Create();
+    (void)Broker_AddModule(broker, &fake_module);
+    (void)Broker_AddAnySourceLink(broker, fake_module_handle);
+    mocks.ResetAllCalls();
+
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_find(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2)
+        .IgnoreArgument(3);
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_item_get_value(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_item_get_value(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, nn_setsockopt(IGNORED_NUM_ARG, NN_SUB, NN_SUB_UNSUBSCRIBE, IGNORED_PTR_ARG, 1))
+        .IgnoreArgument(1)
+        .IgnoreArgument(4)
+        .SetFailReturn(-1);
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+
+    ///act
+    auto result = Broker_RemoveAnySourceLink(broker, fake_module_handle);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, result, BROKER_REMOVE_LINK_ERROR);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    Broker_RemoveModule(broker, &fake_module);
+    Broker_Destroy(broker);
+}
+
+//Tests_SRS_BROKER_17_046: [ If broker, module or metrics are NULL, Broker_GetModuleMetrics shall return BROKER_INVALIDARG. ]
+TEST_FUNCTION(Broker_GetModuleMetrics_fails_with_null_inputs)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    auto broker = Broker_Create();
+    BROKER_MODULE_METRICS metrics;
+    mocks.ResetAllCalls();
+
+    ///act
+    auto result1 = Broker_GetModuleMetrics(NULL, fake_module_handle, &metrics);
+    auto result2 = Broker_GetModuleMetrics(broker, NULL, &metrics);
+    auto result3 = Broker_GetModuleMetrics(broker, fake_module_handle, NULL);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, result1, BROKER_INVALIDARG);
+    ASSERT_ARE_EQUAL(BROKER_RESULT, result2, BROKER_INVALIDARG);
+    ASSERT_ARE_EQUAL(BROKER_RESULT, result3, BROKER_INVALIDARG);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    Broker_Destroy(broker);
+}
+
+//Tests_SRS_BROKER_17_047: [ Broker_GetModuleMetrics shall lock the modules_lock. ]
+//Tests_SRS_BROKER_17_048: [ Broker_GetModuleMetrics shall find the module_info for module. ]
+//Tests_SRS_BROKER_17_049: [ Broker_GetModuleMetrics shall copy the counters of the module into metrics. ]
+//Tests_SRS_BROKER_17_051: [ Broker_GetModuleMetrics shall unlock the modules_lock. ]
+//Tests_SRS_BROKER_17_053: [ Broker_GetModuleMetrics shall set receive_elapsed_us to the time spent in the current Module_Receive call, or 0 if there is none. ]
+TEST_FUNCTION(Broker_GetModuleMetrics_succeeds)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    auto broker = Broker_Create();
+    auto result = Broker_AddModule(broker, &fake_module);
+    BROKER_MODULE_METRICS metrics;
+    memset(&metrics, 0xFF, sizeof(metrics));
+
+    mocks.ResetAllCalls();
+
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_find(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2)
+        .IgnoreArgument(3);
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_item_get_value(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_item_get_value(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+
+    ///act
+    result = Broker_GetModuleMetrics(broker, fake_module_handle, &metrics);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, result, BROKER_OK);
+    ASSERT_ARE_EQUAL(size_t, 0, metrics.messages_received);
+    ASSERT_ARE_EQUAL(size_t, 0, metrics.messages_dropped);
+    for (size_t i = 0; i < BROKER_LATENCY_BUCKET_COUNT; i++)
+    {
+        ASSERT_ARE_EQUAL(size_t, 0, metrics.latency_buckets[i]);
+    }
+    ASSERT_IS_TRUE(metrics.receive_elapsed_us == 0);
+    ASSERT_IS_TRUE(metrics.receive_cpu_us == 0);
+    ASSERT_ARE_EQUAL(size_t, 0, metrics.memory_live_bytes);
+    ASSERT_ARE_EQUAL(size_t, 0, metrics.memory_budget);
+    ASSERT_ARE_EQUAL(size_t, 0, metrics.messages_shed);
+    ASSERT_IS_TRUE(metrics.queue_wait_us == 0);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    Broker_RemoveModule(broker, &fake_module);
+    Broker_Destroy(broker);
+}
+
+//Tests_SRS_BROKER_17_050: [ Upon an error, Broker_GetModuleMetrics shall return BROKER_ERROR. ]
+TEST_FUNCTION(Broker_GetModuleMetrics_fails_for_unknown_module)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    auto broker = Broker_Create();
+    BROKER_MODULE_METRICS metrics;
+
+    mocks.ResetAllCalls();
+
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_find(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2)
+        .IgnoreArgument(3);
+
+    ///act
+    auto result = Broker_GetModuleMetrics(broker, fake_module_handle, &metrics);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, result, BROKER_ERROR);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    Broker_Destroy(broker);
+}
+
+//Tests_SRS_BROKER_17_050: [ Upon an error, Broker_GetModuleMetrics shall return BROKER_ERROR. ]
+TEST_FUNCTION(Broker_GetModuleMetrics_fails_lock_fails)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    auto broker = Broker_Create();
+    auto result = Broker_AddModule(broker, &fake_module);
+    BROKER_MODULE_METRICS metrics;
+
+    mocks.ResetAllCalls();
+
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .SetFailReturn(LOCK_ERROR);
+
+    ///act
+    result = Broker_GetModuleMetrics(broker, fake_module_handle, &metrics);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, result, BROKER_ERROR);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    Broker_RemoveModule(broker, &fake_module);
+    Broker_Destroy(broker);
+}
+
+//Tests_SRS_BROKER_17_059: [ If broker or module is NULL, Broker_SetModuleMemoryBudget shall return BROKER_INVALIDARG. ]
+TEST_FUNCTION(Broker_SetModuleMemoryBudget_fails_with_null_inputs)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    auto broker = Broker_Create();
+    mocks.ResetAllCalls();
+
+    ///act
+    auto result1 = Broker_SetModuleMemoryBudget(NULL, fake_module_handle, 10);
+    auto result2 = Broker_SetModuleMemoryBudget(broker, NULL, 10);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, result1, BROKER_INVALIDARG);
+    ASSERT_ARE_EQUAL(BROKER_RESULT, result2, BROKER_INVALIDARG);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    Broker_Destroy(broker);
+}
+
+//Tests_SRS_BROKER_17_060: [ Broker_SetModuleMemoryBudget shall find the module_info for module under the modules_lock. ]
+//Tests_SRS_BROKER_17_061: [ Broker_SetModuleMemoryBudget shall set the memory budget of the module to budget_bytes, 0 meaning no budget, and return BROKER_OK. ]
+TEST_FUNCTION(Broker_SetModuleMemoryBudget_succeeds)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    auto broker = Broker_Create();
+    auto result = Broker_AddModule(broker, &fake_module);
+    BROKER_MODULE_METRICS metrics;
+
+    mocks.ResetAllCalls();
+
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_find(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2)
+        .IgnoreArgument(3);
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_item_get_value(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_item_get_value(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+
+    ///act
+    result = Broker_SetModuleMemoryBudget(broker, fake_module_handle, 4096);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, result, BROKER_OK);
+    mocks.AssertActualAndExpectedCalls();
+    ASSERT_ARE_EQUAL(BROKER_RESULT, BROKER_OK, Broker_GetModuleMetrics(broker, fake_module_handle, &metrics));
+    ASSERT_ARE_EQUAL(size_t, 4096, metrics.memory_budget);
+
+    ///cleanup
+    Broker_RemoveModule(broker, &fake_module);
+    Broker_Destroy(broker);
+}
+
+//Tests_SRS_BROKER_17_062: [ Upon an error, Broker_SetModuleMemoryBudget shall return BROKER_ERROR. ]
+TEST_FUNCTION(Broker_SetModuleMemoryBudget_fails_for_unknown_module)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    auto broker = Broker_Create();
+
+    mocks.ResetAllCalls();
+
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_find(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2)
+        .IgnoreArgument(3);
+
+    ///act
+    auto result = Broker_SetModuleMemoryBudget(broker, fake_module_handle, 4096);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, result, BROKER_ERROR);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    Broker_Destroy(broker);
+}
+
+//Tests_SRS_BROKER_17_062: [ Upon an error, Broker_SetModuleMemoryBudget shall return BROKER_ERROR. ]
+TEST_FUNCTION(Broker_SetModuleMemoryBudget_fails_lock_fails)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    auto broker = Broker_Create();
+    auto result = Broker_AddModule(broker, &fake_module);
+
+    mocks.ResetAllCalls();
+
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .SetFailReturn(LOCK_ERROR);
+
+    ///act
+    result = Broker_SetModuleMemoryBudget(broker, fake_module_handle, 4096);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, result, BROKER_ERROR);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    Broker_RemoveModule(broker, &fake_module);
+    Broker_Destroy(broker);
+}
+
+//Tests_SRS_BROKER_17_095: [ If broker or module is NULL, Broker_ReportDroppedMessages shall return BROKER_INVALIDARG. ]
+TEST_FUNCTION(Broker_ReportDroppedMessages_fails_with_null_inputs)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    auto broker = Broker_Create();
+    mocks.ResetAllCalls();
+
+    ///act
+    auto result1 = Broker_ReportDroppedMessages(NULL, fake_module_handle, 1);
+    auto result2 = Broker_ReportDroppedMessages(broker, NULL, 1);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, result1, BROKER_INVALIDARG);
+    ASSERT_ARE_EQUAL(BROKER_RESULT, result2, BROKER_INVALIDARG);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    Broker_Destroy(broker);
+}
+
+//Tests_SRS_BROKER_17_096: [ Broker_ReportDroppedMessages shall find the module_info for module, or for the module module publishes for, under the modules_lock. ]
+//Tests_SRS_BROKER_17_097: [ Broker_ReportDroppedMessages shall add count to the messages the module dropped and return BROKER_OK. ]
+TEST_FUNCTION(Broker_ReportDroppedMessages_succeeds)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    auto broker = Broker_Create();
+    auto result = Broker_AddModule(broker, &fake_module);
+    BROKER_MODULE_METRICS metrics;
+
+    mocks.ResetAllCalls();
+
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_find(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2)
+        .IgnoreArgument(3);
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_item_get_value(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_item_get_value(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+
+    ///act
+    result = Broker_ReportDroppedMessages(broker, fake_module_handle, 3);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, result, BROKER_OK);
+    mocks.AssertActualAndExpectedCalls();
+    ASSERT_ARE_EQUAL(BROKER_RESULT, BROKER_OK, Broker_GetModuleMetrics(broker, fake_module_handle, &metrics));
+    ASSERT_ARE_EQUAL(size_t, 3, metrics.messages_dropped);
+
+    ///cleanup
+    Broker_RemoveModule(broker, &fake_module);
+    Broker_Destroy(broker);
+}
+
+//Tests_SRS_BROKER_17_098: [ Upon an error, Broker_ReportDroppedMessages shall return BROKER_ERROR. ]
+TEST_FUNCTION(Broker_ReportDroppedMessages_fails_for_unknown_module)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    auto broker = Broker_Create();
+
+    mocks.ResetAllCalls();
+
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_find(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2)
+        .IgnoreArgument(3);
+
+    ///act
+    auto result = Broker_ReportDroppedMessages(broker, fake_module_handle, 3);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, result, BROKER_ERROR);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    Broker_Destroy(broker);
+}
+
+//Tests_SRS_BROKER_17_098: [ Upon an error, Broker_ReportDroppedMessages shall return BROKER_ERROR. ]
+TEST_FUNCTION(Broker_ReportDroppedMessages_fails_lock_fails)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    auto broker = Broker_Create();
+    auto result = Broker_AddModule(broker, &fake_module);
+
+    mocks.ResetAllCalls();
+
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .SetFailReturn(LOCK_ERROR);
+
+    ///act
+    result = Broker_ReportDroppedMessages(broker, fake_module_handle, 3);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, result, BROKER_ERROR);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    Broker_RemoveModule(broker, &fake_module);
+    Broker_Destroy(broker);
+}
+
+//Tests_SRS_BROKER_17_070: [ If broker, module or shedding is NULL, Broker_SetModuleShedding shall return BROKER_INVALIDARG. ]
+TEST_FUNCTION(Broker_SetModuleShedding_fails_with_null_inputs)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    auto broker = Broker_Create();
+    BROKER_MODULE_SHEDDING shedding = { true, 0, false };
+    mocks.ResetAllCalls();
+
+    ///act
+    auto result1 = Broker_SetModuleShedding(NULL, fake_module_handle, &shedding);
+    auto result2 = Broker_SetModuleShedding(broker, NULL, &shedding);
+    auto result3 = Broker_SetModuleShedding(broker, fake_module_handle, NULL);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, result1, BROKER_INVALIDARG);
+    ASSERT_ARE_EQUAL(BROKER_RESULT, result2, BROKER_INVALIDARG);
+    ASSERT_ARE_EQUAL(BROKER_RESULT, result3, BROKER_INVALIDARG);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    Broker_Destroy(broker);
+}
+
+//Tests_SRS_BROKER_17_071: [ Broker_SetModuleShedding shall find the module_info for module under the modules_lock. ]
+//Tests_SRS_BROKER_17_072: [ Broker_SetModuleShedding shall copy shedding into the module_info and return BROKER_OK. ]
+TEST_FUNCTION(Broker_SetModuleShedding_succeeds)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    auto broker = Broker_Create();
+    auto result = Broker_AddModule(broker, &fake_module);
+    BROKER_MODULE_SHEDDING shedding = { true, 0, true };
+
+    mocks.ResetAllCalls();
+
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_find(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2)
+        .IgnoreArgument(3);
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_item_get_value(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_item_get_value(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+
+    ///act
+    result = Broker_SetModuleShedding(broker, fake_module_handle, &shedding);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, result, BROKER_OK);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    Broker_RemoveModule(broker, &fake_module);
+    Broker_Destroy(broker);
+}
+
+//Tests_SRS_BROKER_17_073: [ Upon an error, Broker_SetModuleShedding shall return BROKER_ERROR. ]
+TEST_FUNCTION(Broker_SetModuleShedding_fails_for_unknown_module)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    auto broker = Broker_Create();
+    BROKER_MODULE_SHEDDING shedding = { true, 0, false };
+
+    mocks.ResetAllCalls();
+
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_find(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2)
+        .IgnoreArgument(3);
+
+    ///act
+    auto result = Broker_SetModuleShedding(broker, fake_module_handle, &shedding);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, result, BROKER_ERROR);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    Broker_Destroy(broker);
+}
+
+//Tests_SRS_BROKER_17_073: [ Upon an error, Broker_SetModuleShedding shall return BROKER_ERROR. ]
+TEST_FUNCTION(Broker_SetModuleShedding_fails_lock_fails)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    auto broker = Broker_Create();
+    auto result = Broker_AddModule(broker, &fake_module);
+    BROKER_MODULE_SHEDDING shedding = { true, 0, false };
+
+    mocks.ResetAllCalls();
+
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .SetFailReturn(LOCK_ERROR);
+
+    ///act
+    result = Broker_SetModuleShedding(broker, fake_module_handle, &shedding);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, result, BROKER_ERROR);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    Broker_RemoveModule(broker, &fake_module);
+    Broker_Destroy(broker);
+}
+
+//Tests_SRS_BROKER_17_083: [ If broker or module is NULL, Broker_SetModulePublisher shall return BROKER_INVALIDARG. ]
+TEST_FUNCTION(Broker_SetModulePublisher_fails_with_null_inputs)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    auto broker = Broker_Create();
+    mocks.ResetAllCalls();
+
+    ///act
+    auto result1 = Broker_SetModulePublisher(NULL, fake_module_handle, (MODULE_HANDLE)0x42);
+    auto result2 = Broker_SetModulePublisher(broker, NULL, (MODULE_HANDLE)0x42);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, result1, BROKER_INVALIDARG);
+    ASSERT_ARE_EQUAL(BROKER_RESULT, result2, BROKER_INVALIDARG);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    Broker_Destroy(broker);
+}
+
+//Tests_SRS_BROKER_17_084: [ Broker_SetModulePublisher shall find the module_info for module under the modules_lock. ]
+//Tests_SRS_BROKER_17_085: [ Broker_SetModulePublisher shall set publisher as the publisher of module, NULL removing it, and return BROKER_OK. ]
+TEST_FUNCTION(Broker_SetModulePublisher_succeeds)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    auto broker = Broker_Create();
+    auto result = Broker_AddModule(broker, &fake_module);
+
+    mocks.ResetAllCalls();
+
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_find(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2)
+        .IgnoreArgument(3);
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_item_get_value(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_item_get_value(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+
+    ///act
+    result = Broker_SetModulePublisher(broker, fake_module_handle, (MODULE_HANDLE)0x42);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, result, BROKER_OK);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    Broker_RemoveModule(broker, &fake_module);
+    Broker_Destroy(broker);
+}
+
+//Tests_SRS_BROKER_17_086: [ Upon an error, Broker_SetModulePublisher shall return BROKER_ERROR. ]
+TEST_FUNCTION(Broker_SetModulePublisher_fails_for_unknown_module)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    auto broker = Broker_Create();
+
+    mocks.ResetAllCalls();
+
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_find(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2)
+        .IgnoreArgument(3);
+
+    ///act
+    auto result = Broker_SetModulePublisher(broker, fake_module_handle, (MODULE_HANDLE)0x42);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, result, BROKER_ERROR);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    Broker_Destroy(broker);
+}
+
+//Tests_SRS_BROKER_17_086: [ Upon an error, Broker_SetModulePublisher shall return BROKER_ERROR. ]
+TEST_FUNCTION(Broker_SetModulePublisher_fails_lock_fails)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    auto broker = Broker_Create();
+    auto result = Broker_AddModule(broker, &fake_module);
+
+    mocks.ResetAllCalls();
+
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .SetFailReturn(LOCK_ERROR);
+
+    ///act
+    result = Broker_SetModulePublisher(broker, fake_module_handle, (MODULE_HANDLE)0x42);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, result, BROKER_ERROR);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    Broker_RemoveModule(broker, &fake_module);
+    Broker_Destroy(broker);
+}
+
+//Tests_SRS_BROKER_17_088: [ If broker, module or drain is NULL, Broker_DrainModule shall return BROKER_INVALIDARG. ]
+TEST_FUNCTION(Broker_DrainModule_fails_with_null_inputs)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    auto broker = Broker_Create();
+    BROKER_MODULE_DRAIN drain;
+    mocks.ResetAllCalls();
+
+    ///act
+    auto result1 = Broker_DrainModule(NULL, fake_module_handle, 100, &drain);
+    auto result2 = Broker_DrainModule(broker, NULL, 100, &drain);
+    auto result3 = Broker_DrainModule(broker, fake_module_handle, 100, NULL);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, result1, BROKER_INVALIDARG);
+    ASSERT_ARE_EQUAL(BROKER_RESULT, result2, BROKER_INVALIDARG);
+    ASSERT_ARE_EQUAL(BROKER_RESULT, result3, BROKER_INVALIDARG);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    Broker_Destroy(broker);
+}
+
+//Tests_SRS_BROKER_17_089: [ Broker_DrainModule shall find the module_info for module under the modules_lock and send its quit signal to the publish_socket, so the worker delivers the messages queued before it and exits. ]
+//Tests_SRS_BROKER_17_090: [ Broker_DrainModule shall wait on the drain condition at most timeout_ms for the worker to exit. ]
+//Tests_SRS_BROKER_17_093: [ Broker_DrainModule shall fill drain with the messages delivered and abandoned meanwhile, pause the publishing of the module and return BROKER_OK. ]
+TEST_FUNCTION(Broker_DrainModule_succeeds_once_the_worker_exited)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    auto broker = Broker_Create();
+    auto result = Broker_AddModule(broker, &fake_module);
+    BROKER_MODULE_DRAIN drain = { 42, 42 };
+
+    // let the worker exit
+    STRICT_EXPECTED_CALL(mocks, nn_recv(IGNORED_NUM_ARG, IGNORED_PTR_ARG, NN_MSG, 0))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2)
+        .SetFailReturn(-1);
+    (void)thread_func_to_call(thread_func_args);
+
+    mocks.ResetAllCalls();
+
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_find(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2)
+        .IgnoreArgument(3);
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_item_get_value(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_item_get_value(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, nn_send(IGNORED_NUM_ARG, IGNORED_PTR_ARG, 38, 0))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG)) /*this is for the drain lock*/
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+
+    ///act
+    result = Broker_DrainModule(broker, fake_module_handle, 100, &drain);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, result, BROKER_OK);
+    ASSERT_ARE_EQUAL(size_t, 0, drain.messages_drained);
+    ASSERT_ARE_EQUAL(size_t, 0, drain.messages_abandoned);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    Broker_RemoveModule(broker, &fake_module);
+    Broker_Destroy(broker);
+}
+
+//Tests_SRS_BROKER_17_092: [ If the worker did not exit by then, Broker_DrainModule shall have it abandon what is still queued, and wait for the Module_Receive call it is inside of, if any, to return. ]
+TEST_FUNCTION(Broker_DrainModule_abandons_the_queue_after_the_deadline)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    auto broker = Broker_Create();
+    auto result = Broker_AddModule(broker, &fake_module);
+    BROKER_MODULE_DRAIN drain;
+
+    mocks.ResetAllCalls();
+
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_find(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2)
+        .IgnoreArgument(3);
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_item_get_value(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_item_get_value(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, nn_send(IGNORED_NUM_ARG, IGNORED_PTR_ARG, 38, 0))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2);
+    // the worker never runs and is not inside Module_Receive, so it is not waited for
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG)) /*this is for the drain lock*/
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+
+    ///act
+    result = Broker_DrainModule(broker, fake_module_handle, 0, &drain);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, result, BROKER_OK);
+    ASSERT_ARE_EQUAL(size_t, 0, drain.messages_drained);
+    ASSERT_ARE_EQUAL(size_t, 0, drain.messages_abandoned);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    Broker_RemoveModule(broker, &fake_module);
+    Broker_Destroy(broker);
+}
+
+static void worker_exits(void)
+{
+    (void)thread_func_to_call(thread_func_args);
+}
+
+static BROKER_HANDLE broker_removing_module;
+
+static void worker_exits_and_module_is_removed(void)
+{
+    (void)thread_func_to_call(thread_func_args);
+    (void)Broker_RemoveModule(broker_removing_module, &fake_module);
+}
+
+//Tests_SRS_BROKER_17_090: [ Broker_DrainModule shall wait on the drain condition at most timeout_ms for the worker to exit. ]
+//Tests_SRS_BROKER_17_099: [ Once it left its loop, the function shall set worker_exited under the drain_lock and signal the drain condition. ]
+TEST_FUNCTION(Broker_DrainModule_waits_on_the_drain_condition_for_the_worker)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    auto broker = Broker_Create();
+    auto result = Broker_AddModule(broker, &fake_module);
+    BROKER_MODULE_DRAIN drain = { 42, 42 };
+    on_Condition_Wait = worker_exits;
+
+    mocks.ResetAllCalls();
+
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_find(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2)
+        .IgnoreArgument(3);
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_item_get_value(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_item_get_value(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, nn_send(IGNORED_NUM_ARG, IGNORED_PTR_ARG, 38, 0))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG)) /*this is for the drain lock*/
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    // the worker exits while the drain waits
+    STRICT_EXPECTED_CALL(mocks, Condition_Wait(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG))
+        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, nn_recv(IGNORED_NUM_ARG, IGNORED_PTR_ARG, NN_MSG, 0))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2)
+        .SetFailReturn(-1);
+    STRICT_EXPECTED_CALL(mocks, nn_errno());
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Condition_Post(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+
+    ///act
+    result = Broker_DrainModule(broker, fake_module_handle, 1000, &drain);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, result, BROKER_OK);
+    ASSERT_ARE_EQUAL(size_t, 0, drain.messages_drained);
+    ASSERT_ARE_EQUAL(size_t, 0, drain.messages_abandoned);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    Broker_RemoveModule(broker, &fake_module);
+    Broker_Destroy(broker);
+}
+
+//Tests_SRS_BROKER_17_101: [ Broker_DrainModule shall hold a reference to the module_info while it waits, and release it under the modules_lock, so a module removed meanwhile is only freed once it is done. ]
+TEST_FUNCTION(Broker_DrainModule_frees_a_module_removed_while_it_waits)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    auto broker = Broker_Create();
+    auto result = Broker_AddModule(broker, &fake_module);
+    BROKER_MODULE_DRAIN drain;
+    broker_removing_module = broker;
+    on_Condition_Wait = worker_exits_and_module_is_removed;
+
+    mocks.ResetAllCalls();
+
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_find(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2)
+        .IgnoreArgument(3);
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_item_get_value(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_item_get_value(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, nn_send(IGNORED_NUM_ARG, IGNORED_PTR_ARG, 38, 0))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG)) /*this is for the drain lock*/
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    // the worker exits while the drain waits
+    STRICT_EXPECTED_CALL(mocks, Condition_Wait(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG))
+        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, nn_recv(IGNORED_NUM_ARG, IGNORED_PTR_ARG, NN_MSG, 0))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2)
+        .SetFailReturn(-1);
+    STRICT_EXPECTED_CALL(mocks, nn_errno());
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Condition_Post(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    // Broker_RemoveModule, which leaves the module_info to the drain
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_find(IGNORED_PTR_ARG, IGNORED_PTR_ARG, &fake_module))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_item_get_value(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_item_get_value(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, nn_send(IGNORED_NUM_ARG, IGNORED_PTR_ARG, 38, 0))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, nn_close(IGNORED_NUM_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, ThreadAPI_Join(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(mocks, Lock_Deinit(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_remove(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG)) /*this is for the module struct*/
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG)) /*this is for the memory account*/
+        .IgnoreArgument(1);
+    // the drain frees the module_info once it is done
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG)) /*this is for the module_info*/
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Lock_Deinit(IGNORED_PTR_ARG)) /*this is for the drain lock*/
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Condition_Deinit(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+
+    ///act
+    result = Broker_DrainModule(broker, fake_module_handle, 1000, &drain);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, result, BROKER_OK);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    Broker_Destroy(broker);
+}
+
+//Tests_SRS_BROKER_17_091: [ Once the deadline of Broker_DrainModule passed, the function shall discard the messages it receives and count them as abandoned. ]
+TEST_FUNCTION(module_publish_worker_abandons_messages_after_the_drain_deadline)
+{
+    CBrokerMocks mocks;
+    auto broker = Broker_Create();
+    BROKER_MODULE_DRAIN drain;
+
+    (void)Broker_AddModule(broker, &fake_module);
+    (void)Broker_DrainModule(broker, fake_module_handle, 0, &drain);
+
+    mocks.ResetAllCalls();
+
+    //loop 1, the message is not delivered
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, nn_recv(IGNORED_NUM_ARG, IGNORED_PTR_ARG, NN_MSG, 0))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(mocks, nn_freemsg(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+
+    //loop 2
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, nn_recv(IGNORED_NUM_ARG, IGNORED_PTR_ARG, NN_MSG, 0))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2)
+        .SetFailReturn(-1);
+    STRICT_EXPECTED_CALL(mocks, nn_errno());
+
+    // worker exit
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG)) /*this is for the drain lock*/
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Condition_Post(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+
+    auto result = thread_func_to_call(thread_func_args);
+
+    ASSERT_ARE_EQUAL(int, result, 0);
     mocks.AssertActualAndExpectedCalls();
 
     ///cleanup
-
+    Broker_RemoveModule(broker, &fake_module);
+    Broker_Destroy(broker);
 }
 
-//Tests_SRS_BROKER_17_036: [ Broker_RemoveLink shall lock the modules_lock. ]
-//Tests_SRS_BROKER_17_037: [ Broker_RemoveLink shall find the module_info for link->module_sink_handle. ]
-//Tests_SRS_BROKER_17_042: [ Broker_RemoveLink shall find the module_info for link->module_source_handle. ]
-//Tests_SRS_BROKER_17_038: [ Broker_RemoveLink shall unsubscribe module_info->receive_socket from the link->module_source_handle module handle. ]
-//Tests_SRS_BROKER_17_039: [ Broker_RemoveLink shall unlock the modules_lock. ]
-TEST_FUNCTION(Broker_RemoveLink_succeeds)
+//Tests_SRS_BROKER_17_094: [ Upon an error, Broker_DrainModule shall return BROKER_ERROR. ]
+TEST_FUNCTION(Broker_DrainModule_fails_for_unknown_module)
 {
     ///arrange
     CBrokerMocks mocks;
     auto broker = Broker_Create();
-    auto result = Broker_AddModule(broker, &fake_module);
-    BROKER_LINK_DATA bld =
-    {
-        fake_module_handle,
-        fake_module_handle
-    };
-    result = Broker_AddLink(broker, &bld);
+    BROKER_MODULE_DRAIN drain;
 
     mocks.ResetAllCalls();
 
@@ -2914,48 +5132,26 @@ TEST_FUNCTION(Broker_RemoveLink_succeeds)
         .IgnoreArgument(1)
         .IgnoreArgument(2)
         .IgnoreArgument(3);
-    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_item_get_value(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_item_get_value(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_find(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .IgnoreArgument(1)
-        .IgnoreArgument(2)
-        .IgnoreArgument(3);
-    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_item_get_value(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_item_get_value(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-
-    STRICT_EXPECTED_CALL(mocks, nn_setsockopt(IGNORED_NUM_ARG, NN_SUB, NN_SUB_UNSUBSCRIBE, IGNORED_PTR_ARG, sizeof(MODULE_HANDLE)))
-        .IgnoreArgument(1)
-        .IgnoreArgument(4);
 
     ///act
-    result = Broker_RemoveLink(broker, &bld);
+    auto result = Broker_DrainModule(broker, fake_module_handle, 100, &drain);
 
     ///assert
-    ASSERT_ARE_EQUAL(BROKER_RESULT, result, BROKER_OK);
+    ASSERT_ARE_EQUAL(BROKER_RESULT, result, BROKER_ERROR);
     mocks.AssertActualAndExpectedCalls();
 
     ///cleanup
-    Broker_RemoveModule(broker, &fake_module);
     Broker_Destroy(broker);
 }
 
-//Tests_SRS_BROKER_17_040: [ Upon an error, Broker_RemoveLink shall return BROKER_REMOVE_LINK_ERROR. ]
-TEST_FUNCTION(Broker_RemoveLink_fails_sockopt_fails)
+//Tests_SRS_BROKER_17_094: [ Upon an error, Broker_DrainModule shall return BROKER_ERROR. ]
+TEST_FUNCTION(Broker_DrainModule_fails_when_the_quit_signal_cannot_be_sent)
 {
     ///arrange
     CBrokerMocks mocks;
     auto broker = Broker_Create();
     auto result = Broker_AddModule(broker, &fake_module);
-    BROKER_LINK_DATA bld =
-    {
-        fake_module_handle,
-        fake_module_handle
-    };
-    result = Broker_AddLink(broker, &bld);
+    BROKER_MODULE_DRAIN drain;
 
     mocks.ResetAllCalls();
 
@@ -2971,24 +5167,19 @@ TEST_FUNCTION(Broker_RemoveLink_fails_sockopt_fails)
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, singlylinkedlist_item_get_value(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_find(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .IgnoreArgument(1)
-        .IgnoreArgument(2)
-        .IgnoreArgument(3);
-    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_item_get_value(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_item_get_value(IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(mocks, STRING_c_str(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, nn_setsockopt(IGNORED_NUM_ARG, NN_SUB, NN_SUB_UNSUBSCRIBE, IGNORED_PTR_ARG, sizeof(MODULE_HANDLE)))
+    STRICT_EXPECTED_CALL(mocks, nn_send(IGNORED_NUM_ARG, IGNORED_PTR_ARG, 38, 0))
         .IgnoreArgument(1)
-        .IgnoreArgument(4)
+        .IgnoreArgument(2)
         .SetFailReturn(-1);
+    STRICT_EXPECTED_CALL(mocks, nn_errno());
 
     ///act
-    result = Broker_RemoveLink(broker, &bld);
+    result = Broker_DrainModule(broker, fake_module_handle, 100, &drain);
 
     ///assert
-    ASSERT_ARE_EQUAL(BROKER_RESULT, result, BROKER_REMOVE_LINK_ERROR);
+    ASSERT_ARE_EQUAL(BROKER_RESULT, result, BROKER_ERROR);
     mocks.AssertActualAndExpectedCalls();
 
     ///cleanup
@@ -2996,104 +5187,112 @@ TEST_FUNCTION(Broker_RemoveLink_fails_sockopt_fails)
     Broker_Destroy(broker);
 }
 
-TEST_FUNCTION(Broker_RemoveLink_fails_source_find_fails)
+//Tests_SRS_BROKER_17_063: [ If broker is NULL, Broker_GetTimerService shall return NULL. ]
+TEST_FUNCTION(Broker_GetTimerService_returns_NULL_with_null_broker)
 {
     ///arrange
     CBrokerMocks mocks;
-    auto broker = Broker_Create();
-    auto result = Broker_AddModule(broker, &fake_module);
-    BROKER_LINK_DATA bld =
-    {
-        fake_module_handle,
-        fake_module_handle
-    };
-    result = Broker_AddLink(broker, &bld);
 
+    ///act
+    auto result = Broker_GetTimerService(NULL);
+
+    ///assert
+    ASSERT_IS_NULL(result);
+    mocks.AssertActualAndExpectedCalls();
+}
+
+//Tests_SRS_BROKER_17_064: [ Broker_GetTimerService shall create the timer service of the broker under the modules_lock on the first call and return the same service on every call. ]
+TEST_FUNCTION(Broker_GetTimerService_creates_the_service_once)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    auto broker = Broker_Create();
     mocks.ResetAllCalls();
 
     STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_find(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreArgument(1)
-        .IgnoreArgument(2)
-        .IgnoreArgument(3);
-    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_item_get_value(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_item_get_value(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_find(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .ExpectedTimesExactly(2);
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
         .IgnoreArgument(1)
-        .IgnoreArgument(2)
-        .IgnoreArgument(3)
-        .SetFailReturn(nullptr);
+        .ExpectedTimesExactly(2);
+    STRICT_EXPECTED_CALL(mocks, TimerService_Create());
 
     ///act
-    result = Broker_RemoveLink(broker, &bld);
+    auto first = Broker_GetTimerService(broker);
+    auto second = Broker_GetTimerService(broker);
 
     ///assert
-    ASSERT_ARE_EQUAL(BROKER_RESULT, result, BROKER_REMOVE_LINK_ERROR);
+    ASSERT_IS_NOT_NULL(first);
+    ASSERT_ARE_EQUAL(void_ptr, first, second);
     mocks.AssertActualAndExpectedCalls();
 
     ///cleanup
-    Broker_RemoveModule(broker, &fake_module);
     Broker_Destroy(broker);
 }
 
-
-//Tests_SRS_BROKER_17_040: [ Upon an error, Broker_RemoveLink shall return BROKER_REMOVE_LINK_ERROR. ]
-TEST_FUNCTION(Broker_RemoveLink_fails_singlylinkedlist_find_fails)
+//Tests_SRS_BROKER_17_066: [ Broker_Destroy shall destroy the timer service of the broker, if there is one. ]
+TEST_FUNCTION(Broker_Destroy_destroys_the_timer_service)
 {
     ///arrange
     CBrokerMocks mocks;
     auto broker = Broker_Create();
-    auto result = Broker_AddModule(broker, &fake_module);
-    BROKER_LINK_DATA bld =
-    {
-        fake_module_handle,
-        fake_module_handle
-    };
-    result = Broker_AddLink(broker, &bld);
+    (void)Broker_GetTimerService(broker);
+    mocks.ResetAllCalls();
+
+    STRICT_EXPECTED_CALL(mocks, TimerService_Destroy(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Lock_Deinit(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, nn_close(IGNORED_NUM_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, STRING_delete(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_get_head_item(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_destroy(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+
+    ///act
+    Broker_Destroy(broker);
+
+    ///assert
+    mocks.AssertActualAndExpectedCalls();
+}
 
+//Tests_SRS_BROKER_17_065: [ Broker_GetTimerService shall return NULL if any underlying call fails. ]
+TEST_FUNCTION(Broker_GetTimerService_returns_NULL_when_create_fails)
+{
+    ///arrange
+    CBrokerMocks mocks;
+    auto broker = Broker_Create();
     mocks.ResetAllCalls();
 
     STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_find(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .IgnoreArgument(1)
-        .IgnoreArgument(2)
-        .IgnoreArgument(3)
-        .SetFailReturn(nullptr);
+    STRICT_EXPECTED_CALL(mocks, TimerService_Create())
+        .SetFailReturn((TIMER_SERVICE_HANDLE)NULL);
 
     ///act
-    result = Broker_RemoveLink(broker, &bld);
+    auto result = Broker_GetTimerService(broker);
 
     ///assert
-    ASSERT_ARE_EQUAL(BROKER_RESULT, result, BROKER_REMOVE_LINK_ERROR);
+    ASSERT_IS_NULL(result);
     mocks.AssertActualAndExpectedCalls();
 
     ///cleanup
-    Broker_RemoveModule(broker, &fake_module);
     Broker_Destroy(broker);
 }
 
-//Tests_SRS_BROKER_17_040: [ Upon an error, Broker_RemoveLink shall return BROKER_REMOVE_LINK_ERROR. ]
-TEST_FUNCTION(Broker_RemoveLink_fails_lock_fails)
+//Tests_SRS_BROKER_17_065: [ Broker_GetTimerService shall return NULL if any underlying call fails. ]
+TEST_FUNCTION(Broker_GetTimerService_returns_NULL_when_lock_fails)
 {
     ///arrange
     CBrokerMocks mocks;
     auto broker = Broker_Create();
-    auto result = Broker_AddModule(broker, &fake_module);
-    BROKER_LINK_DATA bld =
-    {
-        fake_module_handle,
-        fake_module_handle
-    };
-    result = Broker_AddLink(broker, &bld);
-
     mocks.ResetAllCalls();
 
     STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
@@ -3101,14 +5300,13 @@ TEST_FUNCTION(Broker_RemoveLink_fails_lock_fails)
         .SetFailReturn(LOCK_ERROR);
 
     ///act
-    result = Broker_RemoveLink(broker, &bld);
+    auto result = Broker_GetTimerService(broker);
 
     ///assert
-    ASSERT_ARE_EQUAL(BROKER_RESULT, result, BROKER_REMOVE_LINK_ERROR);
+    ASSERT_IS_NULL(result);
     mocks.AssertActualAndExpectedCalls();
 
     ///cleanup
-    Broker_RemoveModule(broker, &fake_module);
     Broker_Destroy(broker);
 }
 
@@ -3341,7 +5539,7 @@ TEST_FUNCTION(Broker_Publish_fails_when_Lock_fails)
 }
 
 //Tests_SRS_BROKER_13_037: [This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise.]
-TEST_FUNCTION(Broker_Publish_fails_when_Message_ToByteArray_fails)
+TEST_FUNCTION(Broker_Publish_fails_when_Message_GetSerialized_fails)
 {
     ///arrange
     CBrokerMocks mocks;
@@ -3364,8 +5562,10 @@ TEST_FUNCTION(Broker_Publish_fails_when_Message_ToByteArray_fails)
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, Message_Clone(message));
     STRICT_EXPECTED_CALL(mocks, Message_Destroy(message));
-    STRICT_EXPECTED_CALL(mocks, Message_ToByteArray(message, NULL, 0))
-        .SetFailReturn(-1);
+    STRICT_EXPECTED_CALL(mocks, Message_GetSerialized(message, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(2)
+        .IgnoreArgument(3)
+        .SetFailReturn(__LINE__);
 
     ///act
     result = Broker_Publish(broker, fake_module_handle, message);
@@ -3404,8 +5604,10 @@ TEST_FUNCTION(Broker_Publish_fails_when_allocmsg_fails)
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, Message_Clone(message));
     STRICT_EXPECTED_CALL(mocks, Message_Destroy(message));
-    STRICT_EXPECTED_CALL(mocks, Message_ToByteArray(message, NULL, 0));
-    STRICT_EXPECTED_CALL(mocks, nn_allocmsg(1 + sizeof(MODULE_HANDLE), 0))
+    STRICT_EXPECTED_CALL(mocks, Message_GetSerialized(message, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(2)
+        .IgnoreArgument(3);
+    STRICT_EXPECTED_CALL(mocks, nn_allocmsg(2 + sizeof(MODULE_HANDLE) + sizeof(uint64_t), 0))
         .SetFailReturn(nullptr);
 
     ///act
@@ -3445,13 +5647,13 @@ TEST_FUNCTION(Broker_Publish_fails_when_send_fails)
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, Message_Clone(message));
     STRICT_EXPECTED_CALL(mocks, Message_Destroy(message));
-    STRICT_EXPECTED_CALL(mocks, Message_ToByteArray(message, NULL, 0));
-    STRICT_EXPECTED_CALL(mocks, nn_allocmsg(1 + sizeof(MODULE_HANDLE), 0))
+    STRICT_EXPECTED_CALL(mocks, Message_GetSerialized(message, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(2)
+        .IgnoreArgument(3);
+    STRICT_EXPECTED_CALL(mocks, nn_allocmsg(2 + sizeof(MODULE_HANDLE) + sizeof(uint64_t), 0))
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, nn_freemsg(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, Message_ToByteArray(message, IGNORED_PTR_ARG, 1))
-        .IgnoreArgument(2);
     STRICT_EXPECTED_CALL(mocks, nn_send(IGNORED_NUM_ARG, IGNORED_PTR_ARG, NN_MSG, 0))
         .IgnoreArgument(1)
         .IgnoreArgument(2)
@@ -3494,13 +5696,13 @@ TEST_FUNCTION(Broker_Publish_retries_when_send_is_interrupted)
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, Message_Clone(message));
     STRICT_EXPECTED_CALL(mocks, Message_Destroy(message));
-    STRICT_EXPECTED_CALL(mocks, Message_ToByteArray(message, NULL, 0));
-    STRICT_EXPECTED_CALL(mocks, nn_allocmsg(1 + sizeof(MODULE_HANDLE), 0))
+    STRICT_EXPECTED_CALL(mocks, Message_GetSerialized(message, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(2)
+        .IgnoreArgument(3);
+    STRICT_EXPECTED_CALL(mocks, nn_allocmsg(2 + sizeof(MODULE_HANDLE) + sizeof(uint64_t), 0))
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, nn_freemsg(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, Message_ToByteArray(message, IGNORED_PTR_ARG, 1))
-        .IgnoreArgument(2);
     STRICT_EXPECTED_CALL(mocks, nn_send(IGNORED_NUM_ARG, IGNORED_PTR_ARG, NN_MSG, 0))
         .IgnoreArgument(1)
         .IgnoreArgument(2)
@@ -3528,10 +5730,11 @@ TEST_FUNCTION(Broker_Publish_retries_when_send_is_interrupted)
 
 //Tests_SRS_BROKER_17_022: [ Broker_Publish shall Lock the modules lock. ]
 //Tests_SRS_BROKER_17_007: [Broker_Publish shall clone the message.]
-//Tests_SRS_BROKER_17_008: [ Broker_Publish shall serialize the message. ]
-//Tests_SRS_BROKER_17_025: [ Broker_Publish shall allocate a nanomsg buffer the size of the serialized message + sizeof(MODULE_HANDLE). ]
-//Tests_SRS_BROKER_17_026: [ Broker_Publish shall copy source into the beginning of the nanomsg buffer. ]
-//Tests_SRS_BROKER_17_027: [ Broker_Publish shall serialize the message into the remainder of the nanomsg buffer. ]
+//Tests_SRS_BROKER_17_008: [ Broker_Publish shall serialize the message by calling Message_GetSerialized. ]
+//Tests_SRS_BROKER_17_025: [ Broker_Publish shall allocate a nanomsg buffer the size of the serialized message + 1 + sizeof(MODULE_HANDLE) + sizeof(uint64_t). ]
+//Tests_SRS_BROKER_17_043: [ Broker_Publish shall copy the current time in microseconds after the source. ]
+//Tests_SRS_BROKER_17_026: [ Broker_Publish shall start the nanomsg buffer with the message tag followed by source. ]
+//Tests_SRS_BROKER_17_027: [ Broker_Publish shall copy the serialized message into the remainder of the nanomsg buffer. ]
 //Tests_SRS_BROKER_17_010: [ Broker_Publish shall send a message on the publish_socket. ]
 //Tests_SRS_BROKER_17_011: [ Broker_Publish shall free the serialized message data. ]
 //Tests_SRS_BROKER_17_012: [ Broker_Publish shall free the message. ]
@@ -3560,11 +5763,11 @@ TEST_FUNCTION(Broker_Publish_succeeds)
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, Message_Clone(message));
     STRICT_EXPECTED_CALL(mocks, Message_Destroy(message));
-    STRICT_EXPECTED_CALL(mocks, Message_ToByteArray(message, NULL, 0));
-    STRICT_EXPECTED_CALL(mocks, nn_allocmsg(1 + sizeof(MODULE_HANDLE), 0))
+    STRICT_EXPECTED_CALL(mocks, Message_GetSerialized(message, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(2)
+        .IgnoreArgument(3);
+    STRICT_EXPECTED_CALL(mocks, nn_allocmsg(2 + sizeof(MODULE_HANDLE) + sizeof(uint64_t), 0))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, Message_ToByteArray(message, IGNORED_PTR_ARG, 1))
-        .IgnoreArgument(2);
     STRICT_EXPECTED_CALL(mocks, nn_send(IGNORED_NUM_ARG, IGNORED_PTR_ARG, NN_MSG, 0))
         .IgnoreArgument(1)
         .IgnoreArgument(2);
@@ -3583,5 +5786,112 @@ TEST_FUNCTION(Broker_Publish_succeeds)
     Broker_Destroy(broker);
 }
 
+//Tests_SRS_BROKER_17_074: [ While the publishing of source is paused, Broker_Publish shall count the message as shed and return BROKER_OK without sending it. ]
+TEST_FUNCTION(Broker_Publish_drops_messages_of_a_paused_source)
+{
+    ///arrange
+    CBrokerMocks mocks;
+
+    auto broker = Broker_Create();
+    BROKER_MODULE_SHEDDING shedding = { false, 0, true };
+    BROKER_MODULE_METRICS metrics;
+
+    // create a message to send
+    unsigned char fake;
+    MESSAGE_CONFIG c = { 1, &fake, (MAP_HANDLE)&fake };
+    auto message = Message_Create(&c);
+
+    auto result = Broker_AddModule(broker, &fake_module);
+    (void)Broker_SetModuleShedding(broker, fake_module_handle, &shedding);
+
+    mocks.ResetAllCalls();
+
+    // this is for Broker_Publish, which looks up the source but sends nothing
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_find(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2)
+        .IgnoreArgument(3);
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_item_get_value(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_item_get_value(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+
+    ///act
+    result = Broker_Publish(broker, fake_module_handle, message);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, result, BROKER_OK);
+    mocks.AssertActualAndExpectedCalls();
+    ASSERT_ARE_EQUAL(BROKER_RESULT, BROKER_OK, Broker_GetModuleMetrics(broker, fake_module_handle, &metrics));
+    ASSERT_ARE_EQUAL(size_t, 1, metrics.messages_shed);
+
+    ///cleanup
+    Message_Destroy(message);
+    Broker_RemoveModule(broker, &fake_module);
+    Broker_Destroy(broker);
+}
+
+//Tests_SRS_BROKER_17_087: [ If source is the publisher of a module, Broker_Publish shall publish the message as that module. ]
+TEST_FUNCTION(Broker_Publish_publishes_the_messages_of_a_publisher_as_its_module)
+{
+    ///arrange
+    CBrokerMocks mocks;
+
+    auto broker = Broker_Create();
+    BROKER_MODULE_SHEDDING shedding = { false, 0, true };
+    BROKER_MODULE_METRICS metrics;
+    MODULE_HANDLE publisher = (MODULE_HANDLE)0x42;
+
+    // create a message to send
+    unsigned char fake;
+    MESSAGE_CONFIG c = { 1, &fake, (MAP_HANDLE)&fake };
+    auto message = Message_Create(&c);
+
+    auto result = Broker_AddModule(broker, &fake_module);
+    (void)Broker_SetModulePublisher(broker, fake_module_handle, publisher);
+    (void)Broker_SetModuleShedding(broker, fake_module_handle, &shedding);
+
+    mocks.ResetAllCalls();
+
+    // this is for Broker_Publish, which finds the module of the publisher, then sheds its message
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_find(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2)
+        .IgnoreArgument(3);
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_item_get_value(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_item_get_value(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_find(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2)
+        .IgnoreArgument(3);
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_item_get_value(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, singlylinkedlist_item_get_value(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+
+    ///act
+    result = Broker_Publish(broker, publisher, message);
+
+    ///assert
+    ASSERT_ARE_EQUAL(BROKER_RESULT, result, BROKER_OK);
+    mocks.AssertActualAndExpectedCalls();
+    ASSERT_ARE_EQUAL(BROKER_RESULT, BROKER_OK, Broker_GetModuleMetrics(broker, fake_module_handle, &metrics));
+    ASSERT_ARE_EQUAL(size_t, 1, metrics.messages_shed);
+
+    ///cleanup
+    Message_Destroy(message);
+    Broker_RemoveModule(broker, &fake_module);
+    Broker_Destroy(broker);
+}
 
 END_TEST_SUITE(broker_ut)
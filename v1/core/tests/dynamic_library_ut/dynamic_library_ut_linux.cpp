@@ -1,6 +1,7 @@
 // Copyright (c) Microsoft. All rights reserved.
 // Licensed under the MIT license. See LICENSE file in the project root for full license information.
 
+#include <cstdlib>
 #include "testrunnerswitcher.h"
 #include "micromock.h"
 #include "micromockcharstararenullterminatedstrings.h"
@@ -140,4 +141,48 @@ TEST_FUNCTION(DynamicLibrary_FindSymbol_returns_correct_value)
     ///cleanup
 }
 
+// Tests_SRS_DYNAMIC_LIBRARY_17_004: [DynamicLibrary_GetCanonicalPath shall return NULL if dynamicLibraryFileName is NULL or does not name an existing file.]
+TEST_FUNCTION(DynamicLibrary_GetCanonicalPath_returns_NULL_for_NULL_name)
+{
+    CDynamicLibraryMocks mocks;
+
+    ///act
+    char* result = DynamicLibrary_GetCanonicalPath(NULL);
+
+    ///assert
+    ASSERT_IS_NULL(result);
+
+    ///cleanup
+}
+
+// Tests_SRS_DYNAMIC_LIBRARY_17_004: [DynamicLibrary_GetCanonicalPath shall return NULL if dynamicLibraryFileName is NULL or does not name an existing file.]
+TEST_FUNCTION(DynamicLibrary_GetCanonicalPath_returns_NULL_for_a_missing_file)
+{
+    CDynamicLibraryMocks mocks;
+
+    ///act
+    char* result = DynamicLibrary_GetCanonicalPath(LIBRARY_NAME);
+
+    ///assert
+    ASSERT_IS_NULL(result);
+
+    ///cleanup
+}
+
+// Tests_SRS_DYNAMIC_LIBRARY_17_005: [DynamicLibrary_GetCanonicalPath shall return a newly allocated string holding the absolute path of dynamicLibraryFileName, which the caller frees.]
+TEST_FUNCTION(DynamicLibrary_GetCanonicalPath_resolves_the_path)
+{
+    CDynamicLibraryMocks mocks;
+
+    ///act
+    char* result = DynamicLibrary_GetCanonicalPath("/./");
+
+    ///assert
+    ASSERT_IS_NOT_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, "/", result);
+
+    ///cleanup
+    free(result);
+}
+
 END_TEST_SUITE(dynamic_library_ut)
@@ -151,4 +151,32 @@ TEST_FUNCTION(DynamicLibrary_FindSymbol_returns_correct_value)
     ///cleanup
 }
 
+// Tests_SRS_DYNAMIC_LIBRARY_17_004: [DynamicLibrary_GetCanonicalPath shall return NULL if dynamicLibraryFileName is NULL or does not name an existing file.]
+TEST_FUNCTION(DynamicLibrary_GetCanonicalPath_returns_NULL_for_NULL_name)
+{
+    CDynamicLibraryMocks mocks;
+
+    ///act
+    char* result = DynamicLibrary_GetCanonicalPath(NULL);
+
+    ///assert
+    ASSERT_IS_NULL(result);
+
+    ///cleanup
+}
+
+// Tests_SRS_DYNAMIC_LIBRARY_17_004: [DynamicLibrary_GetCanonicalPath shall return NULL if dynamicLibraryFileName is NULL or does not name an existing file.]
+TEST_FUNCTION(DynamicLibrary_GetCanonicalPath_returns_NULL_for_a_missing_file)
+{
+    CDynamicLibraryMocks mocks;
+
+    ///act
+    char* result = DynamicLibrary_GetCanonicalPath(LIBRARY_NAME);
+
+    ///assert
+    ASSERT_IS_NULL(result);
+
+    ///cleanup
+}
+
 END_TEST_SUITE(dynamic_library_ut)
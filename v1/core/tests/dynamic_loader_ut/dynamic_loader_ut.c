@@ -47,6 +47,7 @@ void my_gballoc_free(void* ptr)
 
 #include "azure_c_shared_utility/strings.h"
 #include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/lock.h"
 
 #include "parson.h"
 #include "dynamic_library.h"
@@ -180,9 +181,13 @@ TEST_SUITE_INITIALIZE(TestClassInitialize)
     REGISTER_UMOCK_ALIAS_TYPE(MODULE_LIBRARY_HANDLE, void*);
     REGISTER_UMOCK_ALIAS_TYPE(JSON_Value_Type, int);
     REGISTER_UMOCK_ALIAS_TYPE(MODULE_API_VERSION, int);
+    REGISTER_UMOCK_ALIAS_TYPE(LOCK_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(LOCK_RESULT, int);
     REGISTER_GLOBAL_MOCK_RETURN(DynamicLibrary_LoadLibrary, (DYNAMIC_LIBRARY_HANDLE)0x42);
     REGISTER_GLOBAL_MOCK_RETURN(DynamicLibrary_FindSymbol, (void*)0x42);
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(json_value_get_object, NULL);
+    REGISTER_GLOBAL_MOCK_RETURN(Lock_Init, (LOCK_HANDLE)0x4242);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(Lock, LOCK_ERROR);
 
     // malloc/free hooks
     REGISTER_GLOBAL_MOCK_HOOK(gballoc_malloc, my_gballoc_malloc);
@@ -195,6 +200,8 @@ TEST_SUITE_INITIALIZE(TestClassInitialize)
     REGISTER_GLOBAL_MOCK_HOOK(STRING_c_str, real_STRING_c_str);
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(STRING_clone, NULL);
 
+    ASSERT_ARE_EQUAL(int, MODULE_LOADER_SUCCESS, DynamicLoader_Initialize());
+
     const MODULE_LOADER* loader = DynamicLoader_Get();
     DynamicModuleLoader_Load = loader->api->Load;
     DynamicModuleLoader_Unload = loader->api->Unload;
@@ -209,6 +216,7 @@ TEST_SUITE_INITIALIZE(TestClassInitialize)
 
 TEST_SUITE_CLEANUP(TestClassCleanup)
 {
+    DynamicLoader_Deinitialize();
     umock_c_deinit();
 
     TEST_MUTEX_DESTROY(g_testByTest);
@@ -307,6 +315,10 @@ TEST_FUNCTION(DynamicModuleLoader_Load_returns_NULL_when_things_fail)
     ASSERT_ARE_EQUAL(int, 0, result);
 
     STRICT_EXPECTED_CALL(STRING_c_str(entrypoint.moduleLibraryFileName));
+    STRICT_EXPECTED_CALL(DynamicLibrary_GetCanonicalPath(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
         .IgnoreArgument(1)
         .SetFailReturn(NULL);
@@ -320,9 +332,10 @@ TEST_FUNCTION(DynamicModuleLoader_Load_returns_NULL_when_things_fail)
     umock_c_negative_tests_snapshot();
 
     // NOTE:
-    //  We start the negative testing from *1* instead of 0 because we don't want
-    //  the STRING_c_str call to fail or test for that.
-    for (size_t i = 1; i < umock_c_negative_tests_call_count(); i++)
+    //  We start the negative testing from *2* instead of 0 because we don't want
+    //  the STRING_c_str call to fail or test for that, and a failing
+    //  DynamicLibrary_GetCanonicalPath only makes the file name the cache key.
+    for (size_t i = 2; i < umock_c_negative_tests_call_count(); i++)
     {
         // arrange
         umock_c_negative_tests_reset();
@@ -356,6 +369,10 @@ TEST_FUNCTION(DynamicModuleLoader_Load_returns_NULL_when_GetAPI_returns_NULL)
     umock_c_reset_all_calls();
 
     STRICT_EXPECTED_CALL(STRING_c_str(entrypoint.moduleLibraryFileName));
+    STRICT_EXPECTED_CALL(DynamicLibrary_GetCanonicalPath(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(DynamicLibrary_LoadLibrary(IGNORED_PTR_ARG))
@@ -370,6 +387,8 @@ TEST_FUNCTION(DynamicModuleLoader_Load_returns_NULL_when_GetAPI_returns_NULL)
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
 
     // act
     MODULE_LIBRARY_HANDLE result = DynamicModuleLoader_Load(&loader, &entrypoint);
@@ -401,6 +420,10 @@ TEST_FUNCTION(DynamicModuleLoader_Load_returns_NULL_when_GetAPI_returns_API_with
     umock_c_reset_all_calls();
 
     STRICT_EXPECTED_CALL(STRING_c_str(entrypoint.moduleLibraryFileName));
+    STRICT_EXPECTED_CALL(DynamicLibrary_GetCanonicalPath(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(DynamicLibrary_LoadLibrary(IGNORED_PTR_ARG))
@@ -415,6 +438,8 @@ TEST_FUNCTION(DynamicModuleLoader_Load_returns_NULL_when_GetAPI_returns_API_with
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
 
     // act
     MODULE_LIBRARY_HANDLE result = DynamicModuleLoader_Load(&loader, &entrypoint);
@@ -481,6 +506,10 @@ TEST_FUNCTION(DynamicModuleLoader_Load_returns_NULL_when_GetAPI_returns_API_with
     for (size_t i = 0; i < sizeof(api_inputs) / sizeof(api_inputs[0]); i++)
     {
         STRICT_EXPECTED_CALL(STRING_c_str(entrypoint.moduleLibraryFileName));
+        STRICT_EXPECTED_CALL(DynamicLibrary_GetCanonicalPath(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
         STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
             .IgnoreArgument(1);
         STRICT_EXPECTED_CALL(DynamicLibrary_LoadLibrary(IGNORED_PTR_ARG))
@@ -495,6 +524,8 @@ TEST_FUNCTION(DynamicModuleLoader_Load_returns_NULL_when_GetAPI_returns_API_with
             .IgnoreArgument(1);
         STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
             .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
     }
 
     for (size_t i = 0; i < sizeof(api_inputs) / sizeof(api_inputs[0]); i++)
@@ -541,6 +572,10 @@ TEST_FUNCTION(DynamicModuleLoader_Load_succeeds)
     umock_c_reset_all_calls();
 
     STRICT_EXPECTED_CALL(STRING_c_str(entrypoint.moduleLibraryFileName));
+    STRICT_EXPECTED_CALL(DynamicLibrary_GetCanonicalPath(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(DynamicLibrary_LoadLibrary(IGNORED_PTR_ARG))
@@ -551,6 +586,8 @@ TEST_FUNCTION(DynamicModuleLoader_Load_succeeds)
     STRICT_EXPECTED_CALL(Fake_GetAPI((MODULE_API_VERSION)IGNORED_NUM_ARG))
         .IgnoreArgument(1)
         .SetReturn((MODULE_API*)&api);
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
 
     // act
     MODULE_LIBRARY_HANDLE result = DynamicModuleLoader_Load(&loader, &entrypoint);
@@ -564,6 +601,146 @@ TEST_FUNCTION(DynamicModuleLoader_Load_succeeds)
     STRING_delete(entrypoint.moduleLibraryFileName);
 }
 
+//Tests_SRS_DYNAMIC_MODULE_LOADER_17_057: [ DynamicModuleLoader_Load shall key the library by DynamicLibrary_GetCanonicalPath, or by entrypoint->moduleLibraryFileName if it has no canonical path. ]
+//Tests_SRS_DYNAMIC_MODULE_LOADER_17_058: [ DynamicModuleLoader_Load shall cache the library under its canonical path with a reference count of 1. ]
+//Tests_SRS_DYNAMIC_MODULE_LOADER_17_059: [ If the library is cached already, DynamicModuleLoader_Load shall increment its reference count and return it without loading it again. ]
+TEST_FUNCTION(DynamicModuleLoader_Load_reuses_the_library_loaded_from_the_same_file)
+{
+    // arrange
+    MODULE_LOADER loader =
+    {
+        NATIVE,
+        NULL, NULL, NULL
+    };
+    DYNAMIC_LOADER_ENTRYPOINT entrypoint = { STRING_construct("boo") };
+    MODULE_API_1 api =
+    {
+        {
+            MODULE_API_VERSION_1
+        },
+        NULL,
+        NULL,
+        (pfModule_Create)0x42,
+        (pfModule_Destroy)0x42,
+        (pfModule_Receive)0x42,
+        NULL
+    };
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(STRING_c_str(entrypoint.moduleLibraryFileName));
+    STRICT_EXPECTED_CALL(DynamicLibrary_GetCanonicalPath(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(DynamicLibrary_LoadLibrary(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(DynamicLibrary_FindSymbol(IGNORED_PTR_ARG, MODULE_GETAPI_NAME))
+        .IgnoreArgument(1)
+        .SetReturn((void*)Fake_GetAPI);
+    STRICT_EXPECTED_CALL(Fake_GetAPI((MODULE_API_VERSION)IGNORED_NUM_ARG))
+        .IgnoreArgument(1)
+        .SetReturn((MODULE_API*)&api);
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(STRING_c_str(entrypoint.moduleLibraryFileName));
+    STRICT_EXPECTED_CALL(DynamicLibrary_GetCanonicalPath(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+
+    // act
+    MODULE_LIBRARY_HANDLE result1 = DynamicModuleLoader_Load(&loader, &entrypoint);
+    MODULE_LIBRARY_HANDLE result2 = DynamicModuleLoader_Load(&loader, &entrypoint);
+
+    // assert
+    ASSERT_IS_NOT_NULL(result1);
+    ASSERT_IS_TRUE(result1 == result2);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    DynamicModuleLoader_Unload(&loader, result2);
+    DynamicModuleLoader_Unload(&loader, result1);
+    STRING_delete(entrypoint.moduleLibraryFileName);
+}
+
+//Tests_SRS_DYNAMIC_MODULE_LOADER_17_057: [ DynamicModuleLoader_Load shall key the library by DynamicLibrary_GetCanonicalPath, or by entrypoint->moduleLibraryFileName if it has no canonical path. ]
+//Tests_SRS_DYNAMIC_MODULE_LOADER_17_059: [ If the library is cached already, DynamicModuleLoader_Load shall increment its reference count and return it without loading it again. ]
+TEST_FUNCTION(DynamicModuleLoader_Load_reuses_the_library_for_paths_with_the_same_canonical_path)
+{
+    // arrange
+    MODULE_LOADER loader =
+    {
+        NATIVE,
+        NULL, NULL, NULL
+    };
+    DYNAMIC_LOADER_ENTRYPOINT entrypoint1 = { STRING_construct("boo") };
+    DYNAMIC_LOADER_ENTRYPOINT entrypoint2 = { STRING_construct("./boo") };
+    char* canonical_path1 = (char*)malloc(sizeof("/lib/boo"));
+    char* canonical_path2 = (char*)malloc(sizeof("/lib/boo"));
+    ASSERT_IS_NOT_NULL(canonical_path1);
+    ASSERT_IS_NOT_NULL(canonical_path2);
+    (void)strcpy(canonical_path1, "/lib/boo");
+    (void)strcpy(canonical_path2, "/lib/boo");
+    MODULE_API_1 api =
+    {
+        {
+            MODULE_API_VERSION_1
+        },
+        NULL,
+        NULL,
+        (pfModule_Create)0x42,
+        (pfModule_Destroy)0x42,
+        (pfModule_Receive)0x42,
+        NULL
+    };
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(STRING_c_str(entrypoint1.moduleLibraryFileName));
+    STRICT_EXPECTED_CALL(DynamicLibrary_GetCanonicalPath("boo"))
+        .SetReturn(canonical_path1);
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(DynamicLibrary_LoadLibrary("boo"));
+    STRICT_EXPECTED_CALL(DynamicLibrary_FindSymbol(IGNORED_PTR_ARG, MODULE_GETAPI_NAME))
+        .IgnoreArgument(1)
+        .SetReturn((void*)Fake_GetAPI);
+    STRICT_EXPECTED_CALL(Fake_GetAPI((MODULE_API_VERSION)IGNORED_NUM_ARG))
+        .IgnoreArgument(1)
+        .SetReturn((MODULE_API*)&api);
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(gballoc_free(canonical_path1));
+    STRICT_EXPECTED_CALL(STRING_c_str(entrypoint2.moduleLibraryFileName));
+    STRICT_EXPECTED_CALL(DynamicLibrary_GetCanonicalPath("./boo"))
+        .SetReturn(canonical_path2);
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(gballoc_free(canonical_path2));
+
+    // act
+    MODULE_LIBRARY_HANDLE result1 = DynamicModuleLoader_Load(&loader, &entrypoint1);
+    MODULE_LIBRARY_HANDLE result2 = DynamicModuleLoader_Load(&loader, &entrypoint2);
+
+    // assert
+    ASSERT_IS_NOT_NULL(result1);
+    ASSERT_IS_TRUE(result1 == result2);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    DynamicModuleLoader_Unload(&loader, result2);
+    DynamicModuleLoader_Unload(&loader, result1);
+    STRING_delete(entrypoint1.moduleLibraryFileName);
+    STRING_delete(entrypoint2.moduleLibraryFileName);
+}
+
 /*Tests_SRS_MODULE_LOADER_17_007: [DynamicModuleLoader_GetModuleApi shall return NULL if the moduleLibraryHandle is NULL.]*/
 TEST_FUNCTION(DynamicModuleLoader_GetModuleApi_returns_NULL_when_moduleLibraryHandle_is_NULL)
 {
@@ -601,6 +778,10 @@ TEST_FUNCTION(DynamicModuleLoader_GetModuleApi_succeeds)
     umock_c_reset_all_calls();
 
     STRICT_EXPECTED_CALL(STRING_c_str(entrypoint.moduleLibraryFileName));
+    STRICT_EXPECTED_CALL(DynamicLibrary_GetCanonicalPath(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(DynamicLibrary_LoadLibrary(IGNORED_PTR_ARG))
@@ -611,6 +792,8 @@ TEST_FUNCTION(DynamicModuleLoader_GetModuleApi_succeeds)
     STRICT_EXPECTED_CALL(Fake_GetAPI((MODULE_API_VERSION)IGNORED_NUM_ARG))
         .IgnoreArgument(1)
         .SetReturn((MODULE_API*)&api);
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
 
     MODULE_LIBRARY_HANDLE module = DynamicModuleLoader_Load(&loader, &entrypoint);
     ASSERT_IS_NOT_NULL(module);
@@ -665,6 +848,10 @@ TEST_FUNCTION(DynamicModuleLoader_Unload_frees_things)
     umock_c_reset_all_calls();
 
     STRICT_EXPECTED_CALL(STRING_c_str(entrypoint.moduleLibraryFileName));
+    STRICT_EXPECTED_CALL(DynamicLibrary_GetCanonicalPath(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(DynamicLibrary_LoadLibrary(IGNORED_PTR_ARG))
@@ -675,15 +862,21 @@ TEST_FUNCTION(DynamicModuleLoader_Unload_frees_things)
     STRICT_EXPECTED_CALL(Fake_GetAPI((MODULE_API_VERSION)IGNORED_NUM_ARG))
         .IgnoreArgument(1)
         .SetReturn((MODULE_API*)&api);
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
 
     MODULE_LIBRARY_HANDLE module = DynamicModuleLoader_Load(&loader, &entrypoint);
     ASSERT_IS_NOT_NULL(module);
 
     umock_c_reset_all_calls();
 
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(DynamicLibrary_UnloadLibrary((DYNAMIC_LIBRARY_HANDLE)0x42));
     STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
 
     // act
     DynamicModuleLoader_Unload(&loader, module);
@@ -695,6 +888,68 @@ TEST_FUNCTION(DynamicModuleLoader_Unload_frees_things)
     STRING_delete(entrypoint.moduleLibraryFileName);
 }
 
+//Tests_SRS_DYNAMIC_MODULE_LOADER_17_060: [ DynamicModuleLoader_Unload shall decrement the reference count of the library and do nothing else while it is not 0. ]
+/*Tests_SRS_MODULE_LOADER_17_010: [DynamicModuleLoader_Unload shall attempt to unload the library.]*/
+TEST_FUNCTION(DynamicModuleLoader_Unload_unloads_the_library_when_its_last_module_is_unloaded)
+{
+    // arrange
+    MODULE_LOADER loader =
+    {
+        NATIVE,
+        NULL, NULL, NULL
+    };
+    DYNAMIC_LOADER_ENTRYPOINT entrypoint = { STRING_construct("boo") };
+    MODULE_API_1 api =
+    {
+        {
+            MODULE_API_VERSION_1
+        },
+        NULL,
+        NULL,
+        (pfModule_Create)0x42,
+        (pfModule_Destroy)0x42,
+        (pfModule_Receive)0x42,
+        NULL
+    };
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(DynamicLibrary_FindSymbol(IGNORED_PTR_ARG, MODULE_GETAPI_NAME))
+        .IgnoreArgument(1)
+        .SetReturn((void*)Fake_GetAPI);
+    STRICT_EXPECTED_CALL(Fake_GetAPI((MODULE_API_VERSION)IGNORED_NUM_ARG))
+        .IgnoreArgument(1)
+        .SetReturn((MODULE_API*)&api);
+
+    MODULE_LIBRARY_HANDLE module1 = DynamicModuleLoader_Load(&loader, &entrypoint);
+    MODULE_LIBRARY_HANDLE module2 = DynamicModuleLoader_Load(&loader, &entrypoint);
+    ASSERT_IS_NOT_NULL(module1);
+    ASSERT_IS_TRUE(module1 == module2);
+
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(DynamicLibrary_UnloadLibrary((DYNAMIC_LIBRARY_HANDLE)0x42));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+
+    // act
+    DynamicModuleLoader_Unload(&loader, module1);
+    DynamicModuleLoader_Unload(&loader, module2);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    STRING_delete(entrypoint.moduleLibraryFileName);
+}
+
 //Tests_SRS_DYNAMIC_MODULE_LOADER_13_042 : [DynamicModuleLoader_ParseEntrypointFromJson shall return NULL if json is NULL.]
 TEST_FUNCTION(DynamicModuleLoader_ParseEntrypointFromJson_returns_NULL_when_json_is_NULL)
 {
@@ -912,6 +1167,73 @@ TEST_FUNCTION(DynamicModuleLoader_FreeModuleConfiguration_does_nothing)
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 }
 
+//Tests_SRS_DYNAMIC_MODULE_LOADER_17_061: [ DynamicLoader_Initialize shall create the lock of the library cache. ]
+//Tests_SRS_DYNAMIC_MODULE_LOADER_17_063: [ DynamicLoader_Initialize shall return MODULE_LOADER_SUCCESS when the lock of the library cache exists. ]
+TEST_FUNCTION(DynamicLoader_Initialize_creates_the_library_cache_lock)
+{
+    // arrange
+    DynamicLoader_Deinitialize();
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(Lock_Init());
+
+    // act
+    MODULE_LOADER_RESULT result = DynamicLoader_Initialize();
+
+    // assert
+    ASSERT_ARE_EQUAL(int, MODULE_LOADER_SUCCESS, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+//Tests_SRS_DYNAMIC_MODULE_LOADER_17_063: [ DynamicLoader_Initialize shall return MODULE_LOADER_SUCCESS when the lock of the library cache exists. ]
+TEST_FUNCTION(DynamicLoader_Initialize_keeps_an_existing_library_cache_lock)
+{
+    // act
+    MODULE_LOADER_RESULT result = DynamicLoader_Initialize();
+
+    // assert
+    ASSERT_ARE_EQUAL(int, MODULE_LOADER_SUCCESS, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+//Tests_SRS_DYNAMIC_MODULE_LOADER_17_062: [ DynamicLoader_Initialize shall return MODULE_LOADER_ERROR if the lock cannot be created. ]
+TEST_FUNCTION(DynamicLoader_Initialize_returns_MODULE_LOADER_ERROR_when_Lock_Init_fails)
+{
+    // arrange
+    DynamicLoader_Deinitialize();
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(Lock_Init())
+        .SetReturn(NULL);
+
+    // act
+    MODULE_LOADER_RESULT result = DynamicLoader_Initialize();
+
+    // assert
+    ASSERT_ARE_EQUAL(int, MODULE_LOADER_ERROR, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    ASSERT_ARE_EQUAL(int, MODULE_LOADER_SUCCESS, DynamicLoader_Initialize());
+}
+
+//Tests_SRS_DYNAMIC_MODULE_LOADER_17_064: [ DynamicLoader_Deinitialize shall free the lock of the library cache. ]
+TEST_FUNCTION(DynamicLoader_Deinitialize_frees_the_library_cache_lock)
+{
+    // arrange
+    STRICT_EXPECTED_CALL(Lock_Deinit((LOCK_HANDLE)0x4242));
+
+    // act
+    DynamicLoader_Deinitialize();
+    DynamicLoader_Deinitialize();
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    ASSERT_ARE_EQUAL(int, MODULE_LOADER_SUCCESS, DynamicLoader_Initialize());
+}
+
 //Tests_SRS_DYNAMIC_MODULE_LOADER_13_054: [DynamicModuleLoader_Get shall return a non - NULL pointer to a MODULE_LOADER struct.]
 //Tests_SRS_DYNAMIC_MODULE_LOADER_13_055 : [MODULE_LOADER::type shall be NATIVE.]
 //Tests_SRS_DYNAMIC_MODULE_LOADER_13_056 : [MODULE_LOADER::name shall be the string native.]
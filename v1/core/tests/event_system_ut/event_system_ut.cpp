@@ -6,6 +6,7 @@
 #include <cstdbool>
 #include <vector>
 #include <list>
+#include <string>
 
 #include "testrunnerswitcher.h"
 #include "micromock.h"
@@ -59,6 +60,18 @@ static void* last_context;
 static void* last_user_param;
 
 static VECTOR_HANDLE module_list;
+static int destroyed_module_lists;
+static VECTOR_HANDLE metrics_snapshot;
+static int destroyed_metrics_snapshots;
+static VECTOR_HANDLE stuck_modules;
+static int destroyed_stuck_modules;
+static VECTOR_HANDLE modules_over_budget;
+static int destroyed_modules_over_budget;
+static GATEWAY_LOAD_SHEDDING_STATE load_shedding_state;
+static int destroyed_load_shedding_states;
+static char startup_report[] = "{\"total_us\":0}";
+static int destroyed_startup_reports;
+static COND_RESULT condition_wait_result;
 
 struct ListNode
 {
@@ -189,7 +202,7 @@ public:
     MOCK_METHOD_END(COND_RESULT, COND_OK);
 
     MOCK_STATIC_METHOD_3(, COND_RESULT, Condition_Wait, COND_HANDLE, handle, LOCK_HANDLE, lock, int, timeout_milliseconds);
-    MOCK_METHOD_END(COND_RESULT, COND_OK);
+    MOCK_METHOD_END(COND_RESULT, condition_wait_result);
 
     MOCK_STATIC_METHOD_1(, void, Condition_Deinit, COND_HANDLE, handle);
         BASEIMPLEMENTATION::gballoc_free(handle);
@@ -199,6 +212,42 @@ public:
     MOCK_METHOD_END(VECTOR_HANDLE, module_list);
 
     MOCK_STATIC_METHOD_1(, void, Gateway_DestroyModuleList, VECTOR_HANDLE, vec);
+        destroyed_module_lists++;
+    MOCK_VOID_METHOD_END();
+
+    MOCK_STATIC_METHOD_1(, VECTOR_HANDLE, Gateway_GetMetricsSnapshot, GATEWAY_HANDLE, gw);
+    MOCK_METHOD_END(VECTOR_HANDLE, metrics_snapshot);
+
+    MOCK_STATIC_METHOD_1(, void, Gateway_DestroyMetricsSnapshot, VECTOR_HANDLE, snapshot);
+        destroyed_metrics_snapshots++;
+    MOCK_VOID_METHOD_END();
+
+    MOCK_STATIC_METHOD_1(, VECTOR_HANDLE, Gateway_GetStuckModules, GATEWAY_HANDLE, gw);
+    MOCK_METHOD_END(VECTOR_HANDLE, stuck_modules);
+
+    MOCK_STATIC_METHOD_1(, void, Gateway_DestroyStuckModules, VECTOR_HANDLE, stuck);
+        destroyed_stuck_modules++;
+    MOCK_VOID_METHOD_END();
+
+    MOCK_STATIC_METHOD_1(, VECTOR_HANDLE, Gateway_GetModulesOverBudget, GATEWAY_HANDLE, gw);
+    MOCK_METHOD_END(VECTOR_HANDLE, modules_over_budget);
+
+    MOCK_STATIC_METHOD_1(, void, Gateway_DestroyModulesOverBudget, VECTOR_HANDLE, over_budget);
+        destroyed_modules_over_budget++;
+    MOCK_VOID_METHOD_END();
+
+    MOCK_STATIC_METHOD_1(, GATEWAY_LOAD_SHEDDING_STATE*, Gateway_GetLoadSheddingState, GATEWAY_HANDLE, gw);
+    MOCK_METHOD_END(GATEWAY_LOAD_SHEDDING_STATE*, &load_shedding_state);
+
+    MOCK_STATIC_METHOD_1(, void, Gateway_DestroyLoadSheddingState, GATEWAY_LOAD_SHEDDING_STATE*, state);
+        destroyed_load_shedding_states++;
+    MOCK_VOID_METHOD_END();
+
+    MOCK_STATIC_METHOD_1(, char*, Gateway_GetStartupReport, GATEWAY_HANDLE, gw);
+    MOCK_METHOD_END(char*, startup_report);
+
+    MOCK_STATIC_METHOD_1(, void, Gateway_DestroyStartupReport, char*, report);
+        destroyed_startup_reports++;
     MOCK_VOID_METHOD_END();
         
 };
@@ -241,6 +290,16 @@ DECLARE_GLOBAL_MOCK_METHOD_1(CEventSystemMocks, , void, Condition_Deinit, COND_H
 
 DECLARE_GLOBAL_MOCK_METHOD_1(CEventSystemMocks, , VECTOR_HANDLE, Gateway_GetModuleList, GATEWAY_HANDLE, gw);
 DECLARE_GLOBAL_MOCK_METHOD_1(CEventSystemMocks, , void, Gateway_DestroyModuleList, VECTOR_HANDLE, vec);
+DECLARE_GLOBAL_MOCK_METHOD_1(CEventSystemMocks, , VECTOR_HANDLE, Gateway_GetMetricsSnapshot, GATEWAY_HANDLE, gw);
+DECLARE_GLOBAL_MOCK_METHOD_1(CEventSystemMocks, , void, Gateway_DestroyMetricsSnapshot, VECTOR_HANDLE, snapshot);
+DECLARE_GLOBAL_MOCK_METHOD_1(CEventSystemMocks, , VECTOR_HANDLE, Gateway_GetStuckModules, GATEWAY_HANDLE, gw);
+DECLARE_GLOBAL_MOCK_METHOD_1(CEventSystemMocks, , void, Gateway_DestroyStuckModules, VECTOR_HANDLE, stuck);
+DECLARE_GLOBAL_MOCK_METHOD_1(CEventSystemMocks, , VECTOR_HANDLE, Gateway_GetModulesOverBudget, GATEWAY_HANDLE, gw);
+DECLARE_GLOBAL_MOCK_METHOD_1(CEventSystemMocks, , void, Gateway_DestroyModulesOverBudget, VECTOR_HANDLE, over_budget);
+DECLARE_GLOBAL_MOCK_METHOD_1(CEventSystemMocks, , GATEWAY_LOAD_SHEDDING_STATE*, Gateway_GetLoadSheddingState, GATEWAY_HANDLE, gw);
+DECLARE_GLOBAL_MOCK_METHOD_1(CEventSystemMocks, , void, Gateway_DestroyLoadSheddingState, GATEWAY_LOAD_SHEDDING_STATE*, state);
+DECLARE_GLOBAL_MOCK_METHOD_1(CEventSystemMocks, , char*, Gateway_GetStartupReport, GATEWAY_HANDLE, gw);
+DECLARE_GLOBAL_MOCK_METHOD_1(CEventSystemMocks, , void, Gateway_DestroyStartupReport, char*, report);
 
 static void expectEventSystemDestroy(CEventSystemMocks &mocks, bool started_thread, int nodes_in_queue)
 {
@@ -287,6 +346,27 @@ static void catch_context_callback(GATEWAY_HANDLE gw, GATEWAY_EVENT event_type,
     last_user_param = user_param;
 }
 
+static std::string last_module_name;
+static std::string last_link_source;
+static std::string last_link_sink;
+
+static void catch_change_callback(GATEWAY_HANDLE gw, GATEWAY_EVENT event_type, GATEWAY_EVENT_CTX ctx, void* user_param)
+{
+    (void)gw;
+    (void)user_param;
+    if (event_type == GATEWAY_MODULE_ADDED || event_type == GATEWAY_MODULE_REMOVED)
+    {
+        last_module_name = (const char*)ctx;
+    }
+    else
+    {
+        const GATEWAY_LINK_ENTRY* link = (const GATEWAY_LINK_ENTRY*)ctx;
+        last_link_source = link->module_source;
+        last_link_sink = link->module_sink;
+    }
+    last_context = ctx;
+}
+
 BEGIN_TEST_SUITE(event_system_ut)
 
 TEST_SUITE_INITIALIZE(TestClassInitialize)
@@ -322,7 +402,20 @@ TEST_FUNCTION_INITIALIZE(TestMethodInitialize)
     last_thread_arg = NULL;
     last_thread_func = NULL;
     module_list = NULL;
+    metrics_snapshot = NULL;
+    destroyed_metrics_snapshots = 0;
+    stuck_modules = NULL;
+    destroyed_stuck_modules = 0;
+    modules_over_budget = NULL;
+    destroyed_modules_over_budget = 0;
+    destroyed_load_shedding_states = 0;
+    destroyed_startup_reports = 0;
     last_context = NULL;
+    last_module_name.clear();
+    last_link_source.clear();
+    last_link_sink.clear();
+    destroyed_module_lists = 0;
+    condition_wait_result = COND_OK;
 }
 
 TEST_FUNCTION_CLEANUP(TestMethodCleanup)
@@ -493,6 +586,32 @@ TEST_FUNCTION(EventSystem_Init_Fail_List)
     mocks.AssertActualAndExpectedCalls();
 }
 
+/* Tests_SRS_EVENTSYSTEM_26_018: [ This function shall deliver events with the given dispatcher. ] */
+TEST_FUNCTION(EventSystem_InitWithDispatcher_Persistent_Basic)
+{
+    // Arrange
+    CEventSystemMocks mocks;
+
+    // Expectations
+    EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG));
+    EXPECTED_CALL(mocks, Lock_Init())
+        .ExpectedTimesExactly(2);
+    EXPECTED_CALL(mocks, Condition_Init());
+    EXPECTED_CALL(mocks, VECTOR_create(IGNORED_NUM_ARG))
+        .ExpectedTimesExactly(GATEWAY_EVENTS_COUNT);
+    EXPECTED_CALL(mocks, singlylinkedlist_create());
+
+    // Act
+    EVENTSYSTEM_HANDLE event_system = EventSystem_InitWithDispatcher(EVENTSYSTEM_DISPATCHER_PERSISTENT);
+
+    // Assert
+    ASSERT_IS_NOT_NULL(event_system);
+    mocks.AssertActualAndExpectedCalls();
+
+    // Cleanup
+    EventSystem_Destroy(event_system);
+}
+
 /* Tests_SRS_EVENTSYSTEM_26_003: [ This function shall destroy and free resources of the given event system. ] */
 TEST_FUNCTION(EventSystem_Destroy_Basic)
 {
@@ -716,6 +835,214 @@ TEST_FUNCTION(EventSystem_Recreates_Thread_When_Quit)
     mocks.AssertActualAndExpectedCalls();
 }
 
+/* Tests_SRS_EVENTSYSTEM_26_020: [ The `EVENTSYSTEM_DISPATCHER_PERSISTENT` dispatcher shall queue events without taking a lock. ] */
+TEST_FUNCTION(EventSystem_Persistent_Report_Does_Not_Lock_Queue)
+{
+    // Arrange
+    CEventSystemMocks mocks;
+    EVENTSYSTEM_HANDLE handle = EventSystem_InitWithDispatcher(EVENTSYSTEM_DISPATCHER_PERSISTENT);
+    EventSystem_AddEventCallback(handle, GATEWAY_STARTED, countingCallback, NULL);
+    mocks.ResetAllCalls();
+
+    // Expect
+    // only the internal change lock is taken, once to start the thread
+    EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+        .ExpectedTimesExactly(1);
+    EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .ExpectedTimesExactly(1);
+    EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG));
+    EXPECTED_CALL(mocks, VECTOR_create(IGNORED_NUM_ARG));
+    EXPECTED_CALL(mocks, VECTOR_front(IGNORED_PTR_ARG));
+    EXPECTED_CALL(mocks, VECTOR_push_back(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG));
+    EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG));
+    EXPECTED_CALL(mocks, ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+
+    // Act
+    EventSystem_ReportEvent(handle, NULL, GATEWAY_STARTED);
+
+    // Assert
+    mocks.AssertActualAndExpectedCalls();
+
+    // Cleanup
+    EventSystem_Destroy(handle);
+}
+
+/* Tests_SRS_EVENTSYSTEM_26_020: [ The `EVENTSYSTEM_DISPATCHER_PERSISTENT` dispatcher shall queue events without taking a lock. ] */
+/* Tests_SRS_EVENTSYSTEM_26_033: [ The `EVENTSYSTEM_DISPATCHER_PERSISTENT` dispatcher shall take the internal lock only once, when the first event starts its thread. ] */
+TEST_FUNCTION(EventSystem_Persistent_Report_Takes_No_Lock_Once_Started)
+{
+    // Arrange
+    CEventSystemMocks mocks;
+    EVENTSYSTEM_HANDLE handle = EventSystem_InitWithDispatcher(EVENTSYSTEM_DISPATCHER_PERSISTENT);
+    EventSystem_AddEventCallback(handle, GATEWAY_STARTED, countingCallback, NULL);
+    EventSystem_ReportEvent(handle, NULL, GATEWAY_STARTED);
+    mocks.ResetAllCalls();
+
+    // Expect
+    EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG));
+    EXPECTED_CALL(mocks, VECTOR_create(IGNORED_NUM_ARG));
+    EXPECTED_CALL(mocks, VECTOR_front(IGNORED_PTR_ARG));
+    EXPECTED_CALL(mocks, VECTOR_push_back(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG));
+    EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG));
+
+    // Act
+    EventSystem_ReportEvent(handle, NULL, GATEWAY_STARTED);
+
+    // Assert
+    mocks.AssertActualAndExpectedCalls();
+
+    // Cleanup
+    EventSystem_Destroy(handle);
+}
+
+/* Tests_SRS_EVENTSYSTEM_26_013: [ Should the worker thread ever fail to be created or any internall callbacks fail, failure will be logged and no further callbacks will be called during gateway's lifecycle. ] */
+TEST_FUNCTION(EventSystem_Persistent_Thread_Creation_Fails)
+{
+    // Arrange
+    CEventSystemMocks mocks;
+    EVENTSYSTEM_HANDLE handle = EventSystem_InitWithDispatcher(EVENTSYSTEM_DISPATCHER_PERSISTENT);
+    EventSystem_AddEventCallback(handle, GATEWAY_STARTED, countingCallback, NULL);
+    mocks.ResetAllCalls();
+
+    // Expect
+    EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG));
+    EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG));
+    EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG));
+    EXPECTED_CALL(mocks, VECTOR_create(IGNORED_NUM_ARG));
+    EXPECTED_CALL(mocks, VECTOR_front(IGNORED_PTR_ARG));
+    EXPECTED_CALL(mocks, VECTOR_push_back(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG));
+    EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG));
+    EXPECTED_CALL(mocks, ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .SetFailReturn(THREADAPI_ERROR);
+
+    // Act
+    EventSystem_ReportEvent(handle, NULL, GATEWAY_STARTED);
+    // nothing is done for the second event
+    EventSystem_ReportEvent(handle, NULL, GATEWAY_STARTED);
+
+    // Assert
+    mocks.AssertActualAndExpectedCalls();
+    ASSERT_IS_TRUE(callback_gw_history->empty());
+
+    // Cleanup
+    EventSystem_Destroy(handle);
+}
+
+/* Tests_SRS_EVENTSYSTEM_26_019: [ The `EVENTSYSTEM_DISPATCHER_PERSISTENT` dispatcher shall create its thread once and keep it until the event system is destroyed. ] */
+/* Tests_SRS_EVENTSYSTEM_26_022: [ The `EVENTSYSTEM_DISPATCHER_PERSISTENT` dispatcher thread shall wait without a timeout while there are no events, and exit only once the event system is being destroyed and no events are left. ] */
+TEST_FUNCTION(EventSystem_Persistent_Creates_Thread_Once)
+{
+    // Arrange
+    CEventSystemMocks mocks;
+    mocks.SetIgnoreUnexpectedCalls(true);
+    EVENTSYSTEM_HANDLE handle = EventSystem_InitWithDispatcher(EVENTSYSTEM_DISPATCHER_PERSISTENT);
+    EventSystem_AddEventCallback(handle, GATEWAY_STARTED, countingCallback, NULL);
+
+    // Act
+    EventSystem_ReportEvent(handle, NULL, GATEWAY_STARTED);
+    THREAD_START_FUNC thread_func = last_thread_func;
+    last_thread_func = NULL;
+    EventSystem_ReportEvent(handle, NULL, GATEWAY_STARTED);
+
+    // Assert
+    ASSERT_IS_NOT_NULL((void*)thread_func);
+    ASSERT_IS_NULL((void*)last_thread_func);
+    ASSERT_ARE_EQUAL(int, callback_gw_history->size(), 0);
+
+    // simulate the thread running, the wait failing lets it return
+    mocks.ResetAllCalls();
+    condition_wait_result = COND_ERROR;
+    EXPECTED_CALL(mocks, Condition_Wait(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 0));
+    thread_func(last_thread_arg);
+    ASSERT_ARE_EQUAL(int, callback_gw_history->size(), 2);
+    mocks.AssertActualAndExpectedCalls();
+
+    // Cleanup
+    EventSystem_Destroy(handle);
+}
+
+/* Tests_SRS_EVENTSYSTEM_26_021: [ When several `GATEWAY_MODULE_LIST_CHANGED` events are waiting back to back, the `EVENTSYSTEM_DISPATCHER_PERSISTENT` dispatcher shall only deliver the last of them and clean up the module lists of the others. ] */
+TEST_FUNCTION(EventSystem_Persistent_Coalesces_Module_List_Events)
+{
+    // Arrange
+    CEventSystemMocks mocks;
+    mocks.SetIgnoreUnexpectedCalls(true);
+    module_list = BASEIMPLEMENTATION::VECTOR_create(1);
+    EVENTSYSTEM_HANDLE handle = EventSystem_InitWithDispatcher(EVENTSYSTEM_DISPATCHER_PERSISTENT);
+    EventSystem_AddEventCallback(handle, GATEWAY_STARTED, countingCallback, NULL);
+    EventSystem_AddEventCallback(handle, GATEWAY_MODULE_LIST_CHANGED, countingCallback, NULL);
+    condition_wait_result = COND_ERROR;
+
+    // Act
+    EventSystem_ReportEvent(handle, NULL, GATEWAY_MODULE_LIST_CHANGED);
+    EventSystem_ReportEvent(handle, NULL, GATEWAY_MODULE_LIST_CHANGED);
+    EventSystem_ReportEvent(handle, NULL, GATEWAY_STARTED);
+    EventSystem_ReportEvent(handle, NULL, GATEWAY_MODULE_LIST_CHANGED);
+    last_thread_func(last_thread_arg);
+
+    // Assert
+    // the first two collapse into one, the one after GATEWAY_STARTED is delivered on its own
+    ASSERT_ARE_EQUAL(int, callback_per_event_count[GATEWAY_MODULE_LIST_CHANGED], 2);
+    ASSERT_ARE_EQUAL(int, callback_per_event_count[GATEWAY_STARTED], 1);
+    ASSERT_ARE_EQUAL(int, destroyed_module_lists, 3);
+
+    // Cleanup
+    BASEIMPLEMENTATION::VECTOR_destroy(module_list);
+    EventSystem_Destroy(handle);
+}
+
+/* Tests_SRS_EVENTSYSTEM_26_017: [ This function shall create an event system with the `EVENTSYSTEM_DISPATCHER_ON_DEMAND` dispatcher. ] */
+TEST_FUNCTION(EventSystem_OnDemand_Delivers_Every_Module_List_Event)
+{
+    // Arrange
+    CEventSystemMocks mocks;
+    mocks.SetIgnoreUnexpectedCalls(true);
+    module_list = BASEIMPLEMENTATION::VECTOR_create(1);
+    EVENTSYSTEM_HANDLE handle = EventSystem_Init();
+    EventSystem_AddEventCallback(handle, GATEWAY_MODULE_LIST_CHANGED, countingCallback, NULL);
+
+    // Act
+    EventSystem_ReportEvent(handle, NULL, GATEWAY_MODULE_LIST_CHANGED);
+    EventSystem_ReportEvent(handle, NULL, GATEWAY_MODULE_LIST_CHANGED);
+    EventSystem_ReportEvent(handle, NULL, GATEWAY_MODULE_LIST_CHANGED);
+    last_thread_func(last_thread_arg);
+
+    // Assert
+    // unlike the persistent dispatcher, nothing is coalesced
+    ASSERT_ARE_EQUAL(int, callback_per_event_count[GATEWAY_MODULE_LIST_CHANGED], 3);
+    ASSERT_ARE_EQUAL(int, destroyed_module_lists, 3);
+
+    // Cleanup
+    BASEIMPLEMENTATION::VECTOR_destroy(module_list);
+    EventSystem_Destroy(handle);
+}
+
+/* Tests_SRS_EVENTSYSTEM_26_017: [ This function shall create an event system with the `EVENTSYSTEM_DISPATCHER_ON_DEMAND` dispatcher. ] */
+TEST_FUNCTION(EventSystem_OnDemand_Thread_Waits_With_Timeout_And_Quits)
+{
+    // Arrange
+    CEventSystemMocks mocks;
+    mocks.SetIgnoreUnexpectedCalls(true);
+    EVENTSYSTEM_HANDLE handle = EventSystem_Init();
+    EventSystem_AddEventCallback(handle, GATEWAY_STARTED, countingCallback, NULL);
+    EventSystem_ReportEvent(handle, NULL, GATEWAY_STARTED);
+    mocks.ResetAllCalls();
+
+    // Expect
+    // the queue is empty after the first event, the thread waits 200 ms once and returns
+    EXPECTED_CALL(mocks, Condition_Wait(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 200));
+
+    // Act
+    last_thread_func(last_thread_arg);
+
+    // Assert
+    mocks.AssertActualAndExpectedCalls();
+    ASSERT_ARE_EQUAL(int, callback_per_event_count[GATEWAY_STARTED], 1);
+
+    // Cleanup
+    EventSystem_Destroy(handle);
+}
+
 /* Tests_SRS_EVENTSYSTEM_26_009: [ This function shall call all registered callbacks in First-In-First-Out order in terms registration. ] */
 TEST_FUNCTION(EventSystem_Report_CallOrder)
 {
@@ -1122,6 +1449,281 @@ TEST_FUNCTION(EventSystem_ReportEvent_Modules_Pushback_Fails)
     EventSystem_Destroy(handle);
 }
 
+/* Tests_SRS_EVENTSYSTEM_26_023: [ This event shall provide `VECTOR_HANDLE` as returned from #Gateway_GetMetricsSnapshot as the event context in callbacks ] */
+/* Tests_SRS_EVENTSYSTEM_26_024: [ This event shall clean up the `VECTOR_HANDLE` of #Gateway_GetMetricsSnapshot after finishing all the callbacks ] */
+TEST_FUNCTION(EventSystem_ReportEvent_Metrics_Snapshot_Given)
+{
+    // Arrange
+    CNiceCallComparer<CEventSystemMocks> mocks;
+    metrics_snapshot = BASEIMPLEMENTATION::VECTOR_create(1);
+    EVENTSYSTEM_HANDLE handle = EventSystem_Init();
+    EventSystem_AddEventCallback(handle, GATEWAY_METRICS_SNAPSHOT, catch_context_callback, NULL);
+    mocks.ResetAllCalls();
+
+    // Expect
+    EXPECTED_CALL(mocks, Gateway_GetMetricsSnapshot(IGNORED_PTR_ARG));
+    EXPECTED_CALL(mocks, Gateway_DestroyMetricsSnapshot(IGNORED_PTR_ARG));
+    EXPECTED_CALL(mocks, Gateway_GetModuleList(IGNORED_PTR_ARG))
+        .NeverInvoked();
+
+    // Act
+    EventSystem_ReportEvent(handle, NULL, GATEWAY_METRICS_SNAPSHOT);
+    // simulate the thread running
+    last_thread_func(last_thread_arg);
+
+    // Assert
+    ASSERT_IS_TRUE(metrics_snapshot == (VECTOR_HANDLE)last_context);
+    ASSERT_ARE_EQUAL(int, 1, destroyed_metrics_snapshots);
+    mocks.AssertActualAndExpectedCalls();
+
+    // Cleanup
+    BASEIMPLEMENTATION::VECTOR_destroy(metrics_snapshot);
+    EventSystem_Destroy(handle);
+}
+
+TEST_FUNCTION(EventSystem_ReportEvent_Metrics_Snapshot_Fails)
+{
+    // Arrange
+    CNiceCallComparer<CEventSystemMocks> mocks;
+    EVENTSYSTEM_HANDLE handle = EventSystem_Init();
+    EventSystem_AddEventCallback(handle, GATEWAY_METRICS_SNAPSHOT, catch_context_callback, NULL);
+    mocks.ResetAllCalls();
+
+    // Expect
+    EXPECTED_CALL(mocks, Gateway_GetMetricsSnapshot(IGNORED_PTR_ARG))
+        .SetFailReturn((VECTOR_HANDLE)NULL);
+    EXPECTED_CALL(mocks, ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .NeverInvoked();
+
+    // Act
+    EventSystem_ReportEvent(handle, NULL, GATEWAY_METRICS_SNAPSHOT);
+
+    // Assert
+    ASSERT_ARE_EQUAL(int, 0, destroyed_metrics_snapshots);
+    mocks.AssertActualAndExpectedCalls();
+
+    // Cleanup
+    EventSystem_Destroy(handle);
+}
+
+/* Tests_SRS_EVENTSYSTEM_26_025: [ This event shall provide `VECTOR_HANDLE` as returned from #Gateway_GetStuckModules as the event context in callbacks ] */
+/* Tests_SRS_EVENTSYSTEM_26_026: [ This event shall clean up the `VECTOR_HANDLE` of #Gateway_GetStuckModules after finishing all the callbacks ] */
+TEST_FUNCTION(EventSystem_ReportEvent_Module_Stuck_Given)
+{
+    // Arrange
+    CNiceCallComparer<CEventSystemMocks> mocks;
+    stuck_modules = BASEIMPLEMENTATION::VECTOR_create(1);
+    EVENTSYSTEM_HANDLE handle = EventSystem_Init();
+    EventSystem_AddEventCallback(handle, GATEWAY_MODULE_STUCK, catch_context_callback, NULL);
+    mocks.ResetAllCalls();
+
+    // Expect
+    EXPECTED_CALL(mocks, Gateway_GetStuckModules(IGNORED_PTR_ARG));
+    EXPECTED_CALL(mocks, Gateway_DestroyStuckModules(IGNORED_PTR_ARG));
+    EXPECTED_CALL(mocks, Gateway_GetMetricsSnapshot(IGNORED_PTR_ARG))
+        .NeverInvoked();
+
+    // Act
+    EventSystem_ReportEvent(handle, NULL, GATEWAY_MODULE_STUCK);
+    // simulate the thread running
+    last_thread_func(last_thread_arg);
+
+    // Assert
+    ASSERT_IS_TRUE(stuck_modules == (VECTOR_HANDLE)last_context);
+    ASSERT_ARE_EQUAL(int, 1, destroyed_stuck_modules);
+    mocks.AssertActualAndExpectedCalls();
+
+    // Cleanup
+    BASEIMPLEMENTATION::VECTOR_destroy(stuck_modules);
+    EventSystem_Destroy(handle);
+}
+
+/* Tests_SRS_EVENTSYSTEM_26_027: [ This event shall provide `VECTOR_HANDLE` as returned from #Gateway_GetModulesOverBudget as the event context in callbacks ] */
+/* Tests_SRS_EVENTSYSTEM_26_028: [ This event shall clean up the `VECTOR_HANDLE` of #Gateway_GetModulesOverBudget after finishing all the callbacks ] */
+TEST_FUNCTION(EventSystem_ReportEvent_Module_Over_Budget_Given)
+{
+    // Arrange
+    CNiceCallComparer<CEventSystemMocks> mocks;
+    modules_over_budget = BASEIMPLEMENTATION::VECTOR_create(1);
+    EVENTSYSTEM_HANDLE handle = EventSystem_Init();
+    EventSystem_AddEventCallback(handle, GATEWAY_MODULE_OVER_BUDGET, catch_context_callback, NULL);
+    mocks.ResetAllCalls();
+
+    // Expect
+    EXPECTED_CALL(mocks, Gateway_GetModulesOverBudget(IGNORED_PTR_ARG));
+    EXPECTED_CALL(mocks, Gateway_DestroyModulesOverBudget(IGNORED_PTR_ARG));
+    EXPECTED_CALL(mocks, Gateway_GetStuckModules(IGNORED_PTR_ARG))
+        .NeverInvoked();
+
+    // Act
+    EventSystem_ReportEvent(handle, NULL, GATEWAY_MODULE_OVER_BUDGET);
+    // simulate the thread running
+    last_thread_func(last_thread_arg);
+
+    // Assert
+    ASSERT_IS_TRUE(modules_over_budget == (VECTOR_HANDLE)last_context);
+    ASSERT_ARE_EQUAL(int, 1, destroyed_modules_over_budget);
+    mocks.AssertActualAndExpectedCalls();
+
+    // Cleanup
+    BASEIMPLEMENTATION::VECTOR_destroy(modules_over_budget);
+    EventSystem_Destroy(handle);
+}
+
+/* Tests_SRS_EVENTSYSTEM_26_029: [ This event shall provide `GATEWAY_LOAD_SHEDDING_STATE*` as returned from #Gateway_GetLoadSheddingState as the event context in callbacks ] */
+/* Tests_SRS_EVENTSYSTEM_26_030: [ This event shall clean up the `GATEWAY_LOAD_SHEDDING_STATE*` of #Gateway_GetLoadSheddingState after finishing all the callbacks ] */
+TEST_FUNCTION(EventSystem_ReportEvent_Load_Shedding_Changed_Given)
+{
+    // Arrange
+    CNiceCallComparer<CEventSystemMocks> mocks;
+    EVENTSYSTEM_HANDLE handle = EventSystem_Init();
+    EventSystem_AddEventCallback(handle, GATEWAY_LOAD_SHEDDING_CHANGED, catch_context_callback, NULL);
+    mocks.ResetAllCalls();
+
+    // Expect
+    EXPECTED_CALL(mocks, Gateway_GetLoadSheddingState(IGNORED_PTR_ARG));
+    EXPECTED_CALL(mocks, Gateway_DestroyLoadSheddingState(IGNORED_PTR_ARG));
+    EXPECTED_CALL(mocks, Gateway_GetModulesOverBudget(IGNORED_PTR_ARG))
+        .NeverInvoked();
+
+    // Act
+    EventSystem_ReportEvent(handle, NULL, GATEWAY_LOAD_SHEDDING_CHANGED);
+    // simulate the thread running
+    last_thread_func(last_thread_arg);
+
+    // Assert
+    ASSERT_IS_TRUE(&load_shedding_state == (GATEWAY_LOAD_SHEDDING_STATE*)last_context);
+    ASSERT_ARE_EQUAL(int, 1, destroyed_load_shedding_states);
+    mocks.AssertActualAndExpectedCalls();
+
+    // Cleanup
+    EventSystem_Destroy(handle);
+}
+
+/* Tests_SRS_EVENTSYSTEM_26_031: [ This event shall provide the JSON string returned from #Gateway_GetStartupReport as the event context in callbacks ] */
+/* Tests_SRS_EVENTSYSTEM_26_032: [ This event shall clean up the string of #Gateway_GetStartupReport after finishing all the callbacks ] */
+TEST_FUNCTION(EventSystem_ReportEvent_Startup_Reported_Given)
+{
+    // Arrange
+    CNiceCallComparer<CEventSystemMocks> mocks;
+    EVENTSYSTEM_HANDLE handle = EventSystem_Init();
+    EventSystem_AddEventCallback(handle, GATEWAY_STARTUP_REPORTED, catch_context_callback, NULL);
+    mocks.ResetAllCalls();
+
+    // Expect
+    EXPECTED_CALL(mocks, Gateway_GetStartupReport(IGNORED_PTR_ARG));
+    EXPECTED_CALL(mocks, Gateway_DestroyStartupReport(IGNORED_PTR_ARG));
+    EXPECTED_CALL(mocks, Gateway_GetLoadSheddingState(IGNORED_PTR_ARG))
+        .NeverInvoked();
+
+    // Act
+    EventSystem_ReportEvent(handle, NULL, GATEWAY_STARTUP_REPORTED);
+    // simulate the thread running
+    last_thread_func(last_thread_arg);
+
+    // Assert
+    ASSERT_IS_TRUE(startup_report == (char*)last_context);
+    ASSERT_ARE_EQUAL(int, 1, destroyed_startup_reports);
+    mocks.AssertActualAndExpectedCalls();
+
+    // Cleanup
+    EventSystem_Destroy(handle);
+}
+
+/* Tests_SRS_EVENTSYSTEM_17_002: [ This function shall report `event_type` the way `EventSystem_ReportEvent` does. ] */
+/* Tests_SRS_EVENTSYSTEM_17_005: [ `GATEWAY_MODULE_ADDED` and `GATEWAY_MODULE_REMOVED` shall provide a copy of the name of the module as the event context in callbacks ] */
+/* Tests_SRS_EVENTSYSTEM_17_006: [ `GATEWAY_MODULE_ADDED` and `GATEWAY_MODULE_REMOVED` shall free the copy of the name after finishing all the callbacks ] */
+TEST_FUNCTION(EventSystem_ReportModuleEvent_Name_Given)
+{
+    // Arrange
+    CNiceCallComparer<CEventSystemMocks> mocks;
+    char module_name[] = "module1";
+    EVENTSYSTEM_HANDLE handle = EventSystem_Init();
+    EventSystem_AddEventCallback(handle, GATEWAY_MODULE_ADDED, catch_change_callback, NULL);
+    mocks.ResetAllCalls();
+
+    // Expect
+    EXPECTED_CALL(mocks, gballoc_malloc(sizeof(module_name)));
+    EXPECTED_CALL(mocks, Gateway_GetModuleList(IGNORED_PTR_ARG))
+        .NeverInvoked();
+
+    // Act
+    EventSystem_ReportModuleEvent(handle, NULL, GATEWAY_MODULE_ADDED, module_name);
+    // simulate the thread running
+    last_thread_func(last_thread_arg);
+
+    // Assert
+    ASSERT_ARE_EQUAL(char_ptr, "module1", last_module_name.c_str());
+    ASSERT_IS_TRUE((void*)module_name != last_context);
+    mocks.AssertActualAndExpectedCalls();
+
+    // Cleanup
+    EventSystem_Destroy(handle);
+}
+
+/* Tests_SRS_EVENTSYSTEM_17_004: [ This function shall report `event_type` the way `EventSystem_ReportEvent` does. ] */
+/* Tests_SRS_EVENTSYSTEM_17_007: [ `GATEWAY_LINK_ADDED` and `GATEWAY_LINK_REMOVED` shall provide a copy of the `GATEWAY_LINK_ENTRY`, allocated together with its module names, as the event context in callbacks ] */
+/* Tests_SRS_EVENTSYSTEM_17_008: [ `GATEWAY_LINK_ADDED` and `GATEWAY_LINK_REMOVED` shall free the copy of the link after finishing all the callbacks ] */
+TEST_FUNCTION(EventSystem_ReportLinkEvent_Link_Given)
+{
+    // Arrange
+    CNiceCallComparer<CEventSystemMocks> mocks;
+    GATEWAY_LINK_ENTRY link = { "source", "sink" };
+    EVENTSYSTEM_HANDLE handle = EventSystem_Init();
+    EventSystem_AddEventCallback(handle, GATEWAY_LINK_REMOVED, catch_change_callback, NULL);
+    mocks.ResetAllCalls();
+
+    // Expect
+    EXPECTED_CALL(mocks, gballoc_malloc(sizeof(GATEWAY_LINK_ENTRY) + sizeof("source") + sizeof("sink")));
+    EXPECTED_CALL(mocks, Gateway_GetModuleList(IGNORED_PTR_ARG))
+        .NeverInvoked();
+
+    // Act
+    EventSystem_ReportLinkEvent(handle, NULL, GATEWAY_LINK_REMOVED, &link);
+    // simulate the thread running
+    last_thread_func(last_thread_arg);
+
+    // Assert
+    ASSERT_ARE_EQUAL(char_ptr, "source", last_link_source.c_str());
+    ASSERT_ARE_EQUAL(char_ptr, "sink", last_link_sink.c_str());
+    ASSERT_IS_TRUE((void*)&link != last_context);
+    mocks.AssertActualAndExpectedCalls();
+
+    // Cleanup
+    EventSystem_Destroy(handle);
+}
+
+/* Tests_SRS_EVENTSYSTEM_17_001: [ This function shall log a failure and do nothing else when `event_type` is neither `GATEWAY_MODULE_ADDED` nor `GATEWAY_MODULE_REMOVED` or `module_name` is NULL. ] */
+/* Tests_SRS_EVENTSYSTEM_17_003: [ This function shall log a failure and do nothing else when `event_type` is neither `GATEWAY_LINK_ADDED` nor `GATEWAY_LINK_REMOVED`, or `link` or one of its module names is NULL. ] */
+TEST_FUNCTION(EventSystem_Report_Change_Events_Invalid_Args)
+{
+    // Arrange
+    CNiceCallComparer<CEventSystemMocks> mocks;
+    GATEWAY_LINK_ENTRY link = { "source", NULL };
+    EVENTSYSTEM_HANDLE handle = EventSystem_Init();
+    EventSystem_AddEventCallback(handle, GATEWAY_MODULE_ADDED, countingCallback, NULL);
+    EventSystem_AddEventCallback(handle, GATEWAY_MODULE_LIST_CHANGED, countingCallback, NULL);
+    EventSystem_AddEventCallback(handle, GATEWAY_LINK_ADDED, countingCallback, NULL);
+    mocks.ResetAllCalls();
+
+    // Expect
+    EXPECTED_CALL(mocks, VECTOR_create(IGNORED_NUM_ARG))
+        .NeverInvoked();
+
+    // Act
+    EventSystem_ReportModuleEvent(handle, NULL, GATEWAY_MODULE_ADDED, NULL);
+    EventSystem_ReportModuleEvent(handle, NULL, GATEWAY_MODULE_LIST_CHANGED, "module1");
+    EventSystem_ReportLinkEvent(handle, NULL, GATEWAY_LINK_ADDED, NULL);
+    EventSystem_ReportLinkEvent(handle, NULL, GATEWAY_LINK_ADDED, &link);
+    EventSystem_ReportLinkEvent(handle, NULL, GATEWAY_MODULE_ADDED, &link);
+
+    // Assert
+    mocks.AssertActualAndExpectedCalls();
+
+    // Cleanup
+    EventSystem_Destroy(handle);
+}
+
 TEST_FUNCTION(EventSystem_ReportEvent_user_param_is_passed)
 {
     // Arrange
@@ -0,0 +1,365 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "testrunnerswitcher.h"
+#include "umock_c.h"
+
+static TEST_MUTEX_HANDLE g_testByTest;
+
+#include "internal/gateway_config_snapshot.h"
+
+#define TEST_SOURCE_FILE "gateway_config_snapshot_ut.json"
+#define TEST_SNAPSHOT_FILE "gateway_config_snapshot_ut.json.snapshot"
+#define TEST_SOURCE_HASH 0x1234567890abcdefULL
+
+static size_t currentmalloc_call;
+static size_t whenShallmalloc_fail;
+
+static void* my_gballoc_malloc(size_t size)
+{
+    void* result;
+    currentmalloc_call++;
+    if (whenShallmalloc_fail > 0 && currentmalloc_call == whenShallmalloc_fail)
+    {
+        result = NULL;
+    }
+    else
+    {
+        result = malloc(size);
+    }
+    return result;
+}
+
+static void my_gballoc_free(void* ptr)
+{
+    free(ptr);
+}
+
+#define ENABLE_MOCKS
+#include "azure_c_shared_utility/gballoc.h"
+#undef ENABLE_MOCKS
+
+static const GATEWAY_CONFIG_SNAPSHOT_MODULE test_modules[] =
+{
+    { "logger", "native", "{\"module.path\":\"liblogger.so\"}", "{\"filename\":\"log.txt\"}", "\"lazy\"", 42 },
+    { "hello_world", "outprocess", NULL, NULL, NULL, 7 }
+};
+
+static const GATEWAY_LINK_ENTRY test_links[] =
+{
+    { "*", "logger" },
+    { "hello_world", "logger" }
+};
+
+static void write_file(const char* file_path, const char* content, size_t length)
+{
+    FILE* file = fopen(file_path, "wb");
+    ASSERT_IS_NOT_NULL(file);
+    ASSERT_ARE_EQUAL(size_t, length, fwrite(content, 1, length, file));
+    ASSERT_ARE_EQUAL(int, 0, fclose(file));
+}
+
+static int write_test_snapshot(void)
+{
+    return GatewayConfigSnapshot_Write(TEST_SNAPSHOT_FILE, TEST_SOURCE_HASH, "[{\"type\":\"java\"}]",
+        test_modules, sizeof(test_modules) / sizeof(test_modules[0]), test_links, sizeof(test_links) / sizeof(test_links[0]));
+}
+
+static void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
+{
+    (void)error_code;
+    ASSERT_FAIL("umock_c reported error");
+}
+
+BEGIN_TEST_SUITE(gateway_config_snapshot_ut)
+
+    TEST_SUITE_INITIALIZE(TestClassInitialize)
+    {
+        g_testByTest = TEST_MUTEX_CREATE();
+        ASSERT_IS_NOT_NULL(g_testByTest);
+
+        umock_c_init(on_umock_c_error);
+
+        REGISTER_GLOBAL_MOCK_HOOK(gballoc_malloc, my_gballoc_malloc);
+        REGISTER_GLOBAL_MOCK_HOOK(gballoc_free, my_gballoc_free);
+    }
+
+    TEST_SUITE_CLEANUP(TestClassCleanup)
+    {
+        TEST_MUTEX_DESTROY(g_testByTest);
+        umock_c_deinit();
+    }
+
+    TEST_FUNCTION_INITIALIZE(TestMethodInitialize)
+    {
+        if (TEST_MUTEX_ACQUIRE(g_testByTest) != 0)
+        {
+            ASSERT_FAIL("our mutex is ABANDONED. Failure in test framework");
+        }
+
+        umock_c_reset_all_calls();
+
+        currentmalloc_call = 0;
+        whenShallmalloc_fail = 0;
+    }
+
+    TEST_FUNCTION_CLEANUP(TestMethodCleanup)
+    {
+        (void)remove(TEST_SOURCE_FILE);
+        (void)remove(TEST_SNAPSHOT_FILE);
+        TEST_MUTEX_RELEASE(g_testByTest);
+    }
+
+    /*Tests_SRS_GATEWAY_SNAPSHOT_17_002: [ GatewayConfigSnapshot_ReadSource shall return the content of the file, NUL terminated, and set source_hash to the FNV-1a hash of it. ]*/
+    TEST_FUNCTION(GatewayConfigSnapshot_ReadSource_returns_content_and_hash)
+    {
+        ///arrange
+        uint64_t source_hash = 0;
+        write_file(TEST_SOURCE_FILE, "a", 1);
+
+        ///act
+        char* result = GatewayConfigSnapshot_ReadSource(TEST_SOURCE_FILE, &source_hash);
+
+        ///assert
+        ASSERT_IS_NOT_NULL(result);
+        ASSERT_ARE_EQUAL(char_ptr, "a", result);
+        ASSERT_IS_TRUE(source_hash == 0xaf63dc4c8601ec8cULL);
+
+        ///cleanup
+        my_gballoc_free(result);
+    }
+
+    /*Tests_SRS_GATEWAY_SNAPSHOT_17_001: [ If file_path or source_hash is NULL, GatewayConfigSnapshot_ReadSource shall return NULL. ]*/
+    TEST_FUNCTION(GatewayConfigSnapshot_ReadSource_returns_NULL_with_NULL_arguments)
+    {
+        ///arrange
+        uint64_t source_hash;
+
+        ///act
+        char* result1 = GatewayConfigSnapshot_ReadSource(NULL, &source_hash);
+        char* result2 = GatewayConfigSnapshot_ReadSource(TEST_SOURCE_FILE, NULL);
+
+        ///assert
+        ASSERT_IS_NULL(result1);
+        ASSERT_IS_NULL(result2);
+    }
+
+    /*Tests_SRS_GATEWAY_SNAPSHOT_17_003: [ GatewayConfigSnapshot_ReadSource shall return NULL if the file cannot be read or any underlying call fails. ]*/
+    TEST_FUNCTION(GatewayConfigSnapshot_ReadSource_returns_NULL_for_a_missing_file)
+    {
+        ///arrange
+        uint64_t source_hash;
+
+        ///act
+        char* result = GatewayConfigSnapshot_ReadSource(TEST_SOURCE_FILE, &source_hash);
+
+        ///assert
+        ASSERT_IS_NULL(result);
+    }
+
+    /*Tests_SRS_GATEWAY_SNAPSHOT_17_003: [ GatewayConfigSnapshot_ReadSource shall return NULL if the file cannot be read or any underlying call fails. ]*/
+    TEST_FUNCTION(GatewayConfigSnapshot_ReadSource_malloc_fails_returns_NULL)
+    {
+        ///arrange
+        uint64_t source_hash;
+        write_file(TEST_SOURCE_FILE, "{}", 2);
+        whenShallmalloc_fail = 1;
+
+        ///act
+        char* result = GatewayConfigSnapshot_ReadSource(TEST_SOURCE_FILE, &source_hash);
+
+        ///assert
+        ASSERT_IS_NULL(result);
+    }
+
+    /*Tests_SRS_GATEWAY_SNAPSHOT_17_005: [ GatewayConfigSnapshot_Write shall write source_hash, loaders, every module and every link to snapshot_path followed by .tmp and then rename it to snapshot_path. ]*/
+    /*Tests_SRS_GATEWAY_SNAPSHOT_17_007: [ GatewayConfigSnapshot_Write shall return 0 upon success. ]*/
+    /*Tests_SRS_GATEWAY_SNAPSHOT_17_010: [ Otherwise GatewayConfigSnapshot_Open shall return a handle to the mapped snapshot. ]*/
+    /*Tests_SRS_GATEWAY_SNAPSHOT_17_011: [ The getters shall return the loaders, modules and links that were written to the snapshot, with strings pointing into the mapping. ]*/
+    /*Tests_SRS_GATEWAY_SNAPSHOT_17_012: [ GatewayConfigSnapshot_Close shall unmap the snapshot and free the handle; if snapshot is NULL it shall do nothing. ]*/
+    TEST_FUNCTION(GatewayConfigSnapshot_Open_returns_what_was_written)
+    {
+        ///arrange
+        GATEWAY_CONFIG_SNAPSHOT_MODULE module;
+        GATEWAY_LINK_ENTRY link;
+        int write_result = write_test_snapshot();
+
+        ///act
+        GATEWAY_CONFIG_SNAPSHOT_HANDLE snapshot = GatewayConfigSnapshot_Open(TEST_SNAPSHOT_FILE, TEST_SOURCE_HASH);
+
+        ///assert
+        ASSERT_ARE_EQUAL(int, 0, write_result);
+        ASSERT_IS_NULL(fopen(TEST_SNAPSHOT_FILE ".tmp", "rb"));
+        ASSERT_IS_NOT_NULL(snapshot);
+        ASSERT_ARE_EQUAL(char_ptr, "[{\"type\":\"java\"}]", GatewayConfigSnapshot_GetLoaders(snapshot));
+        ASSERT_ARE_EQUAL(size_t, 2, GatewayConfigSnapshot_GetModuleCount(snapshot));
+        GatewayConfigSnapshot_GetModule(snapshot, 0, &module);
+        ASSERT_ARE_EQUAL(char_ptr, "logger", module.module_name);
+        ASSERT_ARE_EQUAL(char_ptr, "native", module.loader_name);
+        ASSERT_ARE_EQUAL(char_ptr, "{\"module.path\":\"liblogger.so\"}", module.entrypoint);
+        ASSERT_ARE_EQUAL(char_ptr, "{\"filename\":\"log.txt\"}", module.args);
+        ASSERT_ARE_EQUAL(char_ptr, "\"lazy\"", module.activation);
+        ASSERT_IS_TRUE(module.configuration_hash == 42);
+        GatewayConfigSnapshot_GetModule(snapshot, 1, &module);
+        ASSERT_ARE_EQUAL(char_ptr, "hello_world", module.module_name);
+        ASSERT_ARE_EQUAL(char_ptr, "outprocess", module.loader_name);
+        ASSERT_IS_NULL(module.entrypoint);
+        ASSERT_IS_NULL(module.args);
+        ASSERT_IS_NULL(module.activation);
+        ASSERT_IS_TRUE(module.configuration_hash == 7);
+        ASSERT_ARE_EQUAL(size_t, 2, GatewayConfigSnapshot_GetLinkCount(snapshot));
+        GatewayConfigSnapshot_GetLink(snapshot, 0, &link);
+        ASSERT_ARE_EQUAL(char_ptr, "*", link.module_source);
+        ASSERT_ARE_EQUAL(char_ptr, "logger", link.module_sink);
+        GatewayConfigSnapshot_GetLink(snapshot, 1, &link);
+        ASSERT_ARE_EQUAL(char_ptr, "hello_world", link.module_source);
+        ASSERT_ARE_EQUAL(char_ptr, "logger", link.module_sink);
+
+        ///cleanup
+        GatewayConfigSnapshot_Close(snapshot);
+    }
+
+    /*Tests_SRS_GATEWAY_SNAPSHOT_17_011: [ The getters shall return the loaders, modules and links that were written to the snapshot, with strings pointing into the mapping. ]*/
+    TEST_FUNCTION(GatewayConfigSnapshot_Open_returns_an_empty_snapshot)
+    {
+        ///arrange
+        int write_result = GatewayConfigSnapshot_Write(TEST_SNAPSHOT_FILE, TEST_SOURCE_HASH, NULL, NULL, 0, NULL, 0);
+
+        ///act
+        GATEWAY_CONFIG_SNAPSHOT_HANDLE snapshot = GatewayConfigSnapshot_Open(TEST_SNAPSHOT_FILE, TEST_SOURCE_HASH);
+
+        ///assert
+        ASSERT_ARE_EQUAL(int, 0, write_result);
+        ASSERT_IS_NOT_NULL(snapshot);
+        ASSERT_IS_NULL(GatewayConfigSnapshot_GetLoaders(snapshot));
+        ASSERT_ARE_EQUAL(size_t, 0, GatewayConfigSnapshot_GetModuleCount(snapshot));
+        ASSERT_ARE_EQUAL(size_t, 0, GatewayConfigSnapshot_GetLinkCount(snapshot));
+
+        ///cleanup
+        GatewayConfigSnapshot_Close(snapshot);
+    }
+
+    /*Tests_SRS_GATEWAY_SNAPSHOT_17_009: [ GatewayConfigSnapshot_Open shall return NULL if the file is not a snapshot of this version, was written from a source of another hash or refers to anything outside of itself. ]*/
+    TEST_FUNCTION(GatewayConfigSnapshot_Open_returns_NULL_for_another_source)
+    {
+        ///arrange
+        ASSERT_ARE_EQUAL(int, 0, write_test_snapshot());
+
+        ///act
+        GATEWAY_CONFIG_SNAPSHOT_HANDLE snapshot = GatewayConfigSnapshot_Open(TEST_SNAPSHOT_FILE, TEST_SOURCE_HASH + 1);
+
+        ///assert
+        ASSERT_IS_NULL(snapshot);
+    }
+
+    /*Tests_SRS_GATEWAY_SNAPSHOT_17_009: [ GatewayConfigSnapshot_Open shall return NULL if the file is not a snapshot of this version, was written from a source of another hash or refers to anything outside of itself. ]*/
+    TEST_FUNCTION(GatewayConfigSnapshot_Open_returns_NULL_for_a_truncated_snapshot)
+    {
+        ///arrange
+        char content[4096];
+        size_t length;
+        FILE* file;
+        ASSERT_ARE_EQUAL(int, 0, write_test_snapshot());
+        file = fopen(TEST_SNAPSHOT_FILE, "rb");
+        ASSERT_IS_NOT_NULL(file);
+        length = fread(content, 1, sizeof(content), file);
+        (void)fclose(file);
+        write_file(TEST_SNAPSHOT_FILE, content, length - 1);
+
+        ///act
+        GATEWAY_CONFIG_SNAPSHOT_HANDLE snapshot = GatewayConfigSnapshot_Open(TEST_SNAPSHOT_FILE, TEST_SOURCE_HASH);
+
+        ///assert
+        ASSERT_IS_NULL(snapshot);
+    }
+
+    /*Tests_SRS_GATEWAY_SNAPSHOT_17_009: [ GatewayConfigSnapshot_Open shall return NULL if the file is not a snapshot of this version, was written from a source of another hash or refers to anything outside of itself. ]*/
+    TEST_FUNCTION(GatewayConfigSnapshot_Open_returns_NULL_for_a_file_that_is_not_a_snapshot)
+    {
+        ///arrange
+        static const char not_a_snapshot[] = "{\"modules\":[],\"links\":[],\"padding\":\"to be longer than a snapshot header\"}";
+        write_file(TEST_SNAPSHOT_FILE, not_a_snapshot, sizeof(not_a_snapshot));
+
+        ///act
+        GATEWAY_CONFIG_SNAPSHOT_HANDLE snapshot = GatewayConfigSnapshot_Open(TEST_SNAPSHOT_FILE, TEST_SOURCE_HASH);
+
+        ///assert
+        ASSERT_IS_NULL(snapshot);
+    }
+
+    /*Tests_SRS_GATEWAY_SNAPSHOT_17_008: [ If snapshot_path is NULL, or the file cannot be opened or mapped, GatewayConfigSnapshot_Open shall return NULL. ]*/
+    TEST_FUNCTION(GatewayConfigSnapshot_Open_returns_NULL_for_a_missing_snapshot)
+    {
+        ///act
+        GATEWAY_CONFIG_SNAPSHOT_HANDLE result1 = GatewayConfigSnapshot_Open(TEST_SNAPSHOT_FILE, TEST_SOURCE_HASH);
+        GATEWAY_CONFIG_SNAPSHOT_HANDLE result2 = GatewayConfigSnapshot_Open(NULL, TEST_SOURCE_HASH);
+
+        ///assert
+        ASSERT_IS_NULL(result1);
+        ASSERT_IS_NULL(result2);
+    }
+
+    /*Tests_SRS_GATEWAY_SNAPSHOT_17_004: [ If snapshot_path is NULL, or modules or links is NULL while its count is not 0, GatewayConfigSnapshot_Write shall fail and return a non-zero value. ]*/
+    TEST_FUNCTION(GatewayConfigSnapshot_Write_fails_with_NULL_arguments)
+    {
+        ///act
+        int result1 = GatewayConfigSnapshot_Write(NULL, TEST_SOURCE_HASH, NULL, test_modules, 2, test_links, 2);
+        int result2 = GatewayConfigSnapshot_Write(TEST_SNAPSHOT_FILE, TEST_SOURCE_HASH, NULL, NULL, 2, test_links, 2);
+        int result3 = GatewayConfigSnapshot_Write(TEST_SNAPSHOT_FILE, TEST_SOURCE_HASH, NULL, test_modules, 2, NULL, 2);
+
+        ///assert
+        ASSERT_ARE_NOT_EQUAL(int, 0, result1);
+        ASSERT_ARE_NOT_EQUAL(int, 0, result2);
+        ASSERT_ARE_NOT_EQUAL(int, 0, result3);
+        ASSERT_IS_NULL(fopen(TEST_SNAPSHOT_FILE, "rb"));
+    }
+
+    /*Tests_SRS_GATEWAY_SNAPSHOT_17_006: [ If any underlying call fails, GatewayConfigSnapshot_Write shall remove the file it wrote to, fail and return a non-zero value. ]*/
+    TEST_FUNCTION(GatewayConfigSnapshot_Write_malloc_fails_keeps_the_old_snapshot)
+    {
+        ///arrange
+        GATEWAY_CONFIG_SNAPSHOT_HANDLE snapshot;
+        ASSERT_ARE_EQUAL(int, 0, write_test_snapshot());
+        currentmalloc_call = 0;
+        whenShallmalloc_fail = 2;
+
+        ///act
+        int result = GatewayConfigSnapshot_Write(TEST_SNAPSHOT_FILE, TEST_SOURCE_HASH + 1, NULL, NULL, 0, NULL, 0);
+
+        ///assert
+        ASSERT_ARE_NOT_EQUAL(int, 0, result);
+        whenShallmalloc_fail = 0;
+        snapshot = GatewayConfigSnapshot_Open(TEST_SNAPSHOT_FILE, TEST_SOURCE_HASH);
+        ASSERT_IS_NOT_NULL(snapshot);
+        ASSERT_ARE_EQUAL(size_t, 2, GatewayConfigSnapshot_GetModuleCount(snapshot));
+
+        ///cleanup
+        GatewayConfigSnapshot_Close(snapshot);
+    }
+
+    /*Tests_SRS_GATEWAY_SNAPSHOT_17_006: [ If any underlying call fails, GatewayConfigSnapshot_Write shall remove the file it wrote to, fail and return a non-zero value. ]*/
+    TEST_FUNCTION(GatewayConfigSnapshot_Write_fails_when_the_file_cannot_be_opened)
+    {
+        ///act
+        int result = GatewayConfigSnapshot_Write("gateway_config_snapshot_ut_missing_directory/config.json.snapshot", TEST_SOURCE_HASH, NULL, NULL, 0, NULL, 0);
+
+        ///assert
+        ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    }
+
+    /*Tests_SRS_GATEWAY_SNAPSHOT_17_012: [ GatewayConfigSnapshot_Close shall unmap the snapshot and free the handle; if snapshot is NULL it shall do nothing. ]*/
+    TEST_FUNCTION(GatewayConfigSnapshot_Close_with_NULL_does_nothing)
+    {
+        ///act
+        GatewayConfigSnapshot_Close(NULL);
+
+        ///assert
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    }
+
+END_TEST_SUITE(gateway_config_snapshot_ut)
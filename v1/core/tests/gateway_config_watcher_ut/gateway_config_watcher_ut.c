@@ -0,0 +1,686 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include "testrunnerswitcher.h"
+#include "umock_c.h"
+
+static TEST_MUTEX_HANDLE g_testByTest;
+
+#include "gateway.h"
+
+#define TEST_GATEWAY ((GATEWAY_HANDLE)0x1)
+#define TEST_DIRECTORY "."
+#define TEST_FILE_NAME "gateway_config_watcher_ut.json"
+#define TEST_FILE TEST_DIRECTORY "/" TEST_FILE_NAME
+#define TEST_INOTIFY_FD 1000
+#define TEST_STOP_FD 1001
+
+static size_t currentmalloc_call;
+static size_t whenShallmalloc_fail;
+
+static void* my_gballoc_malloc(size_t size)
+{
+    void* result;
+    currentmalloc_call++;
+    if (whenShallmalloc_fail > 0 && currentmalloc_call == whenShallmalloc_fail)
+    {
+        result = NULL;
+    }
+    else
+    {
+        result = malloc(size);
+    }
+    return result;
+}
+
+static void my_gballoc_free(void* ptr)
+{
+    free(ptr);
+}
+
+#define ENABLE_MOCKS
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/threadapi.h"
+#undef ENABLE_MOCKS
+
+/*the watcher thread runs when the test joins it, so the tests script what it sees beforehand*/
+static THREAD_START_FUNC thread_func;
+static void* thread_arg;
+static bool fail_thread_create;
+
+static THREADAPI_RESULT my_ThreadAPI_Create(THREAD_HANDLE* threadHandle, THREAD_START_FUNC func, void* arg)
+{
+    THREADAPI_RESULT result;
+    if (fail_thread_create)
+    {
+        result = THREADAPI_ERROR;
+    }
+    else
+    {
+        *threadHandle = (THREAD_HANDLE)0x2;
+        thread_func = func;
+        thread_arg = arg;
+        result = THREADAPI_OK;
+    }
+    return result;
+}
+
+static THREADAPI_RESULT my_ThreadAPI_Join(THREAD_HANDLE threadHandle, int* res)
+{
+    (void)threadHandle;
+    *res = thread_func(thread_arg);
+    return THREADAPI_OK;
+}
+
+/*what the watcher did to the gateway*/
+static int reconciles;
+static char reconciled_content[64];
+static GATEWAY_UPDATE_FROM_JSON_RESULT reconcile_result;
+
+GATEWAY_UPDATE_FROM_JSON_RESULT Gateway_ReconcileFromJson(GATEWAY_HANDLE gw, const char* json_content)
+{
+    ASSERT_IS_TRUE(gw == TEST_GATEWAY);
+    reconciles++;
+    (void)snprintf(reconciled_content, sizeof(reconciled_content), "%s", json_content);
+    return reconcile_result;
+}
+
+/*inotify, eventfd and poll of the watcher; other file descriptors go to the system*/
+typedef enum TEST_POLL_TAG
+{
+    TEST_POLL_STOP,
+    TEST_POLL_CHANGE,
+    TEST_POLL_INTERRUPTED,
+    TEST_POLL_FAIL
+} TEST_POLL;
+
+#define TEST_MAX_POLLS 8
+
+static TEST_POLL polls[TEST_MAX_POLLS];
+static const char* poll_file_names[TEST_MAX_POLLS];
+static size_t poll_count;
+static size_t polled;
+static const char* pending_file_name;
+static bool fail_inotify_init;
+static bool fail_add_watch;
+static bool fail_eventfd;
+static bool fail_stop;
+static char watched_directory[64];
+static uint32_t watched_mask;
+static int inotify_closes;
+static int stop_closes;
+static int stops;
+
+static void script_poll(TEST_POLL what, const char* file_name)
+{
+    ASSERT_IS_TRUE(poll_count < TEST_MAX_POLLS);
+    polls[poll_count] = what;
+    poll_file_names[poll_count] = file_name;
+    poll_count++;
+}
+
+int inotify_init1(int flags)
+{
+    (void)flags;
+    return fail_inotify_init ? -1 : TEST_INOTIFY_FD;
+}
+
+int inotify_add_watch(int fd, const char* pathname, uint32_t mask)
+{
+    ASSERT_ARE_EQUAL(int, TEST_INOTIFY_FD, fd);
+    (void)snprintf(watched_directory, sizeof(watched_directory), "%s", pathname);
+    watched_mask = mask;
+    return fail_add_watch ? -1 : 1;
+}
+
+int eventfd(unsigned int initval, int flags)
+{
+    (void)initval;
+    (void)flags;
+    return fail_eventfd ? -1 : TEST_STOP_FD;
+}
+
+int poll(struct pollfd* fds, nfds_t nfds, int timeout)
+{
+    int result;
+    TEST_POLL what = polled < poll_count ? polls[polled] : TEST_POLL_STOP;
+    ASSERT_ARE_EQUAL(int, 2, (int)nfds);
+    ASSERT_ARE_EQUAL(int, -1, timeout);
+    ASSERT_ARE_EQUAL(int, TEST_STOP_FD, fds[0].fd);
+    ASSERT_ARE_EQUAL(int, TEST_INOTIFY_FD, fds[1].fd);
+    pending_file_name = polled < poll_count ? poll_file_names[polled] : NULL;
+    polled++;
+    switch (what)
+    {
+    case TEST_POLL_CHANGE:
+        fds[1].revents = POLLIN;
+        result = 1;
+        break;
+    case TEST_POLL_INTERRUPTED:
+        errno = EINTR;
+        result = -1;
+        break;
+    case TEST_POLL_FAIL:
+        errno = EBADF;
+        result = -1;
+        break;
+    default:
+        fds[0].revents = POLLIN;
+        result = 1;
+        break;
+    }
+    return result;
+}
+
+ssize_t read(int fd, void* buf, size_t count)
+{
+    ssize_t result;
+    if (fd != TEST_INOTIFY_FD)
+    {
+        result = (ssize_t)syscall(SYS_read, fd, buf, count);
+    }
+    else if (pending_file_name == NULL)
+    {
+        errno = EAGAIN;
+        result = -1;
+    }
+    else
+    {
+        /*one event, its name padded with NULs like the kernel does*/
+        struct inotify_event* event = (struct inotify_event*)buf;
+        size_t name_length = 16;
+        ASSERT_IS_TRUE(count >= sizeof(struct inotify_event) + name_length);
+        memset(event, 0, sizeof(struct inotify_event) + name_length);
+        event->wd = 1;
+        event->mask = IN_CLOSE_WRITE;
+        event->len = (uint32_t)name_length;
+        (void)strncpy(event->name, pending_file_name, name_length - 1);
+        pending_file_name = NULL;
+        result = (ssize_t)(sizeof(struct inotify_event) + name_length);
+    }
+    return result;
+}
+
+ssize_t write(int fd, const void* buf, size_t count)
+{
+    ssize_t result;
+    if (fd != TEST_STOP_FD)
+    {
+        result = (ssize_t)syscall(SYS_write, fd, buf, count);
+    }
+    else if (fail_stop)
+    {
+        errno = EBADF;
+        result = -1;
+    }
+    else
+    {
+        stops++;
+        result = (ssize_t)count;
+    }
+    return result;
+}
+
+int close(int fd)
+{
+    int result;
+    if (fd == TEST_INOTIFY_FD)
+    {
+        inotify_closes++;
+        result = 0;
+    }
+    else if (fd == TEST_STOP_FD)
+    {
+        stop_closes++;
+        result = 0;
+    }
+    else
+    {
+        result = (int)syscall(SYS_close, fd);
+    }
+    return result;
+}
+
+static void write_file(const char* content)
+{
+    FILE* file = fopen(TEST_FILE, "wb");
+    ASSERT_IS_NOT_NULL(file);
+    ASSERT_ARE_EQUAL(size_t, strlen(content), fwrite(content, 1, strlen(content), file));
+    ASSERT_ARE_EQUAL(int, 0, fclose(file));
+}
+
+static void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
+{
+    (void)error_code;
+    ASSERT_FAIL("umock_c reported error");
+}
+
+BEGIN_TEST_SUITE(gateway_config_watcher_ut)
+
+    TEST_SUITE_INITIALIZE(TestClassInitialize)
+    {
+        g_testByTest = TEST_MUTEX_CREATE();
+        ASSERT_IS_NOT_NULL(g_testByTest);
+
+        umock_c_init(on_umock_c_error);
+
+        REGISTER_UMOCK_ALIAS_TYPE(THREAD_HANDLE, void*);
+        REGISTER_UMOCK_ALIAS_TYPE(THREAD_START_FUNC, void*);
+        REGISTER_UMOCK_ALIAS_TYPE(THREADAPI_RESULT, int);
+
+        REGISTER_GLOBAL_MOCK_HOOK(gballoc_malloc, my_gballoc_malloc);
+        REGISTER_GLOBAL_MOCK_HOOK(gballoc_free, my_gballoc_free);
+        REGISTER_GLOBAL_MOCK_HOOK(ThreadAPI_Create, my_ThreadAPI_Create);
+        REGISTER_GLOBAL_MOCK_HOOK(ThreadAPI_Join, my_ThreadAPI_Join);
+    }
+
+    TEST_SUITE_CLEANUP(TestClassCleanup)
+    {
+        TEST_MUTEX_DESTROY(g_testByTest);
+        umock_c_deinit();
+    }
+
+    TEST_FUNCTION_INITIALIZE(TestMethodInitialize)
+    {
+        if (TEST_MUTEX_ACQUIRE(g_testByTest) != 0)
+        {
+            ASSERT_FAIL("our mutex is ABANDONED. Failure in test framework");
+        }
+
+        umock_c_reset_all_calls();
+
+        currentmalloc_call = 0;
+        whenShallmalloc_fail = 0;
+        thread_func = NULL;
+        thread_arg = NULL;
+        fail_thread_create = false;
+        reconciles = 0;
+        reconciled_content[0] = '\0';
+        reconcile_result = GATEWAY_UPDATE_FROM_JSON_SUCCESS;
+        poll_count = 0;
+        polled = 0;
+        pending_file_name = NULL;
+        fail_inotify_init = false;
+        fail_add_watch = false;
+        fail_eventfd = false;
+        fail_stop = false;
+        watched_directory[0] = '\0';
+        watched_mask = 0;
+        inotify_closes = 0;
+        stop_closes = 0;
+        stops = 0;
+    }
+
+    TEST_FUNCTION_CLEANUP(TestMethodCleanup)
+    {
+        (void)remove(TEST_FILE);
+        TEST_MUTEX_RELEASE(g_testByTest);
+    }
+
+    /*Tests_SRS_GATEWAY_JSON_17_029: [ If gw or file_path is NULL, Gateway_WatchConfigFile shall return NULL. ]*/
+    TEST_FUNCTION(Gateway_WatchConfigFile_returns_NULL_with_NULL_arguments)
+    {
+        ///arrange
+
+        ///act
+        GATEWAY_CONFIG_WATCHER_HANDLE result1 = Gateway_WatchConfigFile(NULL, TEST_FILE);
+        GATEWAY_CONFIG_WATCHER_HANDLE result2 = Gateway_WatchConfigFile(TEST_GATEWAY, NULL);
+
+        ///assert
+        ASSERT_IS_NULL(result1);
+        ASSERT_IS_NULL(result2);
+        ASSERT_IS_NULL(thread_func);
+    }
+
+    /*Tests_SRS_GATEWAY_JSON_17_031: [ Each time the file is written or moved into place, the watcher shall reconcile the gateway with its content using Gateway_ReconcileFromJson. ]*/
+    TEST_FUNCTION(Gateway_WatchConfigFile_watches_the_directory_of_the_file)
+    {
+        ///arrange
+        write_file("{}");
+
+        ///act
+        GATEWAY_CONFIG_WATCHER_HANDLE result = Gateway_WatchConfigFile(TEST_GATEWAY, TEST_FILE);
+
+        ///assert
+        ASSERT_IS_NOT_NULL(result);
+        ASSERT_IS_NOT_NULL(thread_func);
+        ASSERT_ARE_EQUAL(char_ptr, TEST_DIRECTORY, watched_directory);
+        ASSERT_IS_TRUE(watched_mask == (IN_CLOSE_WRITE | IN_MOVED_TO));
+
+        ///cleanup
+        Gateway_StopWatchingConfigFile(result);
+    }
+
+    /*Tests_SRS_GATEWAY_JSON_17_031: [ Each time the file is written or moved into place, the watcher shall reconcile the gateway with its content using Gateway_ReconcileFromJson. ]*/
+    TEST_FUNCTION(Gateway_WatchConfigFile_watches_the_current_directory_for_a_file_name)
+    {
+        ///arrange
+        write_file("{}");
+
+        ///act
+        GATEWAY_CONFIG_WATCHER_HANDLE result = Gateway_WatchConfigFile(TEST_GATEWAY, TEST_FILE_NAME);
+
+        ///assert
+        ASSERT_IS_NOT_NULL(result);
+        ASSERT_ARE_EQUAL(char_ptr, ".", watched_directory);
+
+        ///cleanup
+        Gateway_StopWatchingConfigFile(result);
+    }
+
+    /*Tests_SRS_GATEWAY_JSON_17_030: [ Gateway_WatchConfigFile shall read the file as it is now, so only later changes of it are applied. ]*/
+    /*Tests_SRS_GATEWAY_JSON_17_032: [ If the content of the file did not change since it was last applied, the watcher shall do nothing. ]*/
+    TEST_FUNCTION(watcher_does_not_apply_the_file_it_started_with)
+    {
+        ///arrange
+        GATEWAY_CONFIG_WATCHER_HANDLE watcher;
+        write_file("{\"a\":1}");
+        watcher = Gateway_WatchConfigFile(TEST_GATEWAY, TEST_FILE);
+        ASSERT_IS_NOT_NULL(watcher);
+        script_poll(TEST_POLL_CHANGE, TEST_FILE_NAME);
+
+        ///act
+        Gateway_StopWatchingConfigFile(watcher);
+
+        ///assert
+        ASSERT_ARE_EQUAL(int, 0, reconciles);
+        ASSERT_ARE_EQUAL(int, 2, (int)polled);
+    }
+
+    /*Tests_SRS_GATEWAY_JSON_17_031: [ Each time the file is written or moved into place, the watcher shall reconcile the gateway with its content using Gateway_ReconcileFromJson. ]*/
+    TEST_FUNCTION(watcher_reconciles_the_gateway_when_the_file_changes)
+    {
+        ///arrange
+        GATEWAY_CONFIG_WATCHER_HANDLE watcher;
+        write_file("{\"a\":1}");
+        watcher = Gateway_WatchConfigFile(TEST_GATEWAY, TEST_FILE);
+        ASSERT_IS_NOT_NULL(watcher);
+        write_file("{\"a\":2}");
+        script_poll(TEST_POLL_CHANGE, TEST_FILE_NAME);
+
+        ///act
+        Gateway_StopWatchingConfigFile(watcher);
+
+        ///assert
+        ASSERT_ARE_EQUAL(int, 1, reconciles);
+        ASSERT_ARE_EQUAL(char_ptr, "{\"a\":2}", reconciled_content);
+    }
+
+    /*Tests_SRS_GATEWAY_JSON_17_031: [ Each time the file is written or moved into place, the watcher shall reconcile the gateway with its content using Gateway_ReconcileFromJson. ]*/
+    TEST_FUNCTION(watcher_ignores_other_files_of_the_directory)
+    {
+        ///arrange
+        GATEWAY_CONFIG_WATCHER_HANDLE watcher;
+        write_file("{\"a\":1}");
+        watcher = Gateway_WatchConfigFile(TEST_GATEWAY, TEST_FILE);
+        ASSERT_IS_NOT_NULL(watcher);
+        write_file("{\"a\":2}");
+        script_poll(TEST_POLL_CHANGE, "other.json");
+
+        ///act
+        Gateway_StopWatchingConfigFile(watcher);
+
+        ///assert
+        ASSERT_ARE_EQUAL(int, 0, reconciles);
+    }
+
+    /*Tests_SRS_GATEWAY_JSON_17_031: [ Each time the file is written or moved into place, the watcher shall reconcile the gateway with its content using Gateway_ReconcileFromJson. ]*/
+    TEST_FUNCTION(watcher_keeps_waiting_when_poll_is_interrupted)
+    {
+        ///arrange
+        GATEWAY_CONFIG_WATCHER_HANDLE watcher;
+        write_file("{\"a\":1}");
+        watcher = Gateway_WatchConfigFile(TEST_GATEWAY, TEST_FILE);
+        ASSERT_IS_NOT_NULL(watcher);
+        write_file("{\"a\":2}");
+        script_poll(TEST_POLL_INTERRUPTED, NULL);
+        script_poll(TEST_POLL_CHANGE, TEST_FILE_NAME);
+
+        ///act
+        Gateway_StopWatchingConfigFile(watcher);
+
+        ///assert
+        ASSERT_ARE_EQUAL(int, 1, reconciles);
+        ASSERT_ARE_EQUAL(int, 3, (int)polled);
+    }
+
+    /*Tests_SRS_GATEWAY_JSON_17_031: [ Each time the file is written or moved into place, the watcher shall reconcile the gateway with its content using Gateway_ReconcileFromJson. ]*/
+    TEST_FUNCTION(watcher_stops_when_poll_fails)
+    {
+        ///arrange
+        GATEWAY_CONFIG_WATCHER_HANDLE watcher;
+        write_file("{\"a\":1}");
+        watcher = Gateway_WatchConfigFile(TEST_GATEWAY, TEST_FILE);
+        ASSERT_IS_NOT_NULL(watcher);
+        write_file("{\"a\":2}");
+        script_poll(TEST_POLL_FAIL, NULL);
+        script_poll(TEST_POLL_CHANGE, TEST_FILE_NAME);
+
+        ///act
+        Gateway_StopWatchingConfigFile(watcher);
+
+        ///assert
+        ASSERT_ARE_EQUAL(int, 0, reconciles);
+        ASSERT_ARE_EQUAL(int, 1, (int)polled);
+    }
+
+    /*Tests_SRS_GATEWAY_JSON_17_032: [ If the content of the file did not change since it was last applied, the watcher shall do nothing. ]*/
+    TEST_FUNCTION(watcher_applies_a_content_once)
+    {
+        ///arrange
+        GATEWAY_CONFIG_WATCHER_HANDLE watcher;
+        write_file("{\"a\":1}");
+        watcher = Gateway_WatchConfigFile(TEST_GATEWAY, TEST_FILE);
+        ASSERT_IS_NOT_NULL(watcher);
+        write_file("{\"a\":2}");
+        script_poll(TEST_POLL_CHANGE, TEST_FILE_NAME);
+        script_poll(TEST_POLL_CHANGE, TEST_FILE_NAME);
+
+        ///act
+        Gateway_StopWatchingConfigFile(watcher);
+
+        ///assert
+        ASSERT_ARE_EQUAL(int, 1, reconciles);
+        ASSERT_ARE_EQUAL(int, 3, (int)polled);
+    }
+
+    /*Tests_SRS_GATEWAY_JSON_17_032: [ If the content of the file did not change since it was last applied, the watcher shall do nothing. ]*/
+    TEST_FUNCTION(watcher_retries_a_content_that_failed_to_apply)
+    {
+        ///arrange
+        GATEWAY_CONFIG_WATCHER_HANDLE watcher;
+        write_file("{\"a\":1}");
+        watcher = Gateway_WatchConfigFile(TEST_GATEWAY, TEST_FILE);
+        ASSERT_IS_NOT_NULL(watcher);
+        write_file("{\"a\":2}");
+        reconcile_result = GATEWAY_UPDATE_FROM_JSON_ERROR;
+        script_poll(TEST_POLL_CHANGE, TEST_FILE_NAME);
+        script_poll(TEST_POLL_CHANGE, TEST_FILE_NAME);
+
+        ///act
+        Gateway_StopWatchingConfigFile(watcher);
+
+        ///assert
+        ASSERT_ARE_EQUAL(int, 2, reconciles);
+    }
+
+    /*Tests_SRS_GATEWAY_JSON_17_030: [ Gateway_WatchConfigFile shall read the file as it is now, so only later changes of it are applied. ]*/
+    TEST_FUNCTION(watcher_applies_a_file_that_did_not_exist_when_it_started)
+    {
+        ///arrange
+        GATEWAY_CONFIG_WATCHER_HANDLE watcher = Gateway_WatchConfigFile(TEST_GATEWAY, TEST_FILE);
+        ASSERT_IS_NOT_NULL(watcher);
+        write_file("{\"a\":1}");
+        script_poll(TEST_POLL_CHANGE, TEST_FILE_NAME);
+
+        ///act
+        Gateway_StopWatchingConfigFile(watcher);
+
+        ///assert
+        ASSERT_ARE_EQUAL(int, 1, reconciles);
+        ASSERT_ARE_EQUAL(char_ptr, "{\"a\":1}", reconciled_content);
+    }
+
+    /*Tests_SRS_GATEWAY_JSON_17_033: [ Gateway_WatchConfigFile shall return NULL if any underlying call fails. ]*/
+    TEST_FUNCTION(Gateway_WatchConfigFile_returns_NULL_when_malloc_fails)
+    {
+        size_t fail_at;
+        write_file("{}");
+        /*the watcher, its path and its directory; the content of the file is read again later if it cannot be now*/
+        for (fail_at = 1; fail_at <= 3; fail_at++)
+        {
+            ///arrange
+            currentmalloc_call = 0;
+            whenShallmalloc_fail = fail_at;
+
+            ///act
+            GATEWAY_CONFIG_WATCHER_HANDLE result = Gateway_WatchConfigFile(TEST_GATEWAY, TEST_FILE);
+
+            ///assert
+            ASSERT_IS_NULL(result);
+        }
+        ASSERT_IS_NULL(thread_func);
+        ASSERT_ARE_EQUAL(int, 0, inotify_closes);
+    }
+
+    /*Tests_SRS_GATEWAY_JSON_17_033: [ Gateway_WatchConfigFile shall return NULL if any underlying call fails. ]*/
+    TEST_FUNCTION(Gateway_WatchConfigFile_returns_NULL_when_inotify_init1_fails)
+    {
+        ///arrange
+        fail_inotify_init = true;
+
+        ///act
+        GATEWAY_CONFIG_WATCHER_HANDLE result = Gateway_WatchConfigFile(TEST_GATEWAY, TEST_FILE);
+
+        ///assert
+        ASSERT_IS_NULL(result);
+        ASSERT_ARE_EQUAL(int, 0, inotify_closes);
+        ASSERT_ARE_EQUAL(int, 0, stop_closes);
+    }
+
+    /*Tests_SRS_GATEWAY_JSON_17_033: [ Gateway_WatchConfigFile shall return NULL if any underlying call fails. ]*/
+    TEST_FUNCTION(Gateway_WatchConfigFile_returns_NULL_when_inotify_add_watch_fails)
+    {
+        ///arrange
+        fail_add_watch = true;
+
+        ///act
+        GATEWAY_CONFIG_WATCHER_HANDLE result = Gateway_WatchConfigFile(TEST_GATEWAY, TEST_FILE);
+
+        ///assert
+        ASSERT_IS_NULL(result);
+        ASSERT_ARE_EQUAL(int, 1, inotify_closes);
+        ASSERT_ARE_EQUAL(int, 0, stop_closes);
+    }
+
+    /*Tests_SRS_GATEWAY_JSON_17_033: [ Gateway_WatchConfigFile shall return NULL if any underlying call fails. ]*/
+    TEST_FUNCTION(Gateway_WatchConfigFile_returns_NULL_when_eventfd_fails)
+    {
+        ///arrange
+        fail_eventfd = true;
+
+        ///act
+        GATEWAY_CONFIG_WATCHER_HANDLE result = Gateway_WatchConfigFile(TEST_GATEWAY, TEST_FILE);
+
+        ///assert
+        ASSERT_IS_NULL(result);
+        ASSERT_ARE_EQUAL(int, 1, inotify_closes);
+        ASSERT_ARE_EQUAL(int, 0, stop_closes);
+    }
+
+    /*Tests_SRS_GATEWAY_JSON_17_033: [ Gateway_WatchConfigFile shall return NULL if any underlying call fails. ]*/
+    TEST_FUNCTION(Gateway_WatchConfigFile_returns_NULL_when_ThreadAPI_Create_fails)
+    {
+        ///arrange
+        fail_thread_create = true;
+
+        ///act
+        GATEWAY_CONFIG_WATCHER_HANDLE result = Gateway_WatchConfigFile(TEST_GATEWAY, TEST_FILE);
+
+        ///assert
+        ASSERT_IS_NULL(result);
+        ASSERT_ARE_EQUAL(int, 1, inotify_closes);
+        ASSERT_ARE_EQUAL(int, 1, stop_closes);
+    }
+
+    /*Tests_SRS_GATEWAY_JSON_17_034: [ If watcher is NULL, Gateway_StopWatchingConfigFile shall do nothing. ]*/
+    TEST_FUNCTION(Gateway_StopWatchingConfigFile_with_NULL_does_nothing)
+    {
+        ///arrange
+
+        ///act
+        Gateway_StopWatchingConfigFile(NULL);
+
+        ///assert
+        ASSERT_ARE_EQUAL(int, 0, stops);
+        ASSERT_ARE_EQUAL(int, 0, inotify_closes);
+    }
+
+    /*Tests_SRS_GATEWAY_JSON_17_035: [ Gateway_StopWatchingConfigFile shall stop the watcher thread, wait for it to end and free the watcher. ]*/
+    TEST_FUNCTION(Gateway_StopWatchingConfigFile_stops_the_thread_and_frees_the_watcher)
+    {
+        ///arrange
+        GATEWAY_CONFIG_WATCHER_HANDLE watcher;
+        write_file("{}");
+        watcher = Gateway_WatchConfigFile(TEST_GATEWAY, TEST_FILE);
+        ASSERT_IS_NOT_NULL(watcher);
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(ThreadAPI_Join(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .IgnoreArgument(1)
+            .IgnoreArgument(2);
+        STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(gballoc_free(watcher));
+
+        ///act
+        Gateway_StopWatchingConfigFile(watcher);
+
+        ///assert
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+        ASSERT_ARE_EQUAL(int, 1, stops);
+        ASSERT_ARE_EQUAL(int, 1, (int)polled);
+        ASSERT_ARE_EQUAL(int, 1, inotify_closes);
+        ASSERT_ARE_EQUAL(int, 1, stop_closes);
+    }
+
+    /*Tests_SRS_GATEWAY_JSON_17_035: [ Gateway_StopWatchingConfigFile shall stop the watcher thread, wait for it to end and free the watcher. ]*/
+    TEST_FUNCTION(Gateway_StopWatchingConfigFile_keeps_the_watcher_when_the_thread_cannot_be_stopped)
+    {
+        ///arrange
+        GATEWAY_CONFIG_WATCHER_HANDLE watcher;
+        write_file("{}");
+        watcher = Gateway_WatchConfigFile(TEST_GATEWAY, TEST_FILE);
+        ASSERT_IS_NOT_NULL(watcher);
+        umock_c_reset_all_calls();
+        fail_stop = true;
+
+        ///act
+        Gateway_StopWatchingConfigFile(watcher);
+
+        ///assert
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+        ASSERT_ARE_EQUAL(int, 0, inotify_closes);
+        ASSERT_ARE_EQUAL(int, 0, stop_closes);
+
+        ///cleanup
+        fail_stop = false;
+        Gateway_StopWatchingConfigFile(watcher);
+    }
+
+END_TEST_SUITE(gateway_config_watcher_ut)
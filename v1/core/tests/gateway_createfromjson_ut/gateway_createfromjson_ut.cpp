@@ -13,6 +13,7 @@
 
 #include "gateway.h"
 #include "../src/gateway_internal.h"
+#include "../src/internal/gateway_lazy_module.h"
 #include <parson.h>
 
 #include "azure_c_shared_utility/vector_types_internal.h"
@@ -21,6 +22,11 @@
 #endif
 
 #define DUMMY_JSON_PATH "x.json"
+
+/*the dispatcher the gateway was built with, see gateway_internal.c*/
+#ifndef GATEWAY_EVENT_DISPATCHER
+#define GATEWAY_EVENT_DISPATCHER EVENTSYSTEM_DISPATCHER_PERSISTENT
+#endif
 #define MISCONFIG_JSON_PATH "invalid_json.json"
 #define MISSING_INFO_JSON_PATH "missing_info_json.json"
 #define VALID_JSON_PATH "valid_json.json"
@@ -57,6 +63,11 @@ namespace BASEIMPLEMENTATION
 
 static MODULE_API_1 dummyAPIs;
 static size_t currentBroker_ref_count;
+static size_t started_modules_count;
+static size_t drained_modules_count;
+static size_t removed_modules_count;
+static size_t removed_undrained_count;
+static size_t module_create_failures;
 static MODULE_LOADER_API default_module_loader;
 static MODULE_LOADER dummyModuleLoader;
 static GATEWAY_MODULE_LOADER_INFO dummyLoaderInfo;
@@ -110,6 +121,14 @@ public:
         }
     MOCK_METHOD_END(JSON_Object*, object);
 
+    MOCK_STATIC_METHOD_2(, JSON_Value*, json_array_get_value, const JSON_Array*, arr, size_t, index)
+        JSON_Value* value = NULL;
+        if (arr != NULL)
+        {
+            value = (JSON_Value*)0x42;
+        }
+    MOCK_METHOD_END(JSON_Value*, value);
+
     MOCK_STATIC_METHOD_2(, const char*, json_object_get_string, const JSON_Object*, object, const char*, name)
         const char* string = NULL;
         if (object != NULL && name != NULL)
@@ -134,6 +153,15 @@ public:
         }
     MOCK_METHOD_END(JSON_Value*, value);
 
+    MOCK_STATIC_METHOD_1(, const char*, json_value_get_string, const JSON_Value*, value)
+    MOCK_METHOD_END(const char*, NULL);
+
+    MOCK_STATIC_METHOD_1(, JSON_Value_Type, json_value_get_type, const JSON_Value*, value)
+    MOCK_METHOD_END(JSON_Value_Type, JSONNumber);
+
+    MOCK_STATIC_METHOD_1(, double, json_value_get_number, const JSON_Value*, value)
+    MOCK_METHOD_END(double, 0);
+
     MOCK_STATIC_METHOD_1(, char*, json_serialize_to_string, const JSON_Value*, value)
         char* serialized_string = NULL;
         const char* text = "[serialized string]";
@@ -166,7 +194,7 @@ public:
         gateway->broker = (BROKER_HANDLE)Broker_Create();
         gateway->modules = VECTOR_create(sizeof(MODULE_DATA*));
         gateway->links = VECTOR_create(sizeof(LINK_DATA));
-        gateway->event_system = EventSystem_Init();
+        gateway->event_system = EventSystem_InitWithDispatcher(GATEWAY_EVENT_DISPATCHER);
         EventSystem_ReportEvent(gateway->event_system, gateway, GATEWAY_CREATED);
         EventSystem_ReportEvent(gateway->event_system, gateway, GATEWAY_MODULE_LIST_CHANGED);
     MOCK_METHOD_END(GATEWAY_HANDLE, gateway);
@@ -178,6 +206,10 @@ public:
     MOCK_STATIC_METHOD_1(, GATEWAY_START_RESULT, Gateway_Start, GATEWAY_HANDLE, gw)
     MOCK_METHOD_END(GATEWAY_START_RESULT, GATEWAY_START_SUCCESS);
 
+    MOCK_STATIC_METHOD_2(, void, Gateway_StartModule, GATEWAY_HANDLE, gw, MODULE_HANDLE, module)
+        ++started_modules_count;
+    MOCK_VOID_METHOD_END();
+
     /*Broker Mocks*/
     MOCK_STATIC_METHOD_0(, BROKER_HANDLE, Broker_Create)
         ++currentBroker_ref_count;
@@ -214,6 +246,16 @@ public:
     MOCK_METHOD_END(BROKER_RESULT, BROKER_OK);
 
     MOCK_STATIC_METHOD_2(, BROKER_RESULT, Broker_RemoveModule, BROKER_HANDLE, handle, const MODULE*, module)
+        if (removed_modules_count++ >= drained_modules_count)
+        {
+            ++removed_undrained_count;
+        }
+    MOCK_METHOD_END(BROKER_RESULT, BROKER_OK);
+
+    MOCK_STATIC_METHOD_4(, BROKER_RESULT, Broker_DrainModule, BROKER_HANDLE, handle, MODULE_HANDLE, module, unsigned int, timeout_ms, BROKER_MODULE_DRAIN*, drain)
+        ++drained_modules_count;
+        drain->messages_drained = 0;
+        drain->messages_abandoned = 0;
     MOCK_METHOD_END(BROKER_RESULT, BROKER_OK);
 
     MOCK_STATIC_METHOD_2(, BROKER_RESULT, Broker_AddLink, BROKER_HANDLE, handle, const BROKER_LINK_DATA*, link)
@@ -222,6 +264,12 @@ public:
     MOCK_STATIC_METHOD_2(, BROKER_RESULT, Broker_RemoveLink, BROKER_HANDLE, handle, const BROKER_LINK_DATA*, link)
     MOCK_METHOD_END(BROKER_RESULT, BROKER_OK)
 
+    MOCK_STATIC_METHOD_2(, BROKER_RESULT, Broker_AddAnySourceLink, BROKER_HANDLE, handle, MODULE_HANDLE, sink)
+    MOCK_METHOD_END(BROKER_RESULT, BROKER_OK)
+
+    MOCK_STATIC_METHOD_2(, BROKER_RESULT, Broker_RemoveAnySourceLink, BROKER_HANDLE, handle, MODULE_HANDLE, sink)
+    MOCK_METHOD_END(BROKER_RESULT, BROKER_OK)
+
     /*ModuleLoader Mocks*/
     MOCK_STATIC_METHOD_0(, const MODULE_LOADER_API*, DynamicLoader_GetApi)
     MOCK_METHOD_END(const MODULE_LOADER_API*, &default_module_loader);
@@ -261,6 +309,9 @@ public:
         BASEIMPLEMENTATION::gballoc_free((void*)module_configuration);
     MOCK_VOID_METHOD_END();
 
+    MOCK_STATIC_METHOD_2(, int, GatewayLazyModule_Wrap, GATEWAY_MODULE_LOADER_INFO*, loader_info, const GATEWAY_LAZY_ACTIVATION*, activation)
+    MOCK_METHOD_END(int, 0);
+
     MOCK_STATIC_METHOD_0(, MODULE_LOADER_RESULT, ModuleLoader_Initialize);
     MOCK_METHOD_END(MODULE_LOADER_RESULT, MODULE_LOADER_SUCCESS);
 
@@ -270,6 +321,12 @@ public:
     MOCK_STATIC_METHOD_0(, void, ModuleLoader_Destroy);
     MOCK_VOID_METHOD_END();
 
+    MOCK_STATIC_METHOD_1(, MODULE_LOADER_RESULT, ModuleLoader_LockModuleCalls, const MODULE_LOADER*, loader);
+    MOCK_METHOD_END(MODULE_LOADER_RESULT, MODULE_LOADER_SUCCESS);
+
+    MOCK_STATIC_METHOD_1(, void, ModuleLoader_UnlockModuleCalls, const MODULE_LOADER*, loader);
+    MOCK_VOID_METHOD_END();
+
     MOCK_STATIC_METHOD_1(, MODULE_LOADER*, ModuleLoader_FindByName, const char*, name)
     MOCK_METHOD_END(MODULE_LOADER*, &dummyModuleLoader);
 
@@ -280,7 +337,7 @@ public:
     MOCK_METHOD_END(int, 0);
 
     /*EventSystem Mocks*/
-    MOCK_STATIC_METHOD_0(, EVENTSYSTEM_HANDLE, EventSystem_Init)
+    MOCK_STATIC_METHOD_1(, EVENTSYSTEM_HANDLE, EventSystem_InitWithDispatcher, EVENTSYSTEM_DISPATCHER, dispatcher)
     MOCK_METHOD_END(EVENTSYSTEM_HANDLE, (EVENTSYSTEM_HANDLE)BASEIMPLEMENTATION::gballoc_malloc(1));
 
     MOCK_STATIC_METHOD_4(, void, EventSystem_AddEventCallback, EVENTSYSTEM_HANDLE, event_system, GATEWAY_EVENT, event_type, GATEWAY_CALLBACK, callback, void*, user_param)
@@ -289,6 +346,12 @@ public:
     MOCK_STATIC_METHOD_3(, void, EventSystem_ReportEvent, EVENTSYSTEM_HANDLE, event_system, GATEWAY_HANDLE, gw, GATEWAY_EVENT, event_type)
     MOCK_VOID_METHOD_END();
 
+    MOCK_STATIC_METHOD_4(, void, EventSystem_ReportModuleEvent, EVENTSYSTEM_HANDLE, event_system, GATEWAY_HANDLE, gw, GATEWAY_EVENT, event_type, const char*, module_name)
+    MOCK_VOID_METHOD_END();
+
+    MOCK_STATIC_METHOD_4(, void, EventSystem_ReportLinkEvent, EVENTSYSTEM_HANDLE, event_system, GATEWAY_HANDLE, gw, GATEWAY_EVENT, event_type, const GATEWAY_LINK_ENTRY*, link)
+    MOCK_VOID_METHOD_END();
+
     MOCK_STATIC_METHOD_1(, void, EventSystem_Destroy, EVENTSYSTEM_HANDLE, handle)
         BASEIMPLEMENTATION::gballoc_free(handle);
     MOCK_VOID_METHOD_END();
@@ -356,7 +419,16 @@ public:
     MOCK_VOID_METHOD_END();
 
     MOCK_STATIC_METHOD_2(, MODULE_HANDLE, mock_Module_Create, BROKER_HANDLE, broker, const void*, configuration)
-    MOCK_METHOD_END(MODULE_HANDLE, (MODULE_HANDLE)BASEIMPLEMENTATION::gballoc_malloc(1));
+        MODULE_HANDLE created = NULL;
+        if (module_create_failures > 0)
+        {
+            --module_create_failures;
+        }
+        else
+        {
+            created = (MODULE_HANDLE)BASEIMPLEMENTATION::gballoc_malloc(1);
+        }
+    MOCK_METHOD_END(MODULE_HANDLE, created);
 
     MOCK_STATIC_METHOD_1(, void, mock_Module_Destroy, MODULE_HANDLE, moduleHandle)
         BASEIMPLEMENTATION::gballoc_free(moduleHandle);
@@ -372,10 +444,14 @@ DECLARE_GLOBAL_MOCK_METHOD_1(CGatewayMocks, , JSON_Object*, json_value_get_objec
 DECLARE_GLOBAL_MOCK_METHOD_2(CGatewayMocks, , JSON_Array*, json_object_get_array, const JSON_Object*, object, const char*, name);
 DECLARE_GLOBAL_MOCK_METHOD_1(CGatewayMocks, , size_t, json_array_get_count, const JSON_Array*, arr);
 DECLARE_GLOBAL_MOCK_METHOD_2(CGatewayMocks, , JSON_Object*, json_array_get_object, const JSON_Array*, arr, size_t, index);
+DECLARE_GLOBAL_MOCK_METHOD_2(CGatewayMocks, , JSON_Value*, json_array_get_value, const JSON_Array*, arr, size_t, index);
 DECLARE_GLOBAL_MOCK_METHOD_2(CGatewayMocks, , const char*, json_object_get_string, const JSON_Object*, object, const char*, name);
 DECLARE_GLOBAL_MOCK_METHOD_2(CGatewayMocks, , JSON_Object*, json_object_get_object, const JSON_Object*, object, const char*, name);
 
 DECLARE_GLOBAL_MOCK_METHOD_2(CGatewayMocks, , JSON_Value*, json_object_get_value, const JSON_Object*, object, const char*, name);
+DECLARE_GLOBAL_MOCK_METHOD_1(CGatewayMocks, , const char*, json_value_get_string, const JSON_Value*, value);
+DECLARE_GLOBAL_MOCK_METHOD_1(CGatewayMocks, , JSON_Value_Type, json_value_get_type, const JSON_Value*, value);
+DECLARE_GLOBAL_MOCK_METHOD_1(CGatewayMocks, , double, json_value_get_number, const JSON_Value*, value);
 DECLARE_GLOBAL_MOCK_METHOD_1(CGatewayMocks, , char*, json_serialize_to_string, const JSON_Value*, value);
 DECLARE_GLOBAL_MOCK_METHOD_1(CGatewayMocks, , void, json_value_free, JSON_Value*, value);
 DECLARE_GLOBAL_MOCK_METHOD_1(CGatewayMocks, , void, json_free_serialized_string, char*, string);
@@ -384,6 +460,7 @@ DECLARE_GLOBAL_MOCK_METHOD_2(CGatewayMocks, , void, Gateway_RemoveLink, GATEWAY_
 DECLARE_GLOBAL_MOCK_METHOD_1(CGatewayMocks, , GATEWAY_HANDLE, Gateway_Create, const GATEWAY_PROPERTIES*, properties);
 DECLARE_GLOBAL_MOCK_METHOD_1(CGatewayMocks, , void, Gateway_Destroy, GATEWAY_HANDLE, gw);
 DECLARE_GLOBAL_MOCK_METHOD_1(CGatewayMocks, , GATEWAY_START_RESULT, Gateway_Start, GATEWAY_HANDLE, gw);
+DECLARE_GLOBAL_MOCK_METHOD_2(CGatewayMocks, , void, Gateway_StartModule, GATEWAY_HANDLE, gw, MODULE_HANDLE, module);
 DECLARE_GLOBAL_MOCK_METHOD_2(CGatewayMocks, , int, Gateway_RemoveModuleByName, GATEWAY_HANDLE, gw, const char *, module_name);
 
 DECLARE_GLOBAL_MOCK_METHOD_0(CGatewayMocks, , BROKER_HANDLE, Broker_Create);
@@ -392,8 +469,11 @@ DECLARE_GLOBAL_MOCK_METHOD_1(CGatewayMocks, , void, Broker_IncRef, BROKER_HANDLE
 DECLARE_GLOBAL_MOCK_METHOD_1(CGatewayMocks, , void, Broker_DecRef, BROKER_HANDLE, broker);
 DECLARE_GLOBAL_MOCK_METHOD_2(CGatewayMocks, , BROKER_RESULT, Broker_AddModule, BROKER_HANDLE, handle, const MODULE*, module);
 DECLARE_GLOBAL_MOCK_METHOD_2(CGatewayMocks, , BROKER_RESULT, Broker_RemoveModule, BROKER_HANDLE, handle, const MODULE*, module);
+DECLARE_GLOBAL_MOCK_METHOD_4(CGatewayMocks, , BROKER_RESULT, Broker_DrainModule, BROKER_HANDLE, handle, MODULE_HANDLE, module, unsigned int, timeout_ms, BROKER_MODULE_DRAIN*, drain);
 DECLARE_GLOBAL_MOCK_METHOD_2(CGatewayMocks, , BROKER_RESULT, Broker_AddLink, BROKER_HANDLE, handle, const BROKER_LINK_DATA*, link);
 DECLARE_GLOBAL_MOCK_METHOD_2(CGatewayMocks, , BROKER_RESULT, Broker_RemoveLink, BROKER_HANDLE, handle, const BROKER_LINK_DATA*, link);
+DECLARE_GLOBAL_MOCK_METHOD_2(CGatewayMocks, , BROKER_RESULT, Broker_AddAnySourceLink, BROKER_HANDLE, handle, MODULE_HANDLE, sink);
+DECLARE_GLOBAL_MOCK_METHOD_2(CGatewayMocks, , BROKER_RESULT, Broker_RemoveAnySourceLink, BROKER_HANDLE, handle, MODULE_HANDLE, sink);
 
 DECLARE_GLOBAL_MOCK_METHOD_0(CGatewayMocks, , const MODULE_LOADER_API*, DynamicLoader_GetApi);
 DECLARE_GLOBAL_MOCK_METHOD_2(CGatewayMocks, , MODULE_LIBRARY_HANDLE, DynamicModuleLoader_Load, const struct MODULE_LOADER_TAG*, loader, const void*, entrypoint);
@@ -405,16 +485,21 @@ DECLARE_GLOBAL_MOCK_METHOD_2(CGatewayMocks, , MODULE_LOADER_BASE_CONFIGURATION*,
 DECLARE_GLOBAL_MOCK_METHOD_2(CGatewayMocks, , void, DynamicModuleLoader_FreeConfiguration, const struct MODULE_LOADER_TAG*, loader, MODULE_LOADER_BASE_CONFIGURATION*, configuration);
 DECLARE_GLOBAL_MOCK_METHOD_3(CGatewayMocks, , void*, DynamicModuleLoader_BuildModuleConfiguration, const struct MODULE_LOADER_TAG*, loader, const void*, entrypoint, const void*, module_configuration);
 DECLARE_GLOBAL_MOCK_METHOD_2(CGatewayMocks, , void, DynamicModuleLoader_FreeModuleConfiguration, const struct MODULE_LOADER_TAG*, loader, const void*, module_configuration);
+DECLARE_GLOBAL_MOCK_METHOD_2(CGatewayMocks, , int, GatewayLazyModule_Wrap, GATEWAY_MODULE_LOADER_INFO*, loader_info, const GATEWAY_LAZY_ACTIVATION*, activation);
 DECLARE_GLOBAL_MOCK_METHOD_0(CGatewayMocks, , MODULE_LOADER_RESULT, ModuleLoader_Initialize);
 DECLARE_GLOBAL_MOCK_METHOD_1(CGatewayMocks, , MODULE_LOADER_RESULT, ModuleLoader_InitializeFromJson, const JSON_Value*, loaders);
 DECLARE_GLOBAL_MOCK_METHOD_0(CGatewayMocks, , void, ModuleLoader_Destroy);
+DECLARE_GLOBAL_MOCK_METHOD_1(CGatewayMocks, , MODULE_LOADER_RESULT, ModuleLoader_LockModuleCalls, const MODULE_LOADER*, loader);
+DECLARE_GLOBAL_MOCK_METHOD_1(CGatewayMocks, , void, ModuleLoader_UnlockModuleCalls, const MODULE_LOADER*, loader);
 DECLARE_GLOBAL_MOCK_METHOD_1(CGatewayMocks, , MODULE_LOADER*, ModuleLoader_FindByName, const char*, name);
 DECLARE_GLOBAL_MOCK_METHOD_0(CGatewayMocks, , void, OutprocessLoader_JoinChildProcesses);
 DECLARE_GLOBAL_MOCK_METHOD_0(CGatewayMocks, , int, OutprocessLoader_SpawnChildProcesses);
 
-DECLARE_GLOBAL_MOCK_METHOD_0(CGatewayMocks, , EVENTSYSTEM_HANDLE, EventSystem_Init);
+DECLARE_GLOBAL_MOCK_METHOD_1(CGatewayMocks, , EVENTSYSTEM_HANDLE, EventSystem_InitWithDispatcher, EVENTSYSTEM_DISPATCHER, dispatcher);
 DECLARE_GLOBAL_MOCK_METHOD_4(CGatewayMocks, , void, EventSystem_AddEventCallback, EVENTSYSTEM_HANDLE, event_system, GATEWAY_EVENT, event_type, GATEWAY_CALLBACK, callback, void*, user_param);
 DECLARE_GLOBAL_MOCK_METHOD_3(CGatewayMocks, , void, EventSystem_ReportEvent, EVENTSYSTEM_HANDLE, event_system, GATEWAY_HANDLE, gw, GATEWAY_EVENT, event_type);
+DECLARE_GLOBAL_MOCK_METHOD_4(CGatewayMocks, , void, EventSystem_ReportModuleEvent, EVENTSYSTEM_HANDLE, event_system, GATEWAY_HANDLE, gw, GATEWAY_EVENT, event_type, const char*, module_name);
+DECLARE_GLOBAL_MOCK_METHOD_4(CGatewayMocks, , void, EventSystem_ReportLinkEvent, EVENTSYSTEM_HANDLE, event_system, GATEWAY_HANDLE, gw, GATEWAY_EVENT, event_type, const GATEWAY_LINK_ENTRY*, link);
 DECLARE_GLOBAL_MOCK_METHOD_1(CGatewayMocks, , void, EventSystem_Destroy, EVENTSYSTEM_HANDLE, handle);
 
 DECLARE_GLOBAL_MOCK_METHOD_1(CGatewayMocks, , VECTOR_HANDLE, VECTOR_create, size_t, elementSize);
@@ -481,7 +566,8 @@ TEST_SUITE_INITIALIZE(TestClassInitialize)
         NATIVE,
         "dummy loader",
         NULL,
-        &default_module_loader
+        &default_module_loader,
+        true
     };
 
     dummyLoaderInfo =
@@ -503,6 +589,11 @@ TEST_FUNCTION_INITIALIZE(TestMethodInitialize)
     {
         ASSERT_FAIL("our mutex is ABANDONED. Failure in test framework");
     }
+
+    drained_modules_count = 0;
+    removed_modules_count = 0;
+    removed_undrained_count = 0;
+    module_create_failures = 0;
 }
 
 TEST_FUNCTION_CLEANUP(TestMethodCleanup)
@@ -635,6 +726,9 @@ static void setup_2module_gw(CGatewayMocks& mocks, char * path)
         .IgnoreArgument(1)
         .SetReturn(2);
     STRICT_EXPECTED_CALL(mocks, VECTOR_create(sizeof(GATEWAY_MODULES_ENTRY)));
+    STRICT_EXPECTED_CALL(mocks, gballoc_malloc(2 * sizeof(uint64_t))); //entrypoint parse times
+    STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
 }
 
 static void setup_parse_modules_entry(CGatewayMocks& mocks, size_t index, const char * modulename, const char* loadername = "loader1")
@@ -656,6 +750,9 @@ static void setup_parse_modules_entry(CGatewayMocks& mocks, size_t index, const
     STRICT_EXPECTED_CALL(mocks, json_object_get_string(IGNORED_PTR_ARG, "name"))
         .IgnoreArgument(1)
         .SetReturn(modulename);
+    STRICT_EXPECTED_CALL(mocks, json_object_get_value(IGNORED_PTR_ARG, "activation"))
+        .IgnoreArgument(1)
+        .SetReturn((JSON_Value*)NULL);
     STRICT_EXPECTED_CALL(mocks, json_object_get_value(IGNORED_PTR_ARG, "args"))
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, json_serialize_to_string(IGNORED_PTR_ARG))
@@ -711,10 +808,6 @@ static void add_a_module(CGatewayMocks& mocks, size_t index)
     STRICT_EXPECTED_CALL(mocks, VECTOR_push_back(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1))
         .IgnoreArgument(1)
         .IgnoreArgument(2);
-    STRICT_EXPECTED_CALL(mocks, VECTOR_back(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
 }
 
 static void add_a_link(CGatewayMocks& mocks, size_t index)
@@ -741,6 +834,44 @@ static void add_a_link(CGatewayMocks& mocks, size_t index)
         .IgnoreArgument(2);
 }
 
+/*modules and links added once the gateway exists are reported one by one*/
+static void report_module_added(CGatewayMocks& mocks, const char* module_name)
+{
+    STRICT_EXPECTED_CALL(mocks, EventSystem_ReportModuleEvent(IGNORED_PTR_ARG, IGNORED_PTR_ARG, GATEWAY_MODULE_ADDED, module_name))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2);
+}
+
+static void report_link_added(CGatewayMocks& mocks)
+{
+    STRICT_EXPECTED_CALL(mocks, EventSystem_ReportLinkEvent(IGNORED_PTR_ARG, IGNORED_PTR_ARG, GATEWAY_LINK_ADDED, IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2)
+        .IgnoreArgument(4);
+}
+
+static void record_module_configurations(CGatewayMocks& mocks, size_t modules_count)
+{
+    STRICT_EXPECTED_CALL(mocks, json_value_get_object(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, json_object_get_array(IGNORED_PTR_ARG, "modules"))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    for (size_t index = 0; index < modules_count; index++)
+    {
+        STRICT_EXPECTED_CALL(mocks, VECTOR_element(IGNORED_PTR_ARG, index))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .IgnoreAllArguments();
+        STRICT_EXPECTED_CALL(mocks, json_array_get_value(IGNORED_PTR_ARG, index))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, json_serialize_to_string(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, json_free_serialized_string((char*)"[serialized string]"));
+    }
+}
+
 /*Tests_SRS_GATEWAY_JSON_14_008: [ This function shall return NULL upon any memory allocation failure. */
 TEST_FUNCTION(Gateway_CreateFromJson_Returns_NULL_on_gateway_create_internal_fail)
 {
@@ -814,6 +945,9 @@ TEST_FUNCTION(Gateway_CreateFromJson_Returns_NULL_on_gateway_create_internal_fai
 /*Tests_SRS_GATEWAY_JSON_17_011: [ The function shall the loader's BuildModuleConfiguration to construct module input from module's "args" and "loader.entrypoint". ]*/
 /*Tests_SRS_GATEWAY_JSON_17_013: [ The function shall parse each modules object for "loader.name" and "loader.entrypoint". ]*/
 /*Tests_SRS_GATEWAY_JSON_17_014: [ The function shall find the correct loader by "loader.name". ]*/
+/*Tests_SRS_GATEWAY_JSON_17_015: [ The function shall keep a hash of each module's JSON object with the module. ]*/
+/*Tests_SRS_GATEWAY_JSON_17_037: [ The startup of the gateway shall begin before the file is read, and the time reading and parsing it took shall be kept with the gateway. ]*/
+/*Tests_SRS_GATEWAY_JSON_17_038: [ The function shall keep the time parsing each module's entrypoint took with the module. ]*/
 TEST_FUNCTION(Gateway_CreateFromJson_Parses_Valid_JSON_Configuration_File)
 {
     //Arrange
@@ -841,6 +975,10 @@ TEST_FUNCTION(Gateway_CreateFromJson_Parses_Valid_JSON_Configuration_File)
     STRICT_EXPECTED_CALL(mocks, VECTOR_create(sizeof(LINK_DATA)));
     STRICT_EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG))
+        .IgnoreArgument(1); //module tasks
+    STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
 
     //Adding module 1 (Success)
     add_a_module(mocks, 0);
@@ -855,7 +993,7 @@ TEST_FUNCTION(Gateway_CreateFromJson_Parses_Valid_JSON_Configuration_File)
 
 
     //Gateway start
-       STRICT_EXPECTED_CALL(mocks, EventSystem_Init());
+       STRICT_EXPECTED_CALL(mocks, EventSystem_InitWithDispatcher(GATEWAY_EVENT_DISPATCHER));
        STRICT_EXPECTED_CALL(mocks, EventSystem_ReportEvent(IGNORED_PTR_ARG, IGNORED_PTR_ARG, GATEWAY_CREATED))
            .IgnoreArgument(1)
            .IgnoreArgument(2);
@@ -864,6 +1002,7 @@ TEST_FUNCTION(Gateway_CreateFromJson_Parses_Valid_JSON_Configuration_File)
            .IgnoreArgument(2);
        STRICT_EXPECTED_CALL(mocks, Gateway_Start(IGNORED_PTR_ARG))
            .IgnoreArgument(1);
+       record_module_configurations(mocks, 2);
        STRICT_EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG))
            .IgnoreArgument(1);
        STRICT_EXPECTED_CALL(mocks, VECTOR_element(IGNORED_PTR_ARG, 0))
@@ -926,6 +1065,10 @@ TEST_FUNCTION(Gateway_Create_Start_fails_returns_null)
     STRICT_EXPECTED_CALL(mocks, VECTOR_create(sizeof(LINK_DATA)));
     STRICT_EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG))
+        .IgnoreArgument(1); //module tasks
+    STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
 
     //Adding module 1 (Success)
     add_a_module(mocks, 0);
@@ -938,13 +1081,14 @@ TEST_FUNCTION(Gateway_Create_Start_fails_returns_null)
     add_a_link(mocks, 0);
     add_a_link(mocks, 1);
 
-    STRICT_EXPECTED_CALL(mocks, EventSystem_Init());
+    STRICT_EXPECTED_CALL(mocks, EventSystem_InitWithDispatcher(GATEWAY_EVENT_DISPATCHER));
     STRICT_EXPECTED_CALL(mocks, EventSystem_ReportEvent(IGNORED_PTR_ARG, IGNORED_PTR_ARG, GATEWAY_CREATED))
         .IgnoreArgument(1)
         .IgnoreArgument(2);
     STRICT_EXPECTED_CALL(mocks, EventSystem_ReportEvent(IGNORED_PTR_ARG, IGNORED_PTR_ARG, GATEWAY_MODULE_LIST_CHANGED))
         .IgnoreArgument(1)
         .IgnoreArgument(2);
+    record_module_configurations(mocks, 2);
     STRICT_EXPECTED_CALL(mocks, Gateway_Start(IGNORED_PTR_ARG))
         .IgnoreArgument(1)
         .SetFailReturn((GATEWAY_START_RESULT)GATEWAY_START_INVALID_ARGS);
@@ -1104,6 +1248,9 @@ TEST_FUNCTION(Gateway_CreateFromJson_Traverses_JSON_Push_Back_Fail)
     STRICT_EXPECTED_CALL(mocks, json_object_get_string(IGNORED_PTR_ARG, "name"))
         .IgnoreArgument(1)
         .SetReturn("Module2");
+    STRICT_EXPECTED_CALL(mocks, json_object_get_value(IGNORED_PTR_ARG, "activation"))
+        .IgnoreArgument(1)
+        .SetReturn((JSON_Value*)NULL);
     STRICT_EXPECTED_CALL(mocks, json_object_get_value(IGNORED_PTR_ARG, "args"))
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, json_serialize_to_string(IGNORED_PTR_ARG))
@@ -1208,6 +1355,9 @@ TEST_FUNCTION(Gateway_CreateFromJson_Traverses_JSON_Value_NULL_Loaders_Array_suc
         .IgnoreArgument(1)
         .SetReturn(2);
     STRICT_EXPECTED_CALL(mocks, VECTOR_create(sizeof(GATEWAY_MODULES_ENTRY)));
+    STRICT_EXPECTED_CALL(mocks, gballoc_malloc(2 * sizeof(uint64_t))); //entrypoint parse times
+    STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
 
     // modules array
     setup_parse_modules_entry(mocks, 0, "module1");
@@ -1228,6 +1378,10 @@ TEST_FUNCTION(Gateway_CreateFromJson_Traverses_JSON_Value_NULL_Loaders_Array_suc
     STRICT_EXPECTED_CALL(mocks, VECTOR_create(sizeof(LINK_DATA)));
     STRICT_EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG))
+        .IgnoreArgument(1); //module tasks
+    STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
 
     //Adding module 1 (Success)
     add_a_module(mocks, 0);
@@ -1242,7 +1396,7 @@ TEST_FUNCTION(Gateway_CreateFromJson_Traverses_JSON_Value_NULL_Loaders_Array_suc
 
 
     //Gateway start
-    STRICT_EXPECTED_CALL(mocks, EventSystem_Init());
+    STRICT_EXPECTED_CALL(mocks, EventSystem_InitWithDispatcher(GATEWAY_EVENT_DISPATCHER));
     STRICT_EXPECTED_CALL(mocks, EventSystem_ReportEvent(IGNORED_PTR_ARG, IGNORED_PTR_ARG, GATEWAY_CREATED))
         .IgnoreArgument(1)
         .IgnoreArgument(2);
@@ -1251,6 +1405,7 @@ TEST_FUNCTION(Gateway_CreateFromJson_Traverses_JSON_Value_NULL_Loaders_Array_suc
         .IgnoreArgument(2);
     STRICT_EXPECTED_CALL(mocks, Gateway_Start(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
+    record_module_configurations(mocks, 2);
     STRICT_EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, VECTOR_element(IGNORED_PTR_ARG, 0))
@@ -1511,6 +1666,10 @@ TEST_FUNCTION(Gateway_CreateFromJson_uses_native_loader_when_loader_name_is_miss
     STRICT_EXPECTED_CALL(mocks, VECTOR_create(sizeof(LINK_DATA)));
     STRICT_EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG))
+        .IgnoreArgument(1); //module tasks
+    STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
 
     //Adding module 1 (Success)
     add_a_module(mocks, 0);
@@ -1524,7 +1683,7 @@ TEST_FUNCTION(Gateway_CreateFromJson_uses_native_loader_when_loader_name_is_miss
     add_a_link(mocks, 1);
 
     //Gateway start
-    STRICT_EXPECTED_CALL(mocks, EventSystem_Init());
+    STRICT_EXPECTED_CALL(mocks, EventSystem_InitWithDispatcher(GATEWAY_EVENT_DISPATCHER));
     STRICT_EXPECTED_CALL(mocks, EventSystem_ReportEvent(IGNORED_PTR_ARG, IGNORED_PTR_ARG, GATEWAY_CREATED))
         .IgnoreArgument(1)
         .IgnoreArgument(2);
@@ -1533,6 +1692,7 @@ TEST_FUNCTION(Gateway_CreateFromJson_uses_native_loader_when_loader_name_is_miss
         .IgnoreArgument(2);
     STRICT_EXPECTED_CALL(mocks, Gateway_Start(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
+    record_module_configurations(mocks, 2);
     STRICT_EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, VECTOR_element(IGNORED_PTR_ARG, 0))
@@ -1630,6 +1790,9 @@ TEST_FUNCTION(Gateway_CreateFromJson_fails_with_no_entry_point)
     STRICT_EXPECTED_CALL(mocks, json_object_get_string(IGNORED_PTR_ARG, "name"))
         .IgnoreArgument(1)
         .SetReturn("module1");
+    STRICT_EXPECTED_CALL(mocks, json_object_get_value(IGNORED_PTR_ARG, "activation"))
+        .IgnoreArgument(1)
+        .SetReturn((JSON_Value*)NULL);
     STRICT_EXPECTED_CALL(mocks, json_object_get_value(IGNORED_PTR_ARG, "args"))
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, json_serialize_to_string(IGNORED_PTR_ARG))
@@ -1656,6 +1819,10 @@ TEST_FUNCTION(Gateway_CreateFromJson_fails_with_no_entry_point)
     STRICT_EXPECTED_CALL(mocks, VECTOR_create(sizeof(LINK_DATA)));
     STRICT_EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG))
+        .IgnoreArgument(1); //module tasks
+    STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
 
     //tear down.
 
@@ -1757,6 +1924,131 @@ TEST_FUNCTION(Gateway_CreateFromJson_Fails_For_not_parsing_loader_entrypoint)
     mocks.AssertActualAndExpectedCalls();
 }
 
+/*Tests_SRS_GATEWAY_JSON_17_043: [ The "activation" of a module shall be "eager", "lazy", or an object with such a "mode" and optionally a "max_queued_messages" from 1 to 65536 and an "idle_timeout_ms"; otherwise the function shall fail. ]*/
+TEST_FUNCTION(Gateway_CreateFromJson_Fails_For_unknown_activation)
+{
+    //Arrange
+    CGatewayMocks mocks;
+
+    setup_2module_gw(mocks, (char*)MISSING_INFO_JSON_PATH);
+
+    STRICT_EXPECTED_CALL(mocks, json_array_get_object(IGNORED_PTR_ARG, 0))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, json_object_get_object(IGNORED_PTR_ARG, "loader"))
+        .IgnoreArgument(1)
+        .SetReturn((JSON_Object*)0x42);
+    STRICT_EXPECTED_CALL(mocks, json_object_get_string(IGNORED_PTR_ARG, "name"))
+        .IgnoreArgument(1)
+        .SetReturn("loader1");
+    STRICT_EXPECTED_CALL(mocks, ModuleLoader_FindByName("loader1"));
+    STRICT_EXPECTED_CALL(mocks, json_object_get_value(IGNORED_PTR_ARG, "entrypoint"))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, DynamicModuleLoader_ParseEntrypointFromJson(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(mocks, json_object_get_string(IGNORED_PTR_ARG, "name"))
+        .IgnoreArgument(1)
+        .SetReturn("module1");
+    STRICT_EXPECTED_CALL(mocks, json_object_get_value(IGNORED_PTR_ARG, "activation"))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, json_value_get_object(IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .SetReturn((JSON_Object*)NULL);
+    STRICT_EXPECTED_CALL(mocks, json_value_get_string(IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .SetReturn("sometimes");
+    STRICT_EXPECTED_CALL(mocks, DynamicModuleLoader_FreeEntrypoint(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2);
+
+    STRICT_EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, VECTOR_destroy(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+
+    STRICT_EXPECTED_CALL(mocks, json_value_free(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, ModuleLoader_Destroy());
+
+    //Act
+    GATEWAY_HANDLE gateway = Gateway_CreateFromJson(MISSING_INFO_JSON_PATH);
+
+    //Assert
+    ASSERT_IS_NULL(gateway);
+    mocks.AssertActualAndExpectedCalls();
+}
+
+/*Tests_SRS_GATEWAY_JSON_17_043: [ The "activation" of a module shall be "eager", "lazy", or an object with such a "mode" and optionally a "max_queued_messages" from 1 to 65536 and an "idle_timeout_ms"; otherwise the function shall fail. ]*/
+/*Tests_SRS_GATEWAY_JSON_17_044: [ For a lazy module, the function shall have the loader of the module wrapped by GatewayLazyModule_Wrap, so the module is only loaded and created once a message reaches it. ]*/
+TEST_FUNCTION(Gateway_CreateFromJson_Fails_when_a_lazy_module_cannot_be_wrapped)
+{
+    //Arrange
+    CGatewayMocks mocks;
+
+    setup_2module_gw(mocks, (char*)MISSING_INFO_JSON_PATH);
+
+    STRICT_EXPECTED_CALL(mocks, json_array_get_object(IGNORED_PTR_ARG, 0))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, json_object_get_object(IGNORED_PTR_ARG, "loader"))
+        .IgnoreArgument(1)
+        .SetReturn((JSON_Object*)0x42);
+    STRICT_EXPECTED_CALL(mocks, json_object_get_string(IGNORED_PTR_ARG, "name"))
+        .IgnoreArgument(1)
+        .SetReturn("loader1");
+    STRICT_EXPECTED_CALL(mocks, ModuleLoader_FindByName("loader1"));
+    STRICT_EXPECTED_CALL(mocks, json_object_get_value(IGNORED_PTR_ARG, "entrypoint"))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, DynamicModuleLoader_ParseEntrypointFromJson(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(mocks, json_object_get_string(IGNORED_PTR_ARG, "name"))
+        .IgnoreArgument(1)
+        .SetReturn("module1");
+    STRICT_EXPECTED_CALL(mocks, json_object_get_value(IGNORED_PTR_ARG, "activation"))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, json_value_get_object(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, json_object_get_string(IGNORED_PTR_ARG, "mode"))
+        .IgnoreArgument(1)
+        .SetReturn("lazy");
+    STRICT_EXPECTED_CALL(mocks, json_object_get_value(IGNORED_PTR_ARG, "max_queued_messages"))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, json_value_get_number(IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .SetReturn(16.0);
+    STRICT_EXPECTED_CALL(mocks, json_value_get_type(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, json_object_get_value(IGNORED_PTR_ARG, "idle_timeout_ms"))
+        .IgnoreArgument(1)
+        .SetReturn((JSON_Value*)NULL);
+    STRICT_EXPECTED_CALL(mocks, GatewayLazyModule_Wrap(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments()
+        .SetReturn(1);
+    STRICT_EXPECTED_CALL(mocks, DynamicModuleLoader_FreeEntrypoint(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2);
+
+    STRICT_EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, VECTOR_destroy(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+
+    STRICT_EXPECTED_CALL(mocks, json_value_free(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, ModuleLoader_Destroy());
+
+    //Act
+    GATEWAY_HANDLE gateway = Gateway_CreateFromJson(MISSING_INFO_JSON_PATH);
+
+    //Assert
+    ASSERT_IS_NULL(gateway);
+    mocks.AssertActualAndExpectedCalls();
+}
+
 /*Tests_SRS_GATEWAY_JSON_14_006: [ The function shall return NULL if the JSON_Value contains incomplete information. ]*/
 TEST_FUNCTION(Gateway_CreateFromJson_Fails_links_parsing_no_source)
 {
@@ -2014,6 +2306,7 @@ static void setup_2module_update_gw(CGatewayMocks& mocks, char * json_content)
 
 
 /* Tests_SRS_GATEWAY_JSON_04_007: [ The function shall traverse the JSON_Value object to initialize a GATEWAY_PROPERTIES instance. ] */
+/* Tests_SRS_GATEWAY_JSON_17_016: [ The function shall keep a hash of each added module's JSON object with the module. ] */
 TEST_FUNCTION(Gateway_UpdateFromJson_Parses_Valid_JSON_Configuration_File_Succeed)
 {
     //Arrange
@@ -2048,11 +2341,13 @@ TEST_FUNCTION(Gateway_UpdateFromJson_Parses_Valid_JSON_Configuration_File_Succee
 
     //Adding module 1 (Success)
     add_a_module(mocks, 0);
+    report_module_added(mocks, "module1");
     STRICT_EXPECTED_CALL(mocks, VECTOR_push_back(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1))
         .IgnoreArgument(1)
         .IgnoreArgument(2);
     //Adding module 2 (Success)
     add_a_module(mocks, 1);
+    report_module_added(mocks, "module2");
     STRICT_EXPECTED_CALL(mocks, VECTOR_push_back(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1))
         .IgnoreArgument(1)
         .IgnoreArgument(2);
@@ -2061,14 +2356,18 @@ TEST_FUNCTION(Gateway_UpdateFromJson_Parses_Valid_JSON_Configuration_File_Succee
     STRICT_EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
     add_a_link(mocks, 0);
+    report_link_added(mocks);
     STRICT_EXPECTED_CALL(mocks, VECTOR_push_back(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1))
         .IgnoreArgument(1)
         .IgnoreArgument(2);
     add_a_link(mocks, 1);
+    report_link_added(mocks);
     STRICT_EXPECTED_CALL(mocks, VECTOR_push_back(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1))
         .IgnoreArgument(1)
         .IgnoreArgument(2);
 
+    record_module_configurations(mocks, 2);
+
     STRICT_EXPECTED_CALL(mocks, VECTOR_destroy(IGNORED_PTR_ARG))
         .IgnoreArgument(1); //Successfull Modules
 
@@ -2160,15 +2459,19 @@ TEST_FUNCTION(Gateway_UpdateFromJson_Parses_JSON_WithJustModule_Configuration_Fi
 
     //Adding module 1 (Success)
     add_a_module(mocks, 0);
+    report_module_added(mocks, "module1");
     STRICT_EXPECTED_CALL(mocks, VECTOR_push_back(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1))
         .IgnoreArgument(1)
         .IgnoreArgument(2);
     //Adding module 2 (Success)
     add_a_module(mocks, 1);
+    report_module_added(mocks, "module2");
     STRICT_EXPECTED_CALL(mocks, VECTOR_push_back(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1))
         .IgnoreArgument(1)
         .IgnoreArgument(2);
 
+    record_module_configurations(mocks, 2);
+
     STRICT_EXPECTED_CALL(mocks, VECTOR_destroy(IGNORED_PTR_ARG))
         .IgnoreArgument(1); //Successfull Modules
 
@@ -2259,15 +2562,19 @@ TEST_FUNCTION(Gateway_UpdateFromJson_Parses_JSON_WithJustLinks_Configuration_Fil
 
     //Adding module 1 (Success)
     add_a_module(mocks, 0);
+    report_module_added(mocks, "module1");
     STRICT_EXPECTED_CALL(mocks, VECTOR_push_back(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1))
         .IgnoreArgument(1)
         .IgnoreArgument(2);
     //Adding module 2 (Success)
     add_a_module(mocks, 1);
+    report_module_added(mocks, "module2");
     STRICT_EXPECTED_CALL(mocks, VECTOR_push_back(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1))
         .IgnoreArgument(1)
         .IgnoreArgument(2);
 
+    record_module_configurations(mocks, 2);
+
     STRICT_EXPECTED_CALL(mocks, VECTOR_destroy(IGNORED_PTR_ARG))
         .IgnoreArgument(1); //Successfull Modules
 
@@ -2339,10 +2646,12 @@ TEST_FUNCTION(Gateway_UpdateFromJson_Parses_JSON_WithJustLinks_Configuration_Fil
         .IgnoreArgument(1);
 
     add_a_link(mocks, 0);
+    report_link_added(mocks);
     STRICT_EXPECTED_CALL(mocks, VECTOR_push_back(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1))
         .IgnoreArgument(1)
         .IgnoreArgument(2);
     add_a_link(mocks, 1);
+    report_link_added(mocks);
     STRICT_EXPECTED_CALL(mocks, VECTOR_push_back(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1))
         .IgnoreArgument(1)
         .IgnoreArgument(2);
@@ -2374,4 +2683,279 @@ TEST_FUNCTION(Gateway_UpdateFromJson_Parses_JSON_WithJustLinks_Configuration_Fil
 }
 
 
+
+/*Tests_SRS_GATEWAY_JSON_17_017: [ If gw or json_content is NULL the function shall return GATEWAY_UPDATE_FROM_JSON_INVALID_ARG. ]*/
+TEST_FUNCTION(Gateway_ReconcileFromJson_Returns_INVALID_ARG_For_NULL_gw)
+{
+    //Arrange
+    CGatewayMocks mocks;
+
+    //Act
+    GATEWAY_UPDATE_FROM_JSON_RESULT result = Gateway_ReconcileFromJson(NULL, VALID_JSON_CONTENT);
+
+    //Assert
+    ASSERT_ARE_EQUAL(int, (int)GATEWAY_UPDATE_FROM_JSON_INVALID_ARG, (int)result);
+    mocks.AssertActualAndExpectedCalls();
+}
+
+/*Tests_SRS_GATEWAY_JSON_17_017: [ If gw or json_content is NULL the function shall return GATEWAY_UPDATE_FROM_JSON_INVALID_ARG. ]*/
+TEST_FUNCTION(Gateway_ReconcileFromJson_Returns_INVALID_ARG_For_NULL_json_content)
+{
+    //Arrange
+    CGatewayMocks mocks;
+    GATEWAY_HANDLE gateway = Gateway_Create(NULL);
+    mocks.ResetAllCalls();
+
+    //Act
+    GATEWAY_UPDATE_FROM_JSON_RESULT result = Gateway_ReconcileFromJson(gateway, NULL);
+
+    //Assert
+    ASSERT_ARE_EQUAL(int, (int)GATEWAY_UPDATE_FROM_JSON_INVALID_ARG, (int)result);
+    mocks.AssertActualAndExpectedCalls();
+
+    //Cleanup
+    gateway_destroy_internal(gateway);
+}
+
+/*Tests_SRS_GATEWAY_JSON_17_018: [ The function shall use parson to parse the JSON string to a parson JSON_Value structure. ]*/
+/*Tests_SRS_GATEWAY_JSON_17_019: [ The function shall return GATEWAY_UPDATE_FROM_JSON_ERROR if the JSON content could not be parsed, contains incomplete information or configures a link to a module it does not configure. ]*/
+TEST_FUNCTION(Gateway_ReconcileFromJson_parse_string_fail_fail)
+{
+    //Arrange
+    CGatewayMocks mocks;
+    GATEWAY_HANDLE gateway = Gateway_Create(NULL);
+    mocks.ResetAllCalls();
+
+    STRICT_EXPECTED_CALL(mocks, json_parse_string(VALID_JSON_CONTENT))
+        .SetFailReturn((JSON_Value*)NULL);
+
+    //Act
+    GATEWAY_UPDATE_FROM_JSON_RESULT result = Gateway_ReconcileFromJson(gateway, VALID_JSON_CONTENT);
+
+    //Assert
+    ASSERT_ARE_EQUAL(int, (int)GATEWAY_UPDATE_FROM_JSON_ERROR, (int)result);
+    mocks.AssertActualAndExpectedCalls();
+
+    //Cleanup
+    gateway_destroy_internal(gateway);
+}
+
+/*Tests_SRS_GATEWAY_JSON_17_020: [ The function shall return GATEWAY_UPDATE_FROM_JSON_MEMORY upon any memory allocation failure. ]*/
+TEST_FUNCTION(Gateway_ReconcileFromJson_gateway_property_malloc_fail_fail)
+{
+    //Arrange
+    CGatewayMocks mocks;
+    GATEWAY_HANDLE gateway = Gateway_Create(NULL);
+    mocks.ResetAllCalls();
+
+    STRICT_EXPECTED_CALL(mocks, json_parse_string(VALID_JSON_CONTENT));
+    STRICT_EXPECTED_CALL(mocks, gballoc_malloc(sizeof(GATEWAY_PROPERTIES)))
+        .SetFailReturn((void*)NULL);
+    STRICT_EXPECTED_CALL(mocks, json_value_free(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+
+    //Act
+    GATEWAY_UPDATE_FROM_JSON_RESULT result = Gateway_ReconcileFromJson(gateway, VALID_JSON_CONTENT);
+
+    //Assert
+    ASSERT_ARE_EQUAL(int, (int)GATEWAY_UPDATE_FROM_JSON_MEMORY, (int)result);
+    mocks.AssertActualAndExpectedCalls();
+
+    //Cleanup
+    gateway_destroy_internal(gateway);
+}
+
+/*Tests_SRS_GATEWAY_JSON_17_019: [ The function shall return GATEWAY_UPDATE_FROM_JSON_ERROR if the JSON content could not be parsed, contains incomplete information or configures a link to a module it does not configure. ]*/
+TEST_FUNCTION(Gateway_ReconcileFromJson_link_to_unconfigured_module_fails_and_changes_nothing)
+{
+    //Arrange
+    CGatewayMocks mocks;
+    GATEWAY_HANDLE gateway = Gateway_Create(NULL);
+    mocks.ResetAllCalls();
+
+    setup_2module_update_gw(mocks, (char *)VALID_JSON_CONTENT);
+    setup_parse_modules_entry(mocks, 0, "module1");
+    setup_parse_modules_entry(mocks, 1, "module2");
+    STRICT_EXPECTED_CALL(mocks, VECTOR_create(sizeof(GATEWAY_LINK_ENTRY)));
+    STRICT_EXPECTED_CALL(mocks, json_array_get_count(IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .SetReturn(1);
+    setup_links_entry(mocks, 0, "module1", "module3");
+
+    //Act
+    GATEWAY_UPDATE_FROM_JSON_RESULT result = Gateway_ReconcileFromJson(gateway, VALID_JSON_CONTENT);
+
+    //Assert
+    ASSERT_ARE_EQUAL(int, (int)GATEWAY_UPDATE_FROM_JSON_ERROR, (int)result);
+    ASSERT_ARE_EQUAL(size_t, 0, BASEIMPLEMENTATION::VECTOR_size(gateway->modules));
+    ASSERT_ARE_EQUAL(size_t, 0, BASEIMPLEMENTATION::VECTOR_size(gateway->links));
+
+    //Cleanup
+    gateway_destroy_internal(gateway);
+}
+
+/*Tests_SRS_GATEWAY_JSON_17_021: [ The function shall add every configured module whose name is not in the gateway and replace every module whose JSON object hashes differently from the one it was added with. ]*/
+/*Tests_SRS_GATEWAY_JSON_17_022: [ The function shall create the new modules before it changes anything else, and return GATEWAY_UPDATE_FROM_JSON_ERROR with the gateway unchanged if that fails. ]*/
+/*Tests_SRS_GATEWAY_JSON_17_026: [ The function shall add every configured link the gateway does not have. ]*/
+/*Tests_SRS_GATEWAY_JSON_17_027: [ Once the links are in place, the function shall start the added and replacing modules and keep the hash of their JSON objects with them. ]*/
+/*Tests_SRS_GATEWAY_JSON_17_028: [ If any module or link changed, the function shall report a GATEWAY_MODULE_LIST_CHANGED event. ]*/
+TEST_FUNCTION(Gateway_ReconcileFromJson_adds_configured_modules_and_links)
+{
+    //Arrange
+    CGatewayMocks mocks;
+    GATEWAY_HANDLE gateway = Gateway_Create(NULL);
+    mocks.ResetAllCalls();
+
+    setup_2module_update_gw(mocks, (char *)VALID_JSON_CONTENT);
+    setup_parse_modules_entry(mocks, 0, "module1");
+    setup_parse_modules_entry(mocks, 1, "module2");
+    STRICT_EXPECTED_CALL(mocks, VECTOR_create(sizeof(GATEWAY_LINK_ENTRY)));
+    STRICT_EXPECTED_CALL(mocks, json_array_get_count(IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .SetReturn(2);
+    setup_links_entry(mocks, 0, "module1", "module2");
+    setup_links_entry(mocks, 1, "module2", "module1");
+    STRICT_EXPECTED_CALL(mocks, Gateway_StartModule(gateway, IGNORED_PTR_ARG))
+        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(mocks, Gateway_StartModule(gateway, IGNORED_PTR_ARG))
+        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(mocks, EventSystem_ReportEvent(IGNORED_PTR_ARG, gateway, GATEWAY_MODULE_LIST_CHANGED))
+        .IgnoreArgument(1);
+
+    //Act
+    GATEWAY_UPDATE_FROM_JSON_RESULT result = Gateway_ReconcileFromJson(gateway, VALID_JSON_CONTENT);
+
+    //Assert
+    ASSERT_ARE_EQUAL(int, (int)GATEWAY_UPDATE_FROM_JSON_SUCCESS, (int)result);
+    ASSERT_ARE_EQUAL(size_t, 2, BASEIMPLEMENTATION::VECTOR_size(gateway->modules));
+    ASSERT_ARE_EQUAL(size_t, 2, BASEIMPLEMENTATION::VECTOR_size(gateway->links));
+    MODULE_DATA* module1 = *(MODULE_DATA**)BASEIMPLEMENTATION::VECTOR_element(gateway->modules, 0);
+    ASSERT_IS_TRUE(module1->configuration_hash != 0);
+
+    //Cleanup
+    gateway_destroy_internal(gateway);
+}
+
+/*Tests_SRS_GATEWAY_JSON_17_021: [ The function shall add every configured module whose name is not in the gateway and replace every module whose JSON object hashes differently from the one it was added with. ]*/
+/*Tests_SRS_GATEWAY_JSON_17_023: [ The function shall remove every link of the gateway that is not configured. ]*/
+/*Tests_SRS_GATEWAY_JSON_17_024: [ The function shall remove every module of the gateway that is not configured or is replaced, together with its links. ]*/
+/*Tests_SRS_GATEWAY_JSON_17_045: [ The function shall drain each module it removes with Broker_DrainModule, for at most GATEWAY_RECONCILE_DRAIN_MS, before removing it. ]*/
+TEST_FUNCTION(Gateway_ReconcileFromJson_removes_unconfigured_modules_and_keeps_unchanged_ones)
+{
+    //Arrange
+    CGatewayMocks mocks;
+    GATEWAY_HANDLE gateway = Gateway_Create(NULL);
+    mocks.ResetAllCalls();
+
+    setup_2module_update_gw(mocks, (char *)VALID_JSON_CONTENT);
+    setup_parse_modules_entry(mocks, 0, "module1");
+    setup_parse_modules_entry(mocks, 1, "module2");
+    STRICT_EXPECTED_CALL(mocks, VECTOR_create(sizeof(GATEWAY_LINK_ENTRY)));
+    STRICT_EXPECTED_CALL(mocks, json_array_get_count(IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .SetReturn(2);
+    setup_links_entry(mocks, 0, "module1", "module2");
+    setup_links_entry(mocks, 1, "module2", "module1");
+    ASSERT_ARE_EQUAL(int, (int)GATEWAY_UPDATE_FROM_JSON_SUCCESS, (int)Gateway_ReconcileFromJson(gateway, VALID_JSON_CONTENT));
+    MODULE_DATA* module1 = *(MODULE_DATA**)BASEIMPLEMENTATION::VECTOR_element(gateway->modules, 0);
+    mocks.ResetAllCalls();
+    started_modules_count = 0;
+
+    STRICT_EXPECTED_CALL(mocks, json_parse_string(VALID_JSON_CONTENT));
+    STRICT_EXPECTED_CALL(mocks, json_object_get_array(IGNORED_PTR_ARG, "links"))
+        .IgnoreArgument(1)
+        .SetFailReturn((JSON_Array *)NULL);
+    STRICT_EXPECTED_CALL(mocks, json_array_get_count(IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .SetReturn(1);
+    setup_parse_modules_entry(mocks, 0, "module1");
+
+    //Act
+    GATEWAY_UPDATE_FROM_JSON_RESULT result = Gateway_ReconcileFromJson(gateway, VALID_JSON_CONTENT);
+
+    //Assert
+    ASSERT_ARE_EQUAL(int, (int)GATEWAY_UPDATE_FROM_JSON_SUCCESS, (int)result);
+    ASSERT_ARE_EQUAL(size_t, 1, BASEIMPLEMENTATION::VECTOR_size(gateway->modules));
+    ASSERT_ARE_EQUAL(size_t, 0, BASEIMPLEMENTATION::VECTOR_size(gateway->links));
+    ASSERT_ARE_EQUAL(void_ptr, (void*)module1, *(void**)BASEIMPLEMENTATION::VECTOR_element(gateway->modules, 0));
+    ASSERT_ARE_EQUAL(size_t, 0, started_modules_count);
+    ASSERT_ARE_EQUAL(size_t, 1, drained_modules_count);
+    ASSERT_ARE_EQUAL(size_t, 0, removed_undrained_count);
+
+    //Cleanup
+    gateway_destroy_internal(gateway);
+}
+
+
+/*Tests_SRS_GATEWAY_JSON_17_025: [ The function shall then create the replacing modules. ]*/
+/*Tests_SRS_GATEWAY_JSON_17_045: [ The function shall drain each module it removes with Broker_DrainModule, for at most GATEWAY_RECONCILE_DRAIN_MS, before removing it. ]*/
+/*Tests_SRS_GATEWAY_JSON_17_046: [ If the replacing modules cannot be created together, the function shall create the ones the gateway does not have one at a time, return GATEWAY_UPDATE_FROM_JSON_ERROR and leave out those that fail, which were reported removed, so the next reconcile adds them. ]*/
+TEST_FUNCTION(Gateway_ReconcileFromJson_replaces_the_modules_it_can_when_a_replacement_fails)
+{
+    //Arrange
+    CGatewayMocks mocks;
+    GATEWAY_HANDLE gateway = Gateway_Create(NULL);
+    mocks.ResetAllCalls();
+
+    setup_2module_update_gw(mocks, (char *)VALID_JSON_CONTENT);
+    setup_parse_modules_entry(mocks, 0, "module1");
+    setup_parse_modules_entry(mocks, 1, "module2");
+    STRICT_EXPECTED_CALL(mocks, VECTOR_create(sizeof(GATEWAY_LINK_ENTRY)));
+    STRICT_EXPECTED_CALL(mocks, json_array_get_count(IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .SetReturn(0);
+    ASSERT_ARE_EQUAL(int, (int)GATEWAY_UPDATE_FROM_JSON_SUCCESS, (int)Gateway_ReconcileFromJson(gateway, VALID_JSON_CONTENT));
+    MODULE_DATA* module1 = *(MODULE_DATA**)BASEIMPLEMENTATION::VECTOR_element(gateway->modules, 0);
+    MODULE_DATA* module2 = *(MODULE_DATA**)BASEIMPLEMENTATION::VECTOR_element(gateway->modules, 1);
+    /*modules that were not added from JSON are always replaced*/
+    module1->configuration_hash = 0;
+    module2->configuration_hash = 0;
+    mocks.ResetAllCalls();
+    started_modules_count = 0;
+
+    setup_2module_update_gw(mocks, (char *)VALID_JSON_CONTENT);
+    setup_parse_modules_entry(mocks, 0, "module1");
+    setup_parse_modules_entry(mocks, 1, "module2");
+    STRICT_EXPECTED_CALL(mocks, VECTOR_create(sizeof(GATEWAY_LINK_ENTRY)));
+    STRICT_EXPECTED_CALL(mocks, json_array_get_count(IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .SetReturn(0);
+    /*both fail together, then module1 fails again on its own*/
+    module_create_failures = 3;
+
+    //Act
+    GATEWAY_UPDATE_FROM_JSON_RESULT result = Gateway_ReconcileFromJson(gateway, VALID_JSON_CONTENT);
+
+    //Assert
+    ASSERT_ARE_EQUAL(int, (int)GATEWAY_UPDATE_FROM_JSON_ERROR, (int)result);
+    ASSERT_ARE_EQUAL(size_t, 2, drained_modules_count);
+    ASSERT_ARE_EQUAL(size_t, 0, removed_undrained_count);
+    ASSERT_ARE_EQUAL(size_t, 1, BASEIMPLEMENTATION::VECTOR_size(gateway->modules));
+    ASSERT_ARE_EQUAL(char_ptr, "module2", (*(MODULE_DATA**)BASEIMPLEMENTATION::VECTOR_element(gateway->modules, 0))->module_name);
+    ASSERT_ARE_EQUAL(size_t, 1, started_modules_count);
+
+    //Cleanup
+    gateway_destroy_internal(gateway);
+}
+
+/*Tests_SRS_GATEWAY_JSON_17_036: [ If the gateway was built without the configuration watcher, Gateway_WatchConfigFile shall return NULL. ]*/
+TEST_FUNCTION(Gateway_WatchConfigFile_returns_NULL_without_the_watcher)
+{
+    //Arrange
+    CGatewayMocks mocks;
+    GATEWAY_HANDLE gateway = Gateway_Create(NULL);
+    mocks.ResetAllCalls();
+
+    //Act
+    GATEWAY_CONFIG_WATCHER_HANDLE result = Gateway_WatchConfigFile(gateway, "gateway.json");
+
+    //Assert
+    ASSERT_IS_NULL(result);
+    mocks.AssertActualAndExpectedCalls();
+
+    //Cleanup
+    Gateway_StopWatchingConfigFile(result);
+    gateway_destroy_internal(gateway);
+}
+
 END_TEST_SUITE(gateway_createfromjson_ut)
@@ -0,0 +1,888 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <string.h>
+#include "testrunnerswitcher.h"
+#include "umock_c.h"
+#include "azure_c_shared_utility/threadapi.h"
+
+static TEST_MUTEX_HANDLE g_testByTest;
+
+#include "module.h"
+#include "module_access.h"
+#include "module_loader.h"
+#include "message.h"
+#include "timer_service.h"
+#include "internal/gateway_lazy_module.h"
+
+#define TEST_BROKER ((BROKER_HANDLE)0x1)
+#define TEST_ENTRYPOINT ((void*)0x2)
+#define TEST_LIBRARY ((MODULE_LIBRARY_HANDLE)0x3)
+#define TEST_MODULE ((MODULE_HANDLE)0x4)
+#define TEST_TIMER_SERVICE ((TIMER_SERVICE_HANDLE)0x5)
+#define TEST_ARGS "{\"a\":1}"
+
+static size_t currentmalloc_call;
+static size_t whenShallmalloc_fail;
+
+static void* my_gballoc_malloc(size_t size)
+{
+    void* result;
+    currentmalloc_call++;
+    if (whenShallmalloc_fail > 0 && currentmalloc_call == whenShallmalloc_fail)
+    {
+        result = NULL;
+    }
+    else
+    {
+        result = malloc(size);
+    }
+    return result;
+}
+
+static void my_gballoc_free(void* ptr)
+{
+    free(ptr);
+}
+
+#define ENABLE_MOCKS
+#include "azure_c_shared_utility/gballoc.h"
+#undef ENABLE_MOCKS
+
+/*the module behind the stand-in is created on a timer thread, the tests wait for what it does*/
+static volatile int loads;
+static volatile int unloads;
+static volatile int entrypoints_freed;
+static volatile int creates;
+static volatile int destroys;
+static volatile int starts;
+static volatile int receives;
+static volatile int last_received;
+static volatile bool fail_create;
+static volatile bool hold_create;
+static volatile bool hold_receive;
+static volatile int receiving;
+static char created_args[32];
+
+/*the module calls of the test loader, unless it sets parallel_create*/
+static volatile bool module_calls_locked;
+static volatile bool created_locked;
+static volatile bool destroyed_locked;
+
+MODULE_LOADER_RESULT ModuleLoader_LockModuleCalls(const MODULE_LOADER* loader)
+{
+    (void)loader;
+    module_calls_locked = true;
+    return MODULE_LOADER_SUCCESS;
+}
+
+void ModuleLoader_UnlockModuleCalls(const MODULE_LOADER* loader)
+{
+    (void)loader;
+    module_calls_locked = false;
+}
+
+/*messages are an id and a reference count*/
+typedef struct TEST_MESSAGE_TAG
+{
+    int id;
+    int count;
+} TEST_MESSAGE;
+
+static int live_messages;
+
+static MESSAGE_HANDLE test_message(int id)
+{
+    TEST_MESSAGE* message = (TEST_MESSAGE*)malloc(sizeof(TEST_MESSAGE));
+    message->id = id;
+    message->count = 1;
+    live_messages++;
+    return (MESSAGE_HANDLE)message;
+}
+
+MESSAGE_HANDLE Message_Clone(MESSAGE_HANDLE message)
+{
+    ((TEST_MESSAGE*)message)->count++;
+    return message;
+}
+
+void Message_Destroy(MESSAGE_HANDLE message)
+{
+    if (--((TEST_MESSAGE*)message)->count == 0)
+    {
+        free(message);
+        live_messages--;
+    }
+}
+
+static MODULE_HANDLE publisher;
+
+BROKER_RESULT Broker_SetModulePublisher(BROKER_HANDLE broker, MODULE_HANDLE module, MODULE_HANDLE module_publisher)
+{
+    (void)broker;
+    (void)module;
+    publisher = module_publisher;
+    return BROKER_OK;
+}
+
+static bool no_timer_service;
+
+TIMER_SERVICE_HANDLE Broker_GetTimerService(BROKER_HANDLE broker)
+{
+    (void)broker;
+    return no_timer_service ? NULL : TEST_TIMER_SERVICE;
+}
+
+/*a one-shot timer fires on a thread of its own, which cancelling it joins; the tests fire the periodic idle check themselves*/
+typedef struct TEST_TIMER_TAG
+{
+    TIMER_CALLBACK callback;
+    void* context;
+    THREAD_HANDLE thread;
+} TEST_TIMER;
+
+static TIMER_CALLBACK timer_callback;
+static void* timer_context;
+static volatile int timers;
+
+static int fire_timer(void* param)
+{
+    TEST_TIMER* timer = (TEST_TIMER*)param;
+    timer->callback(timer->context);
+    return 0;
+}
+
+TIMER_HANDLE TimerService_Schedule(TIMER_SERVICE_HANDLE service, unsigned int delay_ms, unsigned int period_ms, TIMER_CALLBACK callback, void* context)
+{
+    TEST_TIMER* timer = (TEST_TIMER*)malloc(sizeof(TEST_TIMER));
+    (void)service;
+    (void)delay_ms;
+    timer->callback = callback;
+    timer->context = context;
+    timer->thread = NULL;
+    if (period_ms == 0)
+    {
+        ASSERT_ARE_EQUAL(int, (int)THREADAPI_OK, (int)ThreadAPI_Create(&timer->thread, fire_timer, timer));
+    }
+    else
+    {
+        timer_callback = callback;
+        timer_context = context;
+    }
+    timers++;
+    return (TIMER_HANDLE)timer;
+}
+
+void TimerService_Cancel(TIMER_SERVICE_HANDLE service, TIMER_HANDLE timer)
+{
+    TEST_TIMER* test_timer = (TEST_TIMER*)timer;
+    (void)service;
+    if (test_timer->thread != NULL)
+    {
+        int thread_result;
+        (void)ThreadAPI_Join(test_timer->thread, &thread_result);
+    }
+    free(test_timer);
+    timers--;
+}
+
+static void* Test_ParseConfigurationFromJson(const char* configuration)
+{
+    return (void*)configuration;
+}
+
+static void Test_FreeConfiguration(void* configuration)
+{
+    (void)configuration;
+}
+
+static MODULE_HANDLE Test_Create(BROKER_HANDLE broker, const void* configuration)
+{
+    MODULE_HANDLE result;
+    (void)broker;
+    while (hold_create)
+    {
+        ThreadAPI_Sleep(1);
+    }
+    (void)strcpy(created_args, configuration == NULL ? "" : (const char*)configuration);
+    result = fail_create ? NULL : TEST_MODULE;
+    created_locked = module_calls_locked;
+    creates++;
+    return result;
+}
+
+static void Test_Destroy(MODULE_HANDLE module)
+{
+    (void)module;
+    destroyed_locked = module_calls_locked;
+    destroys++;
+}
+
+static void Test_Receive(MODULE_HANDLE module, MESSAGE_HANDLE message)
+{
+    (void)module;
+    receiving++;
+    while (hold_receive)
+    {
+        ThreadAPI_Sleep(1);
+    }
+    last_received = ((TEST_MESSAGE*)message)->id;
+    receives++;
+}
+
+static void Test_Start(MODULE_HANDLE module)
+{
+    (void)module;
+    starts++;
+}
+
+static const MODULE_API_1 test_module_api =
+{
+    { MODULE_API_VERSION_1 },
+    Test_ParseConfigurationFromJson,
+    Test_FreeConfiguration,
+    Test_Create,
+    Test_Destroy,
+    Test_Receive,
+    Test_Start
+};
+
+static MODULE_LIBRARY_HANDLE TestLoader_Load(const MODULE_LOADER* loader, const void* entrypoint)
+{
+    (void)loader;
+    (void)entrypoint;
+    loads++;
+    return TEST_LIBRARY;
+}
+
+static void TestLoader_Unload(const MODULE_LOADER* loader, MODULE_LIBRARY_HANDLE handle)
+{
+    (void)loader;
+    (void)handle;
+    unloads++;
+}
+
+static const MODULE_API* TestLoader_GetApi(const MODULE_LOADER* loader, MODULE_LIBRARY_HANDLE handle)
+{
+    (void)loader;
+    (void)handle;
+    return (const MODULE_API*)&test_module_api;
+}
+
+static void TestLoader_FreeEntrypoint(const MODULE_LOADER* loader, void* entrypoint)
+{
+    (void)loader;
+    (void)entrypoint;
+    entrypoints_freed++;
+}
+
+static void* TestLoader_BuildModuleConfiguration(const MODULE_LOADER* loader, const void* entrypoint, const void* module_configuration)
+{
+    (void)loader;
+    (void)entrypoint;
+    return (void*)module_configuration;
+}
+
+static void TestLoader_FreeModuleConfiguration(const MODULE_LOADER* loader, const void* module_configuration)
+{
+    (void)loader;
+    (void)module_configuration;
+}
+
+static MODULE_LOADER_API test_loader_api =
+{
+    TestLoader_Load,
+    TestLoader_Unload,
+    TestLoader_GetApi,
+    NULL,
+    TestLoader_FreeEntrypoint,
+    NULL,
+    NULL,
+    TestLoader_BuildModuleConfiguration,
+    TestLoader_FreeModuleConfiguration
+};
+
+static MODULE_LOADER test_loader =
+{
+    NATIVE,
+    "native",
+    NULL,
+    &test_loader_api,
+    false
+};
+
+static void wait_for(volatile int* counter, int expected)
+{
+    int waited_ms;
+    for (waited_ms = 0; *counter < expected && waited_ms < 5000; waited_ms++)
+    {
+        ThreadAPI_Sleep(1);
+    }
+    ASSERT_ARE_EQUAL(int, expected, *counter);
+}
+
+/*what the gateway does to add a module and free its entry, returns the stand-in*/
+typedef struct TEST_STAND_IN_TAG
+{
+    GATEWAY_MODULE_LOADER_INFO loader_info;
+    MODULE_LIBRARY_HANDLE library;
+    const MODULE_API* api;
+    MODULE_HANDLE module;
+} TEST_STAND_IN;
+
+static void add_stand_in(TEST_STAND_IN* stand_in, size_t max_queued_messages, unsigned int idle_timeout_ms)
+{
+    GATEWAY_LAZY_ACTIVATION activation;
+    void* configuration;
+    void* module_configuration;
+    activation.max_queued_messages = max_queued_messages;
+    activation.idle_timeout_ms = idle_timeout_ms;
+    stand_in->loader_info.loader = &test_loader;
+    stand_in->loader_info.entrypoint = TEST_ENTRYPOINT;
+    ASSERT_ARE_EQUAL(int, 0, GatewayLazyModule_Wrap(&stand_in->loader_info, &activation));
+
+    stand_in->library = stand_in->loader_info.loader->api->Load(stand_in->loader_info.loader, stand_in->loader_info.entrypoint);
+    stand_in->api = stand_in->loader_info.loader->api->GetApi(stand_in->loader_info.loader, stand_in->library);
+    configuration = MODULE_PARSE_CONFIGURATION_FROM_JSON(stand_in->api)(TEST_ARGS);
+    module_configuration = stand_in->loader_info.loader->api->BuildModuleConfiguration(stand_in->loader_info.loader, stand_in->loader_info.entrypoint, configuration);
+    stand_in->module = MODULE_CREATE(stand_in->api)(TEST_BROKER, module_configuration);
+    MODULE_FREE_CONFIGURATION(stand_in->api)(configuration);
+    stand_in->loader_info.loader->api->FreeModuleConfiguration(stand_in->loader_info.loader, module_configuration);
+    stand_in->loader_info.loader->api->FreeEntrypoint(stand_in->loader_info.loader, stand_in->loader_info.entrypoint);
+    ASSERT_IS_NOT_NULL(stand_in->module);
+}
+
+static void remove_stand_in(TEST_STAND_IN* stand_in)
+{
+    MODULE_DESTROY(stand_in->api)(stand_in->module);
+    stand_in->loader_info.loader->api->Unload(stand_in->loader_info.loader, stand_in->library);
+}
+
+static void receive(TEST_STAND_IN* stand_in, int id)
+{
+    MESSAGE_HANDLE message = test_message(id);
+    MODULE_RECEIVE(stand_in->api)(stand_in->module, message);
+    Message_Destroy(message);
+}
+
+static int receive_on_thread(void* param)
+{
+    receive((TEST_STAND_IN*)param, 2);
+    return 0;
+}
+
+static void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
+{
+    (void)error_code;
+    ASSERT_FAIL("umock_c reported error");
+}
+
+BEGIN_TEST_SUITE(gateway_lazy_module_ut)
+
+    TEST_SUITE_INITIALIZE(TestClassInitialize)
+    {
+        g_testByTest = TEST_MUTEX_CREATE();
+        ASSERT_IS_NOT_NULL(g_testByTest);
+
+        umock_c_init(on_umock_c_error);
+
+        REGISTER_GLOBAL_MOCK_HOOK(gballoc_malloc, my_gballoc_malloc);
+        REGISTER_GLOBAL_MOCK_HOOK(gballoc_free, my_gballoc_free);
+    }
+
+    TEST_SUITE_CLEANUP(TestClassCleanup)
+    {
+        TEST_MUTEX_DESTROY(g_testByTest);
+        umock_c_deinit();
+    }
+
+    TEST_FUNCTION_INITIALIZE(TestMethodInitialize)
+    {
+        if (TEST_MUTEX_ACQUIRE(g_testByTest) != 0)
+        {
+            ASSERT_FAIL("our mutex is ABANDONED. Failure in test framework");
+        }
+
+        umock_c_reset_all_calls();
+
+        currentmalloc_call = 0;
+        whenShallmalloc_fail = 0;
+        loads = 0;
+        unloads = 0;
+        entrypoints_freed = 0;
+        creates = 0;
+        destroys = 0;
+        starts = 0;
+        receives = 0;
+        last_received = -1;
+        fail_create = false;
+        hold_create = false;
+        hold_receive = false;
+        receiving = 0;
+        created_args[0] = '\0';
+        module_calls_locked = false;
+        created_locked = false;
+        destroyed_locked = false;
+        test_loader.parallel_create = false;
+        live_messages = 0;
+        publisher = NULL;
+        no_timer_service = false;
+        timer_callback = NULL;
+        timer_context = NULL;
+        timers = 0;
+    }
+
+    TEST_FUNCTION_CLEANUP(TestMethodCleanup)
+    {
+        TEST_MUTEX_RELEASE(g_testByTest);
+    }
+
+    /*Tests_SRS_GATEWAY_LAZY_17_001: [ If loader_info, its loader or its entrypoint, or activation is NULL, or activation asks for no queue, GatewayLazyModule_Wrap shall fail and return a non-zero value. ]*/
+    TEST_FUNCTION(GatewayLazyModule_Wrap_fails_with_invalid_arguments)
+    {
+        ///arrange
+        GATEWAY_MODULE_LOADER_INFO loader_info = { &test_loader, TEST_ENTRYPOINT };
+        GATEWAY_MODULE_LOADER_INFO no_entrypoint = { &test_loader, NULL };
+        GATEWAY_LAZY_ACTIVATION activation = { 4, 0 };
+        GATEWAY_LAZY_ACTIVATION no_queue = { 0, 0 };
+
+        ///act
+        int result1 = GatewayLazyModule_Wrap(NULL, &activation);
+        int result2 = GatewayLazyModule_Wrap(&loader_info, NULL);
+        int result3 = GatewayLazyModule_Wrap(&no_entrypoint, &activation);
+        int result4 = GatewayLazyModule_Wrap(&loader_info, &no_queue);
+
+        ///assert
+        ASSERT_ARE_NOT_EQUAL(int, 0, result1);
+        ASSERT_ARE_NOT_EQUAL(int, 0, result2);
+        ASSERT_ARE_NOT_EQUAL(int, 0, result3);
+        ASSERT_ARE_NOT_EQUAL(int, 0, result4);
+        ASSERT_IS_TRUE(loader_info.loader == &test_loader);
+        ASSERT_IS_TRUE(loader_info.entrypoint == TEST_ENTRYPOINT);
+    }
+
+    /*Tests_SRS_GATEWAY_LAZY_17_001: [ If loader_info, its loader or its entrypoint, or activation is NULL, or activation asks for no queue, GatewayLazyModule_Wrap shall fail and return a non-zero value. ]*/
+    TEST_FUNCTION(GatewayLazyModule_Wrap_fails_when_malloc_fails)
+    {
+        ///arrange
+        GATEWAY_MODULE_LOADER_INFO loader_info = { &test_loader, TEST_ENTRYPOINT };
+        GATEWAY_LAZY_ACTIVATION activation = { 4, 0 };
+        whenShallmalloc_fail = 1;
+
+        ///act
+        int result = GatewayLazyModule_Wrap(&loader_info, &activation);
+
+        ///assert
+        ASSERT_ARE_NOT_EQUAL(int, 0, result);
+        ASSERT_IS_TRUE(loader_info.loader == &test_loader);
+        ASSERT_IS_TRUE(loader_info.entrypoint == TEST_ENTRYPOINT);
+    }
+
+    /*Tests_SRS_GATEWAY_LAZY_17_002: [ GatewayLazyModule_Wrap shall replace the loader and entrypoint of loader_info by the ones of a stand-in that keeps them and activation, and return 0. ]*/
+    /*Tests_SRS_GATEWAY_LAZY_17_003: [ The loader of the stand-in shall load nothing, its library handle keeping the entrypoint alive. ]*/
+    /*Tests_SRS_GATEWAY_LAZY_17_005: [ Module_Create of the stand-in shall create a bounded message queue of max_queued_messages and neither load nor create the module. ]*/
+    TEST_FUNCTION(stand_in_is_added_without_loading_the_module)
+    {
+        ///arrange
+        TEST_STAND_IN stand_in;
+
+        ///act
+        add_stand_in(&stand_in, 4, 0);
+
+        ///assert
+        ASSERT_ARE_EQUAL(char_ptr, "lazy", stand_in.loader_info.loader->name);
+        ASSERT_ARE_EQUAL(int, 0, loads);
+        ASSERT_ARE_EQUAL(int, 0, creates);
+        ASSERT_ARE_EQUAL(int, 0, entrypoints_freed);
+
+        ///cleanup
+        remove_stand_in(&stand_in);
+        ASSERT_ARE_EQUAL(int, 1, entrypoints_freed);
+        ASSERT_ARE_EQUAL(int, 0, loads);
+    }
+
+    /*Tests_SRS_GATEWAY_LAZY_17_006: [ If any underlying call fails, Module_Create of the stand-in shall free what it allocated and return NULL. ]*/
+    TEST_FUNCTION(stand_in_Create_fails_when_malloc_fails)
+    {
+        size_t fail_at;
+        for (fail_at = 1; fail_at <= 3; fail_at++)
+        {
+            ///arrange
+            GATEWAY_MODULE_LOADER_INFO loader_info = { &test_loader, TEST_ENTRYPOINT };
+            GATEWAY_LAZY_ACTIVATION activation = { 4, 0 };
+            MODULE_LIBRARY_HANDLE library;
+            const MODULE_API* api;
+            void* configuration;
+            ASSERT_ARE_EQUAL(int, 0, GatewayLazyModule_Wrap(&loader_info, &activation));
+            library = loader_info.loader->api->Load(loader_info.loader, loader_info.entrypoint);
+            api = loader_info.loader->api->GetApi(loader_info.loader, library);
+            configuration = loader_info.loader->api->BuildModuleConfiguration(loader_info.loader, loader_info.entrypoint, TEST_ARGS);
+            currentmalloc_call = 0;
+            whenShallmalloc_fail = fail_at;
+
+            ///act
+            MODULE_HANDLE module = MODULE_CREATE(api)(TEST_BROKER, configuration);
+
+            ///assert
+            ASSERT_IS_NULL(module);
+
+            ///cleanup
+            whenShallmalloc_fail = 0;
+            loader_info.loader->api->FreeModuleConfiguration(loader_info.loader, configuration);
+            loader_info.loader->api->Unload(loader_info.loader, library);
+            loader_info.loader->api->FreeEntrypoint(loader_info.loader, loader_info.entrypoint);
+        }
+        ASSERT_ARE_EQUAL(int, 3, entrypoints_freed);
+    }
+
+    /*Tests_SRS_GATEWAY_LAZY_17_006: [ If any underlying call fails, Module_Create of the stand-in shall free what it allocated and return NULL. ]*/
+    /*Tests_SRS_GATEWAY_LAZY_17_017: [ Module_Create of the stand-in shall get the timer service of the broker, on which the module is activated and the idle check runs. ]*/
+    TEST_FUNCTION(stand_in_Create_fails_without_a_timer_service)
+    {
+        ///arrange
+        GATEWAY_MODULE_LOADER_INFO loader_info = { &test_loader, TEST_ENTRYPOINT };
+        GATEWAY_LAZY_ACTIVATION activation = { 4, 1000 };
+        MODULE_LIBRARY_HANDLE library;
+        const MODULE_API* api;
+        void* configuration;
+        ASSERT_ARE_EQUAL(int, 0, GatewayLazyModule_Wrap(&loader_info, &activation));
+        library = loader_info.loader->api->Load(loader_info.loader, loader_info.entrypoint);
+        api = loader_info.loader->api->GetApi(loader_info.loader, library);
+        configuration = loader_info.loader->api->BuildModuleConfiguration(loader_info.loader, loader_info.entrypoint, TEST_ARGS);
+        no_timer_service = true;
+
+        ///act
+        MODULE_HANDLE module = MODULE_CREATE(api)(TEST_BROKER, configuration);
+
+        ///assert
+        ASSERT_IS_NULL(module);
+        ASSERT_ARE_EQUAL(int, 0, timers);
+
+        ///cleanup
+        loader_info.loader->api->FreeModuleConfiguration(loader_info.loader, configuration);
+        loader_info.loader->api->Unload(loader_info.loader, library);
+        loader_info.loader->api->FreeEntrypoint(loader_info.loader, loader_info.entrypoint);
+        ASSERT_ARE_EQUAL(int, 1, entrypoints_freed);
+    }
+
+    /*Tests_SRS_GATEWAY_LAZY_17_004: [ The stand-in shall keep a copy of the serialized args until the module is activated. ]*/
+    /*Tests_SRS_GATEWAY_LAZY_17_008: [ Otherwise Module_Receive of the stand-in shall queue a clone of the message, dropping it if the queue is full, and schedule the activation of the module on the timer service unless it is activating already. ]*/
+    /*Tests_SRS_GATEWAY_LAZY_17_009: [ The activation shall load the library of the module, parse its args, build its configuration with the wrapped loader and create it. ]*/
+    /*Tests_SRS_GATEWAY_LAZY_17_010: [ The stand-in shall set the module as its publisher on the broker. ]*/
+    /*Tests_SRS_GATEWAY_LAZY_17_012: [ The activation shall then hand the queued messages to the module, oldest first. ]*/
+    TEST_FUNCTION(first_message_activates_the_module)
+    {
+        ///arrange
+        TEST_STAND_IN stand_in;
+        add_stand_in(&stand_in, 4, 0);
+        hold_create = true;
+
+        ///act
+        receive(&stand_in, 1);
+        receive(&stand_in, 2);
+        hold_create = false;
+        wait_for(&receives, 2);
+
+        ///assert
+        ASSERT_ARE_EQUAL(int, 1, loads);
+        ASSERT_ARE_EQUAL(int, 1, creates);
+        ASSERT_ARE_EQUAL(char_ptr, TEST_ARGS, created_args);
+        ASSERT_IS_TRUE(publisher == TEST_MODULE);
+        ASSERT_ARE_EQUAL(int, 2, last_received);
+
+        ///cleanup
+        remove_stand_in(&stand_in);
+        ASSERT_ARE_EQUAL(int, 0, live_messages);
+    }
+
+    /*Tests_SRS_GATEWAY_LAZY_17_007: [ While the module is active, Module_Receive of the stand-in shall hand the message to it. ]*/
+    TEST_FUNCTION(active_module_receives_directly)
+    {
+        ///arrange
+        TEST_STAND_IN stand_in;
+        add_stand_in(&stand_in, 4, 0);
+        receive(&stand_in, 1);
+        wait_for(&receives, 1);
+
+        ///act
+        receive(&stand_in, 2);
+
+        ///assert
+        ASSERT_ARE_EQUAL(int, 2, receives);
+        ASSERT_ARE_EQUAL(int, 2, last_received);
+        ASSERT_ARE_EQUAL(int, 1, loads);
+
+        ///cleanup
+        remove_stand_in(&stand_in);
+    }
+
+    /*Tests_SRS_GATEWAY_LAZY_17_008: [ Otherwise Module_Receive of the stand-in shall queue a clone of the message, dropping it if the queue is full, and schedule the activation of the module on the timer service unless it is activating already. ]*/
+    TEST_FUNCTION(messages_beyond_the_queue_are_dropped_while_activating)
+    {
+        ///arrange
+        TEST_STAND_IN stand_in;
+        int id;
+        add_stand_in(&stand_in, 2, 0);
+        hold_create = true;
+
+        ///act
+        for (id = 1; id <= 4; id++)
+        {
+            receive(&stand_in, id);
+        }
+        hold_create = false;
+        wait_for(&receives, 2);
+        ThreadAPI_Sleep(50);
+
+        ///assert
+        ASSERT_ARE_EQUAL(int, 2, receives);
+        ASSERT_ARE_EQUAL(int, 2, last_received);
+        ASSERT_ARE_EQUAL(int, 1, creates);
+
+        ///cleanup
+        remove_stand_in(&stand_in);
+        ASSERT_ARE_EQUAL(int, 0, live_messages);
+    }
+
+    /*Tests_SRS_GATEWAY_LAZY_17_013: [ If the module cannot be activated, the stand-in shall drop the queued messages and every message it receives afterwards. ]*/
+    TEST_FUNCTION(messages_are_dropped_when_activation_fails)
+    {
+        ///arrange
+        TEST_STAND_IN stand_in;
+        add_stand_in(&stand_in, 4, 0);
+        fail_create = true;
+
+        ///act
+        receive(&stand_in, 1);
+        wait_for(&unloads, 1);
+        ThreadAPI_Sleep(50);
+        receive(&stand_in, 2);
+
+        ///assert
+        ASSERT_ARE_EQUAL(int, 1, creates);
+        ASSERT_ARE_EQUAL(int, 0, receives);
+        ASSERT_IS_NULL(publisher);
+        ASSERT_ARE_EQUAL(int, 0, live_messages);
+
+        ///cleanup
+        remove_stand_in(&stand_in);
+        ASSERT_ARE_EQUAL(int, 1, loads);
+        ASSERT_ARE_EQUAL(int, 0, destroys);
+    }
+
+    /*Tests_SRS_GATEWAY_LAZY_17_011: [ If the stand-in was started, the activation shall start the module. ]*/
+    /*Tests_SRS_GATEWAY_LAZY_17_016: [ Module_Start of the stand-in shall start the module if it is active, and otherwise have it started once it is activated. ]*/
+    TEST_FUNCTION(module_is_started_once_activated)
+    {
+        ///arrange
+        TEST_STAND_IN stand_in;
+        add_stand_in(&stand_in, 4, 0);
+
+        ///act
+        MODULE_START(stand_in.api)(stand_in.module);
+        ASSERT_ARE_EQUAL(int, 0, starts);
+        receive(&stand_in, 1);
+        wait_for(&receives, 1);
+
+        ///assert
+        ASSERT_ARE_EQUAL(int, 1, starts);
+
+        ///cleanup
+        remove_stand_in(&stand_in);
+    }
+
+    /*Tests_SRS_GATEWAY_LAZY_17_016: [ Module_Start of the stand-in shall start the module if it is active, and otherwise have it started once it is activated. ]*/
+    TEST_FUNCTION(active_module_is_started_by_Start)
+    {
+        ///arrange
+        TEST_STAND_IN stand_in;
+        add_stand_in(&stand_in, 4, 0);
+        receive(&stand_in, 1);
+        wait_for(&receives, 1);
+        ASSERT_ARE_EQUAL(int, 0, starts);
+
+        ///act
+        MODULE_START(stand_in.api)(stand_in.module);
+
+        ///assert
+        ASSERT_ARE_EQUAL(int, 1, starts);
+
+        ///cleanup
+        remove_stand_in(&stand_in);
+    }
+
+    /*Tests_SRS_GATEWAY_LAZY_17_014: [ Once an active module received nothing for idle_timeout_ms, the stand-in shall destroy it, unload its library and become inactive. ]*/
+    TEST_FUNCTION(idle_module_is_unloaded_and_activated_again)
+    {
+        ///arrange
+        TEST_STAND_IN stand_in;
+        add_stand_in(&stand_in, 4, 1);
+        receive(&stand_in, 1);
+        wait_for(&receives, 1);
+        ThreadAPI_Sleep(10);
+        ASSERT_IS_NOT_NULL(timer_callback);
+
+        ///act
+        timer_callback(timer_context);
+
+        ///assert
+        ASSERT_ARE_EQUAL(int, 1, destroys);
+        ASSERT_ARE_EQUAL(int, 1, unloads);
+        ASSERT_IS_NULL(publisher);
+
+        receive(&stand_in, 2);
+        wait_for(&receives, 2);
+        ASSERT_ARE_EQUAL(int, 2, loads);
+        ASSERT_ARE_EQUAL(int, 2, last_received);
+        /*the idle check and the last activation*/
+        ASSERT_ARE_EQUAL(int, 2, timers);
+
+        ///cleanup
+        remove_stand_in(&stand_in);
+        ASSERT_ARE_EQUAL(int, 0, timers);
+    }
+
+    /*Tests_SRS_GATEWAY_LAZY_17_014: [ Once an active module received nothing for idle_timeout_ms, the stand-in shall destroy it, unload its library and become inactive. ]*/
+    TEST_FUNCTION(busy_module_is_kept)
+    {
+        ///arrange
+        TEST_STAND_IN stand_in;
+        add_stand_in(&stand_in, 4, 60000);
+        receive(&stand_in, 1);
+        wait_for(&receives, 1);
+        ASSERT_IS_NOT_NULL(timer_callback);
+
+        ///act
+        timer_callback(timer_context);
+
+        ///assert
+        ASSERT_ARE_EQUAL(int, 0, destroys);
+        ASSERT_IS_TRUE(publisher == TEST_MODULE);
+
+        ///cleanup
+        remove_stand_in(&stand_in);
+    }
+
+    /*Tests_SRS_GATEWAY_LAZY_17_015: [ Module_Destroy of the stand-in shall cancel the idle check, wait for an activation in progress, destroy the module if it is active and unload its library. ]*/
+    TEST_FUNCTION(Destroy_waits_for_the_activation_and_destroys_the_module)
+    {
+        ///arrange
+        TEST_STAND_IN stand_in;
+        add_stand_in(&stand_in, 4, 1000);
+        receive(&stand_in, 1);
+
+        ///act
+        remove_stand_in(&stand_in);
+
+        ///assert
+        ASSERT_ARE_EQUAL(int, 1, creates);
+        ASSERT_ARE_EQUAL(int, 1, destroys);
+        ASSERT_ARE_EQUAL(int, 1, unloads);
+        ASSERT_ARE_EQUAL(int, 0, timers);
+        ASSERT_ARE_EQUAL(int, 1, entrypoints_freed);
+        ASSERT_ARE_EQUAL(int, 0, live_messages);
+    }
+
+    /*Tests_SRS_GATEWAY_LAZY_17_009: [ The activation shall load the library of the module, parse its args, build its configuration with the wrapped loader and create it. ]*/
+    /*Tests_SRS_GATEWAY_LAZY_17_014: [ Once an active module received nothing for idle_timeout_ms, the stand-in shall destroy it, unload its library and become inactive. ]*/
+    TEST_FUNCTION(module_of_a_serial_loader_is_created_and_destroyed_under_the_loader_lock)
+    {
+        ///arrange
+        TEST_STAND_IN stand_in;
+        add_stand_in(&stand_in, 4, 1);
+        receive(&stand_in, 1);
+        wait_for(&receives, 1);
+        ThreadAPI_Sleep(10);
+
+        ///act
+        timer_callback(timer_context);
+
+        ///assert
+        ASSERT_IS_TRUE(created_locked);
+        ASSERT_IS_TRUE(destroyed_locked);
+        ASSERT_IS_FALSE(module_calls_locked);
+
+        ///cleanup
+        remove_stand_in(&stand_in);
+    }
+
+    /*Tests_SRS_GATEWAY_LAZY_17_009: [ The activation shall load the library of the module, parse its args, build its configuration with the wrapped loader and create it. ]*/
+    TEST_FUNCTION(module_of_a_parallel_loader_is_created_without_the_loader_lock)
+    {
+        ///arrange
+        TEST_STAND_IN stand_in;
+        test_loader.parallel_create = true;
+        add_stand_in(&stand_in, 4, 0);
+
+        ///act
+        receive(&stand_in, 1);
+        wait_for(&receives, 1);
+        remove_stand_in(&stand_in);
+
+        ///assert
+        ASSERT_ARE_EQUAL(int, 1, creates);
+        ASSERT_IS_FALSE(created_locked);
+        ASSERT_IS_FALSE(destroyed_locked);
+    }
+
+    /*Tests_SRS_GATEWAY_LAZY_17_007: [ While the module is active, Module_Receive of the stand-in shall hand the message to it. ]*/
+    /*Tests_SRS_GATEWAY_LAZY_17_016: [ Module_Start of the stand-in shall start the module if it is active, and otherwise have it started once it is activated. ]*/
+    TEST_FUNCTION(Start_is_not_held_up_by_a_module_receiving)
+    {
+        ///arrange
+        TEST_STAND_IN stand_in;
+        THREAD_HANDLE thread;
+        int thread_result;
+        add_stand_in(&stand_in, 4, 0);
+        receive(&stand_in, 1);
+        wait_for(&receives, 1);
+        hold_receive = true;
+        ASSERT_ARE_EQUAL(int, (int)THREADAPI_OK, (int)ThreadAPI_Create(&thread, receive_on_thread, &stand_in));
+        wait_for(&receiving, 2);
+
+        ///act
+        MODULE_START(stand_in.api)(stand_in.module);
+
+        ///assert
+        ASSERT_ARE_EQUAL(int, 1, starts);
+        ASSERT_ARE_EQUAL(int, 1, receives);
+
+        ///cleanup
+        hold_receive = false;
+        (void)ThreadAPI_Join(thread, &thread_result);
+        ASSERT_ARE_EQUAL(int, 2, receives);
+        remove_stand_in(&stand_in);
+    }
+
+    /*Tests_SRS_GATEWAY_LAZY_17_014: [ Once an active module received nothing for idle_timeout_ms, the stand-in shall destroy it, unload its library and become inactive. ]*/
+    TEST_FUNCTION(module_receiving_is_not_unloaded)
+    {
+        ///arrange
+        TEST_STAND_IN stand_in;
+        THREAD_HANDLE thread;
+        int thread_result;
+        add_stand_in(&stand_in, 4, 1);
+        receive(&stand_in, 1);
+        wait_for(&receives, 1);
+        hold_receive = true;
+        ASSERT_ARE_EQUAL(int, (int)THREADAPI_OK, (int)ThreadAPI_Create(&thread, receive_on_thread, &stand_in));
+        wait_for(&receiving, 2);
+        ThreadAPI_Sleep(10);
+
+        ///act
+        timer_callback(timer_context);
+
+        ///assert
+        ASSERT_ARE_EQUAL(int, 0, destroys);
+
+        ///cleanup
+        hold_receive = false;
+        (void)ThreadAPI_Join(thread, &thread_result);
+        remove_stand_in(&stand_in);
+        ASSERT_ARE_EQUAL(int, 1, destroys);
+    }
+
+END_TEST_SUITE(gateway_lazy_module_ut)
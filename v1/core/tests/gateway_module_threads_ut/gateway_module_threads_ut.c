@@ -0,0 +1,392 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <string.h>
+#include "testrunnerswitcher.h"
+#include "azure_c_shared_utility/lock.h"
+#include "azure_c_shared_utility/threadapi.h"
+#include "azure_c_shared_utility/vector.h"
+
+static TEST_MUTEX_HANDLE g_testByTest;
+
+#include "gateway.h"
+#include "broker.h"
+#include "module.h"
+#include "module_access.h"
+#include "module_loader.h"
+#include "experimental/event_system.h"
+#include "gateway_internal.h"
+
+#define TEST_BROKER ((BROKER_HANDLE)0x1)
+#define TEST_EVENT_SYSTEM ((EVENTSYSTEM_HANDLE)0x2)
+#define TEST_MODULES 4
+
+/*the modules of one loader, Module_Create counts how many of them are being created at the same time*/
+typedef struct TEST_MODULE_GROUP_TAG
+{
+    int creating;
+    int most_creating;
+    int created;
+} TEST_MODULE_GROUP;
+
+static LOCK_HANDLE groups_lock;
+static TEST_MODULE_GROUP parallel_group;
+static TEST_MODULE_GROUP serialized_group;
+
+/*what the gateway needs of the broker and the event system, none of which is looked at here*/
+BROKER_HANDLE Broker_Create(void)
+{
+    return TEST_BROKER;
+}
+
+void Broker_Destroy(BROKER_HANDLE broker)
+{
+    (void)broker;
+}
+
+void Broker_IncRef(BROKER_HANDLE broker)
+{
+    (void)broker;
+}
+
+void Broker_DecRef(BROKER_HANDLE broker)
+{
+    (void)broker;
+}
+
+BROKER_RESULT Broker_AddModule(BROKER_HANDLE broker, const MODULE* module)
+{
+    (void)broker;
+    (void)module;
+    return BROKER_OK;
+}
+
+BROKER_RESULT Broker_RemoveModule(BROKER_HANDLE broker, const MODULE* module)
+{
+    (void)broker;
+    (void)module;
+    return BROKER_OK;
+}
+
+BROKER_RESULT Broker_AddLink(BROKER_HANDLE broker, const BROKER_LINK_DATA* link)
+{
+    (void)broker;
+    (void)link;
+    return BROKER_OK;
+}
+
+BROKER_RESULT Broker_RemoveLink(BROKER_HANDLE broker, const BROKER_LINK_DATA* link)
+{
+    (void)broker;
+    (void)link;
+    return BROKER_OK;
+}
+
+BROKER_RESULT Broker_AddAnySourceLink(BROKER_HANDLE broker, MODULE_HANDLE sink)
+{
+    (void)broker;
+    (void)sink;
+    return BROKER_OK;
+}
+
+BROKER_RESULT Broker_RemoveAnySourceLink(BROKER_HANDLE broker, MODULE_HANDLE sink)
+{
+    (void)broker;
+    (void)sink;
+    return BROKER_OK;
+}
+
+EVENTSYSTEM_HANDLE EventSystem_InitWithDispatcher(EVENTSYSTEM_DISPATCHER dispatcher)
+{
+    (void)dispatcher;
+    return TEST_EVENT_SYSTEM;
+}
+
+void EventSystem_ReportEvent(EVENTSYSTEM_HANDLE event_system, GATEWAY_HANDLE gw, GATEWAY_EVENT event_type)
+{
+    (void)event_system;
+    (void)gw;
+    (void)event_type;
+}
+
+void EventSystem_ReportModuleEvent(EVENTSYSTEM_HANDLE event_system, GATEWAY_HANDLE gw, GATEWAY_EVENT event_type, const char* module_name)
+{
+    (void)event_system;
+    (void)gw;
+    (void)event_type;
+    (void)module_name;
+}
+
+void EventSystem_ReportLinkEvent(EVENTSYSTEM_HANDLE event_system, GATEWAY_HANDLE gw, GATEWAY_EVENT event_type, const GATEWAY_LINK_ENTRY* link)
+{
+    (void)event_system;
+    (void)gw;
+    (void)event_type;
+    (void)link;
+}
+
+void EventSystem_Destroy(EVENTSYSTEM_HANDLE event_system)
+{
+    (void)event_system;
+}
+
+/*one lock for each loader type, like the module loader keeps*/
+static LOCK_HANDLE module_call_locks[NATIVE_STATIC + 1];
+
+MODULE_LOADER_RESULT ModuleLoader_LockModuleCalls(const MODULE_LOADER* loader)
+{
+    return Lock(module_call_locks[loader->type]) == LOCK_OK ? MODULE_LOADER_SUCCESS : MODULE_LOADER_ERROR;
+}
+
+void ModuleLoader_UnlockModuleCalls(const MODULE_LOADER* loader)
+{
+    (void)Unlock(module_call_locks[loader->type]);
+}
+
+/*the module configuration is the group of the module*/
+static MODULE_HANDLE Test_Create(BROKER_HANDLE broker, const void* configuration)
+{
+    TEST_MODULE_GROUP* group = (TEST_MODULE_GROUP*)configuration;
+    (void)broker;
+
+    (void)Lock(groups_lock);
+    group->creating++;
+    if (group->creating > group->most_creating)
+    {
+        group->most_creating = group->creating;
+    }
+    (void)Unlock(groups_lock);
+
+    /*long enough for the other threads to start creating their module*/
+    ThreadAPI_Sleep(100);
+
+    (void)Lock(groups_lock);
+    group->creating--;
+    group->created++;
+    (void)Unlock(groups_lock);
+
+    return (MODULE_HANDLE)malloc(1);
+}
+
+static void Test_Destroy(MODULE_HANDLE module)
+{
+    free(module);
+}
+
+static void Test_Receive(MODULE_HANDLE module, MESSAGE_HANDLE message)
+{
+    (void)module;
+    (void)message;
+}
+
+static const MODULE_API_1 test_module_api =
+{
+    { MODULE_API_VERSION_1 },
+    NULL,
+    NULL,
+    Test_Create,
+    Test_Destroy,
+    Test_Receive,
+    NULL
+};
+
+/*the entrypoint of a module is its group*/
+static MODULE_LIBRARY_HANDLE TestLoader_Load(const MODULE_LOADER* loader, const void* entrypoint)
+{
+    (void)loader;
+    return (MODULE_LIBRARY_HANDLE)entrypoint;
+}
+
+static void TestLoader_Unload(const MODULE_LOADER* loader, MODULE_LIBRARY_HANDLE library)
+{
+    (void)loader;
+    (void)library;
+}
+
+static const MODULE_API* TestLoader_GetApi(const MODULE_LOADER* loader, MODULE_LIBRARY_HANDLE library)
+{
+    (void)loader;
+    (void)library;
+    return (const MODULE_API*)&test_module_api;
+}
+
+static void* TestLoader_BuildModuleConfiguration(const MODULE_LOADER* loader, const void* entrypoint, const void* module_configuration)
+{
+    (void)loader;
+    (void)module_configuration;
+    return (void*)entrypoint;
+}
+
+static void TestLoader_FreeModuleConfiguration(const MODULE_LOADER* loader, const void* module_configuration)
+{
+    (void)loader;
+    (void)module_configuration;
+}
+
+static MODULE_LOADER_API test_loader_api =
+{
+    TestLoader_Load,
+    TestLoader_Unload,
+    TestLoader_GetApi,
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    TestLoader_BuildModuleConfiguration,
+    TestLoader_FreeModuleConfiguration
+};
+
+static MODULE_LOADER parallel_loader =
+{
+    NATIVE,
+    "parallel",
+    NULL,
+    &test_loader_api,
+    true
+};
+
+static MODULE_LOADER serialized_loader =
+{
+    JAVA,
+    "serialized",
+    NULL,
+    &test_loader_api,
+    false
+};
+
+static const char* module_names[TEST_MODULES] = { "module0", "module1", "module2", "module3" };
+
+/*creates a gateway of TEST_MODULES modules, the first serialized_count of them of the serialized loader*/
+static GATEWAY_HANDLE create_gateway(size_t serialized_count)
+{
+    GATEWAY_HANDLE gateway;
+    GATEWAY_PROPERTIES properties;
+    size_t i;
+    properties.gateway_modules = VECTOR_create(sizeof(GATEWAY_MODULES_ENTRY));
+    properties.gateway_links = NULL;
+    ASSERT_IS_NOT_NULL(properties.gateway_modules);
+    for (i = 0; i < TEST_MODULES; i++)
+    {
+        GATEWAY_MODULES_ENTRY entry;
+        entry.module_name = module_names[i];
+        if (i < serialized_count)
+        {
+            entry.module_loader_info.loader = &serialized_loader;
+            entry.module_loader_info.entrypoint = &serialized_group;
+        }
+        else
+        {
+            entry.module_loader_info.loader = &parallel_loader;
+            entry.module_loader_info.entrypoint = &parallel_group;
+        }
+        entry.module_configuration = NULL;
+        ASSERT_ARE_EQUAL(int, 0, VECTOR_push_back(properties.gateway_modules, &entry, 1));
+    }
+
+    gateway = gateway_create_internal(&properties, false);
+
+    VECTOR_destroy(properties.gateway_modules);
+    return gateway;
+}
+
+BEGIN_TEST_SUITE(gateway_module_threads_ut)
+
+    TEST_SUITE_INITIALIZE(TestClassInitialize)
+    {
+        size_t i;
+        g_testByTest = TEST_MUTEX_CREATE();
+        ASSERT_IS_NOT_NULL(g_testByTest);
+
+        groups_lock = Lock_Init();
+        ASSERT_IS_NOT_NULL(groups_lock);
+        for (i = 0; i < sizeof(module_call_locks) / sizeof(module_call_locks[0]); i++)
+        {
+            module_call_locks[i] = Lock_Init();
+            ASSERT_IS_NOT_NULL(module_call_locks[i]);
+        }
+    }
+
+    TEST_SUITE_CLEANUP(TestClassCleanup)
+    {
+        size_t i;
+        for (i = 0; i < sizeof(module_call_locks) / sizeof(module_call_locks[0]); i++)
+        {
+            (void)Lock_Deinit(module_call_locks[i]);
+        }
+        (void)Lock_Deinit(groups_lock);
+        TEST_MUTEX_DESTROY(g_testByTest);
+    }
+
+    TEST_FUNCTION_INITIALIZE(TestMethodInitialize)
+    {
+        if (TEST_MUTEX_ACQUIRE(g_testByTest) != 0)
+        {
+            ASSERT_FAIL("our mutex is ABANDONED. Failure in test framework");
+        }
+
+        memset(&parallel_group, 0, sizeof(TEST_MODULE_GROUP));
+        memset(&serialized_group, 0, sizeof(TEST_MODULE_GROUP));
+    }
+
+    TEST_FUNCTION_CLEANUP(TestMethodCleanup)
+    {
+        TEST_MUTEX_RELEASE(g_testByTest);
+    }
+
+    /*Tests_SRS_GATEWAY_17_073: [ The function shall then create the modules concurrently, on at most GATEWAY_MODULE_THREADS threads including the calling one, one at a time for each loader type that did not set parallel_create. ]*/
+    TEST_FUNCTION(modules_of_a_parallel_loader_are_created_concurrently)
+    {
+        ///arrange
+
+        ///act
+        GATEWAY_HANDLE gateway = create_gateway(0);
+
+        ///assert
+        ASSERT_IS_NOT_NULL(gateway);
+        ASSERT_ARE_EQUAL(int, TEST_MODULES, parallel_group.created);
+        ASSERT_IS_TRUE(parallel_group.most_creating > 1);
+
+        ///cleanup
+        gateway_destroy_internal(gateway);
+    }
+
+    /*Tests_SRS_GATEWAY_17_073: [ The function shall then create the modules concurrently, on at most GATEWAY_MODULE_THREADS threads including the calling one, one at a time for each loader type that did not set parallel_create. ]*/
+    /*Tests_SRS_GATEWAY_17_099: [ If the loader of the module did not set parallel_create, the function shall call Module_Create between ModuleLoader_LockModuleCalls and ModuleLoader_UnlockModuleCalls. ]*/
+    TEST_FUNCTION(modules_of_a_serialized_loader_are_created_one_at_a_time)
+    {
+        ///arrange
+
+        ///act
+        GATEWAY_HANDLE gateway = create_gateway(TEST_MODULES);
+
+        ///assert
+        ASSERT_IS_NOT_NULL(gateway);
+        ASSERT_ARE_EQUAL(int, TEST_MODULES, serialized_group.created);
+        ASSERT_ARE_EQUAL(int, 1, serialized_group.most_creating);
+
+        ///cleanup
+        gateway_destroy_internal(gateway);
+    }
+
+    /*Tests_SRS_GATEWAY_17_099: [ If the loader of the module did not set parallel_create, the function shall call Module_Create between ModuleLoader_LockModuleCalls and ModuleLoader_UnlockModuleCalls. ]*/
+    TEST_FUNCTION(serialized_loader_does_not_hold_back_a_parallel_one)
+    {
+        ///arrange
+
+        ///act
+        GATEWAY_HANDLE gateway = create_gateway(TEST_MODULES / 2);
+
+        ///assert
+        ASSERT_IS_NOT_NULL(gateway);
+        ASSERT_ARE_EQUAL(int, TEST_MODULES / 2, serialized_group.created);
+        ASSERT_ARE_EQUAL(int, TEST_MODULES / 2, parallel_group.created);
+        ASSERT_ARE_EQUAL(int, 1, serialized_group.most_creating);
+
+        ///cleanup
+        gateway_destroy_internal(gateway);
+    }
+
+END_TEST_SUITE(gateway_module_threads_ut)
@@ -0,0 +1,218 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "testrunnerswitcher.h"
+#include "umock_c.h"
+
+static TEST_MUTEX_HANDLE g_testByTest;
+
+#include "gateway_trace.h"
+
+#define TEST_TRACE_FILE "gateway_trace_ut.json"
+
+static size_t currentmalloc_call;
+static size_t whenShallmalloc_fail;
+
+static void* my_gballoc_malloc(size_t size)
+{
+    void* result;
+    currentmalloc_call++;
+    if (whenShallmalloc_fail > 0 && currentmalloc_call == whenShallmalloc_fail)
+    {
+        result = NULL;
+    }
+    else
+    {
+        result = malloc(size);
+    }
+    return result;
+}
+
+static void my_gballoc_free(void* ptr)
+{
+    free(ptr);
+}
+
+#define ENABLE_MOCKS
+#include "azure_c_shared_utility/gballoc.h"
+#undef ENABLE_MOCKS
+
+static char trace_text[16384];
+
+static const char* read_trace_file(void)
+{
+    size_t length = 0;
+    FILE* file = fopen(TEST_TRACE_FILE, "r");
+    if (file != NULL)
+    {
+        length = fread(trace_text, 1, sizeof(trace_text) - 1, file);
+        (void)fclose(file);
+    }
+    trace_text[length] = '\0';
+    return trace_text;
+}
+
+static void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
+{
+    (void)error_code;
+    ASSERT_FAIL("umock_c reported error");
+}
+
+/*trace buffers live until the process exits, so this suite does not check for leaks*/
+BEGIN_TEST_SUITE(gateway_trace_ut)
+
+    TEST_SUITE_INITIALIZE(TestClassInitialize)
+    {
+        g_testByTest = TEST_MUTEX_CREATE();
+        ASSERT_IS_NOT_NULL(g_testByTest);
+
+        umock_c_init(on_umock_c_error);
+
+        REGISTER_GLOBAL_MOCK_HOOK(gballoc_malloc, my_gballoc_malloc);
+        REGISTER_GLOBAL_MOCK_HOOK(gballoc_free, my_gballoc_free);
+    }
+
+    TEST_SUITE_CLEANUP(TestClassCleanup)
+    {
+        (void)remove(TEST_TRACE_FILE);
+        TEST_MUTEX_DESTROY(g_testByTest);
+        umock_c_deinit();
+    }
+
+    TEST_FUNCTION_INITIALIZE(TestMethodInitialize)
+    {
+        if (TEST_MUTEX_ACQUIRE(g_testByTest) != 0)
+        {
+            ASSERT_FAIL("our mutex is ABANDONED. Failure in test framework");
+        }
+
+        umock_c_reset_all_calls();
+
+        currentmalloc_call = 0;
+        whenShallmalloc_fail = 0;
+    }
+
+    TEST_FUNCTION_CLEANUP(TestMethodCleanup)
+    {
+        TEST_MUTEX_RELEASE(g_testByTest);
+    }
+
+    /*Tests_SRS_GATEWAY_TRACE_17_001: [ The first time a thread records an event, GatewayTrace_Record shall give it a ring buffer released by another thread or allocate a new one. ]*/
+    /*Tests_SRS_GATEWAY_TRACE_17_003: [ GatewayTrace_Record shall write name, phase, value, the calling thread and the current time in microseconds over the oldest event of the ring buffer of the calling thread. ]*/
+    /*Tests_SRS_GATEWAY_TRACE_17_007: [ GatewayTrace_Dump shall write a Chrome trace event JSON object whose traceEvents array holds the events kept in every ring buffer, oldest first. ]*/
+    /*Tests_SRS_GATEWAY_TRACE_17_009: [ GatewayTrace_Dump shall return 0 upon success. ]*/
+    TEST_FUNCTION(GatewayTrace_Dump_writes_recorded_events)
+    {
+        ///arrange
+        GatewayTrace_Record("publish", 'B', 12);
+        GatewayTrace_Record("message", 's', 0xab);
+        GatewayTrace_Record("publish", 'E', 0);
+        GatewayTrace_Record("message", 'f', 0xab);
+
+        ///act
+        int result = GatewayTrace_Dump(TEST_TRACE_FILE);
+
+        ///assert
+        ASSERT_ARE_EQUAL(int, 0, result);
+        const char* text = read_trace_file();
+        ASSERT_IS_NOT_NULL(strstr(text, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":["));
+        const char* begin = strstr(text, "{\"name\":\"publish\",\"cat\":\"gateway\",\"ph\":\"B\"");
+        const char* flow_start = strstr(text, "{\"name\":\"message\",\"cat\":\"gateway\",\"ph\":\"s\"");
+        const char* end = strstr(text, "{\"name\":\"publish\",\"cat\":\"gateway\",\"ph\":\"E\"");
+        const char* flow_end = strstr(text, "{\"name\":\"message\",\"cat\":\"gateway\",\"ph\":\"f\"");
+        ASSERT_IS_NOT_NULL(begin);
+        ASSERT_IS_NOT_NULL(flow_start);
+        ASSERT_IS_NOT_NULL(end);
+        ASSERT_IS_NOT_NULL(flow_end);
+        ASSERT_IS_TRUE(begin < flow_start && flow_start < end && end < flow_end);
+        ASSERT_IS_NOT_NULL(strstr(begin, "\"args\":{\"value\":12}}"));
+        ASSERT_IS_NOT_NULL(strstr(flow_start, "\"id\":\"0xab\"}"));
+        ASSERT_IS_NOT_NULL(strstr(flow_end, "\"id\":\"0xab\",\"bp\":\"e\"}"));
+        ASSERT_IS_NOT_NULL(strstr(text, "\n]}\n"));
+    }
+
+    /*Tests_SRS_GATEWAY_TRACE_17_003: [ GatewayTrace_Record shall write name, phase, value, the calling thread and the current time in microseconds over the oldest event of the ring buffer of the calling thread. ]*/
+    TEST_FUNCTION(GatewayTrace_Record_overwrites_the_oldest_events)
+    {
+        ///arrange
+        GatewayTrace_Record("first", 'i', 1);
+        GatewayTrace_Record("second", 'i', 2);
+        GatewayTrace_Record("third", 'i', 3);
+        GatewayTrace_Record("fourth", 'i', 4);
+        GatewayTrace_Record("fifth", 'i', 5);
+
+        ///act
+        int result = GatewayTrace_Dump(TEST_TRACE_FILE);
+
+        ///assert
+        ASSERT_ARE_EQUAL(int, 0, result);
+        const char* text = read_trace_file();
+        ASSERT_IS_NULL(strstr(text, "\"first\""));
+        const char* second = strstr(text, "{\"name\":\"second\"");
+        const char* fifth = strstr(text, "{\"name\":\"fifth\"");
+        ASSERT_IS_NOT_NULL(second);
+        ASSERT_IS_NOT_NULL(fifth);
+        ASSERT_IS_TRUE(second < fifth);
+        ASSERT_IS_NOT_NULL(strstr(fifth, "\"s\":\"t\",\"args\":{\"value\":5}}"));
+    }
+
+    /*Tests_SRS_GATEWAY_TRACE_17_001: [ The first time a thread records an event, GatewayTrace_Record shall give it a ring buffer released by another thread or allocate a new one. ]*/
+    /*Tests_SRS_GATEWAY_TRACE_17_004: [ GatewayTrace_ReleaseThread shall hand the ring buffer of the calling thread, if any, to the next thread that starts recording. ]*/
+    TEST_FUNCTION(GatewayTrace_Record_reuses_a_released_buffer)
+    {
+        ///arrange
+        GatewayTrace_Record("before_release", 'i', 0);
+        GatewayTrace_ReleaseThread();
+        umock_c_reset_all_calls();
+
+        ///act
+        GatewayTrace_Record("after_release", 'i', 0);
+
+        ///assert
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+        ASSERT_ARE_EQUAL(int, 0, GatewayTrace_Dump(TEST_TRACE_FILE));
+        const char* text = read_trace_file();
+        const char* before = strstr(text, "{\"name\":\"before_release\"");
+        const char* after = strstr(text, "{\"name\":\"after_release\"");
+        ASSERT_IS_NOT_NULL(before);
+        ASSERT_IS_NOT_NULL(after);
+        ASSERT_IS_TRUE(before < after);
+    }
+
+    /*Tests_SRS_GATEWAY_TRACE_17_004: [ GatewayTrace_ReleaseThread shall hand the ring buffer of the calling thread, if any, to the next thread that starts recording. ]*/
+    TEST_FUNCTION(GatewayTrace_ReleaseThread_twice_does_nothing)
+    {
+        ///act
+        GatewayTrace_ReleaseThread();
+        GatewayTrace_ReleaseThread();
+
+        ///assert
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    }
+
+    /*Tests_SRS_GATEWAY_TRACE_17_005: [ If file_path is NULL, GatewayTrace_Dump shall fail and return a non-zero value. ]*/
+    TEST_FUNCTION(GatewayTrace_Dump_fails_with_NULL_path)
+    {
+        ///act
+        int result = GatewayTrace_Dump(NULL);
+
+        ///assert
+        ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    }
+
+    /*Tests_SRS_GATEWAY_TRACE_17_006: [ If the file cannot be opened for writing, GatewayTrace_Dump shall fail and return a non-zero value. ]*/
+    TEST_FUNCTION(GatewayTrace_Dump_fails_when_the_file_cannot_be_opened)
+    {
+        ///act
+        int result = GatewayTrace_Dump("gateway_trace_ut_missing_directory/trace.json");
+
+        ///assert
+        ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    }
+
+END_TEST_SUITE(gateway_trace_ut)
@@ -21,6 +21,11 @@
 
 #define DUMMY_LIBRARY_PATH "x.dll"
 
+/*the dispatcher the gateway was built with, see gateway_internal.c*/
+#ifndef GATEWAY_EVENT_DISPATCHER
+#define GATEWAY_EVENT_DISPATCHER EVENTSYSTEM_DISPATCHER_PERSISTENT
+#endif
+
 #define GBALLOC_H
 
 DEFINE_MICROMOCK_ENUM_TO_STRING(GATEWAY_ADD_LINK_RESULT, GATEWAY_ADD_LINK_RESULT_VALUES);
@@ -62,6 +67,9 @@ static size_t currentBroker_Create_call;
 static size_t whenShallBroker_Create_fail;
 static size_t currentBroker_module_count;
 static size_t currentBroker_ref_count;
+static size_t currentBroker_messages_received;
+static size_t currentBroker_DrainModule_call;
+static size_t whenShallBroker_DrainModule_fail;
 
 static size_t currentModuleLoader_Load_call;
 static size_t whenShallModuleLoader_Load_fail;
@@ -75,6 +83,7 @@ static size_t currentVECTOR_find_if_call;
 static size_t whenShallVECTOR_find_if_fail;
 
 static MODULE_API_1 dummyAPIs;
+static char fake_json;
 
 TYPED_MOCK_CLASS(CGatewayLLMocks, CGlobalMock)
 {
@@ -169,9 +178,45 @@ public:
     MOCK_STATIC_METHOD_2(, BROKER_RESULT, Broker_AddLink, BROKER_HANDLE, handle, const BROKER_LINK_DATA*, link)
     MOCK_METHOD_END(BROKER_RESULT, BROKER_OK)
 
+    MOCK_STATIC_METHOD_3(, BROKER_RESULT, Broker_GetModuleMetrics, BROKER_HANDLE, broker, MODULE_HANDLE, module, BROKER_MODULE_METRICS*, metrics)
+        memset(metrics, 0, sizeof(BROKER_MODULE_METRICS));
+        metrics->messages_received = currentBroker_messages_received;
+        /*every delivery took between 4 and 8 microseconds*/
+        metrics->latency_buckets[3] = currentBroker_messages_received;
+        /*and used 10 microseconds of CPU*/
+        metrics->receive_cpu_us = currentBroker_messages_received * 10;
+    MOCK_METHOD_END(BROKER_RESULT, BROKER_OK)
+
+    MOCK_STATIC_METHOD_3(, BROKER_RESULT, Broker_SetModuleMemoryBudget, BROKER_HANDLE, broker, MODULE_HANDLE, module, size_t, budget_bytes)
+    MOCK_METHOD_END(BROKER_RESULT, BROKER_OK)
+
+    MOCK_STATIC_METHOD_3(, BROKER_RESULT, Broker_SetModuleShedding, BROKER_HANDLE, broker, MODULE_HANDLE, module, const BROKER_MODULE_SHEDDING*, shedding)
+    MOCK_METHOD_END(BROKER_RESULT, BROKER_OK)
+
+    MOCK_STATIC_METHOD_4(, BROKER_RESULT, Broker_DrainModule, BROKER_HANDLE, broker, MODULE_HANDLE, module, unsigned int, timeout_ms, BROKER_MODULE_DRAIN*, drain)
+        BROKER_RESULT result2;
+        ++currentBroker_DrainModule_call;
+        if (whenShallBroker_DrainModule_fail == currentBroker_DrainModule_call)
+        {
+            result2 = BROKER_ERROR;
+        }
+        else
+        {
+            drain->messages_drained = 3;
+            drain->messages_abandoned = 1;
+            result2 = BROKER_OK;
+        }
+    MOCK_METHOD_END(BROKER_RESULT, result2)
+
     MOCK_STATIC_METHOD_2(, BROKER_RESULT, Broker_RemoveLink, BROKER_HANDLE, handle, const BROKER_LINK_DATA*, link)
     MOCK_METHOD_END(BROKER_RESULT, BROKER_OK)
 
+    MOCK_STATIC_METHOD_2(, BROKER_RESULT, Broker_AddAnySourceLink, BROKER_HANDLE, handle, MODULE_HANDLE, sink)
+    MOCK_METHOD_END(BROKER_RESULT, BROKER_OK)
+
+    MOCK_STATIC_METHOD_2(, BROKER_RESULT, Broker_RemoveAnySourceLink, BROKER_HANDLE, handle, MODULE_HANDLE, sink)
+    MOCK_METHOD_END(BROKER_RESULT, BROKER_OK)
+
     MOCK_STATIC_METHOD_2(, MODULE_LIBRARY_HANDLE, DynamicModuleLoader_Load, const struct MODULE_LOADER_TAG*, loader, const void*, entrypoint)
         currentModuleLoader_Load_call++;
         MODULE_LIBRARY_HANDLE handle = NULL;
@@ -219,6 +264,12 @@ public:
 	MOCK_STATIC_METHOD_0(, void, ModuleLoader_Destroy);
 	MOCK_VOID_METHOD_END();
 
+	MOCK_STATIC_METHOD_1(, MODULE_LOADER_RESULT, ModuleLoader_LockModuleCalls, const MODULE_LOADER*, loader);
+	MOCK_METHOD_END(MODULE_LOADER_RESULT, MODULE_LOADER_SUCCESS);
+
+	MOCK_STATIC_METHOD_1(, void, ModuleLoader_UnlockModuleCalls, const MODULE_LOADER*, loader);
+	MOCK_VOID_METHOD_END();
+
     MOCK_STATIC_METHOD_0(, void, OutprocessLoader_JoinChildProcesses);
     MOCK_VOID_METHOD_END();
 
@@ -226,7 +277,7 @@ public:
     MOCK_METHOD_END(int, 0);
 
 
-    MOCK_STATIC_METHOD_0(, EVENTSYSTEM_HANDLE, EventSystem_Init)
+    MOCK_STATIC_METHOD_1(, EVENTSYSTEM_HANDLE, EventSystem_InitWithDispatcher, EVENTSYSTEM_DISPATCHER, dispatcher)
     MOCK_METHOD_END(EVENTSYSTEM_HANDLE, (EVENTSYSTEM_HANDLE)BASEIMPLEMENTATION::gballoc_malloc(1));
 
     MOCK_STATIC_METHOD_4(, void, EventSystem_AddEventCallback, EVENTSYSTEM_HANDLE, event_system, GATEWAY_EVENT, event_type, GATEWAY_CALLBACK, callback, void*, user_param)
@@ -241,6 +292,14 @@ public:
         // no-op
     MOCK_VOID_METHOD_END();
 
+    MOCK_STATIC_METHOD_4(, void, EventSystem_ReportModuleEvent, EVENTSYSTEM_HANDLE, event_system, GATEWAY_HANDLE, gw, GATEWAY_EVENT, event_type, const char*, module_name)
+        // no-op
+    MOCK_VOID_METHOD_END();
+
+    MOCK_STATIC_METHOD_4(, void, EventSystem_ReportLinkEvent, EVENTSYSTEM_HANDLE, event_system, GATEWAY_HANDLE, gw, GATEWAY_EVENT, event_type, const GATEWAY_LINK_ENTRY*, link)
+        // no-op
+    MOCK_VOID_METHOD_END();
+
     MOCK_STATIC_METHOD_1(, void, EventSystem_Destroy, EVENTSYSTEM_HANDLE, handle)
         BASEIMPLEMENTATION::gballoc_free(handle);
     MOCK_VOID_METHOD_END();
@@ -330,6 +389,44 @@ public:
         (*destination) = (char*)malloc(strlen(source) + 1);
         strcpy(*destination, source);
     MOCK_METHOD_END(int, 0);
+
+    /*the startup report only ever hands these back to parson, so they all share one fake*/
+    MOCK_STATIC_METHOD_0(, JSON_Value*, json_value_init_object)
+    MOCK_METHOD_END(JSON_Value*, (JSON_Value*)&fake_json);
+
+    MOCK_STATIC_METHOD_0(, JSON_Value*, json_value_init_array)
+    MOCK_METHOD_END(JSON_Value*, (JSON_Value*)&fake_json);
+
+    MOCK_STATIC_METHOD_1(, JSON_Object*, json_value_get_object, const JSON_Value*, value)
+    MOCK_METHOD_END(JSON_Object*, (JSON_Object*)value);
+
+    MOCK_STATIC_METHOD_1(, JSON_Array*, json_value_get_array, const JSON_Value*, value)
+    MOCK_METHOD_END(JSON_Array*, (JSON_Array*)value);
+
+    MOCK_STATIC_METHOD_3(, JSON_Status, json_object_set_value, JSON_Object*, object, const char*, name, JSON_Value*, value)
+    MOCK_METHOD_END(JSON_Status, JSONSuccess);
+
+    MOCK_STATIC_METHOD_3(, JSON_Status, json_object_set_string, JSON_Object*, object, const char*, name, const char*, string)
+    MOCK_METHOD_END(JSON_Status, JSONSuccess);
+
+    MOCK_STATIC_METHOD_3(, JSON_Status, json_object_set_number, JSON_Object*, object, const char*, name, double, number)
+    MOCK_METHOD_END(JSON_Status, JSONSuccess);
+
+    MOCK_STATIC_METHOD_2(, JSON_Status, json_array_append_value, JSON_Array*, array, JSON_Value*, value)
+    MOCK_METHOD_END(JSON_Status, JSONSuccess);
+
+    MOCK_STATIC_METHOD_1(, char*, json_serialize_to_string, const JSON_Value*, value)
+        const char* text = "[startup report]";
+        char* serialized_string = (char*)malloc(strlen(text) + 1);
+        strcpy(serialized_string, text);
+    MOCK_METHOD_END(char*, serialized_string);
+
+    MOCK_STATIC_METHOD_1(, void, json_value_free, JSON_Value*, value)
+    MOCK_VOID_METHOD_END();
+
+    MOCK_STATIC_METHOD_1(, void, json_free_serialized_string, char*, string)
+        free(string);
+    MOCK_VOID_METHOD_END();
 };
 
 DECLARE_GLOBAL_MOCK_METHOD_1(CGatewayLLMocks, , void*, mock_Module_ParseConfigurationFromJson, const char*, configuration);
@@ -343,8 +440,14 @@ DECLARE_GLOBAL_MOCK_METHOD_0(CGatewayLLMocks, , BROKER_HANDLE, Broker_Create);
 DECLARE_GLOBAL_MOCK_METHOD_1(CGatewayLLMocks, , void, Broker_Destroy, BROKER_HANDLE, broker);
 DECLARE_GLOBAL_MOCK_METHOD_2(CGatewayLLMocks, , BROKER_RESULT, Broker_AddModule, BROKER_HANDLE, handle, const MODULE*, module);
 DECLARE_GLOBAL_MOCK_METHOD_2(CGatewayLLMocks, , BROKER_RESULT, Broker_RemoveModule, BROKER_HANDLE, handle, const MODULE*, module);
+DECLARE_GLOBAL_MOCK_METHOD_3(CGatewayLLMocks, , BROKER_RESULT, Broker_GetModuleMetrics, BROKER_HANDLE, broker, MODULE_HANDLE, module, BROKER_MODULE_METRICS*, metrics);
+DECLARE_GLOBAL_MOCK_METHOD_3(CGatewayLLMocks, , BROKER_RESULT, Broker_SetModuleMemoryBudget, BROKER_HANDLE, broker, MODULE_HANDLE, module, size_t, budget_bytes);
+DECLARE_GLOBAL_MOCK_METHOD_3(CGatewayLLMocks, , BROKER_RESULT, Broker_SetModuleShedding, BROKER_HANDLE, broker, MODULE_HANDLE, module, const BROKER_MODULE_SHEDDING*, shedding);
+DECLARE_GLOBAL_MOCK_METHOD_4(CGatewayLLMocks, , BROKER_RESULT, Broker_DrainModule, BROKER_HANDLE, broker, MODULE_HANDLE, module, unsigned int, timeout_ms, BROKER_MODULE_DRAIN*, drain);
 DECLARE_GLOBAL_MOCK_METHOD_2(CGatewayLLMocks, , BROKER_RESULT, Broker_AddLink, BROKER_HANDLE, handle, const BROKER_LINK_DATA*, link);
 DECLARE_GLOBAL_MOCK_METHOD_2(CGatewayLLMocks, , BROKER_RESULT, Broker_RemoveLink, BROKER_HANDLE, handle, const BROKER_LINK_DATA*, link);
+DECLARE_GLOBAL_MOCK_METHOD_2(CGatewayLLMocks, , BROKER_RESULT, Broker_AddAnySourceLink, BROKER_HANDLE, handle, MODULE_HANDLE, sink);
+DECLARE_GLOBAL_MOCK_METHOD_2(CGatewayLLMocks, , BROKER_RESULT, Broker_RemoveAnySourceLink, BROKER_HANDLE, handle, MODULE_HANDLE, sink);
 DECLARE_GLOBAL_MOCK_METHOD_1(CGatewayLLMocks, , void, Broker_IncRef, BROKER_HANDLE, broker);
 DECLARE_GLOBAL_MOCK_METHOD_1(CGatewayLLMocks, , void, Broker_DecRef, BROKER_HANDLE, broker);
 
@@ -359,12 +462,16 @@ DECLARE_GLOBAL_MOCK_METHOD_3(CGatewayLLMocks, , void*, DynamicModuleLoader_Build
 DECLARE_GLOBAL_MOCK_METHOD_2(CGatewayLLMocks, , void, DynamicModuleLoader_FreeModuleConfiguration, const struct MODULE_LOADER_TAG*, loader, const void*, module_configuration);
 DECLARE_GLOBAL_MOCK_METHOD_0(CGatewayLLMocks, , MODULE_LOADER_RESULT, ModuleLoader_Initialize);
 DECLARE_GLOBAL_MOCK_METHOD_0(CGatewayLLMocks, , void, ModuleLoader_Destroy);
+DECLARE_GLOBAL_MOCK_METHOD_1(CGatewayLLMocks, , MODULE_LOADER_RESULT, ModuleLoader_LockModuleCalls, const MODULE_LOADER*, loader);
+DECLARE_GLOBAL_MOCK_METHOD_1(CGatewayLLMocks, , void, ModuleLoader_UnlockModuleCalls, const MODULE_LOADER*, loader);
 DECLARE_GLOBAL_MOCK_METHOD_0(CGatewayLLMocks, , void, OutprocessLoader_JoinChildProcesses);
 DECLARE_GLOBAL_MOCK_METHOD_0(CGatewayLLMocks, , int, OutprocessLoader_SpawnChildProcesses);
 
-DECLARE_GLOBAL_MOCK_METHOD_0(CGatewayLLMocks, , EVENTSYSTEM_HANDLE, EventSystem_Init);
+DECLARE_GLOBAL_MOCK_METHOD_1(CGatewayLLMocks, , EVENTSYSTEM_HANDLE, EventSystem_InitWithDispatcher, EVENTSYSTEM_DISPATCHER, dispatcher);
 DECLARE_GLOBAL_MOCK_METHOD_4(CGatewayLLMocks, , void, EventSystem_AddEventCallback, EVENTSYSTEM_HANDLE, event_system, GATEWAY_EVENT, event_type, GATEWAY_CALLBACK, callback, void*, user_param);
 DECLARE_GLOBAL_MOCK_METHOD_3(CGatewayLLMocks, , void, EventSystem_ReportEvent, EVENTSYSTEM_HANDLE, event_system, GATEWAY_HANDLE, gw, GATEWAY_EVENT, event_type);
+DECLARE_GLOBAL_MOCK_METHOD_4(CGatewayLLMocks, , void, EventSystem_ReportModuleEvent, EVENTSYSTEM_HANDLE, event_system, GATEWAY_HANDLE, gw, GATEWAY_EVENT, event_type, const char*, module_name);
+DECLARE_GLOBAL_MOCK_METHOD_4(CGatewayLLMocks, , void, EventSystem_ReportLinkEvent, EVENTSYSTEM_HANDLE, event_system, GATEWAY_HANDLE, gw, GATEWAY_EVENT, event_type, const GATEWAY_LINK_ENTRY*, link);
 DECLARE_GLOBAL_MOCK_METHOD_1(CGatewayLLMocks, , void, EventSystem_Destroy, EVENTSYSTEM_HANDLE, handle);
 
 DECLARE_GLOBAL_MOCK_METHOD_1(CGatewayLLMocks, , VECTOR_HANDLE, VECTOR_create, size_t, elementSize);
@@ -384,6 +491,18 @@ DECLARE_GLOBAL_MOCK_METHOD_2(CGatewayLLMocks, , void*, gballoc_calloc, size_t, n
 
 DECLARE_GLOBAL_MOCK_METHOD_2(CGatewayLLMocks, , int, mallocAndStrcpy_s, char**, destination, const char*, source);
 
+DECLARE_GLOBAL_MOCK_METHOD_0(CGatewayLLMocks, , JSON_Value*, json_value_init_object);
+DECLARE_GLOBAL_MOCK_METHOD_0(CGatewayLLMocks, , JSON_Value*, json_value_init_array);
+DECLARE_GLOBAL_MOCK_METHOD_1(CGatewayLLMocks, , JSON_Object*, json_value_get_object, const JSON_Value*, value);
+DECLARE_GLOBAL_MOCK_METHOD_1(CGatewayLLMocks, , JSON_Array*, json_value_get_array, const JSON_Value*, value);
+DECLARE_GLOBAL_MOCK_METHOD_3(CGatewayLLMocks, , JSON_Status, json_object_set_value, JSON_Object*, object, const char*, name, JSON_Value*, value);
+DECLARE_GLOBAL_MOCK_METHOD_3(CGatewayLLMocks, , JSON_Status, json_object_set_string, JSON_Object*, object, const char*, name, const char*, string);
+DECLARE_GLOBAL_MOCK_METHOD_3(CGatewayLLMocks, , JSON_Status, json_object_set_number, JSON_Object*, object, const char*, name, double, number);
+DECLARE_GLOBAL_MOCK_METHOD_2(CGatewayLLMocks, , JSON_Status, json_array_append_value, JSON_Array*, array, JSON_Value*, value);
+DECLARE_GLOBAL_MOCK_METHOD_1(CGatewayLLMocks, , char*, json_serialize_to_string, const JSON_Value*, value);
+DECLARE_GLOBAL_MOCK_METHOD_1(CGatewayLLMocks, , void, json_value_free, JSON_Value*, value);
+DECLARE_GLOBAL_MOCK_METHOD_1(CGatewayLLMocks, , void, json_free_serialized_string, char*, string);
+
 static MICROMOCK_GLOBAL_SEMAPHORE_HANDLE g_dllByDll;
 static MICROMOCK_MUTEX_HANDLE g_testByTest;
 
@@ -406,7 +525,8 @@ static MODULE_LOADER dummyModuleLoader =
 	NATIVE,
 	"dummy loader",
 	NULL,
-	&module_loader_api
+	&module_loader_api,
+	true
 };
 
 static GATEWAY_MODULE_LOADER_INFO dummyLoaderInfo =
@@ -415,11 +535,27 @@ static GATEWAY_MODULE_LOADER_INFO dummyLoaderInfo =
 	(void*)0x42
 };
 
+/*a loader hosting a runtime, whose modules are created and started one at a time*/
+static MODULE_LOADER serializedModuleLoader =
+{
+	JAVA,
+	"serialized loader",
+	NULL,
+	&module_loader_api,
+	false
+};
+
+static GATEWAY_MODULE_LOADER_INFO serializedLoaderInfo =
+{
+	&serializedModuleLoader,
+	(void*)0x42
+};
+
 static int sampleCallbackFuncCallCount;
 
 static void expectEventSystemInit(CGatewayLLMocks &mocks)
 {
-    STRICT_EXPECTED_CALL(mocks, EventSystem_Init());
+    STRICT_EXPECTED_CALL(mocks, EventSystem_InitWithDispatcher(GATEWAY_EVENT_DISPATCHER));
     STRICT_EXPECTED_CALL(mocks, EventSystem_ReportEvent(IGNORED_PTR_ARG, IGNORED_PTR_ARG, GATEWAY_CREATED))
         .IgnoreArgument(1)
         .IgnoreArgument(2);
@@ -478,6 +614,9 @@ TEST_FUNCTION_INITIALIZE(TestMethodInitialize)
     whenShallBroker_Create_fail = 0;
     currentBroker_module_count = 0;
     currentBroker_ref_count = 0;
+    currentBroker_messages_received = 0;
+    currentBroker_DrainModule_call = 0;
+    whenShallBroker_DrainModule_fail = 0;
 
     currentModuleLoader_Load_call = 0;
     whenShallModuleLoader_Load_fail = 0;
@@ -615,6 +754,10 @@ TEST_FUNCTION(Gateway_Create_returns_null_on_bad_module_api_entry)
     STRICT_EXPECTED_CALL(mocks, VECTOR_create(IGNORED_NUM_ARG))
         .IgnoreArgument(1); //links
     STRICT_EXPECTED_CALL(mocks, VECTOR_size(newdummyProps.gateway_modules));
+    STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG))
+        .IgnoreArgument(1); //module tasks
+    STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, VECTOR_element(newdummyProps.gateway_modules, 0));
     STRICT_EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
@@ -823,6 +966,10 @@ TEST_FUNCTION(Gateway_Create_VECTOR_push_back_Fails_To_Add_All_Modules_In_Props)
     STRICT_EXPECTED_CALL(mocks, VECTOR_create(IGNORED_NUM_ARG))
         .IgnoreArgument(1); //links
     STRICT_EXPECTED_CALL(mocks, VECTOR_size(dummyProps->gateway_modules));
+    STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG))
+        .IgnoreArgument(1); //module tasks
+    STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
 
     //Adding module 1 (Success)
     STRICT_EXPECTED_CALL(mocks, VECTOR_element(dummyProps->gateway_modules, 0));
@@ -852,10 +999,6 @@ TEST_FUNCTION(Gateway_Create_VECTOR_push_back_Fails_To_Add_All_Modules_In_Props)
     STRICT_EXPECTED_CALL(mocks, VECTOR_push_back(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1))
         .IgnoreArgument(1)
         .IgnoreArgument(2);
-    STRICT_EXPECTED_CALL(mocks, VECTOR_back(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
 
     //Adding module 2 (Failure)
     STRICT_EXPECTED_CALL(mocks, VECTOR_element(dummyProps->gateway_modules, 1));
@@ -977,6 +1120,10 @@ TEST_FUNCTION(Gateway_Create_Broker_AddModule_Fails_To_Add_All_Modules_In_Props)
     STRICT_EXPECTED_CALL(mocks, VECTOR_create(IGNORED_NUM_ARG))
         .IgnoreArgument(1); //links
     STRICT_EXPECTED_CALL(mocks, VECTOR_size(dummyProps->gateway_modules));
+    STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG))
+        .IgnoreArgument(1); //module tasks
+    STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
 
     //Adding module 1 (Success)
     STRICT_EXPECTED_CALL(mocks, VECTOR_element(dummyProps->gateway_modules, 0));
@@ -1006,10 +1153,6 @@ TEST_FUNCTION(Gateway_Create_Broker_AddModule_Fails_To_Add_All_Modules_In_Props)
     STRICT_EXPECTED_CALL(mocks, VECTOR_push_back(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1))
         .IgnoreArgument(1)
         .IgnoreArgument(2);
-    STRICT_EXPECTED_CALL(mocks, VECTOR_back(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
 
     //Adding module 2 (Failure)
     STRICT_EXPECTED_CALL(mocks, VECTOR_element(dummyProps->gateway_modules, 1));
@@ -1096,6 +1239,8 @@ TEST_FUNCTION(Gateway_Create_Broker_AddModule_Fails_To_Add_All_Modules_In_Props)
 /*Tests_SRS_GATEWAY_04_004: [If a module with the same module_name already exists, this function shall fail and the GATEWAY_HANDLE will be destroyed.]*/
 /*Tests_SRS_GATEWAY_17_020: [ The function shall clean up any constructed resources. ]*/
 /*Tests_SRS_GATEWAY_27_027: [ Launch - This function shall join any spawned threads upon any failure. ]*/
+/*Tests_SRS_GATEWAY_17_072: [ The function shall load every module and build its configuration on the calling thread, one after the other. ]*/
+/*Tests_SRS_GATEWAY_17_075: [ If any module fails to be loaded, created or attached, the function shall destroy the modules it created and unload their libraries. ]*/
 TEST_FUNCTION(Gateway_Create_AddModule_WithDuplicatedModuleName_Fails)
 {
     //Arrange
@@ -1122,15 +1267,17 @@ TEST_FUNCTION(Gateway_Create_AddModule_WithDuplicatedModuleName_Fails)
         .IgnoreArgument(1); //links
     STRICT_EXPECTED_CALL(mocks, VECTOR_size(dummyProps->gateway_modules));
 
-    //Adding module 1 (Success)
+    STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG))
+        .IgnoreArgument(1); //module tasks
+    STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+
+    //Loading module 1 (Success)
     STRICT_EXPECTED_CALL(mocks, VECTOR_element(dummyProps->gateway_modules, 0));
     STRICT_EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreAllArguments();
     STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG))
         .IgnoreArgument(1);
-    EXPECTED_CALL(mocks, mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, DynamicModuleLoader_Load(IGNORED_PTR_ARG, duplicatedEntry.module_loader_info.entrypoint))
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, DynamicModuleLoader_GetModuleApi(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
@@ -1138,58 +1285,29 @@ TEST_FUNCTION(Gateway_Create_AddModule_WithDuplicatedModuleName_Fails)
         .IgnoreArgument(2);
 	STRICT_EXPECTED_CALL(mocks, DynamicModuleLoader_BuildModuleConfiguration(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
 		.IgnoreAllArguments();
+
+    //Loading module 2 (Failure), the name is already taken by module 1
+    STRICT_EXPECTED_CALL(mocks, VECTOR_element(dummyProps->gateway_modules, 1));
+    STRICT_EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+
+    //Unloading module 1, which was never created
 	STRICT_EXPECTED_CALL(mocks, DynamicModuleLoader_FreeModuleConfiguration(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
 		.IgnoreArgument(1)
         .IgnoreArgument(2);
-	STRICT_EXPECTED_CALL(mocks, mock_Module_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-		.IgnoreArgument(1)
-		.IgnoreArgument(2);
-    STRICT_EXPECTED_CALL(mocks, Broker_AddModule(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .IgnoreArgument(1)
-        .IgnoreArgument(2);
-    STRICT_EXPECTED_CALL(mocks, Broker_IncRef(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, VECTOR_push_back(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1))
+    STRICT_EXPECTED_CALL(mocks, DynamicModuleLoader_Unload(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreArgument(1)
         .IgnoreArgument(2);
-    STRICT_EXPECTED_CALL(mocks, VECTOR_back(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
 
-    //Adding module 2 (Failure)
-    STRICT_EXPECTED_CALL(mocks, VECTOR_element(dummyProps->gateway_modules, 1));
-    STRICT_EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .IgnoreAllArguments();
-
-    //Removing previous module
+    //Destroying the gateway
     STRICT_EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, VECTOR_front(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(mocks, Broker_RemoveModule(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .IgnoreArgument(1)
-        .IgnoreArgument(2);
-    STRICT_EXPECTED_CALL(mocks, Broker_DecRef(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, DynamicModuleLoader_GetModuleApi(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .IgnoreArgument(1)
-        .IgnoreArgument(2);
-    STRICT_EXPECTED_CALL(mocks, mock_Module_Destroy(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, DynamicModuleLoader_Unload(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .IgnoreArgument(1)
-        .IgnoreArgument(2);
-    STRICT_EXPECTED_CALL(mocks, VECTOR_erase(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1))
-        .IgnoreArgument(1)
-        .IgnoreArgument(2);
     STRICT_EXPECTED_CALL(mocks, VECTOR_destroy(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, VECTOR_destroy(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
 #ifdef OUTPROCESS_ENABLED
@@ -1242,6 +1360,10 @@ TEST_FUNCTION(Gateway_Create_Adds_All_Modules_In_Props_Success)
     STRICT_EXPECTED_CALL(mocks, VECTOR_create(IGNORED_NUM_ARG))
         .IgnoreArgument(1); //links vector.
     STRICT_EXPECTED_CALL(mocks, VECTOR_size(dummyProps->gateway_modules)); //Modules
+    STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG))
+        .IgnoreArgument(1); //module tasks
+    STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
 
     //Adding module 1 (Success)
     STRICT_EXPECTED_CALL(mocks, VECTOR_element(dummyProps->gateway_modules, 0));
@@ -1271,10 +1393,6 @@ TEST_FUNCTION(Gateway_Create_Adds_All_Modules_In_Props_Success)
     STRICT_EXPECTED_CALL(mocks, VECTOR_push_back(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1))
         .IgnoreArgument(1)
         .IgnoreArgument(2);
-    STRICT_EXPECTED_CALL(mocks, VECTOR_back(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
 
     //Adding module 2 (Success)
     STRICT_EXPECTED_CALL(mocks, VECTOR_element(dummyProps->gateway_modules, 1));
@@ -1304,10 +1422,6 @@ TEST_FUNCTION(Gateway_Create_Adds_All_Modules_In_Props_Success)
     STRICT_EXPECTED_CALL(mocks, VECTOR_push_back(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1))
         .IgnoreArgument(1)
         .IgnoreArgument(2);
-    STRICT_EXPECTED_CALL(mocks, VECTOR_back(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
 
     STRICT_EXPECTED_CALL(mocks, VECTOR_size(dummyProps->gateway_links)); //Links
 
@@ -1371,6 +1485,10 @@ TEST_FUNCTION(Gateway_Create_Adds_All_Modules_And_All_Links_In_Props_Success)
     STRICT_EXPECTED_CALL(mocks, VECTOR_create(IGNORED_NUM_ARG))
         .IgnoreArgument(1); //links vector.
     STRICT_EXPECTED_CALL(mocks, VECTOR_size(dummyProps->gateway_modules));
+    STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG))
+        .IgnoreArgument(1); //module tasks
+    STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
     
     //Modules
 
@@ -1403,10 +1521,6 @@ TEST_FUNCTION(Gateway_Create_Adds_All_Modules_And_All_Links_In_Props_Success)
     STRICT_EXPECTED_CALL(mocks, VECTOR_push_back(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1))
         .IgnoreArgument(1)
         .IgnoreArgument(2);
-    STRICT_EXPECTED_CALL(mocks, VECTOR_back(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
 
     //Adding module 2 (Success)
     STRICT_EXPECTED_CALL(mocks, VECTOR_element(dummyProps->gateway_modules, 1));
@@ -1437,10 +1551,6 @@ TEST_FUNCTION(Gateway_Create_Adds_All_Modules_And_All_Links_In_Props_Success)
     STRICT_EXPECTED_CALL(mocks, VECTOR_push_back(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1))
         .IgnoreArgument(1)
         .IgnoreArgument(2);
-    STRICT_EXPECTED_CALL(mocks, VECTOR_back(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
 
     STRICT_EXPECTED_CALL(mocks, VECTOR_size(dummyProps->gateway_links)); //Links
 
@@ -1496,6 +1606,10 @@ TEST_FUNCTION(Gateway_Create_Adds_All_Modules_And_Links_fromNonExistingModule_Fa
     STRICT_EXPECTED_CALL(mocks, VECTOR_create(IGNORED_NUM_ARG))
         .IgnoreArgument(1); //links vector.
     STRICT_EXPECTED_CALL(mocks, VECTOR_size(dummyProps->gateway_modules)); //Modules
+    STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG))
+        .IgnoreArgument(1); //module tasks
+    STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
 
     //Adding module 1 (Success)
     STRICT_EXPECTED_CALL(mocks, VECTOR_element(dummyProps->gateway_modules, 0));
@@ -1527,10 +1641,6 @@ TEST_FUNCTION(Gateway_Create_Adds_All_Modules_And_Links_fromNonExistingModule_Fa
     STRICT_EXPECTED_CALL(mocks, VECTOR_push_back(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1))
         .IgnoreArgument(1)
         .IgnoreArgument(2);
-    STRICT_EXPECTED_CALL(mocks, VECTOR_back(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
 
     STRICT_EXPECTED_CALL(mocks, VECTOR_size(dummyProps->gateway_links)); //Links
 
@@ -1911,6 +2021,7 @@ TEST_FUNCTION(Gateway_AddModule_Returns_Null_For_star_module_name)
 /*Tests_SRS_GATEWAY_17_015: [ The function shall use GATEWAY_PROPERTIES::loader_api->Load and each GATEWAY_PROPERTIES::loader_configuration to get each module's MODULE_LIBRARY_HANDLE. ]*/
 /*Tests_SRS_GATEWAY_17_021: [ The function shall construct module configuration from module's entrypoint and module's module_configuration. ]*/
 /*Tests_SRS_GATEWAY_17_022: [ The function shall clean up any constructed resources. ]*/
+/*Tests_SRS_GATEWAY_17_095: [ Once the gateway has its event system, the function shall report `GATEWAY_MODULE_ADDED` with the name of every module it added. ]*/
 TEST_FUNCTION(Gateway_AddModule_Loads_Module_From_Library_Path)
 {
     //Arrange
@@ -1946,9 +2057,7 @@ TEST_FUNCTION(Gateway_AddModule_Loads_Module_From_Library_Path)
     STRICT_EXPECTED_CALL(mocks, VECTOR_push_back(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1))
         .IgnoreArgument(1)
         .IgnoreArgument(2);
-    STRICT_EXPECTED_CALL(mocks, VECTOR_back(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(mocks, EventSystem_ReportModuleEvent(IGNORED_PTR_ARG, gw, GATEWAY_MODULE_ADDED, "dummy module"))
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, EventSystem_ReportEvent(IGNORED_PTR_ARG, gw, GATEWAY_MODULE_LIST_CHANGED))
         .IgnoreArgument(1);
@@ -2065,9 +2174,67 @@ TEST_FUNCTION(Gateway_AddModule_Creates_Module_Using_Module_Properties)
     STRICT_EXPECTED_CALL(mocks, VECTOR_push_back(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1))
         .IgnoreArgument(1)
         .IgnoreArgument(2);
-    STRICT_EXPECTED_CALL(mocks, VECTOR_back(IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(mocks, EventSystem_ReportModuleEvent(IGNORED_PTR_ARG, gw, GATEWAY_MODULE_ADDED, "Test module"))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(mocks, EventSystem_ReportEvent(IGNORED_PTR_ARG, gw, GATEWAY_MODULE_LIST_CHANGED))
+        .IgnoreArgument(1);
+
+    //Act
+    MODULE_HANDLE handle = Gateway_AddModule(gw, &entry);
+
+    //Assert
+    ASSERT_IS_NOT_NULL(handle);
+    mocks.AssertActualAndExpectedCalls();
+
+    //Cleanup
+    Gateway_Destroy(gw);
+    free(properties);
+}
+
+/*Tests_SRS_GATEWAY_17_099: [ If the loader of the module did not set parallel_create, the function shall call Module_Create between ModuleLoader_LockModuleCalls and ModuleLoader_UnlockModuleCalls. ]*/
+TEST_FUNCTION(Gateway_AddModule_creates_module_of_serialized_loader_under_its_lock)
+{
+    //Arrange
+    CGatewayLLMocks mocks;
+
+    GATEWAY_HANDLE gw = Gateway_Create(NULL);
+    mocks.ResetAllCalls();
+    bool* properties = (bool*)malloc(sizeof(bool));
+    *properties = true;
+    GATEWAY_MODULES_ENTRY entry = {
+        "Test module",
+        serializedLoaderInfo,
+        properties
+    };
+
+    //Expectations
+    STRICT_EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG))
+        .IgnoreArgument(1);
+    EXPECTED_CALL(mocks, mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(mocks, DynamicModuleLoader_Load(&serializedModuleLoader, serializedLoaderInfo.entrypoint));
+    STRICT_EXPECTED_CALL(mocks, DynamicModuleLoader_GetModuleApi(&serializedModuleLoader, IGNORED_PTR_ARG))
+        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(mocks, DynamicModuleLoader_BuildModuleConfiguration(&serializedModuleLoader, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(2)
+        .IgnoreArgument(3);
+    STRICT_EXPECTED_CALL(mocks, ModuleLoader_LockModuleCalls(&serializedModuleLoader));
+    STRICT_EXPECTED_CALL(mocks, mock_Module_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(mocks, ModuleLoader_UnlockModuleCalls(&serializedModuleLoader));
+    STRICT_EXPECTED_CALL(mocks, DynamicModuleLoader_FreeModuleConfiguration(&serializedModuleLoader, IGNORED_PTR_ARG))
+        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(mocks, Broker_AddModule(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(mocks, Broker_IncRef(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, VECTOR_push_back(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(mocks, EventSystem_ReportModuleEvent(IGNORED_PTR_ARG, gw, GATEWAY_MODULE_ADDED, "Test module"))
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, EventSystem_ReportEvent(IGNORED_PTR_ARG, gw, GATEWAY_MODULE_LIST_CHANGED))
         .IgnoreArgument(1);
@@ -2084,6 +2251,45 @@ TEST_FUNCTION(Gateway_AddModule_Creates_Module_Using_Module_Properties)
     free(properties);
 }
 
+/*Tests_SRS_GATEWAY_17_099: [ If the loader of the module did not set parallel_create, the function shall call Module_Create between ModuleLoader_LockModuleCalls and ModuleLoader_UnlockModuleCalls. ]*/
+TEST_FUNCTION(Gateway_AddModule_creates_module_of_serialized_loader_when_its_lock_fails)
+{
+    //Arrange
+    CGatewayLLMocks mocks;
+
+    GATEWAY_HANDLE gw = Gateway_Create(NULL);
+    mocks.ResetAllCalls();
+    bool* properties = (bool*)malloc(sizeof(bool));
+    *properties = true;
+    GATEWAY_MODULES_ENTRY entry = {
+        "Test module",
+        serializedLoaderInfo,
+        properties
+    };
+
+    //Expectations
+    mocks.SetIgnoreUnexpectedCalls(true);
+    STRICT_EXPECTED_CALL(mocks, ModuleLoader_LockModuleCalls(&serializedModuleLoader))
+        .SetReturn(MODULE_LOADER_ERROR);
+    STRICT_EXPECTED_CALL(mocks, mock_Module_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(mocks, ModuleLoader_UnlockModuleCalls(IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .NeverInvoked();
+
+    //Act
+    MODULE_HANDLE handle = Gateway_AddModule(gw, &entry);
+
+    //Assert
+    ASSERT_IS_NOT_NULL(handle);
+    mocks.AssertActualAndExpectedCalls();
+
+    //Cleanup
+    Gateway_Destroy(gw);
+    free(properties);
+}
+
 /*Tests_SRS_GATEWAY_14_011: [ If gw, entry, or GATEWAY_MODULES_ENTRY's specified loader or entrypoint is NULL the function shall return NULL. ]*/
 TEST_FUNCTION(Gateway_AddModule_fails_on_null_loader_api)
 {
@@ -2328,6 +2534,7 @@ TEST_FUNCTION(Gateway_RemoveModule_Does_Nothing_If_Module_NULL)
 /*Tests_SRS_GATEWAY_14_025: [ The function shall unload MODULE_DATA's module_library_handle. ]*/
 /*Tests_SRS_GATEWAY_14_026: [ The function shall remove that MODULE_DATA from GATEWAY_HANDLE_DATA's modules. ]*/
 /*Tests_SRS_GATEWAY_14_038: [ The function shall decrement the BROKER_HANDLE reference count. ]*/
+/*Tests_SRS_GATEWAY_17_096: [ Once the gateway has its event system, the function shall report `GATEWAY_MODULE_REMOVED` with the name of the module after removing its links. ]*/
 TEST_FUNCTION(Gateway_RemoveModule_Finds_Module_Data_Success)
 {
     //Arrange
@@ -2339,8 +2546,6 @@ TEST_FUNCTION(Gateway_RemoveModule_Finds_Module_Data_Success)
     //Expectations
     STRICT_EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreAllArguments();
-    STRICT_EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreAllArguments();
     EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG));
@@ -2361,6 +2566,8 @@ TEST_FUNCTION(Gateway_RemoveModule_Finds_Module_Data_Success)
         .IgnoreArgument(2);
     STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, EventSystem_ReportModuleEvent(IGNORED_PTR_ARG, gw, GATEWAY_MODULE_REMOVED, "dummy module"))
+        .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, EventSystem_ReportEvent(IGNORED_PTR_ARG, gw, GATEWAY_MODULE_LIST_CHANGED))
         .IgnoreArgument(1);
     
@@ -2412,8 +2619,6 @@ TEST_FUNCTION(Gateway_RemoveModule_Broker_RemoveModule_Failure)
     //Expectations
     STRICT_EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreAllArguments();
-    STRICT_EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreAllArguments();
     whenShallBroker_RemoveModule_fail = 1;
@@ -2437,6 +2642,8 @@ TEST_FUNCTION(Gateway_RemoveModule_Broker_RemoveModule_Failure)
     STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
     // Well it IS removed from the gateway even if still linked to broker. I think this scenario should report the event
+    STRICT_EXPECTED_CALL(mocks, EventSystem_ReportModuleEvent(IGNORED_PTR_ARG, gw, GATEWAY_MODULE_REMOVED, "dummy module"))
+        .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, EventSystem_ReportEvent(IGNORED_PTR_ARG, gw, GATEWAY_MODULE_LIST_CHANGED))
         .IgnoreArgument(1);
 
@@ -2633,6 +2840,9 @@ TEST_FUNCTION(Gateway_RemoveLink_NonExistingSinkModule_Find_star_Link_Data_Failu
     STRICT_EXPECTED_CALL(mocks, VECTOR_erase(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1))
         .IgnoreArgument(1)
         .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(mocks, EventSystem_ReportLinkEvent(IGNORED_PTR_ARG, gw, GATEWAY_LINK_REMOVED, IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .IgnoreArgument(4);
     STRICT_EXPECTED_CALL(mocks, EventSystem_ReportEvent(IGNORED_PTR_ARG, IGNORED_PTR_ARG, GATEWAY_MODULE_LIST_CHANGED))
         .IgnoreArgument(1)
         .IgnoreArgument(2);
@@ -2649,6 +2859,7 @@ TEST_FUNCTION(Gateway_RemoveLink_NonExistingSinkModule_Find_star_Link_Data_Failu
 
 /*Tests_SRS_GATEWAY_04_006: [ The function shall locate the LINK_DATA object in GATEWAY_HANDLE_DATA's links containing link and return if it cannot be found. ]*/
 /*Tests_SRS_GATEWAY_04_007: [ The functional shall remove that LINK_DATA from GATEWAY_HANDLE_DATA's links. ]*/
+/*Tests_SRS_GATEWAY_17_098: [ Once the gateway has its event system, the function shall report `GATEWAY_LINK_REMOVED` with the link, whose source is "*" for a link from every module. ]*/
 TEST_FUNCTION(Gateway_RemoveLink_Finds_Link_Data_Success)
 {
     //Arrange
@@ -2687,6 +2898,9 @@ TEST_FUNCTION(Gateway_RemoveLink_Finds_Link_Data_Success)
     STRICT_EXPECTED_CALL(mocks, VECTOR_erase(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1))
         .IgnoreArgument(1)
         .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(mocks, EventSystem_ReportLinkEvent(IGNORED_PTR_ARG, gw, GATEWAY_LINK_REMOVED, IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .IgnoreArgument(4);
     STRICT_EXPECTED_CALL(mocks, EventSystem_ReportEvent(IGNORED_PTR_ARG, IGNORED_PTR_ARG, GATEWAY_MODULE_LIST_CHANGED))
         .IgnoreArgument(1)
         .IgnoreArgument(2);
@@ -2777,6 +2991,7 @@ TEST_FUNCTION(Gateway_AddLink_with_Null_Link_Module_Source_Fail)
 
 /* Tests_SRS_GATEWAY_26_001: [ This function shall initialize attached Event System and report GATEWAY_STARTED event. ]*/
 /* Tests_SRS_GATEWAY_26_010: [ This function shall report `GATEWAY_MODULE_LIST_CHANGED` event. ] */
+/* Tests_SRS_GATEWAY_26_021: [ This function shall create the Event System with the `GATEWAY_EVENT_DISPATCHER` dispatcher, which is `EVENTSYSTEM_DISPATCHER_PERSISTENT` unless the build selects otherwise. ] */
 TEST_FUNCTION(Gateway_Event_System_Create_And_Report)
 {
     //Arrange
@@ -2815,7 +3030,7 @@ TEST_FUNCTION(Gateway_Event_System_Create_Fail)
     EXPECTED_CALL(mocks, VECTOR_create(IGNORED_NUM_ARG)); //Modules.
     EXPECTED_CALL(mocks, VECTOR_create(IGNORED_NUM_ARG)); //Links
     // Fail to create
-    EXPECTED_CALL(mocks, EventSystem_Init())
+    EXPECTED_CALL(mocks, EventSystem_InitWithDispatcher(GATEWAY_EVENT_DISPATCHER))
         .SetFailReturn((EVENTSYSTEM_HANDLE)NULL);
     // Note - no EventSystem_Report()!
     // Gateway_destroy called from inside create
@@ -3019,18 +3234,644 @@ TEST_FUNCTION(Gateway_AddEventCallback_Forwards)
     Gateway_Destroy(gw);
 }
 
-/*Tests_SRS_GATEWAY_04_008: [ If gw , entryLink, entryLink->module_source or entryLink->module_source is NULL the function shall return GATEWAY_ADD_LINK_INVALID_ARG. ]*/
-TEST_FUNCTION(Gateway_AddLink_with_Null_Link_Module_Sink_Fail)
+/*Tests_SRS_GATEWAY_17_023: [ If `gw` is NULL, the function shall return a non-zero value. ]*/
+TEST_FUNCTION(Gateway_SetMetricsInterval_NULL_Gateway_Fails)
 {
-    //Arrange
+    // Arrange
     CGatewayLLMocks mocks;
 
-    GATEWAY_HANDLE gw = Gateway_Create(NULL);
-    GATEWAY_LINK_ENTRY dummyLink2;
-    dummyLink2.module_source = "Test";
-    dummyLink2.module_sink = NULL;
-
-    mocks.ResetAllCalls();
+    // Act
+    int result = Gateway_SetMetricsInterval(NULL, 1000);
+
+    // Assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    mocks.AssertActualAndExpectedCalls();
+}
+
+/*Tests_SRS_GATEWAY_17_032: [ If `gw` is NULL or `Gateway_SetMetricsInterval` was never called, the function shall return NULL. ]*/
+TEST_FUNCTION(Gateway_GetMetricsSnapshot_NULL_Gateway_Returns_NULL)
+{
+    // Arrange
+    CGatewayLLMocks mocks;
+
+    // Act
+    VECTOR_HANDLE snapshot = Gateway_GetMetricsSnapshot(NULL);
+
+    // Assert
+    ASSERT_IS_NULL(snapshot);
+    mocks.AssertActualAndExpectedCalls();
+}
+
+/*Tests_SRS_GATEWAY_17_032: [ If `gw` is NULL or `Gateway_SetMetricsInterval` was never called, the function shall return NULL. ]*/
+TEST_FUNCTION(Gateway_GetMetricsSnapshot_Not_Enabled_Returns_NULL)
+{
+    // Arrange
+    CGatewayLLMocks mocks;
+    GATEWAY_HANDLE gw = Gateway_Create(dummyProps);
+    mocks.ResetAllCalls();
+
+    // Expectations
+    EXPECTED_CALL(mocks, Broker_GetModuleMetrics(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .NeverInvoked();
+
+    // Act
+    VECTOR_HANDLE snapshot = Gateway_GetMetricsSnapshot(gw);
+
+    // Assert
+    ASSERT_IS_NULL(snapshot);
+    mocks.AssertActualAndExpectedCalls();
+
+    // Cleanup
+    Gateway_Destroy(gw);
+}
+
+/*Tests_SRS_GATEWAY_17_024: [ On the first call, the function shall record the current counters of every module as the baseline of the first snapshot. ]*/
+/*Tests_SRS_GATEWAY_17_027: [ The function shall return 0 on success. ]*/
+/*Tests_SRS_GATEWAY_17_033: [ The function shall read each module's counters with `Broker_GetModuleMetrics`. ]*/
+/*Tests_SRS_GATEWAY_17_034: [ Each `GATEWAY_MODULE_METRICS` shall hold what the module did since the previous snapshot. ]*/
+/*Tests_SRS_GATEWAY_17_035: [ The latency percentiles shall be the upper bound of the histogram bucket that holds them. ]*/
+/*Tests_SRS_GATEWAY_17_047: [ The CPU time of each module shall be the thread CPU time of its `Module_Start` and `Module_Receive` calls since the previous snapshot. ]*/
+/*Tests_SRS_GATEWAY_17_037: [ The function shall make the counters just read the baseline of the next snapshot. ]*/
+/*Tests_SRS_GATEWAY_17_030: [ The function shall stop the metrics thread and free the metrics data before destroying the event system. ]*/
+TEST_FUNCTION(Gateway_GetMetricsSnapshot_Reports_Delta_Per_Module)
+{
+    // Arrange
+    CNiceCallComparer<CGatewayLLMocks> mocks;
+    GATEWAY_HANDLE gw = Gateway_Create(dummyProps);
+    currentBroker_messages_received = 3;
+    /*an hour, the thread never ticks during the test*/
+    int result = Gateway_SetMetricsInterval(gw, 3600000);
+    currentBroker_messages_received = 7;
+    mocks.ResetAllCalls();
+
+    // Expectations
+    EXPECTED_CALL(mocks, Broker_GetModuleMetrics(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .ExpectedTimesExactly(2);
+
+    // Act
+    VECTOR_HANDLE first = Gateway_GetMetricsSnapshot(gw);
+    VECTOR_HANDLE second = Gateway_GetMetricsSnapshot(gw);
+
+    // Assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_IS_NOT_NULL(first);
+    ASSERT_IS_NOT_NULL(second);
+    ASSERT_ARE_EQUAL(size_t, (size_t)1, BASEIMPLEMENTATION::VECTOR_size(first));
+    GATEWAY_MODULE_METRICS* metrics = (GATEWAY_MODULE_METRICS*)BASEIMPLEMENTATION::VECTOR_element(first, 0);
+    ASSERT_ARE_EQUAL(int, 0, strcmp(metrics->module_name, "dummy module"));
+    ASSERT_ARE_EQUAL(size_t, (size_t)4, metrics->messages_received);
+    ASSERT_ARE_EQUAL(size_t, (size_t)0, metrics->messages_dropped);
+    ASSERT_IS_TRUE(metrics->latency_p50_us == 8);
+    ASSERT_IS_TRUE(metrics->latency_p99_us == 8);
+    ASSERT_IS_TRUE(metrics->cpu_time_us == 40);
+    metrics = (GATEWAY_MODULE_METRICS*)BASEIMPLEMENTATION::VECTOR_element(second, 0);
+    ASSERT_ARE_EQUAL(size_t, (size_t)0, metrics->messages_received);
+    ASSERT_IS_TRUE(metrics->latency_p50_us == 0);
+    mocks.AssertActualAndExpectedCalls();
+
+    // Cleanup
+    Gateway_DestroyMetricsSnapshot(first);
+    Gateway_DestroyMetricsSnapshot(second);
+    Gateway_Destroy(gw);
+}
+
+/*Tests_SRS_GATEWAY_17_028: [ Once neither snapshots, the receive deadline, memory budgets nor load shedding are enabled, the function shall stop and join the metrics thread. ]*/
+TEST_FUNCTION(Gateway_SetMetricsInterval_Zero_Stops_Thread)
+{
+    // Arrange
+    CNiceCallComparer<CGatewayLLMocks> mocks;
+    GATEWAY_HANDLE gw = Gateway_Create(dummyProps);
+    (void)Gateway_SetMetricsInterval(gw, 3600000);
+    mocks.ResetAllCalls();
+
+    // Expectations
+    EXPECTED_CALL(mocks, EventSystem_ReportEvent(IGNORED_PTR_ARG, IGNORED_PTR_ARG, GATEWAY_METRICS_SNAPSHOT))
+        .NeverInvoked();
+
+    // Act
+    int result = Gateway_SetMetricsInterval(gw, 0);
+    /*a stopped thread can be started again*/
+    int restart_result = Gateway_SetMetricsInterval(gw, 3600000);
+
+    // Assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(int, 0, restart_result);
+    mocks.AssertActualAndExpectedCalls();
+
+    // Cleanup
+    Gateway_Destroy(gw);
+}
+
+/*Tests_SRS_GATEWAY_17_039: [ `Gateway_SetReceiveDeadline` shall behave as `Gateway_SetMetricsInterval`, but set the time a module may spend in `Module_Receive` before `GATEWAY_MODULE_STUCK` is reported. ]*/
+TEST_FUNCTION(Gateway_SetReceiveDeadline_NULL_Gateway_Fails)
+{
+    // Arrange
+    CGatewayLLMocks mocks;
+
+    // Act
+    int result = Gateway_SetReceiveDeadline(NULL, 1000);
+
+    // Assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    mocks.AssertActualAndExpectedCalls();
+}
+
+/*Tests_SRS_GATEWAY_17_041: [ If `gw` is NULL or the metrics were never enabled, the function shall return NULL. ]*/
+TEST_FUNCTION(Gateway_GetStuckModules_Not_Enabled_Returns_NULL)
+{
+    // Arrange
+    CGatewayLLMocks mocks;
+    GATEWAY_HANDLE gw = Gateway_Create(dummyProps);
+    mocks.ResetAllCalls();
+
+    // Act
+    VECTOR_HANDLE null_gateway = Gateway_GetStuckModules(NULL);
+    VECTOR_HANDLE not_enabled = Gateway_GetStuckModules(gw);
+
+    // Assert
+    ASSERT_IS_NULL(null_gateway);
+    ASSERT_IS_NULL(not_enabled);
+    mocks.AssertActualAndExpectedCalls();
+
+    // Cleanup
+    Gateway_Destroy(gw);
+}
+
+/*Tests_SRS_GATEWAY_17_042: [ The function shall return the name of every module the watchdog last found past the deadline and how long its `Module_Receive` call had been running. ]*/
+/*Tests_SRS_GATEWAY_17_028: [ Once neither snapshots, the receive deadline, memory budgets nor load shedding are enabled, the function shall stop and join the metrics thread. ]*/
+TEST_FUNCTION(Gateway_GetStuckModules_Nothing_Checked_Returns_Empty)
+{
+    // Arrange
+    CNiceCallComparer<CGatewayLLMocks> mocks;
+    GATEWAY_HANDLE gw = Gateway_Create(dummyProps);
+    /*an hour, the watchdog never looks during the test*/
+    int result = Gateway_SetReceiveDeadline(gw, 3600000);
+    mocks.ResetAllCalls();
+
+    // Act
+    VECTOR_HANDLE stuck = Gateway_GetStuckModules(gw);
+    int stop_result = Gateway_SetReceiveDeadline(gw, 0);
+
+    // Assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(int, 0, stop_result);
+    ASSERT_IS_NOT_NULL(stuck);
+    ASSERT_ARE_EQUAL(size_t, (size_t)0, BASEIMPLEMENTATION::VECTOR_size(stuck));
+    mocks.AssertActualAndExpectedCalls();
+
+    // Cleanup
+    Gateway_DestroyStuckModules(stuck);
+    Gateway_Destroy(gw);
+}
+
+/*Tests_SRS_GATEWAY_17_088: [ If `gw` is NULL, the function shall do nothing and return NULL. ]*/
+TEST_FUNCTION(Gateway_Shutdown_Returns_NULL_For_NULL_Gateway)
+{
+    // Arrange
+    CGatewayLLMocks mocks;
+
+    // Act
+    VECTOR_HANDLE report = Gateway_Shutdown(NULL, 1000);
+
+    // Assert
+    ASSERT_IS_NULL(report);
+    mocks.AssertActualAndExpectedCalls();
+}
+
+/*Tests_SRS_GATEWAY_17_089: [ The function shall stop the metrics thread first, so load shedding does not change what the modules publish while they drain. ]*/
+/*Tests_SRS_GATEWAY_17_090: [ The function shall drain each module with `Broker_DrainModule` after the modules that link to it, and the modules of a cycle in the order they were added. ]*/
+/*Tests_SRS_GATEWAY_17_091: [ The modules shall share one deadline, `drain_timeout_ms` from the call, each being given what is left of it, and the function shall report the messages each module drained and abandoned. ]*/
+/*Tests_SRS_GATEWAY_17_092: [ The function shall then destroy the gateway as `Gateway_Destroy` does. ]*/
+/*Tests_SRS_GATEWAY_17_094: [ This function shall free every module name and destroy the vector. ]*/
+TEST_FUNCTION(Gateway_Shutdown_Drains_Sources_First)
+{
+    // Arrange
+    CNiceCallComparer<CGatewayLLMocks> mocks;
+    GATEWAY_MODULES_ENTRY dummyEntry2 = {
+        "dummy module 2",
+        dummyLoaderInfo,
+        NULL
+    };
+    GATEWAY_LINK_ENTRY dummyLink = {
+        "dummy module 2",
+        "dummy module"
+    };
+    BASEIMPLEMENTATION::VECTOR_push_back(dummyProps->gateway_modules, &dummyEntry2, 1);
+    BASEIMPLEMENTATION::VECTOR_push_back(dummyProps->gateway_links, &dummyLink, 1);
+    GATEWAY_HANDLE gw = Gateway_Create(dummyProps);
+    /*an hour, the watchdog never looks during the test*/
+    (void)Gateway_SetReceiveDeadline(gw, 3600000);
+    mocks.ResetAllCalls();
+
+    STRICT_EXPECTED_CALL(mocks, Broker_DrainModule(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments()
+        .ExpectedTimesExactly(2);
+    STRICT_EXPECTED_CALL(mocks, ModuleLoader_Destroy());
+
+    // Act
+    VECTOR_HANDLE report = Gateway_Shutdown(gw, 1000);
+
+    // Assert
+    ASSERT_IS_NOT_NULL(report);
+    ASSERT_ARE_EQUAL(size_t, (size_t)2, BASEIMPLEMENTATION::VECTOR_size(report));
+    GATEWAY_MODULE_DRAIN* first = (GATEWAY_MODULE_DRAIN*)BASEIMPLEMENTATION::VECTOR_element(report, 0);
+    GATEWAY_MODULE_DRAIN* second = (GATEWAY_MODULE_DRAIN*)BASEIMPLEMENTATION::VECTOR_element(report, 1);
+    ASSERT_ARE_EQUAL(char_ptr, "dummy module 2", first->module_name);
+    ASSERT_ARE_EQUAL(char_ptr, "dummy module", second->module_name);
+    ASSERT_ARE_EQUAL(size_t, (size_t)3, second->messages_drained);
+    ASSERT_ARE_EQUAL(size_t, (size_t)1, second->messages_abandoned);
+    ASSERT_ARE_EQUAL(size_t, 0, currentBroker_module_count);
+    mocks.AssertActualAndExpectedCalls();
+
+    // Cleanup
+    Gateway_DestroyShutdownReport(report);
+}
+
+/*Tests_SRS_GATEWAY_17_090: [ The function shall drain each module with `Broker_DrainModule` after the modules that link to it, and the modules of a cycle in the order they were added. ]*/
+TEST_FUNCTION(Gateway_Shutdown_Drains_A_Cycle_In_The_Order_Modules_Were_Added)
+{
+    // Arrange
+    CNiceCallComparer<CGatewayLLMocks> mocks;
+    GATEWAY_MODULES_ENTRY dummyEntry2 = {
+        "dummy module 2",
+        dummyLoaderInfo,
+        NULL
+    };
+    GATEWAY_LINK_ENTRY dummyLink = {
+        "dummy module 2",
+        "dummy module"
+    };
+    GATEWAY_LINK_ENTRY dummyLink2 = {
+        "dummy module",
+        "dummy module 2"
+    };
+    BASEIMPLEMENTATION::VECTOR_push_back(dummyProps->gateway_modules, &dummyEntry2, 1);
+    BASEIMPLEMENTATION::VECTOR_push_back(dummyProps->gateway_links, &dummyLink, 1);
+    BASEIMPLEMENTATION::VECTOR_push_back(dummyProps->gateway_links, &dummyLink2, 1);
+    GATEWAY_HANDLE gw = Gateway_Create(dummyProps);
+    mocks.ResetAllCalls();
+
+    // Act
+    VECTOR_HANDLE report = Gateway_Shutdown(gw, 1000);
+
+    // Assert
+    ASSERT_IS_NOT_NULL(report);
+    ASSERT_ARE_EQUAL(size_t, (size_t)2, BASEIMPLEMENTATION::VECTOR_size(report));
+    ASSERT_ARE_EQUAL(char_ptr, "dummy module", ((GATEWAY_MODULE_DRAIN*)BASEIMPLEMENTATION::VECTOR_element(report, 0))->module_name);
+    ASSERT_ARE_EQUAL(char_ptr, "dummy module 2", ((GATEWAY_MODULE_DRAIN*)BASEIMPLEMENTATION::VECTOR_element(report, 1))->module_name);
+
+    // Cleanup
+    Gateway_DestroyShutdownReport(report);
+}
+
+/*Tests_SRS_GATEWAY_17_090: [ The function shall drain each module with `Broker_DrainModule` after the modules that link to it, and the modules of a cycle in the order they were added. ]*/
+TEST_FUNCTION(Gateway_Shutdown_Drains_The_Sink_Of_An_Any_Source_Link_Last)
+{
+    // Arrange
+    CNiceCallComparer<CGatewayLLMocks> mocks;
+    GATEWAY_MODULES_ENTRY dummyEntry2 = {
+        "dummy module 2",
+        dummyLoaderInfo,
+        NULL
+    };
+    GATEWAY_LINK_ENTRY dummyLink = {
+        "*",
+        "dummy module"
+    };
+    BASEIMPLEMENTATION::VECTOR_push_back(dummyProps->gateway_modules, &dummyEntry2, 1);
+    BASEIMPLEMENTATION::VECTOR_push_back(dummyProps->gateway_links, &dummyLink, 1);
+    GATEWAY_HANDLE gw = Gateway_Create(dummyProps);
+    mocks.ResetAllCalls();
+
+    // Act
+    VECTOR_HANDLE report = Gateway_Shutdown(gw, 1000);
+
+    // Assert
+    ASSERT_IS_NOT_NULL(report);
+    ASSERT_ARE_EQUAL(size_t, (size_t)2, BASEIMPLEMENTATION::VECTOR_size(report));
+    ASSERT_ARE_EQUAL(char_ptr, "dummy module 2", ((GATEWAY_MODULE_DRAIN*)BASEIMPLEMENTATION::VECTOR_element(report, 0))->module_name);
+    ASSERT_ARE_EQUAL(char_ptr, "dummy module", ((GATEWAY_MODULE_DRAIN*)BASEIMPLEMENTATION::VECTOR_element(report, 1))->module_name);
+
+    // Cleanup
+    Gateway_DestroyShutdownReport(report);
+}
+
+/*Tests_SRS_GATEWAY_17_091: [ The modules shall share one deadline, `drain_timeout_ms` from the call, each being given what is left of it, and the function shall report the messages each module drained and abandoned. ]*/
+TEST_FUNCTION(Gateway_Shutdown_Leaves_Out_A_Module_That_Fails_To_Drain)
+{
+    // Arrange
+    CNiceCallComparer<CGatewayLLMocks> mocks;
+    GATEWAY_MODULES_ENTRY dummyEntry2 = {
+        "dummy module 2",
+        dummyLoaderInfo,
+        NULL
+    };
+    BASEIMPLEMENTATION::VECTOR_push_back(dummyProps->gateway_modules, &dummyEntry2, 1);
+    GATEWAY_HANDLE gw = Gateway_Create(dummyProps);
+    mocks.ResetAllCalls();
+    whenShallBroker_DrainModule_fail = 1;
+
+    // Act
+    VECTOR_HANDLE report = Gateway_Shutdown(gw, 1000);
+
+    // Assert
+    ASSERT_IS_NOT_NULL(report);
+    ASSERT_ARE_EQUAL(size_t, (size_t)1, BASEIMPLEMENTATION::VECTOR_size(report));
+    ASSERT_ARE_EQUAL(char_ptr, "dummy module 2", ((GATEWAY_MODULE_DRAIN*)BASEIMPLEMENTATION::VECTOR_element(report, 0))->module_name);
+    ASSERT_ARE_EQUAL(size_t, 0, currentBroker_module_count);
+
+    // Cleanup
+    Gateway_DestroyShutdownReport(report);
+}
+
+/*Tests_SRS_GATEWAY_17_090: [ The function shall drain each module with `Broker_DrainModule` after the modules that link to it, and the modules of a cycle in the order they were added. ]*/
+TEST_FUNCTION(Gateway_Shutdown_Without_Modules_Returns_An_Empty_Report)
+{
+    // Arrange
+    CNiceCallComparer<CGatewayLLMocks> mocks;
+    GATEWAY_HANDLE gw = Gateway_Create(NULL);
+    mocks.ResetAllCalls();
+
+    STRICT_EXPECTED_CALL(mocks, Broker_DrainModule(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments()
+        .NeverInvoked();
+
+    // Act
+    VECTOR_HANDLE report = Gateway_Shutdown(gw, 1000);
+
+    // Assert
+    ASSERT_IS_NOT_NULL(report);
+    ASSERT_ARE_EQUAL(size_t, (size_t)0, BASEIMPLEMENTATION::VECTOR_size(report));
+
+    // Cleanup
+    Gateway_DestroyShutdownReport(report);
+}
+
+/*Tests_SRS_GATEWAY_17_093: [ If the report cannot be built, the function shall still drain and destroy the gateway, and return NULL. ]*/
+TEST_FUNCTION(Gateway_Shutdown_Destroys_The_Gateway_When_The_Report_Fails)
+{
+    // Arrange
+    CNiceCallComparer<CGatewayLLMocks> mocks;
+    GATEWAY_HANDLE gw = Gateway_Create(dummyProps);
+    mocks.ResetAllCalls();
+    whenShallVECTOR_create_fail = currentVECTOR_create_call + 1;
+
+    STRICT_EXPECTED_CALL(mocks, Broker_DrainModule(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+
+    // Act
+    VECTOR_HANDLE report = Gateway_Shutdown(gw, 1000);
+
+    // Assert
+    ASSERT_IS_NULL(report);
+    ASSERT_ARE_EQUAL(size_t, 0, currentBroker_module_count);
+    mocks.AssertActualAndExpectedCalls();
+}
+
+/*Tests_SRS_GATEWAY_17_049: [ If `gw` or `module_name` is NULL, the function shall return a non-zero value. ]*/
+TEST_FUNCTION(Gateway_SetModuleMemoryBudget_NULL_Inputs_Fail)
+{
+    // Arrange
+    CGatewayLLMocks mocks;
+    GATEWAY_HANDLE gw = Gateway_Create(dummyProps);
+    mocks.ResetAllCalls();
+
+    // Act
+    int null_gateway = Gateway_SetModuleMemoryBudget(NULL, "dummy module", 1024);
+    int null_name = Gateway_SetModuleMemoryBudget(gw, NULL, 1024);
+
+    // Assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, null_gateway);
+    ASSERT_ARE_NOT_EQUAL(int, 0, null_name);
+    mocks.AssertActualAndExpectedCalls();
+
+    // Cleanup
+    Gateway_Destroy(gw);
+}
+
+/*Tests_SRS_GATEWAY_17_050: [ If no module is called `module_name`, the function shall return a non-zero value. ]*/
+TEST_FUNCTION(Gateway_SetModuleMemoryBudget_Unknown_Module_Fails)
+{
+    // Arrange
+    CNiceCallComparer<CGatewayLLMocks> mocks;
+    GATEWAY_HANDLE gw = Gateway_Create(dummyProps);
+    mocks.ResetAllCalls();
+
+    // Expectations
+    EXPECTED_CALL(mocks, Broker_SetModuleMemoryBudget(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG))
+        .NeverInvoked();
+
+    // Act
+    int result = Gateway_SetModuleMemoryBudget(gw, "no such module", 1024);
+
+    // Assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    mocks.AssertActualAndExpectedCalls();
+
+    // Cleanup
+    Gateway_Destroy(gw);
+}
+
+/*Tests_SRS_GATEWAY_17_053: [ The function shall return 0 on success and a non-zero value if any underlying call fails. ]*/
+TEST_FUNCTION(Gateway_SetModuleMemoryBudget_Broker_Fails)
+{
+    // Arrange
+    CNiceCallComparer<CGatewayLLMocks> mocks;
+    GATEWAY_HANDLE gw = Gateway_Create(dummyProps);
+    mocks.ResetAllCalls();
+
+    // Expectations
+    STRICT_EXPECTED_CALL(mocks, Broker_SetModuleMemoryBudget(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1024))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2)
+        .SetFailReturn(BROKER_ERROR);
+
+    // Act
+    int result = Gateway_SetModuleMemoryBudget(gw, "dummy module", 1024);
+
+    // Assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_IS_NULL(Gateway_GetModulesOverBudget(gw));
+    mocks.AssertActualAndExpectedCalls();
+
+    // Cleanup
+    Gateway_Destroy(gw);
+}
+
+/*Tests_SRS_GATEWAY_17_051: [ The function shall set the budget of the module with `Broker_SetModuleMemoryBudget`. ]*/
+/*Tests_SRS_GATEWAY_17_052: [ A non-zero budget shall make the metrics thread check the memory budgets of all modules, starting it if needed. ]*/
+/*Tests_SRS_GATEWAY_17_056: [ The function shall return the name, live bytes and budget of every module the last check found over its memory budget. ]*/
+TEST_FUNCTION(Gateway_SetModuleMemoryBudget_Starts_Checks)
+{
+    // Arrange
+    CNiceCallComparer<CGatewayLLMocks> mocks;
+    GATEWAY_HANDLE gw = Gateway_Create(dummyProps);
+    mocks.ResetAllCalls();
+
+    // Expectations
+    STRICT_EXPECTED_CALL(mocks, Broker_SetModuleMemoryBudget(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1024))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2);
+
+    // Act
+    int result = Gateway_SetModuleMemoryBudget(gw, "dummy module", 1024);
+    VECTOR_HANDLE over_budget = Gateway_GetModulesOverBudget(gw);
+
+    // Assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_IS_NOT_NULL(over_budget);
+    ASSERT_ARE_EQUAL(size_t, (size_t)0, BASEIMPLEMENTATION::VECTOR_size(over_budget));
+    mocks.AssertActualAndExpectedCalls();
+
+    // Cleanup
+    Gateway_DestroyModulesOverBudget(over_budget);
+    Gateway_Destroy(gw);
+}
+
+/*Tests_SRS_GATEWAY_17_055: [ If `gw` is NULL or the metrics were never enabled, the function shall return NULL. ]*/
+TEST_FUNCTION(Gateway_GetModulesOverBudget_Not_Enabled_Returns_NULL)
+{
+    // Arrange
+    CGatewayLLMocks mocks;
+    GATEWAY_HANDLE gw = Gateway_Create(dummyProps);
+    mocks.ResetAllCalls();
+
+    // Act
+    VECTOR_HANDLE null_gateway = Gateway_GetModulesOverBudget(NULL);
+    VECTOR_HANDLE not_enabled = Gateway_GetModulesOverBudget(gw);
+
+    // Assert
+    ASSERT_IS_NULL(null_gateway);
+    ASSERT_IS_NULL(not_enabled);
+    mocks.AssertActualAndExpectedCalls();
+
+    // Cleanup
+    Gateway_Destroy(gw);
+}
+
+/*Tests_SRS_GATEWAY_17_059: [ If `gw` is NULL, the function shall return a non-zero value. ]*/
+TEST_FUNCTION(Gateway_SetLoadShedding_NULL_Gateway_Fails)
+{
+    // Arrange
+    CGatewayLLMocks mocks;
+    GATEWAY_LOAD_SHEDDING shedding = { 1000, 100, 0, 0, NULL, 0 };
+
+    // Act
+    int result = Gateway_SetLoadShedding(NULL, &shedding);
+
+    // Assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    mocks.AssertActualAndExpectedCalls();
+}
+
+/*Tests_SRS_GATEWAY_17_060: [ If `shedding` has a `check_interval_ms` of 0, NULL `rules` with a non-zero `rule_count`, or a rule with a NULL `module_name`, a `level` of 0, an unknown `action` or a `sample_every` under 2 for `GATEWAY_SHEDDING_SAMPLE_INBOUND`, the function shall return a non-zero value. ]*/
+TEST_FUNCTION(Gateway_SetLoadShedding_Invalid_Settings_Fail)
+{
+    // Arrange
+    CGatewayLLMocks mocks;
+    GATEWAY_HANDLE gw = Gateway_Create(dummyProps);
+    GATEWAY_SHEDDING_RULE no_name = { NULL, 1, GATEWAY_SHEDDING_DROP_INBOUND, 0 };
+    GATEWAY_SHEDDING_RULE no_level = { "dummy module", 0, GATEWAY_SHEDDING_DROP_INBOUND, 0 };
+    GATEWAY_SHEDDING_RULE no_sample = { "dummy module", 1, GATEWAY_SHEDDING_SAMPLE_INBOUND, 1 };
+    GATEWAY_LOAD_SHEDDING no_interval = { 0, 100, 0, 0, NULL, 0 };
+    GATEWAY_LOAD_SHEDDING no_rules = { 1000, 100, 0, 0, NULL, 1 };
+    GATEWAY_LOAD_SHEDDING bad_name = { 1000, 100, 0, 0, &no_name, 1 };
+    GATEWAY_LOAD_SHEDDING bad_level = { 1000, 100, 0, 0, &no_level, 1 };
+    GATEWAY_LOAD_SHEDDING bad_sample = { 1000, 100, 0, 0, &no_sample, 1 };
+    mocks.ResetAllCalls();
+
+    // Act
+    int result1 = Gateway_SetLoadShedding(gw, &no_interval);
+    int result2 = Gateway_SetLoadShedding(gw, &no_rules);
+    int result3 = Gateway_SetLoadShedding(gw, &bad_name);
+    int result4 = Gateway_SetLoadShedding(gw, &bad_level);
+    int result5 = Gateway_SetLoadShedding(gw, &bad_sample);
+
+    // Assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result1);
+    ASSERT_ARE_NOT_EQUAL(int, 0, result2);
+    ASSERT_ARE_NOT_EQUAL(int, 0, result3);
+    ASSERT_ARE_NOT_EQUAL(int, 0, result4);
+    ASSERT_ARE_NOT_EQUAL(int, 0, result5);
+    ASSERT_IS_NULL(Gateway_GetLoadSheddingState(gw));
+    mocks.AssertActualAndExpectedCalls();
+
+    // Cleanup
+    Gateway_Destroy(gw);
+}
+
+/*Tests_SRS_GATEWAY_17_061: [ The function shall have the metrics thread check the load every `check_interval_ms` milliseconds, starting it if needed, or stop the checks if `shedding` is NULL. ]*/
+/*Tests_SRS_GATEWAY_17_062: [ The function shall stop what the previous rules shed, replace them with a copy of `shedding` and start over at level 0. ]*/
+/*Tests_SRS_GATEWAY_17_068: [ The function shall return a copy of the last shedding transition and the readings it was based on. ]*/
+/*Tests_SRS_GATEWAY_17_070: [ This function shall free `state`. ]*/
+TEST_FUNCTION(Gateway_SetLoadShedding_Starts_And_Stops_Checks)
+{
+    // Arrange
+    CNiceCallComparer<CGatewayLLMocks> mocks;
+    GATEWAY_HANDLE gw = Gateway_Create(dummyProps);
+    GATEWAY_SHEDDING_RULE rule = { "dummy module", 1, GATEWAY_SHEDDING_DROP_INBOUND, 0 };
+    /*an hour, the controller never looks during the test*/
+    GATEWAY_LOAD_SHEDDING shedding = { 3600000, 100, 0, 0, &rule, 1 };
+    mocks.ResetAllCalls();
+
+    // Expectations
+    /*only clearing the rules when the controller stops sets what is shed*/
+    STRICT_EXPECTED_CALL(mocks, Broker_SetModuleShedding(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2)
+        .IgnoreArgument(3);
+
+    // Act
+    int result = Gateway_SetLoadShedding(gw, &shedding);
+    GATEWAY_LOAD_SHEDDING_STATE* state = Gateway_GetLoadSheddingState(gw);
+    int stop_result = Gateway_SetLoadShedding(gw, NULL);
+
+    // Assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(int, 0, stop_result);
+    ASSERT_IS_NOT_NULL(state);
+    ASSERT_ARE_EQUAL(int, 0, (int)state->level);
+    ASSERT_ARE_EQUAL(int, 0, (int)state->previous_level);
+    mocks.AssertActualAndExpectedCalls();
+
+    // Cleanup
+    Gateway_DestroyLoadSheddingState(state);
+    Gateway_Destroy(gw);
+}
+
+/*Tests_SRS_GATEWAY_17_067: [ If `gw` is NULL or the metrics were never enabled, the function shall return NULL. ]*/
+TEST_FUNCTION(Gateway_GetLoadSheddingState_Not_Enabled_Returns_NULL)
+{
+    // Arrange
+    CGatewayLLMocks mocks;
+    GATEWAY_HANDLE gw = Gateway_Create(dummyProps);
+    mocks.ResetAllCalls();
+
+    // Act
+    GATEWAY_LOAD_SHEDDING_STATE* null_gateway = Gateway_GetLoadSheddingState(NULL);
+    GATEWAY_LOAD_SHEDDING_STATE* not_enabled = Gateway_GetLoadSheddingState(gw);
+
+    // Assert
+    ASSERT_IS_NULL(null_gateway);
+    ASSERT_IS_NULL(not_enabled);
+    mocks.AssertActualAndExpectedCalls();
+
+    // Cleanup
+    Gateway_Destroy(gw);
+}
+
+/*Tests_SRS_GATEWAY_04_008: [ If gw , entryLink, entryLink->module_source or entryLink->module_source is NULL the function shall return GATEWAY_ADD_LINK_INVALID_ARG. ]*/
+TEST_FUNCTION(Gateway_AddLink_with_Null_Link_Module_Sink_Fail)
+{
+    //Arrange
+    CGatewayLLMocks mocks;
+
+    GATEWAY_HANDLE gw = Gateway_Create(NULL);
+    GATEWAY_LINK_ENTRY dummyLink2;
+    dummyLink2.module_source = "Test";
+    dummyLink2.module_sink = NULL;
+
+    mocks.ResetAllCalls();
 
     //Act
     GATEWAY_ADD_LINK_RESULT result = Gateway_AddLink(gw, &dummyLink2);
@@ -3195,6 +4036,7 @@ TEST_FUNCTION(Gateway_AddLink_NonExistingSinkModule_Fail)
 
 /*Tests_SRS_GATEWAY_04_012: [ This function shall add the entryLink to the gw->links ] */
 /*Tests_SRS_GATEWAY_04_013: [If adding the link succeed this function shall return GATEWAY_ADD_LINK_SUCCESS]*/
+/*Tests_SRS_GATEWAY_17_097: [ Once the gateway has its event system, the function shall report `GATEWAY_LINK_ADDED` with every link it added. ]*/
 TEST_FUNCTION(Gateway_AddLink_Succeeds)
 {
     //Arrange
@@ -3229,6 +4071,8 @@ TEST_FUNCTION(Gateway_AddLink_Succeeds)
     STRICT_EXPECTED_CALL(mocks, VECTOR_push_back(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1))
         .IgnoreArgument(1)
         .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(mocks, EventSystem_ReportLinkEvent(IGNORED_PTR_ARG, gateway, GATEWAY_LINK_ADDED, &dummyLink))
+        .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, EventSystem_ReportEvent(IGNORED_PTR_ARG, IGNORED_PTR_ARG, GATEWAY_MODULE_LIST_CHANGED))
         .IgnoreArgument(1)
         .IgnoreArgument(2);
@@ -3292,138 +4136,7 @@ TEST_FUNCTION(Gateway_AddLink_pushback_fails)
     Gateway_Destroy(gateway);
 }
 
-TEST_FUNCTION(Gateway_AddLink_broker_add_fails)
-{
-    //Arrange
-    CGatewayLLMocks mocks;
-
-    //Add another entry to the properties
-    GATEWAY_MODULES_ENTRY dummyEntry2 = {
-        "dummy module 2",
-		dummyLoaderInfo,
-        NULL
-    };
-
-    GATEWAY_LINK_ENTRY dummyLink = {
-        "dummy module",
-        "dummy module 2"
-    };
-
-    BASEIMPLEMENTATION::VECTOR_push_back(dummyProps->gateway_modules, &dummyEntry2, 1);
-
-    GATEWAY_HANDLE gateway = Gateway_Create(dummyProps);
-    mocks.ResetAllCalls();
-
-    //Act
-    STRICT_EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .IgnoreAllArguments();//Check link
-    STRICT_EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .IgnoreAllArguments();//Check Source Module.
-    STRICT_EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .IgnoreAllArguments();//Check Sink Module.
-    STRICT_EXPECTED_CALL(mocks, Broker_AddLink(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .IgnoreAllArguments()
-        .SetFailReturn(BROKER_ADD_LINK_ERROR);
-
-     GATEWAY_ADD_LINK_RESULT result = Gateway_AddLink(gateway, &dummyLink);
-
-    //Assert
-    ASSERT_ARE_EQUAL(GATEWAY_ADD_LINK_RESULT, GATEWAY_ADD_LINK_ERROR, result);
-
-    mocks.AssertActualAndExpectedCalls();
-
-    //Cleanup
-    Gateway_Destroy(gateway);
-}
-
-TEST_FUNCTION(Gateway_AddLink_star_2nd_addbroker_fails)
-{
-    //Arrange
-    CGatewayLLMocks mocks;
-
-    //Add another entry to the properties
-    GATEWAY_MODULES_ENTRY dummyEntry2 = {
-        "dummy module 2",
-		dummyLoaderInfo,
-        NULL
-    };
-    GATEWAY_MODULES_ENTRY dummyEntry3 = {
-        "dummy module 3",
-		dummyLoaderInfo,
-        NULL
-    };
-
-    GATEWAY_LINK_ENTRY dummyLink1 = {
-        "*",
-        "dummy module 2"
-    };
-    GATEWAY_LINK_ENTRY dummyLink2 = {
-        "*",
-        "dummy module 3"
-    };
-
-    BASEIMPLEMENTATION::VECTOR_push_back(dummyProps->gateway_modules, &dummyEntry2, 1);
-    BASEIMPLEMENTATION::VECTOR_push_back(dummyProps->gateway_modules, &dummyEntry3, 1);
-
-    GATEWAY_HANDLE gateway = Gateway_Create(dummyProps);
-
-    GATEWAY_ADD_LINK_RESULT result = Gateway_AddLink(gateway, &dummyLink1);
-
-    mocks.ResetAllCalls();
-
-    //Act
-    STRICT_EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .IgnoreAllArguments();//Check link
-    STRICT_EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .IgnoreAllArguments();//Check Sink Module.
-    STRICT_EXPECTED_CALL(mocks, VECTOR_push_back(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1))
-        .IgnoreArgument(1)
-        .IgnoreArgument(2); // Add link to links vector
-    STRICT_EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG))
-        .IgnoreArgument(1); // for each module.
-    STRICT_EXPECTED_CALL(mocks, VECTOR_element(IGNORED_PTR_ARG, 0))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, VECTOR_element(IGNORED_PTR_ARG, 1))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, Broker_AddLink(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .IgnoreAllArguments();
-    STRICT_EXPECTED_CALL(mocks, Broker_AddLink(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .IgnoreAllArguments()
-        .SetFailReturn(BROKER_ADD_LINK_ERROR);
-
-    //Remove link
-    STRICT_EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .IgnoreAllArguments();
-    STRICT_EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG))
-        .IgnoreArgument(1); // for each module.
-    STRICT_EXPECTED_CALL(mocks, VECTOR_element(IGNORED_PTR_ARG, 0))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, VECTOR_element(IGNORED_PTR_ARG, 1))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, VECTOR_element(IGNORED_PTR_ARG, 2))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, Broker_RemoveLink(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .IgnoreAllArguments();
-    STRICT_EXPECTED_CALL(mocks, Broker_RemoveLink(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .IgnoreAllArguments();
-    STRICT_EXPECTED_CALL(mocks, VECTOR_back(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, VECTOR_erase(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1))
-        .IgnoreArgument(1)
-        .IgnoreArgument(2);
-
-    result = Gateway_AddLink(gateway, &dummyLink2);
-
-    //Assert
-    ASSERT_ARE_EQUAL(GATEWAY_ADD_LINK_RESULT, GATEWAY_ADD_LINK_ERROR, result);
-
-    mocks.AssertActualAndExpectedCalls();
-
-    //Cleanup
-    Gateway_Destroy(gateway);
-}
-
-TEST_FUNCTION(Gateway_AddLink_star_2nd_add_push_fails)
+TEST_FUNCTION(Gateway_AddLink_broker_add_fails)
 {
     //Arrange
     CGatewayLLMocks mocks;
@@ -3434,41 +4147,29 @@ TEST_FUNCTION(Gateway_AddLink_star_2nd_add_push_fails)
 		dummyLoaderInfo,
         NULL
     };
-    GATEWAY_MODULES_ENTRY dummyEntry3 = {
-        "dummy module 3",
-		dummyLoaderInfo,
-        NULL
-    };
 
-    GATEWAY_LINK_ENTRY dummyLink1 = {
-        "*",
+    GATEWAY_LINK_ENTRY dummyLink = {
+        "dummy module",
         "dummy module 2"
     };
-    GATEWAY_LINK_ENTRY dummyLink2 = {
-        "*",
-        "dummy module 3"
-    };
 
     BASEIMPLEMENTATION::VECTOR_push_back(dummyProps->gateway_modules, &dummyEntry2, 1);
-    BASEIMPLEMENTATION::VECTOR_push_back(dummyProps->gateway_modules, &dummyEntry3, 1);
 
     GATEWAY_HANDLE gateway = Gateway_Create(dummyProps);
-
-    GATEWAY_ADD_LINK_RESULT result = Gateway_AddLink(gateway, &dummyLink1);
-
     mocks.ResetAllCalls();
 
     //Act
     STRICT_EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreAllArguments();//Check link
+    STRICT_EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();//Check Source Module.
     STRICT_EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreAllArguments();//Check Sink Module.
-    STRICT_EXPECTED_CALL(mocks, VECTOR_push_back(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1))
-        .IgnoreArgument(1)
-        .IgnoreArgument(2)
-        .SetFailReturn(1); // Add link to links vector
+    STRICT_EXPECTED_CALL(mocks, Broker_AddLink(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments()
+        .SetFailReturn(BROKER_ADD_LINK_ERROR);
 
-    result = Gateway_AddLink(gateway, &dummyLink2);
+     GATEWAY_ADD_LINK_RESULT result = Gateway_AddLink(gateway, &dummyLink);
 
     //Assert
     ASSERT_ARE_EQUAL(GATEWAY_ADD_LINK_RESULT, GATEWAY_ADD_LINK_ERROR, result);
@@ -3480,22 +4181,20 @@ TEST_FUNCTION(Gateway_AddLink_star_2nd_add_push_fails)
 }
 
 //Tests_SRS_GATEWAY_17_003: [ The gateway shall treat a source of "*" as link to the sink module from every other module in gateway. ]
-//Tests_SRS_GATEWAY_17_005: [ For this link, the sink shall receive all messages publish by other modules. ]
-TEST_FUNCTION(Gateway_AddModule_Creates_Module_with_star_links)
+TEST_FUNCTION(Gateway_AddLink_star_2nd_addbroker_fails)
 {
     //Arrange
     CGatewayLLMocks mocks;
 
-
     //Add another entry to the properties
     GATEWAY_MODULES_ENTRY dummyEntry2 = {
         "dummy module 2",
-		dummyLoaderInfo,
+        dummyLoaderInfo,
         NULL
     };
     GATEWAY_MODULES_ENTRY dummyEntry3 = {
         "dummy module 3",
-		dummyLoaderInfo,
+        dummyLoaderInfo,
         NULL
     };
 
@@ -3505,83 +4204,54 @@ TEST_FUNCTION(Gateway_AddModule_Creates_Module_with_star_links)
     };
     GATEWAY_LINK_ENTRY dummyLink2 = {
         "*",
-        "dummy module"
+        "dummy module 3"
     };
 
     BASEIMPLEMENTATION::VECTOR_push_back(dummyProps->gateway_modules, &dummyEntry2, 1);
-    BASEIMPLEMENTATION::VECTOR_push_back(dummyProps->gateway_links, &dummyLink1, 1);
-    BASEIMPLEMENTATION::VECTOR_push_back(dummyProps->gateway_links, &dummyLink2, 1);
+    BASEIMPLEMENTATION::VECTOR_push_back(dummyProps->gateway_modules, &dummyEntry3, 1);
 
     GATEWAY_HANDLE gateway = Gateway_Create(dummyProps);
+
+    GATEWAY_ADD_LINK_RESULT result = Gateway_AddLink(gateway, &dummyLink1);
+
     mocks.ResetAllCalls();
 
-    //Expectations
+    //Act
     STRICT_EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .IgnoreAllArguments();
-    STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG))
-        .IgnoreArgument(1);
-    EXPECTED_CALL(mocks, mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(mocks, DynamicModuleLoader_Load(IGNORED_PTR_ARG, dummyLoaderInfo.entrypoint))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, DynamicModuleLoader_GetModuleApi(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .IgnoreArgument(1)
-        .IgnoreArgument(2);
-	STRICT_EXPECTED_CALL(mocks, DynamicModuleLoader_BuildModuleConfiguration(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-		.IgnoreAllArguments();
-	STRICT_EXPECTED_CALL(mocks, DynamicModuleLoader_FreeModuleConfiguration(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-		.IgnoreArgument(1)
-        .IgnoreArgument(2);
-    STRICT_EXPECTED_CALL(mocks, mock_Module_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .IgnoreArgument(1)
-        .IgnoreArgument(2);
-    STRICT_EXPECTED_CALL(mocks, Broker_AddModule(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .IgnoreArgument(1)
-        .IgnoreArgument(2);
-    STRICT_EXPECTED_CALL(mocks, Broker_IncRef(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
+        .IgnoreAllArguments();//Check link
+    STRICT_EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();//Check Sink Module.
     STRICT_EXPECTED_CALL(mocks, VECTOR_push_back(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1))
         .IgnoreArgument(1)
-        .IgnoreArgument(2);
+        .IgnoreArgument(2); // Add link to links vector
+    STRICT_EXPECTED_CALL(mocks, Broker_AddAnySourceLink(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments()
+        .SetFailReturn(BROKER_ADD_LINK_ERROR);
+
+    //Remove link
     STRICT_EXPECTED_CALL(mocks, VECTOR_back(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    // 1st broadcast link
-    STRICT_EXPECTED_CALL(mocks, VECTOR_element(IGNORED_PTR_ARG, 0))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .IgnoreAllArguments();
-    STRICT_EXPECTED_CALL(mocks, Broker_AddLink(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .IgnoreAllArguments();
-    // 2nd broadcast link
-    STRICT_EXPECTED_CALL(mocks, VECTOR_element(IGNORED_PTR_ARG, 1))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .IgnoreAllArguments();
-    STRICT_EXPECTED_CALL(mocks, Broker_AddLink(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .IgnoreAllArguments();
-    STRICT_EXPECTED_CALL(mocks, EventSystem_ReportEvent(IGNORED_PTR_ARG, gateway, GATEWAY_MODULE_LIST_CHANGED))
-        .IgnoreArgument(1);
-
+    STRICT_EXPECTED_CALL(mocks, VECTOR_erase(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2);
 
-    //Act
-    MODULE_HANDLE handle = Gateway_AddModule(gateway, &dummyEntry3);
+    result = Gateway_AddLink(gateway, &dummyLink2);
 
     //Assert
-    ASSERT_IS_NOT_NULL(handle);
+    ASSERT_ARE_EQUAL(GATEWAY_ADD_LINK_RESULT, GATEWAY_ADD_LINK_ERROR, result);
+
     mocks.AssertActualAndExpectedCalls();
 
     //Cleanup
     Gateway_Destroy(gateway);
 }
 
-//Tests_SRS_GATEWAY_17_003: [ The gateway shall treat a source of "*" as link to the sink module from every other module in gateway. ]
-//Tests_SRS_GATEWAY_17_005: [ For this link, the sink shall receive all messages publish by other modules. ]
-TEST_FUNCTION(Gateway_AddModule_Creates_Module_star_2nd_addLink_fails)
+TEST_FUNCTION(Gateway_AddLink_star_2nd_add_push_fails)
 {
     //Arrange
     CGatewayLLMocks mocks;
 
+    //Add another entry to the properties
     GATEWAY_MODULES_ENTRY dummyEntry2 = {
         "dummy module 2",
 		dummyLoaderInfo,
@@ -3599,104 +4269,33 @@ TEST_FUNCTION(Gateway_AddModule_Creates_Module_star_2nd_addLink_fails)
     };
     GATEWAY_LINK_ENTRY dummyLink2 = {
         "*",
-        "dummy module"
+        "dummy module 3"
     };
 
     BASEIMPLEMENTATION::VECTOR_push_back(dummyProps->gateway_modules, &dummyEntry2, 1);
-    BASEIMPLEMENTATION::VECTOR_push_back(dummyProps->gateway_links, &dummyLink1, 1);
-    BASEIMPLEMENTATION::VECTOR_push_back(dummyProps->gateway_links, &dummyLink2, 1);
+    BASEIMPLEMENTATION::VECTOR_push_back(dummyProps->gateway_modules, &dummyEntry3, 1);
 
     GATEWAY_HANDLE gateway = Gateway_Create(dummyProps);
-    mocks.ResetAllCalls();
 
-    //Expectations
-    STRICT_EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .IgnoreAllArguments();
-    STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG))
-        .IgnoreArgument(1);
-    EXPECTED_CALL(mocks, mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, DynamicModuleLoader_Load(IGNORED_PTR_ARG, dummyLoaderInfo.entrypoint))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, DynamicModuleLoader_GetModuleApi(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .IgnoreArgument(1)
-        .IgnoreArgument(2);
-	STRICT_EXPECTED_CALL(mocks, DynamicModuleLoader_BuildModuleConfiguration(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-		.IgnoreAllArguments();
-	STRICT_EXPECTED_CALL(mocks, DynamicModuleLoader_FreeModuleConfiguration(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-		.IgnoreArgument(1)
-        .IgnoreArgument(2);
-    STRICT_EXPECTED_CALL(mocks, mock_Module_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .IgnoreArgument(1)
-        .IgnoreArgument(2);
-    STRICT_EXPECTED_CALL(mocks, Broker_AddModule(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .IgnoreArgument(1)
-        .IgnoreArgument(2);
-    STRICT_EXPECTED_CALL(mocks, Broker_IncRef(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, VECTOR_push_back(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1))
-        .IgnoreArgument(1)
-        .IgnoreArgument(2);
-    STRICT_EXPECTED_CALL(mocks, VECTOR_back(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    // 1st broadcast link
-    STRICT_EXPECTED_CALL(mocks, VECTOR_element(IGNORED_PTR_ARG, 0))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .IgnoreAllArguments();
-    STRICT_EXPECTED_CALL(mocks, Broker_AddLink(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .IgnoreAllArguments();
-    // 2nd broadcast link
-    STRICT_EXPECTED_CALL(mocks, VECTOR_element(IGNORED_PTR_ARG, 1))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .IgnoreAllArguments();
-    STRICT_EXPECTED_CALL(mocks, Broker_AddLink(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .IgnoreAllArguments()
-        .SetFailReturn(BROKER_ADD_LINK_ERROR);
+    GATEWAY_ADD_LINK_RESULT result = Gateway_AddLink(gateway, &dummyLink1);
 
-    // tear down the star link for each module
-    STRICT_EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG))
-        .IgnoreArgument(1); // for each module.
-    STRICT_EXPECTED_CALL(mocks, VECTOR_element(IGNORED_PTR_ARG, 0))
-        .IgnoreArgument(1);
+    mocks.ResetAllCalls();
+
+    //Act
     STRICT_EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .IgnoreAllArguments();
-    STRICT_EXPECTED_CALL(mocks, Broker_RemoveLink(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .IgnoreAllArguments();
-    STRICT_EXPECTED_CALL(mocks, VECTOR_element(IGNORED_PTR_ARG, 1))
-        .IgnoreArgument(1);
+        .IgnoreAllArguments();//Check link
     STRICT_EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .IgnoreAllArguments();
-    STRICT_EXPECTED_CALL(mocks, Broker_RemoveLink(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .IgnoreAllArguments();
-    // and remove the rest.
-    STRICT_EXPECTED_CALL(mocks, Broker_RemoveModule(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();//Check Sink Module.
+    STRICT_EXPECTED_CALL(mocks, VECTOR_push_back(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1))
         .IgnoreArgument(1)
         .IgnoreArgument(2)
-        .SetFailReturn(BROKER_ERROR);
-    STRICT_EXPECTED_CALL(mocks, Broker_DecRef(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, VECTOR_back(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, VECTOR_erase(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1))
-        .IgnoreArgument(1)
-        .IgnoreArgument(2);
-    EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(mocks, mock_Module_Destroy(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, DynamicModuleLoader_Unload(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .IgnoreArgument(1)
-        .IgnoreArgument(2);
+        .SetFailReturn(1); // Add link to links vector
 
-    //Act
-    MODULE_HANDLE handle = Gateway_AddModule(gateway, &dummyEntry3);
+    result = Gateway_AddLink(gateway, &dummyLink2);
 
     //Assert
-    ASSERT_IS_NULL(handle);
+    ASSERT_ARE_EQUAL(GATEWAY_ADD_LINK_RESULT, GATEWAY_ADD_LINK_ERROR, result);
+
     mocks.AssertActualAndExpectedCalls();
 
     //Cleanup
@@ -3705,19 +4304,20 @@ TEST_FUNCTION(Gateway_AddModule_Creates_Module_star_2nd_addLink_fails)
 
 //Tests_SRS_GATEWAY_17_003: [ The gateway shall treat a source of "*" as link to the sink module from every other module in gateway. ]
 //Tests_SRS_GATEWAY_17_005: [ For this link, the sink shall receive all messages publish by other modules. ]
-TEST_FUNCTION(Gateway_AddModule_Creates_Module_star_2nd_find_fails)
+TEST_FUNCTION(Gateway_AddModule_Creates_Module_with_star_links)
 {
     //Arrange
     CGatewayLLMocks mocks;
 
+    //Add another entry to the properties
     GATEWAY_MODULES_ENTRY dummyEntry2 = {
         "dummy module 2",
-		dummyLoaderInfo,
+        dummyLoaderInfo,
         NULL
     };
     GATEWAY_MODULES_ENTRY dummyEntry3 = {
         "dummy module 3",
-		dummyLoaderInfo,
+        dummyLoaderInfo,
         NULL
     };
 
@@ -3743,87 +4343,38 @@ TEST_FUNCTION(Gateway_AddModule_Creates_Module_star_2nd_find_fails)
     STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG))
         .IgnoreArgument(1);
     EXPECTED_CALL(mocks, mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, DynamicModuleLoader_Load(IGNORED_PTR_ARG, dummyLoaderInfo.entrypoint))
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, DynamicModuleLoader_GetModuleApi(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreArgument(1)
         .IgnoreArgument(2);
-	STRICT_EXPECTED_CALL(mocks, DynamicModuleLoader_BuildModuleConfiguration(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-		.IgnoreAllArguments();
-	STRICT_EXPECTED_CALL(mocks, DynamicModuleLoader_FreeModuleConfiguration(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-		.IgnoreArgument(1)
-        .IgnoreArgument(2);
-    STRICT_EXPECTED_CALL(mocks, mock_Module_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .IgnoreArgument(1)
-        .IgnoreArgument(2);
-    STRICT_EXPECTED_CALL(mocks, Broker_AddModule(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .IgnoreArgument(1)
-        .IgnoreArgument(2);
-    STRICT_EXPECTED_CALL(mocks, Broker_IncRef(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, VECTOR_push_back(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1))
-        .IgnoreArgument(1)
-        .IgnoreArgument(2);
-    STRICT_EXPECTED_CALL(mocks, VECTOR_back(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    // 1st broadcast link
-    STRICT_EXPECTED_CALL(mocks, VECTOR_element(IGNORED_PTR_ARG, 0))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .IgnoreAllArguments();
-    STRICT_EXPECTED_CALL(mocks, Broker_AddLink(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .IgnoreAllArguments();
-    // 2nd broadcast link
-    STRICT_EXPECTED_CALL(mocks, VECTOR_element(IGNORED_PTR_ARG, 1))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .IgnoreAllArguments()
-        .SetFailReturn(nullptr);
-
-
-    // tear down broadcast link.
-    STRICT_EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, VECTOR_element(IGNORED_PTR_ARG, 0))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .IgnoreAllArguments();
-    STRICT_EXPECTED_CALL(mocks, Broker_RemoveLink(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .IgnoreAllArguments()
-        .SetFailReturn(BROKER_REMOVE_LINK_ERROR);
-    STRICT_EXPECTED_CALL(mocks, VECTOR_element(IGNORED_PTR_ARG, 1))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .IgnoreAllArguments();
-    STRICT_EXPECTED_CALL(mocks, Broker_RemoveLink(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(mocks, DynamicModuleLoader_BuildModuleConfiguration(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreAllArguments();
-    // and remove the rest.
-    STRICT_EXPECTED_CALL(mocks, Broker_RemoveModule(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(mocks, DynamicModuleLoader_FreeModuleConfiguration(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreArgument(1)
         .IgnoreArgument(2);
-    STRICT_EXPECTED_CALL(mocks, Broker_DecRef(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, VECTOR_back(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, VECTOR_erase(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1))
+    STRICT_EXPECTED_CALL(mocks, mock_Module_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreArgument(1)
         .IgnoreArgument(2);
-    EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(mocks, mock_Module_Destroy(IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(mocks, Broker_AddModule(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(mocks, Broker_IncRef(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, DynamicModuleLoader_Unload(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(mocks, VECTOR_push_back(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1))
         .IgnoreArgument(1)
         .IgnoreArgument(2);
+    // the broadcast links already reach the new module, nothing to link.
+    STRICT_EXPECTED_CALL(mocks, EventSystem_ReportModuleEvent(IGNORED_PTR_ARG, gateway, GATEWAY_MODULE_ADDED, "dummy module 3"))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, EventSystem_ReportEvent(IGNORED_PTR_ARG, gateway, GATEWAY_MODULE_LIST_CHANGED))
+        .IgnoreArgument(1);
 
     //Act
     MODULE_HANDLE handle = Gateway_AddModule(gateway, &dummyEntry3);
 
     //Assert
-    ASSERT_IS_NULL(handle);
+    ASSERT_IS_NOT_NULL(handle);
     mocks.AssertActualAndExpectedCalls();
 
     //Cleanup
@@ -3876,18 +4427,10 @@ TEST_FUNCTION(Gateway_AddLink_star_success)
     STRICT_EXPECTED_CALL(mocks, VECTOR_push_back(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1))
         .IgnoreArgument(1)
         .IgnoreArgument(2);
-    STRICT_EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, VECTOR_element(IGNORED_PTR_ARG, 0))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, VECTOR_element(IGNORED_PTR_ARG, 1))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, Broker_AddLink(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(mocks, Broker_AddAnySourceLink(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreAllArguments();
-    STRICT_EXPECTED_CALL(mocks, VECTOR_element(IGNORED_PTR_ARG, 2))
+    STRICT_EXPECTED_CALL(mocks, EventSystem_ReportLinkEvent(IGNORED_PTR_ARG, gateway, GATEWAY_LINK_ADDED, &dummyLink2))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, Broker_AddLink(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .IgnoreAllArguments();
     STRICT_EXPECTED_CALL(mocks, EventSystem_ReportEvent(IGNORED_PTR_ARG, IGNORED_PTR_ARG, GATEWAY_MODULE_LIST_CHANGED))
         .IgnoreArgument(1)
         .IgnoreArgument(2);
@@ -3903,7 +4446,6 @@ TEST_FUNCTION(Gateway_AddLink_star_success)
 
     //Cleanup
     Gateway_Destroy(gateway);
-//Tests_SRS_GATEWAY_17_005: [ For this link, the sink shall receive all messages publish by other modules. ]
 }
 
 //Tests_SRS_GATEWAY_17_004: [ The gateway shall accept a link containing "*" as entryLink->module_source, and a valid module name as a entryLink->module_sink. ]
@@ -4002,32 +4544,11 @@ TEST_FUNCTION(Gateway_AddLink_star_failure_to_add)
     STRICT_EXPECTED_CALL(mocks, VECTOR_push_back(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1))
         .IgnoreArgument(1)
         .IgnoreArgument(2);
-    STRICT_EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, VECTOR_element(IGNORED_PTR_ARG, 0))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, VECTOR_element(IGNORED_PTR_ARG, 1))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, Broker_AddLink(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(mocks, Broker_AddAnySourceLink(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreAllArguments()
         .SetFailReturn(BROKER_ADD_LINK_ERROR);
 
     //Remove link
-    STRICT_EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .IgnoreAllArguments();
-    STRICT_EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG))
-        .IgnoreArgument(1); // for each module.
-    STRICT_EXPECTED_CALL(mocks, VECTOR_element(IGNORED_PTR_ARG, 0))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, VECTOR_element(IGNORED_PTR_ARG, 1))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, Broker_RemoveLink(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .IgnoreAllArguments()
-        .SetFailReturn(BROKER_REMOVE_LINK_ERROR);
-    STRICT_EXPECTED_CALL(mocks, VECTOR_element(IGNORED_PTR_ARG, 2))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, Broker_RemoveLink(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .IgnoreAllArguments();
     STRICT_EXPECTED_CALL(mocks, VECTOR_back(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, VECTOR_erase(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1))
@@ -4085,23 +4606,7 @@ TEST_FUNCTION(Gateway_RemoveModule_with_star_links)
     //Expectations
     STRICT_EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, module_handle))
         .IgnoreAllArguments();
-    STRICT_EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    // 1st broadcast link
-    STRICT_EXPECTED_CALL(mocks, VECTOR_element(IGNORED_PTR_ARG, 0))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .IgnoreAllArguments();
-    STRICT_EXPECTED_CALL(mocks, Broker_RemoveLink(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .IgnoreAllArguments();
-    // 2nd broadcast link
-    STRICT_EXPECTED_CALL(mocks, VECTOR_element(IGNORED_PTR_ARG, 1))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .IgnoreAllArguments();
-    STRICT_EXPECTED_CALL(mocks, Broker_RemoveLink(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .IgnoreAllArguments();
-    // and the rest of the remove...
+    // the broadcast links do not depend on the module being removed.
     STRICT_EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreAllArguments();
     EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG));
@@ -4122,6 +4627,8 @@ TEST_FUNCTION(Gateway_RemoveModule_with_star_links)
         .IgnoreArgument(2);
     STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, EventSystem_ReportModuleEvent(IGNORED_PTR_ARG, gateway, GATEWAY_MODULE_REMOVED, "dummy module 3"))
+        .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, EventSystem_ReportEvent(IGNORED_PTR_ARG, gateway, GATEWAY_MODULE_LIST_CHANGED))
         .IgnoreArgument(1);
 
@@ -4136,6 +4643,7 @@ TEST_FUNCTION(Gateway_RemoveModule_with_star_links)
 }
 
 //Tests_SRS_GATEWAY_17_003: [ The gateway shall treat a source of "*" as link to the sink module from every other module in gateway. ]
+/*Tests_SRS_GATEWAY_17_096: [ Once the gateway has its event system, the function shall report `GATEWAY_MODULE_REMOVED` with the name of the module after removing its links. ]*/
 TEST_FUNCTION(Gateway_RemoveModule_with_star_links_has_errors)
 {
     //Arrange
@@ -4169,28 +4677,29 @@ TEST_FUNCTION(Gateway_RemoveModule_with_star_links_has_errors)
     GATEWAY_HANDLE gateway = Gateway_Create(dummyProps);
     auto module_handle = Gateway_AddModule(gateway, &dummyEntry3);
 
+    GATEWAY_LINK_ENTRY dummyLink3 = {
+        "*",
+        "dummy module 3"
+    };
+    (void)Gateway_AddLink(gateway, &dummyLink3);
+
     mocks.ResetAllCalls();
 
     //Expectations
     STRICT_EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, module_handle))
         .IgnoreAllArguments();
-    STRICT_EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    // 1st broadcast link
-    STRICT_EXPECTED_CALL(mocks, VECTOR_element(IGNORED_PTR_ARG, 0))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .IgnoreAllArguments()
-        .SetFailReturn(nullptr);
-    // 2nd broadcast link
-    STRICT_EXPECTED_CALL(mocks, VECTOR_element(IGNORED_PTR_ARG, 1))
-        .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreAllArguments();
     EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(mocks, Broker_RemoveLink(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .IgnoreAllArguments()
+    // the broadcast link to the module
+    STRICT_EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(mocks, Broker_RemoveAnySourceLink(IGNORED_PTR_ARG, module_handle))
+        .IgnoreArgument(1)
         .SetFailReturn(BROKER_REMOVE_LINK_ERROR);
+    STRICT_EXPECTED_CALL(mocks, VECTOR_erase(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2);
     // and the rest of the remove...
     STRICT_EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreAllArguments();
@@ -4211,6 +4720,11 @@ TEST_FUNCTION(Gateway_RemoveModule_with_star_links_has_errors)
         .IgnoreArgument(2);
     STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, EventSystem_ReportLinkEvent(IGNORED_PTR_ARG, gateway, GATEWAY_LINK_REMOVED, IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .IgnoreArgument(4);
+    STRICT_EXPECTED_CALL(mocks, EventSystem_ReportModuleEvent(IGNORED_PTR_ARG, gateway, GATEWAY_MODULE_REMOVED, "dummy module 3"))
+        .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, EventSystem_ReportEvent(IGNORED_PTR_ARG, gateway, GATEWAY_MODULE_LIST_CHANGED))
         .IgnoreArgument(1);
 
@@ -4268,23 +4782,15 @@ TEST_FUNCTION(Gateway_RemoveLink_star_link_success)
         .IgnoreAllArguments();
     STRICT_EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, "dummy module"))
         .IgnoreAllArguments();
-    STRICT_EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG))
-        .IgnoreArgument(1);
-    // 1st broadcast link
-    STRICT_EXPECTED_CALL(mocks, VECTOR_element(IGNORED_PTR_ARG, 0))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, VECTOR_element(IGNORED_PTR_ARG, 1))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, Broker_RemoveLink(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .IgnoreAllArguments();
-    STRICT_EXPECTED_CALL(mocks, VECTOR_element(IGNORED_PTR_ARG, 2))
-        .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(mocks, Broker_RemoveLink(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(mocks, Broker_RemoveAnySourceLink(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreAllArguments()
         .SetFailReturn(BROKER_REMOVE_LINK_ERROR);
     STRICT_EXPECTED_CALL(mocks, VECTOR_erase(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1))
         .IgnoreArgument(1)
         .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(mocks, EventSystem_ReportLinkEvent(IGNORED_PTR_ARG, gateway, GATEWAY_LINK_REMOVED, IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .IgnoreArgument(4);
     STRICT_EXPECTED_CALL(mocks, EventSystem_ReportEvent(IGNORED_PTR_ARG, IGNORED_PTR_ARG, GATEWAY_MODULE_LIST_CHANGED))
         .IgnoreArgument(1)
         .IgnoreArgument(2);
@@ -4347,6 +4853,9 @@ TEST_FUNCTION(Gateway_RemoveLink_nostar_link_success)
     STRICT_EXPECTED_CALL(mocks, VECTOR_erase(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1))
         .IgnoreArgument(1)
         .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(mocks, EventSystem_ReportLinkEvent(IGNORED_PTR_ARG, gateway, GATEWAY_LINK_REMOVED, IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .IgnoreArgument(4);
     STRICT_EXPECTED_CALL(mocks, EventSystem_ReportEvent(IGNORED_PTR_ARG, IGNORED_PTR_ARG, GATEWAY_MODULE_LIST_CHANGED))
         .IgnoreArgument(1)
         .IgnoreArgument(2);
@@ -5025,7 +5534,6 @@ TEST_FUNCTION(Gateway_RemoveModuleByName_success)
     //Expect
     EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .ExpectedTimesExactly(2);
-    EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG));
     EXPECTED_CALL(mocks, Broker_RemoveModule(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
     EXPECTED_CALL(mocks, Broker_DecRef(IGNORED_PTR_ARG));
     EXPECTED_CALL(mocks, DynamicModuleLoader_GetModuleApi(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
@@ -5034,6 +5542,7 @@ TEST_FUNCTION(Gateway_RemoveModuleByName_success)
     EXPECTED_CALL(mocks, DynamicModuleLoader_Unload(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
     EXPECTED_CALL(mocks, VECTOR_erase(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG));
     EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG));
+    EXPECTED_CALL(mocks, EventSystem_ReportModuleEvent(IGNORED_PTR_ARG, IGNORED_PTR_ARG, GATEWAY_MODULE_REMOVED, IGNORED_PTR_ARG));
     EXPECTED_CALL(mocks, EventSystem_ReportEvent(IGNORED_PTR_ARG, IGNORED_PTR_ARG, GATEWAY_MODULE_LIST_CHANGED));
 
     //Act
@@ -5126,6 +5635,8 @@ TEST_FUNCTION(Gateway_AddLink_reports_on_success)
     };
 
     // Expect
+    STRICT_EXPECTED_CALL(mocks, EventSystem_ReportLinkEvent(IGNORED_PTR_ARG, gateway, GATEWAY_LINK_ADDED, &entry))
+        .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, EventSystem_ReportEvent(IGNORED_PTR_ARG, IGNORED_PTR_ARG, GATEWAY_MODULE_LIST_CHANGED))
         .IgnoreArgument(1)
         .IgnoreArgument(2);
@@ -5155,6 +5666,8 @@ TEST_FUNCTION(Gateway_AddLink_no_report_on_fail)
     // Expect
     EXPECTED_CALL(mocks, Broker_AddLink(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .SetFailReturn(BROKER_ADD_LINK_ERROR);
+    STRICT_EXPECTED_CALL(mocks, EventSystem_ReportLinkEvent(IGNORED_PTR_ARG, gateway, GATEWAY_LINK_ADDED, &entry))
+        .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(mocks, EventSystem_ReportEvent(IGNORED_PTR_ARG, IGNORED_PTR_ARG, GATEWAY_MODULE_LIST_CHANGED))
         .IgnoreArgument(1)
         .IgnoreArgument(2)
@@ -5184,6 +5697,9 @@ TEST_FUNCTION(Gateway_RemoveLink_reports)
     mocks.ResetAllCalls();
 
     // Expect
+    STRICT_EXPECTED_CALL(mocks, EventSystem_ReportLinkEvent(IGNORED_PTR_ARG, gateway, GATEWAY_LINK_REMOVED, IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .IgnoreArgument(4);
     STRICT_EXPECTED_CALL(mocks, EventSystem_ReportEvent(IGNORED_PTR_ARG, IGNORED_PTR_ARG, GATEWAY_MODULE_LIST_CHANGED))
         .IgnoreArgument(1)
         .IgnoreArgument(2);
@@ -5279,6 +5795,8 @@ TEST_FUNCTION(Gateway_AddModule_malloc_name_fail)
 //Tests_SRS_GATEWAY_17_010: [ This function shall call Module_Start for every module which defines the start function. ]
 //Tests_SRS_GATEWAY_17_012: [ This function shall report a GATEWAY_STARTED events. ]
 //Tests_SRS_GATEWAY_17_013: [ This function shall return GATEWAY_START_SUCCESS upon completion. ]
+//Tests_SRS_GATEWAY_17_076: [ This function shall start the modules concurrently, on at most GATEWAY_MODULE_THREADS threads including the calling one, and return once all of them were started. ]
+//Tests_SRS_GATEWAY_17_082: [ The first time it is called, this function shall then report a `GATEWAY_STARTUP_REPORTED` event. ]
 TEST_FUNCTION(Gateway_Start_starts_stuff)
 {
     //Arrange
@@ -5332,6 +5850,8 @@ TEST_FUNCTION(Gateway_Start_starts_stuff)
 
     STRICT_EXPECTED_CALL(mocks, EventSystem_ReportEvent(IGNORED_PTR_ARG, gw, GATEWAY_STARTED))
         .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, EventSystem_ReportEvent(IGNORED_PTR_ARG, gw, GATEWAY_STARTUP_REPORTED))
+        .IgnoreArgument(1);
 
     //Act
     auto result = Gateway_Start(gw);
@@ -5361,6 +5881,187 @@ TEST_FUNCTION(Gateway_Start_null_gw_returns_error)
     //Cleanup
 }
 
+//Tests_SRS_GATEWAY_17_082: [ The first time it is called, this function shall then report a `GATEWAY_STARTUP_REPORTED` event. ]
+TEST_FUNCTION(Gateway_Start_reports_startup_only_once)
+{
+    //Arrange
+    CGatewayLLMocks mocks;
+    GATEWAY_HANDLE gw = Gateway_Create(NULL);
+    GATEWAY_MODULES_ENTRY entry = {
+        "Test module",
+        dummyLoaderInfo,
+        NULL
+    };
+    MODULE_HANDLE handle = Gateway_AddModule(gw, &entry);
+    (void)Gateway_Start(gw);
+    mocks.ResetAllCalls();
+
+    STRICT_EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, VECTOR_element(IGNORED_PTR_ARG, 0))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, DynamicModuleLoader_GetModuleApi(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(mocks, mock_Module_Start(handle));
+    STRICT_EXPECTED_CALL(mocks, EventSystem_ReportEvent(IGNORED_PTR_ARG, gw, GATEWAY_STARTED))
+        .IgnoreArgument(1);
+
+    //Act
+    auto result = Gateway_Start(gw);
+
+    //Assert
+    ASSERT_ARE_EQUAL(GATEWAY_START_RESULT, result, GATEWAY_START_SUCCESS);
+    mocks.AssertActualAndExpectedCalls();
+
+    //Cleanup
+    Gateway_Destroy(gw);
+}
+
+//Tests_SRS_GATEWAY_17_083: [ If `gw` is NULL or `Gateway_Start` was never called, the function shall return NULL. ]
+TEST_FUNCTION(Gateway_GetStartupReport_returns_NULL_before_start)
+{
+    //Arrange
+    CGatewayLLMocks mocks;
+    GATEWAY_HANDLE gw = Gateway_Create(dummyProps);
+    mocks.ResetAllCalls();
+
+    //Act
+    char* null_gateway = Gateway_GetStartupReport(NULL);
+    char* not_started = Gateway_GetStartupReport(gw);
+
+    //Assert
+    ASSERT_IS_NULL(null_gateway);
+    ASSERT_IS_NULL(not_started);
+    mocks.AssertActualAndExpectedCalls();
+
+    //Cleanup
+    Gateway_Destroy(gw);
+}
+
+//Tests_SRS_GATEWAY_17_078: [ The function shall take the time each step of adding a module took: loading the module, building its configuration, Module_Create and Broker_AddModule. ]
+//Tests_SRS_GATEWAY_17_081: [ The first time it is called, this function shall take the time starting each module and all of them took, and the time from the start of the gateway creation to the end of the start. ]
+//Tests_SRS_GATEWAY_17_084: [ The function shall return a JSON object with `total_us` and, for every module the first `Gateway_Start` started, the time each step of bringing it up took. ]
+//Tests_SRS_GATEWAY_17_085: [ The JSON object shall have a `critical_path` array of the startup phases in the order they ran, where the phases that create and start the modules name the module that took longest. ]
+//Tests_SRS_GATEWAY_17_087: [ This function shall free `report`. ]
+TEST_FUNCTION(Gateway_GetStartupReport_reports_every_started_module)
+{
+    //Arrange
+    CGatewayLLMocks mocks;
+    GATEWAY_HANDLE gw = Gateway_Create(NULL);
+    GATEWAY_MODULES_ENTRY entry1 = {
+        "Test module1",
+        dummyLoaderInfo,
+        NULL
+    };
+    GATEWAY_MODULES_ENTRY entry2 = {
+        "Test \"module2\"",
+        dummyLoaderInfo,
+        NULL
+    };
+    GATEWAY_MODULES_ENTRY late_entry = {
+        "Late module",
+        dummyLoaderInfo,
+        NULL
+    };
+    (void)Gateway_AddModule(gw, &entry1);
+    (void)Gateway_AddModule(gw, &entry2);
+    (void)Gateway_Start(gw);
+    (void)Gateway_AddModule(gw, &late_entry);
+    mocks.ResetAllCalls();
+
+    /*one object for the report, one per started module and one per phase*/
+    EXPECTED_CALL(mocks, json_value_init_object())
+        .ExpectedTimesExactly(9);
+    EXPECTED_CALL(mocks, json_value_get_object(IGNORED_PTR_ARG))
+        .ExpectedTimesExactly(9);
+    EXPECTED_CALL(mocks, json_value_init_array())
+        .ExpectedTimesExactly(2);
+    EXPECTED_CALL(mocks, json_value_get_array(IGNORED_PTR_ARG))
+        .ExpectedTimesExactly(2);
+    STRICT_EXPECTED_CALL(mocks, json_object_set_value(IGNORED_PTR_ARG, "modules", IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .IgnoreArgument(3);
+    STRICT_EXPECTED_CALL(mocks, json_object_set_value(IGNORED_PTR_ARG, "critical_path", IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .IgnoreArgument(3);
+    EXPECTED_CALL(mocks, json_array_append_value(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .ExpectedTimesExactly(8);
+    /*total_us, seven steps per module, and the time of each phase*/
+    EXPECTED_CALL(mocks, json_object_set_number(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG))
+        .ExpectedTimesExactly(21);
+    STRICT_EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    for (size_t i = 0; i < 3; i++)
+    {
+        STRICT_EXPECTED_CALL(mocks, VECTOR_element(IGNORED_PTR_ARG, i))
+            .IgnoreArgument(1);
+    }
+    STRICT_EXPECTED_CALL(mocks, json_object_set_string(IGNORED_PTR_ARG, "name", "Test module1"))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, json_object_set_string(IGNORED_PTR_ARG, "name", "Test \"module2\""))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, json_object_set_string(IGNORED_PTR_ARG, "phase", "parse_json"))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, json_object_set_string(IGNORED_PTR_ARG, "phase", "load_modules"))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, json_object_set_string(IGNORED_PTR_ARG, "phase", "create_modules"))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, json_object_set_string(IGNORED_PTR_ARG, "module", IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .IgnoreArgument(3);
+    STRICT_EXPECTED_CALL(mocks, json_object_set_string(IGNORED_PTR_ARG, "phase", "add_modules"))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, json_object_set_string(IGNORED_PTR_ARG, "phase", "links"))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, json_object_set_string(IGNORED_PTR_ARG, "phase", "start_modules"))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, json_object_set_string(IGNORED_PTR_ARG, "module", IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .IgnoreArgument(3);
+    STRICT_EXPECTED_CALL(mocks, json_serialize_to_string(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, json_value_free(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, json_free_serialized_string(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+
+    //Act
+    char* report = Gateway_GetStartupReport(gw);
+
+    //Assert
+    ASSERT_IS_NOT_NULL(report);
+    ASSERT_ARE_EQUAL(char_ptr, "[startup report]", report);
+
+    //Cleanup
+    Gateway_DestroyStartupReport(report);
+    mocks.AssertActualAndExpectedCalls();
+    Gateway_Destroy(gw);
+}
+
+//Tests_SRS_GATEWAY_17_086: [ The function shall return NULL if any underlying call fails. ]
+TEST_FUNCTION(Gateway_GetStartupReport_json_fails_returns_NULL)
+{
+    //Arrange
+    CGatewayLLMocks mocks;
+    GATEWAY_HANDLE gw = Gateway_Create(NULL);
+    (void)Gateway_Start(gw);
+    mocks.ResetAllCalls();
+
+    STRICT_EXPECTED_CALL(mocks, json_value_init_object())
+        .SetFailReturn((JSON_Value*)NULL);
+
+    //Act
+    char* report = Gateway_GetStartupReport(gw);
+
+    //Assert
+    ASSERT_IS_NULL(report);
+    mocks.AssertActualAndExpectedCalls();
+
+    //Cleanup
+    Gateway_Destroy(gw);
+}
+
 //Tests_SRS_GATEWAY_17_008: [ When module is found, if the Module_Start function is defined for this module, the Module_Start function shall be called. ]
 TEST_FUNCTION(Gateway_StartModule_starts_module)
 {
@@ -5397,6 +6098,42 @@ TEST_FUNCTION(Gateway_StartModule_starts_module)
     free(properties);
 }
 
+//Tests_SRS_GATEWAY_17_101: [ If the loader of the module did not set parallel_create, the function shall call Module_Start between ModuleLoader_LockModuleCalls and ModuleLoader_UnlockModuleCalls. ]
+TEST_FUNCTION(Gateway_StartModule_starts_module_of_serialized_loader_under_its_lock)
+{
+    //Arrange
+    CGatewayLLMocks mocks;
+
+    GATEWAY_HANDLE gw = Gateway_Create(NULL);
+    bool* properties = (bool*)malloc(sizeof(bool));
+    *properties = true;
+    GATEWAY_MODULES_ENTRY entry = {
+        "Test module",
+        serializedLoaderInfo,
+        properties
+    };
+    MODULE_HANDLE handle = Gateway_AddModule(gw, &entry);
+    mocks.ResetAllCalls();
+
+    STRICT_EXPECTED_CALL(mocks, VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, handle))
+        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(mocks, DynamicModuleLoader_GetModuleApi(&serializedModuleLoader, IGNORED_PTR_ARG))
+        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(mocks, ModuleLoader_LockModuleCalls(&serializedModuleLoader));
+    STRICT_EXPECTED_CALL(mocks, mock_Module_Start(handle));
+    STRICT_EXPECTED_CALL(mocks, ModuleLoader_UnlockModuleCalls(&serializedModuleLoader));
+
+    //Act
+    Gateway_StartModule(gw, handle);
+
+    //Assert
+    mocks.AssertActualAndExpectedCalls();
+
+    //Cleanup
+    Gateway_Destroy(gw);
+    free(properties);
+}
+
 //Tests_SRS_GATEWAY_17_008: [ When module is found, if the Module_Start function is defined for this module, the Module_Start function shall be called. ]
 TEST_FUNCTION(Gateway_StartModule_no_start_for_null_start_func)
 {
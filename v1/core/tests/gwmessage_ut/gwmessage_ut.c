@@ -19,6 +19,7 @@ static TEST_MUTEX_HANDLE g_dllByDll;
 static TEST_MUTEX_HANDLE g_testByTest;
 
 #include "message.h"
+#include "module_memory.h"
 
 static size_t currentmalloc_call;
 static size_t whenShallmalloc_fail;
@@ -271,6 +272,48 @@ static const unsigned char notFail__2Property_2bytes[] =
     '3', '4'
 };
 
+static const unsigned char notFail__v2_2Property_2bytes[] =
+{
+    0xA1, 0x62,             /*header*/
+    0x02,                   /*two properties*/
+    0x01,                   /*key dictionary index 0, "source"*/
+    0x07, 'm','a','p','p','i','n','g',
+    0x08, 't','e','m','p',  /*key of 4 bytes*/
+    0x02, '2','1',
+    0x02,                   /*2 message content size*/
+    '3', '4'
+};
+
+static const unsigned char notFail__v2_2Property_8bytes[] =
+{
+    0xA1, 0x62,             /*header*/
+    0x02,                   /*two properties*/
+    0x01,                   /*key dictionary index 0, "source"*/
+    0x07, 'm','a','p','p','i','n','g',
+    0x08, 't','e','m','p',  /*key of 4 bytes*/
+    0x02, '2','1',
+    0x08,                   /*8 message content size*/
+    0x00, 0x00, 0x00,       /*padding, the content starts at offset 24*/
+    '0','1','2','3','4','5','6','7'
+};
+
+static const unsigned char fail_____v2_unknownKeyIndex[] =
+{
+    0xA1, 0x62,             /*header*/
+    0x01,                   /*one property*/
+    0x7F,                   /*key dictionary index 63*/
+    0x00,
+    0x00                    /*0 message content size*/
+};
+
+static const unsigned char fail_____v2_contentTooShort[] =
+{
+    0xA1, 0x62,             /*header*/
+    0x00,                   /*no properties*/
+    0x03,                   /*3 message content size*/
+    '3', '4'
+};
+
 static const unsigned char fail_____firstByteNot0xA1[] =
 {
     0xA2, 0x60,             /*header - wrong*/
@@ -330,6 +373,25 @@ static const unsigned char fail_whenThereIsOnly1ByteOfcontentSize[] =
     0x00                    /*not enough bytes for contentSize*/
 };
 
+/*the message below has the properties of a message with the properties of notFail__2Property_2bytes*/
+/*once "BleedingEdge" is removed and "source" is set to "mapping"*/
+static const unsigned char notFail__derived_2Property_2bytes[] =
+{
+    0xA1, 0x60,             /*header*/
+    0x00, 0x00, 0x00, 60,   /*size of this array*/
+    0x00, 0x00, 0x00, 0x02, /*two properties*/
+    'A', 'z','u','r','e',' ','I','o','T',' ','G','a','t','e','w','a','y',' ','i','s','\0','a','w','e','s','o','m','e','\0',
+    's','o','u','r','c','e','\0','m','a','p','p','i','n','g','\0',
+    0x00, 0x00, 0x00, 0x02,  /*2 message content size*/
+    '3', '4'
+};
+
+static const char* const parentKeys[] = { "BleedingEdge", "Azure IoT Gateway is" };
+static const char* const parentValues[] = { "rocks", "awesome" };
+static const char* const overrideKeys[] = { "source" };
+static const char* const overrideValues[] = { "mapping" };
+static const char* removedKeys[] = { "BleedingEdge", NULL };
+
 #define TEST_MAP_HANDLE ((MAP_HANDLE)(1))
 #define TEST_CONSTBUFFER_HANDLE ((CONSTBUFFER_HANDLE)2)
 #define TEST_CONSTMAP_HANDLE ((CONSTMAP_HANDLE)3)
@@ -882,8 +944,8 @@ BEGIN_TEST_SUITE(gwmessage_ut)
     }
 
     /*Tests_SRS_MESSAGE_02_010: [Message_Clone shall return messageHandle.]*/
-    /*Tests_SRS_MESSAGE_17_001: [Message_Clone shall clone the CONSTMAP handle.]*/
-    /*Tests_SRS_MESSAGE_17_004: [Message_Clone shall clone the CONSTBUFFER handle]*/
+    /*Tests_SRS_MESSAGE_17_001: [ Message_Clone shall not clone the CONSTMAP handle; the internal ref count of the message covers its properties. ]*/
+    /*Tests_SRS_MESSAGE_17_004: [ Message_Clone shall not clone the CONSTBUFFER handle; the internal ref count of the message covers its content. ]*/
     TEST_FUNCTION(Message_Clone_increments_ref_count_1)
     {
         ///arrange
@@ -891,11 +953,6 @@ BEGIN_TEST_SUITE(gwmessage_ut)
         MESSAGE_HANDLE aMessage = Message_Create(&c);
         umock_c_reset_all_calls();
 
-        STRICT_EXPECTED_CALL(ConstMap_Clone(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(CONSTBUFFER_Clone(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-
         ///act
         MESSAGE_HANDLE r = Message_Clone(aMessage);
 
@@ -917,11 +974,6 @@ BEGIN_TEST_SUITE(gwmessage_ut)
         MESSAGE_HANDLE r = Message_Clone(aMessage);
         umock_c_reset_all_calls();
 
-        STRICT_EXPECTED_CALL(ConstMap_Destroy(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(CONSTBUFFER_Destroy(IGNORED_PTR_ARG))
-            .IgnoreArgument(1);
-
         ///act
         Message_Destroy(r);
 
@@ -1135,6 +1187,81 @@ BEGIN_TEST_SUITE(gwmessage_ut)
         CONSTBUFFER_Destroy(content);
     }
 
+    /*Tests_SRS_MESSAGE_17_056: [ If message is NULL then Message_BorrowProperties shall return NULL. ]*/
+    TEST_FUNCTION(Message_BorrowProperties_with_NULL_message_returns_NULL)
+    {
+        ///arrange
+
+        ///act
+        CONSTMAP_HANDLE properties = Message_BorrowProperties(NULL);
+
+        ///assert
+        ASSERT_IS_NULL(properties);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///cleanup
+    }
+
+    /*Tests_SRS_MESSAGE_17_058: [ Otherwise, Message_BorrowProperties shall return the CONSTMAP handle representing the properties of the message without cloning it. ]*/
+    TEST_FUNCTION(Message_BorrowProperties_returns_the_properties_without_cloning_them)
+    {
+        ///arrange
+        MESSAGE_CONFIG c = { 0, NULL, (MAP_HANDLE)&c };
+        MESSAGE_HANDLE aMessage = Message_Create(&c);
+        CONSTMAP_HANDLE cloned = Message_GetProperties(aMessage);
+        umock_c_reset_all_calls();
+
+        ///act
+        CONSTMAP_HANDLE borrowed = Message_BorrowProperties(aMessage);
+
+        ///assert
+        ASSERT_ARE_EQUAL(void_ptr, cloned, borrowed);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///cleanup
+        ConstMap_Destroy(cloned);
+        Message_Destroy(aMessage);
+    }
+
+    /*Tests_SRS_MESSAGE_17_059: [ If message is NULL then Message_BorrowContentHandle shall return NULL. ]*/
+    TEST_FUNCTION(Message_BorrowContentHandle_with_NULL_message_returns_NULL)
+    {
+        ///arrange
+
+        ///act
+        CONSTBUFFER_HANDLE content = Message_BorrowContentHandle(NULL);
+
+        ///assert
+        ASSERT_IS_NULL(content);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///cleanup
+    }
+
+    /*Tests_SRS_MESSAGE_17_060: [ Otherwise, Message_BorrowContentHandle shall return the CONSTBUFFER_HANDLE representing the message content without cloning it. ]*/
+    TEST_FUNCTION(Message_BorrowContentHandle_returns_the_content_without_cloning_it)
+    {
+        ///arrange
+        char t = '3';
+        MESSAGE_CONFIG c = { sizeof(t), (unsigned char*)&t, (MAP_HANDLE)&c };
+        MESSAGE_HANDLE msg = Message_Create(&c);
+        umock_c_reset_all_calls();
+
+        ///act
+        CONSTBUFFER_HANDLE content = Message_BorrowContentHandle(msg);
+
+        ///assert
+        ASSERT_IS_NOT_NULL(content);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        const CONSTBUFFER * contentBuffer = CONSTBUFFER_GetContent(content);
+        ASSERT_ARE_EQUAL(size_t, 1, contentBuffer->size);
+        ASSERT_ARE_EQUAL(int, 0, memcmp(contentBuffer->buffer, &t, 1));
+
+        ///cleanup
+        Message_Destroy(msg);
+    }
+
     /*Tests_SRS_MESSAGE_02_017: [If message is NULL then Message_Destroy shall do nothing.] */
     TEST_FUNCTION(Message_Destroy_with_NULL_argument_does_nothing)
     {
@@ -1152,8 +1279,8 @@ BEGIN_TEST_SUITE(gwmessage_ut)
 
     /*Tests_SRS_MESSAGE_02_020: [Otherwise, Message_Destroy shall decrement the internal ref count of the message.]*/
     /*Tests_SRS_MESSAGE_02_021: [If the ref count is zero then the allocated resources are freed.]*/
-    /*Tests_SRS_MESSAGE_17_002: [Message_Destroy shall destroy the CONSTMAP properties.]*/
-    /*Tests_SRS_MESSAGE_17_005: [Message_Destroy shall destroy the CONSTBUFFER.]*/
+    /*Tests_SRS_MESSAGE_17_002: [ If the ref count is zero then Message_Destroy shall destroy the CONSTMAP properties. ]*/
+    /*Tests_SRS_MESSAGE_17_005: [ If the ref count is zero then Message_Destroy shall destroy the CONSTBUFFER. ]*/
     TEST_FUNCTION(Message_Destroy_happy_path)
     {
         ///arrange
@@ -1198,7 +1325,7 @@ BEGIN_TEST_SUITE(gwmessage_ut)
 
 
 
-    /*Tests_SRS_MESSAGE_02_023: [ If source is not NULL and and size parameter is smaller than 14 then Message_CreateFromByteArray shall fail and return NULL. ]*/
+    /*Tests_SRS_MESSAGE_02_023: [ If source is not NULL and and size parameter is smaller than 4, or source is a version 1 serialization and size parameter is smaller than 14, then Message_CreateFromByteArray shall fail and return NULL. ]*/
     TEST_FUNCTION(Message_CreateFromByteArray_with_13_size_fails)
     {
         ///arrange
@@ -1481,7 +1608,7 @@ BEGIN_TEST_SUITE(gwmessage_ut)
         Message_Destroy(handle);
     }
 
-    /*Tests_SRS_MESSAGE_02_024: [ If the first two bytes of source are not 0xA1 0x60 then Message_CreateFromByteArray shall fail and return NULL. ]*/
+    /*Tests_SRS_MESSAGE_02_024: [ If the first two bytes of source are neither 0xA1 0x60 nor 0xA1 0x62 then Message_CreateFromByteArray shall fail and return NULL. ]*/
     TEST_FUNCTION(Message_CreateFromByteArray_when_first_byte_is_not_0xA1_fails)
     {
 
@@ -1497,7 +1624,7 @@ BEGIN_TEST_SUITE(gwmessage_ut)
         ///cleanup
     }
 
-    /*Tests_SRS_MESSAGE_02_024: [ If the first two bytes of source are not 0xA1 0x60 then Message_CreateFromByteArray shall fail and return NULL. ]*/
+    /*Tests_SRS_MESSAGE_02_024: [ If the first two bytes of source are neither 0xA1 0x60 nor 0xA1 0x62 then Message_CreateFromByteArray shall fail and return NULL. ]*/
     TEST_FUNCTION(Message_CreateFromByteArray_when_second_byte_is_not_0x60_fails)
     {
 
@@ -2150,4 +2277,814 @@ BEGIN_TEST_SUITE(gwmessage_ut)
         Message_Destroy(messageHandle);
     }
 
+    /*Tests_SRS_MESSAGE_17_020: [ If message, buffer or size is NULL then Message_GetSerialized shall fail and return a non-zero value. ]*/
+    TEST_FUNCTION(Message_GetSerialized_fails_with_NULL_message)
+    {
+        ///arrange
+        const unsigned char* buffer;
+        int32_t size;
+        umock_c_reset_all_calls();
+
+        ///act
+        int result = Message_GetSerialized(NULL, &buffer, &size);
+
+        ///assert
+        ASSERT_ARE_NOT_EQUAL(int, 0, result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    }
+
+    /*Tests_SRS_MESSAGE_17_020: [ If message, buffer or size is NULL then Message_GetSerialized shall fail and return a non-zero value. ]*/
+    TEST_FUNCTION(Message_GetSerialized_fails_with_NULL_buffer_or_size)
+    {
+        ///arrange
+        const unsigned char* buffer;
+        int32_t size;
+        MESSAGE_CONFIG c = { 0, NULL, TEST_MAP_HANDLE };
+        MESSAGE_HANDLE messageHandle = Message_Create(&c);
+        umock_c_reset_all_calls();
+
+        ///act
+        int result1 = Message_GetSerialized(messageHandle, NULL, &size);
+        int result2 = Message_GetSerialized(messageHandle, &buffer, NULL);
+
+        ///assert
+        ASSERT_ARE_NOT_EQUAL(int, 0, result1);
+        ASSERT_ARE_NOT_EQUAL(int, 0, result2);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///cleanup
+        Message_Destroy(messageHandle);
+    }
+
+    /*Tests_SRS_MESSAGE_17_021: [ If the message has already been serialized with version, Message_GetSerialized shall return the cached serialization without serializing the message again. Every version is cached separately. ]*/
+    /*Tests_SRS_MESSAGE_17_022: [ Message_GetSerialized shall compute the serialization size by calling Message_ToByteArray with a NULL buffer. ]*/
+    /*Tests_SRS_MESSAGE_17_023: [ Message_GetSerialized shall allocate memory for the serialization and serialize the message by calling Message_ToByteArray. ]*/
+    /*Tests_SRS_MESSAGE_17_024: [ Message_GetSerialized shall publish the serialization atomically; if another thread published a serialization first, the new serialization shall be freed and the existing one returned. ]*/
+    /*Tests_SRS_MESSAGE_17_026: [ On success, Message_GetSerialized shall set *buffer and *size to the serialized message and return 0. ]*/
+    /*Tests_SRS_MESSAGE_17_019: [ If the ref count is zero then the cached serialized forms shall be freed. ]*/
+    TEST_FUNCTION(Message_GetSerialized_serializes_only_once)
+    {
+        ///arrange
+        MESSAGE_CONFIG c = { 2, (const unsigned char*)"34", TEST_MAP_HANDLE };
+        MESSAGE_HANDLE messageHandle = Message_Create(&c);
+        umock_c_reset_all_calls();
+
+        size_t two = 2;
+        const char* keys[] = { "BleedingEdge", "Azure IoT Gateway is" };
+        const char* values[] = { "rocks", "awesome" };
+        const char* const* *pkeys = (const char* const* *)&keys;
+        const char* const* *pvalues = (const char* const* *)&values;
+
+        const CONSTBUFFER bufferContent = { (const unsigned char*)"34", 2 };
+
+        STRICT_EXPECTED_CALL(ConstMap_GetInternals(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .IgnoreArgument_handle()
+            .CopyOutArgumentBuffer(2, &pkeys, sizeof(char**))
+            .CopyOutArgumentBuffer(3, &pvalues, sizeof(char**))
+            .CopyOutArgumentBuffer(4, &two, sizeof(two));
+        STRICT_EXPECTED_CALL(CONSTBUFFER_GetContent(IGNORED_PTR_ARG))
+            .IgnoreArgument_constbufferHandle()
+            .SetReturn(&bufferContent);
+        STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+            .IgnoreArgument_size();
+        STRICT_EXPECTED_CALL(ConstMap_GetInternals(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .IgnoreArgument_handle()
+            .CopyOutArgumentBuffer(2, &pkeys, sizeof(char**))
+            .CopyOutArgumentBuffer(3, &pvalues, sizeof(char**))
+            .CopyOutArgumentBuffer(4, &two, sizeof(two));
+        STRICT_EXPECTED_CALL(CONSTBUFFER_GetContent(IGNORED_PTR_ARG))
+            .IgnoreArgument_constbufferHandle()
+            .SetReturn(&bufferContent);
+
+        const unsigned char* buffer1;
+        int32_t size1;
+        const unsigned char* buffer2;
+        int32_t size2;
+
+        ///act
+        int result1 = Message_GetSerialized(messageHandle, &buffer1, &size1);
+        int result2 = Message_GetSerialized(messageHandle, &buffer2, &size2);
+
+        ///assert
+        ASSERT_ARE_EQUAL(int, 0, result1);
+        ASSERT_ARE_EQUAL(int, 0, result2);
+        ASSERT_ARE_EQUAL(int32_t, sizeof(notFail__2Property_2bytes), size1);
+        ASSERT_ARE_EQUAL(int, 0, memcmp(buffer1, notFail__2Property_2bytes, size1));
+        ASSERT_ARE_EQUAL(void_ptr, (void*)buffer1, (void*)buffer2);
+        ASSERT_ARE_EQUAL(int32_t, size1, size2);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///cleanup
+        Message_Destroy(messageHandle);
+    }
+
+    /*Tests_SRS_MESSAGE_17_025: [ If any of the above steps fails then Message_GetSerialized shall fail and return a non-zero value. ]*/
+    TEST_FUNCTION(Message_GetSerialized_fails_when_malloc_fails)
+    {
+        ///arrange
+        MESSAGE_CONFIG c = { 0, NULL, TEST_MAP_HANDLE };
+        MESSAGE_HANDLE messageHandle = Message_Create(&c);
+        umock_c_reset_all_calls();
+
+        size_t zero = 0;
+        const CONSTBUFFER bufferContent = { NULL, 0 };
+
+        STRICT_EXPECTED_CALL(ConstMap_GetInternals(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .IgnoreArgument_handle()
+            .IgnoreArgument_keys()
+            .IgnoreArgument_values()
+            .CopyOutArgumentBuffer(4, &zero, sizeof(zero));
+        STRICT_EXPECTED_CALL(CONSTBUFFER_GetContent(IGNORED_PTR_ARG))
+            .IgnoreArgument_constbufferHandle()
+            .SetReturn(&bufferContent);
+        STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+            .IgnoreArgument_size()
+            .SetReturn(NULL);
+
+        const unsigned char* buffer;
+        int32_t size;
+
+        ///act
+        int result = Message_GetSerialized(messageHandle, &buffer, &size);
+
+        ///assert
+        ASSERT_ARE_NOT_EQUAL(int, 0, result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///cleanup
+        Message_Destroy(messageHandle);
+    }
+
+    /*Tests_SRS_MESSAGE_17_043: [ If version is not a supported serialization version then Message_ToByteArrayWithVersion shall fail and return -1. ]*/
+    TEST_FUNCTION(Message_ToByteArrayWithVersion_fails_with_unsupported_version)
+    {
+        ///arrange
+        MESSAGE_CONFIG c = { 2, (const unsigned char*)"34", TEST_MAP_HANDLE };
+        MESSAGE_HANDLE messageHandle = Message_Create(&c);
+        umock_c_reset_all_calls();
+
+        ///act
+        int32_t result0 = Message_ToByteArrayWithVersion(messageHandle, 0, NULL, 0);
+        int32_t result3 = Message_ToByteArrayWithVersion(messageHandle, GATEWAY_MESSAGE_VERSION_MAX + 1, NULL, 0);
+
+        ///assert
+        ASSERT_ARE_EQUAL(int32_t, -1, result0);
+        ASSERT_ARE_EQUAL(int32_t, -1, result3);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///cleanup
+        Message_Destroy(messageHandle);
+    }
+
+    /*Tests_SRS_MESSAGE_17_045: [ For version 2, Message_ToByteArrayWithVersion shall populate the memory with values as indicated in the version 2 implementation details. ]*/
+    /*Tests_SRS_MESSAGE_02_036: [ Otherwise Message_ToByteArray shall succeed, and return the byte array size. ]*/
+    TEST_FUNCTION(Message_ToByteArrayWithVersion_2_with_properties_and_content_happy_path)
+    {
+        ///arrange
+        MESSAGE_CONFIG c = { 2, (const unsigned char*)"34", TEST_MAP_HANDLE };
+        MESSAGE_HANDLE messageHandle = Message_Create(&c);
+        unsigned char buf[sizeof(notFail__v2_2Property_2bytes)];
+        umock_c_reset_all_calls();
+
+        size_t two = 2;
+        const char* keys[] = { "source", "temp" };
+        const char* values[] = { "mapping", "21" };
+        const char* const* *pkeys = (const char* const* *)&keys;
+        const char* const* *pvalues = (const char* const* *)&values;
+
+        const CONSTBUFFER bufferContent = { (const unsigned char*)"34", 2 };
+
+        STRICT_EXPECTED_CALL(ConstMap_GetInternals(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .IgnoreArgument_handle()
+            .CopyOutArgumentBuffer(2, &pkeys, sizeof(char**))
+            .CopyOutArgumentBuffer(3, &pvalues, sizeof(char**))
+            .CopyOutArgumentBuffer(4, &two, sizeof(two));
+        STRICT_EXPECTED_CALL(CONSTBUFFER_GetContent(IGNORED_PTR_ARG))
+            .IgnoreArgument_constbufferHandle()
+            .SetReturn(&bufferContent);
+
+        ///act
+        int32_t nbytes = Message_ToByteArrayWithVersion(messageHandle, GATEWAY_MESSAGE_VERSION_2, buf, sizeof(buf));
+
+        ///assert
+        ASSERT_ARE_EQUAL(int32_t, sizeof(notFail__v2_2Property_2bytes), nbytes);
+        ASSERT_ARE_EQUAL(int, 0, memcmp(buf, notFail__v2_2Property_2bytes, sizeof(buf)));
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///cleanup
+        Message_Destroy(messageHandle);
+    }
+
+    /*Tests_SRS_MESSAGE_17_045: [ For version 2, Message_ToByteArrayWithVersion shall populate the memory with values as indicated in the version 2 implementation details. ]*/
+    TEST_FUNCTION(Message_ToByteArrayWithVersion_2_aligns_content_of_8_bytes)
+    {
+        ///arrange
+        MESSAGE_CONFIG c = { 8, (const unsigned char*)"01234567", TEST_MAP_HANDLE };
+        MESSAGE_HANDLE messageHandle = Message_Create(&c);
+        unsigned char buf[sizeof(notFail__v2_2Property_8bytes)];
+        memset(buf, 0xFF, sizeof(buf));
+        umock_c_reset_all_calls();
+
+        size_t two = 2;
+        const char* keys[] = { "source", "temp" };
+        const char* values[] = { "mapping", "21" };
+        const char* const* *pkeys = (const char* const* *)&keys;
+        const char* const* *pvalues = (const char* const* *)&values;
+
+        const CONSTBUFFER bufferContent = { (const unsigned char*)"01234567", 8 };
+
+        STRICT_EXPECTED_CALL(ConstMap_GetInternals(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .IgnoreArgument_handle()
+            .CopyOutArgumentBuffer(2, &pkeys, sizeof(char**))
+            .CopyOutArgumentBuffer(3, &pvalues, sizeof(char**))
+            .CopyOutArgumentBuffer(4, &two, sizeof(two));
+        STRICT_EXPECTED_CALL(CONSTBUFFER_GetContent(IGNORED_PTR_ARG))
+            .IgnoreArgument_constbufferHandle()
+            .SetReturn(&bufferContent);
+
+        ///act
+        int32_t nbytes = Message_ToByteArrayWithVersion(messageHandle, GATEWAY_MESSAGE_VERSION_2, buf, sizeof(buf));
+
+        ///assert
+        ASSERT_ARE_EQUAL(int32_t, sizeof(notFail__v2_2Property_8bytes), nbytes);
+        ASSERT_ARE_EQUAL(int, 0, memcmp(buf, notFail__v2_2Property_8bytes, sizeof(buf)));
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///cleanup
+        Message_Destroy(messageHandle);
+    }
+
+    /*Tests_SRS_MESSAGE_17_046: [ If the first two bytes of source are 0xA1 0x62 then Message_CreateFromByteArray shall parse source as a version 2 serialization. ]*/
+    /*Tests_SRS_MESSAGE_02_027: [ All the properties of the byte array shall be added to the MAP_HANDLE. ]*/
+    /*Tests_SRS_MESSAGE_02_031: [ Otherwise Message_CreateFromByteArray shall succeed and return a non-NULL handle. ]*/
+    TEST_FUNCTION(Message_CreateFromByteArray_version_2_happy_path)
+    {
+        ///arrange
+        STRICT_EXPECTED_CALL(Map_Create(IGNORED_PTR_ARG))
+            .IgnoreArgument_mapFilterFunc()
+            .SetReturn(TEST_MAP_HANDLE);
+        EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+            .IgnoreAllCalls();
+        STRICT_EXPECTED_CALL(Map_Add(TEST_MAP_HANDLE, "source", "mapping"))
+            .SetReturn(MAP_OK);
+        STRICT_EXPECTED_CALL(Map_Add(TEST_MAP_HANDLE, "temp", "21"))
+            .SetReturn(MAP_OK);
+        STRICT_EXPECTED_CALL(CONSTBUFFER_Create(notFail__v2_2Property_8bytes + 24, 8));
+        STRICT_EXPECTED_CALL(ConstMap_Create(TEST_MAP_HANDLE));
+        STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(Map_Destroy(TEST_MAP_HANDLE));
+
+        ///act
+        MESSAGE_HANDLE handle = Message_CreateFromByteArray(notFail__v2_2Property_8bytes, sizeof(notFail__v2_2Property_8bytes));
+
+        ///assert
+        ASSERT_IS_NOT_NULL(handle);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///cleanup
+        Message_Destroy(handle);
+    }
+
+    /*Tests_SRS_MESSAGE_17_047: [ If a version 2 serialization names a property by an index that is not in the key dictionary then Message_CreateFromByteArray shall fail and return NULL. ]*/
+    TEST_FUNCTION(Message_CreateFromByteArray_version_2_with_unknown_key_index_fails)
+    {
+        ///arrange
+        STRICT_EXPECTED_CALL(Map_Create(IGNORED_PTR_ARG))
+            .IgnoreArgument_mapFilterFunc()
+            .SetReturn(TEST_MAP_HANDLE);
+        STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(Map_Destroy(TEST_MAP_HANDLE));
+
+        ///act
+        MESSAGE_HANDLE handle = Message_CreateFromByteArray(fail_____v2_unknownKeyIndex, sizeof(fail_____v2_unknownKeyIndex));
+
+        ///assert
+        ASSERT_IS_NULL(handle);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    }
+
+    /*Tests_SRS_MESSAGE_17_048: [ If the content of a version 2 serialization does not end exactly at the end of the array then Message_CreateFromByteArray shall fail and return NULL. ]*/
+    TEST_FUNCTION(Message_CreateFromByteArray_version_2_with_short_content_fails)
+    {
+        ///arrange
+        STRICT_EXPECTED_CALL(Map_Create(IGNORED_PTR_ARG))
+            .IgnoreArgument_mapFilterFunc()
+            .SetReturn(TEST_MAP_HANDLE);
+        STRICT_EXPECTED_CALL(Map_Destroy(TEST_MAP_HANDLE));
+
+        ///act
+        MESSAGE_HANDLE handle = Message_CreateFromByteArray(fail_____v2_contentTooShort, sizeof(fail_____v2_contentTooShort));
+
+        ///assert
+        ASSERT_IS_NULL(handle);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    }
+
+    /*Tests_SRS_MESSAGE_17_049: [ If version is not a supported serialization version then Message_GetSerializedWithVersion shall fail and return a non-zero value. ]*/
+    TEST_FUNCTION(Message_GetSerializedWithVersion_fails_with_unsupported_version)
+    {
+        ///arrange
+        MESSAGE_CONFIG c = { 2, (const unsigned char*)"34", TEST_MAP_HANDLE };
+        MESSAGE_HANDLE messageHandle = Message_Create(&c);
+        const unsigned char* buffer;
+        int32_t size;
+        umock_c_reset_all_calls();
+
+        ///act
+        int result = Message_GetSerializedWithVersion(messageHandle, GATEWAY_MESSAGE_VERSION_MAX + 1, &buffer, &size);
+
+        ///assert
+        ASSERT_ARE_NOT_EQUAL(int, 0, result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///cleanup
+        Message_Destroy(messageHandle);
+    }
+
+    /*Tests_SRS_MESSAGE_17_021: [ If the message has already been serialized with version, Message_GetSerialized shall return the cached serialization without serializing the message again. Every version is cached separately. ]*/
+    /*Tests_SRS_MESSAGE_17_050: [ Message_GetSerialized shall behave as Message_GetSerializedWithVersion with version GATEWAY_MESSAGE_VERSION_1. ]*/
+    TEST_FUNCTION(Message_GetSerializedWithVersion_caches_every_version_separately)
+    {
+        ///arrange
+        MESSAGE_CONFIG c = { 2, (const unsigned char*)"34", TEST_MAP_HANDLE };
+        MESSAGE_HANDLE messageHandle = Message_Create(&c);
+        umock_c_reset_all_calls();
+
+        size_t two = 2;
+        const char* keys[] = { "source", "temp" };
+        const char* values[] = { "mapping", "21" };
+        const char* const* *pkeys = (const char* const* *)&keys;
+        const char* const* *pvalues = (const char* const* *)&values;
+
+        const CONSTBUFFER bufferContent = { (const unsigned char*)"34", 2 };
+
+        STRICT_EXPECTED_CALL(ConstMap_GetInternals(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .IgnoreArgument_handle()
+            .CopyOutArgumentBuffer(2, &pkeys, sizeof(char**))
+            .CopyOutArgumentBuffer(3, &pvalues, sizeof(char**))
+            .CopyOutArgumentBuffer(4, &two, sizeof(two));
+        STRICT_EXPECTED_CALL(CONSTBUFFER_GetContent(IGNORED_PTR_ARG))
+            .IgnoreArgument_constbufferHandle()
+            .SetReturn(&bufferContent);
+        STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+            .IgnoreArgument_size();
+        STRICT_EXPECTED_CALL(ConstMap_GetInternals(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .IgnoreArgument_handle()
+            .CopyOutArgumentBuffer(2, &pkeys, sizeof(char**))
+            .CopyOutArgumentBuffer(3, &pvalues, sizeof(char**))
+            .CopyOutArgumentBuffer(4, &two, sizeof(two));
+        STRICT_EXPECTED_CALL(CONSTBUFFER_GetContent(IGNORED_PTR_ARG))
+            .IgnoreArgument_constbufferHandle()
+            .SetReturn(&bufferContent);
+
+        const unsigned char* buffer1;
+        int32_t size1;
+        const unsigned char* buffer2;
+        int32_t size2;
+
+        ///act
+        int result1 = Message_GetSerializedWithVersion(messageHandle, GATEWAY_MESSAGE_VERSION_2, &buffer1, &size1);
+        int result2 = Message_GetSerializedWithVersion(messageHandle, GATEWAY_MESSAGE_VERSION_2, &buffer2, &size2);
+
+        ///assert
+        ASSERT_ARE_EQUAL(int, 0, result1);
+        ASSERT_ARE_EQUAL(int, 0, result2);
+        ASSERT_ARE_EQUAL(int32_t, sizeof(notFail__v2_2Property_2bytes), size1);
+        ASSERT_ARE_EQUAL(int, 0, memcmp(buffer1, notFail__v2_2Property_2bytes, size1));
+        ASSERT_ARE_EQUAL(void_ptr, (void*)buffer1, (void*)buffer2);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///cleanup
+        Message_Destroy(messageHandle);
+    }
+
+    /*creates a message derived from parent that removes "BleedingEdge" and sets "source"*/
+    static MESSAGE_HANDLE create_derived_message(MESSAGE_HANDLE parent)
+    {
+        size_t two = 2;
+        size_t one = 1;
+        const char* const* pParentKeys = parentKeys;
+        const char* const* pParentValues = parentValues;
+        const char* const* pOverrideKeys = overrideKeys;
+        const char* const* pOverrideValues = overrideValues;
+
+        STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+            .IgnoreArgument_size();
+        STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+            .IgnoreArgument_size();
+        STRICT_EXPECTED_CALL(ConstMap_GetInternals(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .IgnoreArgument_handle()
+            .CopyOutArgumentBuffer(2, &pParentKeys, sizeof(pParentKeys))
+            .CopyOutArgumentBuffer(3, &pParentValues, sizeof(pParentValues))
+            .CopyOutArgumentBuffer(4, &two, sizeof(two));
+        STRICT_EXPECTED_CALL(ConstMap_Create(TEST_MAP_HANDLE));
+        STRICT_EXPECTED_CALL(ConstMap_GetInternals(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .IgnoreArgument_handle()
+            .CopyOutArgumentBuffer(2, &pOverrideKeys, sizeof(pOverrideKeys))
+            .CopyOutArgumentBuffer(3, &pOverrideValues, sizeof(pOverrideValues))
+            .CopyOutArgumentBuffer(4, &one, sizeof(one));
+        STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+            .IgnoreArgument_size();
+
+        return Message_CreateDerived(parent, TEST_MAP_HANDLE, removedKeys);
+    }
+
+    /*Tests_SRS_MESSAGE_17_027: [ If parent is NULL then Message_CreateDerived shall fail and return NULL. ]*/
+    TEST_FUNCTION(Message_CreateDerived_with_NULL_parent_fails)
+    {
+        ///arrange
+        umock_c_reset_all_calls();
+
+        ///act
+        MESSAGE_HANDLE derived = Message_CreateDerived(NULL, TEST_MAP_HANDLE, removedKeys);
+
+        ///assert
+        ASSERT_IS_NULL(derived);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    }
+
+    /*Tests_SRS_MESSAGE_17_028: [ On success, Message_CreateDerived shall return a non-NULL handle and set the internal ref count to "1". ]*/
+    /*Tests_SRS_MESSAGE_17_029: [ If overrides is not NULL, Message_CreateDerived shall copy overrides to a readonly CONSTMAP. ]*/
+    /*Tests_SRS_MESSAGE_17_030: [ Message_CreateDerived shall copy the NULL terminated array removedKeys, which may be NULL. ]*/
+    /*Tests_SRS_MESSAGE_17_031: [ Message_CreateDerived shall call Message_Clone on parent and share the content of parent. ]*/
+    TEST_FUNCTION(Message_CreateDerived_happy_path)
+    {
+        ///arrange
+        MESSAGE_CONFIG c = { 2, (const unsigned char*)"34", TEST_MAP_HANDLE };
+        MESSAGE_HANDLE parent = Message_Create(&c);
+        umock_c_reset_all_calls();
+
+        ///act
+        MESSAGE_HANDLE derived = create_derived_message(parent);
+
+        ///assert
+        ASSERT_IS_NOT_NULL(derived);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+        ASSERT_ARE_EQUAL(void_ptr, (void*)Message_GetContent(parent), (void*)Message_GetContent(derived));
+
+        ///cleanup
+        Message_Destroy(derived);
+        Message_Destroy(parent);
+    }
+
+    /*Tests_SRS_MESSAGE_17_032: [ If any of the above steps fails, Message_CreateDerived shall fail and return NULL. ]*/
+    TEST_FUNCTION(Message_CreateDerived_fails_when_ConstMap_Create_fails)
+    {
+        ///arrange
+        MESSAGE_CONFIG c = { 2, (const unsigned char*)"34", TEST_MAP_HANDLE };
+        MESSAGE_HANDLE parent = Message_Create(&c);
+        size_t two = 2;
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+            .IgnoreArgument_size();
+        STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+            .IgnoreArgument_size();
+        STRICT_EXPECTED_CALL(ConstMap_GetInternals(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .IgnoreArgument_handle()
+            .IgnoreArgument_keys()
+            .IgnoreArgument_values()
+            .CopyOutArgumentBuffer(4, &two, sizeof(two));
+        STRICT_EXPECTED_CALL(ConstMap_Create(TEST_MAP_HANDLE))
+            .SetReturn(NULL);
+        STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+
+        ///act
+        MESSAGE_HANDLE derived = Message_CreateDerived(parent, TEST_MAP_HANDLE, removedKeys);
+
+        ///assert
+        ASSERT_IS_NULL(derived);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///cleanup
+        Message_Destroy(parent);
+    }
+
+    /*Tests_SRS_MESSAGE_17_032: [ If any of the above steps fails, Message_CreateDerived shall fail and return NULL. ]*/
+    TEST_FUNCTION(Message_CreateDerived_fails_when_malloc_fails)
+    {
+        ///arrange
+        MESSAGE_CONFIG c = { 2, (const unsigned char*)"34", TEST_MAP_HANDLE };
+        MESSAGE_HANDLE parent = Message_Create(&c);
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+            .IgnoreArgument_size();
+        STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+            .IgnoreArgument_size()
+            .SetReturn(NULL);
+        STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+
+        ///act
+        MESSAGE_HANDLE derived = Message_CreateDerived(parent, TEST_MAP_HANDLE, removedKeys);
+
+        ///assert
+        ASSERT_IS_NULL(derived);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///cleanup
+        Message_Destroy(parent);
+    }
+
+    /*Tests_SRS_MESSAGE_17_038: [ For a derived message, Message_Clone shall only increment the internal ref count. ]*/
+    TEST_FUNCTION(Message_Clone_of_a_derived_message_only_increments_the_ref_count)
+    {
+        ///arrange
+        MESSAGE_CONFIG c = { 2, (const unsigned char*)"34", TEST_MAP_HANDLE };
+        MESSAGE_HANDLE parent = Message_Create(&c);
+        MESSAGE_HANDLE derived = create_derived_message(parent);
+        umock_c_reset_all_calls();
+
+        ///act
+        MESSAGE_HANDLE clone = Message_Clone(derived);
+        Message_Destroy(clone);
+
+        ///assert
+        ASSERT_ARE_EQUAL(void_ptr, derived, clone);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///cleanup
+        Message_Destroy(derived);
+        Message_Destroy(parent);
+    }
+
+    /*Tests_SRS_MESSAGE_17_039: [ If the ref count of a derived message is zero then Message_Destroy shall free the overlay and the property map built for it, and shall call Message_Destroy on the parent message. ]*/
+    TEST_FUNCTION(Message_Destroy_of_a_derived_message_releases_the_parent)
+    {
+        ///arrange
+        MESSAGE_CONFIG c = { 2, (const unsigned char*)"34", TEST_MAP_HANDLE };
+        MESSAGE_HANDLE parent = Message_Create(&c);
+        MESSAGE_HANDLE derived = create_derived_message(parent);
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(ConstMap_Destroy(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+
+        ///act
+        Message_Destroy(derived);
+
+        ///assert
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///cleanup
+        Message_Destroy(parent);
+    }
+
+    /*Tests_SRS_MESSAGE_17_061: [ A new message shall be charged to the current module memory account of the calling thread with the size of the message and of the content it copied. ]*/
+    /*Tests_SRS_MESSAGE_17_062: [ If the ref count is zero then Message_Destroy shall release the charge of the message. ]*/
+    TEST_FUNCTION(Message_Create_charges_the_current_memory_account_until_destroyed)
+    {
+        ///arrange
+        MESSAGE_CONFIG c = { 2, (const unsigned char*)"34", TEST_MAP_HANDLE };
+        MODULE_MEMORY_HANDLE memory = ModuleMemory_Create();
+        MODULE_MEMORY_HANDLE previous = ModuleMemory_SetCurrent(memory);
+
+        ///act
+        MESSAGE_HANDLE message = Message_Create(&c);
+        MESSAGE_HANDLE clone = Message_Clone(message);
+        (void)ModuleMemory_SetCurrent(previous);
+        size_t charged = ModuleMemory_GetLiveBytes(memory);
+        Message_Destroy(clone);
+        size_t charged_after_clone_destroyed = ModuleMemory_GetLiveBytes(memory);
+        Message_Destroy(message);
+
+        ///assert
+        ASSERT_IS_NOT_NULL(message);
+        ASSERT_IS_TRUE(charged > 2);
+        ASSERT_ARE_EQUAL(size_t, charged, charged_after_clone_destroyed);
+        ASSERT_ARE_EQUAL(size_t, 0, ModuleMemory_GetLiveBytes(memory));
+
+        ///cleanup
+        ModuleMemory_DecRef(memory);
+    }
+
+    /*Tests_SRS_MESSAGE_17_033: [ If message or key is NULL then Message_GetProperty shall return NULL. ]*/
+    TEST_FUNCTION(Message_GetProperty_with_NULL_arguments_returns_NULL)
+    {
+        ///arrange
+        umock_c_reset_all_calls();
+
+        ///act
+        const char* result1 = Message_GetProperty(NULL, "source");
+        const char* result2 = Message_GetProperty(TEST_MESSAGE_HANDLE, NULL);
+
+        ///assert
+        ASSERT_IS_NULL(result1);
+        ASSERT_IS_NULL(result2);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    }
+
+    /*Tests_SRS_MESSAGE_17_034: [ If message is a derived message that overrides key, Message_GetProperty shall return the overriding value. ]*/
+    /*Tests_SRS_MESSAGE_17_035: [ Otherwise, if message is a derived message that removes key, Message_GetProperty shall return NULL. ]*/
+    /*Tests_SRS_MESSAGE_17_036: [ Otherwise, if message is a derived message, Message_GetProperty shall look key up in the parent message. ]*/
+    /*Tests_SRS_MESSAGE_17_037: [ Otherwise, Message_GetProperty shall return the value of key from the message properties, or NULL if there is no such property. ]*/
+    TEST_FUNCTION(Message_GetProperty_resolves_through_the_overlay)
+    {
+        ///arrange
+        MESSAGE_CONFIG c = { 2, (const unsigned char*)"34", TEST_MAP_HANDLE };
+        MESSAGE_HANDLE parent = Message_Create(&c);
+        MESSAGE_HANDLE derived = create_derived_message(parent);
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(ConstMap_GetValue(IGNORED_PTR_ARG, "Azure IoT Gateway is"))
+            .IgnoreArgument_handle()
+            .SetReturn("awesome");
+
+        ///act
+        const char* overridden = Message_GetProperty(derived, "source");
+        const char* removed = Message_GetProperty(derived, "BleedingEdge");
+        const char* inherited = Message_GetProperty(derived, "Azure IoT Gateway is");
+
+        ///assert
+        ASSERT_ARE_EQUAL(char_ptr, "mapping", overridden);
+        ASSERT_IS_NULL(removed);
+        ASSERT_ARE_EQUAL(char_ptr, "awesome", inherited);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///cleanup
+        Message_Destroy(derived);
+        Message_Destroy(parent);
+    }
+
+    /*Tests_SRS_MESSAGE_17_042: [ For a derived message, Message_ToByteArray shall serialize the properties of the parent message that are neither overridden nor removed, followed by the overrides. ]*/
+    TEST_FUNCTION(Message_ToByteArray_of_a_derived_message_happy_path)
+    {
+        ///arrange
+        MESSAGE_CONFIG c = { 2, (const unsigned char*)"34", TEST_MAP_HANDLE };
+        MESSAGE_HANDLE parent = Message_Create(&c);
+        MESSAGE_HANDLE derived = create_derived_message(parent);
+        unsigned char buf[sizeof(notFail__derived_2Property_2bytes)];
+        size_t two = 2;
+        const char* const* pParentKeys = parentKeys;
+        const char* const* pParentValues = parentValues;
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+            .IgnoreArgument_size();
+        STRICT_EXPECTED_CALL(ConstMap_GetInternals(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .IgnoreArgument_handle()
+            .CopyOutArgumentBuffer(2, &pParentKeys, sizeof(pParentKeys))
+            .CopyOutArgumentBuffer(3, &pParentValues, sizeof(pParentValues))
+            .CopyOutArgumentBuffer(4, &two, sizeof(two));
+        STRICT_EXPECTED_CALL(CONSTBUFFER_GetContent(IGNORED_PTR_ARG))
+            .IgnoreArgument_constbufferHandle();
+        STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+
+        ///act
+        int32_t nbytes = Message_ToByteArray(derived, buf, sizeof(buf));
+
+        ///assert
+        ASSERT_ARE_EQUAL(int32_t, sizeof(notFail__derived_2Property_2bytes), nbytes);
+        ASSERT_ARE_EQUAL(int, 0, memcmp(buf, notFail__derived_2Property_2bytes, sizeof(buf)));
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///cleanup
+        Message_Destroy(derived);
+        Message_Destroy(parent);
+    }
+
+    /*Tests_SRS_MESSAGE_17_041: [ Message_GetProperties shall build the property map of a derived message only once. ]*/
+    TEST_FUNCTION(Message_GetProperties_of_a_derived_message_builds_the_map_once)
+    {
+        ///arrange
+        MESSAGE_CONFIG c = { 2, (const unsigned char*)"34", TEST_MAP_HANDLE };
+        MESSAGE_HANDLE parent = Message_Create(&c);
+        MESSAGE_HANDLE derived = create_derived_message(parent);
+        size_t two = 2;
+        const char* const* pParentKeys = parentKeys;
+        const char* const* pParentValues = parentValues;
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+            .IgnoreArgument_size();
+        STRICT_EXPECTED_CALL(ConstMap_GetInternals(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .IgnoreArgument_handle()
+            .CopyOutArgumentBuffer(2, &pParentKeys, sizeof(pParentKeys))
+            .CopyOutArgumentBuffer(3, &pParentValues, sizeof(pParentValues))
+            .CopyOutArgumentBuffer(4, &two, sizeof(two));
+        STRICT_EXPECTED_CALL(Map_Create(IGNORED_PTR_ARG))
+            .IgnoreArgument_mapFilterFunc()
+            .SetReturn(TEST_MAP_HANDLE);
+        STRICT_EXPECTED_CALL(Map_Add(TEST_MAP_HANDLE, "Azure IoT Gateway is", "awesome"));
+        STRICT_EXPECTED_CALL(Map_Add(TEST_MAP_HANDLE, "source", "mapping"));
+        STRICT_EXPECTED_CALL(ConstMap_Create(TEST_MAP_HANDLE));
+        STRICT_EXPECTED_CALL(Map_Destroy(TEST_MAP_HANDLE));
+        STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(ConstMap_Clone(IGNORED_PTR_ARG))
+            .IgnoreArgument_handle();
+        STRICT_EXPECTED_CALL(ConstMap_Clone(IGNORED_PTR_ARG))
+            .IgnoreArgument_handle();
+
+        ///act
+        CONSTMAP_HANDLE properties1 = Message_GetProperties(derived);
+        CONSTMAP_HANDLE properties2 = Message_GetProperties(derived);
+
+        ///assert
+        ASSERT_IS_NOT_NULL(properties1);
+        ASSERT_ARE_EQUAL(void_ptr, properties1, properties2);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///cleanup
+        ConstMap_Destroy(properties1);
+        ConstMap_Destroy(properties2);
+        Message_Destroy(derived);
+        Message_Destroy(parent);
+    }
+
+    /*Tests_SRS_MESSAGE_17_057: [ For a derived message, Message_BorrowProperties shall build the property map as Message_GetProperties does, and return NULL if that fails. ]*/
+    TEST_FUNCTION(Message_BorrowProperties_of_a_derived_message_builds_the_properties_without_cloning_them)
+    {
+        ///arrange
+        MESSAGE_CONFIG c = { 2, (const unsigned char*)"34", TEST_MAP_HANDLE };
+        MESSAGE_HANDLE parent = Message_Create(&c);
+        MESSAGE_HANDLE derived = create_derived_message(parent);
+        size_t two = 2;
+        const char* const* pParentKeys = parentKeys;
+        const char* const* pParentValues = parentValues;
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+            .IgnoreArgument_size();
+        STRICT_EXPECTED_CALL(ConstMap_GetInternals(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .IgnoreArgument_handle()
+            .CopyOutArgumentBuffer(2, &pParentKeys, sizeof(pParentKeys))
+            .CopyOutArgumentBuffer(3, &pParentValues, sizeof(pParentValues))
+            .CopyOutArgumentBuffer(4, &two, sizeof(two));
+        STRICT_EXPECTED_CALL(Map_Create(IGNORED_PTR_ARG))
+            .IgnoreArgument_mapFilterFunc()
+            .SetReturn(TEST_MAP_HANDLE);
+        STRICT_EXPECTED_CALL(Map_Add(TEST_MAP_HANDLE, "Azure IoT Gateway is", "awesome"));
+        STRICT_EXPECTED_CALL(Map_Add(TEST_MAP_HANDLE, "source", "mapping"));
+        STRICT_EXPECTED_CALL(ConstMap_Create(TEST_MAP_HANDLE));
+        STRICT_EXPECTED_CALL(Map_Destroy(TEST_MAP_HANDLE));
+        STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+
+        ///act
+        CONSTMAP_HANDLE properties1 = Message_BorrowProperties(derived);
+        CONSTMAP_HANDLE properties2 = Message_BorrowProperties(derived);
+
+        ///assert
+        ASSERT_IS_NOT_NULL(properties1);
+        ASSERT_ARE_EQUAL(void_ptr, properties1, properties2);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///cleanup
+        Message_Destroy(derived);
+        Message_Destroy(parent);
+    }
+
+    /*Tests_SRS_MESSAGE_17_040: [ If building the property map of a derived message fails, Message_GetProperties shall return NULL. ]*/
+    TEST_FUNCTION(Message_GetProperties_of_a_derived_message_fails_when_Map_Create_fails)
+    {
+        ///arrange
+        MESSAGE_CONFIG c = { 2, (const unsigned char*)"34", TEST_MAP_HANDLE };
+        MESSAGE_HANDLE parent = Message_Create(&c);
+        MESSAGE_HANDLE derived = create_derived_message(parent);
+        size_t two = 2;
+        const char* const* pParentKeys = parentKeys;
+        const char* const* pParentValues = parentValues;
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+            .IgnoreArgument_size();
+        STRICT_EXPECTED_CALL(ConstMap_GetInternals(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .IgnoreArgument_handle()
+            .CopyOutArgumentBuffer(2, &pParentKeys, sizeof(pParentKeys))
+            .CopyOutArgumentBuffer(3, &pParentValues, sizeof(pParentValues))
+            .CopyOutArgumentBuffer(4, &two, sizeof(two));
+        STRICT_EXPECTED_CALL(Map_Create(IGNORED_PTR_ARG))
+            .IgnoreArgument_mapFilterFunc()
+            .SetReturn(NULL);
+        STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+
+        ///act
+        CONSTMAP_HANDLE properties = Message_GetProperties(derived);
+
+        ///assert
+        ASSERT_IS_NULL(properties);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///cleanup
+        Message_Destroy(derived);
+        Message_Destroy(parent);
+    }
+
 END_TEST_SUITE(gwmessage_ut)
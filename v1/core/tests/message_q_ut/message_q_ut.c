@@ -48,6 +48,8 @@ void my_gballoc_free(void* ptr)
 #include "message.h"
 #include "azure_c_shared_utility/doublylinkedlist.h"
 #include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/lock.h"
+#include "azure_c_shared_utility/condition.h"
 
 #undef ENABLE_MOCKS
 
@@ -125,6 +127,15 @@ void real_DList_InsertHeadList(PDLIST_ENTRY listHead, PDLIST_ENTRY entry)
 static TEST_MUTEX_HANDLE g_dllByDll;
 static TEST_MUTEX_HANDLE g_testByTest;
 
+static MESSAGE_HANDLE drained_messages[8];
+static size_t drained_count;
+
+static void record_drained_message(void* context, MESSAGE_HANDLE message)
+{
+	ASSERT_IS_TRUE(context == (void*)&drained_count);
+	drained_messages[drained_count++] = message;
+}
+
 void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
 {
     (void)error_code;
@@ -147,6 +158,10 @@ TEST_SUITE_INITIALIZE(TestClassInitialize)
 	REGISTER_UMOCK_ALIAS_TYPE(MESSAGE_HANDLE, void*);
 	REGISTER_UMOCK_ALIAS_TYPE(PDLIST_ENTRY, void *);
 	REGISTER_UMOCK_ALIAS_TYPE(const PDLIST_ENTRY, const void*);
+	REGISTER_UMOCK_ALIAS_TYPE(LOCK_HANDLE, void*);
+	REGISTER_UMOCK_ALIAS_TYPE(LOCK_RESULT, int);
+	REGISTER_UMOCK_ALIAS_TYPE(COND_HANDLE, void*);
+	REGISTER_UMOCK_ALIAS_TYPE(COND_RESULT, int);
 
 	// malloc/free hooks
 	REGISTER_GLOBAL_MOCK_HOOK(gballoc_malloc, my_gballoc_malloc);
@@ -160,6 +175,15 @@ TEST_SUITE_INITIALIZE(TestClassInitialize)
 	REGISTER_GLOBAL_MOCK_HOOK(DList_AppendTailList, real_DList_AppendTailList);
 	REGISTER_GLOBAL_MOCK_HOOK(DList_RemoveEntryList, real_DList_RemoveEntryList);
 	REGISTER_GLOBAL_MOCK_HOOK(DList_RemoveHeadList, real_DList_RemoveHeadList);
+
+	// lock and condition for bounded queues
+	REGISTER_GLOBAL_MOCK_RETURN(Lock_Init, (LOCK_HANDLE)0x4242);
+	REGISTER_GLOBAL_MOCK_RETURN(Lock, LOCK_OK);
+	REGISTER_GLOBAL_MOCK_RETURN(Unlock, LOCK_OK);
+	REGISTER_GLOBAL_MOCK_RETURN(Lock_Deinit, LOCK_OK);
+	REGISTER_GLOBAL_MOCK_RETURN(Condition_Init, (COND_HANDLE)0x4343);
+	REGISTER_GLOBAL_MOCK_RETURN(Condition_Post, COND_OK);
+	REGISTER_GLOBAL_MOCK_RETURN(Condition_Wait, COND_TIMEOUT);
 }
 
 TEST_SUITE_CLEANUP(TestClassCleanup)
@@ -181,6 +205,7 @@ TEST_FUNCTION_INITIALIZE(TestMethodInitialize)
 	malloc_will_fail = false;
 	malloc_fail_count = 0;
 	malloc_count = 0;
+	drained_count = 0;
 }
 
 TEST_FUNCTION_CLEANUP(TestMethodCleanup)
@@ -567,10 +592,547 @@ TEST_FUNCTION(MESSAGE_QUEUE_front_returns_null_empty_queue)
 	MESSAGE_QUEUE_destroy(mq);
 }
 
+/*Tests_SRS_MESSAGE_QUEUE_17_023: [ If capacity is zero or too large to be rounded up to a power of two, MESSAGE_QUEUE_create_bounded shall fail and return NULL. ]*/
+TEST_FUNCTION(MESSAGE_QUEUE_create_bounded_zero_capacity_fails)
+{
+	///arrange
+	///act
+	MESSAGE_QUEUE_HANDLE mq = MESSAGE_QUEUE_create_bounded(0);
+
+	///assert
+	ASSERT_IS_NULL(mq);
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+	///ablutions
+}
+
+/*Tests_SRS_MESSAGE_QUEUE_17_024: [ MESSAGE_QUEUE_create_bounded shall allocate all the slots of the queue up front, rounding capacity up to a power of two of at least 2. ]*/
+/*Tests_SRS_MESSAGE_QUEUE_17_025: [ MESSAGE_QUEUE_create_bounded shall create a lock and a condition for MESSAGE_QUEUE_pop_wait. ]*/
+/*Tests_SRS_MESSAGE_QUEUE_17_027: [ On success, MESSAGE_QUEUE_create_bounded shall return a non-NULL handle to an empty message queue. ]*/
+TEST_FUNCTION(MESSAGE_QUEUE_create_bounded_success)
+{
+	///arrange
+	STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Lock_Init());
+	STRICT_EXPECTED_CALL(Condition_Init());
+
+	///act
+	MESSAGE_QUEUE_HANDLE mq = MESSAGE_QUEUE_create_bounded(3);
+
+	///assert
+	ASSERT_IS_NOT_NULL(mq);
+	ASSERT_IS_TRUE(MESSAGE_QUEUE_is_empty(mq));
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+	///ablutions
+	MESSAGE_QUEUE_destroy(mq);
+}
+
+/*Tests_SRS_MESSAGE_QUEUE_17_026: [ If any of the above steps fails, MESSAGE_QUEUE_create_bounded shall free all allocated resources and return NULL. ]*/
+TEST_FUNCTION(MESSAGE_QUEUE_create_bounded_fails)
+{
+	///arrange
+	int result = 0;
+	result = umock_c_negative_tests_init();
+	ASSERT_ARE_EQUAL(int, 0, result);
+
+	STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+		.IgnoreArgument(1)
+		.SetFailReturn(NULL);
+	STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+		.IgnoreArgument(1)
+		.SetFailReturn(NULL);
+	STRICT_EXPECTED_CALL(Lock_Init())
+		.SetFailReturn(NULL);
+	STRICT_EXPECTED_CALL(Condition_Init())
+		.SetFailReturn(NULL);
+	umock_c_negative_tests_snapshot();
+
+	for (size_t i = 0; i < umock_c_negative_tests_call_count(); i++)
+	{
+		umock_c_negative_tests_reset();
+		umock_c_negative_tests_fail_call(i);
+
+		///act
+		MESSAGE_QUEUE_HANDLE mq = MESSAGE_QUEUE_create_bounded(4);
+
+		///assert
+		ASSERT_IS_NULL(mq);
+	}
+
+	///ablutions
+	umock_c_negative_tests_deinit();
+}
+
+/*Tests_SRS_MESSAGE_QUEUE_17_028: [ If a bounded message queue already holds capacity messages, MESSAGE_QUEUE_push shall return MESSAGE_QUEUE_FULL without taking ownership of element. ]*/
+TEST_FUNCTION(MESSAGE_QUEUE_push_bounded_full_returns_full)
+{
+	///arrange
+	MESSAGE_QUEUE_HANDLE mq = MESSAGE_QUEUE_create_bounded(2);
+	ASSERT_ARE_EQUAL(int, 0, MESSAGE_QUEUE_push(mq, (MESSAGE_HANDLE)0x42));
+	ASSERT_ARE_EQUAL(int, 0, MESSAGE_QUEUE_push(mq, (MESSAGE_HANDLE)0x43));
+	umock_c_reset_all_calls();
+
+	///act
+	int result = MESSAGE_QUEUE_push(mq, (MESSAGE_HANDLE)0x44);
+
+	///assert
+	ASSERT_ARE_EQUAL(int, MESSAGE_QUEUE_FULL, result);
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+	///ablutions
+	(void)MESSAGE_QUEUE_pop(mq);
+	(void)MESSAGE_QUEUE_pop(mq);
+	MESSAGE_QUEUE_destroy(mq);
+}
+
+/*Tests_SRS_MESSAGE_QUEUE_17_024: [ MESSAGE_QUEUE_create_bounded shall allocate all the slots of the queue up front, rounding capacity up to a power of two of at least 2. ]*/
+/*Tests_SRS_MESSAGE_QUEUE_17_028: [ If a bounded message queue already holds capacity messages, MESSAGE_QUEUE_push shall return MESSAGE_QUEUE_FULL without taking ownership of element. ]*/
+TEST_FUNCTION(MESSAGE_QUEUE_push_bounded_capacity_one_returns_full_without_losing_messages)
+{
+	///arrange
+	MESSAGE_QUEUE_HANDLE mq = MESSAGE_QUEUE_create_bounded(1);
+	ASSERT_IS_NOT_NULL(mq);
+	umock_c_reset_all_calls();
+
+	///act
+	int result;
+	size_t pushed = 0;
+	while ((result = MESSAGE_QUEUE_push(mq, (MESSAGE_HANDLE)(0x42 + pushed))) == 0)
+	{
+		pushed++;
+		ASSERT_IS_TRUE(pushed <= 2);
+	}
+
+	///assert
+	ASSERT_ARE_EQUAL(int, MESSAGE_QUEUE_FULL, result);
+	ASSERT_IS_TRUE(MESSAGE_QUEUE_pop(mq) == (MESSAGE_HANDLE)0x42);
+	for (size_t i = 1; i < pushed; i++)
+	{
+		ASSERT_IS_TRUE(MESSAGE_QUEUE_pop(mq) == (MESSAGE_HANDLE)(0x42 + i));
+	}
+	ASSERT_IS_NULL(MESSAGE_QUEUE_pop(mq));
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+	///ablutions
+	MESSAGE_QUEUE_destroy(mq);
+}
+
+/*Tests_SRS_MESSAGE_QUEUE_17_011: [ Messages shall be pushed into the queue in a first-in-first-out order. ]*/
+/*Tests_SRS_MESSAGE_QUEUE_17_014: [ MESSAGE_QUEUE_pop shall remove messages from the queue in a first-in-first-out order. ]*/
+TEST_FUNCTION(MESSAGE_QUEUE_pop_bounded_is_fifo_across_laps)
+{
+	///arrange
+	MESSAGE_QUEUE_HANDLE mq = MESSAGE_QUEUE_create_bounded(2);
+	umock_c_reset_all_calls();
+
+	///act
+	for (size_t i = 1; i <= 5; i++)
+	{
+		ASSERT_ARE_EQUAL(int, 0, MESSAGE_QUEUE_push(mq, (MESSAGE_HANDLE)(0x40 + i)));
+		ASSERT_ARE_EQUAL(int, 0, MESSAGE_QUEUE_push(mq, (MESSAGE_HANDLE)(0x80 + i)));
+		ASSERT_IS_TRUE(MESSAGE_QUEUE_front(mq) == (MESSAGE_HANDLE)(0x40 + i));
+		ASSERT_IS_TRUE(MESSAGE_QUEUE_pop(mq) == (MESSAGE_HANDLE)(0x40 + i));
+		ASSERT_IS_TRUE(MESSAGE_QUEUE_pop(mq) == (MESSAGE_HANDLE)(0x80 + i));
+	}
+
+	///assert
+	ASSERT_IS_TRUE(MESSAGE_QUEUE_is_empty(mq));
+	ASSERT_IS_NULL(MESSAGE_QUEUE_pop(mq));
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+	///ablutions
+	MESSAGE_QUEUE_destroy(mq);
+}
+
+/*Tests_SRS_MESSAGE_QUEUE_17_030: [ MESSAGE_QUEUE_pop_wait shall return NULL on a NULL message queue. ]*/
+TEST_FUNCTION(MESSAGE_QUEUE_pop_wait_returns_null_with_null)
+{
+	///arrange
+	///act
+	MESSAGE_HANDLE mh = MESSAGE_QUEUE_pop_wait(NULL, 10);
+
+	///assert
+	ASSERT_IS_NULL(mh);
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+	///ablutions
+}
+
+/*Tests_SRS_MESSAGE_QUEUE_17_031: [ If the message queue is not empty, MESSAGE_QUEUE_pop_wait shall behave as MESSAGE_QUEUE_pop without waiting. ]*/
+TEST_FUNCTION(MESSAGE_QUEUE_pop_wait_non_empty_does_not_wait)
+{
+	///arrange
+	MESSAGE_QUEUE_HANDLE mq = MESSAGE_QUEUE_create_bounded(4);
+	MESSAGE_QUEUE_push(mq, (MESSAGE_HANDLE)0x42);
+	umock_c_reset_all_calls();
+
+	///act
+	MESSAGE_HANDLE mh = MESSAGE_QUEUE_pop_wait(mq, 10);
+
+	///assert
+	ASSERT_IS_TRUE(mh == (MESSAGE_HANDLE)0x42);
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+	///ablutions
+	MESSAGE_QUEUE_destroy(mq);
+}
+
+/*Tests_SRS_MESSAGE_QUEUE_17_032: [ If a bounded message queue is empty, MESSAGE_QUEUE_pop_wait shall wait on its condition for at most timeout_ms milliseconds, or until a message is pushed if timeout_ms is zero. ]*/
+/*Tests_SRS_MESSAGE_QUEUE_17_033: [ After waiting, MESSAGE_QUEUE_pop_wait shall return the oldest message in the queue, or NULL if the queue is still empty. ]*/
+TEST_FUNCTION(MESSAGE_QUEUE_pop_wait_empty_waits_for_timeout)
+{
+	///arrange
+	MESSAGE_QUEUE_HANDLE mq = MESSAGE_QUEUE_create_bounded(4);
+	umock_c_reset_all_calls();
+
+	STRICT_EXPECTED_CALL(Lock((LOCK_HANDLE)0x4242));
+	STRICT_EXPECTED_CALL(Condition_Wait((COND_HANDLE)0x4343, (LOCK_HANDLE)0x4242, 10));
+	STRICT_EXPECTED_CALL(Unlock((LOCK_HANDLE)0x4242));
+
+	///act
+	MESSAGE_HANDLE mh = MESSAGE_QUEUE_pop_wait(mq, 10);
+
+	///assert
+	ASSERT_IS_NULL(mh);
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+	///ablutions
+	MESSAGE_QUEUE_destroy(mq);
+}
+
+/*Tests_SRS_MESSAGE_QUEUE_17_034: [ MESSAGE_QUEUE_pop_wait shall not wait on a message queue created by MESSAGE_QUEUE_create. ]*/
+TEST_FUNCTION(MESSAGE_QUEUE_pop_wait_unbounded_does_not_wait)
+{
+	///arrange
+	MESSAGE_QUEUE_HANDLE mq = MESSAGE_QUEUE_create();
+	umock_c_reset_all_calls();
+
+	STRICT_EXPECTED_CALL(DList_IsListEmpty(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+
+	///act
+	MESSAGE_HANDLE mh = MESSAGE_QUEUE_pop_wait(mq, 10);
+
+	///assert
+	ASSERT_IS_NULL(mh);
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+	///ablutions
+	MESSAGE_QUEUE_destroy(mq);
+}
+
+/*Tests_SRS_MESSAGE_QUEUE_17_005: [ If the message queue is not empty, MESSAGE_QUEUE_destroy shall destroy all messages in the queue. ]*/
+/*Tests_SRS_MESSAGE_QUEUE_17_006: [ MESSAGE_QUEUE_destroy shall free all allocated resources. ]*/
+TEST_FUNCTION(MESSAGE_QUEUE_destroy_bounded_frees_everything)
+{
+	///arrange
+	MESSAGE_QUEUE_HANDLE mq = MESSAGE_QUEUE_create_bounded(4);
+	MESSAGE_QUEUE_push(mq, (MESSAGE_HANDLE)0x42);
+	umock_c_reset_all_calls();
+
+	STRICT_EXPECTED_CALL(Message_Destroy((MESSAGE_HANDLE)0x42));
+	STRICT_EXPECTED_CALL(Condition_Deinit((COND_HANDLE)0x4343));
+	STRICT_EXPECTED_CALL(Lock_Deinit((LOCK_HANDLE)0x4242));
+	STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+
+	///act
+	MESSAGE_QUEUE_destroy(mq);
+
+	///assert
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+	///ablutions
+}
+
+/*Tests_SRS_MESSAGE_QUEUE_17_035: [ MESSAGE_QUEUE_push_many shall return a non-zero value if handle or elements are NULL, or if any of the count elements is NULL. ]*/
+TEST_FUNCTION(MESSAGE_QUEUE_push_many_null_handle_fails)
+{
+	///arrange
+	MESSAGE_HANDLE elements[1] = { (MESSAGE_HANDLE)0x42 };
+
+	///act
+	int result = MESSAGE_QUEUE_push_many(NULL, elements, 1);
+
+	///assert
+	ASSERT_ARE_NOT_EQUAL(int, 0, result);
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+	///ablutions
+}
+
+/*Tests_SRS_MESSAGE_QUEUE_17_035: [ MESSAGE_QUEUE_push_many shall return a non-zero value if handle or elements are NULL, or if any of the count elements is NULL. ]*/
+TEST_FUNCTION(MESSAGE_QUEUE_push_many_null_element_fails)
+{
+	///arrange
+	MESSAGE_HANDLE elements[2] = { (MESSAGE_HANDLE)0x42, NULL };
+	MESSAGE_QUEUE_HANDLE mq = MESSAGE_QUEUE_create();
+	umock_c_reset_all_calls();
+
+	///act
+	int result = MESSAGE_QUEUE_push_many(mq, elements, 2);
+
+	///assert
+	ASSERT_ARE_NOT_EQUAL(int, 0, result);
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+	///ablutions
+	MESSAGE_QUEUE_destroy(mq);
+}
+
+/*Tests_SRS_MESSAGE_QUEUE_17_036: [ MESSAGE_QUEUE_push_many shall push all count elements onto the queue in order, such that no other message pushed concurrently is placed between them. ]*/
+/*Tests_SRS_MESSAGE_QUEUE_17_041: [ MESSAGE_QUEUE_push_many shall return zero on success. ]*/
+TEST_FUNCTION(MESSAGE_QUEUE_push_many_appends_batch_in_order)
+{
+	///arrange
+	MESSAGE_HANDLE elements[2] = { (MESSAGE_HANDLE)0x43, (MESSAGE_HANDLE)0x44 };
+	MESSAGE_QUEUE_HANDLE mq = MESSAGE_QUEUE_create();
+	MESSAGE_QUEUE_push(mq, (MESSAGE_HANDLE)0x42);
+	umock_c_reset_all_calls();
+
+	STRICT_EXPECTED_CALL(DList_InitializeListHead(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(DList_InsertTailList(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+		.IgnoreArgument(1)
+		.IgnoreArgument(2);
+	STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(DList_InsertTailList(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+		.IgnoreArgument(1)
+		.IgnoreArgument(2);
+	STRICT_EXPECTED_CALL(DList_RemoveEntryList(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(DList_AppendTailList(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+		.IgnoreArgument(1)
+		.IgnoreArgument(2);
+
+	///act
+	int result = MESSAGE_QUEUE_push_many(mq, elements, 2);
+
+	///assert
+	ASSERT_ARE_EQUAL(int, 0, result);
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+	ASSERT_IS_TRUE(MESSAGE_QUEUE_pop(mq) == (MESSAGE_HANDLE)0x42);
+	ASSERT_IS_TRUE(MESSAGE_QUEUE_pop(mq) == (MESSAGE_HANDLE)0x43);
+	ASSERT_IS_TRUE(MESSAGE_QUEUE_pop(mq) == (MESSAGE_HANDLE)0x44);
+	ASSERT_IS_TRUE(MESSAGE_QUEUE_is_empty(mq));
+
+	///ablutions
+	MESSAGE_QUEUE_destroy(mq);
+}
+
+/*Tests_SRS_MESSAGE_QUEUE_17_037: [ If any system call fails, MESSAGE_QUEUE_push_many shall leave the queue unchanged and return a non-zero value. ]*/
+TEST_FUNCTION(MESSAGE_QUEUE_push_many_malloc_fails_leaves_queue_unchanged)
+{
+	///arrange
+	MESSAGE_HANDLE elements[2] = { (MESSAGE_HANDLE)0x43, (MESSAGE_HANDLE)0x44 };
+	MESSAGE_QUEUE_HANDLE mq = MESSAGE_QUEUE_create();
+	umock_c_reset_all_calls();
+	malloc_will_fail = true;
+	malloc_fail_count = 2;
+	malloc_count = 0;
+
+	STRICT_EXPECTED_CALL(DList_InitializeListHead(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(DList_InsertTailList(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+		.IgnoreArgument(1)
+		.IgnoreArgument(2);
+	STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(DList_IsListEmpty(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(DList_RemoveHeadList(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(DList_IsListEmpty(IGNORED_PTR_ARG))
+		.IgnoreArgument(1);
+
+	///act
+	int result = MESSAGE_QUEUE_push_many(mq, elements, 2);
+
+	///assert
+	ASSERT_ARE_NOT_EQUAL(int, 0, result);
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+	ASSERT_IS_TRUE(MESSAGE_QUEUE_is_empty(mq));
+
+	///ablutions
+	MESSAGE_QUEUE_destroy(mq);
+}
+
+/*Tests_SRS_MESSAGE_QUEUE_17_038: [ If a bounded message queue does not have count free slots, MESSAGE_QUEUE_push_many shall return MESSAGE_QUEUE_FULL without taking ownership of any element. ]*/
+TEST_FUNCTION(MESSAGE_QUEUE_push_many_bounded_without_room_returns_full)
+{
+	///arrange
+	MESSAGE_HANDLE elements[2] = { (MESSAGE_HANDLE)0x43, (MESSAGE_HANDLE)0x44 };
+	MESSAGE_QUEUE_HANDLE mq = MESSAGE_QUEUE_create_bounded(2);
+	MESSAGE_QUEUE_push(mq, (MESSAGE_HANDLE)0x42);
+	umock_c_reset_all_calls();
+
+	///act
+	int result = MESSAGE_QUEUE_push_many(mq, elements, 2);
+
+	///assert
+	ASSERT_ARE_EQUAL(int, MESSAGE_QUEUE_FULL, result);
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+	ASSERT_IS_TRUE(MESSAGE_QUEUE_pop(mq) == (MESSAGE_HANDLE)0x42);
+	ASSERT_IS_TRUE(MESSAGE_QUEUE_is_empty(mq));
+
+	///ablutions
+	MESSAGE_QUEUE_destroy(mq);
+}
+
+/*Tests_SRS_MESSAGE_QUEUE_17_036: [ MESSAGE_QUEUE_push_many shall push all count elements onto the queue in order, such that no other message pushed concurrently is placed between them. ]*/
+TEST_FUNCTION(MESSAGE_QUEUE_push_many_bounded_success)
+{
+	///arrange
+	MESSAGE_HANDLE elements[3] = { (MESSAGE_HANDLE)0x43, (MESSAGE_HANDLE)0x44, (MESSAGE_HANDLE)0x45 };
+	MESSAGE_QUEUE_HANDLE mq = MESSAGE_QUEUE_create_bounded(4);
+	MESSAGE_QUEUE_push(mq, (MESSAGE_HANDLE)0x42);
+	umock_c_reset_all_calls();
+
+	///act
+	int result = MESSAGE_QUEUE_push_many(mq, elements, 3);
+
+	///assert
+	ASSERT_ARE_EQUAL(int, 0, result);
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+	ASSERT_IS_TRUE(MESSAGE_QUEUE_pop(mq) == (MESSAGE_HANDLE)0x42);
+	ASSERT_IS_TRUE(MESSAGE_QUEUE_pop(mq) == (MESSAGE_HANDLE)0x43);
+	ASSERT_IS_TRUE(MESSAGE_QUEUE_pop(mq) == (MESSAGE_HANDLE)0x44);
+	ASSERT_IS_TRUE(MESSAGE_QUEUE_pop(mq) == (MESSAGE_HANDLE)0x45);
+
+	///ablutions
+	MESSAGE_QUEUE_destroy(mq);
+}
+
+/*Tests_SRS_MESSAGE_QUEUE_17_042: [ MESSAGE_QUEUE_pop_batch shall return zero if handle or messages are NULL. ]*/
+TEST_FUNCTION(MESSAGE_QUEUE_pop_batch_null_handle_returns_zero)
+{
+	///arrange
+	MESSAGE_HANDLE messages[2];
+
+	///act
+	size_t result = MESSAGE_QUEUE_pop_batch(NULL, messages, 2);
+
+	///assert
+	ASSERT_ARE_EQUAL(size_t, 0, result);
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+	///ablutions
+}
+
+/*Tests_SRS_MESSAGE_QUEUE_17_043: [ MESSAGE_QUEUE_pop_batch shall remove up to max messages from the queue in first-in-first-out order and store them in messages. ]*/
+/*Tests_SRS_MESSAGE_QUEUE_17_044: [ MESSAGE_QUEUE_pop_batch shall return the number of messages stored in messages. ]*/
+/*Tests_SRS_MESSAGE_QUEUE_17_045: [ MESSAGE_QUEUE_pop_batch shall not wait for messages. ]*/
+TEST_FUNCTION(MESSAGE_QUEUE_pop_batch_pops_up_to_max)
+{
+	///arrange
+	MESSAGE_HANDLE messages[2];
+	MESSAGE_QUEUE_HANDLE mq = MESSAGE_QUEUE_create_bounded(4);
+	MESSAGE_QUEUE_push(mq, (MESSAGE_HANDLE)0x42);
+	MESSAGE_QUEUE_push(mq, (MESSAGE_HANDLE)0x43);
+	MESSAGE_QUEUE_push(mq, (MESSAGE_HANDLE)0x44);
+	umock_c_reset_all_calls();
+
+	///act
+	size_t first = MESSAGE_QUEUE_pop_batch(mq, messages, 2);
+
+	///assert
+	ASSERT_ARE_EQUAL(size_t, 2, first);
+	ASSERT_IS_TRUE(messages[0] == (MESSAGE_HANDLE)0x42);
+	ASSERT_IS_TRUE(messages[1] == (MESSAGE_HANDLE)0x43);
+
+	size_t second = MESSAGE_QUEUE_pop_batch(mq, messages, 2);
+	ASSERT_ARE_EQUAL(size_t, 1, second);
+	ASSERT_IS_TRUE(messages[0] == (MESSAGE_HANDLE)0x44);
+	ASSERT_ARE_EQUAL(size_t, 0, MESSAGE_QUEUE_pop_batch(mq, messages, 2));
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+	///ablutions
+	MESSAGE_QUEUE_destroy(mq);
+}
+
+/*Tests_SRS_MESSAGE_QUEUE_17_046: [ MESSAGE_QUEUE_drain shall return zero if handle or callback are NULL. ]*/
+TEST_FUNCTION(MESSAGE_QUEUE_drain_null_callback_returns_zero)
+{
+	///arrange
+	MESSAGE_QUEUE_HANDLE mq = MESSAGE_QUEUE_create();
+	MESSAGE_QUEUE_push(mq, (MESSAGE_HANDLE)0x42);
+	umock_c_reset_all_calls();
+
+	///act
+	size_t result = MESSAGE_QUEUE_drain(mq, NULL, NULL);
+
+	///assert
+	ASSERT_ARE_EQUAL(size_t, 0, result);
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+	///ablutions
+	MESSAGE_QUEUE_destroy(mq);
+}
+
+/*Tests_SRS_MESSAGE_QUEUE_17_047: [ MESSAGE_QUEUE_drain shall remove every message that was on the queue when it was called and pass each to callback, in first-in-first-out order, along with context. ]*/
+/*Tests_SRS_MESSAGE_QUEUE_17_048: [ MESSAGE_QUEUE_drain shall transfer ownership of each message to callback. ]*/
+/*Tests_SRS_MESSAGE_QUEUE_17_049: [ MESSAGE_QUEUE_drain shall return the number of messages passed to callback. ]*/
+TEST_FUNCTION(MESSAGE_QUEUE_drain_unbounded_empties_queue_in_order)
+{
+	///arrange
+	MESSAGE_QUEUE_HANDLE mq = MESSAGE_QUEUE_create();
+	MESSAGE_QUEUE_push(mq, (MESSAGE_HANDLE)0x42);
+	MESSAGE_QUEUE_push(mq, (MESSAGE_HANDLE)0x43);
+	umock_c_reset_all_calls();
+
+	///act
+	size_t result = MESSAGE_QUEUE_drain(mq, record_drained_message, &drained_count);
+
+	///assert
+	ASSERT_ARE_EQUAL(size_t, 2, result);
+	ASSERT_ARE_EQUAL(size_t, 2, drained_count);
+	ASSERT_IS_TRUE(drained_messages[0] == (MESSAGE_HANDLE)0x42);
+	ASSERT_IS_TRUE(drained_messages[1] == (MESSAGE_HANDLE)0x43);
+	ASSERT_IS_TRUE(MESSAGE_QUEUE_is_empty(mq));
+
+	///ablutions
+	MESSAGE_QUEUE_destroy(mq);
+}
+
+/*Tests_SRS_MESSAGE_QUEUE_17_047: [ MESSAGE_QUEUE_drain shall remove every message that was on the queue when it was called and pass each to callback, in first-in-first-out order, along with context. ]*/
+/*Tests_SRS_MESSAGE_QUEUE_17_049: [ MESSAGE_QUEUE_drain shall return the number of messages passed to callback. ]*/
+TEST_FUNCTION(MESSAGE_QUEUE_drain_bounded_empties_queue_in_order)
+{
+	///arrange
+	MESSAGE_QUEUE_HANDLE mq = MESSAGE_QUEUE_create_bounded(2);
+	MESSAGE_QUEUE_push(mq, (MESSAGE_HANDLE)0x42);
+	MESSAGE_QUEUE_push(mq, (MESSAGE_HANDLE)0x43);
+	umock_c_reset_all_calls();
+
+	///act
+	size_t result = MESSAGE_QUEUE_drain(mq, record_drained_message, &drained_count);
+
+	///assert
+	ASSERT_ARE_EQUAL(size_t, 2, result);
+	ASSERT_IS_TRUE(drained_messages[0] == (MESSAGE_HANDLE)0x42);
+	ASSERT_IS_TRUE(drained_messages[1] == (MESSAGE_HANDLE)0x43);
+	ASSERT_IS_TRUE(MESSAGE_QUEUE_is_empty(mq));
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+	///ablutions
+	MESSAGE_QUEUE_destroy(mq);
+}
+
 ///arrange
 ///act
 ///assert
 ///ablutions
 END_TEST_SUITE(message_q_ut);
-
-
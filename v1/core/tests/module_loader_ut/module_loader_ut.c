@@ -71,6 +71,7 @@ MOCKABLE_FUNCTION(, JSON_Value_Type, json_value_get_type, const JSON_Value*, val
 static const size_t g_enabled_loaders[] =
 {
     1       // native loader
+    , 1     // static loader
 #ifdef NODE_BINDING_ENABLED
     , 1
 #endif
@@ -90,6 +91,9 @@ static const size_t g_enabled_loaders[] =
 
 static const size_t LOADERS_COUNT = sizeof(g_enabled_loaders) / sizeof(g_enabled_loaders[0]);
 
+// NATIVE_STATIC is the last value of MODULE_LOADER_TYPE_VALUES
+static const size_t LOADER_TYPES_COUNT = NATIVE_STATIC + 1;
+
 //=============================================================================
 //Globals
 //=============================================================================
@@ -108,9 +112,12 @@ LOCK_HANDLE my_Lock_Init(void)
     return (LOCK_HANDLE)my_gballoc_malloc(1);
 }
 
+static LOCK_HANDLE last_locked;
+
 LOCK_RESULT my_Lock(LOCK_HANDLE handle)
 {
     LOCK_RESULT result = LOCK_ERROR;
+    last_locked = handle;
     if (handle != NULL)
     {
         result = LOCK_OK;
@@ -206,6 +213,28 @@ extern "C"
 #endif
 MOCK_FUNCTION_WITH_CODE(, const MODULE_LOADER*, DynamicLoader_Get)
 MOCK_FUNCTION_END(&Dynamic_Module_Loader)
+MOCK_FUNCTION_WITH_CODE(, MODULE_LOADER_RESULT, DynamicLoader_Initialize)
+MOCK_FUNCTION_END(MODULE_LOADER_SUCCESS)
+MOCK_FUNCTION_WITH_CODE(, void, DynamicLoader_Deinitialize)
+MOCK_FUNCTION_END()
+#ifdef __cplusplus
+}
+#endif
+
+static MODULE_LOADER Static_Module_Loader =
+{
+    NATIVE_STATIC,
+    "static",
+    NULL,
+    &Fake_Module_Loader_API
+};
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+MOCK_FUNCTION_WITH_CODE(, const MODULE_LOADER*, StaticLoader_Get)
+MOCK_FUNCTION_END(&Static_Module_Loader)
 #ifdef __cplusplus
 }
 #endif
@@ -486,6 +515,13 @@ TEST_FUNCTION(ModuleLoader_Initialize_returns_MODULE_LOADER_ERROR_when_things_fa
         .SetFailReturn(LOCK_ERROR);
     STRICT_EXPECTED_CALL(VECTOR_create(sizeof(MODULE_LOADER*)))
         .SetFailReturn(NULL);
+    for (size_t i = 0; i < LOADER_TYPES_COUNT; i++)
+    {
+        STRICT_EXPECTED_CALL(Lock_Init())
+            .SetFailReturn(NULL);
+    }
+    STRICT_EXPECTED_CALL(DynamicLoader_Initialize())
+        .SetFailReturn(MODULE_LOADER_ERROR);
     STRICT_EXPECTED_CALL(VECTOR_push_back(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1))
         .IgnoreArgument(1)
         .IgnoreArgument(2)
@@ -514,6 +550,8 @@ TEST_FUNCTION(ModuleLoader_Initialize_returns_MODULE_LOADER_ERROR_when_things_fa
 // Tests_SRS_MODULE_LOADER_13_004: [ ModuleLoader_Initialize shall initialize g_module.module_loaders by calling VECTOR_create. ]
 // Tests_SRS_MODULE_LOADER_13_005: [ ModuleLoader_Initialize shall add the default support module loaders to g_module.module_loaders. ]
 // Tests_SRS_MODULE_LOADER_13_007: [ ModuleLoader_Initialize shall unlock g_module.lock. ]
+// Tests_SRS_MODULE_LOADER_17_012: [ ModuleLoader_Initialize shall initialize a lock for each module loader type. ]
+// Tests_SRS_MODULE_LOADER_17_019: [ ModuleLoader_Initialize shall call DynamicLoader_Initialize before adding the default loaders. ]
 // Tests_SRS_MODULE_LOADER_13_006: [ ModuleLoader_Initialize shall return MODULE_LOADER_SUCCESS once all the default loaders have been added successfully. ]
 TEST_FUNCTION(ModuleLoader_Initialize_succeeds)
 {
@@ -522,7 +560,13 @@ TEST_FUNCTION(ModuleLoader_Initialize_succeeds)
     STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(VECTOR_create(sizeof(MODULE_LOADER*)));
+    for (size_t i = 0; i < LOADER_TYPES_COUNT; i++)
+    {
+        STRICT_EXPECTED_CALL(Lock_Init());
+    }
+    STRICT_EXPECTED_CALL(DynamicLoader_Initialize());
 	STRICT_EXPECTED_CALL(DynamicLoader_Get());
+    STRICT_EXPECTED_CALL(StaticLoader_Get());
 #ifdef NODE_BINDING_ENABLED
     STRICT_EXPECTED_CALL(NodeLoader_Get());
 #endif
@@ -1062,8 +1106,12 @@ TEST_FUNCTION(ModuleLoader_FindByName_succeeds)
 }
 
 // Tests_SRS_MODULE_LOADER_13_045: [ ModuleLoader_Destroy shall free g_module_loaders.lock if it is not NULL. ]
-TEST_FUNCTION(ModuleLoader_Destroy_does_nothing_when_not_initialized)
+// Tests_SRS_MODULE_LOADER_17_020: [ ModuleLoader_Destroy shall call DynamicLoader_Deinitialize. ]
+TEST_FUNCTION(ModuleLoader_Destroy_only_deinitializes_the_dynamic_loader_when_not_initialized)
 {
+    // arrange
+    STRICT_EXPECTED_CALL(DynamicLoader_Deinitialize());
+
     // act
     ModuleLoader_Destroy();
 
@@ -1073,6 +1121,8 @@ TEST_FUNCTION(ModuleLoader_Destroy_does_nothing_when_not_initialized)
 
 // Tests_SRS_MODULE_LOADER_13_046: [ ModuleLoader_Destroy shall invoke FreeConfiguration on every module loader's configuration field. ]
 // Tests_SRS_MODULE_LOADER_13_048: [ ModuleLoader_Destroy shall destroy the loaders vector. ]
+// Tests_SRS_MODULE_LOADER_17_013: [ ModuleLoader_Destroy shall free the lock of every module loader type that is not NULL. ]
+// Tests_SRS_MODULE_LOADER_17_020: [ ModuleLoader_Destroy shall call DynamicLoader_Deinitialize. ]
 TEST_FUNCTION(ModuleLoader_Destroy_frees_resources)
 {
     // arrange
@@ -1096,6 +1146,12 @@ TEST_FUNCTION(ModuleLoader_Destroy_frees_resources)
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(Lock_Deinit(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
+    for (size_t i = 0; i < LOADER_TYPES_COUNT; i++)
+    {
+        STRICT_EXPECTED_CALL(Lock_Deinit(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+    }
+    STRICT_EXPECTED_CALL(DynamicLoader_Deinitialize());
 
     // act
     ModuleLoader_Destroy();
@@ -1154,6 +1210,12 @@ TEST_FUNCTION(ModuleLoader_Destroy_frees_resources_with_non_default_loaders)
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(Lock_Deinit(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
+    for (size_t i = 0; i < LOADER_TYPES_COUNT; i++)
+    {
+        STRICT_EXPECTED_CALL(Lock_Deinit(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+    }
+    STRICT_EXPECTED_CALL(DynamicLoader_Deinitialize());
 
     // act
     ModuleLoader_Destroy();
@@ -1162,6 +1224,118 @@ TEST_FUNCTION(ModuleLoader_Destroy_frees_resources_with_non_default_loaders)
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 }
 
+// Tests_SRS_MODULE_LOADER_17_014: [ ModuleLoader_LockModuleCalls shall return MODULE_LOADER_ERROR if loader is NULL, its type is out of range or the loaders are not initialized. ]
+TEST_FUNCTION(ModuleLoader_LockModuleCalls_returns_error_when_loader_is_NULL)
+{
+    // arrange
+    MODULE_LOADER_RESULT init_result = ModuleLoader_Initialize();
+    ASSERT_ARE_EQUAL(MODULE_LOADER_RESULT, MODULE_LOADER_SUCCESS, init_result);
+    umock_c_reset_all_calls();
+
+    // act
+    MODULE_LOADER_RESULT result = ModuleLoader_LockModuleCalls(NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(MODULE_LOADER_RESULT, MODULE_LOADER_ERROR, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    ModuleLoader_Destroy();
+}
+
+// Tests_SRS_MODULE_LOADER_17_014: [ ModuleLoader_LockModuleCalls shall return MODULE_LOADER_ERROR if loader is NULL, its type is out of range or the loaders are not initialized. ]
+TEST_FUNCTION(ModuleLoader_LockModuleCalls_returns_error_when_not_initialized)
+{
+    // act
+    MODULE_LOADER_RESULT result = ModuleLoader_LockModuleCalls(&Java_Module_Loader);
+
+    // assert
+    ASSERT_ARE_EQUAL(MODULE_LOADER_RESULT, MODULE_LOADER_ERROR, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+// Tests_SRS_MODULE_LOADER_17_015: [ ModuleLoader_LockModuleCalls shall acquire the lock of the type of loader and return MODULE_LOADER_SUCCESS. ]
+// Tests_SRS_MODULE_LOADER_17_018: [ ModuleLoader_UnlockModuleCalls shall release the lock of the type of loader. ]
+TEST_FUNCTION(ModuleLoader_LockModuleCalls_locks_the_lock_of_the_loader_type)
+{
+    // arrange
+    MODULE_LOADER_RESULT init_result = ModuleLoader_Initialize();
+    ASSERT_ARE_EQUAL(MODULE_LOADER_RESULT, MODULE_LOADER_SUCCESS, init_result);
+    MODULE_LOADER other_java_loader = Java_Module_Loader;
+    other_java_loader.name = "other java";
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+
+    // act
+    MODULE_LOADER_RESULT java_result = ModuleLoader_LockModuleCalls(&Java_Module_Loader);
+    LOCK_HANDLE java_lock = last_locked;
+    ModuleLoader_UnlockModuleCalls(&Java_Module_Loader);
+    MODULE_LOADER_RESULT other_java_result = ModuleLoader_LockModuleCalls(&other_java_loader);
+    LOCK_HANDLE other_java_lock = last_locked;
+    ModuleLoader_UnlockModuleCalls(&other_java_loader);
+    MODULE_LOADER_RESULT node_result = ModuleLoader_LockModuleCalls(&Node_Module_Loader);
+    LOCK_HANDLE node_lock = last_locked;
+    ModuleLoader_UnlockModuleCalls(&Node_Module_Loader);
+
+    // assert
+    ASSERT_ARE_EQUAL(MODULE_LOADER_RESULT, MODULE_LOADER_SUCCESS, java_result);
+    ASSERT_ARE_EQUAL(MODULE_LOADER_RESULT, MODULE_LOADER_SUCCESS, other_java_result);
+    ASSERT_ARE_EQUAL(MODULE_LOADER_RESULT, MODULE_LOADER_SUCCESS, node_result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    // loaders of one type share their lock, other types have their own
+    ASSERT_ARE_EQUAL(void_ptr, java_lock, other_java_lock);
+    ASSERT_ARE_NOT_EQUAL(void_ptr, java_lock, node_lock);
+
+    // cleanup
+    ModuleLoader_Destroy();
+}
+
+// Tests_SRS_MODULE_LOADER_17_016: [ ModuleLoader_LockModuleCalls shall return MODULE_LOADER_ERROR if the lock cannot be acquired. ]
+TEST_FUNCTION(ModuleLoader_LockModuleCalls_returns_error_when_Lock_fails)
+{
+    // arrange
+    MODULE_LOADER_RESULT init_result = ModuleLoader_Initialize();
+    ASSERT_ARE_EQUAL(MODULE_LOADER_RESULT, MODULE_LOADER_SUCCESS, init_result);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .SetReturn(LOCK_ERROR);
+
+    // act
+    MODULE_LOADER_RESULT result = ModuleLoader_LockModuleCalls(&Java_Module_Loader);
+
+    // assert
+    ASSERT_ARE_EQUAL(MODULE_LOADER_RESULT, MODULE_LOADER_ERROR, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    ModuleLoader_Destroy();
+}
+
+// Tests_SRS_MODULE_LOADER_17_017: [ ModuleLoader_UnlockModuleCalls shall do nothing if loader is NULL, its type is out of range or the loaders are not initialized. ]
+TEST_FUNCTION(ModuleLoader_UnlockModuleCalls_does_nothing_when_not_initialized)
+{
+    // act
+    ModuleLoader_UnlockModuleCalls(&Java_Module_Loader);
+    ModuleLoader_UnlockModuleCalls(NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
 // Tests_SRS_MODULE_LOADER_13_049: [ ModuleLoader_ParseBaseConfigurationFromJson shall return MODULE_LOADER_ERROR if configuration is NULL. ]
 TEST_FUNCTION(ModuleLoader_ParseBaseConfigurationFromJson_returns_error_when_config_is_NULL)
 {
@@ -1298,7 +1472,8 @@ TEST_FUNCTION(ModuleLoader_GetDefaultLoaderForType_succeeds)
 
     MODULE_LOADER_TYPE inputs[] =
     {
-        NATIVE
+        NATIVE,
+        NATIVE_STATIC
 #ifdef JAVA_BINDING_ENABLED
         , JAVA
 #endif
@@ -1356,8 +1531,8 @@ TEST_FUNCTION(ModuleLoader_ParseType_returns_UNKNOWN_for_unknown_loader_type)
 TEST_FUNCTION(ModuleLoader_ParseType_succeeds)
 {
     // arrange
-    char* inputs[] = { "native", "node", "java", "dotnet", "dotnetcore", "outprocess" };
-    MODULE_LOADER_TYPE expected[] = { NATIVE, NODEJS, JAVA, DOTNET, DOTNETCORE, OUTPROCESS };
+    char* inputs[] = { "native", "static", "node", "java", "dotnet", "dotnetcore", "outprocess" };
+    MODULE_LOADER_TYPE expected[] = { NATIVE, NATIVE_STATIC, NODEJS, JAVA, DOTNET, DOTNETCORE, OUTPROCESS };
 
     for (size_t i = 0; i < sizeof(inputs) / sizeof(inputs[0]); i++)
     {
@@ -1369,12 +1544,12 @@ TEST_FUNCTION(ModuleLoader_ParseType_succeeds)
     }
 }
 
-// Tests_SRS_MODULE_LOADER_13_061: [ ModuleLoader_IsDefaultLoader shall return true if name is the name of a default module loader and false otherwise. The default module loader names are 'native', 'node', 'java' , 'dotnet' and 'dotnetcore'. ]
+// Tests_SRS_MODULE_LOADER_13_061: [ ModuleLoader_IsDefaultLoader shall return true if name is the name of a default module loader and false otherwise. The default module loader names are 'native', 'static', 'node', 'java' , 'dotnet' and 'dotnetcore'. ]
 TEST_FUNCTION(ModuleLoader_IsDefaultLoader_succeeds)
 {
     // arrange
-    char* inputs[] = { "native", "node", "java", "dotnet", "dotnetcore", "outprocess", "boo" };
-    bool expected[] = { true, true, true, true, true, true, false };
+    char* inputs[] = { "native", "static", "node", "java", "dotnet", "dotnetcore", "outprocess", "boo" };
+    bool expected[] = { true, true, true, true, true, true, true, false };
 
     for (size_t i = 0; i < sizeof(inputs) / sizeof(inputs[0]); i++)
     {
@@ -0,0 +1,297 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "testrunnerswitcher.h"
+#include "umock_c.h"
+
+static TEST_MUTEX_HANDLE g_dllByDll;
+static TEST_MUTEX_HANDLE g_testByTest;
+
+#include "module_memory.h"
+
+static size_t currentmalloc_call;
+static size_t whenShallmalloc_fail;
+
+static void* my_gballoc_malloc(size_t size)
+{
+    void* result;
+    currentmalloc_call++;
+    if (whenShallmalloc_fail > 0 && currentmalloc_call == whenShallmalloc_fail)
+    {
+        result = NULL;
+    }
+    else
+    {
+        result = malloc(size);
+    }
+    return result;
+}
+
+static void my_gballoc_free(void* ptr)
+{
+    free(ptr);
+}
+
+#define ENABLE_MOCKS
+#include "azure_c_shared_utility/gballoc.h"
+#undef ENABLE_MOCKS
+
+static void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
+{
+    (void)error_code;
+    ASSERT_FAIL("umock_c reported error");
+}
+
+BEGIN_TEST_SUITE(module_memory_ut)
+
+    TEST_SUITE_INITIALIZE(TestClassInitialize)
+    {
+        TEST_INITIALIZE_MEMORY_DEBUG(g_dllByDll);
+        g_testByTest = TEST_MUTEX_CREATE();
+        ASSERT_IS_NOT_NULL(g_testByTest);
+
+        umock_c_init(on_umock_c_error);
+
+        REGISTER_GLOBAL_MOCK_HOOK(gballoc_malloc, my_gballoc_malloc);
+        REGISTER_GLOBAL_MOCK_HOOK(gballoc_free, my_gballoc_free);
+    }
+
+    TEST_SUITE_CLEANUP(TestClassCleanup)
+    {
+        TEST_MUTEX_DESTROY(g_testByTest);
+        umock_c_deinit();
+        TEST_DEINITIALIZE_MEMORY_DEBUG(g_dllByDll);
+    }
+
+    TEST_FUNCTION_INITIALIZE(TestMethodInitialize)
+    {
+        if (TEST_MUTEX_ACQUIRE(g_testByTest) != 0)
+        {
+            ASSERT_FAIL("our mutex is ABANDONED. Failure in test framework");
+        }
+
+        umock_c_reset_all_calls();
+
+        currentmalloc_call = 0;
+        whenShallmalloc_fail = 0;
+        (void)ModuleMemory_SetCurrent(NULL);
+    }
+
+    TEST_FUNCTION_CLEANUP(TestMethodCleanup)
+    {
+        TEST_MUTEX_RELEASE(g_testByTest);
+    }
+
+    /*Tests_SRS_MODULE_MEMORY_17_001: [ ModuleMemory_Create shall return a new account with no live bytes and a reference count of 1. ]*/
+    /*Tests_SRS_MODULE_MEMORY_17_005: [ ModuleMemory_DecRef shall decrement the reference count of memory and free it when the count reaches 0. ]*/
+    TEST_FUNCTION(ModuleMemory_Create_succeeds)
+    {
+        ///arrange
+        STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+            .IgnoreArgument_size();
+        STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
+            .IgnoreArgument_ptr();
+
+        ///act
+        MODULE_MEMORY_HANDLE memory = ModuleMemory_Create();
+        size_t live_bytes = ModuleMemory_GetLiveBytes(memory);
+        ModuleMemory_DecRef(memory);
+
+        ///assert
+        ASSERT_IS_NOT_NULL(memory);
+        ASSERT_ARE_EQUAL(size_t, 0, live_bytes);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    }
+
+    /*Tests_SRS_MODULE_MEMORY_17_002: [ ModuleMemory_Create shall return NULL if the allocation fails. ]*/
+    TEST_FUNCTION(ModuleMemory_Create_fails_when_malloc_fails)
+    {
+        ///arrange
+        whenShallmalloc_fail = 1;
+        STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+            .IgnoreArgument_size();
+
+        ///act
+        MODULE_MEMORY_HANDLE memory = ModuleMemory_Create();
+
+        ///assert
+        ASSERT_IS_NULL(memory);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    }
+
+    /*Tests_SRS_MODULE_MEMORY_17_003: [ If memory is NULL, ModuleMemory_IncRef and ModuleMemory_DecRef shall do nothing. ]*/
+    /*Tests_SRS_MODULE_MEMORY_17_010: [ If memory is NULL, ModuleMemory_Release shall do nothing. ]*/
+    /*Tests_SRS_MODULE_MEMORY_17_012: [ ModuleMemory_GetLiveBytes shall return the live bytes of memory, or 0 if memory is NULL. ]*/
+    /*Tests_SRS_MODULE_MEMORY_17_015: [ If ptr is NULL, ModuleMemory_Free shall do nothing. ]*/
+    TEST_FUNCTION(ModuleMemory_NULL_inputs_do_nothing)
+    {
+        ///act
+        ModuleMemory_IncRef(NULL);
+        ModuleMemory_DecRef(NULL);
+        ModuleMemory_Release(NULL, 10);
+        ModuleMemory_Free(NULL);
+
+        ///assert
+        ASSERT_ARE_EQUAL(size_t, 0, ModuleMemory_GetLiveBytes(NULL));
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    }
+
+    /*Tests_SRS_MODULE_MEMORY_17_004: [ ModuleMemory_IncRef shall increment the reference count of memory. ]*/
+    TEST_FUNCTION(ModuleMemory_IncRef_keeps_the_account_alive)
+    {
+        ///arrange
+        MODULE_MEMORY_HANDLE memory = ModuleMemory_Create();
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
+            .IgnoreArgument_ptr();
+
+        ///act
+        ModuleMemory_IncRef(memory);
+        ModuleMemory_DecRef(memory);
+        ModuleMemory_DecRef(memory);
+
+        ///assert
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    }
+
+    /*Tests_SRS_MODULE_MEMORY_17_006: [ ModuleMemory_SetCurrent shall make memory the current account of the calling thread and return the previous one. ]*/
+    /*Tests_SRS_MODULE_MEMORY_17_007: [ ModuleMemory_GetCurrent shall return the current account of the calling thread. ]*/
+    TEST_FUNCTION(ModuleMemory_SetCurrent_returns_the_previous_account)
+    {
+        ///arrange
+        MODULE_MEMORY_HANDLE memory = ModuleMemory_Create();
+
+        ///act
+        MODULE_MEMORY_HANDLE previous = ModuleMemory_SetCurrent(memory);
+        MODULE_MEMORY_HANDLE current = ModuleMemory_GetCurrent();
+        MODULE_MEMORY_HANDLE restored = ModuleMemory_SetCurrent(previous);
+
+        ///assert
+        ASSERT_IS_NULL(previous);
+        ASSERT_ARE_EQUAL(void_ptr, memory, current);
+        ASSERT_ARE_EQUAL(void_ptr, memory, restored);
+        ASSERT_IS_NULL(ModuleMemory_GetCurrent());
+
+        ///cleanup
+        ModuleMemory_DecRef(memory);
+    }
+
+    /*Tests_SRS_MODULE_MEMORY_17_008: [ If the calling thread has no current account, ModuleMemory_Charge shall return NULL. ]*/
+    TEST_FUNCTION(ModuleMemory_Charge_without_current_account_returns_NULL)
+    {
+        ///act
+        MODULE_MEMORY_HANDLE charged = ModuleMemory_Charge(10);
+
+        ///assert
+        ASSERT_IS_NULL(charged);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    }
+
+    /*Tests_SRS_MODULE_MEMORY_17_009: [ ModuleMemory_Charge shall add size to the live bytes of the current account, take a reference to it and return it. ]*/
+    /*Tests_SRS_MODULE_MEMORY_17_011: [ ModuleMemory_Release shall subtract size from the live bytes of memory and drop the reference taken by the charge. ]*/
+    TEST_FUNCTION(ModuleMemory_Charge_and_Release_track_live_bytes)
+    {
+        ///arrange
+        MODULE_MEMORY_HANDLE memory = ModuleMemory_Create();
+        (void)ModuleMemory_SetCurrent(memory);
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
+            .IgnoreArgument_ptr();
+
+        ///act
+        MODULE_MEMORY_HANDLE first = ModuleMemory_Charge(10);
+        MODULE_MEMORY_HANDLE second = ModuleMemory_Charge(32);
+        (void)ModuleMemory_SetCurrent(NULL);
+        size_t charged = ModuleMemory_GetLiveBytes(memory);
+        ModuleMemory_Release(first, 10);
+        size_t after_first = ModuleMemory_GetLiveBytes(memory);
+        /*the charges hold the account after its owner let go*/
+        ModuleMemory_DecRef(memory);
+        ModuleMemory_Release(second, 32);
+
+        ///assert
+        ASSERT_ARE_EQUAL(void_ptr, memory, first);
+        ASSERT_ARE_EQUAL(void_ptr, memory, second);
+        ASSERT_ARE_EQUAL(size_t, 42, charged);
+        ASSERT_ARE_EQUAL(size_t, 32, after_first);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    }
+
+    /*Tests_SRS_MODULE_MEMORY_17_013: [ ModuleMemory_Malloc shall allocate size bytes and charge them to the current account of the calling thread. ]*/
+    /*Tests_SRS_MODULE_MEMORY_17_016: [ ModuleMemory_Free shall release the charge of the block from the account it was charged to and free the block. ]*/
+    TEST_FUNCTION(ModuleMemory_Malloc_charges_until_freed)
+    {
+        ///arrange
+        MODULE_MEMORY_HANDLE memory = ModuleMemory_Create();
+        (void)ModuleMemory_SetCurrent(memory);
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+            .IgnoreArgument_size();
+        STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
+            .IgnoreArgument_ptr();
+
+        ///act
+        unsigned char* block = (unsigned char*)ModuleMemory_Malloc(100);
+        /*a block may be freed on any thread*/
+        (void)ModuleMemory_SetCurrent(NULL);
+        size_t charged = ModuleMemory_GetLiveBytes(memory);
+        block[0] = 1;
+        block[99] = 1;
+        ModuleMemory_Free(block);
+
+        ///assert
+        ASSERT_IS_NOT_NULL(block);
+        ASSERT_ARE_EQUAL(size_t, 0, (size_t)((uintptr_t)block % sizeof(void*)));
+        ASSERT_ARE_EQUAL(size_t, 100, charged);
+        ASSERT_ARE_EQUAL(size_t, 0, ModuleMemory_GetLiveBytes(memory));
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///cleanup
+        ModuleMemory_DecRef(memory);
+    }
+
+    /*Tests_SRS_MODULE_MEMORY_17_013: [ ModuleMemory_Malloc shall allocate size bytes and charge them to the current account of the calling thread. ]*/
+    TEST_FUNCTION(ModuleMemory_Malloc_without_current_account_charges_nothing)
+    {
+        ///act
+        void* block = ModuleMemory_Malloc(16);
+        ModuleMemory_Free(block);
+
+        ///assert
+        ASSERT_IS_NOT_NULL(block);
+    }
+
+    /*Tests_SRS_MODULE_MEMORY_17_014: [ ModuleMemory_Malloc shall return NULL if the allocation fails. ]*/
+    TEST_FUNCTION(ModuleMemory_Malloc_fails_when_malloc_fails)
+    {
+        ///arrange
+        MODULE_MEMORY_HANDLE memory = ModuleMemory_Create();
+        (void)ModuleMemory_SetCurrent(memory);
+        umock_c_reset_all_calls();
+        whenShallmalloc_fail = currentmalloc_call + 1;
+
+        STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+            .IgnoreArgument_size();
+
+        ///act
+        void* block = ModuleMemory_Malloc(16);
+        void* too_large = ModuleMemory_Malloc(SIZE_MAX);
+
+        ///assert
+        ASSERT_IS_NULL(block);
+        ASSERT_IS_NULL(too_large);
+        ASSERT_ARE_EQUAL(size_t, 0, ModuleMemory_GetLiveBytes(memory));
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///cleanup
+        (void)ModuleMemory_SetCurrent(NULL);
+        ModuleMemory_DecRef(memory);
+    }
+
+END_TEST_SUITE(module_memory_ut)
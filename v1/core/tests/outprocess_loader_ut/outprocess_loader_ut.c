@@ -998,6 +998,7 @@ TEST_FUNCTION(OutprocessModuleLoader_ParseEntrypointFromJson_returns_NULL_when_u
 /*Tests_SRS_OUTPROCESS_LOADER_27_020: [ Launch - `OutprocessModuleLoader_ParseEntrypointFromJson` shall update the entry point with the parsed launch parameters. ]*/
 /*Tests_SRS_OUTPROCESS_LOADER_17_043: [ This function shall read the "timeout" value. ]*/
 /*Tests_SRS_OUTPROCESS_LOADER_17_044: [ If "timeout" is set, the remote_message_wait shall be set to this value, else it will be set to a default of 1000 ms. ]*/
+/*Tests_SRS_OUTPROCESS_LOADER_17_045: [ This function shall assign the entrypoint outgoing_queue_capacity to the value of "outgoing.queue.capacity", 0 if it is not present or not a positive number. ]*/
 /*Tests_SRS_OUTPROCESS_LOADER_17_022: [ This function shall return a valid pointer to an OUTPROCESS_LOADER_ENTRYPOINT on success. ]*/
 TEST_FUNCTION(OutprocessModuleLoader_ParseEntrypointFromJson_succeeds)
 {
@@ -1024,6 +1025,8 @@ TEST_FUNCTION(OutprocessModuleLoader_ParseEntrypointFromJson_succeeds)
     expected_calls_update_entrypoint_with_launch_object();
 	STRICT_EXPECTED_CALL(json_object_get_number((JSON_Object*)0x43, "timeout"))
 		.SetReturn(2000);
+	STRICT_EXPECTED_CALL(json_object_get_number((JSON_Object*)0x43, "outgoing.queue.capacity"))
+		.SetReturn(64);
 	STRICT_EXPECTED_CALL(STRING_construct(NULL));
 
 	// act
@@ -1032,6 +1035,7 @@ TEST_FUNCTION(OutprocessModuleLoader_ParseEntrypointFromJson_succeeds)
 	// assert
 	ASSERT_IS_NOT_NULL(result);
 	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+	ASSERT_ARE_EQUAL(size_t, 64, ((OUTPROCESS_LOADER_ENTRYPOINT*)result)->outgoing_queue_capacity);
 	OutprocessModuleLoader_FreeEntrypoint(NULL, result);
 }
 
@@ -1135,6 +1139,7 @@ TEST_FUNCTION(OutprocessModuleLoader_BuildModuleConfiguration_returns_null_on_nu
 /*Tests_SRS_OUTPROCESS_LOADER_17_034: [ This function shall allocate and copy the module_configuration string and assign it the OUTPROCESS_MODULE_CONFIG::outprocess_module_args field. ]*/
 /*Tests_SRS_OUTPROCESS_LOADER_17_035: [ Upon success, this function shall return a valid pointer to an OUTPROCESS_MODULE_CONFIG structure. ]*/
 /*Tests_SRS_OUTPROCESS_LOADER_17_027: [ This function shall allocate a OUTPROCESS_MODULE_CONFIG structure. ]*/
+/*Tests_SRS_OUTPROCESS_LOADER_17_046: [ This function shall copy the entrypoint outgoing_queue_capacity into OUTPROCESS_MODULE_CONFIG. ]*/
 TEST_FUNCTION(OutprocessModuleLoader_BuildModuleConfiguration_success_with_msg_url)
 {
 	//arrange
@@ -1145,7 +1150,8 @@ TEST_FUNCTION(OutprocessModuleLoader_BuildModuleConfiguration_success_with_msg_u
 		STRING_construct("message_id"),
 		0,
 		NULL,
-		0
+		0,
+		64
 	};
 	STRING_HANDLE mc = STRING_construct("message config");
 
@@ -1166,6 +1172,7 @@ TEST_FUNCTION(OutprocessModuleLoader_BuildModuleConfiguration_success_with_msg_u
 	ASSERT_ARE_EQUAL(char_ptr, STRING_c_str(omc->control_uri), "ipc://control_id");
 	ASSERT_ARE_EQUAL(char_ptr, STRING_c_str(omc->message_uri), "ipc://message_id");
 	ASSERT_ARE_EQUAL(char_ptr, STRING_c_str(omc->outprocess_module_args), STRING_c_str(mc));
+	ASSERT_ARE_EQUAL(size_t, 64, omc->outgoing_queue_capacity);
 
 	//cleanup
 	OutprocessModuleLoader_FreeModuleConfiguration(NULL, result);
@@ -4,6 +4,7 @@
 #include <stdlib.h>
 #include <stddef.h>
 #include <stdbool.h>
+#include <string.h>
 
 #define GATEWAY_EXPORT_H
 #define GATEWAY_EXPORT
@@ -342,6 +343,17 @@ MOCK_FUNCTION_WITH_CODE(, int32_t, Message_ToByteArray, MESSAGE_HANDLE, messageH
 int32_t array_size = default_serialized_size;
 MOCK_FUNCTION_END(array_size)
 
+MOCK_FUNCTION_WITH_CODE(, int32_t, Message_ToByteArrayWithVersion, MESSAGE_HANDLE, messageHandle, uint8_t, version, unsigned char*, buf, int32_t, size)
+int32_t array_size = default_serialized_size;
+MOCK_FUNCTION_END(array_size)
+
+static const unsigned char serialized_message[256] = { 0x42 };
+
+MOCK_FUNCTION_WITH_CODE(, int, Message_GetSerializedWithVersion, MESSAGE_HANDLE, message, uint8_t, version, const unsigned char**, buffer, int32_t*, size)
+*buffer = serialized_message;
+*size = default_serialized_size;
+MOCK_FUNCTION_END(0)
+
 MOCK_FUNCTION_WITH_CODE(, void, Message_Destroy, MESSAGE_HANDLE, message)
 uint8_t *counter = (uint8_t*)message;
 --(*counter);
@@ -353,6 +365,9 @@ MOCK_FUNCTION_END()
 MOCK_FUNCTION_WITH_CODE(, BROKER_RESULT, Broker_Publish, BROKER_HANDLE, broker, MODULE_HANDLE, source, MESSAGE_HANDLE, message)
 MOCK_FUNCTION_END(BROKER_OK)
 
+MOCK_FUNCTION_WITH_CODE(, BROKER_RESULT, Broker_ReportDroppedMessages, BROKER_HANDLE, broker, MODULE_HANDLE, module, size_t, count)
+MOCK_FUNCTION_END(BROKER_OK)
+
 BEGIN_TEST_SUITE(OutprocessModule_UnitTests)
 
 TEST_SUITE_INITIALIZE(TestClassInitialize)
@@ -370,6 +385,7 @@ TEST_SUITE_INITIALIZE(TestClassInitialize)
 	REGISTER_UMOCK_ALIAS_TYPE(MODULE_HANDLE, void*);
 	REGISTER_UMOCK_ALIAS_TYPE(BROKER_HANDLE, void*);
 	REGISTER_UMOCK_ALIAS_TYPE(MESSAGE_HANDLE, void*);
+	REGISTER_UMOCK_ALIAS_TYPE(MESSAGE_HANDLE*, void*);
 	REGISTER_UMOCK_ALIAS_TYPE(MESSAGE_QUEUE_HANDLE, void*);
 	REGISTER_UMOCK_ALIAS_TYPE(LOCK_HANDLE, void*);
 	REGISTER_UMOCK_ALIAS_TYPE(LOCK_RESULT, int);
@@ -401,7 +417,7 @@ TEST_SUITE_INITIALIZE(TestClassInitialize)
 	REGISTER_GLOBAL_MOCK_HOOK(Lock_Deinit, my_Lock_Deinit);
 
 	// message queue
-	REGISTER_GLOBAL_MOCK_RETURNS(MESSAGE_QUEUE_create, (MESSAGE_QUEUE_HANDLE)0x40, NULL);
+	REGISTER_GLOBAL_MOCK_RETURNS(MESSAGE_QUEUE_create_bounded, (MESSAGE_QUEUE_HANDLE)0x40, NULL);
 
 
 	Module_ParseConfigurationFromJson = Outprocess_Module_API_all.Module_ParseConfigurationFromJson;
@@ -609,7 +625,7 @@ TEST_FUNCTION(Outprocess_Create_returns_null_with_null_arguments)
 /*Tests_SRS_OUTPROCESS_MODULE_17_006: [ This function shall allocate memory for the MODULE_HANDLE. ]*/
 /*Tests_SRS_OUTPROCESS_MODULE_17_007: [ This function shall intialize a lock for exclusive access to handle data. ]*/
 /*Tests_SRS_OUTPROCESS_MODULE_17_041: [ This function shall intitialize a lock for each thread for thread management. ]*/
-/*Tests_SRS_OUTPROCESS_MODULE_17_042: [ This function shall initialize a queue for outgoing gateway messages. ]*/
+/*Tests_SRS_OUTPROCESS_MODULE_17_042: [ This function shall initialize a bounded queue of `outgoing_queue_capacity` outgoing gateway messages, or `OUTPROCESS_OUTGOING_QUEUE_CAPACITY` if `outgoing_queue_capacity` is 0. ]*/
 /*Tests_SRS_OUTPROCESS_MODULE_17_008: [ This function shall create a pair socket for sending gateway messages to the module host. ]*/
 /*Tests_SRS_OUTPROCESS_MODULE_17_009: [ This function shall bind and connect the pair socket to the message_uri. ]*/
 /*Tests_SRS_OUTPROCESS_MODULE_17_010: [ This function shall create a request/reply socket for sending control messages to the module host. ]*/
@@ -632,7 +648,7 @@ TEST_FUNCTION(Outprocess_Create_success)
 		.IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(Lock_Init());
 
-	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_create())
+	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_create_bounded(1024))
 		.SetReturn((MESSAGE_QUEUE_HANDLE)0x40);
 
 	setup_create_connections(&config);
@@ -698,7 +714,7 @@ TEST_FUNCTION(Outprocess_Create_retries_nn_recv_when_it_is_interrupted)
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(Lock_Init());
 
-    STRICT_EXPECTED_CALL(MESSAGE_QUEUE_create())
+    STRICT_EXPECTED_CALL(MESSAGE_QUEUE_create_bounded(1024))
         .SetReturn((MESSAGE_QUEUE_HANDLE)0x40);
 
     setup_create_connections(&config);
@@ -777,7 +793,7 @@ TEST_FUNCTION(Outprocess_Create_success_on_2nd_recv)
 		.IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(Lock_Init());
 
-	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_create())
+	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_create_bounded(1024))
 		.SetReturn((MESSAGE_QUEUE_HANDLE)0x40);
 
 	setup_create_connections(&config);
@@ -851,7 +867,7 @@ TEST_FUNCTION(Outprocess_Create_success_async)
 	STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
 		.IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(Lock_Init());
-	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_create())
+	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_create_bounded(1024))
 		.SetReturn((MESSAGE_QUEUE_HANDLE)0x40);
 	setup_create_connections(&config);
 	STRICT_EXPECTED_CALL(Lock_Init());
@@ -892,7 +908,7 @@ TEST_FUNCTION(Outprocess_Create_returns_null_wrong_message_type_response)
 	STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
 		.IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(Lock_Init());
-	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_create())
+	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_create_bounded(1024))
 		.SetReturn((MESSAGE_QUEUE_HANDLE)0x40);
 	setup_create_connections(&config);
 	STRICT_EXPECTED_CALL(Lock_Init());
@@ -968,7 +984,7 @@ TEST_FUNCTION(Outprocess_Create_returns_null_wrong_message_status_response)
 	STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
 		.IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(Lock_Init());
-	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_create())
+	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_create_bounded(1024))
 		.SetReturn((MESSAGE_QUEUE_HANDLE)0x40);
 	setup_create_connections(&config);
 	STRICT_EXPECTED_CALL(Lock_Init());
@@ -1041,7 +1057,7 @@ TEST_FUNCTION(Outprocess_Create_returns_null_reponse_not_a_message)
 	STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
 		.IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(Lock_Init());
-	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_create())
+	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_create_bounded(1024))
 		.SetReturn((MESSAGE_QUEUE_HANDLE)0x40);
 	setup_create_connections(&config);
 	STRICT_EXPECTED_CALL(Lock_Init());
@@ -1113,7 +1129,7 @@ TEST_FUNCTION(Outprocess_Create_returns_null_nn_recv_fails)
 	STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
 		.IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(Lock_Init());
-	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_create())
+	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_create_bounded(1024))
 		.SetReturn((MESSAGE_QUEUE_HANDLE)0x40);
 	setup_create_connections(&config);
 	STRICT_EXPECTED_CALL(Lock_Init());
@@ -1185,7 +1201,7 @@ TEST_FUNCTION(Outprocess_Create_returns_null_thread_join_fails)
 	STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
 		.IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(Lock_Init());
-	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_create())
+	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_create_bounded(1024))
 		.SetReturn((MESSAGE_QUEUE_HANDLE)0x40);
 	setup_create_connections(&config);
 	STRICT_EXPECTED_CALL(Lock_Init());
@@ -1241,7 +1257,7 @@ TEST_FUNCTION(Outprocess_Create_returns_null_thread_create_fails)
 	STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
 		.IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(Lock_Init());
-	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_create())
+	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_create_bounded(1024))
 		.SetReturn((MESSAGE_QUEUE_HANDLE)0x40);
 	setup_create_connections(&config);
 	STRICT_EXPECTED_CALL(Lock_Init());
@@ -1294,7 +1310,7 @@ TEST_FUNCTION(Outprocess_Create_returns_null_nn_send_fails)
 	STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
 		.IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(Lock_Init());
-	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_create())
+	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_create_bounded(1024))
 		.SetReturn((MESSAGE_QUEUE_HANDLE)0x40);
 	setup_create_connections(&config);
 	STRICT_EXPECTED_CALL(Lock_Init());
@@ -1361,7 +1377,7 @@ TEST_FUNCTION(Outprocess_Create_returns_null_nn_send_try_again)
 	STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
 		.IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(Lock_Init());
-	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_create())
+	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_create_bounded(1024))
 		.SetReturn((MESSAGE_QUEUE_HANDLE)0x40);
 	setup_create_connections(&config);
 	STRICT_EXPECTED_CALL(Lock_Init());
@@ -1438,7 +1454,7 @@ TEST_FUNCTION(Outprocess_Create_returns_null_sockopt_fails)
 	STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
 		.IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(Lock_Init());
-	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_create())
+	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_create_bounded(1024))
 		.SetReturn((MESSAGE_QUEUE_HANDLE)0x40);
 	setup_create_connections(&config);
 	STRICT_EXPECTED_CALL(Lock_Init());
@@ -1501,7 +1517,7 @@ TEST_FUNCTION(Outprocess_Create_returns_null_nn_allocmsg_fails)
 	STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
 		.IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(Lock_Init());
-	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_create())
+	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_create_bounded(1024))
 		.SetReturn((MESSAGE_QUEUE_HANDLE)0x40);
 	setup_create_connections(&config);
 	STRICT_EXPECTED_CALL(Lock_Init());
@@ -1574,7 +1590,7 @@ TEST_FUNCTION(Outprocess_Create_returns_null_Message_ToByteArray_fails)
 	STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
 		.IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(Lock_Init());
-	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_create())
+	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_create_bounded(1024))
 		.SetReturn((MESSAGE_QUEUE_HANDLE)0x40);
 	setup_create_connections(&config);
 	STRICT_EXPECTED_CALL(Lock_Init());
@@ -1644,7 +1660,7 @@ TEST_FUNCTION(Outprocess_Create_returns_null_badargs_null)
 	STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
 		.IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(Lock_Init());
-	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_create())
+	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_create_bounded(1024))
 		.SetReturn((MESSAGE_QUEUE_HANDLE)0x40);
 	setup_create_connections(&config);
 	STRICT_EXPECTED_CALL(Lock_Init());
@@ -1711,7 +1727,7 @@ TEST_FUNCTION(Outprocess_Create_returns_null_badargs_length)
 	STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
 		.IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(Lock_Init());
-	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_create())
+	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_create_bounded(1024))
 		.SetReturn((MESSAGE_QUEUE_HANDLE)0x40);
 	setup_create_connections(&config);
 	STRICT_EXPECTED_CALL(Lock_Init());
@@ -1778,7 +1794,7 @@ TEST_FUNCTION(Outprocess_Create_returns_null_baduri_null)
 	STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
 		.IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(Lock_Init());
-	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_create())
+	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_create_bounded(1024))
 		.SetReturn((MESSAGE_QUEUE_HANDLE)0x40);
 	setup_create_connections(&config);
 	STRICT_EXPECTED_CALL(Lock_Init());
@@ -1845,7 +1861,7 @@ TEST_FUNCTION(Outprocess_Create_returns_null_baduri_length)
 	STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
 		.IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(Lock_Init());
-	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_create())
+	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_create_bounded(1024))
 		.SetReturn((MESSAGE_QUEUE_HANDLE)0x40);
 	setup_create_connections(&config);
 	STRICT_EXPECTED_CALL(Lock_Init());
@@ -1911,7 +1927,7 @@ TEST_FUNCTION(Outprocess_Create_returns_null_send_lock_fail)
 	STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
 		.IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(Lock_Init());
-	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_create())
+	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_create_bounded(1024))
 		.SetReturn((MESSAGE_QUEUE_HANDLE)0x40);
 	setup_create_connections(&config);
 	STRICT_EXPECTED_CALL(Lock_Init());
@@ -1952,7 +1968,7 @@ TEST_FUNCTION(Outprocess_Create_returns_null_async_lock_fail)
 	STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
 		.IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(Lock_Init());
-	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_create())
+	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_create_bounded(1024))
 		.SetReturn((MESSAGE_QUEUE_HANDLE)0x40);
 	setup_create_connections(&config);
 	STRICT_EXPECTED_CALL(Lock_Init());
@@ -1991,7 +2007,7 @@ TEST_FUNCTION(Outprocess_Create_returns_null_control_lock_fail)
 	STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
 		.IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(Lock_Init());
-	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_create())
+	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_create_bounded(1024))
 		.SetReturn((MESSAGE_QUEUE_HANDLE)0x40);
 	setup_create_connections(&config);
 	STRICT_EXPECTED_CALL(Lock_Init());
@@ -2028,7 +2044,7 @@ TEST_FUNCTION(Outprocess_Create_returns_null_receive_lock_fail)
 	STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
 		.IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(Lock_Init());
-	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_create())
+	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_create_bounded(1024))
 		.SetReturn((MESSAGE_QUEUE_HANDLE)0x40);
 	setup_create_connections(&config);
 	malloc_will_fail = true;
@@ -2063,7 +2079,7 @@ TEST_FUNCTION(Outprocess_Create_retries_nn_close_when_it_is_interrupted)
     STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
         .IgnoreArgument(1);
     STRICT_EXPECTED_CALL(Lock_Init());
-    STRICT_EXPECTED_CALL(MESSAGE_QUEUE_create())
+    STRICT_EXPECTED_CALL(MESSAGE_QUEUE_create_bounded(1024))
         .SetReturn((MESSAGE_QUEUE_HANDLE)0x40);
     setup_create_connections(&config);
     malloc_will_fail = true;
@@ -2111,7 +2127,7 @@ TEST_FUNCTION(Outprocess_Create_returns_null_clone_args_fail)
 	STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
 		.IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(Lock_Init());
-	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_create())
+	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_create_bounded(1024))
 		.SetReturn((MESSAGE_QUEUE_HANDLE)0x40);
 	setup_create_connections(&config); 
 	STRICT_EXPECTED_CALL(Lock_Init());
@@ -2164,7 +2180,7 @@ TEST_FUNCTION(Outprocess_Create_returns_null_clone_msg_uri_fails)
 	STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
 		.IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(Lock_Init());
-	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_create())
+	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_create_bounded(1024))
 		.SetReturn((MESSAGE_QUEUE_HANDLE)0x40);
 	setup_create_connections(&config);
 	STRICT_EXPECTED_CALL(Lock_Init());
@@ -2214,7 +2230,7 @@ TEST_FUNCTION(Outprocess_Create_returns_null_clone_control_uri_fails)
 	STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
 		.IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(Lock_Init());
-	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_create())
+	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_create_bounded(1024))
 		.SetReturn((MESSAGE_QUEUE_HANDLE)0x40);
 	setup_create_connections(&config);
 	STRICT_EXPECTED_CALL(Lock_Init());
@@ -2262,7 +2278,7 @@ TEST_FUNCTION(Outprocess_Create_returns_null_control_connect_fails)
 	STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
 		.IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(Lock_Init());
-	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_create())
+	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_create_bounded(1024))
 		.SetReturn((MESSAGE_QUEUE_HANDLE)0x40);
 	STRICT_EXPECTED_CALL(nn_socket(AF_SP, NN_PAIR));
 	STRICT_EXPECTED_CALL(STRING_c_str(config.message_uri));
@@ -2294,7 +2310,7 @@ TEST_FUNCTION(Outprocess_Create_returns_null_control_connect_fails)
 	STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
 		.IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(Lock_Init());
-	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_create())
+	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_create_bounded(1024))
 		.SetReturn((MESSAGE_QUEUE_HANDLE)0x40);
 	STRICT_EXPECTED_CALL(nn_socket(AF_SP, NN_PAIR));
 	STRICT_EXPECTED_CALL(STRING_c_str(config.message_uri));
@@ -2338,7 +2354,7 @@ TEST_FUNCTION(Outprocess_Create_returns_null_control_socket_fails)
 	STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
 		.IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(Lock_Init());
-	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_create())
+	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_create_bounded(1024))
 		.SetReturn((MESSAGE_QUEUE_HANDLE)0x40);
 
 	STRICT_EXPECTED_CALL(nn_socket(AF_SP, NN_PAIR));
@@ -2379,7 +2395,7 @@ TEST_FUNCTION(Outprocess_Create_returns_null_message_connect_fails)
 	STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
 		.IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(Lock_Init());
-	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_create())
+	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_create_bounded(1024))
 		.SetReturn((MESSAGE_QUEUE_HANDLE)0x40);
 
 	STRICT_EXPECTED_CALL(nn_socket(AF_SP, NN_PAIR));
@@ -2409,7 +2425,7 @@ TEST_FUNCTION(Outprocess_Create_returns_null_message_connect_fails)
 	STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
 		.IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(Lock_Init());
-	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_create())
+	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_create_bounded(1024))
 		.SetReturn((MESSAGE_QUEUE_HANDLE)0x40);
 
 	STRICT_EXPECTED_CALL(nn_socket(AF_SP, NN_PAIR));
@@ -2448,7 +2464,7 @@ TEST_FUNCTION(Outprocess_Create_returns_null_message_socket_fails)
 	STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
 		.IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(Lock_Init());
-	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_create())
+	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_create_bounded(1024))
 		.SetReturn((MESSAGE_QUEUE_HANDLE)0x40);
 	when_shall_nn_socket_fail = 1;
 	STRICT_EXPECTED_CALL(nn_socket(AF_SP, NN_PAIR));
@@ -2481,7 +2497,35 @@ TEST_FUNCTION(Outprocess_Create_returns_null_message_queue_fails)
 	STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
 		.IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(Lock_Init());
-	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_create())
+	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_create_bounded(1024))
+		.SetReturn(NULL);
+
+	STRICT_EXPECTED_CALL(Lock_Deinit(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG)).IgnoreArgument(1);
+
+	// act
+	MODULE_HANDLE result = Module_Create((BROKER_HANDLE)0x42, &config);
+
+	// assert
+
+	ASSERT_IS_NULL(result);
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+	// ablution
+	cleanup_create_config(&config);
+}
+
+/*Tests_SRS_OUTPROCESS_MODULE_17_042: [ This function shall initialize a bounded queue of `outgoing_queue_capacity` outgoing gateway messages, or `OUTPROCESS_OUTGOING_QUEUE_CAPACITY` if `outgoing_queue_capacity` is 0. ]*/
+TEST_FUNCTION(Outprocess_Create_uses_configured_queue_capacity)
+{
+	// arrange
+	OUTPROCESS_MODULE_CONFIG config;
+	setup_create_config(&config);
+	config.outgoing_queue_capacity = 64;
+	STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+		.IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Lock_Init());
+	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_create_bounded(64))
 		.SetReturn(NULL);
 
 	STRICT_EXPECTED_CALL(Lock_Deinit(IGNORED_PTR_ARG)).IgnoreArgument(1);
@@ -3047,7 +3091,7 @@ TEST_FUNCTION(Outprocess_Receive_does_nothing_with_nothing)
 	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 }
 
-/*Tests_SRS_OUTPROCESS_MODULE_17_045: [ This function shall ensure thread safety for the module data. ]*/
+/*Tests_SRS_OUTPROCESS_MODULE_17_045: [ This function shall not lock the module data; the outgoing gateway message queue accepts concurrent pushes. ]*/
 /*Tests_SRS_OUTPROCESS_MODULE_17_047: [ This function shall push the message onto the end of the outgoing gateway message queue. ]*/
 /*Tests_SRS_OUTPROCESS_MODULE_17_046: [ This function shall clone the message to ensure the message is kept allocated until forwarded to module host. ]*/
 TEST_FUNCTION(Outprocess_Receive_success)
@@ -3062,9 +3106,7 @@ TEST_FUNCTION(Outprocess_Receive_success)
 	umock_c_reset_all_calls();
 
 	STRICT_EXPECTED_CALL(Message_Clone(msg));
-	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_push(IGNORED_PTR_ARG, msg)).IgnoreArgument(1);
-	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1);
 
 	// act
 	Module_Receive(module, msg);
@@ -3092,10 +3134,8 @@ TEST_FUNCTION(Outprocess_Receive_push_queue_fails)
 	umock_c_reset_all_calls();
 
 	STRICT_EXPECTED_CALL(Message_Clone(msg));
-	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_push(IGNORED_PTR_ARG, msg)).IgnoreArgument(1).SetReturn(2620);
 	STRICT_EXPECTED_CALL(Message_Destroy(msg));
-	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1);
 
 	// act
 	Module_Receive(module, msg);
@@ -3109,8 +3149,9 @@ TEST_FUNCTION(Outprocess_Receive_push_queue_fails)
 	cleanup_create_config(&config);
 }
 
-/*Tests_SRS_OUTPROCESS_MODULE_17_047: [ This function shall push the message onto the end of the outgoing gateway message queue. ]*/
-TEST_FUNCTION(Outprocess_Receive_Lock_fails)
+/*Tests_SRS_OUTPROCESS_MODULE_17_063: [ If the outgoing gateway message queue is full, this function shall drop the message. ]*/
+/*Tests_SRS_OUTPROCESS_MODULE_17_067: [ This function shall count a dropped message in the module's metrics by calling `Broker_ReportDroppedMessages`. ]*/
+TEST_FUNCTION(Outprocess_Receive_queue_full_drops_message)
 {
 	// arrange
 	OUTPROCESS_MODULE_CONFIG config;
@@ -3122,8 +3163,9 @@ TEST_FUNCTION(Outprocess_Receive_Lock_fails)
 	umock_c_reset_all_calls();
 
 	STRICT_EXPECTED_CALL(Message_Clone(msg));
-	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1).SetReturn(LOCK_ERROR);
+	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_push(IGNORED_PTR_ARG, msg)).IgnoreArgument(1).SetReturn(MESSAGE_QUEUE_FULL);
 	STRICT_EXPECTED_CALL(Message_Destroy(msg));
+	STRICT_EXPECTED_CALL(Broker_ReportDroppedMessages((BROKER_HANDLE)0x42, module, 1));
 
 	// act
 	Module_Receive(module, msg);
@@ -3186,9 +3228,10 @@ TEST_FUNCTION(Outprocess_outgoing_thread_does_nothing_with_nothing)
 }
 
 /*Tests_SRS_OUTPROCESS_MODULE_17_053: [ This thread shall ensure thread safety on the module data. ]*/
-/*Tests_SRS_OUTPROCESS_MODULE_17_054: [ This function shall remove the oldest message from the outgoing gateway message queue. ]*/
-/*Tests_SRS_OUTPROCESS_MODULE_17_023: [ This function shall serialize the message for transmission on the message channel. ]*/
-/*Tests_SRS_OUTPROCESS_MODULE_17_024: [ This function shall send the message on the message channel. ]*/
+/*Tests_SRS_OUTPROCESS_MODULE_17_054: [ This function shall remove the oldest message from the outgoing gateway message queue, sleeping on the queue for at most OUTPROCESS_OUTGOING_WAIT_MS milliseconds while it is empty. ]*/
+/*Tests_SRS_OUTPROCESS_MODULE_17_023: [ This function shall serialize the message with the message version negotiated with the module host by calling Message_GetSerializedWithVersion. ]*/
+/*Tests_SRS_OUTPROCESS_MODULE_17_066: [ This function shall allocate a nanomsg message of the serialized size and copy the serialized message into it. ]*/
+/*Tests_SRS_OUTPROCESS_MODULE_17_024: [ This function shall send the nanomsg message on the message channel, handing its ownership to nanomsg. ]*/
 /*Tests_SRS_OUTPROCESS_MODULE_17_055: [ This function shall Destroy the message once successfully transmitted. ]*/
 /*Tests_SRS_OUTPROCESS_MODULE_17_025: [ This function shall free any resources created. ]*/
 TEST_FUNCTION(Outprocess_outgoing_thread_success)
@@ -3204,19 +3247,242 @@ TEST_FUNCTION(Outprocess_outgoing_thread_success)
 
 	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_pop_wait(IGNORED_PTR_ARG, IGNORED_NUM_ARG)).IgnoreAllArguments()
+		.SetReturn(msg);
+	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_pop_batch(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 31))
+		.IgnoreArgument(1).IgnoreArgument(2);
 	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1);
-	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_is_empty(IGNORED_PTR_ARG)).IgnoreArgument(1)
-		.SetReturn(false);
-	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_pop(IGNORED_PTR_ARG)).IgnoreArgument(1)
+	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Message_GetSerializedWithVersion(msg, GATEWAY_MESSAGE_VERSION_1, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+		.IgnoreArgument(3).IgnoreArgument(4);
+	STRICT_EXPECTED_CALL(nn_allocmsg(default_serialized_size, 0));
+	STRICT_EXPECTED_CALL(nn_send(1, IGNORED_PTR_ARG, NN_MSG, 0)).IgnoreArgument(2);
+	STRICT_EXPECTED_CALL(Message_Destroy(msg));
+	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1)
+		.SetReturn(LOCK_ERROR);
+
+	// act
+	//third thread created is outgoing message thread
+	thread_func_to_call[3](thread_func_args[3]);
+
+	// assert 
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+	//ablution
+	Module_Destroy(module);
+	cleanup_create_config(&config);
+}
+
+/*Tests_SRS_OUTPROCESS_MODULE_17_023: [ This function shall serialize the message with the message version negotiated with the module host by calling Message_GetSerializedWithVersion. ]*/
+TEST_FUNCTION(Outprocess_outgoing_thread_sends_the_cached_serialization_without_serializing_again)
+{
+	// arrange
+	OUTPROCESS_MODULE_CONFIG config;
+	setup_create_config(&config);
+
+	MODULE_HANDLE module = Module_Create((BROKER_HANDLE)0x42, &config);
+	Module_Start(module);
+	MESSAGE_HANDLE msg = Message_Create((const MESSAGE_CONFIG*)(0x42));
+	MESSAGE_HANDLE msg2 = Message_Clone(msg);
+	umock_c_reset_all_calls();
+
+	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_pop_wait(IGNORED_PTR_ARG, IGNORED_NUM_ARG)).IgnoreAllArguments()
 		.SetReturn(msg);
+	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_pop_batch(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 31))
+		.IgnoreArgument(1).IgnoreArgument(2)
+		.CopyOutArgumentBuffer(2, &msg2, sizeof(msg2))
+		.SetReturn(1);
+	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1);
-	STRICT_EXPECTED_CALL(Message_ToByteArray(msg, NULL, 0));
+	STRICT_EXPECTED_CALL(Message_GetSerializedWithVersion(msg, GATEWAY_MESSAGE_VERSION_1, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+		.IgnoreArgument(3).IgnoreArgument(4);
+	STRICT_EXPECTED_CALL(nn_allocmsg(default_serialized_size, 0));
+	STRICT_EXPECTED_CALL(nn_send(1, IGNORED_PTR_ARG, NN_MSG, 0)).IgnoreArgument(2);
+	STRICT_EXPECTED_CALL(Message_Destroy(msg));
+	STRICT_EXPECTED_CALL(Message_GetSerializedWithVersion(msg2, GATEWAY_MESSAGE_VERSION_1, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+		.IgnoreArgument(3).IgnoreArgument(4);
+	STRICT_EXPECTED_CALL(nn_allocmsg(default_serialized_size, 0));
+	STRICT_EXPECTED_CALL(nn_send(1, IGNORED_PTR_ARG, NN_MSG, 0)).IgnoreArgument(2);
+	STRICT_EXPECTED_CALL(Message_Destroy(msg2));
+	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1)
+		.SetReturn(LOCK_ERROR);
+
+	// act
+	//third thread created is outgoing message thread
+	thread_func_to_call[3](thread_func_args[3]);
+
+	// assert
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+	ASSERT_IS_NULL(strstr(umock_c_get_actual_calls(), "Message_ToByteArray"));
+
+	//ablution
+	Module_Destroy(module);
+	cleanup_create_config(&config);
+}
+
+/*Tests_SRS_OUTPROCESS_MODULE_17_066: [ This function shall allocate a nanomsg message of the serialized size and copy the serialized message into it. ]*/
+TEST_FUNCTION(Outprocess_outgoing_thread_does_not_send_when_nn_allocmsg_fails)
+{
+	// arrange
+	OUTPROCESS_MODULE_CONFIG config;
+	setup_create_config(&config);
+
+	MODULE_HANDLE module = Module_Create((BROKER_HANDLE)0x42, &config);
+	Module_Start(module);
+	MESSAGE_HANDLE msg = Message_Create((const MESSAGE_CONFIG*)(0x42));
+	umock_c_reset_all_calls();
+
+	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_pop_wait(IGNORED_PTR_ARG, IGNORED_NUM_ARG)).IgnoreAllArguments()
+		.SetReturn(msg);
+	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_pop_batch(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 31))
+		.IgnoreArgument(1).IgnoreArgument(2);
+	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Message_GetSerializedWithVersion(msg, GATEWAY_MESSAGE_VERSION_1, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+		.IgnoreArgument(3).IgnoreArgument(4);
+	malloc_will_fail = true;
+	malloc_fail_count = 1; //nn_allocmsg
+	malloc_count = 0;
+	STRICT_EXPECTED_CALL(nn_allocmsg(default_serialized_size, 0));
+	STRICT_EXPECTED_CALL(Message_Destroy(msg));
+	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1)
+		.SetReturn(LOCK_ERROR);
+
+	// act
+	//third thread created is outgoing message thread
+	thread_func_to_call[3](thread_func_args[3]);
+
+	// assert 
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+	//ablution
+	Module_Destroy(module);
+	cleanup_create_config(&config);
+}
+
+/*Tests_SRS_OUTPROCESS_MODULE_17_064: [ Once it has a message, this function shall also remove up to OUTPROCESS_OUTGOING_BATCH_SIZE - 1 further messages that are already waiting on the outgoing gateway message queue. ]*/
+/*Tests_SRS_OUTPROCESS_MODULE_17_065: [ This function shall lock the module data once per batch of messages. ]*/
+TEST_FUNCTION(Outprocess_outgoing_thread_sends_a_batch_with_one_lock)
+{
+	// arrange
+	OUTPROCESS_MODULE_CONFIG config;
+	setup_create_config(&config);
+
+	MODULE_HANDLE module = Module_Create((BROKER_HANDLE)0x42, &config);
+	Module_Start(module);
+	MESSAGE_HANDLE msg = Message_Create((const MESSAGE_CONFIG*)(0x42));
+	MESSAGE_HANDLE msg2 = Message_Create((const MESSAGE_CONFIG*)(0x42));
+	umock_c_reset_all_calls();
+
+	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_pop_wait(IGNORED_PTR_ARG, IGNORED_NUM_ARG)).IgnoreAllArguments()
+		.SetReturn(msg);
+	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_pop_batch(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 31))
+		.IgnoreArgument(1).IgnoreArgument(2)
+		.CopyOutArgumentBuffer(2, &msg2, sizeof(msg2))
+		.SetReturn(1);
+	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Message_GetSerializedWithVersion(msg, GATEWAY_MESSAGE_VERSION_1, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+		.IgnoreArgument(3).IgnoreArgument(4);
+	STRICT_EXPECTED_CALL(nn_allocmsg(default_serialized_size, 0));
+	STRICT_EXPECTED_CALL(nn_send(1, IGNORED_PTR_ARG, NN_MSG, 0)).IgnoreArgument(2);
+	STRICT_EXPECTED_CALL(Message_Destroy(msg));
+	STRICT_EXPECTED_CALL(Message_GetSerializedWithVersion(msg2, GATEWAY_MESSAGE_VERSION_1, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+		.IgnoreArgument(3).IgnoreArgument(4);
+	STRICT_EXPECTED_CALL(nn_allocmsg(default_serialized_size, 0));
+	STRICT_EXPECTED_CALL(nn_send(1, IGNORED_PTR_ARG, NN_MSG, 0)).IgnoreArgument(2);
+	STRICT_EXPECTED_CALL(Message_Destroy(msg2));
+	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1)
+		.SetReturn(LOCK_ERROR);
+
+	// act
+	//third thread created is outgoing message thread
+	thread_func_to_call[3](thread_func_args[3]);
+
+	// assert 
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+	//ablution
+	Module_Destroy(module);
+	cleanup_create_config(&config);
+}
+
+/*Tests_SRS_OUTPROCESS_MODULE_17_065: [ This function shall lock the module data once per batch of messages. ]*/
+TEST_FUNCTION(Outprocess_outgoing_thread_lock_fails_destroys_the_batch)
+{
+	// arrange
+	OUTPROCESS_MODULE_CONFIG config;
+	setup_create_config(&config);
+
+	MODULE_HANDLE module = Module_Create((BROKER_HANDLE)0x42, &config);
+	Module_Start(module);
+	MESSAGE_HANDLE msg = Message_Create((const MESSAGE_CONFIG*)(0x42));
+	MESSAGE_HANDLE msg2 = Message_Create((const MESSAGE_CONFIG*)(0x42));
+	umock_c_reset_all_calls();
+
+	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_pop_wait(IGNORED_PTR_ARG, IGNORED_NUM_ARG)).IgnoreAllArguments()
+		.SetReturn(msg);
+	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_pop_batch(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 31))
+		.IgnoreArgument(1).IgnoreArgument(2)
+		.CopyOutArgumentBuffer(2, &msg2, sizeof(msg2))
+		.SetReturn(1);
+	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1)
+		.SetReturn(LOCK_ERROR);
+	STRICT_EXPECTED_CALL(Message_Destroy(msg));
+	STRICT_EXPECTED_CALL(Message_Destroy(msg2));
+
+	// act
+	//third thread created is outgoing message thread
+	thread_func_to_call[3](thread_func_args[3]);
+
+	// assert 
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+	//ablution
+	Module_Destroy(module);
+	cleanup_create_config(&config);
+}
+
+/*Tests_SRS_OUTPROCESS_MODULE_17_062: [ This function shall use the message_version of the Create Response for the messages it sends to the module host; a version it does not support shall be treated as GATEWAY_MESSAGE_VERSION_1. ]*/
+/*Tests_SRS_OUTPROCESS_MODULE_17_023: [ This function shall serialize the message with the message version negotiated with the module host by calling Message_GetSerializedWithVersion. ]*/
+TEST_FUNCTION(Outprocess_outgoing_thread_uses_negotiated_message_version)
+{
+	// arrange
+	global_control_msg.base.type = CONTROL_MESSAGE_TYPE_MODULE_REPLY;
+	global_control_msg.base.version = CONTROL_MESSAGE_VERSION_CURRENT;
+	((CONTROL_MESSAGE_MODULE_REPLY*)&global_control_msg)->status = 0;
+	((CONTROL_MESSAGE_MODULE_REPLY*)&global_control_msg)->message_version = GATEWAY_MESSAGE_VERSION_2;
+	call_thread_function_on_join[1] = 1;
+
+	OUTPROCESS_MODULE_CONFIG config;
+	setup_create_config(&config);
+
+	MODULE_HANDLE module = Module_Create((BROKER_HANDLE)0x42, &config);
+	Module_Start(module);
+	MESSAGE_HANDLE msg = Message_Create((const MESSAGE_CONFIG*)(0x42));
+	umock_c_reset_all_calls();
+
+	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_pop_wait(IGNORED_PTR_ARG, IGNORED_NUM_ARG)).IgnoreAllArguments()
+		.SetReturn(msg);
+	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_pop_batch(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 31))
+		.IgnoreArgument(1).IgnoreArgument(2);
+	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Message_GetSerializedWithVersion(msg, GATEWAY_MESSAGE_VERSION_2, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+		.IgnoreArgument(3).IgnoreArgument(4);
 	STRICT_EXPECTED_CALL(nn_allocmsg(default_serialized_size, 0));
-	STRICT_EXPECTED_CALL(Message_ToByteArray(msg, IGNORED_PTR_ARG, default_serialized_size))
-		.IgnoreArgument(2);
 	STRICT_EXPECTED_CALL(nn_send(1, IGNORED_PTR_ARG, NN_MSG, 0)).IgnoreArgument(2);
 	STRICT_EXPECTED_CALL(Message_Destroy(msg));
-	STRICT_EXPECTED_CALL(ThreadAPI_Sleep(1));
 	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1)
 		.SetReturn(LOCK_ERROR);
 
@@ -3245,16 +3511,15 @@ TEST_FUNCTION(Outprocess_outgoing_thread_retries_when_nn_send_is_interrupted)
 
     STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1);
     STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(MESSAGE_QUEUE_is_empty(IGNORED_PTR_ARG)).IgnoreArgument(1)
-        .SetReturn(false);
-    STRICT_EXPECTED_CALL(MESSAGE_QUEUE_pop(IGNORED_PTR_ARG)).IgnoreArgument(1)
+    STRICT_EXPECTED_CALL(MESSAGE_QUEUE_pop_wait(IGNORED_PTR_ARG, IGNORED_NUM_ARG)).IgnoreAllArguments()
         .SetReturn(msg);
+    STRICT_EXPECTED_CALL(MESSAGE_QUEUE_pop_batch(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 31))
+        .IgnoreArgument(1).IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1);
     STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(Message_ToByteArray(msg, NULL, 0));
+    STRICT_EXPECTED_CALL(Message_GetSerializedWithVersion(msg, GATEWAY_MESSAGE_VERSION_1, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(3).IgnoreArgument(4);
     STRICT_EXPECTED_CALL(nn_allocmsg(default_serialized_size, 0));
-    STRICT_EXPECTED_CALL(Message_ToByteArray(msg, IGNORED_PTR_ARG, default_serialized_size))
-        .IgnoreArgument(2);
     should_nn_send_fail = false;
     current_nn_send_index = 0;
     when_shall_nn_send_fail = 1;
@@ -3262,7 +3527,6 @@ TEST_FUNCTION(Outprocess_outgoing_thread_retries_when_nn_send_is_interrupted)
     STRICT_EXPECTED_CALL(nn_errno()).SetReturn(EINTR);
     STRICT_EXPECTED_CALL(nn_send(1, IGNORED_PTR_ARG, NN_MSG, 0)).IgnoreArgument(2);
     STRICT_EXPECTED_CALL(Message_Destroy(msg));
-    STRICT_EXPECTED_CALL(ThreadAPI_Sleep(1));
     STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1)
         .SetReturn(LOCK_ERROR);
 
@@ -3292,24 +3556,22 @@ TEST_FUNCTION(Outprocess_outgoing_thread_nn_send_1st_unlock_fails)
 
 	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1);
-	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1);
-	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_is_empty(IGNORED_PTR_ARG)).IgnoreArgument(1)
-		.SetReturn(false);
-	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_pop(IGNORED_PTR_ARG)).IgnoreArgument(1)
+	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_pop_wait(IGNORED_PTR_ARG, IGNORED_NUM_ARG)).IgnoreAllArguments()
 		.SetReturn(msg);
+	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_pop_batch(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 31))
+		.IgnoreArgument(1).IgnoreArgument(2);
+	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1);
-	STRICT_EXPECTED_CALL(Message_ToByteArray(msg, NULL, 0));
+	STRICT_EXPECTED_CALL(Message_GetSerializedWithVersion(msg, GATEWAY_MESSAGE_VERSION_1, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+		.IgnoreArgument(3).IgnoreArgument(4);
 	STRICT_EXPECTED_CALL(nn_allocmsg(default_serialized_size, 0));
-	STRICT_EXPECTED_CALL(Message_ToByteArray(msg, IGNORED_PTR_ARG, default_serialized_size))
-		.IgnoreArgument(2);
 	should_nn_send_fail = true;
 	current_nn_send_index = 0;
 	when_shall_nn_send_fail = 1;
 	STRICT_EXPECTED_CALL(nn_send(1, IGNORED_PTR_ARG, NN_MSG, 0)).IgnoreArgument(2);
-    STRICT_EXPECTED_CALL(nn_errno());
+	STRICT_EXPECTED_CALL(nn_errno());
 	STRICT_EXPECTED_CALL(nn_freemsg(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(Message_Destroy(msg));
-	STRICT_EXPECTED_CALL(ThreadAPI_Sleep(1));
 	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1)
 		.SetReturn(LOCK_ERROR);
@@ -3327,7 +3589,7 @@ TEST_FUNCTION(Outprocess_outgoing_thread_nn_send_1st_unlock_fails)
 }
 
 /*Tests_SRS_OUTPROCESS_MODULE_17_053: [ This thread shall ensure thread safety on the module data. ]*/
-TEST_FUNCTION(Outprocess_outgoing_thread_nn_alloc_2nd_lock_fails)
+TEST_FUNCTION(Outprocess_outgoing_thread_serialize_fails_2nd_lock_fails)
 {
 	// arrange
 	OUTPROCESS_MODULE_CONFIG config;
@@ -3340,22 +3602,25 @@ TEST_FUNCTION(Outprocess_outgoing_thread_nn_alloc_2nd_lock_fails)
 
 	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1);
-	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1);
-	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_is_empty(IGNORED_PTR_ARG)).IgnoreArgument(1)
-		.SetReturn(false);
-	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_pop(IGNORED_PTR_ARG)).IgnoreArgument(1)
+	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_pop_wait(IGNORED_PTR_ARG, IGNORED_NUM_ARG)).IgnoreAllArguments()
 		.SetReturn(msg);
+	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_pop_batch(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 31))
+		.IgnoreArgument(1).IgnoreArgument(2);
+	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1);
-	STRICT_EXPECTED_CALL(Message_ToByteArray(msg, NULL, 0));
-	malloc_will_fail = true;
-	malloc_fail_count = malloc_count + 1;
-	STRICT_EXPECTED_CALL(nn_allocmsg(default_serialized_size, 0));
+	STRICT_EXPECTED_CALL(Message_GetSerializedWithVersion(msg, GATEWAY_MESSAGE_VERSION_1, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+		.IgnoreArgument(3).IgnoreArgument(4)
+		.SetReturn(1);
 	STRICT_EXPECTED_CALL(Message_Destroy(msg));
-	STRICT_EXPECTED_CALL(ThreadAPI_Sleep(1));
 	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_pop_wait(IGNORED_PTR_ARG, IGNORED_NUM_ARG)).IgnoreAllArguments()
+		.SetReturn(msg);
+	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_pop_batch(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 31))
+		.IgnoreArgument(1).IgnoreArgument(2);
 	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1)
 		.SetReturn(LOCK_ERROR);
+	STRICT_EXPECTED_CALL(Message_Destroy(msg));
 
 	// act
 	//third thread created is outgoing message thread
@@ -3383,22 +3648,26 @@ TEST_FUNCTION(Outprocess_outgoing_thread_serialize_2nd_unlock_fails)
 
 	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1);
-	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1);
-	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_is_empty(IGNORED_PTR_ARG)).IgnoreArgument(1)
-		.SetReturn(false);
-	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_pop(IGNORED_PTR_ARG)).IgnoreArgument(1)
+	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_pop_wait(IGNORED_PTR_ARG, IGNORED_NUM_ARG)).IgnoreAllArguments()
 		.SetReturn(msg);
+	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_pop_batch(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 31))
+		.IgnoreArgument(1).IgnoreArgument(2);
+	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1);
-	STRICT_EXPECTED_CALL(Message_ToByteArray(msg, NULL, 0)).SetReturn(-1);
+	STRICT_EXPECTED_CALL(Message_GetSerializedWithVersion(msg, GATEWAY_MESSAGE_VERSION_1, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+		.IgnoreArgument(3).IgnoreArgument(4)
+		.SetReturn(1);
 	STRICT_EXPECTED_CALL(Message_Destroy(msg));
-	STRICT_EXPECTED_CALL(ThreadAPI_Sleep(1));
 	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_pop_wait(IGNORED_PTR_ARG, IGNORED_NUM_ARG)).IgnoreAllArguments()
+		.SetReturn(msg);
+	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_pop_batch(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 31))
+		.IgnoreArgument(1).IgnoreArgument(2);
 	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1);
-	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_is_empty(IGNORED_PTR_ARG)).IgnoreArgument(1)
-		.SetReturn(true);
 	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1)
 		.SetReturn(LOCK_ERROR);
+	STRICT_EXPECTED_CALL(Message_Destroy(msg));
 
 	// act
 	//third thread created is outgoing message thread
@@ -3412,8 +3681,8 @@ TEST_FUNCTION(Outprocess_outgoing_thread_serialize_2nd_unlock_fails)
 	cleanup_create_config(&config);
 }
 
-/*Tests_SRS_OUTPROCESS_MODULE_17_054: [ This function shall remove the oldest message from the outgoing gateway message queue. ]*/
-TEST_FUNCTION(Outprocess_outgoing_thread_queue_has_null_msg_fails)
+/*Tests_SRS_OUTPROCESS_MODULE_17_054: [ This function shall remove the oldest message from the outgoing gateway message queue, sleeping on the queue for at most OUTPROCESS_OUTGOING_WAIT_MS milliseconds while it is empty. ]*/
+TEST_FUNCTION(Outprocess_outgoing_thread_waits_on_an_empty_queue_without_sleeping)
 {
 	// arrange
 	OUTPROCESS_MODULE_CONFIG config;
@@ -3426,12 +3695,10 @@ TEST_FUNCTION(Outprocess_outgoing_thread_queue_has_null_msg_fails)
 
 	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1);
 	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1);
-	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1);
-	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_is_empty(IGNORED_PTR_ARG)).IgnoreArgument(1)
-		.SetReturn(false);
-	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_pop(IGNORED_PTR_ARG)).IgnoreArgument(1)
+	STRICT_EXPECTED_CALL(MESSAGE_QUEUE_pop_wait(IGNORED_PTR_ARG, 100)).IgnoreArgument(1)
 		.SetReturn(NULL);
-	STRICT_EXPECTED_CALL(Unlock(IGNORED_PTR_ARG)).IgnoreArgument(1);
+	STRICT_EXPECTED_CALL(Lock(IGNORED_PTR_ARG)).IgnoreArgument(1)
+		.SetReturn(LOCK_ERROR);
 
 	// act
 	//third thread created is outgoing message thread
@@ -0,0 +1,740 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+static bool malloc_will_fail = false;
+static size_t malloc_fail_count = 0;
+static size_t malloc_count = 0;
+
+void* my_gballoc_malloc(size_t size)
+{
+    ++malloc_count;
+
+    void* result;
+    if (malloc_will_fail == true && malloc_count == malloc_fail_count)
+    {
+        result = NULL;
+    }
+    else
+    {
+        result = malloc(size);
+    }
+
+    return result;
+}
+
+void my_gballoc_free(void* ptr)
+{
+    free(ptr);
+}
+
+#include "testrunnerswitcher.h"
+#include "umock_c.h"
+#include "umock_c_negative_tests.h"
+#include "umocktypes_charptr.h"
+#include "umocktypes_bool.h"
+#include "umocktypes_stdint.h"
+
+#include "real_strings.h"
+
+#define ENABLE_MOCKS
+
+#define GATEWAY_EXPORT_H
+#define GATEWAY_EXPORT
+
+#include "azure_c_shared_utility/strings.h"
+#include "azure_c_shared_utility/gballoc.h"
+
+#include "parson.h"
+#include "module_loader.h"
+
+#undef ENABLE_MOCKS
+
+#include "module_loaders/static_loader.h"
+
+static pfModuleLoader_Load StaticModuleLoader_Load = NULL;
+static pfModuleLoader_Unload StaticModuleLoader_Unload = NULL;
+static pfModuleLoader_GetApi StaticModuleLoader_GetModuleApi = NULL;
+static pfModuleLoader_ParseEntrypointFromJson StaticModuleLoader_ParseEntrypointFromJson = NULL;
+static pfModuleLoader_FreeEntrypoint StaticModuleLoader_FreeEntrypoint = NULL;
+static pfModuleLoader_ParseConfigurationFromJson StaticModuleLoader_ParseConfigurationFromJson = NULL;
+static pfModuleLoader_FreeConfiguration StaticModuleLoader_FreeConfiguration = NULL;
+static pfModuleLoader_BuildModuleConfiguration StaticModuleLoader_BuildModuleConfiguration = NULL;
+static pfModuleLoader_FreeModuleConfiguration StaticModuleLoader_FreeModuleConfiguration = NULL;
+
+MOCKABLE_FUNCTION(, JSON_Object*, json_value_get_object, const JSON_Value*, value);
+MOCKABLE_FUNCTION(, const char*, json_object_get_string, const JSON_Object*, object, const char*, name);
+MOCKABLE_FUNCTION(, JSON_Value_Type, json_value_get_type, const JSON_Value*, value);
+
+//=============================================================================
+//Globals
+//=============================================================================
+
+static TEST_MUTEX_HANDLE g_dllByDll;
+static TEST_MUTEX_HANDLE g_testByTest;
+
+void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
+{
+    (void)error_code;
+    ASSERT_FAIL("umock_c reported error");
+}
+
+MOCK_FUNCTION_WITH_CODE(, MODULE_API*, Fake_GetAPI, MODULE_API_VERSION, gateway_api_version)
+MODULE_API* val = (MODULE_API*)0x42;
+MOCK_FUNCTION_END(val)
+
+MOCK_FUNCTION_WITH_CODE(, MODULE_API*, Other_GetAPI, MODULE_API_VERSION, gateway_api_version)
+MODULE_API* val = (MODULE_API*)0x42;
+MOCK_FUNCTION_END(val)
+
+//parson mocks
+MOCK_FUNCTION_WITH_CODE(, JSON_Object*, json_value_get_object, const JSON_Value*, value)
+    JSON_Object* obj = NULL;
+    if (value != NULL)
+    {
+        obj = (JSON_Object*)0x42;
+    }
+MOCK_FUNCTION_END(obj)
+
+MOCK_FUNCTION_WITH_CODE(, const char*, json_object_get_string, const JSON_Object*, object, const char*, name)
+    const char* str = NULL;
+    if (object != NULL && name != NULL)
+    {
+        str = "hello_world";
+    }
+MOCK_FUNCTION_END(str)
+
+MOCK_FUNCTION_WITH_CODE(, JSON_Value_Type, json_value_get_type, const JSON_Value*, value)
+    JSON_Value_Type val = JSONError;
+    if (value != NULL)
+    {
+        val = JSONString;
+    }
+MOCK_FUNCTION_END(val)
+
+#undef ENABLE_MOCKS
+
+/*the modules of the test executable, registered before main*/
+static const STATIC_LOADER_MODULE g_test_modules[] =
+{
+    { "hello_world", (pfModule_GetApi)Fake_GetAPI },
+    { "shadowed", (pfModule_GetApi)Fake_GetAPI }
+};
+
+STATIC_LOADER_REGISTER(g_test_modules)
+
+static const MODULE_LOADER g_static_loader =
+{
+    NATIVE_STATIC,
+    NULL, NULL, NULL
+};
+
+TEST_DEFINE_ENUM_TYPE(MODULE_LOADER_TYPE, MODULE_LOADER_TYPE_VALUES);
+
+BEGIN_TEST_SUITE(StaticLoader_UnitTests)
+
+TEST_SUITE_INITIALIZE(TestClassInitialize)
+{
+    TEST_INITIALIZE_MEMORY_DEBUG(g_dllByDll);
+    g_testByTest = TEST_MUTEX_CREATE();
+    ASSERT_IS_NOT_NULL(g_testByTest);
+
+    umock_c_init(on_umock_c_error);
+    umocktypes_charptr_register_types();
+    umocktypes_stdint_register_types();
+
+    REGISTER_UMOCK_ALIAS_TYPE(MODULE_LOADER_RESULT, int);
+    REGISTER_UMOCK_ALIAS_TYPE(MODULE_LOADER_TYPE, int);
+    REGISTER_UMOCK_ALIAS_TYPE(STRING_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(MODULE_LIBRARY_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(JSON_Value_Type, int);
+    REGISTER_UMOCK_ALIAS_TYPE(MODULE_API_VERSION, int);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(json_value_get_object, NULL);
+
+    // malloc/free hooks
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_malloc, my_gballoc_malloc);
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_free, my_gballoc_free);
+
+    // Strings hooks
+    REGISTER_GLOBAL_MOCK_HOOK(STRING_construct, real_STRING_construct);
+    REGISTER_GLOBAL_MOCK_HOOK(STRING_delete, real_STRING_delete);
+    REGISTER_GLOBAL_MOCK_HOOK(STRING_c_str, real_STRING_c_str);
+
+    const MODULE_LOADER* loader = StaticLoader_Get();
+    StaticModuleLoader_Load = loader->api->Load;
+    StaticModuleLoader_Unload = loader->api->Unload;
+    StaticModuleLoader_GetModuleApi = loader->api->GetApi;
+    StaticModuleLoader_ParseEntrypointFromJson = loader->api->ParseEntrypointFromJson;
+    StaticModuleLoader_FreeEntrypoint = loader->api->FreeEntrypoint;
+    StaticModuleLoader_ParseConfigurationFromJson = loader->api->ParseConfigurationFromJson;
+    StaticModuleLoader_FreeConfiguration = loader->api->FreeConfiguration;
+    StaticModuleLoader_BuildModuleConfiguration = loader->api->BuildModuleConfiguration;
+    StaticModuleLoader_FreeModuleConfiguration = loader->api->FreeModuleConfiguration;
+}
+
+TEST_SUITE_CLEANUP(TestClassCleanup)
+{
+    umock_c_deinit();
+
+    TEST_MUTEX_DESTROY(g_testByTest);
+    TEST_DEINITIALIZE_MEMORY_DEBUG(g_dllByDll);
+}
+
+TEST_FUNCTION_INITIALIZE(TestMethodInitialize)
+{
+    if (TEST_MUTEX_ACQUIRE(g_testByTest) != 0)
+    {
+        ASSERT_FAIL("our mutex is ABANDONED. Failure in test framework");
+    }
+
+    umock_c_reset_all_calls();
+    malloc_will_fail = false;
+    malloc_fail_count = 0;
+    malloc_count = 0;
+}
+
+TEST_FUNCTION_CLEANUP(TestMethodCleanup)
+{
+    TEST_MUTEX_RELEASE(g_testByTest);
+}
+
+//Tests_SRS_STATIC_MODULE_LOADER_17_001: [ StaticLoader_Register shall do nothing if registry is NULL. ]
+TEST_FUNCTION(StaticLoader_Register_does_nothing_when_registry_is_NULL)
+{
+    // act
+    StaticLoader_Register(NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+//Tests_SRS_STATIC_MODULE_LOADER_17_003: [ StaticModuleLoader_Load shall return NULL if loader or entrypoint is NULL. ]
+TEST_FUNCTION(StaticModuleLoader_Load_returns_NULL_when_loader_is_NULL)
+{
+    // act
+    MODULE_LIBRARY_HANDLE result = StaticModuleLoader_Load(NULL, (void*)0x42);
+
+    // assert
+    ASSERT_IS_NULL(result);
+}
+
+//Tests_SRS_STATIC_MODULE_LOADER_17_003: [ StaticModuleLoader_Load shall return NULL if loader or entrypoint is NULL. ]
+TEST_FUNCTION(StaticModuleLoader_Load_returns_NULL_when_entrypoint_is_NULL)
+{
+    // act
+    MODULE_LIBRARY_HANDLE result = StaticModuleLoader_Load(&g_static_loader, NULL);
+
+    // assert
+    ASSERT_IS_NULL(result);
+}
+
+//Tests_SRS_STATIC_MODULE_LOADER_17_004: [ StaticModuleLoader_Load shall return NULL if loader->type is not NATIVE_STATIC. ]
+TEST_FUNCTION(StaticModuleLoader_Load_returns_NULL_when_loader_type_is_not_NATIVE_STATIC)
+{
+    // arrange
+    MODULE_LOADER loader =
+    {
+        NATIVE,
+        NULL, NULL, NULL
+    };
+
+    // act
+    MODULE_LIBRARY_HANDLE result = StaticModuleLoader_Load(&loader, (void*)0x42);
+
+    // assert
+    ASSERT_IS_NULL(result);
+}
+
+//Tests_SRS_STATIC_MODULE_LOADER_17_005: [ StaticModuleLoader_Load shall return NULL if entrypoint->moduleName is NULL. ]
+TEST_FUNCTION(StaticModuleLoader_Load_returns_NULL_when_moduleName_is_NULL)
+{
+    // arrange
+    STATIC_LOADER_ENTRYPOINT entrypoint = { NULL };
+
+    // act
+    MODULE_LIBRARY_HANDLE result = StaticModuleLoader_Load(&g_static_loader, &entrypoint);
+
+    // assert
+    ASSERT_IS_NULL(result);
+}
+
+//Tests_SRS_STATIC_MODULE_LOADER_17_006: [ StaticModuleLoader_Load shall look up the Module_GetApi function registered under entrypoint->moduleName. ]
+//Tests_SRS_STATIC_MODULE_LOADER_17_007: [ StaticModuleLoader_Load shall return NULL if no module was registered under entrypoint->moduleName. ]
+TEST_FUNCTION(StaticModuleLoader_Load_returns_NULL_when_module_is_not_registered)
+{
+    // arrange
+    STATIC_LOADER_ENTRYPOINT entrypoint = { STRING_construct("not_linked") };
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(STRING_c_str(entrypoint.moduleName));
+
+    // act
+    MODULE_LIBRARY_HANDLE result = StaticModuleLoader_Load(&g_static_loader, &entrypoint);
+
+    // assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    STRING_delete(entrypoint.moduleName);
+}
+
+//Tests_SRS_STATIC_MODULE_LOADER_17_008: [ StaticModuleLoader_Load shall return NULL if an underlying platform call fails. ]
+TEST_FUNCTION(StaticModuleLoader_Load_returns_NULL_when_malloc_fails)
+{
+    // arrange
+    STATIC_LOADER_ENTRYPOINT entrypoint = { STRING_construct("hello_world") };
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(STRING_c_str(entrypoint.moduleName));
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+        .IgnoreArgument(1)
+        .SetReturn(NULL);
+
+    // act
+    MODULE_LIBRARY_HANDLE result = StaticModuleLoader_Load(&g_static_loader, &entrypoint);
+
+    // assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    STRING_delete(entrypoint.moduleName);
+}
+
+//Tests_SRS_STATIC_MODULE_LOADER_17_009: [ StaticModuleLoader_Load shall call the module's Module_GetApi function to acquire the module API table. ]
+//Tests_SRS_STATIC_MODULE_LOADER_17_010: [ StaticModuleLoader_Load shall return NULL if the MODULE_API pointer returned by the module is NULL, its version is greater than Module_ApiGatewayVersion or its Module_Create, Module_Destroy or Module_Receive function is NULL. ]
+TEST_FUNCTION(StaticModuleLoader_Load_returns_NULL_when_GetAPI_returns_NULL)
+{
+    // arrange
+    STATIC_LOADER_ENTRYPOINT entrypoint = { STRING_construct("hello_world") };
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(STRING_c_str(entrypoint.moduleName));
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(Fake_GetAPI(Module_ApiGatewayVersion))
+        .SetReturn(NULL);
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+
+    // act
+    MODULE_LIBRARY_HANDLE result = StaticModuleLoader_Load(&g_static_loader, &entrypoint);
+
+    // assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    STRING_delete(entrypoint.moduleName);
+}
+
+//Tests_SRS_STATIC_MODULE_LOADER_17_010: [ StaticModuleLoader_Load shall return NULL if the MODULE_API pointer returned by the module is NULL, its version is greater than Module_ApiGatewayVersion or its Module_Create, Module_Destroy or Module_Receive function is NULL. ]
+TEST_FUNCTION(StaticModuleLoader_Load_returns_NULL_when_GetAPI_returns_API_with_unsupported_version)
+{
+    // arrange
+    STATIC_LOADER_ENTRYPOINT entrypoint = { STRING_construct("hello_world") };
+    MODULE_API api =
+    {
+        (MODULE_API_VERSION)(Module_ApiGatewayVersion + 1)
+    };
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(STRING_c_str(entrypoint.moduleName));
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(Fake_GetAPI(Module_ApiGatewayVersion))
+        .SetReturn(&api);
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+
+    // act
+    MODULE_LIBRARY_HANDLE result = StaticModuleLoader_Load(&g_static_loader, &entrypoint);
+
+    // assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    STRING_delete(entrypoint.moduleName);
+}
+
+//Tests_SRS_STATIC_MODULE_LOADER_17_010: [ StaticModuleLoader_Load shall return NULL if the MODULE_API pointer returned by the module is NULL, its version is greater than Module_ApiGatewayVersion or its Module_Create, Module_Destroy or Module_Receive function is NULL. ]
+TEST_FUNCTION(StaticModuleLoader_Load_returns_NULL_when_GetAPI_returns_API_with_invalid_callbacks)
+{
+    // arrange
+    STATIC_LOADER_ENTRYPOINT entrypoint = { STRING_construct("hello_world") };
+    MODULE_API_1 apis[] =
+    {
+        { { MODULE_API_VERSION_1 }, NULL, NULL, NULL, (pfModule_Destroy)0x42, (pfModule_Receive)0x42, NULL },
+        { { MODULE_API_VERSION_1 }, NULL, NULL, (pfModule_Create)0x42, NULL, (pfModule_Receive)0x42, NULL },
+        { { MODULE_API_VERSION_1 }, NULL, NULL, (pfModule_Create)0x42, (pfModule_Destroy)0x42, NULL, NULL }
+    };
+
+    for (size_t i = 0; i < sizeof(apis) / sizeof(apis[0]); i++)
+    {
+        umock_c_reset_all_calls();
+
+        STRICT_EXPECTED_CALL(STRING_c_str(entrypoint.moduleName));
+        STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(Fake_GetAPI(Module_ApiGatewayVersion))
+            .SetReturn((MODULE_API*)&apis[i]);
+        STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+
+        // act
+        MODULE_LIBRARY_HANDLE result = StaticModuleLoader_Load(&g_static_loader, &entrypoint);
+
+        // assert
+        ASSERT_IS_NULL(result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    }
+
+    // cleanup
+    STRING_delete(entrypoint.moduleName);
+}
+
+//Tests_SRS_STATIC_MODULE_LOADER_17_002: [ StaticLoader_Register shall link registry in front of the registries already registered, without allocating. ]
+//Tests_SRS_STATIC_MODULE_LOADER_17_006: [ StaticModuleLoader_Load shall look up the Module_GetApi function registered under entrypoint->moduleName. ]
+//Tests_SRS_STATIC_MODULE_LOADER_17_009: [ StaticModuleLoader_Load shall call the module's Module_GetApi function to acquire the module API table. ]
+//Tests_SRS_STATIC_MODULE_LOADER_17_011: [ StaticModuleLoader_Load shall return a non-NULL pointer of type MODULE_LIBRARY_HANDLE when successful. ]
+TEST_FUNCTION(StaticModuleLoader_Load_succeeds)
+{
+    // arrange
+    STATIC_LOADER_ENTRYPOINT entrypoint = { STRING_construct("hello_world") };
+    MODULE_API_1 api =
+    {
+        {
+            MODULE_API_VERSION_1
+        },
+        NULL,
+        NULL,
+        (pfModule_Create)0x42,
+        (pfModule_Destroy)0x42,
+        (pfModule_Receive)0x42,
+        NULL
+    };
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(STRING_c_str(entrypoint.moduleName));
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(Fake_GetAPI(Module_ApiGatewayVersion))
+        .SetReturn((MODULE_API*)&api);
+
+    // act
+    MODULE_LIBRARY_HANDLE result = StaticModuleLoader_Load(&g_static_loader, &entrypoint);
+
+    // assert
+    ASSERT_IS_NOT_NULL(result);
+    ASSERT_IS_TRUE(StaticModuleLoader_GetModuleApi(&g_static_loader, result) == (const MODULE_API*)&api);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    StaticModuleLoader_Unload(&g_static_loader, result);
+    STRING_delete(entrypoint.moduleName);
+}
+
+//Tests_SRS_STATIC_MODULE_LOADER_17_002: [ StaticLoader_Register shall link registry in front of the registries already registered, without allocating. ]
+TEST_FUNCTION(StaticModuleLoader_Load_uses_the_module_registered_last)
+{
+    // arrange
+    static const STATIC_LOADER_MODULE modules[] =
+    {
+        { "shadowed", (pfModule_GetApi)Other_GetAPI }
+    };
+    static STATIC_LOADER_REGISTRY registry = { modules, 1, NULL };
+    STATIC_LOADER_ENTRYPOINT entrypoint = { STRING_construct("shadowed") };
+    MODULE_API_1 api =
+    {
+        {
+            MODULE_API_VERSION_1
+        },
+        NULL,
+        NULL,
+        (pfModule_Create)0x42,
+        (pfModule_Destroy)0x42,
+        (pfModule_Receive)0x42,
+        NULL
+    };
+    StaticLoader_Register(&registry);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(STRING_c_str(entrypoint.moduleName));
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(Other_GetAPI(Module_ApiGatewayVersion))
+        .SetReturn((MODULE_API*)&api);
+
+    // act
+    MODULE_LIBRARY_HANDLE result = StaticModuleLoader_Load(&g_static_loader, &entrypoint);
+
+    // assert
+    ASSERT_IS_NOT_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    StaticModuleLoader_Unload(&g_static_loader, result);
+    STRING_delete(entrypoint.moduleName);
+}
+
+//Tests_SRS_STATIC_MODULE_LOADER_17_012: [ StaticModuleLoader_GetModuleApi shall return NULL if moduleLibraryHandle is NULL. ]
+TEST_FUNCTION(StaticModuleLoader_GetModuleApi_returns_NULL_when_moduleLibraryHandle_is_NULL)
+{
+    // act
+    const MODULE_API* result = StaticModuleLoader_GetModuleApi(&g_static_loader, NULL);
+
+    // assert
+    ASSERT_IS_NULL(result);
+}
+
+//Tests_SRS_STATIC_MODULE_LOADER_17_014: [ StaticModuleLoader_Unload shall do nothing if moduleLibraryHandle is NULL. ]
+TEST_FUNCTION(StaticModuleLoader_Unload_does_nothing_when_moduleLibraryHandle_is_NULL)
+{
+    // act
+    StaticModuleLoader_Unload(&g_static_loader, NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+//Tests_SRS_STATIC_MODULE_LOADER_17_015: [ StaticModuleLoader_Unload shall deallocate the MODULE_LIBRARY_HANDLE. ]
+TEST_FUNCTION(StaticModuleLoader_Unload_frees_things)
+{
+    // arrange
+    STATIC_LOADER_ENTRYPOINT entrypoint = { STRING_construct("hello_world") };
+    MODULE_API_1 api =
+    {
+        {
+            MODULE_API_VERSION_1
+        },
+        NULL,
+        NULL,
+        (pfModule_Create)0x42,
+        (pfModule_Destroy)0x42,
+        (pfModule_Receive)0x42,
+        NULL
+    };
+    REGISTER_GLOBAL_MOCK_RETURN(Fake_GetAPI, (MODULE_API*)&api);
+    MODULE_LIBRARY_HANDLE handle = StaticModuleLoader_Load(&g_static_loader, &entrypoint);
+    ASSERT_IS_NOT_NULL(handle);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(gballoc_free(handle));
+
+    // act
+    StaticModuleLoader_Unload(&g_static_loader, handle);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    REGISTER_GLOBAL_MOCK_RETURN(Fake_GetAPI, (MODULE_API*)0x42);
+    STRING_delete(entrypoint.moduleName);
+}
+
+//Tests_SRS_STATIC_MODULE_LOADER_17_016: [ StaticModuleLoader_ParseEntrypointFromJson shall return NULL if json is NULL. ]
+TEST_FUNCTION(StaticModuleLoader_ParseEntrypointFromJson_returns_NULL_when_json_is_NULL)
+{
+    // act
+    void* result = StaticModuleLoader_ParseEntrypointFromJson(NULL, NULL);
+
+    // assert
+    ASSERT_IS_NULL(result);
+}
+
+//Tests_SRS_STATIC_MODULE_LOADER_17_017: [ StaticModuleLoader_ParseEntrypointFromJson shall return NULL if the root json entity is not an object. ]
+TEST_FUNCTION(StaticModuleLoader_ParseEntrypointFromJson_returns_NULL_when_json_is_not_an_object)
+{
+    // arrange
+    STRICT_EXPECTED_CALL(json_value_get_type((const JSON_Value*)0x42))
+        .SetReturn(JSONArray);
+
+    // act
+    void* result = StaticModuleLoader_ParseEntrypointFromJson(NULL, (const JSON_Value*)0x42);
+
+    // assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+//Tests_SRS_STATIC_MODULE_LOADER_17_019: [ StaticModuleLoader_ParseEntrypointFromJson shall read the name of the module from the attribute module.name. ]
+//Tests_SRS_STATIC_MODULE_LOADER_17_020: [ StaticModuleLoader_ParseEntrypointFromJson shall return NULL if module.name does not exist. ]
+TEST_FUNCTION(StaticModuleLoader_ParseEntrypointFromJson_returns_NULL_when_module_name_is_missing)
+{
+    // arrange
+    STRICT_EXPECTED_CALL(json_value_get_type((const JSON_Value*)0x42))
+        .SetReturn(JSONObject);
+    STRICT_EXPECTED_CALL(json_value_get_object((const JSON_Value*)0x42))
+        .SetReturn((JSON_Object*)0x43);
+    STRICT_EXPECTED_CALL(json_object_get_string((const JSON_Object*)0x43, "module.name"))
+        .SetReturn(NULL);
+
+    // act
+    void* result = StaticModuleLoader_ParseEntrypointFromJson(NULL, (const JSON_Value*)0x42);
+
+    // assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+//Tests_SRS_STATIC_MODULE_LOADER_17_018: [ StaticModuleLoader_ParseEntrypointFromJson shall return NULL if an underlying platform call fails. ]
+TEST_FUNCTION(StaticModuleLoader_ParseEntrypointFromJson_returns_NULL_when_things_fail)
+{
+    // arrange
+    int result = 0;
+    result = umock_c_negative_tests_init();
+    ASSERT_ARE_EQUAL(int, 0, result);
+
+    STRICT_EXPECTED_CALL(json_value_get_type((const JSON_Value*)0x42))
+        .SetReturn(JSONObject);
+    STRICT_EXPECTED_CALL(json_value_get_object((const JSON_Value*)0x42))
+        .SetReturn((JSON_Object*)0x43)
+        .SetFailReturn(NULL);
+    STRICT_EXPECTED_CALL(json_object_get_string((const JSON_Object*)0x43, "module.name"))
+        .SetReturn("hello_world");
+    STRICT_EXPECTED_CALL(gballoc_malloc(sizeof(STATIC_LOADER_ENTRYPOINT)))
+        .SetFailReturn(NULL);
+    STRICT_EXPECTED_CALL(STRING_construct("hello_world"))
+        .SetFailReturn(NULL);
+
+    umock_c_negative_tests_snapshot();
+
+    size_t calls_that_cannot_fail[] = { 0, 2 };
+
+    for (size_t i = 0; i < umock_c_negative_tests_call_count(); i++)
+    {
+        if (i == calls_that_cannot_fail[0] || i == calls_that_cannot_fail[1])
+        {
+            continue;
+        }
+
+        // arrange
+        umock_c_negative_tests_reset();
+        umock_c_negative_tests_fail_call(i);
+
+        // act
+        void* entrypoint = StaticModuleLoader_ParseEntrypointFromJson(NULL, (const JSON_Value*)0x42);
+
+        // assert
+        ASSERT_IS_NULL(entrypoint);
+    }
+
+    // cleanup
+    umock_c_negative_tests_deinit();
+}
+
+//Tests_SRS_STATIC_MODULE_LOADER_17_019: [ StaticModuleLoader_ParseEntrypointFromJson shall read the name of the module from the attribute module.name. ]
+//Tests_SRS_STATIC_MODULE_LOADER_17_021: [ StaticModuleLoader_ParseEntrypointFromJson shall return a non-NULL pointer to the parsed representation of the entrypoint when successful. ]
+TEST_FUNCTION(StaticModuleLoader_ParseEntrypointFromJson_succeeds)
+{
+    // arrange
+    STRICT_EXPECTED_CALL(json_value_get_type((const JSON_Value*)0x42))
+        .SetReturn(JSONObject);
+    STRICT_EXPECTED_CALL(json_value_get_object((const JSON_Value*)0x42))
+        .SetReturn((JSON_Object*)0x43);
+    STRICT_EXPECTED_CALL(json_object_get_string((const JSON_Object*)0x43, "module.name"))
+        .SetReturn("hello_world");
+    STRICT_EXPECTED_CALL(gballoc_malloc(sizeof(STATIC_LOADER_ENTRYPOINT)));
+    STRICT_EXPECTED_CALL(STRING_construct("hello_world"));
+
+    // act
+    void* result = StaticModuleLoader_ParseEntrypointFromJson(NULL, (const JSON_Value*)0x42);
+
+    // assert
+    ASSERT_IS_NOT_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(char_ptr, "hello_world", real_STRING_c_str(((STATIC_LOADER_ENTRYPOINT*)result)->moduleName));
+
+    // cleanup
+    StaticModuleLoader_FreeEntrypoint(NULL, result);
+}
+
+//Tests_SRS_STATIC_MODULE_LOADER_17_023: [ StaticModuleLoader_FreeEntrypoint shall do nothing if entrypoint is NULL. ]
+TEST_FUNCTION(StaticModuleLoader_FreeEntrypoint_does_nothing_when_entrypoint_is_NULL)
+{
+    // act
+    StaticModuleLoader_FreeEntrypoint(NULL, NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+//Tests_SRS_STATIC_MODULE_LOADER_17_022: [ StaticModuleLoader_FreeEntrypoint shall free resources allocated during StaticModuleLoader_ParseEntrypointFromJson. ]
+TEST_FUNCTION(StaticModuleLoader_FreeEntrypoint_frees_resources)
+{
+    // arrange
+    STRICT_EXPECTED_CALL(json_value_get_type((const JSON_Value*)0x42))
+        .SetReturn(JSONObject);
+    void* entrypoint = StaticModuleLoader_ParseEntrypointFromJson(NULL, (const JSON_Value*)0x42);
+    ASSERT_IS_NOT_NULL(entrypoint);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(STRING_delete(((STATIC_LOADER_ENTRYPOINT*)entrypoint)->moduleName));
+    STRICT_EXPECTED_CALL(gballoc_free(entrypoint));
+
+    // act
+    StaticModuleLoader_FreeEntrypoint(NULL, entrypoint);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+//Tests_SRS_STATIC_MODULE_LOADER_17_024: [ StaticModuleLoader_ParseConfigurationFromJson shall return NULL. ]
+TEST_FUNCTION(StaticModuleLoader_ParseConfigurationFromJson_returns_NULL)
+{
+    // act
+    MODULE_LOADER_BASE_CONFIGURATION* result = StaticModuleLoader_ParseConfigurationFromJson(NULL, (const JSON_Value*)0x42);
+
+    // assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+//Tests_SRS_STATIC_MODULE_LOADER_17_025: [ StaticModuleLoader_FreeConfiguration shall do nothing. ]
+TEST_FUNCTION(StaticModuleLoader_FreeConfiguration_does_nothing)
+{
+    // act
+    StaticModuleLoader_FreeConfiguration(NULL, (MODULE_LOADER_BASE_CONFIGURATION*)0x42);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+//Tests_SRS_STATIC_MODULE_LOADER_17_026: [ StaticModuleLoader_BuildModuleConfiguration shall return module_configuration. ]
+TEST_FUNCTION(StaticModuleLoader_BuildModuleConfiguration_returns_module_configuration)
+{
+    // act
+    void* result = StaticModuleLoader_BuildModuleConfiguration(NULL, NULL, (const void*)0x42);
+
+    // assert
+    ASSERT_IS_TRUE(result == (void*)0x42);
+}
+
+//Tests_SRS_STATIC_MODULE_LOADER_17_027: [ StaticModuleLoader_FreeModuleConfiguration shall do nothing. ]
+TEST_FUNCTION(StaticModuleLoader_FreeModuleConfiguration_does_nothing)
+{
+    // act
+    StaticModuleLoader_FreeModuleConfiguration(NULL, (const void*)0x42);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+//Tests_SRS_STATIC_MODULE_LOADER_17_028: [ StaticLoader_Get shall return a pointer to a MODULE_LOADER whose type is NATIVE_STATIC and whose name is the string static. ]
+TEST_FUNCTION(StaticLoader_Get_succeeds)
+{
+    // act
+    const MODULE_LOADER* loader = StaticLoader_Get();
+
+    // assert
+    ASSERT_IS_NOT_NULL(loader);
+    ASSERT_ARE_EQUAL(MODULE_LOADER_TYPE, NATIVE_STATIC, loader->type);
+    ASSERT_ARE_EQUAL(char_ptr, STATIC_LOADER_NAME, loader->name);
+}
+
+END_TEST_SUITE(StaticLoader_UnitTests);
@@ -0,0 +1,358 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "testrunnerswitcher.h"
+#include "umock_c.h"
+#include "azure_c_shared_utility/threadapi.h"
+
+static TEST_MUTEX_HANDLE g_dllByDll;
+static TEST_MUTEX_HANDLE g_testByTest;
+
+#include "timer_service.h"
+
+static size_t currentmalloc_call;
+static size_t whenShallmalloc_fail;
+
+static void* my_gballoc_malloc(size_t size)
+{
+    void* result;
+    currentmalloc_call++;
+    if (whenShallmalloc_fail > 0 && currentmalloc_call == whenShallmalloc_fail)
+    {
+        result = NULL;
+    }
+    else
+    {
+        result = malloc(size);
+    }
+    return result;
+}
+
+static void my_gballoc_free(void* ptr)
+{
+    free(ptr);
+}
+
+#define ENABLE_MOCKS
+#include "azure_c_shared_utility/gballoc.h"
+#undef ENABLE_MOCKS
+
+static void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
+{
+    (void)error_code;
+    ASSERT_FAIL("umock_c reported error");
+}
+
+/*the callbacks run on the service thread, the tests only read the counters once they waited long enough*/
+static volatile int fired;
+static volatile void* fired_context;
+static volatile bool slow_callback_returned;
+static TIMER_SERVICE_HANDLE self_cancel_service;
+static TIMER_HANDLE self_cancel_timer;
+
+static void count_callback(void* context)
+{
+    fired_context = context;
+    fired++;
+}
+
+static void self_cancel_callback(void* context)
+{
+    (void)context;
+    fired++;
+    TimerService_Cancel(self_cancel_service, self_cancel_timer);
+}
+
+static void slow_callback(void* context)
+{
+    (void)context;
+    fired++;
+    ThreadAPI_Sleep(200);
+    slow_callback_returned = true;
+}
+
+BEGIN_TEST_SUITE(timer_service_ut)
+
+    TEST_SUITE_INITIALIZE(TestClassInitialize)
+    {
+        TEST_INITIALIZE_MEMORY_DEBUG(g_dllByDll);
+        g_testByTest = TEST_MUTEX_CREATE();
+        ASSERT_IS_NOT_NULL(g_testByTest);
+
+        umock_c_init(on_umock_c_error);
+
+        REGISTER_GLOBAL_MOCK_HOOK(gballoc_malloc, my_gballoc_malloc);
+        REGISTER_GLOBAL_MOCK_HOOK(gballoc_free, my_gballoc_free);
+    }
+
+    TEST_SUITE_CLEANUP(TestClassCleanup)
+    {
+        TEST_MUTEX_DESTROY(g_testByTest);
+        umock_c_deinit();
+        TEST_DEINITIALIZE_MEMORY_DEBUG(g_dllByDll);
+    }
+
+    TEST_FUNCTION_INITIALIZE(TestMethodInitialize)
+    {
+        if (TEST_MUTEX_ACQUIRE(g_testByTest) != 0)
+        {
+            ASSERT_FAIL("our mutex is ABANDONED. Failure in test framework");
+        }
+
+        umock_c_reset_all_calls();
+
+        currentmalloc_call = 0;
+        whenShallmalloc_fail = 0;
+        fired = 0;
+        fired_context = NULL;
+        slow_callback_returned = false;
+        self_cancel_service = NULL;
+        self_cancel_timer = NULL;
+    }
+
+    TEST_FUNCTION_CLEANUP(TestMethodCleanup)
+    {
+        TEST_MUTEX_RELEASE(g_testByTest);
+    }
+
+    /*Tests_SRS_TIMER_SERVICE_17_001: [ TimerService_Create shall return a service with no timers and start its thread. ]*/
+    /*Tests_SRS_TIMER_SERVICE_17_004: [ TimerService_Destroy shall stop and join the service thread, then free every timer still in the service and the service. ]*/
+    TEST_FUNCTION(TimerService_Create_and_Destroy_succeed)
+    {
+        ///act
+        TIMER_SERVICE_HANDLE service = TimerService_Create();
+        TimerService_Destroy(service);
+
+        ///assert
+        ASSERT_IS_NOT_NULL(service);
+    }
+
+    /*Tests_SRS_TIMER_SERVICE_17_002: [ TimerService_Create shall return NULL if any underlying call fails. ]*/
+    TEST_FUNCTION(TimerService_Create_fails_when_malloc_fails)
+    {
+        ///arrange
+        whenShallmalloc_fail = 1;
+        STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+            .IgnoreArgument_size();
+
+        ///act
+        TIMER_SERVICE_HANDLE service = TimerService_Create();
+
+        ///assert
+        ASSERT_IS_NULL(service);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    }
+
+    /*Tests_SRS_TIMER_SERVICE_17_003: [ If service is NULL, TimerService_Destroy shall do nothing. ]*/
+    /*Tests_SRS_TIMER_SERVICE_17_005: [ If service or callback is NULL, TimerService_Schedule shall return NULL. ]*/
+    /*Tests_SRS_TIMER_SERVICE_17_012: [ If service or timer is NULL, TimerService_Cancel shall do nothing. ]*/
+    TEST_FUNCTION(TimerService_NULL_inputs_do_nothing)
+    {
+        ///arrange
+        TIMER_SERVICE_HANDLE service = TimerService_Create();
+        umock_c_reset_all_calls();
+
+        ///act
+        TimerService_Destroy(NULL);
+        TIMER_HANDLE null_service = TimerService_Schedule(NULL, 1, 0, count_callback, NULL);
+        TIMER_HANDLE null_callback = TimerService_Schedule(service, 1, 0, NULL, NULL);
+        TimerService_Cancel(NULL, (TIMER_HANDLE)0x42);
+        TimerService_Cancel(service, NULL);
+
+        ///assert
+        ASSERT_IS_NULL(null_service);
+        ASSERT_IS_NULL(null_callback);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///cleanup
+        TimerService_Destroy(service);
+    }
+
+    /*Tests_SRS_TIMER_SERVICE_17_007: [ TimerService_Schedule shall return NULL if any underlying call fails. ]*/
+    TEST_FUNCTION(TimerService_Schedule_fails_when_malloc_fails)
+    {
+        ///arrange
+        TIMER_SERVICE_HANDLE service = TimerService_Create();
+        umock_c_reset_all_calls();
+        whenShallmalloc_fail = currentmalloc_call + 1;
+
+        STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+            .IgnoreArgument_size();
+
+        ///act
+        TIMER_HANDLE timer = TimerService_Schedule(service, 1, 0, count_callback, NULL);
+
+        ///assert
+        ASSERT_IS_NULL(timer);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+        ///cleanup
+        TimerService_Destroy(service);
+    }
+
+    /*Tests_SRS_TIMER_SERVICE_17_006: [ TimerService_Schedule shall add a timer that is due delay_ms milliseconds from now to the service and return it. ]*/
+    /*Tests_SRS_TIMER_SERVICE_17_008: [ TimerService_Schedule shall wake the service thread if the timer is due before the thread would wake up. ]*/
+    /*Tests_SRS_TIMER_SERVICE_17_009: [ The service thread shall call the callback of every timer that is due with its context, calling all timers due in the same millisecond together. ]*/
+    /*Tests_SRS_TIMER_SERVICE_17_011: [ A one-shot timer shall not fire again. ]*/
+    TEST_FUNCTION(TimerService_one_shot_timer_fires_once)
+    {
+        ///arrange
+        TIMER_SERVICE_HANDLE service = TimerService_Create();
+
+        ///act
+        TIMER_HANDLE timer = TimerService_Schedule(service, 10, 0, count_callback, (void*)0x42);
+        ThreadAPI_Sleep(300);
+
+        ///assert
+        ASSERT_IS_NOT_NULL(timer);
+        ASSERT_ARE_EQUAL(int, 1, fired);
+        ASSERT_ARE_EQUAL(void_ptr, (void*)0x42, (void*)fired_context);
+
+        ///cleanup
+        TimerService_Cancel(service, timer);
+        TimerService_Destroy(service);
+    }
+
+    /*Tests_SRS_TIMER_SERVICE_17_010: [ Once the callback of a periodic timer returns, the service shall schedule it again period_ms after it was due, skipping the calls it fell behind on. ]*/
+    TEST_FUNCTION(TimerService_periodic_timer_fires_until_cancelled)
+    {
+        ///arrange
+        TIMER_SERVICE_HANDLE service = TimerService_Create();
+        TIMER_HANDLE timer = TimerService_Schedule(service, 0, 10, count_callback, NULL);
+        ThreadAPI_Sleep(300);
+
+        ///act
+        TimerService_Cancel(service, timer);
+        int fired_before_cancel = fired;
+        ThreadAPI_Sleep(100);
+
+        ///assert
+        ASSERT_IS_TRUE(fired_before_cancel >= 5);
+        ASSERT_ARE_EQUAL(int, fired_before_cancel, fired);
+
+        ///cleanup
+        TimerService_Destroy(service);
+    }
+
+    /*Tests_SRS_TIMER_SERVICE_17_006: [ TimerService_Schedule shall add a timer that is due delay_ms milliseconds from now to the service and return it. ]*/
+    TEST_FUNCTION(TimerService_timer_past_the_first_level_fires_on_time)
+    {
+        ///arrange
+        TIMER_SERVICE_HANDLE service = TimerService_Create();
+
+        ///act
+        TIMER_HANDLE timer = TimerService_Schedule(service, 500, 0, count_callback, NULL);
+        ThreadAPI_Sleep(250);
+        int fired_early = fired;
+        ThreadAPI_Sleep(750);
+
+        ///assert
+        ASSERT_ARE_EQUAL(int, 0, fired_early);
+        ASSERT_ARE_EQUAL(int, 1, fired);
+
+        ///cleanup
+        TimerService_Cancel(service, timer);
+        TimerService_Destroy(service);
+    }
+
+    /*Tests_SRS_TIMER_SERVICE_17_016: [ While the service has no timers, the service shall not process the milliseconds that pass one by one. ]*/
+    TEST_FUNCTION(TimerService_timer_scheduled_after_idle_fires_on_time)
+    {
+        ///arrange
+        TIMER_SERVICE_HANDLE service = TimerService_Create();
+        TIMER_HANDLE first = TimerService_Schedule(service, 0, 0, count_callback, NULL);
+        ThreadAPI_Sleep(100);
+        TimerService_Cancel(service, first);
+        ThreadAPI_Sleep(400);
+
+        ///act
+        TIMER_HANDLE timer = TimerService_Schedule(service, 200, 0, count_callback, NULL);
+        ThreadAPI_Sleep(100);
+        int fired_early = fired;
+        ThreadAPI_Sleep(400);
+
+        ///assert
+        ASSERT_ARE_EQUAL(int, 1, fired_early);
+        ASSERT_ARE_EQUAL(int, 2, fired);
+
+        ///cleanup
+        TimerService_Cancel(service, timer);
+        TimerService_Destroy(service);
+    }
+
+    /*Tests_SRS_TIMER_SERVICE_17_013: [ TimerService_Cancel shall remove timer from the service, so its callback is not called anymore, and free it. ]*/
+    TEST_FUNCTION(TimerService_Cancel_before_due_never_fires)
+    {
+        ///arrange
+        TIMER_SERVICE_HANDLE service = TimerService_Create();
+        TIMER_HANDLE timer = TimerService_Schedule(service, 100, 0, count_callback, NULL);
+
+        ///act
+        TimerService_Cancel(service, timer);
+        ThreadAPI_Sleep(300);
+
+        ///assert
+        ASSERT_ARE_EQUAL(int, 0, fired);
+
+        ///cleanup
+        TimerService_Destroy(service);
+    }
+
+    /*Tests_SRS_TIMER_SERVICE_17_015: [ If it is called from the callback of timer, TimerService_Cancel shall free timer once the callback returns. ]*/
+    TEST_FUNCTION(TimerService_Cancel_from_the_callback_stops_the_timer)
+    {
+        ///arrange
+        self_cancel_service = TimerService_Create();
+
+        ///act
+        self_cancel_timer = TimerService_Schedule(self_cancel_service, 0, 5, self_cancel_callback, NULL);
+        ThreadAPI_Sleep(200);
+
+        ///assert
+        ASSERT_ARE_EQUAL(int, 1, fired);
+
+        ///cleanup
+        TimerService_Destroy(self_cancel_service);
+    }
+
+    /*Tests_SRS_TIMER_SERVICE_17_014: [ If the callback of timer is running on the service thread, TimerService_Cancel shall wait for it to return. ]*/
+    TEST_FUNCTION(TimerService_Cancel_waits_for_a_running_callback)
+    {
+        ///arrange
+        TIMER_SERVICE_HANDLE service = TimerService_Create();
+        TIMER_HANDLE timer = TimerService_Schedule(service, 0, 0, slow_callback, NULL);
+        while (fired == 0)
+        {
+            ThreadAPI_Sleep(1);
+        }
+
+        ///act
+        TimerService_Cancel(service, timer);
+
+        ///assert
+        ASSERT_IS_TRUE(slow_callback_returned);
+
+        ///cleanup
+        TimerService_Destroy(service);
+    }
+
+    /*Tests_SRS_TIMER_SERVICE_17_004: [ TimerService_Destroy shall stop and join the service thread, then free every timer still in the service and the service. ]*/
+    TEST_FUNCTION(TimerService_Destroy_frees_pending_timers)
+    {
+        ///arrange
+        TIMER_SERVICE_HANDLE service = TimerService_Create();
+        (void)TimerService_Schedule(service, 10, 0, count_callback, NULL);
+        (void)TimerService_Schedule(service, 100000, 0, count_callback, NULL);
+        (void)TimerService_Schedule(service, 100000000, 0, count_callback, NULL);
+
+        ///act
+        TimerService_Destroy(service);
+
+        ///assert
+        ASSERT_IS_TRUE(fired <= 1);
+    }
+
+END_TEST_SUITE(timer_service_ut)
@@ -64,8 +64,8 @@ static size_t whenShallConstMap_Create_fail;
 static size_t currentConstMap_Clone_call;
 static size_t whenShallConstMap_Clone_fail;
 
-static size_t currentConstMap_CloneWriteable_call;
-static size_t whenShallConstMap_CloneWriteable_fail;
+static size_t currentMap_Create_call;
+static size_t whenShallMap_Create_fail;
 
 static size_t currentCONSTBUFFER_Create_call;
 static size_t whenShallCONSTBUFFER_Create_fail;
@@ -204,15 +204,6 @@ TYPED_MOCK_CLASS(CIdentitymapMocks, CGlobalMock)
         }
         MOCK_METHOD_END(CONSTMAP_HANDLE, result3)
 
-    MOCK_STATIC_METHOD_1(, MAP_HANDLE, ConstMap_CloneWriteable, CONSTMAP_HANDLE, handle)
-        MAP_HANDLE result4;
-        currentConstMap_CloneWriteable_call++;
-        if (currentConstMap_CloneWriteable_call == whenShallConstMap_CloneWriteable_fail)
-            result4 = NULL;
-        else
-            result4 = (MAP_HANDLE)(new RefCountObject());
-    MOCK_METHOD_END(MAP_HANDLE, result4)
-
     MOCK_STATIC_METHOD_1(, void, ConstMap_Destroy, CONSTMAP_HANDLE, map)
         ((RefCountObject*)map)->dec_ref();
     MOCK_VOID_METHOD_END()
@@ -271,6 +262,16 @@ TYPED_MOCK_CLASS(CIdentitymapMocks, CGlobalMock)
 
     // Map related
 
+    // Map_Create
+    MOCK_STATIC_METHOD_1(, MAP_HANDLE, Map_Create, MAP_FILTER_CALLBACK, mapFilterFunc)
+        MAP_HANDLE result4;
+        currentMap_Create_call++;
+        if (currentMap_Create_call == whenShallMap_Create_fail)
+            result4 = NULL;
+        else
+            result4 = (MAP_HANDLE)(new RefCountObject());
+    MOCK_METHOD_END(MAP_HANDLE, result4)
+
     // Map_Clone
     MOCK_STATIC_METHOD_1(, MAP_HANDLE, Map_Clone, MAP_HANDLE, sourceMap)
         ((RefCountObject*)sourceMap)->inc_ref();
@@ -295,16 +296,12 @@ TYPED_MOCK_CLASS(CIdentitymapMocks, CGlobalMock)
         }
     MOCK_METHOD_END(MAP_RESULT, result7)
 
-    // Map_Delete
-    MOCK_STATIC_METHOD_2(, MAP_RESULT, Map_Delete, MAP_HANDLE, handle, const char*, key)
-    MOCK_METHOD_END(MAP_RESULT, MAP_OK)
-
     // Message
     MOCK_STATIC_METHOD_1(, MESSAGE_HANDLE, Message_Create, const MESSAGE_CONFIG*, cfg)
         MESSAGE_HANDLE result2 = (MESSAGE_HANDLE)(new RefCountObject());
     MOCK_METHOD_END(MESSAGE_HANDLE, result2)
 
-    MOCK_STATIC_METHOD_1(, MESSAGE_HANDLE, Message_CreateFromBuffer, const MESSAGE_BUFFER_CONFIG*, cfg)
+    MOCK_STATIC_METHOD_3(, MESSAGE_HANDLE, Message_CreateDerived, MESSAGE_HANDLE, parent, MAP_HANDLE, overrides, const char* const*, removedKeys)
         MESSAGE_HANDLE result1;
         currentMessage_call++;
         if (currentMessage_call == whenShallMessage_fail)
@@ -338,19 +335,6 @@ TYPED_MOCK_CLASS(CIdentitymapMocks, CGlobalMock)
         CONSTBUFFER* result1 = &messageContent;
     MOCK_METHOD_END(const CONSTBUFFER*, result1)
 
-    MOCK_STATIC_METHOD_1(, CONSTBUFFER_HANDLE, Message_GetContentHandle, MESSAGE_HANDLE, message)
-        CONSTBUFFER_HANDLE result1;
-        currentMessage_call++;
-        if (currentMessage_call == whenShallMessage_fail)
-        {
-            result1 = NULL;
-        }
-        else
-        {
-            result1 = CONSTBUFFER_Create(NULL, 0);
-        }
-    MOCK_METHOD_END(CONSTBUFFER_HANDLE, result1)
-
     MOCK_STATIC_METHOD_1(, void, Message_Destroy, MESSAGE_HANDLE, message)
         ((RefCountObject*)message)->dec_ref();
     MOCK_VOID_METHOD_END()
@@ -500,24 +484,22 @@ DECLARE_GLOBAL_MOCK_METHOD_3(CIdentitymapMocks, , BROKER_RESULT, Broker_Publish,
 DECLARE_GLOBAL_MOCK_METHOD_1(CIdentitymapMocks, , CONSTMAP_HANDLE, ConstMap_Create, MAP_HANDLE, sourceMap);
 DECLARE_GLOBAL_MOCK_METHOD_1(CIdentitymapMocks, , CONSTMAP_HANDLE, ConstMap_Clone, CONSTMAP_HANDLE, handle);
 DECLARE_GLOBAL_MOCK_METHOD_1(CIdentitymapMocks, , void, ConstMap_Destroy, CONSTMAP_HANDLE, map);
-DECLARE_GLOBAL_MOCK_METHOD_1(CIdentitymapMocks, , MAP_HANDLE, ConstMap_CloneWriteable, CONSTMAP_HANDLE, handle);
 DECLARE_GLOBAL_MOCK_METHOD_2(CIdentitymapMocks, , const char*, ConstMap_GetValue, CONSTMAP_HANDLE, handle, const char *, key);
 
 DECLARE_GLOBAL_MOCK_METHOD_2(CIdentitymapMocks, , CONSTBUFFER_HANDLE, CONSTBUFFER_Create, const unsigned char*, source, size_t, size);
 DECLARE_GLOBAL_MOCK_METHOD_1(CIdentitymapMocks, , CONSTBUFFER_HANDLE, CONSTBUFFER_Clone, CONSTBUFFER_HANDLE, constbufferHandle);
 DECLARE_GLOBAL_MOCK_METHOD_1(CIdentitymapMocks, , void, CONSTBUFFER_Destroy, CONSTBUFFER_HANDLE, constbufferHandle);
 
+DECLARE_GLOBAL_MOCK_METHOD_1(CIdentitymapMocks, , MAP_HANDLE, Map_Create, MAP_FILTER_CALLBACK, mapFilterFunc);
 DECLARE_GLOBAL_MOCK_METHOD_1(CIdentitymapMocks, , MAP_HANDLE, Map_Clone, MAP_HANDLE, sourceMap);
 DECLARE_GLOBAL_MOCK_METHOD_1(CIdentitymapMocks, , void, Map_Destroy, MAP_HANDLE, ptr);
 DECLARE_GLOBAL_MOCK_METHOD_3(CIdentitymapMocks, , MAP_RESULT, Map_AddOrUpdate, MAP_HANDLE, handle, const char*, key, const char*, value);
-DECLARE_GLOBAL_MOCK_METHOD_2(CIdentitymapMocks, , MAP_RESULT, Map_Delete, MAP_HANDLE, handle, const char*, key);
 
 DECLARE_GLOBAL_MOCK_METHOD_1(CIdentitymapMocks, , MESSAGE_HANDLE, Message_Create, const MESSAGE_CONFIG*, cfg);
-DECLARE_GLOBAL_MOCK_METHOD_1(CIdentitymapMocks, , MESSAGE_HANDLE, Message_CreateFromBuffer, const MESSAGE_BUFFER_CONFIG*, cfg);
+DECLARE_GLOBAL_MOCK_METHOD_3(CIdentitymapMocks, , MESSAGE_HANDLE, Message_CreateDerived, MESSAGE_HANDLE, parent, MAP_HANDLE, overrides, const char* const*, removedKeys);
 DECLARE_GLOBAL_MOCK_METHOD_1(CIdentitymapMocks, , MESSAGE_HANDLE, Message_Clone, MESSAGE_HANDLE, message);
 DECLARE_GLOBAL_MOCK_METHOD_1(CIdentitymapMocks, , CONSTMAP_HANDLE, Message_GetProperties, MESSAGE_HANDLE, message);
 DECLARE_GLOBAL_MOCK_METHOD_1(CIdentitymapMocks, , const CONSTBUFFER*, Message_GetContent, MESSAGE_HANDLE, message);
-DECLARE_GLOBAL_MOCK_METHOD_1(CIdentitymapMocks, , CONSTBUFFER_HANDLE, Message_GetContentHandle, MESSAGE_HANDLE, message);
 DECLARE_GLOBAL_MOCK_METHOD_1(CIdentitymapMocks, , void, Message_Destroy, MESSAGE_HANDLE, message);
 
 //parson
@@ -590,8 +572,8 @@ BEGIN_TEST_SUITE(idmap_ut)
         deviceKeyProperties = NULL;
         currentMessage_call = 0;
         whenShallMessage_fail = 0;
-        currentConstMap_CloneWriteable_call = 0;
-        whenShallConstMap_CloneWriteable_fail = 0;
+        currentMap_Create_call = 0;
+        whenShallMap_Create_fail = 0;
         currentMap_call = 0;
         whenShallMap_fail = 0;
         currentBrokerResult = BROKER_OK;
@@ -2329,58 +2311,8 @@ BEGIN_TEST_SUITE(idmap_ut)
         Broker_Destroy(broker);
 
     }
-
-    /*Tests_SRS_IDMAP_17_021: [If messageHandle properties does not contain "macAddress" property, then the function shall return.]*/
-    TEST_FUNCTION(IdentityMap_Receive_D2C_get_properties_2_fail)
-    {
-        ///Arrange
-        CIdentitymapMocks mocks;
-        const MODULE_API* theAPIS= Module_GetApi(MODULE_API_VERSION_1);
-
-        unsigned char fake;
-        BROKER_HANDLE broker = Broker_Create();
-        auto n = MODULE_CREATE(theAPIS)(broker, testVector2);
-
-        MESSAGE_CONFIG cfg = { 1, &fake, (MAP_HANDLE)&fake };
-        auto m = Message_Create(&cfg);
-
-        macAddressProperties = "aa:aa:bb:bb:cc:cc";
-        sourceProperties = GW_SOURCE_BLE_TELEMETRY;
-
-        mocks.ResetAllCalls();
-
-        STRICT_EXPECTED_CALL(mocks, Message_GetProperties(m));
-        STRICT_EXPECTED_CALL(mocks, ConstMap_Create(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, ConstMap_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_SOURCE_PROPERTY))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_MAC_ADDRESS_PROPERTY))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreAllArguments();
-        STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_DEVICENAME_PROPERTY))
-            .IgnoreArgument(1);
-
-        whenShallMessage_fail = 2;
-        STRICT_EXPECTED_CALL(mocks, Message_GetProperties(m));
-
-
-        ///Act
-        MODULE_RECEIVE(theAPIS)(n, m);
-
-        ///Assert
-        mocks.AssertActualAndExpectedCalls();
-
-        ///Ablution
-        Message_Destroy(m);
-        MODULE_DESTROY(theAPIS)(n);
-        Broker_Destroy(broker);
-
-    }
-
-    /*Tests_SRS_IDMAP_17_027: [If ConstMap_CloneWriteable fails, IdentityMap_Receive shall deallocate any resources and return.]*/
-    TEST_FUNCTION(IdentityMap_Receive_D2C_CloneWriteable_fails)
+    /*Tests_SRS_IDMAP_17_027: [If Map_Create fails, IdentityMap_Receive shall deallocate any resources and return.] */
+    TEST_FUNCTION(IdentityMap_Receive_D2C_Map_Create_fails)
     {
         ///Arrange
         CIdentitymapMocks mocks;
@@ -2411,11 +2343,8 @@ BEGIN_TEST_SUITE(idmap_ut)
         STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG)).IgnoreArgument(1);
         STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_DEVICENAME_PROPERTY))
             .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, Message_GetProperties(m));
-        whenShallConstMap_CloneWriteable_fail = 1;
-        STRICT_EXPECTED_CALL(mocks, ConstMap_CloneWriteable(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, ConstMap_Create(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, ConstMap_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
+        whenShallMap_Create_fail = 1;
+        STRICT_EXPECTED_CALL(mocks, Map_Create(IGNORED_PTR_ARG)).IgnoreArgument(1);
 
 
         ///Act
@@ -2463,13 +2392,8 @@ BEGIN_TEST_SUITE(idmap_ut)
         STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG)).IgnoreArgument(1);
         STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_DEVICENAME_PROPERTY))
             .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, Message_GetProperties(m));
-
-        STRICT_EXPECTED_CALL(mocks, ConstMap_CloneWriteable(IGNORED_PTR_ARG)).IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, Map_Create(IGNORED_PTR_ARG)).IgnoreArgument(1);
         STRICT_EXPECTED_CALL(mocks, Map_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(mocks, ConstMap_Create(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, ConstMap_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
         whenShallMap_fail = 1;
         STRICT_EXPECTED_CALL(mocks, Map_AddOrUpdate(IGNORED_PTR_ARG, GW_DEVICENAME_PROPERTY, "aNiceDevice")).IgnoreArgument(1);
 
@@ -2520,11 +2444,7 @@ BEGIN_TEST_SUITE(idmap_ut)
         STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG)).IgnoreArgument(1);
         STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_DEVICENAME_PROPERTY))
             .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, Message_GetProperties(m));
-        STRICT_EXPECTED_CALL(mocks, ConstMap_Create(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, ConstMap_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(mocks, ConstMap_CloneWriteable(IGNORED_PTR_ARG)).IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, Map_Create(IGNORED_PTR_ARG)).IgnoreArgument(1);
         STRICT_EXPECTED_CALL(mocks, Map_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
         whenShallMap_fail = 2;
         STRICT_EXPECTED_CALL(mocks, Map_AddOrUpdate(IGNORED_PTR_ARG, GW_DEVICENAME_PROPERTY, "aNiceDevice")).IgnoreArgument(1);
@@ -2577,10 +2497,7 @@ BEGIN_TEST_SUITE(idmap_ut)
         STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG)).IgnoreArgument(1);
         STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_DEVICENAME_PROPERTY))
             .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, Message_GetProperties(m));
-        STRICT_EXPECTED_CALL(mocks, ConstMap_Create(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, ConstMap_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, ConstMap_CloneWriteable(IGNORED_PTR_ARG)).IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, Map_Create(IGNORED_PTR_ARG)).IgnoreArgument(1);
         STRICT_EXPECTED_CALL(mocks, Map_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
         whenShallMap_fail = 3;
         STRICT_EXPECTED_CALL(mocks, Map_AddOrUpdate(IGNORED_PTR_ARG, GW_DEVICENAME_PROPERTY, "aNiceDevice")).IgnoreArgument(1);
@@ -2600,69 +2517,8 @@ BEGIN_TEST_SUITE(idmap_ut)
         Broker_Destroy(broker);
 
     }
-
-    /*Tests_SRS_IDMAP_17_035: [If cloning message content fails, IdentityMap_Receive shall deallocate all resources and return.]*/
-    TEST_FUNCTION(IdentityMap_Receive_D2C_Message_GetContent_fail)
-    {
-        ///Arrange
-        CIdentitymapMocks mocks;
-        const MODULE_API* theAPIS= Module_GetApi(MODULE_API_VERSION_1);
-        
-
-        unsigned char fake;
-        BROKER_HANDLE broker = Broker_Create();
-        auto n = MODULE_CREATE(theAPIS)(broker, testVector2);
-
-        MESSAGE_CONFIG cfg = { 1, &fake, (MAP_HANDLE)&fake };
-        auto m = Message_Create(&cfg);
-
-        macAddressProperties = "aa:aa:bb:bb:cc:cc";
-        sourceProperties = GW_SOURCE_BLE_TELEMETRY;
-
-        mocks.ResetAllCalls();
-
-
-        STRICT_EXPECTED_CALL(mocks, Message_GetProperties(m));
-        STRICT_EXPECTED_CALL(mocks, ConstMap_Create(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, ConstMap_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_SOURCE_PROPERTY))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_MAC_ADDRESS_PROPERTY))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreAllArguments();
-        STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_DEVICENAME_PROPERTY))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, Message_GetProperties(m));
-        STRICT_EXPECTED_CALL(mocks, ConstMap_Create(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, ConstMap_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, ConstMap_CloneWriteable(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, Map_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, Map_AddOrUpdate(IGNORED_PTR_ARG, GW_DEVICENAME_PROPERTY, "aNiceDevice")).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, Map_AddOrUpdate(IGNORED_PTR_ARG, GW_DEVICEKEY_PROPERTY, "aNiceKey")).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, Map_AddOrUpdate(IGNORED_PTR_ARG, GW_SOURCE_PROPERTY, GW_IDMAP_MODULE)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, Map_Delete(IGNORED_PTR_ARG, GW_MAC_ADDRESS_PROPERTY))
-            .IgnoreArgument(1);
-        whenShallMessage_fail = 3;
-        STRICT_EXPECTED_CALL(mocks, Message_GetContentHandle(m));
-
-
-        ///Act
-        MODULE_RECEIVE(theAPIS)(n, m);
-
-        ///Assert
-        mocks.AssertActualAndExpectedCalls();
-
-        ///Ablution
-        Message_Destroy(m);
-        MODULE_DESTROY(theAPIS)(n);
-        Broker_Destroy(broker);
-
-    }
-
     /*Tests_SRS_IDMAP_17_037: [If creating new message fails, IdentityMap_Receive shall deallocate all resources and return.]*/
-    TEST_FUNCTION(IdentityMap_Receive_D2C_Message_CreateFromBuffer_fail)
+    TEST_FUNCTION(IdentityMap_Receive_D2C_Message_CreateDerived_fail)
     {
         ///Arrange
         CIdentitymapMocks mocks;
@@ -2694,10 +2550,7 @@ BEGIN_TEST_SUITE(idmap_ut)
         STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG)).IgnoreArgument(1);
         STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_DEVICENAME_PROPERTY))
             .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, Message_GetProperties(m));
-        STRICT_EXPECTED_CALL(mocks, ConstMap_Create(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, ConstMap_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, ConstMap_CloneWriteable(IGNORED_PTR_ARG)).IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, Map_Create(IGNORED_PTR_ARG)).IgnoreArgument(1);
         STRICT_EXPECTED_CALL(mocks, Map_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
         STRICT_EXPECTED_CALL(mocks, Map_AddOrUpdate(IGNORED_PTR_ARG, GW_DEVICENAME_PROPERTY, "aNiceDevice"))
             .IgnoreArgument(1);
@@ -2705,14 +2558,10 @@ BEGIN_TEST_SUITE(idmap_ut)
             .IgnoreArgument(1);
         STRICT_EXPECTED_CALL(mocks, Map_AddOrUpdate(IGNORED_PTR_ARG, GW_SOURCE_PROPERTY, GW_IDMAP_MODULE))
             .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, Map_Delete(IGNORED_PTR_ARG, GW_MAC_ADDRESS_PROPERTY))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, Message_GetContentHandle(m));
-        whenShallMessage_fail = 4;
-        STRICT_EXPECTED_CALL(mocks, Message_CreateFromBuffer(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, CONSTBUFFER_Create(IGNORED_PTR_ARG, IGNORED_NUM_ARG))
-            .IgnoreAllArguments();
-        STRICT_EXPECTED_CALL(mocks, CONSTBUFFER_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
+        whenShallMessage_fail = 2;
+        STRICT_EXPECTED_CALL(mocks, Message_CreateDerived(m, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .IgnoreArgument(2)
+            .IgnoreArgument(3);
 
 
         ///Act
@@ -2762,10 +2611,7 @@ BEGIN_TEST_SUITE(idmap_ut)
         STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG)).IgnoreArgument(1);
         STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_DEVICENAME_PROPERTY))
             .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, Message_GetProperties(m));
-        STRICT_EXPECTED_CALL(mocks, ConstMap_Create(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, ConstMap_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, ConstMap_CloneWriteable(IGNORED_PTR_ARG)).IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, Map_Create(IGNORED_PTR_ARG)).IgnoreArgument(1);
         STRICT_EXPECTED_CALL(mocks, Map_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
         STRICT_EXPECTED_CALL(mocks, Map_AddOrUpdate(IGNORED_PTR_ARG, GW_DEVICENAME_PROPERTY, "aNiceDevice"))
             .IgnoreArgument(1);
@@ -2773,14 +2619,10 @@ BEGIN_TEST_SUITE(idmap_ut)
             .IgnoreArgument(1);
         STRICT_EXPECTED_CALL(mocks, Map_AddOrUpdate(IGNORED_PTR_ARG, GW_SOURCE_PROPERTY, GW_IDMAP_MODULE))
             .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, Map_Delete(IGNORED_PTR_ARG, GW_MAC_ADDRESS_PROPERTY))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, Message_GetContentHandle(m));
-        STRICT_EXPECTED_CALL(mocks, Message_CreateFromBuffer(IGNORED_PTR_ARG)).IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, Message_CreateDerived(m, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .IgnoreArgument(2)
+            .IgnoreArgument(3);
         STRICT_EXPECTED_CALL(mocks, Message_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, CONSTBUFFER_Create(IGNORED_PTR_ARG, IGNORED_NUM_ARG))
-            .IgnoreAllArguments();
-        STRICT_EXPECTED_CALL(mocks, CONSTBUFFER_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
         currentBrokerResult = BROKER_ERROR;
         STRICT_EXPECTED_CALL(mocks, Broker_Publish(broker, n, IGNORED_PTR_ARG))
             .IgnoreArgument(3);
@@ -2798,9 +2640,15 @@ BEGIN_TEST_SUITE(idmap_ut)
         Broker_Destroy(broker);
 
     }
-
-    //Tests_SRS_IDMAP_17_054: [ If deleting the MAC Address fails, IdentityMap_Receive shall deallocate all resources and return. ]
-    TEST_FUNCTION(IdentityMap_Receive_D2C_macaddress_delete_fails)
+    /*Tests_SRS_IDMAP_17_026: [On a D2C message received, IdentityMap_Receive shall call Map_Create to hold the properties that the new message overrides.]*/
+    /*Tests_SRS_IDMAP_17_028: [IdentityMap_Receive shall call Map_AddOrUpdate with key of "deviceName" and value of found deviceId.]*/
+    /*Tests_SRS_IDMAP_17_032: [IdentityMap_Receive shall call Map_AddOrUpdate with key of "source" and value of "mapping".]*/
+    /*Tests_SRS_IDMAP_17_030: [IdentityMap_Receive shall call Map_AddOrUpdate with key of "deviceKey" and value of found deviceKey.]*/
+    /*Tests_SRS_IDMAP_17_053: [ IdentityMap_Receive shall remove the "macAddress" property from the new message. ]*/
+    /*Tests_SRS_IDMAP_17_036: [IdentityMap_Receive shall create a new message by calling Message_CreateDerived with the received message, the new map and the removed properties.]*/
+    /*Tests_SRS_IDMAP_17_038: [IdentityMap_Receive shall call Broker_Publish with broker and new message.]*/
+    /*Tests_SRS_IDMAP_17_039: [IdentityMap_Receive will destroy all resources it created.]*/
+    TEST_FUNCTION(IdentityMap_Receive_D2C_Success)
     {
         ///Arrange
         CIdentitymapMocks mocks;
@@ -2852,10 +2700,7 @@ BEGIN_TEST_SUITE(idmap_ut)
         STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG)).IgnoreArgument(1);
         STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_DEVICENAME_PROPERTY))
             .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, Message_GetProperties(m));
-        STRICT_EXPECTED_CALL(mocks, ConstMap_Create(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, ConstMap_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, ConstMap_CloneWriteable(IGNORED_PTR_ARG)).IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, Map_Create(IGNORED_PTR_ARG)).IgnoreArgument(1);
         STRICT_EXPECTED_CALL(mocks, Map_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
         STRICT_EXPECTED_CALL(mocks, Map_AddOrUpdate(IGNORED_PTR_ARG, GW_DEVICENAME_PROPERTY, "Sensor7"))
             .IgnoreArgument(1);
@@ -2863,9 +2708,12 @@ BEGIN_TEST_SUITE(idmap_ut)
             .IgnoreArgument(1);
         STRICT_EXPECTED_CALL(mocks, Map_AddOrUpdate(IGNORED_PTR_ARG, GW_SOURCE_PROPERTY, GW_IDMAP_MODULE))
             .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, Map_Delete(IGNORED_PTR_ARG, GW_MAC_ADDRESS_PROPERTY))
-            .IgnoreArgument(1)
-            .SetFailReturn((MAP_RESULT)MAP_KEYNOTFOUND);
+        STRICT_EXPECTED_CALL(mocks, Message_CreateDerived(m, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .IgnoreArgument(2)
+            .IgnoreArgument(3);
+        STRICT_EXPECTED_CALL(mocks, Message_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, Broker_Publish((BROKER_HANDLE)&fake, n, IGNORED_PTR_ARG))
+            .IgnoreArgument(3);
 
 
         ///Act
@@ -2881,16 +2729,14 @@ BEGIN_TEST_SUITE(idmap_ut)
 
     }
 
-    /*Tests_SRS_IDMAP_17_026: [On a message which passes all checks, IdentityMap_Receive shall call ConstMap_CloneWriteable on the message properties.]*/
-    /*Tests_SRS_IDMAP_17_028: [IdentityMap_Receive shall call Map_AddOrUpdate with key of "deviceName" and value of found deviceId.]*/
-    /*Tests_SRS_IDMAP_17_032: [IdentityMap_Receive shall call Map_AddOrUpdate with key of "source" and value of "mapping".]*/
-    /*Tests_SRS_IDMAP_17_030: [IdentityMap_Receive shall call Map_AddOrUpdate with key of "deviceKey" and value of found deviceKey.]*/
-    /*Tests_SRS_IDMAP_17_053: [ IdentityMap_Receive shall call Map_Delete to remove the "macAddress" property. ]*/
-    /*Tests_SRS_IDMAP_17_034: [IdentityMap_Receive shall clone message content.]*/
-    /*Tests_SRS_IDMAP_17_036: [IdentityMap_Receive shall create a new message by calling Message_Create with new map and cloned content.]*/
-    /*Tests_SRS_IDMAP_17_038: [IdentityMap_Receive shall call Broker_Publish with broker and new message.]*/
-    /*Tests_SRS_IDMAP_17_039: [IdentityMap_Receive will destroy all resources it created.]*/
-    TEST_FUNCTION(IdentityMap_Receive_D2C_Success)
+    //Tests_SRS_IDMAP_17_049: [ On a C2D message received, IdentityMap_Receive shall call Map_Create to hold the properties that the new message overrides. ]
+    //Tests_SRS_IDMAP_17_051: [ IdentityMap_Receive shall call Map_AddOrUpdate with key of "macAddress" and value of found macAddress. ]
+    //Tests_SRS_IDMAP_17_055: [ IdentityMap_Receive shall remove the "deviceName" property from the new message. ]
+    //Tests_SRS_IDMAP_17_057: [ IdentityMap_Receive shall remove the "deviceKey" property from the new message. ]
+    //Tests_SRS_IDMAP_17_032: [IdentityMap_Receive shall call Map_AddOrUpdate with key of "source" and value of "mapping".]
+    //Tests_SRS_IDMAP_17_036: [IdentityMap_Receive shall create a new message by calling Message_CreateDerived with the received message, the new map and the removed properties.]
+    //Tests_SRS_IDMAP_17_038: [IdentityMap_Receive shall call Broker_Publish with broker and new message.]
+    TEST_FUNCTION(IdentityMap_Receive_C2D_Success)
     {
         ///Arrange
         CIdentitymapMocks mocks;
@@ -2924,8 +2770,8 @@ BEGIN_TEST_SUITE(idmap_ut)
         MESSAGE_CONFIG cfg = { 1, &fake, (MAP_HANDLE)&fake };
         auto m = Message_Create(&cfg);
 
-        macAddressProperties = "07:07:07:07:07:07";
-        sourceProperties = GW_SOURCE_BLE_TELEMETRY;
+        deviceNameProperties = "Sensor7";
+        sourceProperties = GW_IOTHUB_MODULE;
 
         mocks.ResetAllCalls();
 
@@ -2935,32 +2781,19 @@ BEGIN_TEST_SUITE(idmap_ut)
         STRICT_EXPECTED_CALL(mocks, ConstMap_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
         STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_SOURCE_PROPERTY))
             .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_MAC_ADDRESS_PROPERTY))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .IgnoreAllArguments();
-        STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG)).IgnoreArgument(1);
         STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_DEVICENAME_PROPERTY))
             .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, Message_GetProperties(m));
-        STRICT_EXPECTED_CALL(mocks, ConstMap_Create(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, ConstMap_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, ConstMap_CloneWriteable(IGNORED_PTR_ARG)).IgnoreArgument(1);
+            
+        STRICT_EXPECTED_CALL(mocks, Map_Create(IGNORED_PTR_ARG)).IgnoreArgument(1);
         STRICT_EXPECTED_CALL(mocks, Map_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, Map_AddOrUpdate(IGNORED_PTR_ARG, GW_DEVICENAME_PROPERTY, "Sensor7"))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, Map_AddOrUpdate(IGNORED_PTR_ARG, GW_DEVICEKEY_PROPERTY, "theKeyFor7"))
+        STRICT_EXPECTED_CALL(mocks, Map_AddOrUpdate(IGNORED_PTR_ARG, GW_MAC_ADDRESS_PROPERTY, "07:07:07:07:07:07"))
             .IgnoreArgument(1);
         STRICT_EXPECTED_CALL(mocks, Map_AddOrUpdate(IGNORED_PTR_ARG, GW_SOURCE_PROPERTY, GW_IDMAP_MODULE))
             .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, Map_Delete(IGNORED_PTR_ARG, GW_MAC_ADDRESS_PROPERTY))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, Message_GetContentHandle(m));
-        STRICT_EXPECTED_CALL(mocks, Message_CreateFromBuffer(IGNORED_PTR_ARG)).IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, Message_CreateDerived(m, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+            .IgnoreArgument(2)
+            .IgnoreArgument(3);
         STRICT_EXPECTED_CALL(mocks, Message_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, CONSTBUFFER_Create(IGNORED_PTR_ARG, IGNORED_NUM_ARG))
-            .IgnoreAllArguments();
-        STRICT_EXPECTED_CALL(mocks, CONSTBUFFER_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
         STRICT_EXPECTED_CALL(mocks, Broker_Publish((BROKER_HANDLE)&fake, n, IGNORED_PTR_ARG))
             .IgnoreArgument(3);
 
@@ -2970,23 +2803,8 @@ BEGIN_TEST_SUITE(idmap_ut)
 
         ///Assert
         mocks.AssertActualAndExpectedCalls();
-
-        ///Ablution
-        Message_Destroy(m);
-        VECTOR_destroy(v);
-        MODULE_DESTROY(theAPIS)(n);
-
-    }
-
-    //Tests_SRS_IDMAP_17_049: [ On a C2D message received, IdentityMap_Receive shall call ConstMap_CloneWriteable on the message properties. ]
-    //Tests_SRS_IDMAP_17_051: [ IdentityMap_Receive shall call Map_AddOrUpdate with key of "macAddress" and value of found macAddress. ]
-    //Tests_SRS_IDMAP_17_055: [ IdentityMap_Receive shall call Map_Delete to remove the "deviceName" property. ]
-    //Tests_SRS_IDMAP_17_057: [ IdentityMap_Receive shall call Map_Delete to remove the "deviceKey" property. ]
-    //Tests_SRS_IDMAP_17_032: [IdentityMap_Receive shall call Map_AddOrUpdate with key of "source" and value of "mapping".]
-    //Tests_SRS_IDMAP_17_034: [IdentityMap_Receive shall clone message content.]
-    //Tests_SRS_IDMAP_17_036: [IdentityMap_Receive shall create a new message by calling Message_CreateFromBuffer with new map and cloned content.]
-    //Tests_SRS_IDMAP_17_038: [IdentityMap_Receive shall call Broker_Publish with broker and new message.]
-    TEST_FUNCTION(IdentityMap_Receive_C2D_Success)
+    //Tests_SRS_IDMAP_17_044: [ If messageHandle properties contains a "source" property that is set to "mapping", the message shall not be marked as a D2C message. ] 
+    TEST_FUNCTION(IdentityMap_Receive_C2D_MapUpdate_source_fails)
     {
         ///Arrange
         CIdentitymapMocks mocks;
@@ -3033,28 +2851,15 @@ BEGIN_TEST_SUITE(idmap_ut)
             .IgnoreArgument(1);
         STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_DEVICENAME_PROPERTY))
             .IgnoreArgument(1);
-            
-        STRICT_EXPECTED_CALL(mocks, Message_GetProperties(m));
-        STRICT_EXPECTED_CALL(mocks, ConstMap_Create(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, ConstMap_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, ConstMap_CloneWriteable(IGNORED_PTR_ARG)).IgnoreArgument(1);
+
+        STRICT_EXPECTED_CALL(mocks, Map_Create(IGNORED_PTR_ARG)).IgnoreArgument(1);
         STRICT_EXPECTED_CALL(mocks, Map_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
+
         STRICT_EXPECTED_CALL(mocks, Map_AddOrUpdate(IGNORED_PTR_ARG, GW_MAC_ADDRESS_PROPERTY, "07:07:07:07:07:07"))
             .IgnoreArgument(1);
         STRICT_EXPECTED_CALL(mocks, Map_AddOrUpdate(IGNORED_PTR_ARG, GW_SOURCE_PROPERTY, GW_IDMAP_MODULE))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, Map_Delete(IGNORED_PTR_ARG, GW_DEVICENAME_PROPERTY))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, Map_Delete(IGNORED_PTR_ARG, GW_DEVICEKEY_PROPERTY))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, Message_GetContentHandle(m));
-        STRICT_EXPECTED_CALL(mocks, Message_CreateFromBuffer(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, Message_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, CONSTBUFFER_Create(IGNORED_PTR_ARG, IGNORED_NUM_ARG))
-            .IgnoreAllArguments();
-        STRICT_EXPECTED_CALL(mocks, CONSTBUFFER_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, Broker_Publish((BROKER_HANDLE)&fake, n, IGNORED_PTR_ARG))
-            .IgnoreArgument(3);
+            .IgnoreArgument(1)
+            .SetFailReturn(MAP_ERROR);
 
 
         ///Act
@@ -3070,8 +2875,9 @@ BEGIN_TEST_SUITE(idmap_ut)
 
     }
 
-    //Tests_SRS_IDMAP_17_057: [ IdentityMap_Receive shall call Map_Delete to remove the "deviceKey" property. ]
-    TEST_FUNCTION(IdentityMap_Receive_C2D_no_key_key_delete)
+    //Tests_SRS_IDMAP_17_052: [ If adding macAddress fails, IdentityMap_Receive shall deallocate all resources and return. ]
+
+    TEST_FUNCTION(IdentityMap_Receive_C2D_MapUpdate_mac_fails)
     {
         ///Arrange
         CIdentitymapMocks mocks;
@@ -3119,28 +2925,12 @@ BEGIN_TEST_SUITE(idmap_ut)
         STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_DEVICENAME_PROPERTY))
             .IgnoreArgument(1);
 
-        STRICT_EXPECTED_CALL(mocks, Message_GetProperties(m));
-        STRICT_EXPECTED_CALL(mocks, ConstMap_Create(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, ConstMap_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, ConstMap_CloneWriteable(IGNORED_PTR_ARG)).IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, Map_Create(IGNORED_PTR_ARG)).IgnoreArgument(1);
         STRICT_EXPECTED_CALL(mocks, Map_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
+
         STRICT_EXPECTED_CALL(mocks, Map_AddOrUpdate(IGNORED_PTR_ARG, GW_MAC_ADDRESS_PROPERTY, "07:07:07:07:07:07"))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, Map_AddOrUpdate(IGNORED_PTR_ARG, GW_SOURCE_PROPERTY, GW_IDMAP_MODULE))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, Map_Delete(IGNORED_PTR_ARG, GW_DEVICENAME_PROPERTY))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, Map_Delete(IGNORED_PTR_ARG, GW_DEVICEKEY_PROPERTY))
             .IgnoreArgument(1)
-            .SetFailReturn((MAP_RESULT)MAP_KEYNOTFOUND);
-        STRICT_EXPECTED_CALL(mocks, Message_GetContentHandle(m));
-        STRICT_EXPECTED_CALL(mocks, Message_CreateFromBuffer(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, Message_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, CONSTBUFFER_Create(IGNORED_PTR_ARG, IGNORED_NUM_ARG))
-            .IgnoreAllArguments();
-        STRICT_EXPECTED_CALL(mocks, CONSTBUFFER_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, Broker_Publish((BROKER_HANDLE)&fake, n, IGNORED_PTR_ARG))
-            .IgnoreArgument(3);
+            .SetFailReturn(MAP_ERROR);
 
 
         ///Act
@@ -3156,8 +2946,8 @@ BEGIN_TEST_SUITE(idmap_ut)
 
     }
 
-    //Tests_SRS_IDMAP_17_058: [ If deleting the device key does not return MAP_OK or MAP_KEYNOTFOUND, IdentityMap_Receive shall deallocate all resources and return. ]
-    TEST_FUNCTION(IdentityMap_Receive_C2D_key_delete_fails)
+    //Tests_SRS_IDMAP_17_050: [ If Map_Create fails, IdentityMap_Receive shall deallocate any resources and return. ]
+    TEST_FUNCTION(IdentityMap_Receive_C2D_Map_Create_fails)
     {
         ///Arrange
         CIdentitymapMocks mocks;
@@ -3205,314 +2995,7 @@ BEGIN_TEST_SUITE(idmap_ut)
         STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_DEVICENAME_PROPERTY))
             .IgnoreArgument(1);
 
-        STRICT_EXPECTED_CALL(mocks, Message_GetProperties(m));
-        STRICT_EXPECTED_CALL(mocks, ConstMap_Create(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, ConstMap_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, ConstMap_CloneWriteable(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, Map_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, Map_AddOrUpdate(IGNORED_PTR_ARG, GW_MAC_ADDRESS_PROPERTY, "07:07:07:07:07:07"))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, Map_AddOrUpdate(IGNORED_PTR_ARG, GW_SOURCE_PROPERTY, GW_IDMAP_MODULE))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, Map_Delete(IGNORED_PTR_ARG, GW_DEVICENAME_PROPERTY))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, Map_Delete(IGNORED_PTR_ARG, GW_DEVICEKEY_PROPERTY))
-            .IgnoreArgument(1)
-            .SetFailReturn((MAP_RESULT)MAP_INVALIDARG);
-
-        ///Act
-        MODULE_RECEIVE(theAPIS)(n, m);
-
-        ///Assert
-        mocks.AssertActualAndExpectedCalls();
-
-        ///Ablution
-        Message_Destroy(m);
-        VECTOR_destroy(v);
-        MODULE_DESTROY(theAPIS)(n);
-
-    }
-
-    //Tests_SRS_IDMAP_17_056: [ If deleting the device name fails, IdentityMap_Receive shall deallocate all resources and return. ]
-    TEST_FUNCTION(IdentityMap_Receive_C2D_devicename_delete_fails)
-    {
-        ///Arrange
-        CIdentitymapMocks mocks;
-        const MODULE_API* theAPIS= Module_GetApi(MODULE_API_VERSION_1);
-        
-
-        unsigned char fake;
-        BROKER_HANDLE broker = (BROKER_HANDLE)&fake;
-        VECTOR_HANDLE v = VECTOR_create(sizeof(IDENTITY_MAP_CONFIG));
-
-        IDENTITY_MAP_CONFIG c1 = { "01:01:01:01:01:01", "Sensor1", "theKeyFor1" };
-        IDENTITY_MAP_CONFIG c2 = { "02:02:02:02:02:02", "Sensor2", "theKeyFor2" };
-        IDENTITY_MAP_CONFIG c3 = { "03:03:03:03:03:03", "Sensor3", "theKeyFor3" };
-        IDENTITY_MAP_CONFIG c4 = { "04:04:04:04:04:04", "Sensor4", "theKeyFor4" };
-        IDENTITY_MAP_CONFIG c5 = { "05:05:05:05:05:05", "Sensor5", "theKeyFor5" };
-        IDENTITY_MAP_CONFIG c6 = { "06:06:06:06:06:06", "Sensor6", "theKeyFor6" };
-        IDENTITY_MAP_CONFIG c7 = { "07:07:07:07:07:07", "Sensor7", "theKeyFor7" };
-        IDENTITY_MAP_CONFIG c8 = { "08:08:08:08:08:08", "Sensor8", "theKeyFor8" };
-        IDENTITY_MAP_CONFIG c9 = { "09:09:09:09:09:09", "Sensor9", "theKeyFor9" };
-        VECTOR_push_back(v, &c1, 1);
-        VECTOR_push_back(v, &c2, 1);
-        VECTOR_push_back(v, &c3, 1);
-        VECTOR_push_back(v, &c4, 1);
-        VECTOR_push_back(v, &c5, 1);
-        VECTOR_push_back(v, &c6, 1);
-        VECTOR_push_back(v, &c7, 1);
-        VECTOR_push_back(v, &c8, 1);
-        VECTOR_push_back(v, &c9, 1);
-        auto n = MODULE_CREATE(theAPIS)(broker, v);
-
-        MESSAGE_CONFIG cfg = { 1, &fake, (MAP_HANDLE)&fake };
-        auto m = Message_Create(&cfg);
-
-        deviceNameProperties = "Sensor7";
-        sourceProperties = GW_IOTHUB_MODULE;
-
-        mocks.ResetAllCalls();
-
-
-        STRICT_EXPECTED_CALL(mocks, Message_GetProperties(m));
-        STRICT_EXPECTED_CALL(mocks, ConstMap_Create(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, ConstMap_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_SOURCE_PROPERTY))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_DEVICENAME_PROPERTY))
-            .IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(mocks, Message_GetProperties(m));
-        STRICT_EXPECTED_CALL(mocks, ConstMap_Create(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, ConstMap_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, ConstMap_CloneWriteable(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, Map_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, Map_AddOrUpdate(IGNORED_PTR_ARG, GW_MAC_ADDRESS_PROPERTY, "07:07:07:07:07:07"))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, Map_AddOrUpdate(IGNORED_PTR_ARG, GW_SOURCE_PROPERTY, GW_IDMAP_MODULE))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, Map_Delete(IGNORED_PTR_ARG, GW_DEVICENAME_PROPERTY))
-            .IgnoreArgument(1)
-            .SetFailReturn((MAP_RESULT)MAP_INVALIDARG);
-
-        ///Act
-        MODULE_RECEIVE(theAPIS)(n, m);
-
-        ///Assert
-        mocks.AssertActualAndExpectedCalls();
-
-        ///Ablution
-        Message_Destroy(m);
-        VECTOR_destroy(v);
-        MODULE_DESTROY(theAPIS)(n);
-
-    }
-
-    //Tests_SRS_IDMAP_17_044: [ If messageHandle properties contains a "source" property that is set to "mapping", the message shall not be marked as a D2C message. ] 
-    TEST_FUNCTION(IdentityMap_Receive_C2D_MapUpdate_source_fails)
-    {
-        ///Arrange
-        CIdentitymapMocks mocks;
-        const MODULE_API* theAPIS= Module_GetApi(MODULE_API_VERSION_1);
-        
-
-        unsigned char fake;
-        BROKER_HANDLE broker = (BROKER_HANDLE)&fake;
-        VECTOR_HANDLE v = VECTOR_create(sizeof(IDENTITY_MAP_CONFIG));
-
-        IDENTITY_MAP_CONFIG c1 = { "01:01:01:01:01:01", "Sensor1", "theKeyFor1" };
-        IDENTITY_MAP_CONFIG c2 = { "02:02:02:02:02:02", "Sensor2", "theKeyFor2" };
-        IDENTITY_MAP_CONFIG c3 = { "03:03:03:03:03:03", "Sensor3", "theKeyFor3" };
-        IDENTITY_MAP_CONFIG c4 = { "04:04:04:04:04:04", "Sensor4", "theKeyFor4" };
-        IDENTITY_MAP_CONFIG c5 = { "05:05:05:05:05:05", "Sensor5", "theKeyFor5" };
-        IDENTITY_MAP_CONFIG c6 = { "06:06:06:06:06:06", "Sensor6", "theKeyFor6" };
-        IDENTITY_MAP_CONFIG c7 = { "07:07:07:07:07:07", "Sensor7", "theKeyFor7" };
-        IDENTITY_MAP_CONFIG c8 = { "08:08:08:08:08:08", "Sensor8", "theKeyFor8" };
-        IDENTITY_MAP_CONFIG c9 = { "09:09:09:09:09:09", "Sensor9", "theKeyFor9" };
-        VECTOR_push_back(v, &c1, 1);
-        VECTOR_push_back(v, &c2, 1);
-        VECTOR_push_back(v, &c3, 1);
-        VECTOR_push_back(v, &c4, 1);
-        VECTOR_push_back(v, &c5, 1);
-        VECTOR_push_back(v, &c6, 1);
-        VECTOR_push_back(v, &c7, 1);
-        VECTOR_push_back(v, &c8, 1);
-        VECTOR_push_back(v, &c9, 1);
-        auto n = MODULE_CREATE(theAPIS)(broker, v);
-
-        MESSAGE_CONFIG cfg = { 1, &fake, (MAP_HANDLE)&fake };
-        auto m = Message_Create(&cfg);
-
-        deviceNameProperties = "Sensor7";
-        sourceProperties = GW_IOTHUB_MODULE;
-
-        mocks.ResetAllCalls();
-
-
-        STRICT_EXPECTED_CALL(mocks, Message_GetProperties(m));
-        STRICT_EXPECTED_CALL(mocks, ConstMap_Create(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, ConstMap_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_SOURCE_PROPERTY))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_DEVICENAME_PROPERTY))
-            .IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(mocks, Message_GetProperties(m));
-        STRICT_EXPECTED_CALL(mocks, ConstMap_Create(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, ConstMap_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(mocks, ConstMap_CloneWriteable(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, Map_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(mocks, Map_AddOrUpdate(IGNORED_PTR_ARG, GW_MAC_ADDRESS_PROPERTY, "07:07:07:07:07:07"))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, Map_AddOrUpdate(IGNORED_PTR_ARG, GW_SOURCE_PROPERTY, GW_IDMAP_MODULE))
-            .IgnoreArgument(1)
-            .SetFailReturn(MAP_ERROR);
-
-
-        ///Act
-        MODULE_RECEIVE(theAPIS)(n, m);
-
-        ///Assert
-        mocks.AssertActualAndExpectedCalls();
-
-        ///Ablution
-        Message_Destroy(m);
-        VECTOR_destroy(v);
-        MODULE_DESTROY(theAPIS)(n);
-
-    }
-
-    //Tests_SRS_IDMAP_17_052: [ If adding macAddress fails, IdentityMap_Receive shall deallocate all resources and return. ]
-
-    TEST_FUNCTION(IdentityMap_Receive_C2D_MapUpdate_mac_fails)
-    {
-        ///Arrange
-        CIdentitymapMocks mocks;
-        const MODULE_API* theAPIS= Module_GetApi(MODULE_API_VERSION_1);
-        
-
-        unsigned char fake;
-        BROKER_HANDLE broker = (BROKER_HANDLE)&fake;
-        VECTOR_HANDLE v = VECTOR_create(sizeof(IDENTITY_MAP_CONFIG));
-
-        IDENTITY_MAP_CONFIG c1 = { "01:01:01:01:01:01", "Sensor1", "theKeyFor1" };
-        IDENTITY_MAP_CONFIG c2 = { "02:02:02:02:02:02", "Sensor2", "theKeyFor2" };
-        IDENTITY_MAP_CONFIG c3 = { "03:03:03:03:03:03", "Sensor3", "theKeyFor3" };
-        IDENTITY_MAP_CONFIG c4 = { "04:04:04:04:04:04", "Sensor4", "theKeyFor4" };
-        IDENTITY_MAP_CONFIG c5 = { "05:05:05:05:05:05", "Sensor5", "theKeyFor5" };
-        IDENTITY_MAP_CONFIG c6 = { "06:06:06:06:06:06", "Sensor6", "theKeyFor6" };
-        IDENTITY_MAP_CONFIG c7 = { "07:07:07:07:07:07", "Sensor7", "theKeyFor7" };
-        IDENTITY_MAP_CONFIG c8 = { "08:08:08:08:08:08", "Sensor8", "theKeyFor8" };
-        IDENTITY_MAP_CONFIG c9 = { "09:09:09:09:09:09", "Sensor9", "theKeyFor9" };
-        VECTOR_push_back(v, &c1, 1);
-        VECTOR_push_back(v, &c2, 1);
-        VECTOR_push_back(v, &c3, 1);
-        VECTOR_push_back(v, &c4, 1);
-        VECTOR_push_back(v, &c5, 1);
-        VECTOR_push_back(v, &c6, 1);
-        VECTOR_push_back(v, &c7, 1);
-        VECTOR_push_back(v, &c8, 1);
-        VECTOR_push_back(v, &c9, 1);
-        auto n = MODULE_CREATE(theAPIS)(broker, v);
-
-        MESSAGE_CONFIG cfg = { 1, &fake, (MAP_HANDLE)&fake };
-        auto m = Message_Create(&cfg);
-
-        deviceNameProperties = "Sensor7";
-        sourceProperties = GW_IOTHUB_MODULE;
-
-        mocks.ResetAllCalls();
-
-
-        STRICT_EXPECTED_CALL(mocks, Message_GetProperties(m));
-        STRICT_EXPECTED_CALL(mocks, ConstMap_Create(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, ConstMap_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_SOURCE_PROPERTY))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_DEVICENAME_PROPERTY))
-            .IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(mocks, Message_GetProperties(m));
-        STRICT_EXPECTED_CALL(mocks, ConstMap_Create(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, ConstMap_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(mocks, ConstMap_CloneWriteable(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, Map_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(mocks, Map_AddOrUpdate(IGNORED_PTR_ARG, GW_MAC_ADDRESS_PROPERTY, "07:07:07:07:07:07"))
-            .IgnoreArgument(1)
-            .SetFailReturn(MAP_ERROR);
-
-
-        ///Act
-        MODULE_RECEIVE(theAPIS)(n, m);
-
-        ///Assert
-        mocks.AssertActualAndExpectedCalls();
-
-        ///Ablution
-        Message_Destroy(m);
-        VECTOR_destroy(v);
-        MODULE_DESTROY(theAPIS)(n);
-
-    }
-
-    //Tests_SRS_IDMAP_17_050: [ If ConstMap_CloneWriteable fails, IdentityMap_Receive shall deallocate any resources and return. ]
-    TEST_FUNCTION(IdentityMap_Receive_C2D_clone_writeable_fails)
-    {
-        ///Arrange
-        CIdentitymapMocks mocks;
-        const MODULE_API* theAPIS= Module_GetApi(MODULE_API_VERSION_1);
-        
-
-        unsigned char fake;
-        BROKER_HANDLE broker = (BROKER_HANDLE)&fake;
-        VECTOR_HANDLE v = VECTOR_create(sizeof(IDENTITY_MAP_CONFIG));
-
-        IDENTITY_MAP_CONFIG c1 = { "01:01:01:01:01:01", "Sensor1", "theKeyFor1" };
-        IDENTITY_MAP_CONFIG c2 = { "02:02:02:02:02:02", "Sensor2", "theKeyFor2" };
-        IDENTITY_MAP_CONFIG c3 = { "03:03:03:03:03:03", "Sensor3", "theKeyFor3" };
-        IDENTITY_MAP_CONFIG c4 = { "04:04:04:04:04:04", "Sensor4", "theKeyFor4" };
-        IDENTITY_MAP_CONFIG c5 = { "05:05:05:05:05:05", "Sensor5", "theKeyFor5" };
-        IDENTITY_MAP_CONFIG c6 = { "06:06:06:06:06:06", "Sensor6", "theKeyFor6" };
-        IDENTITY_MAP_CONFIG c7 = { "07:07:07:07:07:07", "Sensor7", "theKeyFor7" };
-        IDENTITY_MAP_CONFIG c8 = { "08:08:08:08:08:08", "Sensor8", "theKeyFor8" };
-        IDENTITY_MAP_CONFIG c9 = { "09:09:09:09:09:09", "Sensor9", "theKeyFor9" };
-        VECTOR_push_back(v, &c1, 1);
-        VECTOR_push_back(v, &c2, 1);
-        VECTOR_push_back(v, &c3, 1);
-        VECTOR_push_back(v, &c4, 1);
-        VECTOR_push_back(v, &c5, 1);
-        VECTOR_push_back(v, &c6, 1);
-        VECTOR_push_back(v, &c7, 1);
-        VECTOR_push_back(v, &c8, 1);
-        VECTOR_push_back(v, &c9, 1);
-        auto n = MODULE_CREATE(theAPIS)(broker, v);
-
-        MESSAGE_CONFIG cfg = { 1, &fake, (MAP_HANDLE)&fake };
-        auto m = Message_Create(&cfg);
-
-        deviceNameProperties = "Sensor7";
-        sourceProperties = GW_IOTHUB_MODULE;
-
-        mocks.ResetAllCalls();
-
-
-        STRICT_EXPECTED_CALL(mocks, Message_GetProperties(m));
-        STRICT_EXPECTED_CALL(mocks, ConstMap_Create(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, ConstMap_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_SOURCE_PROPERTY))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_DEVICENAME_PROPERTY))
-            .IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(mocks, Message_GetProperties(m));
-        STRICT_EXPECTED_CALL(mocks, ConstMap_Create(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, ConstMap_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(mocks, ConstMap_CloneWriteable(IGNORED_PTR_ARG))
+        STRICT_EXPECTED_CALL(mocks, Map_Create(IGNORED_PTR_ARG))
             .IgnoreArgument(1)
             .SetFailReturn((MAP_HANDLE)NULL);
 
@@ -3529,72 +3012,6 @@ BEGIN_TEST_SUITE(idmap_ut)
         MODULE_DESTROY(theAPIS)(n);
 
     }
-
-    //Tests_SRS_IDMAP_17_046: [ If messageHandle properties does not contain a "source" property, then the message shall not be marked as a C2D message. ]
-    TEST_FUNCTION(IdentityMap_Receive_C2D_getproperties_fails)
-    {
-        ///Arrange
-        CIdentitymapMocks mocks;
-        const MODULE_API* theAPIS= Module_GetApi(MODULE_API_VERSION_1);
-        
-
-        unsigned char fake;
-        BROKER_HANDLE broker = (BROKER_HANDLE)&fake;
-        VECTOR_HANDLE v = VECTOR_create(sizeof(IDENTITY_MAP_CONFIG));
-
-        IDENTITY_MAP_CONFIG c1 = { "01:01:01:01:01:01", "Sensor1", "theKeyFor1" };
-        IDENTITY_MAP_CONFIG c2 = { "02:02:02:02:02:02", "Sensor2", "theKeyFor2" };
-        IDENTITY_MAP_CONFIG c3 = { "03:03:03:03:03:03", "Sensor3", "theKeyFor3" };
-        IDENTITY_MAP_CONFIG c4 = { "04:04:04:04:04:04", "Sensor4", "theKeyFor4" };
-        IDENTITY_MAP_CONFIG c5 = { "05:05:05:05:05:05", "Sensor5", "theKeyFor5" };
-        IDENTITY_MAP_CONFIG c6 = { "06:06:06:06:06:06", "Sensor6", "theKeyFor6" };
-        IDENTITY_MAP_CONFIG c7 = { "07:07:07:07:07:07", "Sensor7", "theKeyFor7" };
-        IDENTITY_MAP_CONFIG c8 = { "08:08:08:08:08:08", "Sensor8", "theKeyFor8" };
-        IDENTITY_MAP_CONFIG c9 = { "09:09:09:09:09:09", "Sensor9", "theKeyFor9" };
-        VECTOR_push_back(v, &c1, 1);
-        VECTOR_push_back(v, &c2, 1);
-        VECTOR_push_back(v, &c3, 1);
-        VECTOR_push_back(v, &c4, 1);
-        VECTOR_push_back(v, &c5, 1);
-        VECTOR_push_back(v, &c6, 1);
-        VECTOR_push_back(v, &c7, 1);
-        VECTOR_push_back(v, &c8, 1);
-        VECTOR_push_back(v, &c9, 1);
-        auto n = MODULE_CREATE(theAPIS)(broker, v);
-
-        MESSAGE_CONFIG cfg = { 1, &fake, (MAP_HANDLE)&fake };
-        auto m = Message_Create(&cfg);
-
-        deviceNameProperties = "Sensor7";
-        sourceProperties = GW_IOTHUB_MODULE;
-
-        mocks.ResetAllCalls();
-
-
-        STRICT_EXPECTED_CALL(mocks, Message_GetProperties(m));
-        STRICT_EXPECTED_CALL(mocks, ConstMap_Create(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, ConstMap_Destroy(IGNORED_PTR_ARG)).IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_SOURCE_PROPERTY))
-            .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(mocks, ConstMap_GetValue(IGNORED_PTR_ARG, GW_DEVICENAME_PROPERTY))
-            .IgnoreArgument(1);
-
-        STRICT_EXPECTED_CALL(mocks, Message_GetProperties(m))
-            .SetFailReturn((CONSTMAP_HANDLE)NULL);
-
-        ///Act
-        MODULE_RECEIVE(theAPIS)(n, m);
-
-        ///Assert
-        mocks.AssertActualAndExpectedCalls();
-
-        ///Ablution
-        Message_Destroy(m);
-        VECTOR_destroy(v);
-        MODULE_DESTROY(theAPIS)(n);
-
-    }
-
     //Tests_SRS_IDMAP_17_048: [ If the deviceName of the message is not found in deviceToMacArray, then the message shall not be marked as a C2D message. ]
     TEST_FUNCTION(IdentityMap_Receive_C2D_id_no_match_no_new_msg)
     {
@@ -4,23 +4,24 @@
 #include <stdlib.h>
 
 #include "simulated_device.h"
-#include "azure_c_shared_utility/threadapi.h"
 #include "azure_c_shared_utility/xlogging.h"
 #include "azure_c_shared_utility/crt_abstractions.h"
 #include "messageproperties.h"
 #include "message.h"
 #include "module.h"
 #include "broker.h"
+#include "timer_service.h"
 
 #include <parson.h>
 
 typedef struct SIMULATEDDEVICE_DATA_TAG
 {
     BROKER_HANDLE       broker;
-    THREAD_HANDLE       simulatedDeviceThread;
+    TIMER_SERVICE_HANDLE timerService;
+    TIMER_HANDLE        simulatedDeviceTimer;
     const char *        fakeMacAddress;
     unsigned int        messagePeriod;
-    unsigned int        simulatedDeviceRunning : 1;
+    double              additionalTemp;
 } SIMULATEDDEVICE_DATA;
 
 typedef struct SIMULATEDDEVICE_CONFIG_TAG
@@ -83,95 +84,83 @@ static void SimulatedDevice_Destroy(MODULE_HANDLE moduleHandle)
     else
     {
         SIMULATEDDEVICE_DATA* module_data = (SIMULATEDDEVICE_DATA*)moduleHandle;
-        int result;
 
-        /* Tell thread to stop */
-        module_data->simulatedDeviceRunning = 0;
-        /* join the thread */
-        ThreadAPI_Join(module_data->simulatedDeviceThread, &result);
+        /* stop the timer, this waits for a tick that is running */
+        if (module_data->simulatedDeviceTimer != NULL)
+        {
+            TimerService_Cancel(module_data->timerService, module_data->simulatedDeviceTimer);
+        }
         /* free module data */
         free((void*)module_data->fakeMacAddress);
         free(module_data);
     }
 }
 
-static int simulated_device_worker(void * user_data)
+static void simulated_device_tick(void * user_data)
 {
     SIMULATEDDEVICE_DATA* module_data = (SIMULATEDDEVICE_DATA*)user_data;
     double avgTemperature = 10.0;
-    double additionalTemp = 0.0;
     double maxSpeed = 40.0;
 
-    if (user_data != NULL)
+    MESSAGE_CONFIG newMessageCfg;
+    MAP_HANDLE newProperties = Map_Create(NULL);
+    if (newProperties == NULL)
     {
+        LogError("Failed to create message properties");
+    }
 
-        while (module_data->simulatedDeviceRunning)
+    else
+    {
+        if (Map_Add(newProperties, GW_SOURCE_PROPERTY, GW_SOURCE_BLE_TELEMETRY) != MAP_OK)
         {
-            ThreadAPI_Sleep(module_data -> messagePeriod);
+            LogError("Failed to set source property");
+        }
+        else if (Map_Add(newProperties, GW_MAC_ADDRESS_PROPERTY, module_data->fakeMacAddress) != MAP_OK)
+        {
+            LogError("Failed to set address property");
+        }
+        else
+        {
+            char msgText[128];
+
+            newMessageCfg.sourceProperties = newProperties;
+            if ((avgTemperature + module_data->additionalTemp) > maxSpeed)
+                module_data->additionalTemp = 0.0;
 
-            MESSAGE_CONFIG newMessageCfg;
-            MAP_HANDLE newProperties = Map_Create(NULL);
-            if (newProperties == NULL)
+            if (sprintf_s(msgText, sizeof(msgText), "{\"temperature\": %.2f}", avgTemperature + module_data->additionalTemp) < 0)
             {
-                LogError("Failed to create message properties");
+                LogError("Failed to set message text");
             }
-
             else
             {
-                if (Map_Add(newProperties, GW_SOURCE_PROPERTY, GW_SOURCE_BLE_TELEMETRY) != MAP_OK)
-                {
-                    LogError("Failed to set source property");
-                }
-                else if (Map_Add(newProperties, GW_MAC_ADDRESS_PROPERTY, module_data->fakeMacAddress) != MAP_OK)
+                (void)printf("Device: %s, Temperature: %.2f\r\n",
+                    module_data->fakeMacAddress,
+                    avgTemperature + module_data->additionalTemp
+                    );
+                (void)fflush(stdout);
+
+                newMessageCfg.size = strlen(msgText);
+                newMessageCfg.source = (const unsigned char*)msgText;
+
+                MESSAGE_HANDLE newMessage = Message_Create(&newMessageCfg);
+                if (newMessage == NULL)
                 {
-                    LogError("Failed to set address property");
+                    LogError("Failed to create new message");
                 }
                 else
                 {
-                    char msgText[128];
-
-                    newMessageCfg.sourceProperties = newProperties;
-                    if ((avgTemperature + additionalTemp) > maxSpeed)
-                        additionalTemp = 0.0;
-
-                    if (sprintf_s(msgText, sizeof(msgText), "{\"temperature\": %.2f}", avgTemperature + additionalTemp) < 0)
+                    if (Broker_Publish(module_data->broker, (MODULE_HANDLE)module_data, newMessage) != BROKER_OK)
                     {
-                        LogError("Failed to set message text");
+                        LogError("Failed to publish new message");
                     }
-                    else
-                    {
-                        (void)printf("Device: %s, Temperature: %.2f\r\n",
-                            module_data->fakeMacAddress,
-                            avgTemperature + additionalTemp
-                            );
-                        (void)fflush(stdout);
-
-                        newMessageCfg.size = strlen(msgText);
-                        newMessageCfg.source = (const unsigned char*)msgText;
 
-                        MESSAGE_HANDLE newMessage = Message_Create(&newMessageCfg);
-                        if (newMessage == NULL)
-                        {
-                            LogError("Failed to create new message");
-                        }
-                        else
-                        {
-                            if (Broker_Publish(module_data->broker, (MODULE_HANDLE)module_data, newMessage) != BROKER_OK)
-                            {
-                                LogError("Failed to publish new message");
-                            }
-
-                            additionalTemp += 1.0;
-                            Message_Destroy(newMessage);
-                        }
-                    }
+                    module_data->additionalTemp += 1.0;
+                    Message_Destroy(newMessage);
                 }
-                Map_Destroy(newProperties);
             }
         }
+        Map_Destroy(newProperties);
     }
-
-    return 0;
 }
 
 static void SimulatedDevice_Start(MODULE_HANDLE moduleHandle)
@@ -231,18 +220,24 @@ static void SimulatedDevice_Start(MODULE_HANDLE moduleHandle)
 
             SIMULATEDDEVICE_DATA* module_data = (SIMULATEDDEVICE_DATA*)moduleHandle;
             /* OK to start */
-            /* Create a fake data thread.  */
-            if (ThreadAPI_Create(
-                &(module_data->simulatedDeviceThread),
-                simulated_device_worker,
-                (void*)module_data) != THREADAPI_OK)
+            /* Send fake data from the gateway's shared timer thread. */
+            module_data->timerService = Broker_GetTimerService(module_data->broker);
+            if (module_data->timerService == NULL)
+            {
+                LogError("Broker_GetTimerService failed");
+            }
+            else if ((module_data->simulatedDeviceTimer = TimerService_Schedule(
+                module_data->timerService,
+                module_data->messagePeriod,
+                module_data->messagePeriod,
+                simulated_device_tick,
+                (void*)module_data)) == NULL)
             {
-                LogError("ThreadAPI_Create failed");
-                module_data->simulatedDeviceThread = NULL;
+                LogError("TimerService_Schedule failed");
             }
             else
             {
-                /* Thread started, module created, all complete.*/
+                /* Timer started, module created, all complete.*/
             }
     }
 }
@@ -268,8 +263,9 @@ static MODULE_HANDLE SimulatedDevice_Create(BROKER_HANDLE broker, const void* co
         {
             /* save the message broker */
             result->broker = broker;
-            /* set module is running to true */
-            result->simulatedDeviceRunning = 1;
+            result->timerService = NULL;
+            result->simulatedDeviceTimer = NULL;
+            result->additionalTemp = 0.0;
             /* save fake MacAddress */
             char * newFakeAddress;
             int status = mallocAndStrcpy_s(&newFakeAddress, config -> macAddress);
@@ -282,7 +278,6 @@ static MODULE_HANDLE SimulatedDevice_Create(BROKER_HANDLE broker, const void* co
             {
                 result->fakeMacAddress = newFakeAddress;
                 result -> messagePeriod = config -> messagePeriod;
-                result->simulatedDeviceThread = NULL;
 
             }
 
@@ -76,6 +76,7 @@ typedef struct REMOTE_MODULE_TAG {
     int message_socket;
     MESSAGE_THREAD_HANDLE message_thread;
     MODULE module;
+    uint8_t message_version;
 } REMOTE_MODULE;
 
 static size_t strnlen_(const char* s, size_t max)
@@ -157,6 +158,7 @@ ProxyGateway_Attach (
         LogError("%s: Unable to allocate memory!", __FUNCTION__);
     } else {
         static const size_t ENDPOINT_DECORATION_SIZE = sizeof("ipc://") - 1;
+        remote_module->message_version = GATEWAY_MESSAGE_VERSION_1;
 
         const size_t control_channel_uri_size = strlen(connection_id) + ENDPOINT_DECORATION_SIZE + 1;
         char * control_channel_uri;
@@ -467,13 +469,12 @@ Broker_Publish (
     else
     {
         // Send message_ to nanomsg
+        const unsigned char* serialized;
         int32_t msg_size;
-        int32_t buf_size;
         /* Codes_SRS_BROKER_17_007: [ Broker_Publish shall clone the message. ] */
         MESSAGE_HANDLE msg = Message_Clone(message);
-        /* Codes_SRS_BROKER_17_008: [ Broker_Publish shall serialize the message. ] */
-        msg_size = Message_ToByteArray(message, NULL, 0);
-        if (msg_size < 0)
+        /* Codes_SRS_BROKER_17_008: [ Broker_Publish shall serialize the message with the message version negotiated with the gateway by calling Message_GetSerializedWithVersion. ] */
+        if (Message_GetSerializedWithVersion(message, remote_module->message_version, &serialized, &msg_size) != 0)
         {
             /* Codes_SRS_BROKER_13_037: [ This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise. ] */
             LogError("unable to serialize a message [%p]", msg);
@@ -482,9 +483,8 @@ Broker_Publish (
         }
         else
         {
-            /* Codes_SRS_BROKER_17_025: [ Broker_Publish shall allocate a nanomsg buffer the size of the serialized message + sizeof(MODULE_HANDLE). ] */
-            buf_size = msg_size;
-            void* nn_msg = nn_allocmsg(buf_size, 0);
+            /* Codes_SRS_BROKER_17_025: [ Broker_Publish shall allocate a nanomsg buffer the size of the serialized message. ] */
+            void* nn_msg = nn_allocmsg((size_t)msg_size, 0);
             if (nn_msg == NULL)
             {
                 /* Codes_SRS_BROKER_13_037: [ This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise. ] */
@@ -493,17 +493,16 @@ Broker_Publish (
             }
             else
             {
-                unsigned char *nn_msg_bytes = (unsigned char *)nn_msg;
-                /* Codes_SRS_BROKER_17_027: [ Broker_Publish shall serialize the message into the remainder of the nanomsg buffer. ] */
-                Message_ToByteArray(message, nn_msg_bytes, msg_size);
+                /* Codes_SRS_BROKER_17_027: [ Broker_Publish shall copy the serialized message into the nanomsg buffer. ] */
+                memcpy(nn_msg, serialized, (size_t)msg_size);
 
-                /* Codes_SRS_BROKER_17_010: [ Broker_Publish shall send a message on the publish_socket. ] */
+                /* Codes_SRS_BROKER_17_010: [ Broker_Publish shall send the nanomsg buffer on the publish_socket, handing its ownership to nanomsg. ] */
                 int nbytes = nn_really_send(remote_module->message_socket, &nn_msg, NN_MSG, 0);
-                if (nbytes != buf_size)
+                if (nbytes != msg_size)
                 {
                     /* Codes_SRS_BROKER_13_037: [ This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise. ] */
                     LogError("unable to send a message [%p]", msg);
-                    /* Codes_SRS_BROKER_17_012: [ Broker_Publish shall free the message. ] */
+                    /* Codes_SRS_BROKER_17_011: [ Broker_Publish shall free the serialized message data if nanomsg did not take it. ] */
                     nn_freemsg(nn_msg);
                     result = BROKER_ERROR;
                 }
@@ -514,7 +513,6 @@ Broker_Publish (
             }
             /* Codes_SRS_BROKER_17_012: [ Broker_Publish shall free the message. ] */
             Message_Destroy(msg);
-            /* Codes_SRS_BROKER_17_011: [ Broker_Publish shall free the serialized message data. ] */
         }
 
     }
@@ -614,6 +612,12 @@ process_module_create_message (
         result = __LINE__;
         (void)send_control_reply(remote_module, (uint8_t)REMOTE_MODULE_GATEWAY_CONNECTION_ERROR);
     } else {
+        /* SRS_PROXY_GATEWAY_027_0xx: [`process_module_create_message` shall use the highest gateway message version supported by both the gateway (`max_message_version`) and the module host for the messages it exchanges with the gateway] */
+        remote_module->message_version =
+            (message->max_message_version > GATEWAY_MESSAGE_VERSION_MAX) ? GATEWAY_MESSAGE_VERSION_MAX :
+            (message->max_message_version < GATEWAY_MESSAGE_VERSION_1) ? GATEWAY_MESSAGE_VERSION_1 :
+            message->max_message_version;
+
         // Check to see if create has already been called
         if (NULL != remote_module->module.module_handle) {
             /* SRS_PROXY_GATEWAY_027_0xx: [Special Condition - If the creation process has already occurred, `process_module_create_message` shall destroy the module and disconnect from the message channel and continue processing the creation message] */
@@ -663,6 +667,7 @@ send_control_reply (
             .version = CONTROL_MESSAGE_VERSION_1,
         },
         .status = response,
+        .message_version = remote_module->message_version,
     };
     unsigned char * message_buffer = NULL;
     int32_t message_size;
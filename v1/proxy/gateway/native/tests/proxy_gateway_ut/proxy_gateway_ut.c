@@ -3,10 +3,12 @@
 #ifdef __cplusplus
   #include <cstdbool>
   #include <cstdlib>
+  #include <cstring>
   #include <ctime>
 #else
   #include <stdbool.h>
   #include <stdlib.h>
+  #include <string.h>
   #include <time.h>
 #endif
 
@@ -154,7 +156,7 @@ umockvalue_stringify_CONTROL_MESSAGE (
             const CONTROL_MESSAGE_MODULE_CREATE * value = (CONTROL_MESSAGE_MODULE_CREATE *)*value_;
             len = sprintf(
                 buffer,
-                "CONTROL_MESSAGE_MODULE_CREATE {\n\t.base {\n\t\t.type: %u\n\t\t.version: %u\n\t}\n\t.gateway_message_version: %u\n\t.uri {\n\t\t.uri_type: %u\n\t\t.uri_size: %u\n\t\t.uri: %s\n\t}\n\t.args_size: %u\n\t.args: %s\n}\n",
+                "CONTROL_MESSAGE_MODULE_CREATE {\n\t.base {\n\t\t.type: %u\n\t\t.version: %u\n\t}\n\t.gateway_message_version: %u\n\t.uri {\n\t\t.uri_type: %u\n\t\t.uri_size: %u\n\t\t.uri: %s\n\t}\n\t.args_size: %u\n\t.args: %s\n\t.max_message_version: %u\n}\n",
                 (uint8_t)value->base.type,
                 (uint8_t)value->base.version,
                 (uint8_t)value->gateway_message_version,
@@ -162,7 +164,8 @@ umockvalue_stringify_CONTROL_MESSAGE (
                 value->uri.uri_size,
                 value->uri.uri,
                 value->args_size,
-                value->args
+                value->args,
+                value->max_message_version
             );
 
             result = (char *)non_mocked_malloc(len + 1);
@@ -174,10 +177,11 @@ umockvalue_stringify_CONTROL_MESSAGE (
             const CONTROL_MESSAGE_MODULE_REPLY * value = (CONTROL_MESSAGE_MODULE_REPLY *)*value_;
             len = sprintf(
                 buffer,
-                "CONTROL_MESSAGE_MODULE_REPLY {\n\t.base {\n\t\t.type: %u\n\t\t.version: %u\n\t}\n\t.status: %u\n}\n",
+                "CONTROL_MESSAGE_MODULE_REPLY {\n\t.base {\n\t\t.type: %u\n\t\t.version: %u\n\t}\n\t.status: %u\n\t.message_version: %u\n}\n",
                 (uint8_t)value->base.type,
                 (uint8_t)value->base.version,
-                value->status
+                value->status,
+                value->message_version
             );
 
             result = (char *)non_mocked_malloc(len + 1);
@@ -247,6 +251,7 @@ umockvalue_are_equal_CONTROL_MESSAGE (
             match = (match && (!strcmp(left->uri.uri, right->uri.uri)));
             match = (match && (left->args_size == right->args_size));
             match = (match && (!strcmp(left->args, right->args)));
+            match = (match && (left->max_message_version == right->max_message_version));
             break;
           }
           case CONTROL_MESSAGE_TYPE_MODULE_REPLY:
@@ -258,6 +263,7 @@ umockvalue_are_equal_CONTROL_MESSAGE (
             match = (match && (left->base.type == right->base.type));
             match = (match && (left->base.version == right->base.version));
             match = (match && (left->status == right->status));
+            match = (match && (left->message_version == right->message_version));
             break;
           }
           case CONTROL_MESSAGE_TYPE_MODULE_DESTROY:
@@ -313,6 +319,7 @@ umockvalue_copy_CONTROL_MESSAGE (
                     destination->args_size = source->args_size;
                     destination->args = (char *)non_mocked_malloc(source->args_size);
                     strcpy(destination->args, source->args);
+                    destination->max_message_version = source->max_message_version;
                     result = 0;
                 }
             }
@@ -332,6 +339,7 @@ umockvalue_copy_CONTROL_MESSAGE (
                     destination->base.type = source->base.type;
                     destination->base.version = source->base.version;
                     destination->status = source->status;
+                    destination->message_version = source->message_version;
                     result = 0;
                 }
             }
@@ -1072,7 +1080,8 @@ TEST_FUNCTION(doWork_SCENARIO_create_message_success)
             CONTROL_MESSAGE_VERSION_1,
             CONTROL_MESSAGE_TYPE_MODULE_REPLY
         },
-        0
+        0,
+        GATEWAY_MESSAGE_VERSION_1
     };
 	EXPECTED_CALL(gballoc_calloc(1, IGNORED_NUM_ARG));
 	EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
@@ -1117,6 +1126,80 @@ TEST_FUNCTION(doWork_SCENARIO_create_message_success)
     ProxyGateway_Detach(remote_module);
 }
 
+/* Tests_SRS_PROXY_GATEWAY_027_031: [Control Channel - If the message type is CONTROL_MESSAGE_TYPE_MODULE_CREATE, then `ProxyGateway_DoWork` shall process the create message] */
+TEST_FUNCTION(doWork_SCENARIO_create_message_negotiates_message_version)
+{
+    // Arrange
+    CONTROL_MESSAGE_MODULE_CREATE CREATE_MESSAGE = {
+        {
+            CONTROL_MESSAGE_VERSION_CURRENT,
+            CONTROL_MESSAGE_TYPE_MODULE_CREATE
+        },
+        GATEWAY_MESSAGE_VERSION_CURRENT,
+        {
+            sizeof("ipc://message_channel"),
+            NN_PAIR,
+            "ipc://message_channel"
+        },
+        sizeof("json_encoded_remote_module_parameters"),
+        "json_encoded_remote_module_parameters",
+        GATEWAY_MESSAGE_VERSION_MAX + 1
+    };
+    static const void * NN_MESSAGE_BUFFER = (void *)0xEBADF00D;
+    static const int32_t NN_MESSAGE_SIZE = 1979;
+    static const MESSAGE_HANDLE MESSAGE = (MESSAGE_HANDLE)0x42;
+    static const MESSAGE_HANDLE MESSAGE_CLONE = (MESSAGE_HANDLE)0x43;
+    static const CONTROL_MESSAGE_MODULE_REPLY REPLY = {
+        {
+            CONTROL_MESSAGE_VERSION_1,
+            CONTROL_MESSAGE_TYPE_MODULE_REPLY
+        },
+        0,
+        GATEWAY_MESSAGE_VERSION_MAX
+    };
+
+    REMOTE_MODULE_HANDLE remote_module = ProxyGateway_Attach((MODULE_API *)&MOCK_MODULE_APIS, "proxy_gateway_ut");
+    ASSERT_IS_NOT_NULL(remote_module);
+
+    // Expected call listing
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(nn_recv(IGNORED_NUM_ARG, IGNORED_PTR_ARG, NN_MSG, NN_DONTWAIT))
+        .CopyOutArgumentBuffer(2, &NN_MESSAGE_BUFFER, sizeof(void *))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2)
+        .SetReturn(NN_MESSAGE_SIZE);
+    STRICT_EXPECTED_CALL(ControlMessage_CreateFromByteArray((const unsigned char *)NN_MESSAGE_BUFFER, IGNORED_NUM_ARG))
+        .IgnoreArgument(2)
+        .SetReturn((CONTROL_MESSAGE *)&CREATE_MESSAGE);
+    expected_calls_process_module_create_message(remote_module, &CREATE_MESSAGE, &REPLY);
+    STRICT_EXPECTED_CALL(ControlMessage_Destroy((CONTROL_MESSAGE *)&CREATE_MESSAGE));
+    STRICT_EXPECTED_CALL(nn_freemsg((void *)NN_MESSAGE_BUFFER));
+    STRICT_EXPECTED_CALL(nn_recv(IGNORED_NUM_ARG, IGNORED_PTR_ARG, NN_MSG, NN_DONTWAIT))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2)
+        .SetReturn(-1);
+    STRICT_EXPECTED_CALL(nn_errno())
+        .SetReturn(EAGAIN);
+    STRICT_EXPECTED_CALL(Message_Clone(MESSAGE))
+        .SetReturn(MESSAGE_CLONE);
+    STRICT_EXPECTED_CALL(Message_GetSerializedWithVersion(MESSAGE, GATEWAY_MESSAGE_VERSION_MAX, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(3)
+        .IgnoreArgument(4)
+        .SetReturn(1);
+    STRICT_EXPECTED_CALL(Message_Destroy(MESSAGE_CLONE));
+
+    // Act
+    ProxyGateway_DoWork(remote_module);
+    BROKER_RESULT result = Broker_Publish((BROKER_HANDLE)remote_module, MOCK_MODULE, MESSAGE);
+
+    // Assert
+    ASSERT_ARE_EQUAL(int, BROKER_ERROR, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // Cleanup
+    ProxyGateway_Detach(remote_module);
+}
+
 /* Tests_SRS_PROXY_GATEWAY_027_032: [Control Channel - If the message type is CONTROL_MESSAGE_TYPE_MODULE_START and `Module_Start` was provided, then `ProxyGateway_DoWork` shall call `void Module_Start(MODULE_HANDLE moduleHandle)`] */
 TEST_FUNCTION(doWork_SCENARIO_start_message_success)
 {
@@ -1142,7 +1225,8 @@ TEST_FUNCTION(doWork_SCENARIO_start_message_success)
             CONTROL_MESSAGE_VERSION_1,
             CONTROL_MESSAGE_TYPE_MODULE_REPLY
         },
-        0
+        0,
+        GATEWAY_MESSAGE_VERSION_1
     };
     static const CONTROL_MESSAGE START_MESSAGE = {
         CONTROL_MESSAGE_VERSION_CURRENT,
@@ -1287,7 +1371,8 @@ TEST_FUNCTION(doWork_SCENARIO_control_message_error)
             CONTROL_MESSAGE_VERSION_1,
             CONTROL_MESSAGE_TYPE_MODULE_REPLY
         },
-        1
+        1,
+        GATEWAY_MESSAGE_VERSION_1
     };
     static const void * NN_MESSAGE_BUFFER = (void *)0xEBADF00D;
 
@@ -1324,7 +1409,8 @@ TEST_FUNCTION(doWork_SCENARIO_control_message_bad_parse)
             CONTROL_MESSAGE_VERSION_1,
             CONTROL_MESSAGE_TYPE_MODULE_REPLY
         },
-        1
+        1,
+        GATEWAY_MESSAGE_VERSION_1
     };
     static const void * NN_MESSAGE_BUFFER = (void *)0xEBADF00D;
     static const int32_t NN_MESSAGE_SIZE = 1979;
@@ -1380,7 +1466,8 @@ TEST_FUNCTION(doWork_SCENARIO_gateway_message_not_available)
             CONTROL_MESSAGE_VERSION_1,
             CONTROL_MESSAGE_TYPE_MODULE_REPLY
         },
-        0
+        0,
+        GATEWAY_MESSAGE_VERSION_1
     };
 
     REMOTE_MODULE_HANDLE remote_module = ProxyGateway_Attach((MODULE_API *)&MOCK_MODULE_APIS, "proxy_gateway_ut");
@@ -1442,7 +1529,8 @@ TEST_FUNCTION(doWork_SCENARIO_gateway_message_bad_parse)
             CONTROL_MESSAGE_VERSION_1,
             CONTROL_MESSAGE_TYPE_MODULE_REPLY
         },
-        0
+        0,
+        GATEWAY_MESSAGE_VERSION_1
     };
 
     REMOTE_MODULE_HANDLE remote_module = ProxyGateway_Attach((MODULE_API *)&MOCK_MODULE_APIS, "proxy_gateway_ut");
@@ -1810,6 +1898,7 @@ TEST_FUNCTION(detach_SCENARIO_halt_not_called)
             CONTROL_MESSAGE_TYPE_MODULE_REPLY
         },
         (uint8_t)-1,
+        GATEWAY_MESSAGE_VERSION_1
     };
 
     int result;
@@ -1874,6 +1963,7 @@ TEST_FUNCTION(detach_SCENARIO_success)
             CONTROL_MESSAGE_TYPE_MODULE_REPLY
         },
         (uint8_t)-1,
+        GATEWAY_MESSAGE_VERSION_1
     };
 
     REMOTE_MODULE_HANDLE remote_module = ProxyGateway_Attach((MODULE_API *)&MOCK_MODULE_APIS, "proxy_gateway_ut");
@@ -1906,6 +1996,7 @@ TEST_FUNCTION(detach_SCENARIO_retries_shutdown_and_close_when_they_are_interrupt
             CONTROL_MESSAGE_TYPE_MODULE_REPLY
         },
         (uint8_t)-1,
+        GATEWAY_MESSAGE_VERSION_1
     };
 
     REMOTE_MODULE_HANDLE remote_module = ProxyGateway_Attach((MODULE_API *)&MOCK_MODULE_APIS, "proxy_gateway_ut");
@@ -1946,6 +2037,7 @@ TEST_FUNCTION(detach_SCENARIO_unable_to_halt_thread)
             CONTROL_MESSAGE_TYPE_MODULE_REPLY
         },
         (uint8_t)-1,
+        GATEWAY_MESSAGE_VERSION_1
     };
 
     int result;
@@ -2259,7 +2351,8 @@ TEST_FUNCTION(process_module_create_message_SCENARIO_bad_version)
             CONTROL_MESSAGE_VERSION_1,
             CONTROL_MESSAGE_TYPE_MODULE_REPLY
         },
-        1
+        1,
+        GATEWAY_MESSAGE_VERSION_1
     };
 
     int result;
@@ -2305,7 +2398,8 @@ TEST_FUNCTION(process_module_create_message_SCENARIO_already_created)
             CONTROL_MESSAGE_VERSION_1,
             CONTROL_MESSAGE_TYPE_MODULE_REPLY
         },
-        0
+        0,
+        GATEWAY_MESSAGE_VERSION_1
     };
 
     int result;
@@ -2359,7 +2453,8 @@ TEST_FUNCTION(process_module_create_message_SCENARIO_success)
             CONTROL_MESSAGE_VERSION_1,
             CONTROL_MESSAGE_TYPE_MODULE_REPLY
         },
-        0
+        0,
+        GATEWAY_MESSAGE_VERSION_1
     };
 
     int result;
@@ -2410,7 +2505,8 @@ TEST_FUNCTION(process_module_create_message_SCENARIO_negative_tests)
             CONTROL_MESSAGE_VERSION_1,
             CONTROL_MESSAGE_TYPE_MODULE_REPLY
         },
-        0
+        0,
+        GATEWAY_MESSAGE_VERSION_1
     };
 
     int result;
@@ -2458,7 +2554,8 @@ TEST_FUNCTION(send_control_reply_SCENARIO_success)
             CONTROL_MESSAGE_VERSION_1,
             CONTROL_MESSAGE_TYPE_MODULE_REPLY
         },
-        0
+        0,
+        GATEWAY_MESSAGE_VERSION_1
     };
 
     int result;
@@ -2496,7 +2593,8 @@ TEST_FUNCTION(send_control_reply_SCENARIO_negative_tests)
             CONTROL_MESSAGE_VERSION_1,
             CONTROL_MESSAGE_TYPE_MODULE_REPLY
         },
-        0
+        0,
+        GATEWAY_MESSAGE_VERSION_1
     };
 
     int result;
@@ -2532,15 +2630,15 @@ TEST_FUNCTION(send_control_reply_SCENARIO_negative_tests)
 }
 
 /* Tests_SRS_BROKER_17_007: [ Broker_Publish shall clone the message. ] */
-/* Tests_SRS_BROKER_17_008: [ Broker_Publish shall serialize the message. ] */
-/* Tests_SRS_BROKER_17_010: [ Broker_Publish shall send a message on the publish_socket. ] */
-/* Tests_SRS_BROKER_17_011: [ Broker_Publish shall free the serialized message data. ] */
+/* Tests_SRS_BROKER_17_008: [ Broker_Publish shall serialize the message with the message version negotiated with the gateway by calling Message_GetSerializedWithVersion. ] */
+/* Tests_SRS_BROKER_17_010: [ Broker_Publish shall send the nanomsg buffer on the publish_socket, handing its ownership to nanomsg. ] */
+/* Tests_SRS_BROKER_17_011: [ Broker_Publish shall free the serialized message data if nanomsg did not take it. ] */
 /* Tests_SRS_BROKER_17_012: [ Broker_Publish shall free the message. ] */
 /* Tests_SRS_BROKER_17_022: [ N/A - Broker_Publish shall Lock the modules lock. ] */
 /* Tests_SRS_BROKER_17_023: [ N/A - Broker_Publish shall Unlock the modules lock. ] */
-/* Tests_SRS_BROKER_17_025: [ Broker_Publish shall allocate a nanomsg buffer the size of the serialized message + sizeof(MODULE_HANDLE). ] */
+/* Tests_SRS_BROKER_17_025: [ Broker_Publish shall allocate a nanomsg buffer the size of the serialized message. ] */
 /* Tests_SRS_BROKER_17_026: [ N/A - Broker_Publish shall copy source into the beginning of the nanomsg buffer. ] */
-/* Tests_SRS_BROKER_17_027: [ Broker_Publish shall serialize the message into the remainder of the nanomsg buffer. ] */
+/* Tests_SRS_BROKER_17_027: [ Broker_Publish shall copy the serialized message into the nanomsg buffer. ] */
 /* Tests_SRS_BROKER_13_030: [ If broker or message is NULL the function shall return BROKER_INVALIDARG. ] */
 /* Tests_SRS_BROKER_13_037: [ This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise. ] */
 TEST_FUNCTION(publish_SCENARIO_create_message_success)
@@ -2567,7 +2665,8 @@ TEST_FUNCTION(publish_SCENARIO_create_message_success)
             CONTROL_MESSAGE_VERSION_1,
             CONTROL_MESSAGE_TYPE_MODULE_REPLY
         },
-        0
+        0,
+        GATEWAY_MESSAGE_VERSION_1
     };
 
     REMOTE_MODULE_HANDLE remote_module = ProxyGateway_Attach((MODULE_API *)&MOCK_MODULE_APIS, "proxy_gateway_ut");
@@ -2615,19 +2714,23 @@ TEST_FUNCTION(Broker_Publish_retries_nn_send_when_it_is_interrupted)
     memset(&data, 1, 100);
 
     static const int32_t msg_size = 100;
-    static const void* allocated_memptr = (void*)0xEBADF00D;
+    static unsigned char serialized_bytes[100];
+    static unsigned char allocated_bytes[100];
+    const unsigned char* serialized_memptr = serialized_bytes;
+    void* allocated_memptr = allocated_bytes;
+    memset(serialized_bytes, 0x42, sizeof(serialized_bytes));
 
     umock_c_reset_all_calls();
     STRICT_EXPECTED_CALL(Message_Clone(IGNORED_PTR_ARG))
         .IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(Message_ToByteArray(IGNORED_PTR_ARG, NULL, 0))
+    STRICT_EXPECTED_CALL(Message_GetSerializedWithVersion(IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreArgument(1)
-        .SetReturn(msg_size);
+        .IgnoreArgument(2)
+        .CopyOutArgumentBuffer(3, &serialized_memptr, sizeof(serialized_memptr))
+        .CopyOutArgumentBuffer(4, &msg_size, sizeof(msg_size))
+        .SetReturn(0);
     STRICT_EXPECTED_CALL(nn_allocmsg(msg_size, 0))
-        .SetReturn((void*)allocated_memptr);
-    STRICT_EXPECTED_CALL(Message_ToByteArray(IGNORED_PTR_ARG, IGNORED_PTR_ARG, msg_size))
-        .IgnoreArgument(1)
-        .IgnoreArgument(2);
+        .SetReturn(allocated_memptr);
     STRICT_EXPECTED_CALL(nn_send(IGNORED_NUM_ARG, IGNORED_PTR_ARG, NN_MSG, 0))
         .IgnoreArgument(1)
         .IgnoreArgument(2)
@@ -2646,6 +2749,120 @@ TEST_FUNCTION(Broker_Publish_retries_nn_send_when_it_is_interrupted)
 
     // Assert
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, 0, memcmp(allocated_bytes, serialized_bytes, sizeof(serialized_bytes)));
+
+    // Cleanup
+}
+
+/* Tests_SRS_BROKER_17_008: [ Broker_Publish shall serialize the message with the message version negotiated with the gateway by calling Message_GetSerializedWithVersion. ] */
+TEST_FUNCTION(Broker_Publish_sends_the_cached_serialization_to_every_remote_sink)
+{
+    // Arrange
+    int data[100];
+    int data2[100];
+    memset(&data, 1, 100);
+    memset(&data2, 1, 100);
+
+    static const int32_t msg_size = 100;
+    static unsigned char serialized_bytes[100];
+    static unsigned char allocated_bytes[100];
+    static unsigned char allocated_bytes2[100];
+    const unsigned char* serialized_memptr = serialized_bytes;
+    void* allocated_memptr = allocated_bytes;
+    void* allocated_memptr2 = allocated_bytes2;
+    memset(serialized_bytes, 0x42, sizeof(serialized_bytes));
+
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(Message_Clone(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(Message_GetSerializedWithVersion(IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2)
+        .CopyOutArgumentBuffer(3, &serialized_memptr, sizeof(serialized_memptr))
+        .CopyOutArgumentBuffer(4, &msg_size, sizeof(msg_size))
+        .SetReturn(0);
+    STRICT_EXPECTED_CALL(nn_allocmsg(msg_size, 0))
+        .SetReturn(allocated_memptr);
+    STRICT_EXPECTED_CALL(nn_send(IGNORED_NUM_ARG, IGNORED_PTR_ARG, NN_MSG, 0))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2)
+        .SetReturn(msg_size);
+    STRICT_EXPECTED_CALL(Message_Destroy(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(Message_Clone(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(Message_GetSerializedWithVersion(IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2)
+        .CopyOutArgumentBuffer(3, &serialized_memptr, sizeof(serialized_memptr))
+        .CopyOutArgumentBuffer(4, &msg_size, sizeof(msg_size))
+        .SetReturn(0);
+    STRICT_EXPECTED_CALL(nn_allocmsg(msg_size, 0))
+        .SetReturn(allocated_memptr2);
+    STRICT_EXPECTED_CALL(nn_send(IGNORED_NUM_ARG, IGNORED_PTR_ARG, NN_MSG, 0))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2)
+        .SetReturn(msg_size);
+    STRICT_EXPECTED_CALL(Message_Destroy(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+
+    // Act
+    BROKER_RESULT result = Broker_Publish((BROKER_HANDLE)&data, (MODULE_HANDLE)1, (MESSAGE_HANDLE)1);
+    BROKER_RESULT result2 = Broker_Publish((BROKER_HANDLE)&data2, (MODULE_HANDLE)1, (MESSAGE_HANDLE)1);
+
+    // Assert
+    ASSERT_ARE_EQUAL(int, BROKER_OK, result);
+    ASSERT_ARE_EQUAL(int, BROKER_OK, result2);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_IS_NULL(strstr(umock_c_get_actual_calls(), "Message_ToByteArray"));
+    ASSERT_ARE_EQUAL(int, 0, memcmp(allocated_bytes, serialized_bytes, sizeof(serialized_bytes)));
+    ASSERT_ARE_EQUAL(int, 0, memcmp(allocated_bytes2, serialized_bytes, sizeof(serialized_bytes)));
+
+    // Cleanup
+}
+
+/* Tests_SRS_BROKER_17_011: [ Broker_Publish shall free the serialized message data if nanomsg did not take it. ] */
+/* Tests_SRS_BROKER_13_037: [ This function shall return BROKER_ERROR if an underlying API call to the platform causes an error or BROKER_OK otherwise. ] */
+TEST_FUNCTION(Broker_Publish_frees_the_nanomsg_buffer_when_nn_send_fails)
+{
+    // Arrange
+    int data[100];
+    memset(&data, 1, 100);
+
+    static const int32_t msg_size = 100;
+    static unsigned char serialized_bytes[100];
+    static unsigned char allocated_bytes[100];
+    const unsigned char* serialized_memptr = serialized_bytes;
+    void* allocated_memptr = allocated_bytes;
+    memset(serialized_bytes, 0x42, sizeof(serialized_bytes));
+
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(Message_Clone(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(Message_GetSerializedWithVersion(IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2)
+        .CopyOutArgumentBuffer(3, &serialized_memptr, sizeof(serialized_memptr))
+        .CopyOutArgumentBuffer(4, &msg_size, sizeof(msg_size))
+        .SetReturn(0);
+    STRICT_EXPECTED_CALL(nn_allocmsg(msg_size, 0))
+        .SetReturn(allocated_memptr);
+    STRICT_EXPECTED_CALL(nn_send(IGNORED_NUM_ARG, IGNORED_PTR_ARG, NN_MSG, 0))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2)
+        .SetReturn(-1);
+    STRICT_EXPECTED_CALL(nn_errno())
+        .SetReturn(EAGAIN);
+    STRICT_EXPECTED_CALL(nn_freemsg(allocated_memptr));
+    STRICT_EXPECTED_CALL(Message_Destroy(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+
+    // Act
+    BROKER_RESULT result = Broker_Publish((BROKER_HANDLE)&data, (MODULE_HANDLE)1, (MESSAGE_HANDLE)1);
+
+    // Assert
+    ASSERT_ARE_EQUAL(int, BROKER_ERROR, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 
     // Cleanup
 }
@@ -96,6 +96,12 @@ typedef struct CONTROL_MESSAGE_MODULE_CREATE_TAG
      */
     char* args;
 
+    /** @brief  The highest gateway message serialization version the sender
+     *          understands. It is serialized after the args only when it is
+     *          greater than 1, and reads as 1 when it is absent.
+     */
+    uint8_t max_message_version;
+
 }CONTROL_MESSAGE_MODULE_CREATE;
 
 /** @brief    Defines the structure of the message that is sent in reply to the
@@ -112,6 +118,13 @@ typedef struct CONTROL_MESSAGE_MODULE_REPLY_TAG
      *          indicate success and the value 0 to indicate failure.
      */
     uint8_t status;
+
+    /** @brief  The gateway message serialization version the module host
+     *          picked for the messages it exchanges with the gateway. It is
+     *          serialized after the status only when it is greater than 1, and
+     *          reads as 1 when it is absent.
+     */
+    uint8_t message_version;
 }CONTROL_MESSAGE_MODULE_REPLY;
 
 
@@ -95,6 +95,7 @@ static void init_create_message_contents(CONTROL_MESSAGE_MODULE_CREATE * create_
     create_msg->uri.uri = NULL;
     create_msg->args_size = 0;
     create_msg->args = NULL;
+    create_msg->max_message_version = GATEWAY_MESSAGE_VERSION_1;
 }
 
 static void free_create_message_contents(CONTROL_MESSAGE_MODULE_CREATE * create_msg)
@@ -175,6 +176,12 @@ int parse_create_message(const unsigned char* source, size_t sourceSize, size_t
         }
         else
         {
+            position += current_parsed;
+            /*Codes_SRS_CONTROL_MESSAGE_17_038: [ If a byte follows the args, this function shall read it as the max_message_version, otherwise max_message_version shall be GATEWAY_MESSAGE_VERSION_1. ]*/
+            if (position < sourceSize)
+            {
+                create_msg->max_message_version = (uint8_t)source[position];
+            }
             result = 0;
         }
     }
@@ -275,7 +282,10 @@ CONTROL_MESSAGE * ControlMessage_CreateFromByteArray(const unsigned char* source
                             result->type = messageType;
 							/*Codes_SRS_CONTROL_MESSAGE_17_021: [ This function shall read the status from the byte stream. ]*/
                             ((CONTROL_MESSAGE_MODULE_REPLY*)result)->status = 
-                                (uint8_t)source[currentPosition];
+                                (uint8_t)source[currentPosition++];
+							/*Codes_SRS_CONTROL_MESSAGE_17_039: [ If a byte follows the status, this function shall read it as the message_version, otherwise message_version shall be GATEWAY_MESSAGE_VERSION_1. ]*/
+                            ((CONTROL_MESSAGE_MODULE_REPLY*)result)->message_version =
+                                (currentPosition < size) ? (uint8_t)source[currentPosition] : GATEWAY_MESSAGE_VERSION_1;
                         }
                     }
                 }
@@ -345,6 +355,10 @@ static int32_t create_message_get_size(CONTROL_MESSAGE * message)
             (int32_t)strlen(create_msg->args)
             + 1; /* for null char */
     }
+    if (create_msg->max_message_version > GATEWAY_MESSAGE_VERSION_1)
+    {
+        result += 1; /* max_message_version */
+    }
         
     return result;
 }
@@ -371,6 +385,11 @@ static void create_message_serialize(CONTROL_MESSAGE_MODULE_CREATE * create_msg,
         memcpy(buf + currentPosition, create_msg->args, create_msg->args_size);
         currentPosition += create_msg->args_size;
     }
+    /*Codes_SRS_CONTROL_MESSAGE_17_040: [ This function shall write max_message_version after the args only if it is greater than GATEWAY_MESSAGE_VERSION_1. ]*/
+    if (create_msg->max_message_version > GATEWAY_MESSAGE_VERSION_1)
+    {
+        buf[currentPosition++] = create_msg->max_message_version;
+    }
 }
 
 
@@ -412,6 +431,10 @@ int32_t ControlMessage_ToByteArray(CONTROL_MESSAGE * message, unsigned char* buf
         {
             result = 0;
             byteArraySize += 1; /* status */
+            if (((CONTROL_MESSAGE_MODULE_REPLY*)message)->message_version > GATEWAY_MESSAGE_VERSION_1)
+            {
+                byteArraySize += 1; /* message_version */
+            }
         }
         else if (
                  (message->type == CONTROL_MESSAGE_TYPE_MODULE_START) || 
@@ -467,6 +490,11 @@ int32_t ControlMessage_ToByteArray(CONTROL_MESSAGE * message, unsigned char* buf
                     CONTROL_MESSAGE_MODULE_REPLY * reply_msg = 
                             (CONTROL_MESSAGE_MODULE_REPLY*)message;
                     buf[currentPosition++] = (reply_msg->status);
+					/*Codes_SRS_CONTROL_MESSAGE_17_041: [ This function shall write message_version after the status only if it is greater than GATEWAY_MESSAGE_VERSION_1. ]*/
+                    if (reply_msg->message_version > GATEWAY_MESSAGE_VERSION_1)
+                    {
+                        buf[currentPosition++] = reply_msg->message_version;
+                    }
                 }
 				/*Codes_SRS_CONTROL_MESSAGE_17_035: [ Upon success this function shall return the byte array size.*/
                 result = byteArraySize;
@@ -119,6 +119,25 @@ static const unsigned char notFail__1url_1args[] =
 	'T','h','i','s',' ','i','s',' ','m','o','d','u','l','e',' ','a','r','g','u','m','e','n','t','s','\0',
 };
 
+static const unsigned char notFail__1url_0args_maxVersion2[] =
+{
+	0xA1, 0x6C, 0x01, 1,    /*header, version, type */
+	0x00, 0x00, 0x00, 24,   /*size of this array*/
+	0x01,				    /*gateway message version*/
+	0x00, 0x00, 0x00, 0x00, 0x05, /* type, Size of uri*/
+	'm',  's',  'g',  's', '\0', /*uri*/
+	0x00, 0x00, 0x00, 0x00, /*module args size*/
+	0x02                    /*max message version*/
+};
+
+static const unsigned char notFail____messageCreateReplyVersion2[] =
+{
+	0xA1, 0x6C, 0x01, 2,    /*header, version, type */
+	0x00, 0x00, 0x00, 10,   /*size of this array*/
+	0x00,                   /*status*/
+	0x02                    /*message version*/
+};
+
 static const unsigned char fail____headerFirstByteBad[] =
 {
 	0xA2, 0x6C, 0x01, 3,    /*header, version, type */
@@ -763,4 +782,100 @@ TEST_FUNCTION(ControlMessage_ToByteArray_create_reply_correct)
 	///cleanup
 }
 
+/*Tests_SRS_CONTROL_MESSAGE_17_038: [ If a byte follows the args, this function shall read it as the max_message_version, otherwise max_message_version shall be GATEWAY_MESSAGE_VERSION_1. ]*/
+/*Tests_SRS_CONTROL_MESSAGE_17_039: [ If a byte follows the status, this function shall read it as the message_version, otherwise message_version shall be GATEWAY_MESSAGE_VERSION_1. ]*/
+TEST_FUNCTION(ControlMessage_CreateFromByteArray_message_versions_default_to_1)
+{
+	///arrange
+	STRICT_EXPECTED_CALL(gballoc_malloc(sizeof(CONTROL_MESSAGE_MODULE_CREATE)));
+	STRICT_EXPECTED_CALL(gballoc_malloc(5));
+	STRICT_EXPECTED_CALL(gballoc_malloc(sizeof(CONTROL_MESSAGE_MODULE_REPLY)));
+
+	///act
+	CONTROL_MESSAGE * r1 = ControlMessage_CreateFromByteArray(notFail__1url_0args, sizeof(notFail__1url_0args));
+	CONTROL_MESSAGE * r2 = ControlMessage_CreateFromByteArray(notFail____minimalMessageCreateReply, sizeof(notFail____minimalMessageCreateReply));
+
+	///assert
+	ASSERT_IS_NOT_NULL(r1);
+	ASSERT_IS_NOT_NULL(r2);
+	ASSERT_ARE_EQUAL(uint8_t, GATEWAY_MESSAGE_VERSION_1, ((CONTROL_MESSAGE_MODULE_CREATE*)r1)->max_message_version);
+	ASSERT_ARE_EQUAL(uint8_t, GATEWAY_MESSAGE_VERSION_1, ((CONTROL_MESSAGE_MODULE_REPLY*)r2)->message_version);
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+	///cleanup
+	ControlMessage_Destroy(r1);
+	ControlMessage_Destroy(r2);
+}
+
+/*Tests_SRS_CONTROL_MESSAGE_17_038: [ If a byte follows the args, this function shall read it as the max_message_version, otherwise max_message_version shall be GATEWAY_MESSAGE_VERSION_1. ]*/
+/*Tests_SRS_CONTROL_MESSAGE_17_039: [ If a byte follows the status, this function shall read it as the message_version, otherwise message_version shall be GATEWAY_MESSAGE_VERSION_1. ]*/
+TEST_FUNCTION(ControlMessage_CreateFromByteArray_reads_message_versions)
+{
+	///arrange
+	STRICT_EXPECTED_CALL(gballoc_malloc(sizeof(CONTROL_MESSAGE_MODULE_CREATE)));
+	STRICT_EXPECTED_CALL(gballoc_malloc(5));
+	STRICT_EXPECTED_CALL(gballoc_malloc(sizeof(CONTROL_MESSAGE_MODULE_REPLY)));
+
+	///act
+	CONTROL_MESSAGE * r1 = ControlMessage_CreateFromByteArray(notFail__1url_0args_maxVersion2, sizeof(notFail__1url_0args_maxVersion2));
+	CONTROL_MESSAGE * r2 = ControlMessage_CreateFromByteArray(notFail____messageCreateReplyVersion2, sizeof(notFail____messageCreateReplyVersion2));
+
+	///assert
+	ASSERT_IS_NOT_NULL(r1);
+	ASSERT_IS_NOT_NULL(r2);
+	ASSERT_ARE_EQUAL(uint8_t, 0x02, ((CONTROL_MESSAGE_MODULE_CREATE*)r1)->max_message_version);
+	ASSERT_ARE_EQUAL(uint8_t, 0, ((CONTROL_MESSAGE_MODULE_REPLY*)r2)->status);
+	ASSERT_ARE_EQUAL(uint8_t, 0x02, ((CONTROL_MESSAGE_MODULE_REPLY*)r2)->message_version);
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+	///cleanup
+	ControlMessage_Destroy(r1);
+	ControlMessage_Destroy(r2);
+}
+
+/*Tests_SRS_CONTROL_MESSAGE_17_040: [ This function shall write max_message_version after the args only if it is greater than GATEWAY_MESSAGE_VERSION_1. ]*/
+TEST_FUNCTION(ControlMessage_ToByteArray_create_with_max_message_version_roundabout_success)
+{
+	///arrange
+	CONTROL_MESSAGE * r1 = ControlMessage_CreateFromByteArray(notFail__1url_0args_maxVersion2, sizeof(notFail__1url_0args_maxVersion2));
+	unsigned char buf[sizeof(notFail__1url_0args_maxVersion2)];
+	umock_c_reset_all_calls();
+
+	///act
+	int32_t c1 = ControlMessage_ToByteArray(r1, buf, sizeof(buf));
+
+	///assert
+	ASSERT_ARE_EQUAL(int32_t, sizeof(notFail__1url_0args_maxVersion2), c1);
+	ASSERT_ARE_EQUAL(int, 0, memcmp(notFail__1url_0args_maxVersion2, buf, sizeof(buf)));
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+	///cleanup
+	ControlMessage_Destroy(r1);
+}
+
+/*Tests_SRS_CONTROL_MESSAGE_17_041: [ This function shall write message_version after the status only if it is greater than GATEWAY_MESSAGE_VERSION_1. ]*/
+TEST_FUNCTION(ControlMessage_ToByteArray_create_reply_with_message_version_correct)
+{
+	///arrange
+	CONTROL_MESSAGE_MODULE_REPLY m1 =
+	{
+		{
+			0x01,
+			CONTROL_MESSAGE_TYPE_MODULE_REPLY
+		},
+		0,
+		0x02
+	};
+	unsigned char buf[10];
+
+	///act
+	int32_t c1 = ControlMessage_ToByteArray((CONTROL_MESSAGE*)&m1, buf, 10);
+
+	///assert
+	ASSERT_ARE_EQUAL(int32_t, 10, c1);
+	ASSERT_ARE_EQUAL(int, 0, memcmp(notFail____messageCreateReplyVersion2, buf, sizeof(buf)));
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+	///cleanup
+}
+
 END_TEST_SUITE(control_message_ut)
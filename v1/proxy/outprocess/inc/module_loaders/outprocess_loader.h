@@ -53,6 +53,8 @@ typedef struct OUTPROCESS_LOADER_ENTRYPOINT_TAG
     char ** process_argv;
     /** @brief controls timeout for ipc retries. */
 	unsigned int remote_message_wait;
+    /** @brief Messages queued for the module host before new ones are dropped, 0 for the default. */
+    size_t outgoing_queue_capacity;
 } OUTPROCESS_LOADER_ENTRYPOINT;
 
 /** @brief      The API for the out of process proxy module loader. */
@@ -23,6 +23,9 @@ extern "C"
 
 DEFINE_ENUM(OUTPROCESS_MODULE_LIFECYCLE, OUTPROCESS_MODULE_LIFECYCLE_VALUES);
 
+/** @brief Default number of messages queued for the module host */
+#define OUTPROCESS_OUTGOING_QUEUE_CAPACITY 1024
+
 /** @brief Structure to configure an out of process proxy module */
 typedef struct OUTPROCESS_MODULE_CONFIG_DATA
 {
@@ -35,6 +38,8 @@ typedef struct OUTPROCESS_MODULE_CONFIG_DATA
     STRING_HANDLE outprocess_module_args;
 	/** @brief controls timeout for ipc retries. */
 	unsigned int remote_message_wait;
+	/** @brief Messages queued for the module host before new ones are dropped, 0 for #OUTPROCESS_OUTGOING_QUEUE_CAPACITY. */
+	size_t outgoing_queue_capacity;
 } OUTPROCESS_MODULE_CONFIG;
 
 /** @brief the API fr this module */
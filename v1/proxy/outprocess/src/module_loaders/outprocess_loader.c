@@ -567,6 +567,10 @@ static void* OutprocessModuleLoader_ParseEntrypointFromJson(const struct MODULE_
                     config->remote_message_wait = (unsigned int)timeout;
                 }
 
+                /*Codes_SRS_OUTPROCESS_LOADER_17_045: [ This function shall assign the entrypoint outgoing_queue_capacity to the value of "outgoing.queue.capacity", 0 if it is not present or not a positive number. ]*/
+                double capacity = json_object_get_number(entrypoint, "outgoing.queue.capacity");
+                config->outgoing_queue_capacity = (capacity < 1) ? 0 : (size_t)capacity;
+
                 /*Codes_SRS_OUTPROCESS_LOADER_17_017: [ This function shall assign the entrypoint activation_type to the decoded value. ] */
                 config->activation_type = activationType;
 
@@ -704,6 +708,8 @@ static void* OutprocessModuleLoader_BuildModuleConfiguration(
         {
             /*Codes_SRS_OUTPROCESS_LOADER_17_035: [ Upon success, this function shall return a valid pointer to an OUTPROCESS_MODULE_CONFIG structure. ]*/
             fullModuleConfiguration->remote_message_wait = ep->remote_message_wait;
+            /*Codes_SRS_OUTPROCESS_LOADER_17_046: [ This function shall copy the entrypoint outgoing_queue_capacity into OUTPROCESS_MODULE_CONFIG. ]*/
+            fullModuleConfiguration->outgoing_queue_capacity = ep->outgoing_queue_capacity;
             fullModuleConfiguration->lifecycle_model = OUTPROCESS_LIFECYCLE_SYNC;
         }
     }
@@ -749,7 +755,8 @@ static MODULE_LOADER OutProcess_Module_Loader =
     OUTPROCESS,
     OUTPROCESS_LOADER_NAME,
     NULL,
-    &Outprocess_Module_Loader_API
+    &Outprocess_Module_Loader_API,
+    true
 };
 
 const MODULE_LOADER* OutprocessLoader_Get(void)
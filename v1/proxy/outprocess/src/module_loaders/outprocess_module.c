@@ -2,6 +2,7 @@
 // Licensed under the MIT license. See LICENSE file in the project root for full license information.
 
 #include <stdlib.h>
+#include <string.h>
 #include <errno.h>
 #include <nanomsg/nn.h>
 #include <nanomsg/pair.h>
@@ -12,6 +13,7 @@
 #include "message_queue.h"
 #include "control_message.h"
 #include "module_loaders/outprocess_module.h"
+#include "gateway_trace.h"
 #include "azure_c_shared_utility/strings.h"
 #include "azure_c_shared_utility/xlogging.h"
 #include "azure_c_shared_utility/gballoc.h"
@@ -27,6 +29,11 @@ typedef struct THREAD_CONTROL_TAG
 
 #define THREAD_FLAG_STOP 1
 
+/*how long the outgoing message thread sleeps on an empty queue before it checks whether it should stop*/
+#define OUTPROCESS_OUTGOING_WAIT_MS 100
+/*most messages the outgoing message thread takes off the queue per wake-up*/
+#define OUTPROCESS_OUTGOING_BATCH_SIZE 32
+
 typedef struct OUTPROCESS_HANDLE_DATA_TAG
 {
 	LOCK_HANDLE handle_lock;
@@ -39,6 +46,8 @@ typedef struct OUTPROCESS_HANDLE_DATA_TAG
 	OUTPROCESS_MODULE_LIFECYCLE lifecyle_model;
 	BROKER_HANDLE broker;
 	unsigned int remote_message_wait;
+	/*the gateway message serialization version negotiated with the module host*/
+	uint8_t message_version;
 
 	THREAD_CONTROL message_receive_thread;
 	THREAD_CONTROL message_send_thread;
@@ -130,6 +139,7 @@ int outprocessIncomingMessageThread(void *param)
 			}
 			else
 			{
+				GATEWAY_TRACE_INSTANT("outprocess_receive", nbytes);
 				/*Codes_SRS_OUTPROCESS_MODULE_17_039: [ Upon successful receiving a gateway message, this function shall deserialize the message. ]*/
 				const unsigned char*buf_bytes = (const unsigned char*)buf;
 				MESSAGE_HANDLE msg = Message_CreateFromByteArray(buf_bytes, nbytes);
@@ -144,9 +154,44 @@ int outprocessIncomingMessageThread(void *param)
 			ThreadAPI_Sleep(1);
 		}
 	}
+	GATEWAY_TRACE_THREAD_EXIT();
 	return 0;
 }
 
+static void send_outgoing_message(OUTPROCESS_HANDLE_DATA* handleData, uint8_t message_version, MESSAGE_HANDLE messageHandle)
+{
+	const unsigned char* serialized;
+	int32_t msg_size;
+	/*Codes_SRS_OUTPROCESS_MODULE_17_023: [ This function shall serialize the message with the message version negotiated with the module host by calling Message_GetSerializedWithVersion. ]*/
+	if (Message_GetSerializedWithVersion(messageHandle, message_version, &serialized, &msg_size) != 0)
+	{
+		LogError("unable to serialize outgoing message [%p]", messageHandle);
+	}
+	else
+	{
+		/*Codes_SRS_OUTPROCESS_MODULE_17_066: [ This function shall allocate a nanomsg message of the serialized size and copy the serialized message into it. ]*/
+		void* nn_msg = nn_allocmsg((size_t)msg_size, 0);
+		if (nn_msg == NULL)
+		{
+			LogError("unable to allocate buffer for outgoing message [%p]", messageHandle);
+		}
+		else
+		{
+			memcpy(nn_msg, serialized, (size_t)msg_size);
+
+			GATEWAY_TRACE_BEGIN("outprocess_send", msg_size);
+			/*Codes_SRS_OUTPROCESS_MODULE_17_024: [ This function shall send the nanomsg message on the message channel, handing its ownership to nanomsg. ]*/
+			int nbytes = nn_really_send(handleData->message_socket, &nn_msg, NN_MSG, 0);
+			GATEWAY_TRACE_END("outprocess_send");
+			if (nbytes != msg_size)
+			{
+				LogError("unable to send buffer to remote for message [%p]", messageHandle);
+				nn_freemsg(nn_msg);
+			}
+		}
+	}
+}
+
 static int outprocessOutgoingMessagesThread(void * param)
 {
 	OUTPROCESS_HANDLE_DATA * handleData = (OUTPROCESS_HANDLE_DATA*)param;
@@ -178,74 +223,49 @@ static int outprocessOutgoingMessagesThread(void * param)
 				should_continue = 0;
 				break;
 			}
-			MESSAGE_HANDLE messageHandle;
+			MESSAGE_HANDLE batch[OUTPROCESS_OUTGOING_BATCH_SIZE];
+			size_t batch_count;
+			size_t i;
+			/*Codes_SRS_OUTPROCESS_MODULE_17_054: [ This function shall remove the oldest message from the outgoing gateway message queue, sleeping on the queue for at most OUTPROCESS_OUTGOING_WAIT_MS milliseconds while it is empty. ]*/
+			batch[0] = MESSAGE_QUEUE_pop_wait(handleData->outgoing_messages, OUTPROCESS_OUTGOING_WAIT_MS);
+			if (batch[0] == NULL)
+			{
+				continue;
+			}
+			/*Codes_SRS_OUTPROCESS_MODULE_17_064: [ Once it has a message, this function shall also remove up to OUTPROCESS_OUTGOING_BATCH_SIZE - 1 further messages that are already waiting on the outgoing gateway message queue. ]*/
+			batch_count = 1 + MESSAGE_QUEUE_pop_batch(handleData->outgoing_messages, batch + 1, OUTPROCESS_OUTGOING_BATCH_SIZE - 1);
+
+			/* forward messages to remote */
+			uint8_t message_version;
 			/*Codes_SRS_OUTPROCESS_MODULE_17_053: [ This thread shall ensure thread safety on the module data. ]*/
+			/*Codes_SRS_OUTPROCESS_MODULE_17_065: [ This function shall lock the module data once per batch of messages. ]*/
 			if (Lock(handleData->handle_lock) != LOCK_OK)
 			{
 				LogError("unable to Lock");
 				should_continue = 0;
-				break;
-			}
-			
-			if (MESSAGE_QUEUE_is_empty(handleData->outgoing_messages))
-			{
-				messageHandle = NULL;
 			}
 			else
 			{
-				/*Codes_SRS_OUTPROCESS_MODULE_17_054: [ This function shall remove the oldest message from the outgoing gateway message queue. ]*/
-				messageHandle = MESSAGE_QUEUE_pop(handleData->outgoing_messages);
-				if (messageHandle == NULL)
+				message_version = handleData->message_version;
+				if (Unlock(handleData->handle_lock) != LOCK_OK)
 				{
-					LogError("bad condition: message handle in queue is NULL");
-					(void)Unlock(handleData->handle_lock);
 					should_continue = 0;
-					break;
 				}
 			}
-			if (Unlock(handleData->handle_lock) != LOCK_OK)
-			{
-				should_continue = 0;
-				break;
-			}
 
-			/* forward message to remote */
-			if (messageHandle != NULL)
+			for (i = 0; i < batch_count; i++)
 			{
-				/*Codes_SRS_OUTPROCESS_MODULE_17_023: [ This function shall serialize the message for transmission on the message channel. ]*/
-				int32_t msg_size = Message_ToByteArray(messageHandle, NULL, 0);
-				if (msg_size < 0)
+				if (should_continue)
 				{
-					LogError("unable to serialize outgoing message [%p]", messageHandle);
-				}
-				else
-				{
-					void* result = nn_allocmsg(msg_size, 0);
-					if (result == NULL)
-					{
-						LogError("unable to allocate buffer for outgoing message [%p]", messageHandle);
-					}
-					else
-					{
-						unsigned char *nn_msg_bytes = (unsigned char *)result;
-						Message_ToByteArray(messageHandle, nn_msg_bytes, msg_size);
-						/*Codes_SRS_OUTPROCESS_MODULE_17_024: [ This function shall send the message on the message channel. ]*/
-						int nbytes = nn_really_send(handleData->message_socket, &result, NN_MSG, 0);
-						if (nbytes != msg_size)
-						{
-							LogError("unable to send buffer to remote for message [%p]", messageHandle);
-							/*Codes_SRS_OUTPROCESS_MODULE_17_025: [ This function shall free any resources created. ]*/
-							nn_freemsg(result);
-						}
-					}
+					send_outgoing_message(handleData, message_version, batch[i]);
 				}
 				// We are finally finished with this message
 				/*Codes_SRS_OUTPROCESS_MODULE_17_055: [ This function shall Destroy the message once successfully transmitted. ]*/
-				Message_Destroy(messageHandle);
+				Message_Destroy(batch[i]);
 			}
-			ThreadAPI_Sleep(1);
 		}
 	}
+	GATEWAY_TRACE_THREAD_EXIT();
 	return 0;
 }
 
@@ -354,6 +374,11 @@ static int outprocessCreate(void *param)
 										else
 										{
 											/*Codes_SRS_OUTPROCESS_MODULE_17_015: [ This function shall expect a successful result from the Create Response to consider the module creation a success. ]*/
+											/*Codes_SRS_OUTPROCESS_MODULE_17_062: [ This function shall use the message_version of the Create Response for the messages it sends to the module host; a version it does not support shall be treated as GATEWAY_MESSAGE_VERSION_1. ]*/
+											handleData->message_version =
+												(resp_msg->message_version > GATEWAY_MESSAGE_VERSION_1 && resp_msg->message_version <= GATEWAY_MESSAGE_VERSION_MAX) ?
+												resp_msg->message_version :
+												GATEWAY_MESSAGE_VERSION_1;
 											// complete success!
 											thread_return = 1;
 										}
@@ -603,7 +628,9 @@ static void* construct_create_message(OUTPROCESS_HANDLE_DATA* handleData, int32_
 				uri_string							/*uri*/
 			},
 			args_length + 1,	/*args_size;(+1 for null)*/
-			args_string			/*args;*/
+			args_string,		/*args;*/
+			/*Codes_SRS_OUTPROCESS_MODULE_17_061: [ The Create Message shall offer GATEWAY_MESSAGE_VERSION_MAX as the highest gateway message version the gateway supports. ]*/
+			GATEWAY_MESSAGE_VERSION_MAX	/*max_message_version*/
 		};
 		result = serialize_control_message((CONTROL_MESSAGE *)&create_msg, creationMessageSize);
 	}
@@ -749,8 +776,8 @@ static MODULE_HANDLE Outprocess_Create(BROKER_HANDLE broker, const void* configu
 			}
 			else
 			{
-				/*Codes_SRS_OUTPROCESS_MODULE_17_042: [ This function shall initialize a queue for outgoing gateway messages. ]*/
-				module->outgoing_messages = MESSAGE_QUEUE_create();
+				/*Codes_SRS_OUTPROCESS_MODULE_17_042: [ This function shall initialize a bounded queue of outgoing_queue_capacity outgoing gateway messages, or OUTPROCESS_OUTGOING_QUEUE_CAPACITY if outgoing_queue_capacity is 0. ]*/
+				module->outgoing_messages = MESSAGE_QUEUE_create_bounded(config->outgoing_queue_capacity == 0 ? OUTPROCESS_OUTGOING_QUEUE_CAPACITY : config->outgoing_queue_capacity);
 				if (module->outgoing_messages == NULL)
 				{
 					LogError("unable to create outgoing message queue");
@@ -780,6 +807,7 @@ static MODULE_HANDLE Outprocess_Create(BROKER_HANDLE broker, const void* configu
 						};
 						module->broker = broker;
 						module->remote_message_wait = config->remote_message_wait;
+						module->message_version = GATEWAY_MESSAGE_VERSION_1;
 						module->message_receive_thread = default_thread;
 						module->message_send_thread = default_thread;
 						module->control_thread = default_thread;
@@ -1015,21 +1043,21 @@ static void Outprocess_Receive(MODULE_HANDLE moduleHandle, MESSAGE_HANDLE messag
 		}
 		else
 		{
-			/*Codes_SRS_OUTPROCESS_MODULE_17_045: [ This function shall ensure thread safety for the module data. ]*/
-			if (Lock(handleData->handle_lock) != LOCK_OK)
+			/*Codes_SRS_OUTPROCESS_MODULE_17_045: [ This function shall not lock the module data; the outgoing gateway message queue accepts concurrent pushes. ]*/
+			/*Codes_SRS_OUTPROCESS_MODULE_17_047: [ This function shall push the message onto the end of the outgoing gateway message queue. ]*/
+			int push_result = MESSAGE_QUEUE_push(handleData->outgoing_messages, queued_message);
+			if (push_result == MESSAGE_QUEUE_FULL)
 			{
-				LogError("unable to Lock handle data");
+				/*Codes_SRS_OUTPROCESS_MODULE_17_063: [ If the outgoing gateway message queue is full, this function shall drop the message. ]*/
+				LogError("outgoing message queue is full, dropping message [%p]", messageHandle);
 				Message_Destroy(queued_message);
+				/*Codes_SRS_OUTPROCESS_MODULE_17_067: [ This function shall count a dropped message in the module's metrics by calling Broker_ReportDroppedMessages. ]*/
+				(void)Broker_ReportDroppedMessages(handleData->broker, moduleHandle, 1);
 			}
-			else
+			else if (push_result != 0)
 			{
-				/*Codes_SRS_OUTPROCESS_MODULE_17_047: [ This function shall push the message onto the end of the outgoing gateway message queue. ]*/
-				if (MESSAGE_QUEUE_push(handleData->outgoing_messages, queued_message) != 0)
-				{
-					LogError("unable to queue the message");
-					Message_Destroy(queued_message);
-				}
-				(void)Unlock(handleData->handle_lock);
+				LogError("unable to queue the message");
+				Message_Destroy(queued_message);
 			}
 		}
 	}